@@ -0,0 +1,275 @@
+#!/usr/bin/env python3
+
+# Performance regression suite: runs loading, saving, compiling, QA checks,
+# updating from sources and pre-translation from TM on generated catalogs
+# using Poedit's batch mode, and compares the timings and memory usage with
+# a baseline recorded earlier.
+#
+# Usage: check-performance.py --poedit PATH [--sizes 10000,100000] [--runs N]
+#                             [--save-baseline FILE | --baseline FILE]
+#                             [--budgets FILE] [--scenarios PATTERN,...] [--workdir DIR]
+#
+# Timings depend on the machine, so baselines aren't stored in the repository.
+# Record one with a known good build first:
+#
+#     check-performance.py --poedit old/poedit --save-baseline baseline.json
+#
+# and then check newer builds against it on the same machine:
+#
+#     check-performance.py --poedit new/poedit --baseline baseline.json
+#
+# A scenario fails if any of its metrics exceeds the baseline by more than
+# allowed by the budgets in tests/performance/budgets.json; the script then
+# exits with status 1.
+#
+# The TM scenario imports into Poedit's translation memory. It is only run
+# where the TM can be isolated from the user's one (via XDG_DATA_HOME, i.e.
+# on Linux), unless --allow-user-tm is used. Updating from sources requires
+# gettext tools to be installed.
+
+import argparse
+import fnmatch
+import json
+import os
+import os.path
+import platform
+import shutil
+import subprocess
+import sys
+import tempfile
+
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_BUDGETS = os.path.join(HERE, '..', 'tests', 'performance', 'budgets.json')
+DEFAULT_SIZES = [10000, 100000]
+FORMATS = ['po', 'xliff', 'json', 'ts', 'resx']
+FILENAMES = {
+    'po':    'benchmark-%d.cs.po',
+    'xliff': 'benchmark-%d.cs.xlf',
+    'json':  'benchmark-%d.cs.json',
+    'ts':    'benchmark-%d_cs.ts',
+    'resx':  'benchmark-%d.cs.resx',
+}
+
+
+class Scenario:
+    def __init__(self, name, fmt, size, operations, steps, tm=False, sources=False):
+        self.name = name
+        self.fmt = fmt
+        self.size = size
+        self.operations = operations    # value of --batch
+        self.steps = steps              # timed steps reported as metrics
+        self.tm = tm                    # imports TMX into TM first
+        self.sources = sources          # needs generated source code
+
+    @property
+    def filename(self):
+        return FILENAMES[self.fmt] % self.size
+
+
+def make_scenarios(sizes):
+    scenarios = []
+    for size in sizes:
+        for fmt in FORMATS:
+            scenarios.append(Scenario('check-%s-%d' % (fmt, size), fmt, size, 'check', ['load', 'check']))
+            scenarios.append(Scenario('save-%s-%d' % (fmt, size), fmt, size, 'save', ['save']))
+        scenarios.append(Scenario('compile-po-%d' % size, 'po', size, 'compile', ['compile']))
+        scenarios.append(Scenario('update-po-%d' % size, 'po', size, 'update', ['update'], sources=True))
+        scenarios.append(Scenario('pretranslate-po-%d' % size, 'po', size, 'pretranslate', ['pretranslate'], tm=True))
+    return scenarios
+
+
+def generate_corpus(corpus_dir, sizes):
+    generator = os.path.join(HERE, 'generate-benchmark-catalogs.py')
+    subprocess.run([sys.executable, generator,
+                    '--sizes', ','.join(str(x) for x in sizes),
+                    '--formats', ','.join(FORMATS + ['tmx']),
+                    '--with-sources',
+                    corpus_dir],
+                   check=True, stdout=subprocess.DEVNULL)
+
+
+def run_scenario(args, scenario, corpus_dir, run_dir):
+    """Runs the scenario once in a fresh copy of its files, returns its metrics."""
+    if os.path.exists(run_dir):
+        shutil.rmtree(run_dir)
+    os.makedirs(run_dir)
+
+    # files are modified by the operations, so always work on copies:
+    shutil.copy(os.path.join(corpus_dir, scenario.filename), run_dir)
+    if scenario.sources:
+        sources_dir = 'benchmark-%d-sources' % scenario.size
+        shutil.copytree(os.path.join(corpus_dir, sources_dir), os.path.join(run_dir, sources_dir))
+
+    env = dict(os.environ)
+    # isolate TM and settings from the user's (only effective on Linux):
+    env['XDG_DATA_HOME'] = os.path.join(run_dir, 'data')
+    env['XDG_CONFIG_HOME'] = os.path.join(run_dir, 'config')
+
+    timing_file = os.path.join(run_dir, 'timing.json')
+    cmd = [args.poedit, '--batch=' + scenario.operations, '--jobs=1', '--timing=' + timing_file]
+    if scenario.tm:
+        cmd.append('--import-tm=' + os.path.join(corpus_dir, 'benchmark-%d.tmx' % scenario.size))
+    cmd.append(os.path.join(run_dir, scenario.filename))
+
+    proc = subprocess.run(cmd, env=env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    if not os.path.exists(timing_file):
+        raise RuntimeError('no timing written (exit code %d):\n%s' % (proc.returncode, proc.stdout))
+
+    with open(timing_file, encoding='utf-8') as f:
+        timing = json.load(f)
+    result = timing['files'][0]
+    # validation errors don't matter here, only failures to process the file:
+    if 'error' in result:
+        raise RuntimeError(result['error'])
+
+    metrics = {}
+    for step in scenario.steps:
+        if step not in result['ms']:
+            raise RuntimeError('step "%s" was not performed' % step)
+        metrics[step + '_ms'] = result['ms'][step]
+    metrics['catalog_memory_bytes'] = result['memory_bytes']
+    if 'peak_memory_bytes' in timing:
+        metrics['peak_memory_bytes'] = timing['peak_memory_bytes']
+    return metrics
+
+
+def measure(args, scenario, corpus_dir, work_dir):
+    """Runs the scenario repeatedly and returns the best values, to reduce noise."""
+    best = None
+    for i in range(args.runs):
+        metrics = run_scenario(args, scenario, corpus_dir, os.path.join(work_dir, 'run'))
+        if best is None:
+            best = metrics
+        else:
+            best = {k: min(v, metrics.get(k, v)) for k, v in best.items()}
+    return best
+
+
+def load_budgets(filename):
+    with open(filename, encoding='utf-8') as f:
+        budgets = json.load(f)
+    return budgets
+
+
+def budget_for(budgets, scenario_name):
+    budget = dict(budgets['default'])
+    for pattern, overrides in budgets.get('scenarios', {}).items():
+        if fnmatch.fnmatch(scenario_name, pattern):
+            budget.update(overrides)
+    return budget
+
+
+def check_metrics(budget, baseline, current):
+    """Returns list of descriptions of metrics exceeding the budget."""
+    regressions = []
+    for key, base in baseline.items():
+        if key not in current:
+            continue
+        value = current[key]
+        if key.endswith('_ms'):
+            limit = base * budget['time'] + budget['time_slack_ms']
+            unit = 'ms'
+        else:
+            limit = base * budget['memory'] + budget['memory_slack_bytes']
+            unit = 'bytes'
+        if value > limit:
+            regressions.append('%s: %.0f %s, baseline %.0f, limit %.0f' % (key, value, unit, base, limit))
+    return regressions
+
+
+def poedit_version(poedit):
+    try:
+        return subprocess.run([poedit, '--version'], stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                              text=True, timeout=60).stdout.strip()
+    except (OSError, subprocess.SubprocessError):
+        return ''
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Check Poedit for performance regressions.')
+    parser.add_argument('--poedit', required=True, help='Poedit executable to test')
+    parser.add_argument('--sizes', default=','.join(str(x) for x in DEFAULT_SIZES),
+                        help='comma-separated numbers of entries (default: %(default)s)')
+    parser.add_argument('--runs', type=int, default=3,
+                        help='runs of each scenario, the best result is used (default: %(default)s)')
+    parser.add_argument('--scenarios', default='*',
+                        help='comma-separated wildcard patterns of scenarios to run (default: all)')
+    parser.add_argument('--budgets', default=DEFAULT_BUDGETS, help='budgets file (default: %(default)s)')
+    group = parser.add_mutually_exclusive_group(required=True)
+    group.add_argument('--baseline', help='baseline to compare against')
+    group.add_argument('--save-baseline', help='record baseline into this file')
+    parser.add_argument('--allow-user-tm', action='store_true',
+                        help="run TM scenarios even where they would use the user's TM")
+    parser.add_argument('--workdir', help='directory for generated files (default: temporary)')
+    args = parser.parse_args()
+
+    if args.runs < 1:
+        sys.exit('number of runs must be at least 1')
+
+    sizes = [int(x) for x in args.sizes.split(',')]
+    patterns = args.scenarios.split(',')
+    scenarios = [s for s in make_scenarios(sizes) if any(fnmatch.fnmatch(s.name, p) for p in patterns)]
+    can_isolate_tm = platform.system() == 'Linux'
+    if not can_isolate_tm and not args.allow_user_tm:
+        skipped = [s.name for s in scenarios if s.tm]
+        if skipped:
+            print('skipping scenarios using TM, see --allow-user-tm: %s' % ', '.join(skipped))
+        scenarios = [s for s in scenarios if not s.tm]
+
+    baseline = None
+    if args.baseline:
+        with open(args.baseline, encoding='utf-8') as f:
+            baseline = json.load(f)
+        if baseline.get('machine') != platform.node():
+            print('warning: baseline was recorded on a different machine (%s)' % baseline.get('machine'))
+        budgets = load_budgets(args.budgets)
+
+    work_dir = args.workdir or tempfile.mkdtemp(prefix='poedit-perf-')
+    corpus_dir = os.path.join(work_dir, 'corpus')
+    if not os.path.exists(corpus_dir):
+        generate_corpus(corpus_dir, sizes)
+
+    results = {}
+    failed = []
+    for scenario in scenarios:
+        try:
+            metrics = measure(args, scenario, corpus_dir, work_dir)
+        except RuntimeError as e:
+            print('%-28s ERROR %s' % (scenario.name, e))
+            failed.append(scenario.name)
+            continue
+        results[scenario.name] = metrics
+        summary = ', '.join('%s=%.0f' % kv for kv in metrics.items())
+
+        if baseline is None:
+            print('%-28s %s' % (scenario.name, summary))
+            continue
+        base = baseline['scenarios'].get(scenario.name)
+        if base is None:
+            print('%-28s no baseline, %s' % (scenario.name, summary))
+            continue
+        regressions = check_metrics(budget_for(budgets, scenario.name), base, metrics)
+        if regressions:
+            failed.append(scenario.name)
+            print('%-28s FAIL  %s' % (scenario.name, '; '.join(regressions)))
+        else:
+            print('%-28s ok    %s' % (scenario.name, summary))
+
+    if not args.workdir:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+    if args.save_baseline:
+        with open(args.save_baseline, 'w', encoding='utf-8') as f:
+            json.dump({'poedit': poedit_version(args.poedit),
+                       'machine': platform.node(),
+                       'scenarios': results}, f, indent=2)
+            f.write('\n')
+
+    if failed:
+        print('%d scenario(s) failed: %s' % (len(failed), ', '.join(failed)))
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
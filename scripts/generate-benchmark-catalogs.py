@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+
+# Generates synthetic translation files of configurable sizes in all formats
+# Poedit can open, for measuring performance of loading and saving them, and
+# TMX files for measuring translation memory performance.
+#
+# Usage: generate-benchmark-catalogs.py [--sizes 1000,10000,...] [--formats po,xliff,...]
+#                                       [--languages N] [--with-sources] OUTPUT_DIR
+#
+# Open the generated files with "poedit --trace=trace.json FILE" and save them
+# or compile MO; the resulting trace contains timings of Catalog::Create, Save,
+# SaveToBuffer and CompileToMO as well as peak memory usage. View it in
+# https://ui.perfetto.dev or chrome://tracing.
+#
+# The TMX files (not generated by default, use "--formats tmx") contain each
+# entry translated into --languages languages. Import them into an empty TM in
+# Preferences with tracing enabled; Search, SearchSubstring, Insert and Commit
+# latency percentiles for the TM's size are then shown in the TM statistics
+# and individual calls are in the trace.
+#
+# With --with-sources, C source files containing the PO files' strings (with
+# a few changes) are generated too and the PO files are configured to be
+# updated from them, for measuring "poedit --batch=update".
+#
+# See also check-performance.py, which uses these files for regression testing.
+
+import argparse
+import json
+import os
+import os.path
+import random
+import sys
+from xml.sax.saxutils import escape, quoteattr
+
+
+DEFAULT_SIZES = [1000, 10000, 100000, 1000000]
+FORMATS = ['po', 'xliff', 'json', 'ts', 'resx']
+TM_FORMATS = ['tmx']
+
+TMX_LANGUAGES = ['cs', 'de', 'fr', 'es', 'it', 'ja', 'pl', 'pt-BR', 'ru', 'zh-Hans']
+
+WORDS = ('lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor '
+         'incididunt ut labore et dolore magna aliqua enim ad minim veniam quis nostrud '
+         'exercitation ullamco laboris nisi aliquip ex ea commodo consequat').split()
+
+
+class Entry:
+    def __init__(self, rnd, index):
+        self.key = 'message.%d' % index
+        long_string = index % 50 == 0
+        self.source = self.sentence(rnd, 80 if long_string else rnd.randint(1, 12)) + ' #%d' % index
+        self.translation = self.sentence(rnd, len(self.source.split())).upper() if index % 10 else ''
+        self.plural = (self.source + ' (plural)') if index % 20 == 1 else None
+        self.comment = 'Comment for entry %d' % index if index % 7 == 0 else None
+        self.references = ['src/module%d/file%d.c:%d' % ((index + k) % 13, (index + k) % 97, index + k)
+                           for k in range(1 + index % 3)]
+
+    @staticmethod
+    def sentence(rnd, words):
+        return ' '.join(rnd.choice(WORDS) for _ in range(words))
+
+
+def po_quote(s):
+    return '"%s"' % s.replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n')
+
+
+def write_po(f, entries, sources_dir=None):
+    f.write('msgid ""\nmsgstr ""\n'
+            '"Content-Type: text/plain; charset=UTF-8\\n"\n'
+            '"Language: cs\\n"\n'
+            '"Plural-Forms: nplurals=3; plural=(n==1) ? 0 : (n>=2 && n<=4) ? 1 : 2;\\n"\n')
+    if sources_dir:
+        f.write('"X-Poedit-Basepath: %s\\n"\n'
+                '"X-Poedit-KeywordsList: _;ngettext:1,2\\n"\n'
+                '"X-Poedit-SearchPath-0: .\\n"\n' % sources_dir)
+    f.write('\n')
+    for e in entries:
+        if e.comment:
+            f.write('#. %s\n' % e.comment)
+        f.write('#: %s\n' % ' '.join(e.references))
+        f.write('msgid %s\n' % po_quote(e.source))
+        if e.plural:
+            f.write('msgid_plural %s\n' % po_quote(e.plural))
+            for i in range(3):
+                f.write('msgstr[%d] %s\n' % (i, po_quote(e.translation)))
+        else:
+            f.write('msgstr %s\n' % po_quote(e.translation))
+        f.write('\n')
+
+
+def write_xliff(f, entries):
+    f.write('<?xml version="1.0" encoding="UTF-8"?>\n'
+            '<xliff version="1.2" xmlns="urn:oasis:names:tc:xliff:document:1.2">\n'
+            '  <file original="benchmark" source-language="en" target-language="cs" datatype="plaintext">\n'
+            '    <body>\n')
+    for e in entries:
+        f.write('      <trans-unit id=%s>\n' % quoteattr(e.key))
+        f.write('        <source>%s</source>\n' % escape(e.source))
+        if e.translation:
+            f.write('        <target state="translated">%s</target>\n' % escape(e.translation))
+        if e.comment:
+            f.write('        <note>%s</note>\n' % escape(e.comment))
+        f.write('      </trans-unit>\n')
+    f.write('    </body>\n  </file>\n</xliff>\n')
+
+
+def write_json(f, entries):
+    json.dump({e.key: e.translation for e in entries}, f, ensure_ascii=False, indent='\t')
+    f.write('\n')
+
+
+def write_ts(f, entries):
+    f.write('<?xml version="1.0" encoding="utf-8"?>\n<!DOCTYPE TS>\n'
+            '<TS version="2.1" language="cs" sourcelanguage="en">\n<context>\n    <name>Benchmark</name>\n')
+    for e in entries:
+        f.write('    <message%s>\n' % (' numerus="yes"' if e.plural else ''))
+        for ref in e.references:
+            filename, line = ref.rsplit(':', 1)
+            f.write('        <location filename=%s line="%s"/>\n' % (quoteattr(filename), line))
+        f.write('        <source>%s</source>\n' % escape(e.source))
+        if e.comment:
+            f.write('        <extracomment>%s</extracomment>\n' % escape(e.comment))
+        unfinished = '' if e.translation else ' type="unfinished"'
+        if e.plural:
+            f.write('        <translation%s>\n' % unfinished)
+            for _ in range(3):
+                f.write('            <numerusform>%s</numerusform>\n' % escape(e.translation))
+            f.write('        </translation>\n')
+        else:
+            f.write('        <translation%s>%s</translation>\n' % (unfinished, escape(e.translation)))
+        f.write('    </message>\n')
+    f.write('</context>\n</TS>\n')
+
+
+def write_resx(f, entries):
+    f.write('<?xml version="1.0" encoding="utf-8"?>\n<root>\n'
+            '  <resheader name="resmimetype">\n    <value>text/microsoft-resx</value>\n  </resheader>\n'
+            '  <resheader name="version">\n    <value>2.0</value>\n  </resheader>\n')
+    for e in entries:
+        f.write('  <data name=%s xml:space="preserve">\n' % quoteattr(e.key))
+        f.write('    <value>%s</value>\n' % escape(e.translation))
+        if e.comment:
+            f.write('    <comment>%s</comment>\n' % escape(e.comment))
+        f.write('  </data>\n')
+    f.write('</root>\n')
+
+
+def write_tmx(f, entries, languages):
+    f.write('<?xml version="1.0" encoding="UTF-8"?>\n<tmx version="1.4">\n'
+            '  <header creationtool="generate-benchmark-catalogs.py" creationtoolversion="1" segtype="sentence"'
+            ' o-tmf="benchmark" adminlang="en" srclang="en" datatype="plaintext"/>\n  <body>\n')
+    for e in entries:
+        if not e.translation:
+            continue
+        f.write('    <tu>\n      <tuv xml:lang="en"><seg>%s</seg></tuv>\n' % escape(e.source))
+        for i, lang in enumerate(languages):
+            f.write('      <tuv xml:lang="%s"><seg>%s %d</seg></tuv>\n' % (lang, escape(e.translation), i))
+        f.write('    </tu>\n')
+    f.write('  </body>\n</tmx>\n')
+
+
+def write_sources(outdir, entries):
+    """Writes C files using the entries' strings, grouped by their first reference.
+
+    Every 10th string is changed and every 15th is left out, so that updating
+    has something to merge.
+    """
+    files = {}
+    for index, e in enumerate(entries):
+        if index % 15 == 14:
+            continue
+        source = e.source + (' (changed)' if index % 10 == 9 else '')
+        if e.plural:
+            call = 'ngettext(%s, %s, n)' % (po_quote(source), po_quote(e.plural))
+        else:
+            call = '_(%s)' % po_quote(source)
+        filename = e.references[0].rsplit(':', 1)[0]
+        files.setdefault(filename, []).append(call)
+
+    for filename, calls in files.items():
+        path = os.path.join(outdir, filename)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, 'w', encoding='utf-8', newline='\n') as f:
+            f.write('void strings(int n)\n{\n')
+            for call in calls:
+                f.write('    use(%s);\n' % call)
+            f.write('}\n')
+
+
+WRITERS = {
+    'po':    ('%d.cs.po',   write_po),
+    'xliff': ('%d.cs.xlf',  write_xliff),
+    'json':  ('%d.cs.json', write_json),
+    'ts':    ('%d_cs.ts',   write_ts),
+    'resx':  ('%d.cs.resx', write_resx),
+    'tmx':   ('%d.tmx',     write_tmx),
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate synthetic catalogs for benchmarking.')
+    parser.add_argument('--sizes', default=','.join(str(x) for x in DEFAULT_SIZES),
+                        help='comma-separated numbers of entries (default: %(default)s)')
+    parser.add_argument('--formats', default=','.join(FORMATS),
+                        help='comma-separated formats to generate, also: %s (default: %%(default)s)' % ', '.join(TM_FORMATS))
+    parser.add_argument('--languages', type=int, default=1,
+                        help='number of target languages in TMX files, up to %d (default: %%(default)s)' % len(TMX_LANGUAGES))
+    parser.add_argument('--seed', type=int, default=42, help='random seed, for reproducible output')
+    parser.add_argument('--with-sources', action='store_true',
+                        help='also generate source code to update PO files from')
+    parser.add_argument('outdir', help='directory to write the files into')
+    args = parser.parse_args()
+
+    sizes = [int(x) for x in args.sizes.split(',')]
+    formats = args.formats.split(',')
+    for fmt in formats:
+        if fmt not in WRITERS:
+            sys.exit('unknown format "%s", must be one of: %s' % (fmt, ', '.join(FORMATS + TM_FORMATS)))
+    if not 1 <= args.languages <= len(TMX_LANGUAGES):
+        sys.exit('number of languages must be between 1 and %d' % len(TMX_LANGUAGES))
+    languages = TMX_LANGUAGES[:args.languages]
+
+    os.makedirs(args.outdir, exist_ok=True)
+    for size in sizes:
+        rnd = random.Random(args.seed)
+        entries = [Entry(rnd, i) for i in range(size)]
+        for fmt in formats:
+            pattern, writer = WRITERS[fmt]
+            filename = os.path.join(args.outdir, 'benchmark-' + pattern % size)
+            with open(filename, 'w', encoding='utf-8', newline='\n') as f:
+                if fmt in TM_FORMATS:
+                    writer(f, entries, languages)
+                elif fmt == 'po' and args.with_sources:
+                    sources_dir = 'benchmark-%d-sources' % size
+                    write_sources(os.path.join(args.outdir, sources_dir), entries)
+                    writer(f, entries, sources_dir)
+                else:
+                    writer(f, entries)
+            print(filename)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,446 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "batch.h"
+
+#include "cat_update.h"
+#include "catalog_po.h"
+#include "configuration.h"
+#include "errors.h"
+#include "json.h"
+#include "pretranslate.h"
+#include "str_helpers.h"
+#include "tm/tmx_io.h"
+#include "tm/transmem.h"
+#include "tracing.h"
+#include "utility.h"
+
+#include <wx/arrstr.h>
+#include <wx/datetime.h>
+#include <wx/filename.h>
+#include <wx/intl.h>
+#include <wx/log.h>
+#include <wx/numformatter.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <thread>
+
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+double MillisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+// Outcome of processing one file, reported in the timing output
+struct FileResult
+{
+    bool ok = false;
+    wxString error;
+    int pretranslated = 0;
+    int errors = 0, warnings = 0;
+    size_t memory = 0;  // memory used by the loaded catalog, see Catalog::GetMemoryUsage()
+    ordered_json timing = ordered_json::object();
+};
+
+
+// Runs @a step and records its duration as @a name in @a result
+template<typename F>
+auto TimedStep(FileResult& result, const char *name, F&& step) -> decltype(step())
+{
+    auto start = Clock::now();
+    struct Recorder
+    {
+        FileResult& result;
+        const char *name;
+        Clock::time_point start;
+        ~Recorder() { result.timing[name] = MillisecondsSince(start); }
+    } recorder{result, name, start};
+
+    return step();
+}
+
+
+FileResult ProcessFile(const BatchOptions& options, const wxString& filename)
+{
+    TRACE_SPAN("batch", "ProcessFile");
+
+    FileResult result;
+    const auto started = Clock::now();
+    const auto name = wxFileName(filename).GetFullName();
+
+    try
+    {
+        auto catalog = TimedStep(result, "load", [&]{ return Catalog::Create(filename); });
+        result.memory = catalog->GetMemoryUsage().Total();
+        bool modified = false;
+        bool validated = false;
+        Catalog::ValidationResults validation;
+
+        if (options.operations & BatchOptions::Update)
+        {
+            TimedStep(result, "update", [&]
+            {
+                auto merged = PerformUpdateFromSourcesSimple(catalog);
+                if (!merged)
+                    BOOST_THROW_EXCEPTION(Exception(_("Updating from sources failed.")));
+                merged.errors.log_all();
+                catalog = merged.updated_catalog;
+                modified = true;
+            });
+        }
+
+        if (options.operations & BatchOptions::PreTranslate)
+        {
+            result.pretranslated = TimedStep(result, "pretranslate", [&]
+            {
+                return PreTranslateCatalogSimple(catalog, PreTranslateOptions(PreTranslate_OnlyGoodQuality));
+            });
+            if (result.pretranslated)
+                modified = true;
+        }
+
+        if (modified || (options.operations & BatchOptions::Save))
+        {
+            TimedStep(result, "save", [&]
+            {
+                Catalog::CompilationStatus status;
+                if (!catalog->Save(filename, /*save_mo=*/false, validation, status))
+                    BOOST_THROW_EXCEPTION(Exception(wxString::Format(_(L"Couldn’t save file %s."), name)));
+                validated = true;
+            });
+        }
+
+        if (options.operations & BatchOptions::Compile)
+        {
+            auto po = std::dynamic_pointer_cast<POCatalog>(catalog);
+            if (po && po->HasCapability(Catalog::Cap::Translations))
+            {
+                TimedStep(result, "compile", [&]
+                {
+                    const wxString mo_file = wxFileName::StripExtension(filename) + ".mo";
+                    Catalog::CompilationStatus status;
+                    if (!po->CompileToMO(mo_file, validation, status))
+                        BOOST_THROW_EXCEPTION(Exception(wxString::Format(_(L"Couldn’t save file %s."), wxFileName(mo_file).GetFullName())));
+                    validated = true;
+                });
+            }
+        }
+
+        if ((options.operations & BatchOptions::Check) && !validated)
+        {
+            TimedStep(result, "check", [&]{ validation = catalog->Validate(); });
+        }
+
+        result.errors = validation.errors;
+        result.warnings = validation.warnings;
+        result.ok = (options.operations & BatchOptions::Check) ? validation.errors == 0 : true;
+
+        if (options.operations & BatchOptions::Check)
+        {
+            // Validation reports the issues, if any, as items' issues, log them here:
+            for (auto& item: catalog->items())
+            {
+                if (!item->HasIssue())
+                    continue;
+                auto issue = item->GetIssue();
+                auto text = wxString::Format("%s:%d: %s", name, item->GetLineNumber(), issue->message);
+                if (issue->severity == CatalogItem::Issue::Error)
+                    wxLogError("%s", text);
+                else
+                    wxLogWarning("%s", text);
+            }
+        }
+    }
+    catch (...)
+    {
+        result.ok = false;
+        result.error = DescribeCurrentException();
+        wxLogError("%s: %s", name, result.error);
+    }
+
+    result.timing["total"] = MillisecondsSince(started);
+    return result;
+}
+
+
+void WriteTiming(const BatchOptions& options, const ordered_json& timing)
+{
+    auto text = timing.dump(2) + "\n";
+    if (options.timingFile == "-")
+    {
+        std::cout << text;
+        std::cout.flush();
+        return;
+    }
+
+    std::ofstream f(options.timingFile.fn_str(), std::ios::binary | std::ios::trunc);
+    f << text;
+    if (!f)
+        wxLogError(_(L"Couldn’t save file %s."), options.timingFile);
+}
+
+
+// Parses BatchOptions::deleteTM
+TranslationMemory::EntriesFilter ParseTMFilter(const wxString& text)
+{
+    TranslationMemory::EntriesFilter filter;
+    for (auto& criterion: wxSplit(text, ','))
+    {
+        const auto key = criterion.BeforeFirst('=').Strip(wxString::both).Lower();
+        const auto value = criterion.AfterFirst('=').Strip(wxString::both);
+
+        if (key == "srclang" || key == "lang")
+        {
+            auto lang = Language::TryParseWithValidation(value.ToStdWstring());
+            if (!lang.IsValid())
+                BOOST_THROW_EXCEPTION(Exception(wxString::Format(_(L"Invalid language code “%s”."), value)));
+            (key == "srclang" ? filter.srclang : filter.lang) = lang;
+        }
+        else if (key == "from" || key == "to")
+        {
+            wxDateTime date;
+            if (!date.ParseISODate(value))
+                BOOST_THROW_EXCEPTION(Exception(wxString::Format(_(L"Invalid date “%s”, use YYYY-MM-DD format."), value)));
+            (key == "from" ? filter.createdFrom : filter.createdTo) = date.GetTicks();
+        }
+        else if (key == "batch" && !value.empty())
+        {
+            filter.importBatch = value.utf8_string();
+        }
+        else if (!criterion.Strip(wxString::both).empty())
+        {
+            BOOST_THROW_EXCEPTION(Exception(wxString::Format(_(L"Unknown translation memory filter “%s”."), criterion)));
+        }
+    }
+
+    // deleting everything by accident would be too easy otherwise:
+    if (filter.IsEmpty())
+        BOOST_THROW_EXCEPTION(Exception(_("Translation memory entries to delete must be specified.")));
+
+    return filter;
+}
+
+} // anonymous namespace
+
+
+int BatchOptions::ParseOperations(const wxString& list)
+{
+    int ops = 0;
+    for (auto& name: wxSplit(list, ','))
+    {
+        auto n = name.Strip(wxString::both).Lower();
+        if (n == "update")
+            ops |= Update;
+        else if (n == "pretranslate")
+            ops |= PreTranslate;
+        else if (n == "check")
+            ops |= Check;
+        else if (n == "compile")
+            ops |= Compile;
+        else if (n == "save")
+            ops |= Save;
+        else if (!n.empty())
+            BOOST_THROW_EXCEPTION(Exception(wxString::Format(_(L"Unknown batch operation “%s”."), n)));
+    }
+    return ops;
+}
+
+
+int RunBatch(const BatchOptions& options)
+{
+    const auto started = Clock::now();
+    bool failed = false;
+
+    ordered_json timing;
+
+    if (!options.importTM.empty())
+    {
+        TRACE_SPAN("batch", "ImportTM");
+        auto start = Clock::now();
+        try
+        {
+            int count;
+            std::string importBatch;
+            if (options.importTM.Lower().EndsWith(".tmx"))
+            {
+                std::ifstream f;
+                f.open(options.importTM.fn_str());
+                count = TMX::ImportFromFile(f, TranslationMemory::Get(), &importBatch);
+            }
+            else
+            {
+                auto cat = Catalog::Create(options.importTM);
+                auto tm = TranslationMemory::Get().GetWriter();
+                tm->Insert(cat);
+                tm->Commit();
+                count = cat->GetCount();
+            }
+            wxLogMessage(wxPLURAL("%s translation was imported.", "%s translations were imported.", count),
+                         wxNumberFormatter::ToString((long)count));
+            timing["import_tm"] = {{"file", options.importTM.utf8_string()}, {"count", count}, {"ms", MillisecondsSince(start)}};
+            if (!importBatch.empty())
+            {
+                // for removing the imported entries with --delete-tm, if they turn out to be bad:
+                wxLogMessage(_("Import batch ID: %s"), str::to_wx(importBatch));
+                timing["import_tm"]["batch"] = importBatch;
+            }
+        }
+        catch (...)
+        {
+            wxLogError("%s: %s", wxFileName(options.importTM).GetFullName(), DescribeCurrentException());
+            failed = true;
+        }
+    }
+
+    if (options.operations != 0 && !options.files.empty())
+    {
+        if ((options.operations & BatchOptions::PreTranslate) && !Config::UseTM())
+            wxLogWarning(_("Translation memory is disabled in preferences, files won't be pre-translated."));
+
+        const size_t count = options.files.size();
+        size_t jobs = options.jobs > 0 ? size_t(options.jobs) : size_t(std::max(1u, std::thread::hardware_concurrency()));
+        jobs = std::min(jobs, count);
+
+        // Each file is processed by a dedicated thread rather than a dispatch
+        // task, because the operations themselves use the background queue
+        // and wait for it; blocking all of its threads would deadlock them.
+        std::vector<FileResult> results(count);
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        for (size_t j = 0; j < jobs; j++)
+        {
+            workers.emplace_back([&]
+            {
+                for (size_t i = next++; i < count; i = next++)
+                    results[i] = ProcessFile(options, options.files[i]);
+            });
+        }
+        for (auto& w: workers)
+            w.join();
+
+        ordered_json files = ordered_json::array();
+        for (size_t i = 0; i < count; i++)
+        {
+            auto& r = results[i];
+            if (!r.ok)
+                failed = true;
+
+            ordered_json f;
+            f["file"] = options.files[i].utf8_string();
+            f["ok"] = r.ok;
+            if (!r.error.empty())
+                f["error"] = r.error.utf8_string();
+            if (options.operations & BatchOptions::PreTranslate)
+                f["pretranslated"] = r.pretranslated;
+            f["errors"] = r.errors;
+            f["warnings"] = r.warnings;
+            f["memory_bytes"] = r.memory;
+            f["ms"] = std::move(r.timing);
+            files.push_back(std::move(f));
+        }
+        timing["jobs"] = jobs;
+        timing["files"] = std::move(files);
+    }
+
+    std::optional<TranslationMemory::EntriesFilter> deleteFilter;
+    if (!options.deleteTM.empty())
+    {
+        try
+        {
+            deleteFilter = ParseTMFilter(options.deleteTM);
+        }
+        catch (...)
+        {
+            wxLogError("%s", DescribeCurrentException());
+            failed = true;
+        }
+    }
+
+    bool exportFailed = false;
+    if (!options.exportTM.empty() && (options.deleteTM.empty() || deleteFilter))
+    {
+        TRACE_SPAN("batch", "ExportTM");
+        auto start = Clock::now();
+        try
+        {
+            TempOutputFileFor tempfile(options.exportTM);
+            const bool compressed = options.exportTM.Lower().EndsWith(".gz");
+            {
+                std::ofstream f;
+                f.open(tempfile.FileName().fn_str(), compressed ? std::ios_base::binary : std::ios_base::out);
+                // when deleting, only the deleted entries are exported, as their backup:
+                TMX::ExportToFile(TranslationMemory::Get(), f, compressed, deleteFilter ? &*deleteFilter : nullptr);
+            }
+            if (!tempfile.Commit())
+                BOOST_THROW_EXCEPTION(Exception(wxString::Format(_(L"Couldn’t save file %s."), wxFileName(options.exportTM).GetFullName())));
+            timing["export_tm"] = {{"file", options.exportTM.utf8_string()}, {"ms", MillisecondsSince(start)}};
+        }
+        catch (...)
+        {
+            wxLogError("%s", DescribeCurrentException());
+            failed = true;
+            exportFailed = true;
+        }
+    }
+
+    // don't delete anything if its backup couldn't be made:
+    if (deleteFilter && !exportFailed)
+    {
+        TRACE_SPAN("batch", "DeleteTM");
+        auto start = Clock::now();
+        try
+        {
+            auto count = TranslationMemory::Get().DeleteEntries(*deleteFilter);
+            wxLogMessage(wxPLURAL("%s translation was deleted from translation memory.", "%s translations were deleted from translation memory.", (long)count),
+                         wxNumberFormatter::ToString((long)count));
+            timing["delete_tm"] = {{"count", count}, {"ms", MillisecondsSince(start)}};
+        }
+        catch (...)
+        {
+            wxLogError("%s", DescribeCurrentException());
+            failed = true;
+        }
+    }
+
+    timing["total_ms"] = MillisecondsSince(started);
+    if (auto peak = tracing::peak_memory_usage())
+        timing["peak_memory_bytes"] = peak;
+
+    if (!options.timingFile.empty())
+        WriteTiming(options, timing);
+
+    return failed ? 1 : 0;
+}
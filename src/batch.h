@@ -0,0 +1,105 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_batch_h
+#define Poedit_batch_h
+
+#include <wx/string.h>
+
+#include <vector>
+
+
+/**
+    Options for processing translation files without any UI.
+
+    This is used to implement the --batch command line mode, which runs
+    the same operations as the UI does on many files, e.g. in CI.
+ */
+struct BatchOptions
+{
+    /// Operations to perform on each file, in this order
+    enum Operation
+    {
+        Update       = 0x01,    ///< update from source code
+        PreTranslate = 0x02,    ///< pre-translate from TM
+        Check        = 0x04,    ///< validate translations and run QA checks
+        Compile      = 0x08,    ///< compile into MO files
+        Save         = 0x10     ///< save even if not modified, e.g. to measure saving
+    };
+
+    /// Combination of Operation values
+    int operations = 0;
+
+    /// Translation files to process
+    std::vector<wxString> files;
+
+    /// TMX or translation file to import into TM before processing files
+    wxString importTM;
+
+    /// TMX file to export TM into after processing files
+    wxString exportTM;
+
+    /**
+        Entries to delete from TM at the end, as comma-separated criteria:
+        srclang=CODE, lang=CODE, from=YYYY-MM-DD, to=YYYY-MM-DD (exclusive)
+        and batch=ID (as logged when importing).
+
+        If exportTM is set too, only these entries are exported into it,
+        before they are deleted, so that the deletion can be undone.
+     */
+    wxString deleteTM;
+
+    /// Number of files processed in parallel; 0 means number of cores
+    int jobs = 0;
+
+    /// If not empty, write timing information as JSON into this file ("-" for stdout)
+    wxString timingFile;
+
+    /// Does the command line ask for batch processing?
+    bool IsRequested() const
+        { return operations != 0 || !importTM.empty() || !exportTM.empty() || !deleteTM.empty(); }
+
+    /**
+        Parses comma-separated list of operation names ("update",
+        "pretranslate", "check", "compile", "save").
+
+        Throws on unknown names.
+     */
+    static int ParseOperations(const wxString& list);
+};
+
+
+/**
+    Performs batch processing described by @a options.
+
+    Errors are logged and the function returns process exit code: 0 on
+    success, 1 if processing of any file failed or found errors.
+
+    Must be called on a background thread, because some operations
+    need the main thread to be running its event loop.
+ */
+int RunBatch(const BatchOptions& options);
+
+#endif // Poedit_batch_h
@@ -0,0 +1,342 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "cache_registry.h"
+
+#include "concurrency.h"
+#include "configuration.h"
+
+#include <wx/log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__WXOSX__)
+    #include <dispatch/dispatch.h>
+#elif defined(__WXMSW__)
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <string.h>
+    #include <unistd.h>
+#endif
+
+
+namespace
+{
+
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<CacheRegistry::Cache*> caches;
+};
+
+Registry& GetRegistry()
+{
+    // intentionally never destroyed, because static caches unregister
+    // themselves during static destruction:
+    static auto registry = new Registry;
+    return *registry;
+}
+
+std::atomic<bool> gs_enforcementScheduled{false};
+
+
+// Evicts least recently used entries until the caches use at most @a target bytes.
+// Must be called with the registry's mutex locked.
+void EvictToSize(std::vector<CacheRegistry::Cache*>& caches, size_t target)
+{
+    for (;;)
+    {
+        size_t total = 0;
+        CacheRegistry::Timestamp oldest = CacheRegistry::NoEntries;
+        for (auto c: caches)
+        {
+            total += c->GetMemoryUsage();
+            oldest = std::min(oldest, c->GetOldestUse());
+        }
+        if (total <= target || oldest == CacheRegistry::NoEntries)
+            return;
+
+        // entries are only distinguished by the second of their last use, so
+        // evict all of the oldest ones at once, from all caches:
+        for (auto c: caches)
+            c->EvictUsedUntil(oldest);
+    }
+}
+
+size_t GetBudget()
+{
+    const long mb = Config::CachesMemoryBudgetMB();
+    return mb > 0 ? size_t(mb) * 1024 * 1024 : std::numeric_limits<size_t>::max();
+}
+
+
+#if defined(__WXOSX__)
+
+class MemoryPressureMonitor
+{
+public:
+    MemoryPressureMonitor()
+    {
+        auto source = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                             DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                             dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+        dispatch_source_set_event_handler(source, [source]{
+            auto flags = dispatch_source_get_data(source);
+            if (flags & DISPATCH_MEMORYPRESSURE_CRITICAL)
+                CacheRegistry::HandleMemoryPressure(CacheRegistry::Pressure::Critical);
+            else if (flags & DISPATCH_MEMORYPRESSURE_WARN)
+                CacheRegistry::HandleMemoryPressure(CacheRegistry::Pressure::Warning);
+        });
+        dispatch_resume(source);
+        m_source = source;
+    }
+
+    ~MemoryPressureMonitor()
+    {
+        // the handler (and the source it references) is released when cancelled:
+        dispatch_source_cancel(m_source);
+        m_source = nullptr;
+    }
+
+private:
+    dispatch_source_t m_source;
+};
+
+#elif defined(__WXMSW__)
+
+// The low memory notification stays signaled for as long as memory is low,
+// so after reacting to it, it is not checked again for this long:
+const DWORD LOW_MEMORY_RECHECK_MS = 30000;
+
+class MemoryPressureMonitor
+{
+public:
+    MemoryPressureMonitor()
+    {
+        m_stop = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        m_lowMemory = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+        if (m_stop && m_lowMemory)
+            m_thread = std::thread([this]{ Run(); });
+    }
+
+    ~MemoryPressureMonitor()
+    {
+        if (m_thread.joinable())
+        {
+            SetEvent(m_stop);
+            m_thread.join();
+        }
+        if (m_lowMemory)
+            CloseHandle(m_lowMemory);
+        if (m_stop)
+            CloseHandle(m_stop);
+    }
+
+private:
+    void Run()
+    {
+        HANDLE handles[2] = { m_stop, m_lowMemory };
+        while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+        {
+            CacheRegistry::HandleMemoryPressure(CacheRegistry::Pressure::Warning);
+            if (WaitForSingleObject(m_stop, LOW_MEMORY_RECHECK_MS) != WAIT_TIMEOUT)
+                break;
+        }
+    }
+
+    HANDLE m_stop = nullptr, m_lowMemory = nullptr;
+    std::thread m_thread;
+};
+
+#elif defined(__linux__)
+
+// Pressure stall information trigger: some tasks stalled waiting for memory
+// for 150ms within 2s, which is the shortest window unprivileged processes
+// may use:
+const char *PSI_TRIGGER = "some 150000 2000000";
+
+class MemoryPressureMonitor
+{
+public:
+    MemoryPressureMonitor()
+    {
+        // PSI is only available since Linux 4.20 and unprivileged triggers since 6.5:
+        m_psi = open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (m_psi < 0)
+            return;
+        if (write(m_psi, PSI_TRIGGER, strlen(PSI_TRIGGER) + 1) < 0 || pipe(m_stop) != 0)
+        {
+            wxLogTrace("poedit.caches", "memory pressure notifications not available: %s", strerror(errno));
+            close(m_psi);
+            m_psi = -1;
+            return;
+        }
+        m_thread = std::thread([this]{ Run(); });
+    }
+
+    ~MemoryPressureMonitor()
+    {
+        if (m_thread.joinable())
+        {
+            char c = 0;
+            if (write(m_stop[1], &c, 1) >= 0)
+                m_thread.join();
+            else
+                m_thread.detach();
+            close(m_stop[0]);
+            close(m_stop[1]);
+        }
+        if (m_psi >= 0)
+            close(m_psi);
+    }
+
+private:
+    void Run()
+    {
+        pollfd fds[2] = {{m_psi, POLLPRI, 0}, {m_stop[0], POLLIN, 0}};
+        for (;;)
+        {
+            if (poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            if (fds[1].revents)
+                break;
+            if (fds[0].revents & POLLERR)
+                break;  // monitoring is no longer possible
+            if (fds[0].revents & POLLPRI)
+                CacheRegistry::HandleMemoryPressure(CacheRegistry::Pressure::Warning);
+        }
+    }
+
+    int m_psi = -1;
+    int m_stop[2] = {-1, -1};
+    std::thread m_thread;
+};
+
+#else
+
+class MemoryPressureMonitor
+{
+    // not supported on this platform
+};
+
+#endif
+
+std::unique_ptr<MemoryPressureMonitor> gs_monitor;
+
+} // anonymous namespace
+
+
+void CacheRegistry::Register(Cache *cache)
+{
+    auto& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.caches.push_back(cache);
+}
+
+
+void CacheRegistry::Unregister(Cache *cache)
+{
+    auto& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.caches.erase(std::remove(r.caches.begin(), r.caches.end(), cache), r.caches.end());
+}
+
+
+CacheRegistry::Timestamp CacheRegistry::Now()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return Timestamp(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+
+void CacheRegistry::NotifyGrown()
+{
+    if (gs_enforcementScheduled.exchange(true))
+        return;
+
+    dispatch::on_main([]
+    {
+        gs_enforcementScheduled = false;
+        auto& r = GetRegistry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        EvictToSize(r.caches, GetBudget());
+    });
+}
+
+
+size_t CacheRegistry::GetMemoryUsage()
+{
+    auto& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    size_t total = 0;
+    for (auto c: r.caches)
+        total += c->GetMemoryUsage();
+    return total;
+}
+
+
+void CacheRegistry::HandleMemoryPressure(Pressure pressure)
+{
+    dispatch::on_main([pressure]
+    {
+        auto& r = GetRegistry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        size_t total = 0;
+        for (auto c: r.caches)
+            total += c->GetMemoryUsage();
+
+        wxLogTrace("poedit.caches", "memory pressure (%s), caches use %zu bytes",
+                   pressure == Pressure::Critical ? "critical" : "warning", total);
+
+        EvictToSize(r.caches, pressure == Pressure::Critical ? 0 : std::min(total / 2, GetBudget()));
+    });
+}
+
+
+void CacheRegistry::StartMonitoring()
+{
+    if (!gs_monitor)
+        gs_monitor = std::make_unique<MemoryPressureMonitor>();
+}
+
+
+void CacheRegistry::StopMonitoring()
+{
+    gs_monitor.reset();
+}
@@ -0,0 +1,116 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_cache_registry_h
+#define Poedit_cache_registry_h
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+
+/**
+    Central registry of in-memory caches, limiting the total memory they use.
+
+    Caches register themselves and report their size and when their least
+    recently used entry was last used. When their total exceeds the budget
+    (Config::CachesMemoryBudgetMB()) or when the OS reports memory pressure,
+    least recently used entries are evicted across all caches, regardless of
+    which one they are in.
+
+    Eviction is done on the main thread. Caches that are also used from other
+    threads must synchronize access themselves and must not call into the
+    registry, other than NotifyGrown(), while holding their locks.
+ */
+class CacheRegistry
+{
+public:
+    /// Time of an entry's last use, in seconds; see Now()
+    typedef uint32_t Timestamp;
+
+    /// Returned by Cache::GetOldestUse() when there are no entries
+    static const Timestamp NoEntries = std::numeric_limits<Timestamp>::max();
+
+    /**
+        Interface implemented by caches.
+
+        Implementations must call Register() at the end of their constructor
+        and Unregister() at the beginning of their destructor.
+     */
+    class Cache
+    {
+    public:
+        virtual ~Cache() {}
+
+        /// Returns approximate memory used by cached data, in bytes; should be cheap
+        virtual size_t GetMemoryUsage() const = 0;
+
+        /// Returns last use of the least recently used entry, or NoEntries
+        virtual Timestamp GetOldestUse() const = 0;
+
+        /// Evicts all entries last used at or before @a time
+        virtual void EvictUsedUntil(Timestamp time) = 0;
+    };
+
+    static void Register(Cache *cache);
+    static void Unregister(Cache *cache);
+
+    /// Returns current time for recording entries' use
+    static Timestamp Now();
+
+    /**
+        Tells the registry that a cache grew and the budget may be exceeded.
+
+        Cheap and may be called from any thread, the budget is enforced
+        asynchronously on the main thread.
+     */
+    static void NotifyGrown();
+
+    /// Returns total memory used by registered caches
+    static size_t GetMemoryUsage();
+
+    /// Severity of memory pressure, see HandleMemoryPressure()
+    enum class Pressure
+    {
+        Warning,
+        Critical
+    };
+
+    /**
+        Evicts cached data because the system is low on memory: the least
+        recently used half on Warning, everything on Critical.
+
+        May be called from any thread.
+     */
+    static void HandleMemoryPressure(Pressure pressure);
+
+    /// Starts listening to the OS' memory pressure notifications, where available
+    static void StartMonitoring();
+
+    /// Stops listening started by StartMonitoring()
+    static void StopMonitoring();
+};
+
+#endif // Poedit_cache_registry_h
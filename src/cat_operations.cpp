@@ -28,83 +28,179 @@
 #include "catalog_po.h"
 #include "concurrency.h"
 #include "progress.h"
+#include "tracing.h"
 
-#include <map>
-#include <set>
+#include <wx/filename.h>
+
+#include <algorithm>
 
 
 namespace
 {
 
-inline MergeStats::Key make_key_full(const CatalogItemPtr& i)
+inline uint64_t fingerprint_key(const wxString& str, const wxString& str_plural, const wxString& context, const wxString& sym_id)
 {
-    return {i->GetRawString(), i->GetRawPluralString(), i->GetContext(), i->GetRawSymbolicId()};
+    wxStringHash hash;
+    uint64_t h = 14695981039346656037ULL;
+    for (auto s: {&str, &str_plural, &context, &sym_id})
+        h = (h ^ (uint64_t)hash(*s)) * 1099511628211ULL;
+    return h;
 }
 
-template<auto MakeKey = make_key_full, typename TFunc>
-inline void build_item_keys(CatalogPtr cat, TFunc&& f)
+} // anonymous namespace
+
+
+MergeKeysIndex::MergeKeysIndex(CatalogPtr catalog) : m_catalog(catalog)
 {
-    for (auto& i: cat->items())
-    {
-        f(MakeKey(i), i);
-    }
+    BuildIndex();
+}
+
+
+MergeKeysIndex::MergeKeysIndex(std::vector<MergeStats::Key>&& keys) : m_keys(std::move(keys))
+{
+    BuildIndex();
 }
 
-template<auto MakeKey = make_key_full, typename T>
-inline void build_item_map(T& map, CatalogPtr cat)
+
+void MergeKeysIndex::BuildIndex()
 {
-    build_item_keys<MakeKey>(cat, [&](auto&& key, CatalogItemPtr i){ map.emplace(key, i); });
+    const size_t count = m_catalog ? m_catalog->items().size() : m_keys.size();
+    m_index.resize(count);
+    for (size_t i = 0; i < count; i++)
+        m_index[i] = {fingerprint_key(Str(i), StrPlural(i), Context(i), SymId(i)), i};
+    std::sort(m_index.begin(), m_index.end());
 }
 
-template<auto MakeKey = make_key_full, typename T>
-inline void build_item_set(T& map, CatalogPtr cat)
+
+bool MergeKeysIndex::SameKey(size_t i, const MergeKeysIndex& other, size_t j) const
 {
-    build_item_keys<MakeKey>(cat, [&](auto&& key, CatalogItemPtr){ map.insert(key); });
+    return Str(i) == other.Str(j) &&
+           StrPlural(i) == other.StrPlural(j) &&
+           Context(i) == other.Context(j) &&
+           SymId(i) == other.SymId(j);
 }
 
-} // anonymous namespace
+
+MergeStats::Key MergeKeysIndex::KeyAt(size_t i) const
+{
+    return {Str(i), StrPlural(i), Context(i), SymId(i)};
+}
+
+
+void MergeKeysIndex::Difference(const MergeKeysIndex& other, std::vector<MergeStats::Key>& into) const
+{
+    auto byFingerprint = [](const Entry& a, const Entry& b){ return a.first < b.first; };
+
+    const size_t first = into.size();
+    for (auto i = m_index.begin(); i != m_index.end(); ++i)
+    {
+        // report duplicate keys only once:
+        bool duplicate = false;
+        for (auto prev = i; prev != m_index.begin() && (prev - 1)->first == i->first; --prev)
+        {
+            if (SameKey((prev - 1)->second, *this, i->second))
+            {
+                duplicate = true;
+                break;
+            }
+        }
+        if (duplicate)
+            continue;
+
+        auto range = std::equal_range(other.m_index.begin(), other.m_index.end(), *i, byFingerprint);
+        bool found = false;
+        for (auto o = range.first; o != range.second && !found; ++o)
+            found = SameKey(i->second, other, o->second);
+
+        if (!found)
+            into.push_back(KeyAt(i->second));
+    }
+
+    // only the differences are sorted, for presentation:
+    std::sort(into.begin() + first, into.end());
+}
 
 
 void ComputeMergeStats(MergeStats& r, CatalogPtr po, CatalogPtr refcat)
 {
     Progress progress(2);
 
+    // First index all strings from both sides by fingerprints of their keys,
+    // then diff them. Run the two sides in parallel for speed up on large files.
+
+    std::unique_ptr<MergeKeysIndex> indexThis, indexRef;
+
+    // one task for each side:
+    dispatch::parallel_options sides;
+    sides.chunk_size = 1;
+
+    dispatch::parallel_for_chunked(2, [&](size_t side, size_t)
+    {
+        if (side == 0)
+            indexThis.reset(new MergeKeysIndex(po));
+        else
+            indexRef.reset(new MergeKeysIndex(refcat));
+    }, sides);
+    progress.increment();
+
+    ComputeMergeStats(r, *indexThis, *indexRef);
+    progress.increment();
+}
+
+
+void ComputeMergeStats(MergeStats& r, const MergeKeysIndex& catalog, const MergeKeysIndex& reference)
+{
     r.added.clear();
     r.removed.clear();
 
-    // First collect all strings from both sides, then diff the sets.
-    // Run the two sides in parallel for speed up on large files.
+    // one task for each side:
+    dispatch::parallel_options sides;
+    sides.chunk_size = 1;
+
+    dispatch::parallel_for_chunked(2, [&](size_t side, size_t)
+    {
+        if (side == 0)
+            catalog.Difference(reference, r.removed);
+        else
+            reference.Difference(catalog, r.added);
+    }, sides);
+}
 
-    std::set<MergeStats::Key> strsThis, strsRef;
 
-    auto collect1 = dispatch::async([&]{ build_item_set(strsThis, po); });
-    auto collect2 = dispatch::async([&]{ build_item_set(strsRef, refcat); });
+MergePreview PreviewMergeWithReference(CatalogPtr catalog, const wxString& reference_file)
+{
+    TRACE_SPAN("update", "PreviewMergeWithReference");
 
-    collect1.get();
-    collect2.get();
-    progress.increment();
+    MergePreview preview;
 
-    auto add1 = dispatch::async([&]
+    // index the catalog while the reference file is being read:
+    auto catalogIndex = dispatch::async([catalog]{ return std::make_shared<MergeKeysIndex>(catalog); });
+
+    std::unique_ptr<MergeKeysIndex> referenceIndex;
+
+    wxString ext;
+    wxFileName::SplitPath(reference_file, nullptr, nullptr, &ext);
+    if (POCatalog::CanLoadFile(ext))
     {
-        for (auto& i: strsThis)
+        std::vector<MergeStats::Key> keys;
+        auto ok = POCatalog::ScanKeys(reference_file, [&](const wxString& msgid, const wxString& msgid_plural, const wxString& context)
         {
-            if (strsRef.find(i) == strsRef.end())
-                r.removed.push_back(i);
-        }
-    });
+            keys.emplace_back(msgid, msgid_plural, context);
+        });
+        if (ok)
+            referenceIndex.reset(new MergeKeysIndex(std::move(keys)));
+    }
 
-    auto add2 = dispatch::async([&]
+    if (!referenceIndex)
     {
-        for (auto& i: strsRef)
-        {
-            if (strsThis.find(i) == strsThis.end())
-                r.added.push_back(i);
-        }
-    });
+        // not a gettext file or couldn't be scanned, load it fully:
+        referenceIndex.reset(new MergeKeysIndex(Catalog::Create(reference_file, Catalog::CreationFlag_IgnoreTranslations)));
+    }
 
-    add1.get();
-    add2.get();
-    progress.increment();
+    preview.catalogIndex = catalogIndex.get();
+    ComputeMergeStats(preview.stats, *preview.catalogIndex, *referenceIndex);
+
+    return preview;
 }
 
 
@@ -72,6 +72,84 @@ struct MergeStats
 };
 
 
+/// Key identifying items for the purpose of merging.
+inline MergeStats::Key make_key_full(const CatalogItemPtr& i)
+{
+    return {i->GetRawString(), i->GetRawPluralString(), i->GetContext(), i->GetRawSymbolicId()};
+}
+
+/// Calls @a f with the key and item for every item in @a cat.
+template<auto MakeKey = make_key_full, typename TFunc>
+inline void build_item_keys(const Catalog& cat, TFunc&& f)
+{
+    for (auto& i: cat.items())
+    {
+        f(MakeKey(i), i);
+    }
+}
+
+/// Fills key->item map with @a cat's items (first item wins for duplicate keys).
+template<auto MakeKey = make_key_full, typename T>
+inline void build_item_map(T& map, const Catalog& cat)
+{
+    build_item_keys<MakeKey>(cat, [&](auto&& key, CatalogItemPtr i){ map.emplace(key, i); });
+}
+
+/// Fills set with keys of @a cat's items.
+template<auto MakeKey = make_key_full, typename T>
+inline void build_item_set(T& map, const Catalog& cat)
+{
+    build_item_keys<MakeKey>(cat, [&](auto&& key, CatalogItemPtr){ map.insert(key); });
+}
+
+
+/**
+    Index of merge keys (see make_key_full()) of catalog's items by their
+    fingerprints, used to quickly determine differences between catalogs.
+
+    The index can be built either from catalog's items or from just the keys,
+    e.g. when scanning a reference file without fully loading it. Full keys
+    are only compared for entries with the same fingerprint.
+ */
+class MergeKeysIndex
+{
+public:
+    /// Indexes @a catalog's items; the catalog must not be modified while the index is used.
+    explicit MergeKeysIndex(CatalogPtr catalog);
+
+    /// Indexes @a keys directly, without any catalog
+    explicit MergeKeysIndex(std::vector<MergeStats::Key>&& keys);
+
+    /// Number of indexed entries, including duplicates
+    size_t size() const { return m_index.size(); }
+
+    /**
+        Appends keys present in this index, but not in @a other, to @a into.
+
+        Duplicate keys are only reported once and the output is sorted.
+     */
+    void Difference(const MergeKeysIndex& other, std::vector<MergeStats::Key>& into) const;
+
+private:
+    const wxString& Str(size_t i) const { return m_catalog ? m_catalog->items()[i]->GetRawString() : m_keys[i].str; }
+    const wxString& StrPlural(size_t i) const { return m_catalog ? m_catalog->items()[i]->GetRawPluralString() : m_keys[i].str_plural; }
+    const wxString& Context(size_t i) const { return m_catalog ? m_catalog->items()[i]->GetContext() : m_keys[i].context; }
+    wxString SymId(size_t i) const { return m_catalog ? m_catalog->items()[i]->GetRawSymbolicId() : m_keys[i].sym_id; }
+
+    bool SameKey(size_t i, const MergeKeysIndex& other, size_t j) const;
+    MergeStats::Key KeyAt(size_t i) const;
+
+    void BuildIndex();
+
+    // fingerprint and position in items or keys, sorted by the fingerprint
+    typedef std::pair<uint64_t, size_t> Entry;
+
+    CatalogPtr m_catalog;
+    std::vector<MergeStats::Key> m_keys;
+    std::vector<Entry> m_index;
+};
+
+
 /// Resulting data from a merge operation.
 struct MergeResult
 {
@@ -88,6 +166,30 @@ struct MergeResult
  */
 extern void ComputeMergeStats(MergeStats& r, CatalogPtr catalog, CatalogPtr reference);
 
+/// Calculates the difference like above, using already built indexes of both sides.
+extern void ComputeMergeStats(MergeStats& r, const MergeKeysIndex& catalog, const MergeKeysIndex& reference);
+
+
+/// Result of PreviewMergeWithReference()
+struct MergePreview
+{
+    /// Added and removed strings; the errors are not filled in.
+    MergeStats stats;
+
+    /// Index of the catalog's keys, for reuse when computing stats of the actual merge.
+    std::shared_ptr<MergeKeysIndex> catalogIndex;
+};
+
+/**
+    Quickly determines strings that merging @a catalog with @a reference_file
+    would add or remove, without loading the reference file or merging.
+
+    Only the keys of the reference's entries are read if it is a PO or POT
+    file, other files are loaded. The result is the same as obtained from
+    ComputeMergeStats() with the loaded file.
+ */
+extern MergePreview PreviewMergeWithReference(CatalogPtr catalog, const wxString& reference_file);
+
 
 /**
     Merges catalog with a reference catalog, updating catalog with new strings
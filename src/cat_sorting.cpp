@@ -26,12 +26,22 @@
 
 #include "cat_sorting.h"
 
+#include "concurrency.h"
 #include "str_helpers.h"
 
 #include <wx/config.h>
 #include <wx/log.h>
 
 
+namespace
+{
+
+// Number of items processed by a single task when computing sort keys
+const size_t SORT_KEYS_CHUNK_SIZE = 1024;
+
+} // anonymous namespace
+
+
 /*static*/ SortOrder SortOrder::Default()
 {
     SortOrder order;
@@ -98,77 +108,131 @@ CatalogItemsComparator::CatalogItemsComparator(const Catalog& catalog, const Sor
             break;
     }
 
-    // Prepare cache for faster comparison. ICU uses UTF-16 internally, we can significantly
-    // speed up comparisons by doing string conversion in advance, in O(n) time and space, if
-    // the platform's native representation is UTF-32 or -8 (which it is on non-Windows).
-    // Moreover, the additional processing of removing accelerators is also done only once
-    // on all platforms, resulting in massive speedups on Windows too.
+    // Status flags are read from the catalog's dense table instead of
+    // dereferencing items in every comparison:
+    if (m_order.errorsFirst || m_order.untransFirst)
+        m_status = catalog.GetItemsStatus();
+
+    // Prepare collation sort keys for faster comparison. Computing them is done in O(n)
+    // time and space (and in parallel), instead of running the collator in each of the
+    // O(n log n) comparisons, which then only need to compare bytes. Moreover, the additional
+    // processing of removing accelerators is also done only once.
+    auto& items = m_catalog.items();
+    const size_t count = items.size();
+    const size_t chunks = (count + SORT_KEYS_CHUNK_SIZE - 1) / SORT_KEYS_CHUNK_SIZE;
+
+    const bool keysForContext = m_order.groupByContext;
+    const bool keysForSource = m_order.by == SortOrder::By_Source;
+    const bool keysForTranslation = m_order.by == SortOrder::By_Translation;
+
+    if (keysForSource || keysForTranslation)
+        m_sortKeys.resize(count);
+    if (keysForContext)
+        m_contextSortKeys.resize(count);
+
+    if (!keysForSource && !keysForTranslation && !keysForContext)
+        return;
+
+    dispatch::parallel_for(chunks, [&](size_t n)
+    {
+        const size_t end = std::min((n + 1) * SORT_KEYS_CHUNK_SIZE, count);
+        for (size_t i = n * SORT_KEYS_CHUNK_SIZE; i < end; i++)
+        {
+            auto& item = *items[i];
+            if (keysForSource)
+                m_sortKeys[i] = ConvertToSortKey(item.GetString());
+            else if (keysForTranslation)
+                m_sortKeys[i] = ConvertToSortKey(item.GetTranslation());
+
+            // we don't want to apply translation string pre-processing to contexts
+            if (keysForContext && item.HasContext())
+                m_contextSortKeys[i] = ConvertContextToSortKey(item.GetContext());
+        }
+    });
+}
+
+
+void CatalogItemsComparator::UpdateItem(int i)
+{
+    auto& item = Item(i);
+
+    if (!m_status.empty())
+        m_status[i] = item.GetStatusFlags();
+
     switch (m_order.by)
     {
         case SortOrder::By_Source:
-            m_sortKeys.reserve(m_catalog.GetCount());
-            for (auto& i: m_catalog.items())
-                m_sortKeys.push_back(ConvertToSortKey(i->GetString()));
+            m_sortKeys[i] = ConvertToSortKey(item.GetString());
             break;
-
         case SortOrder::By_Translation:
-            m_sortKeys.reserve(m_catalog.GetCount());
-            for (auto& i: m_catalog.items())
-                m_sortKeys.push_back(ConvertToSortKey(i->GetTranslation()));
+            m_sortKeys[i] = ConvertToSortKey(item.GetTranslation());
             break;
-
         case SortOrder::By_FileOrder:
             break;
     }
+
+    if (m_order.groupByContext)
+        m_contextSortKeys[i] = item.HasContext() ? ConvertContextToSortKey(item.GetContext()) : std::string();
 }
 
 
 bool CatalogItemsComparator::operator()(int i, int j) const
 {
-    const CatalogItem& a = Item(i);
-    const CatalogItem& b = Item(j);
-
-    if ( m_order.errorsFirst )
+    if ( m_order.errorsFirst || m_order.untransFirst )
     {
-        // hard errors always go first:
-        if ( a.HasError() && !b.HasError() )
-            return true;
-        else if ( !a.HasError() && b.HasError() )
-            return false;
+        const uint8_t a = m_status[i];
+        const uint8_t b = m_status[j];
 
-        // warnings are more nuanced and should only be considered on non-fuzzy
-        // entries (see https://github.com/vslavik/poedit/issues/611 for discussion):
-        auto const a_shouldWarn = a.HasIssue() && !a.IsFuzzy();
-        auto const b_shouldWarn = b.HasIssue() && !b.IsFuzzy();
-        if ( a_shouldWarn && !b_shouldWarn )
-            return true;
-        else if ( !a_shouldWarn && b_shouldWarn )
-            return false;
-    }
+        if ( m_order.errorsFirst )
+        {
+            // hard errors always go first:
+            const bool a_error = a & CatalogItem::Status_Error;
+            const bool b_error = b & CatalogItem::Status_Error;
+            if ( a_error && !b_error )
+                return true;
+            else if ( !a_error && b_error )
+                return false;
 
-    if ( m_order.untransFirst )
-    {
-        if ( !a.IsTranslated() && b.IsTranslated() )
-            return true;
-        else if ( a.IsTranslated() && !b.IsTranslated() )
-            return false;
+            // warnings are more nuanced and should only be considered on non-fuzzy
+            // entries (see https://github.com/vslavik/poedit/issues/611 for discussion):
+            auto const a_shouldWarn = (a & CatalogItem::Status_Issue) && !(a & CatalogItem::Status_Fuzzy);
+            auto const b_shouldWarn = (b & CatalogItem::Status_Issue) && !(b & CatalogItem::Status_Fuzzy);
+            if ( a_shouldWarn && !b_shouldWarn )
+                return true;
+            else if ( !a_shouldWarn && b_shouldWarn )
+                return false;
+        }
 
-        if ( a.IsFuzzy() && !b.IsFuzzy() )
-            return true;
-        else if ( !a.IsFuzzy() && b.IsFuzzy() )
-            return false;
+        if ( m_order.untransFirst )
+        {
+            const bool a_trans = a & CatalogItem::Status_Translated;
+            const bool b_trans = b & CatalogItem::Status_Translated;
+            if ( !a_trans && b_trans )
+                return true;
+            else if ( a_trans && !b_trans )
+                return false;
+
+            const bool a_fuzzy = a & CatalogItem::Status_Fuzzy;
+            const bool b_fuzzy = b & CatalogItem::Status_Fuzzy;
+            if ( a_fuzzy && !b_fuzzy )
+                return true;
+            else if ( !a_fuzzy && b_fuzzy )
+                return false;
+        }
     }
 
     if ( m_order.groupByContext )
     {
+        const CatalogItem& a = Item(i);
+        const CatalogItem& b = Item(j);
+
         if ( a.HasContext() && !b.HasContext() )
             return true;
         else if ( !a.HasContext() && b.HasContext() )
             return false;
         else if ( a.HasContext() && b.HasContext() )
         {
-            // we don't want to apply translation string pre-processing to contexts, use collator directly
-            auto r = m_collator->compare(a.GetContext(), b.GetContext());
+            auto r = unicode::Collator::compare_sort_keys(m_contextSortKeys[i], m_contextSortKeys[j]);
             if ( r != 0 )
                 return r < 0;
         }
@@ -184,7 +248,7 @@ bool CatalogItemsComparator::operator()(int i, int j) const
         case SortOrder::By_Source:
         case SortOrder::By_Translation:
         {
-            auto r = m_collator->compare(m_sortKeys[i], m_sortKeys[j]);
+            auto r = unicode::Collator::compare_sort_keys(m_sortKeys[i], m_sortKeys[j]);
             if ( r != 0 )
                 return r < 0;
             break;
@@ -196,3 +260,92 @@ bool CatalogItemsComparator::operator()(int i, int j) const
     // ordering.
     return i < j;
 }
+
+
+void ItemsFilter::SetText(const wxString& text)
+{
+    m_text = text;
+    m_textIsAscii = unicode::is_ascii(text);
+    if (m_textIsAscii)
+    {
+        m_foldedText = text;
+        unicode::ascii_fold_case_inplace(m_foldedText);
+    }
+    else
+    {
+        m_foldedText = unicode::fold_case(text);
+    }
+}
+
+
+bool ItemsFilter::ContainsText(const wxString& str, const wxString& folded) const
+{
+    if (m_textIsAscii && unicode::is_ascii(str))
+    {
+        return unicode::ascii_find_nocase(str, m_foldedText) != std::wstring::npos;
+    }
+    else
+    {
+        return folded.find(m_foldedText) != wxString::npos;
+    }
+}
+
+
+bool ItemsFilter::Matches(const CatalogItem& item, uint8_t status) const
+{
+    if (!MatchesIgnoringReferenceFile(item, status))
+        return false;
+
+    if (!m_referenceFile.empty())
+    {
+        for (auto& ref: item.GetReferences())
+        {
+            wxString file;
+            int line;
+            CatalogReferencesIndex::ParseReference(ref, file, line);
+            if (file == m_referenceFile)
+                return true;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+
+bool ItemsFilter::MatchesIgnoringReferenceFile(const CatalogItem& item, uint8_t status) const
+{
+    if (m_status != Status_Any)
+    {
+        const bool matches = ((m_status & Status_Untranslated) && !(status & CatalogItem::Status_Translated)) ||
+                             ((m_status & Status_Fuzzy) && (status & CatalogItem::Status_Fuzzy)) ||
+                             ((m_status & Status_Errors) && (status & CatalogItem::Status_Error));
+        if (!matches)
+            return false;
+    }
+
+    if (!m_text.empty())
+    {
+        // folded texts are cached in the item, so refiltering is cheap:
+        auto folded = item.GetFoldedTexts();
+        bool found = ContainsText(item.GetString(), folded->string) ||
+                     (item.HasPlural() && ContainsText(item.GetPluralString(), folded->pluralString)) ||
+                     (item.HasContext() && ContainsText(item.GetContext(), folded->context));
+        if (!found)
+        {
+            auto& translations = item.GetTranslations();
+            for (size_t i = 0; i < translations.size() && i < folded->translations.size(); i++)
+            {
+                if (ContainsText(translations[i], folded->translations[i]))
+                {
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found)
+            return false;
+    }
+
+    return true;
+}
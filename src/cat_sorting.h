@@ -60,6 +60,66 @@ struct SortOrder
 
     /// Do entries with errors go first?
     bool errorsFirst;
+
+    /// Can editing an entry change its position in this order?
+    bool DependsOnTranslations() const { return by == By_Translation || untransFirst || errorsFirst; }
+};
+
+
+/**
+    Restriction of the list to only some items.
+
+    Items are shown if they match all of the active criteria; with no active
+    criteria, all items are shown.
+ */
+class ItemsFilter
+{
+public:
+    enum Status
+    {
+        Status_Any          = 0,
+        Status_Untranslated = 1,
+        Status_Fuzzy        = 2,
+        Status_Errors       = 4
+    };
+
+    /// Show only items with any of the given statuses (bitmask of Status values)
+    int GetStatus() const { return m_status; }
+    void SetStatus(int status) { m_status = status; }
+
+    /// Show only items containing this text in source, translation or context (case-insensitively)
+    const wxString& GetText() const { return m_text; }
+    void SetText(const wxString& text);
+
+    /// Show only items referenced from given source file
+    const wxString& GetReferenceFile() const { return m_referenceFile; }
+    void SetReferenceFile(const wxString& file) { m_referenceFile = file; }
+
+    /// Does the filter exclude anything at all?
+    bool IsActive() const { return m_status != Status_Any || !m_text.empty() || !m_referenceFile.empty(); }
+
+    /// Should the item be shown? Thread-safe.
+    bool Matches(const CatalogItem& item) const { return Matches(item, item.GetStatusFlags()); }
+
+    /// Like Matches(), using already known CatalogItem::GetStatusFlags() of the item.
+    bool Matches(const CatalogItem& item, uint8_t status) const;
+
+    /**
+        Like Matches(), but doesn't check GetReferenceFile().
+
+        Use when it is already known that the item is referenced from the file,
+        e.g. from CatalogReferencesIndex; checking items' references is slow.
+     */
+    bool MatchesIgnoringReferenceFile(const CatalogItem& item, uint8_t status) const;
+
+private:
+    // @a folded is @a str case-folded, see CatalogItem::GetFoldedTexts()
+    bool ContainsText(const wxString& str, const wxString& folded) const;
+
+    int m_status = Status_Any;
+    wxString m_text, m_foldedText;
+    bool m_textIsAscii = false;
+    wxString m_referenceFile;
 };
 
 
@@ -79,43 +139,47 @@ public:
 
     bool operator()(int i, int j) const;
 
+    /// Updates cached data for i-th item after it was modified.
+    void UpdateItem(int i);
+
 protected:
     const CatalogItem& Item(int i) const { return *m_catalog[i]; }
 
-    // Pre-process given string and return it in a form efficient for comparing
-    // with ICU collator. This does two things:
-    //  1. Converts to UTF-16 (matters on non-Windows platforms where wchar_t is UTF-32)
-    //  2. Perform substitution of accelerator characters in the string
-    static str::UCharBuffer ConvertToSortKey(const wxString& a)
+    // Pre-process given string and return its collation sort key, which can
+    // be compared much faster than the string itself. Accelerator characters
+    // are removed from the string first.
+    std::string ConvertToSortKey(const wxString& a) const
     {
+        // called for every item, possibly from multiple threads, so reuse buffers:
+        static thread_local str::UCharScratchBuffer s_buffer;
+
         if (a.find_first_of(L"&_") == wxString::npos)
         {
-            return str::to_icu(a);
+            return m_collator->sort_key(str::to_icu(a, s_buffer));
         }
         else
         {
-            wxString a_(a);
-            a_.Replace("&", "");
-            a_.Replace("_", "");
-
-            auto buf = str::to_icu(a_);
-            // on Windows to_icu() returns shallow view of the string, we need to make
-            // a deep copy because a_ is a local temporary variable:
-            buf.ensure_owned();
-            return buf;
+            static thread_local wxString s_stripped;
+            s_stripped = a;
+            s_stripped.Replace("&", "");
+            s_stripped.Replace("_", "");
+            return m_collator->sort_key(str::to_icu(s_stripped, s_buffer));
         }
     }
 
-    static str::UCharBuffer ConvertToSortKey(const wxString&& a)
-	{
-		return std::move(ConvertToSortKey(a).ensure_owned());
-	}
+    std::string ConvertContextToSortKey(const wxString& ctxt) const
+    {
+        static thread_local str::UCharScratchBuffer s_buffer;
+        return m_collator->sort_key(str::to_icu(ctxt, s_buffer));
+    }
 
 private:
     const Catalog& m_catalog;
     SortOrder m_order;
     std::unique_ptr<unicode::Collator> m_collator;
-    std::vector<str::UCharBuffer> m_sortKeys;
+    std::vector<std::string> m_sortKeys;
+    std::vector<std::string> m_contextSortKeys;
+    std::vector<uint8_t> m_status;
 };
 
 
@@ -27,11 +27,14 @@
 
 #include "catalog_po.h"
 #include "colorscheme.h"
+#include "configuration.h"
 #include "custom_notebook.h"
 #include "errors.h"
 #include "extractors/extractor.h"
 #include "hidpi.h"
+#include "pretranslate.h"
 #include "progress_ui.h"
+#include "tracing.h"
 #include "utility.h"
 
 #include <wx/artprov.h>
@@ -63,6 +66,17 @@ inline auto variant_vector(std::initializer_list<wxVariant>&& init)
 
 
 
+template<typename T>
+void SetupSummaryList(T *list)
+{
+    list->SetWindowVariant(wxWINDOW_VARIANT_SMALL);
+#ifdef __WXOSX__
+    ((NSTableView*)[((NSScrollView*)list->GetHandle()) documentView]).style = NSTableViewStyleFullWidth;
+    list->SetRowHeight(PX(20));
+#endif
+}
+
+
 class SummaryList : public wxDataViewListCtrl
 {
 public:
@@ -70,15 +84,52 @@ public:
         : wxDataViewListCtrl(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize,
                              flags | wxDV_ROW_LINES | wxDV_VARIABLE_LINE_HEIGHT | wxBORDER_NONE)
     {
-        SetWindowVariant(wxWINDOW_VARIANT_SMALL);
-#ifdef __WXOSX__
-        ((NSTableView*)[((NSScrollView*)GetHandle()) documentView]).style = NSTableViewStyleFullWidth;
-        SetRowHeight(PX(20));
-#endif
+        SetupSummaryList(this);
     }
 };
 
 
+/// List of added or removed strings; uses a virtual model, because there may be very many of them.
+class SummaryStringsList : public wxDataViewCtrl
+{
+public:
+    SummaryStringsList(wxWindow *parent, const wxString& title, const std::vector<MergeStats::Key>& strings)
+        : wxDataViewCtrl(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize,
+                         wxDV_NO_HEADER | wxDV_ROW_LINES | wxBORDER_NONE)
+    {
+        SetupSummaryList(this);
+
+        wxObjectDataPtr<Model> model(new Model(strings));
+        AssociateModel(model.get());
+
+        AppendTextColumn(title, 0, wxDATAVIEW_CELL_INERT, wxCOL_WIDTH_AUTOSIZE);
+    }
+
+private:
+    class Model : public wxDataViewVirtualListModel
+    {
+    public:
+        Model(const std::vector<MergeStats::Key>& strings)
+            : wxDataViewVirtualListModel((unsigned)strings.size()), m_strings(strings)
+        {}
+
+        unsigned int GetColumnCount() const override { return 1; }
+        wxString GetColumnType(unsigned int) const override { return "string"; }
+
+        void GetValueByRow(wxVariant& variant, unsigned row, unsigned) const override
+        {
+            // formatted lazily, only for rows that are actually shown:
+            variant = m_strings[row].to_string();
+        }
+
+        bool SetValueByRow(const wxVariant&, unsigned, unsigned) override { return false; }
+
+    private:
+        std::vector<MergeStats::Key> m_strings;
+    };
+};
+
+
 /// This class provides simple dialog that displays list of changes made in the catalog.
 class MergeSummaryDialog : public wxDialog
 {
@@ -188,28 +239,14 @@ void MergeSummaryDialog::TransferTo(const MergeStats& r)
 
     if (!r.added.empty())
     {
-        auto list = new SummaryList(m_notebook, wxDV_NO_HEADER);
-        m_notebook->AddPage(list, MSW_OR_OTHER(_("New strings"), _("New Strings")));
-
-        list->AppendTextColumn(MSW_OR_OTHER(_("New strings"), _("New Strings")), wxDATAVIEW_CELL_INERT, wxCOL_WIDTH_AUTOSIZE);
-
-        for (auto& s: r.added)
-        {
-            list->AppendItem(variant_vector({s.to_string()}));
-        }
+        auto title = MSW_OR_OTHER(_("New strings"), _("New Strings"));
+        m_notebook->AddPage(new SummaryStringsList(m_notebook, title, r.added), title);
     }
 
     if (!r.removed.empty())
     {
-        auto list = new SummaryList(m_notebook, wxDV_NO_HEADER);
-        m_notebook->AddPage(list, MSW_OR_OTHER(_("Removed strings"), _("Removed Strings")));
-
-        list->AppendTextColumn(MSW_OR_OTHER(_("Removed strings"), _("Removed Strings")), wxDATAVIEW_CELL_INERT, wxCOL_WIDTH_AUTOSIZE);
-
-        for (auto& s: r.removed)
-        {
-            list->AppendItem(variant_vector({s.to_string()}));
-        }
+        auto title = MSW_OR_OTHER(_("Removed strings"), _("Removed Strings"));
+        m_notebook->AddPage(new SummaryStringsList(m_notebook, title, r.removed), title);
     }
 }
 
@@ -223,6 +260,7 @@ struct InterimResults
 
 InterimResults ExtractPOTFromSources(CatalogPtr catalog)
 {
+    TRACE_SPAN("update", "ExtractPOTFromSources");
     auto po = std::dynamic_pointer_cast<POCatalog>(catalog);
     if (!po)
         BOOST_THROW_EXCEPTION(ExtractionException(ExtractionError::Unspecified));
@@ -261,7 +299,7 @@ InterimResults ExtractPOTFromSources(CatalogPtr catalog)
         try
         {
             output.errors = result.errors;
-            output.reference = POCatalog::Create(result.pot_file, Catalog::CreationFlag_IgnoreHeader);
+            output.reference = result.LoadCatalog();
             return output;
         }
         catch (...)
@@ -361,11 +399,13 @@ InterimResults LoadReferenceFile(const wxString& ref_file)
 }
 
 
+// If @a funcPreview is provided, it's used to determine differences while POT is being obtained
 template<typename Func>
 dispatch::future<CatalogPtr> DoPerformUpdateWithUI(wxWindow *parent,
                                                    CatalogPtr catalog,
                                                    int timeCostObtainPOT,
-                                                   Func&& funcObtainPOT)
+                                                   Func&& funcObtainPOT,
+                                                   std::function<MergePreview()> funcPreview = nullptr)
 {
     auto promise = std::make_shared<dispatch::promise<CatalogPtr>>();
     auto merge_result = std::make_shared<MergeResult>();
@@ -373,12 +413,21 @@ dispatch::future<CatalogPtr> DoPerformUpdateWithUI(wxWindow *parent,
     auto cancellation = std::make_shared<dispatch::cancellation_token>();
     wxWindowPtr<ProgressWindow> progress(new MergeProgressWindow(parent, _("Updating translations"), cancellation));
 
-    progress->RunTaskThenDo([merge_result,catalog,cancellation,funcObtainPOT,timeCostObtainPOT]() -> BackgroundTaskResult
+    progress->RunTaskThenDo([merge_result,catalog,cancellation,funcObtainPOT,funcPreview,timeCostObtainPOT]() -> BackgroundTaskResult
     {
         InterimResults data;
 
         Progress p(100);
 
+        // Differences are determined concurrently with obtaining the POT: either
+        // fully from a quick scan of the reference file, or at least the
+        // catalog's side of them is indexed in the meantime:
+        dispatch::future<MergePreview> preview;
+        if (funcPreview)
+            preview = dispatch::async(funcPreview);
+        else
+            preview = dispatch::async([catalog]{ return MergePreview{{}, std::make_shared<MergeKeysIndex>(catalog)}; });
+
         {
             Progress subtask(1, p, timeCostObtainPOT);
             data = funcObtainPOT();
@@ -386,19 +435,52 @@ dispatch::future<CatalogPtr> DoPerformUpdateWithUI(wxWindow *parent,
 
         cancellation->throw_if_cancelled();
 
+        // New strings are looked up in the TM while merging is still in progress:
+        std::unique_ptr<PreTranslationPrefetch> pretranslation;
+        if (Config::UseTM() && Config::MergeBehavior() == Merge_UseTM)
+            pretranslation.reset(new PreTranslationPrefetch(catalog, data.reference, PreTranslateOptions(PreTranslate_OnlyGoodQuality), cancellation));
+
+        const int stepCost = (100 - timeCostObtainPOT) / (pretranslation ? 3 : 2);
+
         MergeStats stats;
         stats.errors = data.errors;
 
         {
-            Progress subtask(1, p, (100 - timeCostObtainPOT) / 2);
+            Progress subtask(1, p, stepCost);
             subtask.message(_(L"Determining differences…"));
-            ComputeMergeStats(stats, catalog, data.reference);
+
+            MergePreview computed;
+            try
+            {
+                computed = preview.get();
+            }
+            catch (...)
+            {
+                // determine them from the loaded reference below
+            }
+
+            if (funcPreview && computed.catalogIndex)
+            {
+                stats.added = std::move(computed.stats.added);
+                stats.removed = std::move(computed.stats.removed);
+            }
+            else if (computed.catalogIndex)
+            {
+                MergeStats diff;
+                ComputeMergeStats(diff, *computed.catalogIndex, MergeKeysIndex(data.reference));
+                stats.added = std::move(diff.added);
+                stats.removed = std::move(diff.removed);
+            }
+            else
+            {
+                ComputeMergeStats(stats, catalog, data.reference);
+            }
         }
 
         cancellation->throw_if_cancelled();
 
         {
-            Progress subtask(1, p, (100 - timeCostObtainPOT) / 2);
+            Progress subtask(1, p, stepCost);
             subtask.message(_(L"Merging differences…"));
             *merge_result = MergeCatalogWithReference(catalog, data.reference);
             if (!(*merge_result))
@@ -407,6 +489,15 @@ dispatch::future<CatalogPtr> DoPerformUpdateWithUI(wxWindow *parent,
             stats.errors += merge_result->errors;
         }
 
+        int pretranslated = 0;
+        if (pretranslation)
+        {
+            // catalog is already merged at this point, so cancelling only skips
+            // the rest of pre-translation:
+            Progress subtask(1, p, stepCost);
+            pretranslated = pretranslation->ApplyTo(merge_result->updated_catalog);
+        }
+
         BackgroundTaskResult bg;
         bg.user_data = stats;
 
@@ -425,6 +516,13 @@ dispatch::future<CatalogPtr> DoPerformUpdateWithUI(wxWindow *parent,
             bg.details.emplace_back(_("Removed strings (no longer used):"), wxNumberFormatter::ToString((long)stats.removed.size()));
         }
 
+        if (pretranslated)
+        {
+            bg.details.emplace_back(wxString::Format(wxPLURAL("%d entry was pre-translated.",
+                                                              "%d entries were pre-translated.",
+                                                              pretranslated), pretranslated), "");
+        }
+
         return bg;
     },
     [progress,promise,merge_result](bool ok)
@@ -474,7 +572,8 @@ PerformUpdateFromReferenceWithUI(wxWindow *parent, CatalogPtr catalog, const wxS
 {
     return DoPerformUpdateWithUI(parent, catalog,
                                  50,
-                                 [=]{ return LoadReferenceFile(reference_file); });
+                                 [=]{ return LoadReferenceFile(reference_file); },
+                                 [=]{ return PreviewMergeWithReference(catalog, reference_file); });
 }
 
 
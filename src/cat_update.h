@@ -63,6 +63,9 @@ MergeResult PerformUpdateFromSourcesSimple(CatalogPtr catalog);
     Update catalog from source code, if configured, and provide UI
     during the operation.
 
+    If enabled in preferences, new strings are pre-translated from TM as
+    part of the same operation, with lookups overlapping the merging.
+
     The returned catalog may be the same as @a catalog (which may be modified
     in place), or it may be a new instance.
 
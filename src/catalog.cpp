@@ -38,6 +38,10 @@
 #include "gexecute.h"
 #include "qa_checks.h"
 #include "str_helpers.h"
+#include "syntaxhighlighter.h"
+#include "text_diff.h"
+#include "tracing.h"
+#include "unicode_helpers.h"
 #include "utility.h"
 #include "version.h"
 #include "language.h"
@@ -56,8 +60,18 @@
 #include <wx/filename.h>
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <numeric>
 #include <set>
-#include <regex>
+
+// dispatch's background queue isn't available in the non-GUI QuickLook extensions:
+#if wxUSE_GUI
+    #include "concurrency.h"
+    #define HAVE_PARALLEL_PROCESSING
+#endif
 
 
 // ----------------------------------------------------------------------
@@ -67,8 +81,77 @@
 namespace
 {
 
-// Mostly correct regex for removing HTML markup
-const std::wregex RE_APPROXIMATE_MARKUP(L"<[^>]*>");
+// Appends @a text to @a out as UTF-8, with anything looking like HTML markup
+// (i.e. "<[^>]*>") replaced with a space; approximate, but good enough for
+// language detection.
+void AppendWithoutMarkup(std::string& out, const wxString& text)
+{
+    const wchar_t *s = text.wc_str();
+    const wchar_t *end = s + text.length();
+    while (s < end)
+    {
+        auto tag = std::find(s, end, L'<');
+        auto tagEnd = (tag != end) ? std::find(tag, end, L'>') : end;
+        if (tagEnd == end)
+            tag = end; // unterminated '<' isn't markup
+
+        if (tag != s)
+            out += str::to_utf8(std::wstring(s, tag));
+        if (tag == end)
+            break;
+        out += ' ';
+        s = tagEnd + 1;
+    }
+    out += '\n';
+}
+
+// Detects language of items' texts, as returned by @a getText (empty texts
+// are skipped). Only a sample of the texts is used: they are taken evenly from
+// the whole catalog, so that e.g. a block of untranslatable entries doesn't
+// skew the result, and detection stops as soon as it is reliable.
+template<typename GetText>
+Language DetectLanguageFromSample(const CatalogItemArray& items, GetText getText)
+{
+    const size_t MIN_SAMPLE_BYTES = 1024;
+    const size_t MAX_SAMPLE_BYTES = 64 * 1024;
+    const size_t STRATA = 16;
+
+    const size_t count = items.size();
+    if (count == 0)
+        return Language();
+
+    const size_t strata = std::min(STRATA, count);
+    const size_t stratumSize = (count + strata - 1) / strata;
+
+    std::string sample;
+    size_t nextCheck = MIN_SAMPLE_BYTES;
+    // take the k-th item of every stratum in turn:
+    for (size_t k = 0; k < stratumSize && sample.size() < MAX_SAMPLE_BYTES; k++)
+    {
+        for (size_t s = 0; s < strata; s++)
+        {
+            const size_t index = s * stratumSize + k;
+            if (index >= count)
+                break;
+            const wxString& text = getText(*items[index]);
+            if (!text.empty())
+                AppendWithoutMarkup(sample, text);
+        }
+
+        if (sample.size() >= nextCheck)
+        {
+            auto lang = Language::TryDetectFromText(sample);
+            if (lang.IsValid())
+                return lang;
+            // keep the total cost of repeated detection linear in sample size:
+            nextCheck = sample.size() * 2;
+        }
+    }
+
+    if (sample.empty())
+        return Language();
+    return Language::TryDetectFromText(sample);
+}
 
 // Fixup some common issues with filepaths in PO files, due to old Poedit versions,
 // user misunderstanding or Poedit bugs:
@@ -83,6 +166,16 @@ wxString FixBrokenSearchPathValue(wxString p)
     return p;
 }
 
+// Extracts charset from Content-Type header's value, defaulting to UTF-8
+wxString CharsetFromContentType(const wxString& ctype)
+{
+    int charsetPos = ctype.Find("; charset=");
+    if (charsetPos != -1)
+        return ctype.Mid(charsetPos + strlen("; charset=")).Strip(wxString::both);
+    else
+        return "UTF-8";
+}
+
 // Detect whether source strings are just IDs instead of actual text
 bool DetectUseOfSymbolicIDs(Catalog& cat)
 {
@@ -113,43 +206,77 @@ bool DetectUseOfSymbolicIDs(Catalog& cat)
 
 void Catalog::HeaderData::FromString(const wxString& str)
 {
-    wxStringTokenizer tkn(str, "\n");
-    wxString ln;
+    ParseEntries(str);
+    ParseDict();
+}
 
-    m_entries.clear();
+wxString Catalog::HeaderData::ParseCharset(const wxString& str)
+{
+    HeaderData hdr;
+    hdr.ParseEntries(str);
+    return CharsetFromContentType(hdr.GetHeader("Content-Type"));
+}
 
-    while (tkn.HasMoreTokens())
+void Catalog::HeaderData::ParseEntries(const wxString& str)
+{
+    m_entries.clear();
+    m_index.clear();
+    m_serializedValid = false;
+
+    // Split the lines directly instead of using wxStringTokenizer, this is
+    // done for every loaded file. Empty lines are skipped, as the tokenizer
+    // would do.
+    const size_t length = str.length();
+    size_t start = 0;
+    while (start < length)
     {
-        ln = tkn.GetNextToken();
-        size_t pos = ln.find(_T(':'));
-        if (pos == wxString::npos)
+        size_t end = str.find('\n', start);
+        if (end == wxString::npos)
+            end = length;
+
+        if (end > start)
         {
-            wxLogError(_(L"Malformed header: “%s”"), ln.c_str());
+            const wxString ln(str.substr(start, end - start));
+            size_t pos = ln.find(_T(':'));
+            if (pos == wxString::npos)
+            {
+                wxLogError(_(L"Malformed header: “%s”"), ln.c_str());
+            }
+            else
+            {
+                Entry en;
+                en.Key = wxString(ln.substr(0, pos)).Strip(wxString::both);
+                en.Value = wxString(ln.substr(pos + 1)).Strip(wxString::both);
+
+                wxLogTrace("poedit.header",
+                           "%s='%s'", en.Key.c_str(), en.Value.c_str());
+                m_index.emplace(en.Key, m_entries.size());
+                m_entries.push_back(std::move(en));
+            }
         }
-        else
-        {
-            Entry en;
-            en.Key = wxString(ln.substr(0, pos)).Strip(wxString::both);
-            en.Value = wxString(ln.substr(pos + 1)).Strip(wxString::both);
 
-            m_entries.push_back(en);
-            wxLogTrace("poedit.header",
-                       "%s='%s'", en.Key.c_str(), en.Value.c_str());
-        }
+        start = end + 1;
     }
-
-    ParseDict();
 }
 
 wxString Catalog::HeaderData::ToString(const wxString& line_delim)
 {
     UpdateDict();
 
+    // UpdateDict() only invalidates the serialized header if it really
+    // changed something, so repeated saves and merges reuse it:
+    if (m_serializedValid && m_serializedDelim == line_delim)
+        return m_serialized;
+
     wxString hdr;
     for (auto& e: m_entries)
     {
         hdr << EscapeCString(e.Key) << ": " << EscapeCString(e.Value) << "\\n" << line_delim;
     }
+
+    m_serialized = hdr;
+    m_serializedDelim = line_delim;
+    m_serializedValid = true;
     return hdr;
 }
 
@@ -158,7 +285,7 @@ void Catalog::HeaderData::NormalizeHeaderOrder()
     // This is the order of header lines in a POT file
     // generated by GNU Gettext's xgettext utility, or
     // rearranged by the msgmerge utility.
-    const wxString canonicalOrder[] =
+    static const char *const canonicalOrder[] =
     {
         "Project-Id-Version",
         "Report-Msgid-Bugs-To",
@@ -173,23 +300,30 @@ void Catalog::HeaderData::NormalizeHeaderOrder()
         "Plural-Forms"
     };
 
-    const wxArrayString orderArr(sizeof(canonicalOrder) / sizeof(*canonicalOrder),
-        canonicalOrder);
+    auto rank = [](const wxString& key) -> int
+    {
+        for (int i = 0; i < int(WXSIZEOF(canonicalOrder)); i++)
+        {
+            if (key == canonicalOrder[i])
+                return i;
+        }
+        return int(WXSIZEOF(canonicalOrder));
+    };
 
     // Sort standard header lines to the beginning of the header, in their
     // canonical order, and the rest after them, in their original order.
-    std::stable_sort(m_entries.begin(), m_entries.end(),
-        [&orderArr](const Entry& a, const Entry& b)
-        {
-            auto coalesce = [&orderArr](int x) -> int {
-                if (x == wxNOT_FOUND)
-                    return 1 + static_cast<int>(orderArr.GetCount());
-                else
-                    return x;
-            };
-
-            return coalesce(orderArr.Index(a.Key)) < coalesce(orderArr.Index(b.Key));
-        });
+    auto ordering = [&rank](const Entry& a, const Entry& b)
+    {
+        return rank(a.Key) < rank(b.Key);
+    };
+
+    // headers are usually already sorted, leave them alone in that case:
+    if (std::is_sorted(m_entries.begin(), m_entries.end(), ordering))
+        return;
+
+    std::stable_sort(m_entries.begin(), m_entries.end(), ordering);
+    RebuildIndex();
+    m_serializedValid = false;
 }
 
 void Catalog::HeaderData::UpdateDict()
@@ -234,41 +368,8 @@ void Catalog::HeaderData::UpdateDict()
 
     SetHeaderNotEmpty("X-Poedit-Basepath", BasePath);
 
-    unsigned i = 0;
-    while (true)
-    {
-        wxString path;
-        path.Printf("X-Poedit-SearchPath-%i", i);
-        if (!HasHeader(path))
-            break;
-        DeleteHeader(path);
-        i++;
-    }
-
-    i = 0;
-    while (true)
-    {
-        wxString path;
-        path.Printf("X-Poedit-SearchPathExcluded-%i", i);
-        if (!HasHeader(path))
-            break;
-        DeleteHeader(path);
-        i++;
-    }
-
-    for (i = 0; i < SearchPaths.size(); i++)
-    {
-        wxString path;
-        path.Printf("X-Poedit-SearchPath-%i", i);
-        SetHeader(path, SearchPaths[i]);
-    }
-
-    for (i = 0; i < SearchPathsExcluded.size(); i++)
-    {
-        wxString path;
-        path.Printf("X-Poedit-SearchPathExcluded-%i", i);
-        SetHeader(path, SearchPathsExcluded[i]);
-    }
+    SetNumberedHeaders("X-Poedit-SearchPath-%i", SearchPaths);
+    SetNumberedHeaders("X-Poedit-SearchPathExcluded-%i", SearchPathsExcluded);
 
     NormalizeHeaderOrder();
 }
@@ -299,17 +400,7 @@ void Catalog::HeaderData::ParseDict()
 
     LanguageTeam = GetHeader("Language-Team");
 
-    wxString ctype = GetHeader("Content-Type");
-    int charsetPos = ctype.Find("; charset=");
-    if (charsetPos != -1)
-    {
-        Charset =
-            ctype.Mid(charsetPos + strlen("; charset=")).Strip(wxString::both);
-    }
-    else
-    {
-        Charset = "UTF-8";
-    }
+    Charset = CharsetFromContentType(GetHeader("Content-Type"));
 
     // Parse language information, with backwards compatibility with X-Poedit-*:
     Lang = Language();
@@ -413,18 +504,23 @@ bool Catalog::HeaderData::HasHeader(const wxString& key) const
 
 void Catalog::HeaderData::SetHeader(const wxString& key, const wxString& value)
 {
-    Entry *e = (Entry*) Find(key);
-    if (e)
+    auto i = m_index.find(key);
+    if (i != m_index.end())
     {
-        e->Value = value;
+        auto& e = m_entries[i->second];
+        if (e.Value == value)
+            return;
+        e.Value = value;
     }
     else
     {
         Entry en;
         en.Key = key;
         en.Value = value;
-        m_entries.push_back(en);
+        m_index.emplace(key, m_entries.size());
+        m_entries.push_back(std::move(en));
     }
+    m_serializedValid = false;
 }
 
 void Catalog::HeaderData::SetHeaderNotEmpty(const wxString& key,
@@ -438,31 +534,128 @@ void Catalog::HeaderData::SetHeaderNotEmpty(const wxString& key,
 
 void Catalog::HeaderData::DeleteHeader(const wxString& key)
 {
-    if (HasHeader(key))
-    {
-        Entries enew;
+    if (!HasHeader(key))
+        return;
 
-        for (Entries::const_iterator i = m_entries.begin();
-                i != m_entries.end(); i++)
-        {
-            if (i->Key != key)
-                enew.push_back(*i);
-        }
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                                   [&key](const Entry& e){ return e.Key == key; }),
+                    m_entries.end());
+    RebuildIndex();
+    m_serializedValid = false;
+}
+
+void Catalog::HeaderData::SetNumberedHeaders(const char *format, const wxArrayString& values)
+{
+    // Existing headers are usually the same as the values, don't modify
+    // them (and their position) in that case:
+    size_t count = 0;
+    while (HasHeader(wxString::Format(format, int(count))))
+        count++;
 
-        m_entries = enew;
+    if (count == values.size())
+    {
+        bool same = true;
+        for (size_t i = 0; i < count && same; i++)
+            same = GetHeader(wxString::Format(format, int(i))) == values[i];
+        if (same)
+            return;
     }
+
+    for (size_t i = 0; i < count; i++)
+        DeleteHeader(wxString::Format(format, int(i)));
+
+    for (size_t i = 0; i < values.size(); i++)
+        SetHeader(wxString::Format(format, int(i)), values[i]);
 }
 
 const Catalog::HeaderData::Entry *
 Catalog::HeaderData::Find(const wxString& key) const
 {
-    size_t size = m_entries.size();
-    for (size_t i = 0; i < size; i++)
+    auto i = m_index.find(key);
+    if (i == m_index.end())
+        return NULL;
+    return &m_entries[i->second];
+}
+
+void Catalog::HeaderData::RebuildIndex()
+{
+    m_index.clear();
+    // with duplicate keys, only the first one is used, as before:
+    for (size_t i = 0; i < m_entries.size(); i++)
+        m_index.emplace(m_entries[i].Key, i);
+}
+
+
+// ----------------------------------------------------------------------
+// CatalogItemsArena
+// ----------------------------------------------------------------------
+
+void *CatalogItemsArena::Allocate(size_t size, size_t alignment)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // large objects get blocks of their own, so that the current block isn't wasted:
+    if (size > BLOCK_SIZE / 4)
+    {
+        m_blocks.emplace_back(new char[size]);
+        m_allocated += size;
+        return m_blocks.back().get();
+    }
+
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(m_next) % alignment) % alignment;
+    if (!m_next || padding + size > m_available)
+    {
+        m_blocks.emplace_back(new char[BLOCK_SIZE]);
+        m_next = m_blocks.back().get();
+        m_available = BLOCK_SIZE;
+        m_allocated += BLOCK_SIZE;
+        padding = 0; // blocks are aligned for any type
+    }
+
+    char *p = m_next + padding;
+    m_next = p + size;
+    m_available -= padding + size;
+    return p;
+}
+
+
+// ----------------------------------------------------------------------
+// InternedStrings
+// ----------------------------------------------------------------------
+
+InternedStrings::Id InternedStrings::Intern(const wxString& str)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto i = m_ids.find(str);
+        if (i != m_ids.end())
+            return i->second;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto i = m_ids.emplace(str, (Id)m_strings.size());
+    if (i.second)
     {
-        if (m_entries[i].Key == key)
-            return &(m_entries[i]);
+        m_strings.push_back(str);
+        // the string is stored twice, sizeof(void*) approximates hash node overhead:
+        m_memoryUsage += 2 * (sizeof(wxString) + CatalogMemoryUsage::Of(str)) + sizeof(Id) + sizeof(void*);
     }
-    return NULL;
+    return i.first->second;
+}
+
+
+wxString InternedStrings::Get(Id id) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    wxCHECK_MSG(id < m_strings.size(), wxString(), "invalid interned string ID");
+    return m_strings[id];
+}
+
+
+size_t InternedStrings::GetMemoryUsage() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_memoryUsage + m_ids.bucket_count() * sizeof(void*);
 }
 
 
@@ -474,6 +667,12 @@ Catalog::Catalog(Type type)
 {
     m_fileType = type;
     m_header.BasePath = wxEmptyString;
+    m_itemsArena = std::make_shared<CatalogItemsArena>();
+    m_changeTracker = std::make_shared<CatalogChangeTracker>();
+}
+
+Catalog::~Catalog()
+{
 }
 
 
@@ -542,41 +741,48 @@ CatalogItemPtr Catalog::FindItemByLine(int lineno)
 
 int Catalog::FindItemIndexByLine(int lineno)
 {
-    int last = -1;
+    // the item starting at or last before lineno:
+    auto& index = GetLineIndex();
+    auto found = std::upper_bound(index.begin(), index.end(), lineno);
+    return int(found - index.begin()) - 1;
+}
+
+std::vector<int> Catalog::FindItemIndexesByLines(const std::vector<int>& lines)
+{
+    auto& index = GetLineIndex();
 
-    for (auto& i: m_items)
+    std::vector<size_t> order(lines.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (!std::is_sorted(lines.begin(), lines.end()))
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return lines[a] < lines[b]; });
+
+    std::vector<int> found(lines.size());
+    size_t pos = 0;
+    for (auto i: order)
     {
-        if (i->GetLineNumber() > lineno)
-            return last;
-        last++;
+        while (pos < index.size() && index[pos] <= lines[i])
+            pos++;
+        found[i] = int(pos) - 1;
     }
 
-    return last;
+    return found;
 }
 
-
-bool Catalog::RemoveSameAsSourceTranslations()
+const std::vector<int>& Catalog::GetLineIndex()
 {
-    bool changed = false;
-    const unsigned pluralFormsCount = GetPluralForms().nplurals();
-
-    for (auto& i: m_items)
+    // also catches items added or removed without invalidating the index:
+    if (m_lineIndex.size() != m_items.size())
     {
-        if (i ->GetString() == i->GetTranslation())
+        m_lineIndex.clear();
+        m_lineIndex.reserve(m_items.size());
+        int highest = std::numeric_limits<int>::min();
+        for (auto& i: m_items)
         {
-            if (i->HasPlural())
-            {
-                // we can only easily do this operation for languages that have singular+plural, skip everything else:
-                if (pluralFormsCount != 2 || i->GetPluralString() != i->GetTranslation(1))
-                    continue;
-            }
-
-            i->ClearTranslation();
-            changed = true;
+            highest = std::max(highest, i->GetLineNumber());
+            m_lineIndex.push_back(highest);
         }
     }
-
-    return changed;
+    return m_lineIndex;
 }
 
 
@@ -612,7 +818,9 @@ wxString MaskForType(Catalog::Type t)
 
 wxString Catalog::GetAllTypesFileMask()
 {
-    return MaskForType("*.po;*.pot;*.xlf;*.xliff;*.xcloc;*.json;*.arb;*.resx;*.ts", _("All Translation Files"), /*showExt=*/false) +
+    return MaskForType("*.po;*.pot;*.xlf;*.xliff;*.xcloc;*.json;*.arb;*.resx;*.ts;"
+                       "*.po.gz;*.xlf.gz;*.xliff.gz;*.json.gz;*.arb.gz;*.resx.gz;*.ts.gz",
+                       _("All Translation Files"), /*showExt=*/false) +
         "|" +
         GetTypesFileMask({ Type::PO, Type::POT, Type::XLIFF, Type::JSON, Type::JSON_FLUTTER, Type::XCLOC, Type::RESX, Type::QT_LINGUIST });
 }
@@ -794,107 +1002,645 @@ void Catalog::SetLanguage(Language lang)
     m_header.Lang = lang;
 }
 
-void Catalog::GetStatistics(int *all, int *fuzzy, int *badtokens,
-                            int *untranslated, int *unfinished)
+// ----------------------------------------------------------------------
+// Tracking of changes to items
+// ----------------------------------------------------------------------
+
+namespace
 {
-    if (all) *all = 0;
-    if (fuzzy) *fuzzy = 0;
-    if (badtokens) *badtokens = 0;
-    if (untranslated) *untranslated = 0;
-    if (unfinished) *unfinished = 0;
 
-    for (auto& i: m_items)
-    {
-        bool ok = true;
+// source of status table revisions, shared by all trackers so that a new
+// tracker never reuses a revision of the one it replaced
+std::atomic<uint64_t> gs_lastStatusRevision{0};
+
+} // anonymous namespace
+
+/**
+    Keeps running statistics of the catalog's items, updated as the items
+    change, and tracks items changed since QA issues were last computed, so
+    that they can be updated in time proportional to the number of changes
+    instead of the catalog's size.
 
-        if (all)
-            (*all)++;
+    Items are attached to the tracker by the first full pass over the catalog;
+    replacing the tracker with a new instance detaches all of them.
+ */
+class CatalogChangeTracker : public std::enable_shared_from_this<CatalogChangeTracker>
+{
+public:
+    struct Statistics
+    {
+        int all = 0, fuzzy = 0, badtokens = 0, untranslated = 0, unfinished = 0;
+        int issues = 0;
+    };
 
-        if (i->IsFuzzy())
+    /// Called by CatalogItem::NotifyChanged(); may be called from any thread.
+    void NoteChanged(CatalogItem& item, bool content)
+    {
+        const bool stats = m_statsValid;
+        const bool qa = content && m_qaValid;
+        if (!stats && !qa && !m_statusValid)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        UpdateStatusSlot(item);
+        if (stats)
+            UpdateItemStats(item);
+        if (qa && !item.m_pendingQA)
         {
-            if (fuzzy)
-                (*fuzzy)++;
-            ok = false;
+            item.m_pendingQA = true;
+            m_pendingQA.push_back(item.shared_from_this());
         }
-        if (i->HasError())
+    }
+
+    /// Called by CatalogItem::NotifyStatusChanged(); may be called from any thread.
+    void NoteStatusChanged(CatalogItem& item)
+    {
+        if (!m_statusValid && !m_statsValid)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        UpdateStatusSlot(item);
+        if (m_statsValid)
+            UpdateItemStats(item);
+    }
+
+    /// Starts deferring notifications about changes of @a items, see Catalog::ItemsBatch.
+    void BeginBatch(const CatalogItemArray& items)
+    {
+        for (auto& item: items)
+            item->m_batchState |= CatalogItem::Batch_Active;
+    }
+
+    /// Processes changes of @a items deferred since BeginBatch(), all at once.
+    void EndBatch(const CatalogItemArray& items)
+    {
+        const bool stats = m_statsValid;
+        const bool qa = m_qaValid;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& item: items)
         {
-            if (badtokens)
-                (*badtokens)++;
-            ok = false;
+            const uint8_t changes = item->m_batchState.exchange(0);
+            if (!(changes & CatalogItem::Batch_Status) || item->m_changeTracker.lock().get() != this)
+                continue;
+
+            UpdateStatusSlot(*item);
+            if (stats)
+                UpdateItemStats(*item);
+            if (qa && (changes & CatalogItem::Batch_Content) && !item->m_pendingQA)
+            {
+                item->m_pendingQA = true;
+                m_pendingQA.push_back(item);
+            }
         }
-        if (!i->IsTranslated())
+    }
+
+    /// Returns status flags of the catalog's @a items and optionally their revision.
+    std::vector<uint8_t> GetItemsStatus(const CatalogItemArray& items, uint64_t *revision = nullptr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        EnsureStatusTable(items);
+        if (revision)
+            *revision = m_statusRevision;
+        return m_status;
+    }
+
+    /// Returns current revision of the status table, see Catalog::GetItemsStatusRevision()
+    uint64_t GetStatusRevision() const { return m_statusRevision; }
+
+    /**
+        Returns up-to-date statistics for the catalog's @a items.
+
+        Only the first call (or the first one after items were added or
+        removed) examines all items; the counters are updated by every
+        change after that, so subsequent calls are O(1).
+     */
+    Statistics UpdateStatistics(const CatalogItemArray& items)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_statsValid || m_stats.all != (int)items.size())
         {
-            if (untranslated)
-                (*untranslated)++;
-            ok = false;
+            // compute from the dense status table, without touching items
+            // more than necessary:
+            EnsureStatusTable(items);
+            m_stats = Statistics();
+            const size_t count = items.size();
+            for (size_t i = 0; i < count; i++)
+            {
+                auto& item = *items[i];
+                item.m_trackedStats = GetStatsFlags(m_status[i]);
+                AddStats(item.m_trackedStats, +1);
+            }
+            m_statsValid = true;
         }
 
-        if ( !ok && unfinished )
-            (*unfinished)++;
+        return m_stats;
     }
-}
 
+    /**
+        Returns items that need to be QA-checked.
 
-void CatalogItem::SetFlags(const wxString& flags)
-{
-    static const wxString flag_fuzzy(wxS(", fuzzy"));
+        Those are the items changed since the last call, if it was done with
+        the same @a key (identifying the QA checker used). Otherwise, all
+        @a items are returned and @a incremental is set to false.
+     */
+    CatalogItemArray TakeItemsForQA(const CatalogItemArray& items, const std::string& key, bool& incremental)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
 
-    m_moreFlags = flags;
+        CatalogItemArray out;
+        incremental = m_qaValid && key == m_qaKey;
+        if (incremental)
+        {
+            out.swap(m_pendingQA);
+            for (auto& i: out)
+                i->m_pendingQA = false;
+        }
+        else
+        {
+            for (auto& i: items)
+            {
+                Attach(*i);
+                i->m_pendingQA = false;
+            }
+            m_pendingQA.clear();
+            out = items;
 
-    if (flags.find(flag_fuzzy) != wxString::npos)
+            // every item's issue will be reset, cheaper to recompute from scratch:
+            m_statsValid = false;
+        }
+
+        m_qaKey = key;
+        m_qaValid = true;
+        return out;
+    }
+
+    /// Forget QA state, next TakeItemsForQA() will return all items.
+    void InvalidateQA()
     {
-        m_isFuzzy = true;
-        m_moreFlags.Replace(flag_fuzzy, wxString());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_qaValid = false;
+        m_pendingQA.clear();
     }
-    else
+
+    /// Approximate memory used by the tracker's tables
+    size_t GetMemoryUsage()
     {
-        m_isFuzzy = false;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_status.capacity() + m_pendingQA.capacity() * sizeof(CatalogItemPtr) + m_qaKey.capacity();
     }
-}
 
+private:
+    enum StatsFlags
+    {
+        Stats_Fuzzy        = 0x01,
+        Stats_Error        = 0x02,
+        Stats_Untranslated = 0x04,
+        Stats_Issue        = 0x08
+    };
 
-wxString CatalogItem::GetFlags() const
-{
-    if (m_isFuzzy)
+    static unsigned GetStatsFlags(uint8_t status)
     {
-        static const wxString flag_fuzzy(wxS(", fuzzy"));
-        if (m_moreFlags.empty())
-            return flag_fuzzy;
-        else
-            return flag_fuzzy + m_moreFlags;
+        unsigned flags = 0;
+        if (status & CatalogItem::Status_Fuzzy)
+            flags |= Stats_Fuzzy;
+        if (status & CatalogItem::Status_Error)
+            flags |= Stats_Error;
+        if (!(status & CatalogItem::Status_Translated))
+            flags |= Stats_Untranslated;
+        if (status & CatalogItem::Status_Issue)
+            flags |= Stats_Issue;
+        return flags;
     }
-    else
+
+    void AddStats(unsigned flags, int delta)
     {
-        return m_moreFlags;
+        m_stats.all += delta;
+        if (flags & Stats_Fuzzy)
+            m_stats.fuzzy += delta;
+        if (flags & Stats_Error)
+            m_stats.badtokens += delta;
+        if (flags & Stats_Untranslated)
+            m_stats.untranslated += delta;
+        if (flags & (Stats_Fuzzy | Stats_Error | Stats_Untranslated))
+            m_stats.unfinished += delta;
+        if (flags & Stats_Issue)
+            m_stats.issues += delta;
     }
-}
 
-std::string CatalogItem::GetFormatFlag() const
-{
-    if (m_moreFlags.empty())
-        return std::string();
+    // Must be called with m_mutex locked
+    void UpdateItemStats(CatalogItem& item)
+    {
+        const unsigned flags = GetStatsFlags(item.GetStatusFlags());
+        if (flags == item.m_trackedStats)
+            return;
+        AddStats(item.m_trackedStats, -1);
+        item.m_trackedStats = flags;
+        AddStats(flags, +1);
+    }
 
-    auto pos = m_moreFlags.find(wxS("-format"));
-    if (pos == wxString::npos)
-        return std::string();
-    auto space = m_moreFlags.find_last_of(" \t", pos);
-    auto format = (space == wxString::npos)
-                    ? m_moreFlags.substr(0, pos)
-                    : m_moreFlags.substr(space+1, pos-space-1);
-    if (format.starts_with("no-"))
-        return std::string();
-    return std::string(format.begin(), format.end());
-}
+    void Attach(CatalogItem& item)
+    {
+        item.m_changeTracker = weak_from_this();
+    }
 
-void CatalogItem::SetFuzzy(bool fuzzy)
-{
-    if (fuzzy == m_isFuzzy)
-        return;
+    // Must be called with m_mutex locked
+    void EnsureStatusTable(const CatalogItemArray& items)
+    {
+        if (m_statusValid && m_status.size() == items.size())
+            return;
+
+        const size_t count = items.size();
+        m_status.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            auto& item = *items[i];
+            Attach(item);
+            item.m_statusSlot = (unsigned)i;
+            m_status[i] = item.GetStatusFlags();
+        }
+        m_statusValid = true;
+        m_statusRevision = ++gs_lastStatusRevision;
+    }
+
+    // Must be called with m_mutex locked
+    void UpdateStatusSlot(const CatalogItem& item)
+    {
+        if (item.m_statusSlot >= m_status.size())
+            return;
+        const uint8_t flags = item.GetStatusFlags();
+        if (m_status[item.m_statusSlot] != flags)
+        {
+            m_status[item.m_statusSlot] = flags;
+            m_statusRevision = ++gs_lastStatusRevision;
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+    std::atomic<bool> m_statsValid{false}, m_qaValid{false}, m_statusValid{false};
+
+    // dense table of items' GetStatusFlags(), indexed by position in the catalog
+    std::vector<uint8_t> m_status;
+    std::atomic<uint64_t> m_statusRevision{++gs_lastStatusRevision};
+
+    Statistics m_stats;
+
+    std::string m_qaKey;
+    CatalogItemArray m_pendingQA;
+};
+
+
+bool CatalogItem::DeferToBatch(uint8_t changes)
+{
+    // If the batch ends concurrently, either its end sees the change or this
+    // fails and the change is processed normally:
+    uint8_t state = m_batchState;
+    while (state & Batch_Active)
+    {
+        if (m_batchState.compare_exchange_weak(state, uint8_t(state | changes)))
+            return true;
+    }
+    return false;
+}
+
+void CatalogItem::NotifyChanged(bool content)
+{
+    if (content)
+        m_revision++;
+
+    if (DeferToBatch(content ? Batch_Status | Batch_Content : Batch_Status))
+        return;
+
+    if (auto tracker = m_changeTracker.lock())
+        tracker->NoteChanged(*this, content);
+}
+
+void CatalogItem::NotifyStatusChanged()
+{
+    if (DeferToBatch(Batch_Status))
+        return;
+
+    if (auto tracker = m_changeTracker.lock())
+        tracker->NoteStatusChanged(*this);
+}
+
+
+Catalog::ItemsBatch::ItemsBatch(Catalog& catalog, const CatalogItemArray& items)
+    : m_tracker(catalog.m_changeTracker), m_items(items)
+{
+    m_tracker->BeginBatch(m_items);
+}
+
+Catalog::ItemsBatch::~ItemsBatch()
+{
+    m_tracker->EndBatch(m_items);
+}
+
+void Catalog::InvalidateChangeTracking()
+{
+    // items attached to the old tracker are detached by its destruction:
+    m_changeTracker = std::make_shared<CatalogChangeTracker>();
+    InvalidateLineIndex();
+    m_referencesIndex = {};
+}
+
+
+void Catalog::GetStatistics(int *all, int *fuzzy, int *badtokens,
+                            int *untranslated, int *unfinished)
+{
+    if (all) *all = 0;
+    if (fuzzy) *fuzzy = 0;
+    if (badtokens) *badtokens = 0;
+    if (untranslated) *untranslated = 0;
+    if (unfinished) *unfinished = 0;
+
+    if (m_precomputedStats.valid)
+    {
+        if (all) *all = m_precomputedStats.all;
+        if (fuzzy) *fuzzy = m_precomputedStats.fuzzy;
+        if (untranslated) *untranslated = m_precomputedStats.untranslated;
+        if (unfinished) *unfinished = m_precomputedStats.unfinished;
+        return;
+    }
+
+    // only changed items are re-examined if the stats were computed before:
+    auto stats = m_changeTracker->UpdateStatistics(m_items);
+    if (all) *all = stats.all;
+    if (fuzzy) *fuzzy = stats.fuzzy;
+    if (badtokens) *badtokens = stats.badtokens;
+    if (untranslated) *untranslated = stats.untranslated;
+    if (unfinished) *unfinished = stats.unfinished;
+}
+
+
+std::vector<uint8_t> Catalog::GetItemsStatus(uint64_t *revision) const
+{
+    return m_changeTracker->GetItemsStatus(m_items, revision);
+}
+
+uint64_t Catalog::GetItemsStatusRevision() const
+{
+    return m_changeTracker->GetStatusRevision();
+}
+
+
+namespace
+{
+
+#ifdef HAVE_PARALLEL_PROCESSING
+// Don't bother with parallelization for small catalogs:
+const size_t MIN_PARALLEL_CREATE_ITEMS = 5000;
+// Number of items created by one parallel task:
+const size_t PARALLEL_CREATE_CHUNK_ITEMS = 1000;
+#endif
+
+} // anonymous namespace
+
+void Catalog::CreateItems(size_t count, const std::function<CatalogItemPtr(size_t)>& create)
+{
+    const size_t first = m_items.size();
+    m_items.resize(first + count);
+
+#ifdef HAVE_PARALLEL_PROCESSING
+    if (count >= MIN_PARALLEL_CREATE_ITEMS)
+    {
+        const size_t chunks = (count + PARALLEL_CREATE_CHUNK_ITEMS - 1) / PARALLEL_CREATE_CHUNK_ITEMS;
+        std::vector<std::exception_ptr> errors(chunks);
+
+        dispatch::parallel_for(chunks, [&](size_t n)
+        {
+            try
+            {
+                const size_t end = std::min(count, (n + 1) * PARALLEL_CREATE_CHUNK_ITEMS);
+                for (size_t i = n * PARALLEL_CREATE_CHUNK_ITEMS; i < end; i++)
+                    m_items[first + i] = create(i);
+            }
+            catch (...)
+            {
+                errors[n] = std::current_exception();
+            }
+        });
+
+        for (auto& e: errors)
+        {
+            if (e)
+                std::rethrow_exception(e);
+        }
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < count; i++)
+        m_items[first + i] = create(i);
+}
+
+
+CatalogSnapshotPtr Catalog::TakeSnapshot() const
+{
+    return std::make_shared<CatalogSnapshot>(*this);
+}
+
+
+CatalogSnapshot::CatalogSnapshot(const Catalog& catalog)
+    : m_fileType(catalog.GetFileType()),
+      m_fileName(catalog.GetFileName()),
+      m_sourceLanguage(catalog.GetSourceLanguage()),
+      m_language(catalog.GetLanguage())
+{
+    auto& items = catalog.items();
+    m_items.reserve(items.size());
+    for (auto& i: items)
+        m_items.push_back(i->GetSnapshot());
+}
+
+
+CatalogItemSnapshot::CatalogItemSnapshot(const CatalogItem& item)
+    : m_item(std::const_pointer_cast<CatalogItem>(item.shared_from_this())),
+      m_id(item.GetId()),
+      m_revision(item.GetRevision()),
+      m_status(item.GetStatusFlags()),
+      m_string(item.GetString()),
+      m_plural(item.GetPluralString()),
+      m_context(item.GetContext()),
+      m_hasPlural(item.HasPlural()),
+      m_hasContext(item.HasContext()),
+      m_translations(item.GetTranslations()),
+      m_comment(item.GetComment()),
+      m_flags(item.GetFlags()),
+      m_issue(item.GetIssue())
+{
+}
+
+
+CatalogItemSnapshotPtr CatalogItem::GetSnapshot() const
+{
+    // Revision covers content changes, but not all of the status flags or
+    // the QA issue, so check those too:
+    auto& s = m_snapshot;
+    if (!s || s->GetRevision() != m_revision || s->GetStatusFlags() != GetStatusFlags() || s->GetIssue() != m_issue)
+        s = std::make_shared<const CatalogItemSnapshot>(*this);
+    return s;
+}
+
+
+namespace
+{
+
+inline wxString FoldCase(const wxString& text)
+{
+    if (text.empty())
+        return text;
+
+    // ASCII-only texts, the most common case, don't need ICU's help:
+    if (unicode::is_ascii(text))
+    {
+        wxString folded(text);
+        unicode::ascii_fold_case_inplace(folded);
+        return folded;
+    }
+    return unicode::fold_case(text);
+}
+
+} // anonymous namespace
+
+
+std::shared_ptr<const CatalogItem::FoldedTexts> CatalogItem::GetFoldedTexts() const
+{
+    auto cached = std::atomic_load(&m_foldedTexts);
+    if (cached && cached->revision == m_revision)
+        return cached;
+
+    auto folded = std::make_shared<FoldedTexts>();
+    auto& f = *folded;
+
+    f.string = FoldCase(GetString());
+    if (HasPlural())
+        f.pluralString = FoldCase(GetPluralString());
+    f.context = FoldCase(GetContext());
+    f.symbolicId = FoldCase(GetSymbolicId());
+    for (auto& t: GetTranslations())
+        f.translations.push_back(FoldCase(t));
+    f.comment = FoldCase(GetComment());
+    for (auto& c: GetExtractedComments())
+        f.extractedComments.push_back(FoldCase(c));
+    f.revision = m_revision;
+
+    std::atomic_store(&m_foldedTexts, std::shared_ptr<const FoldedTexts>(folded));
+    return folded;
+}
+
+
+void CatalogItem::AddMemoryUsage(CatalogMemoryUsage& usage) const
+{
+    typedef CatalogMemoryUsage M;
+
+    // lazily loaded metadata are accounted for by subclasses as long as not loaded:
+    usage.strings += M::Of(m_string) + M::Of(m_plural) + M::Of(m_context) +
+                     M::Of(m_translations) + M::Of(m_extractedComments) + M::Of(m_oldMsgid) +
+                     M::Of(m_moreFlags) + M::Of(m_comment);
+    if (m_issue)
+        usage.caches += sizeof(Issue) + M::Of(m_issue->message);
+    usage.caches += SyntaxHighlighter::GetSourceHighlightsMemoryUsage(*this);
+    usage.caches += TextDiff::GetMemoryUsage(*this);
+
+    if (auto folded = std::atomic_load(&m_foldedTexts))
+    {
+        usage.caches += sizeof(FoldedTexts) +
+                        M::Of(folded->string) + M::Of(folded->pluralString) + M::Of(folded->context) +
+                        M::Of(folded->symbolicId) + M::Of(folded->translations) +
+                        M::Of(folded->comment) + M::Of(folded->extractedComments);
+    }
+
+    if (auto& snap = m_snapshot)
+    {
+        usage.caches += sizeof(CatalogItemSnapshot) +
+                        M::Of(snap->GetString()) + M::Of(snap->GetPluralString()) + M::Of(snap->GetContext()) +
+                        M::Of(snap->GetTranslations()) + M::Of(snap->GetComment()) + M::Of(snap->GetFlags());
+    }
+}
+
+
+void CatalogItem::SetFlags(const wxString& flags)
+{
+    static const wxString flag_fuzzy(wxS(", fuzzy"));
+
+    m_moreFlags = flags;
+
+    if (flags.find(flag_fuzzy) != wxString::npos)
+    {
+        m_isFuzzy = true;
+        m_moreFlags.Replace(flag_fuzzy, wxString());
+    }
+    else
+    {
+        m_isFuzzy = false;
+    }
+}
+
+
+wxString CatalogItem::GetFlags() const
+{
+    if (m_isFuzzy)
+    {
+        static const wxString flag_fuzzy(wxS(", fuzzy"));
+        if (m_moreFlags.empty())
+            return flag_fuzzy;
+        else
+            return flag_fuzzy + m_moreFlags;
+    }
+    else
+    {
+        return m_moreFlags;
+    }
+}
+
+namespace
+{
+
+std::string ParseFormatFlag(const wxString& flags)
+{
+    if (flags.empty())
+        return std::string();
+
+    auto pos = flags.find(wxS("-format"));
+    if (pos == wxString::npos)
+        return std::string();
+    auto space = flags.find_last_of(" \t", pos);
+    auto format = (space == wxString::npos)
+                    ? flags.substr(0, pos)
+                    : flags.substr(space+1, pos-space-1);
+    if (format.starts_with("no-"))
+        return std::string();
+    return std::string(format.begin(), format.end());
+}
+
+} // anonymous namespace
+
+std::string CatalogItem::GetFormatFlag() const
+{
+    return ParseFormatFlag(m_moreFlags);
+}
+
+std::string CatalogItemSnapshot::GetFormatFlag() const
+{
+    return ParseFormatFlag(m_flags);
+}
+
+void CatalogItem::SetFuzzy(bool fuzzy)
+{
+    if (fuzzy == m_isFuzzy)
+        return;
 
     if (!fuzzy && m_isFuzzy)
+    {
+        EnsureLazyMetadata();
         m_oldMsgid.clear();
+    }
     m_isFuzzy = fuzzy;
 
+    NotifyChanged(true);
     UpdateInternalRepresentation();
 }
 
@@ -904,6 +1650,7 @@ void CatalogItem::SetComment(const wxString& c)
         return;
 
     m_comment = c;
+    m_revision++;
     UpdateInternalRepresentation();
 }
 
@@ -916,6 +1663,12 @@ wxString CatalogItem::GetTranslation(unsigned idx) const
         return m_translations[idx];
 }
 
+const wxString& CatalogItem::GetSideloadedPluralString() const
+{
+    static const wxString empty;
+    return HasPlural() && m_translations.size() > 1 ? m_translations[1] : empty;
+}
+
 void CatalogItem::SetTranslation(const wxString &t, unsigned idx)
 {
     while (idx >= m_translations.GetCount())
@@ -934,6 +1687,7 @@ void CatalogItem::SetTranslation(const wxString &t, unsigned idx)
         }
     }
 
+    NotifyChanged(true);
     UpdateInternalRepresentation();
 }
 
@@ -953,6 +1707,7 @@ void CatalogItem::SetTranslations(const wxArrayString &t)
         }
     }
 
+    NotifyChanged(true);
     UpdateInternalRepresentation();
 }
 
@@ -983,6 +1738,7 @@ void CatalogItem::SetTranslationFromSource()
         }
     }
 
+    NotifyChanged(true);
     UpdateInternalRepresentation();
 }
 
@@ -1002,7 +1758,10 @@ void CatalogItem::ClearTranslation()
     m_isModified = modified;
 
     if (modified)
+    {
+        NotifyChanged(true);
         UpdateInternalRepresentation();
+    }
 }
 
 unsigned CatalogItem::GetPluralFormsCount() const
@@ -1017,7 +1776,7 @@ unsigned CatalogItem::GetPluralFormsCount() const
 wxString CatalogItem::GetOldMsgid() const
 {
     wxString s;
-    for (auto line: m_oldMsgid)
+    for (auto line: GetOldMsgidRaw())
     {
         if (line.length() < 2)
             continue;
@@ -1035,23 +1794,63 @@ wxString CatalogItem::GetOldMsgid() const
 }
 
 
+bool Catalog::ShouldRunQA() const
+{
+    // no errors in POT files
+    bool runQA = HasCapability(Catalog::Cap::Translations);
+#if wxUSE_GUI
+    // TODO: _some_ checks (e.g. plurals) do make sense even with symbolic IDs
+    runQA = runQA && Config::ShowWarnings() && !UsesSymbolicIDsForSource();
+#else
+    runQA = false;
+#endif
+    return runQA;
+}
+
+
 Catalog::ValidationResults Catalog::Validate(const wxString& /*fileWithSameContent*/)
 {
     ValidationResults res;
-
-    for (auto& i: m_items)
-        i->ClearIssue();
     res.errors = 0;
 
-    if (!HasCapability(Catalog::Cap::Translations))
-        return res; // no errors in POT files
+    if (!ShouldRunQA())
+    {
+        m_changeTracker->InvalidateQA();
+        for (auto& i: m_items)
+            i->ClearIssue();
+        return res;
+    }
 
 #if wxUSE_GUI
-    if (Config::ShowWarnings())
+    // QA checks only depend on the item itself and the language, so if
+    // the catalog was checked before, only changed items are re-checked:
+    bool incremental;
+    auto checked = m_changeTracker->TakeItemsForQA(m_items, GetLanguage().Code(), incremental);
+
+    if (incremental)
+    {
+        // Errors were added by derived classes' validation (e.g. msgfmt) on
+        // top of QA issues, which is redone every time, so re-check them too:
+        if (m_changeTracker->UpdateStatistics(m_items).badtokens > 0)
+        {
+            for (auto& i: m_items)
+            {
+                if (i->HasError())
+                    checked.push_back(i);
+            }
+        }
+
+        for (auto& i: checked)
+            i->ClearIssue();
+        QAChecker::GetFor(*this)->Check(checked);
+
+        res.warnings = m_changeTracker->UpdateStatistics(m_items).issues;
+    }
+    else
     {
-        // TODO: _some_ checks (e.g. plurals) do make sense even with symbolic IDs
-        if (!UsesSymbolicIDsForSource())
-            res.warnings = QAChecker::GetFor(*this)->Check(*this);
+        for (auto& i: m_items)
+            i->ClearIssue();
+        res.warnings = QAChecker::GetFor(*this)->Check(*this);
     }
 #endif
 
@@ -1059,6 +1858,96 @@ Catalog::ValidationResults Catalog::Validate(const wxString& /*fileWithSameConte
 }
 
 
+#if wxUSE_GUI
+
+namespace
+{
+
+// Number of items checked before found issues are passed to the main thread
+const size_t BACKGROUND_VALIDATION_BATCH = 512;
+
+} // anonymous namespace
+
+
+void Catalog::ValidateInBackground(const wxString& /*fileWithSameContent*/,
+                                   ValidationProgressHandler progressHandler,
+                                   ValidationCompletionHandler completionHandler)
+{
+    if (!ShouldRunQA())
+    {
+        completionHandler(Catalog::Validate());
+        return;
+    }
+
+    // Check all items, not just those changed since the last validation; any
+    // edits done while checking are then picked up by the next Validate():
+    m_changeTracker->InvalidateQA();
+    bool incremental;
+    m_changeTracker->TakeItemsForQA(m_items, GetLanguage().Code(), incremental);
+
+    for (auto& i: m_items)
+        i->ClearIssue();
+
+    auto checker = QAChecker::GetFor(GetLanguage());
+    auto snapshot = TakeSnapshot();
+
+    typedef std::vector<std::pair<CatalogItemSnapshotPtr, QACheck::IssuePtr>> FoundIssues;
+
+    dispatch::async([=]
+    {
+        TRACE_SPAN("qa", "ValidateInBackground");
+
+        auto& items = snapshot->items();
+        dispatch::parallel_options options;
+        options.chunk_size = BACKGROUND_VALIDATION_BATCH;
+        dispatch::parallel_for_chunked(items.size(), [&](size_t begin, size_t end)
+        {
+            auto found = std::make_shared<FoundIssues>();
+            for (size_t i = begin; i < end; i++)
+            {
+                if (auto issue = checker->Check(*items[i]))
+                    found->emplace_back(items[i], issue);
+            }
+            if (found->empty())
+                return;
+
+            dispatch::on_main([=]
+            {
+                CatalogItemArray updated;
+                for (auto& f: *found)
+                {
+                    auto item = f.first->GetItem();
+                    if (item && item->GetRevision() == f.first->GetRevision())
+                    {
+                        item->SetIssue(f.second);
+                        updated.push_back(item);
+                    }
+                }
+                if (!updated.empty())
+                    progressHandler(updated);
+            });
+        }, options);
+    })
+    .then_on_main([=](dispatch::future<void> done)
+    {
+        try
+        {
+            done.get();
+        }
+        catch (...)
+        {
+            wxLogError("%s", DescribeCurrentException());
+        }
+
+        ValidationResults res;
+        res.warnings = m_changeTracker->UpdateStatistics(m_items).issues;
+        completionHandler(res);
+    });
+}
+
+#endif // wxUSE_GUI
+
+
 void Catalog::PostCreation()
 {
     if (!m_sourceLanguage.IsValid())
@@ -1070,18 +1959,8 @@ void Catalog::PostCreation()
         {
             // detect source language from the text (ignoring plurals for simplicity,
             // as we don't need 100% of the text):
-            std::wstring allText;
-            for (auto& i: items())
-            {
-                auto withoutMarkup = std::regex_replace(i->GetRawString().ToStdWstring(), RE_APPROXIMATE_MARKUP, L" ");
-                allText.append(withoutMarkup);
-                allText += L' ';
-            }
-            if (!allText.empty())
-            {
-                m_sourceLanguage = Language::TryDetectFromText(str::to_utf8(allText));
-                wxLogTrace("poedit", "detected source language is '%s'", m_sourceLanguage.Code());
-            }
+            m_sourceLanguage = DetectLanguageFromSample(items(), [](const CatalogItem& i) -> const wxString& { return i.GetRawString(); });
+            wxLogTrace("poedit", "detected source language is '%s'", m_sourceLanguage.Code());
         }
     }
 
@@ -1101,19 +1980,8 @@ void Catalog::PostCreation()
         if (!lang.IsValid())
         {
             // If all else fails, try to detect the language from content
-            wxString allText;
-            for (auto& i: items())
-            {
-                if (!i->IsTranslated())
-                    continue;
-                allText.append(i->GetTranslation());
-                allText.append('\n');
-            }
-            if (!allText.empty())
-            {
-                lang = Language::TryDetectFromText(str::to_utf8(allText));
-                wxLogTrace("poedit", "detected translation language is '%s'", GetLanguage().Code());
-            }
+            lang = DetectLanguageFromSample(items(), [](const CatalogItem& i){ return i.IsTranslated() ? i.GetTranslation() : wxString(); });
+            wxLogTrace("poedit", "detected translation language is '%s'", lang.Code());
         }
 
         if (lang.IsValid())
@@ -1148,8 +2016,12 @@ CatalogPtr Catalog::Create(Type type)
 
 CatalogPtr Catalog::Create(const wxString& filename, int flags)
 {
+    TRACE_SPAN("catalog", "Load");
+
+    // gzip-compressed files are decompressed when loading and compressed
+    // again when saving by the format implementations:
     wxString ext;
-    wxFileName::SplitPath(filename, nullptr, nullptr, nullptr, &ext);
+    wxFileName::SplitPath(StripGzipExtension(filename), nullptr, nullptr, nullptr, &ext);
     ext.MakeLower();
 
     CatalogPtr cat;
@@ -1191,6 +2063,19 @@ CatalogPtr Catalog::Create(const wxString& filename, int flags)
     cat->SetFileName(filename);
     cat->PostCreation();
 
+    if (tracing::is_enabled())
+    {
+        auto usage = cat->GetMemoryUsage();
+        tracing::counter("catalog memory",
+                         {
+                             {"items", usage.items},
+                             {"strings", usage.strings},
+                             {"references", usage.references},
+                             {"document", usage.document},
+                             {"caches", usage.caches}
+                         });
+    }
+
     return cat;
 }
 
@@ -1206,36 +2091,136 @@ bool Catalog::CanLoadFile(const wxString& extension_)
 }
 
 
-void Catalog::SideloadSourceDataFromReferenceFile(CatalogPtr ref)
+namespace
 {
-    std::map<wxString, CatalogItemPtr> refItems;
 
-    for (auto iref: ref->items())
-        refItems[iref->GetRawString()] = iref;
+// Don't bother with parallelization for small catalogs:
+const size_t MIN_PARALLEL_RANGE_ITEMS = 5000;
 
-    for (auto i: this->items())
+// Calls func(begin, end) for ranges of [0, count), in parallel if worth it
+template<typename Func>
+void ForItemRanges(size_t count, Func&& func)
+{
+#ifdef HAVE_PARALLEL_PROCESSING
+    if (count >= MIN_PARALLEL_RANGE_ITEMS)
     {
-        auto ri = refItems.find(i->GetRawString());
-        if (ri == refItems.end())
-            continue;
+        dispatch::parallel_for_chunked(count, func);
+        return;
+    }
+#endif
+    func(0, count);
+}
 
-        auto& rdata = *ri->second;
-        if (rdata.GetTranslation().empty())
-            continue;
+bool IsSameAsSourceTranslation(const CatalogItem& item, unsigned pluralFormsCount)
+{
+    if (item.GetString() != item.GetTranslation())
+        return false;
 
-        auto d = std::make_shared<SideloadedItemData>();
-        d->source_string = rdata.GetTranslation();
-        if (rdata.HasPlural())
-            d->source_plural_string = rdata.GetTranslation(1);
-        if (rdata.HasExtractedComments())
-            d->extracted_comments = rdata.GetExtractedComments();
+    if (item.HasPlural())
+    {
+        // we can only easily do this operation for languages that have singular+plural, skip everything else:
+        if (pluralFormsCount != 2 || item.GetPluralString() != item.GetTranslation(1))
+            return false;
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
+CatalogItemArray Catalog::FindSameAsSourceTranslations()
+{
+    TRACE_SPAN("catalog", "FindSameAsSourceTranslations");
 
-        i->AttachSideloadedData(d);
+    const unsigned pluralFormsCount = GetPluralForms().nplurals();
+
+    // items are only compared in parallel, found ones are collected in order afterwards:
+    std::vector<char> found(m_items.size(), 0);
+    ForItemRanges(m_items.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            found[i] = IsSameAsSourceTranslation(*m_items[i], pluralFormsCount);
+    });
+
+    CatalogItemArray items;
+    for (size_t i = 0; i < found.size(); i++)
+    {
+        if (found[i])
+            items.push_back(m_items[i]);
     }
+    return items;
+}
+
+int Catalog::RemoveSameAsSourceTranslations()
+{
+    auto items = FindSameAsSourceTranslations();
+    if (items.empty())
+        return 0;
+
+    TRACE_SPAN("catalog", "RemoveSameAsSourceTranslations");
+
+    // statistics etc. are updated once for all cleared items when the batch ends:
+    ItemsBatch batch(*this, items);
+    ForItemRanges(items.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            items[i]->ClearTranslation();
+    });
+
+    return int(items.size());
+}
+
+void Catalog::SideloadSourceDataFromReferenceFile(CatalogPtr ref)
+{
+    TRACE_SPAN("catalog", "SideloadSourceDataFromReferenceFile");
+
+    // Index of the reference file's items by hash of their raw string (i.e.
+    // symbolic ID), sorted by the hash and then by position, so that items
+    // with the same hash are found with a binary search:
+    typedef std::pair<size_t, size_t> IndexEntry;
+    auto& refItems = ref->items();
+    std::vector<IndexEntry> index(refItems.size());
+    ForItemRanges(refItems.size(), [&](size_t begin, size_t end)
+    {
+        wxStringHash hash;
+        for (size_t i = begin; i < end; i++)
+            index[i] = {hash(refItems[i]->GetRawString()), i};
+    });
+    std::sort(index.begin(), index.end());
+
+    ForItemRanges(m_items.size(), [&](size_t begin, size_t end)
+    {
+        wxStringHash hash;
+        for (size_t i = begin; i < end; i++)
+        {
+            auto& item = m_items[i];
+            auto& id = item->GetRawString();
+            const size_t h = hash(id);
+            auto range = std::equal_range(index.begin(), index.end(), IndexEntry(h, 0),
+                                          [](const IndexEntry& a, const IndexEntry& b){ return a.first < b.first; });
+
+            // if the ID is duplicated, the last occurrence wins:
+            CatalogItemPtr found;
+            for (auto r = range.first; r != range.second; ++r)
+            {
+                auto& candidate = refItems[r->second];
+                if (candidate->GetRawString() == id)
+                    found = candidate;
+            }
+
+            if (!found || found->GetTranslations().empty() || found->GetTranslations()[0].empty())
+                continue;
+
+            item->AttachSideloadedData(found);
+        }
+    });
 
     m_sideloaded = std::make_shared<SideloadedCatalogData>();
     m_sideloaded->reference_file = ref;
     m_sideloaded->source_language = ref->GetLanguage();
+
+    // source texts changed for (potentially) all items:
+    InvalidateChangeTracking();
 }
 
 void Catalog::ClearSideloadedSourceData()
@@ -1243,4 +2228,176 @@ void Catalog::ClearSideloadedSourceData()
     m_sideloaded.reset();
     for (auto i: this->items())
         i->ClearSideloadedData();
+
+    InvalidateChangeTracking();
+}
+
+
+// ----------------------------------------------------------------------
+// CatalogReferencesIndex
+// ----------------------------------------------------------------------
+
+CatalogReferencesIndex::CatalogReferencesIndex(const CatalogItemArray& items)
+    : m_itemsCount(items.size())
+{
+    TRACE_SPAN("catalog", "BuildReferencesIndex");
+
+    // parse all references first, that's the expensive part:
+    std::vector<std::vector<std::pair<wxString, int>>> parsed(items.size());
+    ForItemRanges(items.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            for (auto& ref: items[i]->GetReferences())
+            {
+                wxString file;
+                int line;
+                ParseReference(ref, file, line);
+                parsed[i].emplace_back(file, line);
+            }
+        }
+    });
+
+    // then add them in items' order, so that occurrences are sorted:
+    for (size_t i = 0; i < parsed.size(); i++)
+    {
+        for (auto& p: parsed[i])
+        {
+            auto& entry = m_files[p.first];
+            entry.occurrences.push_back({int(i), p.second});
+            if (p.second)
+            {
+                entry.minLine = entry.minLine ? std::min(entry.minLine, p.second) : p.second;
+                entry.maxLine = std::max(entry.maxLine, p.second);
+            }
+        }
+    }
+}
+
+void CatalogReferencesIndex::ParseReference(const wxString& ref, wxString& file, int& line)
+{
+    line = 0;
+
+    auto colon = ref.rfind(':');
+    if (colon != wxString::npos && colon > 0)
+    {
+        long number;
+        if (ref.substr(colon + 1).BeforeFirst('(').ToLong(&number) && number >= 0)
+        {
+            file = ref.substr(0, colon);
+            line = int(number);
+            return;
+        }
+    }
+
+    // no line number, or a non-standard reference such as a hyperlink:
+    file = ref;
+}
+
+const CatalogReferencesIndex::Occurrences& CatalogReferencesIndex::GetOccurrences(const wxString& file) const
+{
+    static const Occurrences s_none;
+    auto i = m_files.find(file);
+    return i != m_files.end() ? i->second.occurrences : s_none;
+}
+
+std::pair<int, int> CatalogReferencesIndex::GetLinesRange(const wxString& file) const
+{
+    auto i = m_files.find(file);
+    if (i == m_files.end())
+        return {0, 0};
+    return {i->second.minLine, i->second.maxLine};
+}
+
+std::vector<wxString> CatalogReferencesIndex::GetFiles() const
+{
+    std::vector<wxString> files;
+    files.reserve(m_files.size());
+    for (auto& f: m_files)
+        files.push_back(f.first);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+
+size_t CatalogReferencesIndex::GetMemoryUsage() const
+{
+    size_t size = sizeof(*this) + m_files.bucket_count() * sizeof(void*);
+    for (auto& f: m_files)
+    {
+        size += sizeof(f) + sizeof(void*) + CatalogMemoryUsage::Of(f.first);
+        size += f.second.occurrences.capacity() * sizeof(Occurrence);
+    }
+    return size;
+}
+
+
+std::shared_ptr<const CatalogReferencesIndex> Catalog::GetReferencesIndex()
+{
+    if (m_referencesIndex.valid())
+    {
+        // waits for PrepareReferencesIndex() if it's still running:
+        auto index = m_referencesIndex.get();
+        if (index->GetItemsCount() == m_items.size())
+            return index;
+    }
+
+    auto index = std::make_shared<const CatalogReferencesIndex>(m_items);
+    std::promise<std::shared_ptr<const CatalogReferencesIndex>> ready;
+    ready.set_value(index);
+    m_referencesIndex = ready.get_future().share();
+    return index;
+}
+
+void Catalog::PrepareReferencesIndex()
+{
+#ifdef HAVE_PARALLEL_PROCESSING
+    if (m_referencesIndex.valid())
+        return;
+
+    // the task works with a copy of the items array, which may be modified
+    // on the main thread in the meantime (the index is then discarded):
+    auto promise = std::make_shared<std::promise<std::shared_ptr<const CatalogReferencesIndex>>>();
+    m_referencesIndex = promise->get_future().share();
+    dispatch::async([promise, items = m_items]
+    {
+        try
+        {
+            promise->set_value(std::make_shared<const CatalogReferencesIndex>(items));
+        }
+        catch (...)
+        {
+            promise->set_exception(std::current_exception());
+        }
+    });
+#endif
+}
+
+
+CatalogMemoryUsage Catalog::GetMemoryUsage() const
+{
+    CatalogMemoryUsage usage;
+
+    usage.items = m_items.capacity() * sizeof(CatalogItemPtr);
+    if (m_itemsArena)
+        usage.items += m_itemsArena->GetAllocatedSize();
+
+    for (auto& item: m_items)
+        item->AddMemoryUsage(usage);
+
+    if (m_changeTracker)
+        usage.caches += m_changeTracker->GetMemoryUsage();
+    usage.caches += m_lineIndex.capacity() * sizeof(int);
+    // don't wait for the index if it's still being built:
+    if (m_referencesIndex.valid() && m_referencesIndex.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        try
+        {
+            usage.caches += m_referencesIndex.get()->GetMemoryUsage();
+        }
+        catch (...) {} // failed to build, doesn't use any memory
+    }
+
+    AddFormatMemoryUsage(usage);
+    return usage;
 }
@@ -31,11 +31,20 @@
 #include <wx/encconv.h>
 #include <wx/arrstr.h>
 #include <wx/textfile.h>
+#include <wx/hashmap.h>
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
 #include <initializer_list>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 #include <vector>
 
 class CloudSyncDestination;
@@ -43,35 +52,58 @@ struct SourceCodeSpec;
 
 class Catalog;
 class CatalogItem;
+class CatalogItemSnapshot;
+class CatalogSnapshot;
+class CatalogChangeTracker;
+struct SourceHighlightsCache;
+class TextDiff;
 typedef std::shared_ptr<CatalogItem> CatalogItemPtr;
 typedef std::shared_ptr<Catalog> CatalogPtr;
+typedef std::shared_ptr<const CatalogItemSnapshot> CatalogItemSnapshotPtr;
+typedef std::shared_ptr<const CatalogSnapshot> CatalogSnapshotPtr;
 
 
 /**
-    Optional data attached to CatalogItem.
+    Optional data attached to Catalog.
 
     Used primarily in connection wiht UsesSymbolicIDsForSource() to provide
     read source strings.
  */
-struct SideloadedItemData
+struct SideloadedCatalogData
 {
-    /// Source string replacement
-    wxString source_string, source_plural_string;
-
-    /// Extracted comments / description (used by 
-    wxArrayString extracted_comments;
+    CatalogPtr reference_file;
+    Language source_language;
 };
 
+
 /**
-    Optional data attached to Catalog.
+    Approximate memory used by a catalog, in bytes, broken down by kind.
 
-    Used primarily in connection wiht UsesSymbolicIDsForSource() to provide
-    read source strings.
+    Meant for diagnosing excessive memory usage, not for exact accounting:
+    allocator overhead is ignored and sizes of library structures are only
+    estimated.
+
+    @see Catalog::GetMemoryUsage()
  */
-struct SideloadedCatalogData
+struct CatalogMemoryUsage
 {
-    CatalogPtr reference_file;
-    Language source_language;
+    size_t items = 0;       ///< item objects and the list of them
+    size_t strings = 0;     ///< texts, translations, comments and other strings of the items
+    size_t references = 0;  ///< references to source code, including interned file names
+    size_t document = 0;    ///< in-memory DOM of XML and JSON files
+    size_t caches = 0;      ///< snapshots, indexes and other data derived from the items
+
+    size_t Total() const { return items + strings + references + document + caches; }
+
+    /// Returns memory used by the content of a string
+    static size_t Of(const wxString& s) { return s.empty() ? 0 : (s.length() + 1) * sizeof(wxChar); }
+    static size_t Of(const wxArrayString& a)
+    {
+        size_t size = a.size() * sizeof(wxString);
+        for (auto& s: a)
+            size += Of(s);
+        return size;
+    }
 };
 
 
@@ -82,7 +114,7 @@ struct SideloadedCatalogData
 
     This class is mostly internal, used by Catalog to store data.
  */
-class CatalogItem
+class CatalogItem : public std::enable_shared_from_this<CatalogItem>
 {
     protected:
         /// Ctor. Initializes the object with source string and translation.
@@ -119,10 +151,10 @@ class CatalogItem
         bool HasSymbolicId() const { return !GetSymbolicId().empty(); }
 
         /// Returns the source string.
-        const wxString& GetString() const { return m_sideloaded ? m_sideloaded->source_string : GetRawString(); }
+        const wxString& GetString() const { return m_sideloaded ? m_sideloaded->m_translations[0] : GetRawString(); }
 
         /// Returns the plural string.
-        const wxString& GetPluralString() const { return m_sideloaded ? m_sideloaded->source_plural_string : GetRawPluralString(); }
+        const wxString& GetPluralString() const { return m_sideloaded ? m_sideloaded->GetSideloadedPluralString() : GetRawPluralString(); }
 
         /// Does this entry have a msgid_plural?
         bool HasPlural() const { return m_hasPlural; }
@@ -157,7 +189,13 @@ class CatalogItem
         const wxString& GetComment() const { return m_comment; }
 
         /// Returns array of all auto comments.
-        const wxArrayString& GetExtractedComments() const { return m_sideloaded ? m_sideloaded->extracted_comments : m_extractedComments; }
+        const wxArrayString& GetExtractedComments() const
+        {
+            if (m_sideloaded)
+                return m_sideloaded->GetExtractedComments();
+            EnsureLazyMetadata();
+            return m_extractedComments;
+        }
 
         /// Convenience function: does this entry has a comment?
         bool HasComment() const { return !m_comment.empty(); }
@@ -186,9 +224,35 @@ class CatalogItem
         /// Get line number of this entry.
         int GetLineNumber() const { return m_lineNum; }
 
-        const wxArrayString& GetOldMsgidRaw() const { return m_oldMsgid; }
+        /// Bits returned by GetStatusFlags()
+        enum StatusFlags : uint8_t
+        {
+            Status_Fuzzy         = 0x01,
+            Status_Translated    = 0x02,
+            Status_Modified      = 0x04,
+            Status_PreTranslated = 0x08,
+            Status_Issue         = 0x10,
+            Status_Error         = 0x20
+        };
+
+        /// Returns compact summary of the item's status, see Catalog::GetItemsStatus()
+        uint8_t GetStatusFlags() const
+        {
+            return (m_isFuzzy ? Status_Fuzzy : 0) |
+                   (m_isTranslated ? Status_Translated : 0) |
+                   (m_isModified ? Status_Modified : 0) |
+                   (m_isPreTranslated ? Status_PreTranslated : 0) |
+                   (m_issue ? Status_Issue : 0) |
+                   (HasError() ? Status_Error : 0);
+        }
+
+        /// Revision of the item's content, incremented whenever its text
+        /// (translations, flags, comment, source) is changed after loading.
+        unsigned GetRevision() const { return m_revision; }
+
+        const wxArrayString& GetOldMsgidRaw() const { EnsureLazyMetadata(); return m_oldMsgid; }
         wxString GetOldMsgid() const;
-        bool HasOldMsgid() const { return !m_oldMsgid.empty(); }
+        bool HasOldMsgid() const { return !GetOldMsgidRaw().empty(); }
 
 
         // -------------------------------------------------------------------
@@ -212,11 +276,11 @@ class CatalogItem
         /// Sets fuzzy flag.
         void SetFuzzy(bool fuzzy);
         /// Sets translated flag.
-        void SetTranslated(bool t) { m_isTranslated = t; }
+        void SetTranslated(bool t) { m_isTranslated = t; NotifyChanged(true); }
         /// Sets modified flag.
-        void SetModified(bool modified) { m_isModified = modified; }
+        void SetModified(bool modified) { m_isModified = modified; NotifyStatusChanged(); }
         /// Sets pre-translated translation flag.
-        void SetPreTranslated(bool pre) { m_isPreTranslated = pre; }
+        void SetPreTranslated(bool pre) { m_isPreTranslated = pre; NotifyStatusChanged(); }
 
         /// Sets the comment.
         void SetComment(const wxString& c);
@@ -245,18 +309,83 @@ class CatalogItem
         bool HasError() const { return m_issue && m_issue->severity == Issue::Error; }
         const std::shared_ptr<Issue>& GetIssue() const { return m_issue; }
 
-        void ClearIssue() { m_issue.reset(); }
-        void SetIssue(std::shared_ptr<Issue> issue) { m_issue = issue; }
-        void SetIssue(const Issue& issue) { m_issue = std::make_shared<Issue>(issue); }
-        void SetIssue(Issue::Severity severity, const wxString& message) { m_issue = std::make_shared<Issue>(severity, message); }
+        void ClearIssue() { if (m_issue) { m_issue.reset(); NotifyChanged(false); } }
+        void SetIssue(std::shared_ptr<Issue> issue) { m_issue = issue; NotifyChanged(false); }
+        void SetIssue(const Issue& issue) { SetIssue(std::make_shared<Issue>(issue)); }
+        void SetIssue(Issue::Severity severity, const wxString& message) { SetIssue(std::make_shared<Issue>(severity, message)); }
 
-        void AttachSideloadedData(const std::shared_ptr<SideloadedItemData>& d) { m_sideloaded = d; }
-        void ClearSideloadedData() { m_sideloaded.reset(); }
+        /**
+            Use the translation and extracted comments of @a ref, an item of
+            the reference file, as this item's source text and comments.
+
+            The strings are not copied, @a ref must not be modified while
+            attached. It must have a non-empty translation.
+         */
+        void AttachSideloadedData(const std::shared_ptr<const CatalogItem>& ref) { m_sideloaded = ref; m_syntaxFeatures = 0; m_revision++; }
+        void ClearSideloadedData() { m_sideloaded.reset(); m_syntaxFeatures = 0; m_revision++; }
+
+        /**
+            Returns immutable copy of the item's current content.
+
+            The copy is reused for as long as the item doesn't change, so this
+            is cheap when called repeatedly. Must be called from the thread
+            that modifies the item (i.e. the main thread for opened files).
+         */
+        CatalogItemSnapshotPtr GetSnapshot() const;
+
+        /// Case-folded texts of the item, see GetFoldedTexts()
+        struct FoldedTexts
+        {
+            wxString string, pluralString, context, symbolicId;
+            wxArrayString translations;
+            wxString comment;
+            wxArrayString extractedComments;
+
+            unsigned revision = 0;
+        };
+
+        /**
+            Returns the item's texts case-folded (see unicode::fold_case()),
+            for matching them case-insensitively.
+
+            They are computed on first use and kept until the item changes,
+            so that finding, filtering and other case-insensitive lookups
+            don't have to fold the same texts over again. Computing them is
+            expensive, so call this from parallel code when processing many
+            items. Safe to call from any thread for as long as the item isn't
+            modified at the same time.
+         */
+        std::shared_ptr<const FoldedTexts> GetFoldedTexts() const;
+
+        /**
+            Adds memory used by the item's data to @a usage.
+
+            The object itself isn't included, it's accounted for by its catalog.
+            Must be called from the thread that modifies the item.
+         */
+        virtual void AddMemoryUsage(CatalogMemoryUsage& usage) const;
 
     protected:
         // API for subclasses:
         virtual void UpdateInternalRepresentation() = 0;
 
+        /**
+            Loads rarely needed data (extracted comments, previous msgids) that
+            the subclass chose not to extract when loading the file.
+
+            Only called if m_hasLazyMetadata is set; the implementation must
+            reset it once done and must be thread-safe, because the getters
+            may be called from background threads.
+         */
+        virtual void LoadLazyMetadata() {}
+
+        /// Calls LoadLazyMetadata() if needed; must be used before modifying lazily loaded data
+        void EnsureLazyMetadata() const
+        {
+            if (m_hasLazyMetadata.load(std::memory_order_acquire))
+                const_cast<CatalogItem*>(this)->LoadLazyMetadata(); // logically const
+        }
+
     protected:
         // -------------------------------------------------------------------
         // Private data setters only for internal use:
@@ -267,13 +396,16 @@ class CatalogItem
         void SetString(const wxString& s)
         {
             m_string = s;
+            m_syntaxFeatures = 0;
             ClearIssue();
+            NotifyChanged(true);
         }
 
         void SetPluralString(const wxString& p)
         {
             m_plural = p;
             m_hasPlural = true;
+            m_syntaxFeatures = 0;
         }
 
         void SetContext(const wxString& context)
@@ -286,10 +418,11 @@ class CatalogItem
 
         void AddExtractedComments(const wxString& com)
         {
+            EnsureLazyMetadata();
             m_extractedComments.Add(com);
         }
 
-        void SetOldMsgid(const wxArrayString& data) { m_oldMsgid = data; }
+        void SetOldMsgid(const wxArrayString& data) { EnsureLazyMetadata(); m_oldMsgid = data; }
 
         /** Sets gettext flags directly in string format. It may be
             either empty string or ", fuzzy", ", c-format",
@@ -317,13 +450,300 @@ class CatalogItem
         int m_lineNum;
 
         std::shared_ptr<Issue> m_issue;
-        std::shared_ptr<SideloadedItemData> m_sideloaded;
+        // item of the reference file providing source text, if any:
+        std::shared_ptr<const CatalogItem> m_sideloaded;
+
+        /// Set by subclasses whose metadata are yet to be loaded by LoadLazyMetadata()
+        mutable std::atomic<bool> m_hasLazyMetadata{false};
+
+    private:
+        /// Let the owning catalog know about the change, so that it can update
+        /// statistics and (if @a content changed) QA issues incrementally.
+        void NotifyChanged(bool content);
+        /// Like NotifyChanged(), for flags that only affect GetStatusFlags()
+        void NotifyStatusChanged();
+
+        /// Plural source string when used as sideloaded reference item
+        const wxString& GetSideloadedPluralString() const;
+
+        // Change tracking state, maintained by CatalogChangeTracker:
+        friend class CatalogChangeTracker;
+        std::weak_ptr<CatalogChangeTracker> m_changeTracker;
+        unsigned m_statusSlot = unsigned(-1);
+        unsigned m_trackedStats = 0;
+        bool m_pendingQA = false;
+        unsigned m_revision = 0;
+        // while the item is in Catalog::ItemsBatch, notifications are only
+        // recorded here and processed when the batch ends:
+        enum { Batch_Active = 1, Batch_Status = 2, Batch_Content = 4 };
+        std::atomic<uint8_t> m_batchState{0};
+        bool DeferToBatch(uint8_t changes);
+
+        // Source text features detected by SyntaxHighlighter::ForItem(),
+        // reset whenever the source text changes:
+        friend class SyntaxHighlighter;
+        mutable std::atomic<unsigned> m_syntaxFeatures{0};
+        // highlighting of source text, see SyntaxHighlighter::HighlightSource();
+        // only valid if m_syntaxFeatures says so
+        mutable std::shared_ptr<SourceHighlightsCache> m_sourceHighlights;
+
+        // diff of GetOldMsgid() and the source text, see TextDiff::ComputeForOldMsgid();
+        // verified when used, so doesn't need resetting when the texts change
+        friend class TextDiff;
+        mutable std::shared_ptr<const TextDiff> m_oldMsgidDiff;
+
+        // cached GetFoldedTexts(), valid while its revision matches m_revision;
+        // only accessed atomically:
+        mutable std::shared_ptr<const FoldedTexts> m_foldedTexts;
+
+        // the most recent GetSnapshot(), reused while the item doesn't change:
+        mutable CatalogItemSnapshotPtr m_snapshot;
+};
+
+
+/**
+    Immutable copy of CatalogItem's content, see CatalogItem::GetSnapshot().
+
+    Snapshots can be used from any thread, regardless of changes made to the
+    item since. Accessors mirror those of CatalogItem, except for rarely needed
+    metadata such as extracted comments: it isn't copied, so that taking
+    snapshots doesn't force loading of lazily loaded data.
+ */
+/// Word and character counts of an item's texts, see catalog_stats.h
+struct ItemTextCounts
+{
+    uint32_t sourceWords = 0, sourceChars = 0;
+    uint32_t translationWords = 0, translationChars = 0;
+};
+
+
+class CatalogItemSnapshot
+{
+public:
+    explicit CatalogItemSnapshot(const CatalogItem& item);
+
+    CatalogItemSnapshot(const CatalogItemSnapshot&) = delete;
+    CatalogItemSnapshot& operator=(const CatalogItemSnapshot&) = delete;
+
+    /// Returns the original item, if it still exists
+    CatalogItemPtr GetItem() const { return m_item.lock(); }
+
+    int GetId() const { return m_id; }
+    unsigned GetRevision() const { return m_revision; }
+    uint8_t GetStatusFlags() const { return m_status; }
+
+    const wxString& GetString() const { return m_string; }
+    bool HasPlural() const { return m_hasPlural; }
+    const wxString& GetPluralString() const { return m_plural; }
+    bool HasContext() const { return m_hasContext; }
+    const wxString& GetContext() const { return m_context; }
+
+    unsigned GetNumberOfTranslations() const { return (unsigned)m_translations.size(); }
+    wxString GetTranslation(unsigned n = 0) const { return n < m_translations.size() ? m_translations[n] : wxString(); }
+    const wxArrayString& GetTranslations() const { return m_translations; }
+
+    const wxString& GetComment() const { return m_comment; }
+    const wxString& GetFlags() const { return m_flags; }
+    std::string GetFormatFlag() const;
+
+    bool IsFuzzy() const { return m_status & CatalogItem::Status_Fuzzy; }
+    bool IsTranslated() const { return m_status & CatalogItem::Status_Translated; }
+    bool IsModified() const { return m_status & CatalogItem::Status_Modified; }
+    bool IsPreTranslated() const { return m_status & CatalogItem::Status_PreTranslated; }
+
+    bool HasIssue() const { return m_issue != nullptr; }
+    bool HasError() const { return m_status & CatalogItem::Status_Error; }
+    const std::shared_ptr<CatalogItem::Issue>& GetIssue() const { return m_issue; }
+
+    /**
+        Returns word counts of the item's texts, computed on first use.
+
+        Snapshots of unchanged items are reused, so this caches the counts
+        until the item is modified. Thread-safe; implemented in catalog_stats.cpp.
+     */
+    const ItemTextCounts& GetTextCounts(const Language& srclang, const Language& lang) const;
+
+private:
+    std::weak_ptr<CatalogItem> m_item;
+    int m_id;
+    unsigned m_revision;
+    uint8_t m_status;
+
+    wxString m_string, m_plural, m_context;
+    bool m_hasPlural, m_hasContext;
+    wxArrayString m_translations;
+    wxString m_comment;
+    wxString m_flags;
+    std::shared_ptr<CatalogItem::Issue> m_issue;
+
+    mutable std::once_flag m_textCountsOnce;
+    mutable ItemTextCounts m_textCounts;
 };
 
 
 typedef std::vector<CatalogItemPtr> CatalogItemArray;
 
 
+/**
+    Memory pool that catalog items are allocated from.
+
+    Memory is taken from large blocks by bump allocation and is returned to
+    the system all at once, when the arena is destroyed. Items keep their
+    arena alive (through the allocator stored in shared_ptr's control block),
+    so it may safely outlive the catalog that created it.
+
+    Memory of individual items isn't reused after they are destroyed, so a
+    new arena should be used when replacing all of catalog's items.
+ */
+class CatalogItemsArena
+{
+public:
+    CatalogItemsArena() {}
+    CatalogItemsArena(const CatalogItemsArena&) = delete;
+    CatalogItemsArena& operator=(const CatalogItemsArena&) = delete;
+
+    /// Allocates @a size bytes aligned to @a alignment. Thread-safe.
+    void *Allocate(size_t size, size_t alignment);
+
+    /// Returns total size of memory blocks allocated by the arena. Thread-safe.
+    size_t GetAllocatedSize() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_allocated;
+    }
+
+    /// Standard allocator allocating from the arena; deallocation is no-op.
+    template<typename T>
+    class Allocator
+    {
+    public:
+        typedef T value_type;
+
+        explicit Allocator(std::shared_ptr<CatalogItemsArena> arena) : m_arena(std::move(arena)) {}
+        template<typename U>
+        Allocator(const Allocator<U>& other) : m_arena(other.m_arena) {}
+
+        T *allocate(size_t n) { return static_cast<T*>(m_arena->Allocate(n * sizeof(T), alignof(T))); }
+        void deallocate(T*, size_t) {}
+
+        template<typename U> bool operator==(const Allocator<U>& other) const { return m_arena == other.m_arena; }
+        template<typename U> bool operator!=(const Allocator<U>& other) const { return m_arena != other.m_arena; }
+
+    private:
+        template<typename U> friend class Allocator;
+        std::shared_ptr<CatalogItemsArena> m_arena;
+    };
+
+    /// Creates object of type T (a CatalogItem subclass) in @a arena.
+    template<typename T, typename... Args>
+    static std::shared_ptr<T> Make(const std::shared_ptr<CatalogItemsArena>& arena, Args&&... args)
+    {
+        return std::allocate_shared<T>(Allocator<T>(arena), std::forward<Args>(args)...);
+    }
+
+private:
+    static const size_t BLOCK_SIZE = 256 * 1024;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    char *m_next = nullptr;
+    size_t m_available = 0;
+    size_t m_allocated = 0;
+};
+
+
+/**
+    Table of interned strings, shared by catalog's items.
+
+    Used for metadata that repeats across many items (e.g. source file paths
+    in references): the items only store small IDs of the strings instead of
+    their copies. Strings are never removed from the table. Thread-safe.
+ */
+class InternedStrings
+{
+public:
+    typedef uint32_t Id;
+
+    InternedStrings() {}
+    InternedStrings(const InternedStrings&) = delete;
+    InternedStrings& operator=(const InternedStrings&) = delete;
+
+    /// Returns ID of the string, adding it to the table if necessary.
+    Id Intern(const wxString& str);
+
+    /// Returns string with given ID.
+    wxString Get(Id id) const;
+
+    /// Returns approximate memory used by the table.
+    size_t GetMemoryUsage() const;
+
+private:
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<wxString, Id, wxStringHash, wxStringEqual> m_ids;
+    std::deque<wxString> m_strings;
+    size_t m_memoryUsage = 0;
+};
+
+
+/**
+    Index of catalog items by the source files they reference.
+
+    Items' references are relatively expensive to obtain (they are parsed
+    on every GetReferences() call), so they are processed only once here and
+    e.g. all items from a given source file can then be found without going
+    through all of the items. Immutable and therefore thread-safe.
+
+    @see Catalog::GetReferencesIndex()
+ */
+class CatalogReferencesIndex
+{
+public:
+    /// Reference to a source file location
+    struct Occurrence
+    {
+        int item;   ///< index of the item in the catalog
+        int line;   ///< line number, 0 if not known
+    };
+    typedef std::vector<Occurrence> Occurrences;
+
+    explicit CatalogReferencesIndex(const CatalogItemArray& items);
+
+    /**
+        Splits reference into the file name and line number.
+
+        References are usually in the "file:line" form, with the line being
+        optional (in which case @a line is set to 0). GNOME xml2po's extension
+        "file:line(xml_node)" is supported too.
+     */
+    static void ParseReference(const wxString& ref, wxString& file, int& line);
+
+    /// Returns all occurrences in @a file, sorted by item index; empty if there are none.
+    const Occurrences& GetOccurrences(const wxString& file) const;
+
+    /// Returns the lowest and highest line numbers referenced in @a file, (0,0) if none.
+    std::pair<int, int> GetLinesRange(const wxString& file) const;
+
+    /// Returns all referenced files, sorted.
+    std::vector<wxString> GetFiles() const;
+
+    /// Number of items the index was built from
+    size_t GetItemsCount() const { return m_itemsCount; }
+
+    /// Returns approximate memory used by the index.
+    size_t GetMemoryUsage() const;
+
+private:
+    struct FileEntry
+    {
+        Occurrences occurrences;
+        int minLine = 0, maxLine = 0;
+    };
+
+    size_t m_itemsCount;
+    std::unordered_map<wxString, FileEntry, wxStringHash, wxStringEqual> m_files;
+};
+
+
 /** This class stores all translations, together with filelists, references
     and other additional information. It can read .po files and save both
     .mo and .po files. Furthermore, it provides facilities for updating the
@@ -367,6 +787,10 @@ class Catalog
                 (i.e. list of key:value\n entries). */
             void FromString(const wxString& str);
 
+            /** Returns charset declared in header string @a str (in the same
+                format as FromString() takes), without parsing the rest of it. */
+            static wxString ParseCharset(const wxString& str);
+
             /** Converts the header into string representation that can be
                 directly written to .po file as msgid "". */
             wxString ToString(const wxString& line_delim = wxEmptyString);
@@ -414,8 +838,19 @@ class Catalog
 
         protected:
             Entries m_entries;
+            // position of the first entry with given key in m_entries:
+            std::unordered_map<wxString, size_t, wxStringHash, wxStringEqual> m_index;
 
+            // result of the last ToString(), valid until the entries change:
+            wxString m_serialized, m_serializedDelim;
+            bool m_serializedValid = false;
+
+            void ParseEntries(const wxString& str);
             const Entry *Find(const wxString& key) const;
+            void RebuildIndex();
+
+            // Sets headers named @a format (with %i for number) to @a values
+            void SetNumberedHeaders(const char *format, const wxArrayString& values);
 
             void NormalizeHeaderOrder();
         };
@@ -423,7 +858,15 @@ class Catalog
         enum CreationFlags
         {
             CreationFlag_IgnoreHeader       = 1,
-            CreationFlag_IgnoreTranslations = 2
+            CreationFlag_IgnoreTranslations = 2,
+            /// Only load the header and statistics, without creating items.
+            /// The catalog is empty (no items), but GetStatistics() works.
+            /// Only used by formats that support it (PO), ignored otherwise.
+            CreationFlag_StatisticsOnly     = 4,
+            /// Only load the header and the first entries of large files,
+            /// for quick previews; see IsPartiallyLoaded().
+            /// Only used by formats that support it (PO), ignored otherwise.
+            CreationFlag_Preview            = 8
         };
 
         enum class CompilationStatus
@@ -455,7 +898,7 @@ class Catalog
 
         virtual wxString GetPreferredExtension() const = 0;
 
-        virtual ~Catalog() {}
+        virtual ~Catalog();
 
         /** Creates new, empty header. Sets Charset to something meaningful
             ("UTF-8", currently).
@@ -495,6 +938,16 @@ class Catalog
         /// Exports the catalog to HTML format
         void ExportToHTML(std::ostream& output);
 
+        /**
+            Exports the catalog to HTML split into pages of @a itemsPerPage
+            entries, for catalogs too large to view as a single page.
+
+            @a filename is written as an index with the summary and links to
+            the pages, which are written next to it as name-1.html etc.
+            Throws on failure.
+         */
+        void ExportToPaginatedHTML(const wxString& filename, size_t itemsPerPage);
+
         Type GetFileType() const { return m_fileType; }
 
         wxString GetFileName() const { return m_fileName; }
@@ -541,10 +994,87 @@ class Catalog
 
             @note "untranslated" are entries without translation; "unfinished"
                   are entries with any problems
+
+            @note For catalogs created with CreationFlag_StatisticsOnly, the
+                  values computed during loading are returned.
          */
         void GetStatistics(int *all, int *fuzzy, int *badtokens,
                            int *untranslated, int *unfinished);
 
+        /**
+            Returns status flags (see CatalogItem::GetStatusFlags()) of all
+            items, indexed by their position in items().
+
+            The dense table is kept up to date by items' setters, so scanning
+            it doesn't need to touch the items themselves. If @a revision is
+            not null, it's set to the table's revision (see
+            GetItemsStatusRevision()).
+         */
+        std::vector<uint8_t> GetItemsStatus(uint64_t *revision = nullptr) const;
+
+        /**
+            Returns revision of the status table returned by GetItemsStatus().
+
+            The revision changes whenever any item's status flags change or
+            items are added or removed, so data derived from the table can be
+            cheaply checked for staleness.
+         */
+        uint64_t GetItemsStatusRevision() const;
+
+        /**
+            Groups changes to many items, e.g. by operations on all selected items.
+
+            While the batch exists, changes to its items are not propagated to
+            the catalog's statistics, status table and pending QA checks one by
+            one; they are all processed at once when the batch is destroyed.
+            The items may be modified from any thread (e.g. by parallel
+            pre-translation) until then.
+         */
+        class ItemsBatch
+        {
+        public:
+            ItemsBatch(Catalog& catalog, const CatalogItemArray& items);
+            ~ItemsBatch();
+
+            ItemsBatch(const ItemsBatch&) = delete;
+            ItemsBatch& operator=(const ItemsBatch&) = delete;
+
+        private:
+            std::shared_ptr<CatalogChangeTracker> m_tracker;
+            CatalogItemArray m_items;
+        };
+
+        /**
+            Applies @a func to all @a items as a single batch of changes.
+
+            @a func takes CatalogItem& and returns true if it modified the item.
+            Returns the number of modified items.
+
+            @see ItemsBatch
+         */
+        template<typename F>
+        int ModifyItems(const CatalogItemArray& items, F&& func)
+        {
+            ItemsBatch batch(*this, items);
+            int modified = 0;
+            for (auto& item: items)
+            {
+                if (func(*item))
+                    modified++;
+            }
+            return modified;
+        }
+
+        /**
+            Returns immutable copy of the catalog's items, for use by background
+            tasks while the catalog may be modified.
+
+            Snapshots of unchanged items are shared with previous snapshots (see
+            CatalogItem::GetSnapshot()), so only items modified since then are
+            copied. Must be called from the thread that modifies the catalog.
+         */
+        CatalogSnapshotPtr TakeSnapshot() const;
+
         /// Gets n-th item in the catalog (read-write access).
         CatalogItemPtr operator[](unsigned n) { return m_items[n]; }
 
@@ -571,17 +1101,35 @@ class Catalog
         /// Change the catalog's language and update headers accordingly
         virtual void SetLanguage(Language lang);
 
+        /**
+            Whether only the beginning of the file was loaded, because it is
+            large and CreationFlag_Preview was used. GetStatistics() then
+            returns values estimated for the whole file.
+         */
+        bool IsPartiallyLoaded() const { return m_partiallyLoaded; }
+
         /// Whether source text is just symbolic identifier and not actual text
         bool UsesSymbolicIDsForSource() const { return m_sourceIsSymbolicID && !m_sideloaded; }
             
         /// Returns true if the catalog contains obsolete entries (~.*)
         virtual bool HasDeletedItems() const { return false; }
 
+        /// Returns the number of obsolete entries in the catalog
+        virtual int GetDeletedItemsCount() const { return 0; }
+
         /// Removes all obsolete translations from the catalog
         virtual void RemoveDeletedItems() {}
 
-        /// Removes translations identical to the source text, returns true if any changes were made
-        bool RemoveSameAsSourceTranslations();
+        /// Returns items whose translation is identical to the source text, i.e. what RemoveSameAsSourceTranslations() would clear
+        CatalogItemArray FindSameAsSourceTranslations();
+
+        /**
+            Removes translations identical to the source text.
+
+            Items are checked and cleared in parallel, as a single ItemsBatch.
+            Returns the number of cleared translations.
+         */
+        int RemoveSameAsSourceTranslations();
 
         /// Finds item by line number
         CatalogItemPtr FindItemByLine(int lineno);
@@ -589,11 +1137,65 @@ class Catalog
         /// Finds catalog index by line number
         int FindItemIndexByLine(int lineno);
 
+        /**
+            Finds catalog indexes of all @a lines, with the same results as
+            calling FindItemIndexByLine() for each of them.
+
+            This is done in a single pass over the items, so it is much faster
+            than individual lookups when mapping many lines (e.g. locations of
+            errors reported by gettext tools).
+         */
+        std::vector<int> FindItemIndexesByLines(const std::vector<int>& lines);
+
+        /**
+            Returns index of items by the source files they reference.
+
+            The index is built on first use, which can take a while with huge
+            files; call PrepareReferencesIndex() after loading to have it built
+            in the background instead (this function then waits for it).
+            Must be called from the main thread.
+         */
+        std::shared_ptr<const CatalogReferencesIndex> GetReferencesIndex();
+
+        /// Starts building GetReferencesIndex()'s index in the background.
+        void PrepareReferencesIndex();
+
+        /**
+            Returns approximate memory used by the catalog.
+
+            This goes through all items, so it isn't instant with huge files.
+            Must be called from the main thread, unless the catalog isn't
+            shared with other threads yet.
+         */
+        CatalogMemoryUsage GetMemoryUsage() const;
+
 
         /// Validates correctness of the translation by running msgfmt
         /// Returns number of errors (i.e. 0 if no errors).
         virtual ValidationResults Validate(const wxString& fileWithSameContent = wxString());
 
+#if wxUSE_GUI
+        /// Called on the main thread with items whose issues were just set by ValidateInBackground()
+        typedef std::function<void(const CatalogItemArray& items)> ValidationProgressHandler;
+        typedef std::function<void(const ValidationResults& results)> ValidationCompletionHandler;
+
+        /**
+            Does the same as Validate(), but without blocking the UI.
+
+            The checks run in the background on a snapshot of the catalog.
+            Issues are set on the items on the main thread as they are found,
+            in batches, and @a progressHandler is called after each batch.
+            Items modified in the meantime are skipped; they are re-checked
+            by the next Validate() call.
+
+            @a completionHandler is called on the main thread when done. The
+            catalog must be kept alive until then.
+         */
+        virtual void ValidateInBackground(const wxString& fileWithSameContent,
+                                          ValidationProgressHandler progressHandler,
+                                          ValidationCompletionHandler completionHandler);
+#endif
+
         void AttachCloudSync(std::shared_ptr<CloudSyncDestination> c) { m_cloudSync = c; }
         std::shared_ptr<CloudSyncDestination> GetCloudSync() const { return m_cloudSync; }
 
@@ -622,9 +1224,73 @@ class Catalog
         /// Perform post-creation processing to e.g. fixup issues, detect missing language etc.
         virtual void PostCreation();
 
+        /// Whether QA checks should be done as part of Validate()
+        bool ShouldRunQA() const;
+
+        /**
+            Forget about tracked changes and recompute statistics and QA issues
+            from scratch next time.
+
+            Must be called whenever m_items is modified in any way other than
+            modifying the items through their public API (e.g. items added or
+            removed).
+         */
+        void InvalidateChangeTracking();
+
+        /**
+            Forget the index used by FindItemIndexByLine(), it will be rebuilt
+            on next use.
+
+            Must be called whenever items' line numbers change, e.g. after
+            saving the file.
+         */
+        void InvalidateLineIndex() { m_lineIndex.clear(); }
+
+        /// Creates new item of type T, allocated from the catalog's arena.
+        template<typename T, typename... Args>
+        std::shared_ptr<T> MakeItem(Args&&... args)
+        {
+            return CatalogItemsArena::Make<T>(m_itemsArena, std::forward<Args>(args)...);
+        }
+
+        /**
+            Appends @a count items created by @a create(i) to m_items, in order.
+
+            Large numbers of items are created in parallel, so @a create must
+            be safe to call concurrently (e.g. only read the source document).
+            Exceptions thrown by it are propagated to the caller.
+         */
+        void CreateItems(size_t count, const std::function<CatalogItemPtr(size_t)>& create);
+
+        /// Adds memory used by format-specific data, e.g. the document, to @a usage
+        virtual void AddFormatMemoryUsage(CatalogMemoryUsage& /*usage*/) const {}
+
+    protected:
+        /// Statistics gathered when loading with CreationFlag_StatisticsOnly
+        struct PrecomputedStatistics
+        {
+            bool valid = false;
+            int all = 0, fuzzy = 0, untranslated = 0, unfinished = 0;
+        };
+
     protected:
         CatalogItemArray m_items;
+        std::shared_ptr<CatalogItemsArena> m_itemsArena;
+        PrecomputedStatistics m_precomputedStats;
+        bool m_partiallyLoaded = false;
+        std::shared_ptr<CatalogChangeTracker> m_changeTracker;
+
+    private:
+        const std::vector<int>& GetLineIndex();
+
+        // line numbers of m_items for binary search, m_lineIndex[i] is the
+        // highest line number of items 0..i so that it's always sorted:
+        std::vector<int> m_lineIndex;
 
+        // built or being built index returned by GetReferencesIndex(), invalid if none:
+        std::shared_future<std::shared_ptr<const CatalogReferencesIndex>> m_referencesIndex;
+
+    protected:
         Type m_fileType;
         wxString m_fileName;
         HeaderData m_header;
@@ -635,4 +1301,32 @@ class Catalog
         std::shared_ptr<SideloadedCatalogData> m_sideloaded;
 };
 
+
+/// Immutable copy of catalog's content, see Catalog::TakeSnapshot()
+class CatalogSnapshot
+{
+public:
+    typedef std::vector<CatalogItemSnapshotPtr> Items;
+
+    explicit CatalogSnapshot(const Catalog& catalog);
+
+    CatalogSnapshot(const CatalogSnapshot&) = delete;
+    CatalogSnapshot& operator=(const CatalogSnapshot&) = delete;
+
+    Catalog::Type GetFileType() const { return m_fileType; }
+    const wxString& GetFileName() const { return m_fileName; }
+    const Language& GetSourceLanguage() const { return m_sourceLanguage; }
+    const Language& GetLanguage() const { return m_language; }
+
+    unsigned GetCount() const { return (unsigned)m_items.size(); }
+    const Items& items() const { return m_items; }
+    const CatalogItemSnapshot& operator[](unsigned n) const { return *m_items[n]; }
+
+private:
+    Catalog::Type m_fileType;
+    wxString m_fileName;
+    Language m_sourceLanguage, m_language;
+    Items m_items;
+};
+
 #endif // Poedit_catalog_h
@@ -0,0 +1,263 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "catalog_cache.h"
+
+#include "catalog.h"
+#include "catalog_stats.h"
+#include "edapp.h"
+#include "str_helpers.h"
+#include "utility.h"
+
+#include <wx/dir.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+
+namespace
+{
+
+// Increment whenever the record's layout or meaning of its data (e.g. QA checks) changes
+const uint32_t CACHE_FORMAT_VERSION = 3;
+
+const char CACHE_MAGIC[8] = { 'P', 'o', 'e', 'd', 'C', 'a', 't', '\0' };
+
+// Size of the blocks at the beginning and end of the file that are included in the content hash
+const size_t HASHED_BLOCK_SIZE = 64 * 1024;
+
+// Fixed-size part of the cache record, followed by UTF-8 revision date and language tag. The
+// cache is local to the machine, so native byte order and layout can be used.
+struct Record
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t revisionDateLength;
+    uint32_t languageLength;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t contentHash;
+    int32_t all, fuzzy, badtokens, untranslated, unfinished;
+    int32_t sourceWords, unfinishedWords;
+};
+
+} // anonymous namespace
+
+
+CatalogCache& CatalogCache::Get()
+{
+    static CatalogCache instance(PoeditApp::GetCacheDir("Catalogs"));
+    return instance;
+}
+
+
+CatalogCache::CatalogCache(const wxString& dir) : m_dir(dir)
+{
+}
+
+
+CatalogCache::Info CatalogCache::GetInfo(const wxString& filename)
+{
+    Key key;
+    const bool cacheable = ComputeKey(filename, key);
+    const auto cacheFile = GetCacheFile(filename);
+
+    Info info;
+    if (cacheable && Read(cacheFile, key, info))
+        return info;
+
+    // items are needed for word counts, so CreationFlag_StatisticsOnly can't be used
+    auto cat = Catalog::Create(filename);
+    FillInfo(*cat, info);
+
+    // don't cache results if the file was modified while it was being loaded
+    Key keyAfter;
+    if (cacheable && ComputeKey(filename, keyAfter) && keyAfter == key)
+    {
+        Write(cacheFile, key, info);
+    }
+
+    return info;
+}
+
+
+void CatalogCache::Update(const wxString& filename, Catalog& catalog)
+{
+    Key key;
+    if (!ComputeKey(filename, key))
+        return;
+
+    Info info;
+    FillInfo(catalog, info);
+
+    Write(GetCacheFile(filename), key, info);
+}
+
+
+void CatalogCache::FillInfo(Catalog& catalog, Info& info)
+{
+    catalog.GetStatistics(&info.all, &info.fuzzy, &info.badtokens, &info.untranslated, &info.unfinished);
+    info.revisionDate = catalog.Header().RevisionDate;
+    if (catalog.HasCapability(Catalog::Cap::Translations) && catalog.GetLanguage().IsValid())
+        info.language = catalog.GetLanguage().LanguageTag();
+
+    auto stats = CatalogStatistics::Compute(*catalog.TakeSnapshot());
+    info.sourceWords = (int)stats.Total().sourceWords;
+    info.unfinishedWords = (int)stats.Unfinished().sourceWords;
+}
+
+
+void CatalogCache::Clear()
+{
+    if (wxFileName::DirExists(m_dir))
+        wxFileName::Rmdir(m_dir, wxPATH_RMDIR_RECURSIVE);
+}
+
+
+wxString CatalogCache::GetCacheFile(const wxString& filename) const
+{
+    const auto path = str::to_utf8(MakeFileName(filename).GetFullPath());
+    return m_dir + wxFILE_SEP_PATH + wxString::Format("%016llx.bin", (unsigned long long)HashFNV1a(path.data(), path.size()));
+}
+
+
+bool CatalogCache::ComputeKey(const wxString& filename, Key& key)
+{
+    wxFileName fn(filename);
+    auto mtime = fn.GetModificationTime();
+    if (!mtime.IsValid())
+        return false;
+
+    wxFile file;
+    {
+        wxLogNull null;
+        if (!file.Open(filename))
+            return false;
+    }
+
+    auto size = file.Length();
+    if (size == wxInvalidOffset)
+        return false;
+
+    key.size = (uint64_t)size;
+    key.mtime = mtime.GetValue().GetValue();
+
+    // Hashing part of the content detects most modifications that preserve both size and
+    // modification time (e.g. VCS checkouts), without having to read huge files entirely:
+    std::vector<char> buffer(HASHED_BLOCK_SIZE);
+    auto head = file.Read(buffer.data(), buffer.size());
+    if (head == wxInvalidOffset)
+        return false;
+    key.contentHash = HashFNV1a(buffer.data(), (size_t)head);
+
+    if (size > (wxFileOffset)HASHED_BLOCK_SIZE)
+    {
+        if (file.Seek(std::max(size - (wxFileOffset)HASHED_BLOCK_SIZE, (wxFileOffset)HASHED_BLOCK_SIZE)) == wxInvalidOffset)
+            return false;
+        auto tail = file.Read(buffer.data(), buffer.size());
+        if (tail == wxInvalidOffset)
+            return false;
+        key.contentHash = HashFNV1a(buffer.data(), (size_t)tail, key.contentHash);
+    }
+
+    return true;
+}
+
+
+bool CatalogCache::Read(const wxString& cacheFile, const Key& key, Info& info) const
+{
+    if (!wxFileName::FileExists(cacheFile))
+        return false;
+
+    MappedFile data(cacheFile);
+    if (!data.IsOk() || data.size() < sizeof(Record))
+        return false;
+
+    Record r;
+    memcpy(&r, data.data(), sizeof(Record));
+
+    if (memcmp(r.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || r.version != CACHE_FORMAT_VERSION)
+        return false;
+    if (r.size != key.size || r.mtime != key.mtime || r.contentHash != key.contentHash)
+        return false;
+    if (data.size() != sizeof(Record) + r.revisionDateLength + r.languageLength)
+        return false;
+
+    info.all = r.all;
+    info.fuzzy = r.fuzzy;
+    info.badtokens = r.badtokens;
+    info.untranslated = r.untranslated;
+    info.unfinished = r.unfinished;
+    info.sourceWords = r.sourceWords;
+    info.unfinishedWords = r.unfinishedWords;
+    info.revisionDate = str::to_wx(std::string(data.data() + sizeof(Record), r.revisionDateLength));
+    info.language.assign(data.data() + sizeof(Record) + r.revisionDateLength, r.languageLength);
+    return true;
+}
+
+
+void CatalogCache::Write(const wxString& cacheFile, const Key& key, const Info& info) const
+{
+    // failing to write the cache is not an error worth reporting
+    wxLogNull null;
+
+    if (!wxFileName::DirExists(m_dir) && !wxFileName::Mkdir(m_dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+        return;
+
+    const auto revisionDate = str::to_utf8(info.revisionDate);
+
+    Record r;
+    memset(&r, 0, sizeof(r));
+    memcpy(r.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    r.version = CACHE_FORMAT_VERSION;
+    r.revisionDateLength = (uint32_t)revisionDate.size();
+    r.languageLength = (uint32_t)info.language.size();
+    r.size = key.size;
+    r.mtime = key.mtime;
+    r.contentHash = key.contentHash;
+    r.all = info.all;
+    r.fuzzy = info.fuzzy;
+    r.badtokens = info.badtokens;
+    r.untranslated = info.untranslated;
+    r.unfinished = info.unfinished;
+    r.sourceWords = info.sourceWords;
+    r.unfinishedWords = info.unfinishedWords;
+
+    TempOutputFileFor tempfile(cacheFile);
+    {
+        std::ofstream f(tempfile.FileName().fn_str(), std::ios::binary);
+        f.write(reinterpret_cast<const char*>(&r), sizeof(r));
+        f.write(revisionDate.data(), revisionDate.size());
+        f.write(info.language.data(), info.language.size());
+        if (!f)
+            return;
+    }
+    tempfile.Commit();
+}
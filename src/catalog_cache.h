@@ -0,0 +1,117 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_catalog_cache_h
+#define Poedit_catalog_cache_h
+
+#include <wx/string.h>
+
+#include <cstdint>
+#include <string>
+
+class Catalog;
+
+
+/**
+    On-disk cache of catalog files' summary information.
+
+    Computing statistics requires parsing the entire file, which is slow for
+    large files and wasteful when the file didn't change since the last time.
+    The cache stores one small binary record per file, keyed by its path and
+    validated against its size, modification time and a hash of its content's
+    beginning and end.
+ */
+class CatalogCache
+{
+public:
+    /// Summary information about a catalog file
+    struct Info
+    {
+        int all = 0;
+        int fuzzy = 0;
+        int badtokens = 0;
+        int untranslated = 0;
+        int unfinished = 0;
+        /// Source words in all items and in unfinished (untranslated or fuzzy) ones
+        int sourceWords = 0;
+        int unfinishedWords = 0;
+        wxString revisionDate;
+        /// Language tag of the translation, empty if unknown or not translation
+        std::string language;
+    };
+
+    /// Return singleton instance of the cache.
+    static CatalogCache& Get();
+
+    /**
+        Returns information about @a filename.
+
+        Uses cached data if it is up to date, otherwise loads the file and
+        updates the cache. Throws if the file cannot be loaded.
+     */
+    Info GetInfo(const wxString& filename);
+
+    /**
+        Updates cached information about @a filename from @a catalog.
+
+        Use after saving @a catalog into @a filename to avoid reloading the
+        file later.
+     */
+    void Update(const wxString& filename, Catalog& catalog);
+
+    /// Removes all cached data.
+    void Clear();
+
+    /// Identification of file's version that cached data are valid for
+    struct Key
+    {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t contentHash = 0;
+
+        bool operator==(const Key& other) const
+            { return size == other.size && mtime == other.mtime && contentHash == other.contentHash; }
+    };
+
+    /**
+        Computes current Key of @a filename, e.g. for validating data derived
+        from Info stored elsewhere. Returns false if the file can't be read.
+     */
+    static bool ComputeKey(const wxString& filename, Key& key);
+
+private:
+    CatalogCache(const wxString& dir);
+
+    static void FillInfo(Catalog& catalog, Info& info);
+
+    wxString GetCacheFile(const wxString& filename) const;
+
+    bool Read(const wxString& cacheFile, const Key& key, Info& info) const;
+    void Write(const wxString& cacheFile, const Key& key, const Info& info) const;
+
+    wxString m_dir;
+};
+
+#endif // Poedit_catalog_cache_h
@@ -27,17 +27,20 @@
 
 #include "configuration.h"
 #include "str_helpers.h"
+#include "tracing.h"
 #include "utility.h"
 
 #include <wx/intl.h>
 #include <wx/log.h>
 
-#include <boost/algorithm/string.hpp>
-
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <memory>
 #include <sstream>
+#include <unordered_map>
 
 
 namespace
@@ -45,23 +48,24 @@ namespace
 
 // Try to determine JSON file's formatting, i.e. line endings and identation, by inspecting the
 // beginning of the file.
-void DetectFileFormatting(std::ifstream& f, int& indent, char& indent_char, bool& dos_line_endings)
+void DetectFileFormatting(const std::string& data, int& indent, char& indent_char, bool& dos_line_endings)
 {
     // fallback defaults: compact representation with no indentation
     indent = -1;
     indent_char = ' ';
     dos_line_endings = false;
 
-    for (int counter = 0; counter < 100; ++counter)
+    const size_t len = std::min(data.size(), size_t(100));
+    for (size_t i = 0; i < len; ++i)
     {
-        auto c = f.get();
-        if (c == '\r' && f.peek() == '\n')
+        auto c = data[i];
+        if (c == '\r' && i + 1 < data.size() && data[i + 1] == '\n')
         {
             dos_line_endings = true;
         }
         else if (c == '\n')
         {
-            // first newline found, indent=0 means "use newlines" in json::dump()
+            // first newline found, indent=0 means "use newlines, but don't indent"
             indent = 0;
         }
         else if (c == ' ' || c == '\t')
@@ -70,7 +74,7 @@ void DetectFileFormatting(std::ifstream& f, int& indent, char& indent_char, bool
             {
                 // we're past the newline, identifying whitespace leading to the first "
                 indent++;
-                indent_char = (char)c; // ignore weirdnesses like mixed whitespace
+                indent_char = c; // ignore weirdnesses like mixed whitespace
             }
         }
         else if  (c == '"')
@@ -81,9 +85,841 @@ void DetectFileFormatting(std::ifstream& f, int& indent, char& indent_char, bool
     }
 }
 
+
+[[noreturn]] void ThrowReadError(const wxString& details)
+{
+    BOOST_THROW_EXCEPTION(JSONFileException(wxString::Format(_("Reading file content failed with the following error: %s"), details)));
+}
+
+
+inline bool is_json_whitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+void append_utf8(std::string& out, uint32_t cp)
+{
+    if (cp < 0x80)
+    {
+        out += char(cp);
+    }
+    else if (cp < 0x800)
+    {
+        out += char(0xC0 | (cp >> 6));
+        out += char(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+        out += char(0xE0 | (cp >> 12));
+        out += char(0x80 | ((cp >> 6) & 0x3F));
+        out += char(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        out += char(0xF0 | (cp >> 18));
+        out += char(0x80 | ((cp >> 12) & 0x3F));
+        out += char(0x80 | ((cp >> 6) & 0x3F));
+        out += char(0x80 | (cp & 0x3F));
+    }
+}
+
+// Encodes string as JSON string literal, escaping the same characters json::dump() does
+std::string encode_json_string(const std::string& s)
+{
+    static const char hexdigits[] = "0123456789abcdef";
+
+    std::string out;
+    out.reserve(s.size() + 2);
+    out += '"';
+    for (auto c: s)
+    {
+        switch (c)
+        {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b";  break;
+            case '\f': out += "\\f";  break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if ((unsigned char)c < 0x20)
+                {
+                    out += "\\u00";
+                    out += hexdigits[(c >> 4) & 0xF];
+                    out += hexdigits[c & 0xF];
+                }
+                else
+                {
+                    out += c;
+                }
+                break;
+        }
+    }
+    out += '"';
+    return out;
+}
+
 } // anonymous namespace
 
 
+/**
+    Compact representation of a JSON file's content.
+
+    Instead of building a DOM with decoded keys and values (which is what
+    nlohmann::json does and which is very memory-hungry), the file is
+    scanned once and only the structure is recorded: every node references
+    its key and value as spans of the original text, which is kept as-is.
+    Only the strings that are actually needed by the catalog are decoded.
+
+    Modified values are appended to the text and the node is pointed at the
+    new span, so that the original content remains untouched and can be
+    written back with only the changed values replaced by Serialize().
+ */
+class JSONDocument
+{
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    enum class Kind : uint8_t
+    {
+        Null,
+        Boolean,
+        Number,
+        String,
+        Object,
+        Array
+    };
+
+    /// Parses @a data, throws JSONFileException on failure
+    explicit JSONDocument(std::string&& data) : m_text(std::move(data)), m_originalSize(m_text.size())
+    {
+        Parse();
+        m_originalNodesCount = (uint32_t)m_nodes.size();
+    }
+
+    JSONDocument(const JSONDocument&) = delete;
+
+    uint32_t Root() const { return 0; }
+
+    Kind GetKind(uint32_t node) const { return m_nodes[node].kind; }
+    bool IsNull(uint32_t node) const { return GetKind(node) == Kind::Null; }
+    bool IsString(uint32_t node) const { return GetKind(node) == Kind::String; }
+    bool IsObject(uint32_t node) const { return GetKind(node) == Kind::Object; }
+    bool IsEmpty(uint32_t node) const { return m_nodes[node].firstChild == NONE; }
+
+    /// Iterable range of children of an object or array node
+    class Children
+    {
+    public:
+        class iterator
+        {
+        public:
+            iterator(const JSONDocument& doc, uint32_t node) : m_doc(doc), m_node(node) {}
+            uint32_t operator*() const { return m_node; }
+            iterator& operator++() { m_node = m_doc.m_nodes[m_node].next; return *this; }
+            bool operator!=(const iterator& other) const { return m_node != other.m_node; }
+        private:
+            const JSONDocument& m_doc;
+            uint32_t m_node;
+        };
+
+        Children(const JSONDocument& doc, uint32_t node) : m_doc(doc), m_node(node) {}
+        iterator begin() const { return iterator(m_doc, m_doc.m_nodes[m_node].firstChild); }
+        iterator end() const { return iterator(m_doc, NONE); }
+
+    private:
+        const JSONDocument& m_doc;
+        uint32_t m_node;
+    };
+
+    Children GetChildren(uint32_t node) const { return Children(*this, node); }
+
+    /// Returns decoded key of an object's member
+    std::string GetKey(uint32_t node) const { return Decode(m_nodes[node].key); }
+
+    /// Returns decoded value of a string node, throws if it isn't a string
+    std::string GetString(uint32_t node) const
+    {
+        if (!IsString(node))
+            ThrowReadError("type must be string");
+        return Decode(m_nodes[node].value);
+    }
+
+    /// Finds member @a key of @a object, returns NONE if not present
+    uint32_t Find(uint32_t object, const char *key) const;
+
+    /// Like Find(), but throws if the key isn't present
+    uint32_t At(uint32_t object, const char *key) const
+    {
+        auto node = Find(object, key);
+        if (node == NONE)
+            ThrowReadError(wxString::Format("key '%s' not found", key));
+        return node;
+    }
+
+    /// Returns string value of member @a key or @a defaultValue if not present
+    std::string Value(uint32_t object, const char *key, const std::string& defaultValue = std::string()) const
+    {
+        auto node = Find(object, key);
+        return (node == NONE) ? defaultValue : GetString(node);
+    }
+
+    /// Replaces value of a scalar node with string @a value
+    void SetString(uint32_t node, const std::string& value);
+
+    /// Sets string member @a key of @a object, adding it if necessary
+    void SetMember(uint32_t object, const char *key, const std::string& value);
+
+    /// How to format members added with SetMember()
+    struct Formatting
+    {
+        int indent;        // -1 for compact output
+        char indent_char;
+        const char *eol;
+    };
+
+    /**
+        Serializes the document.
+
+        The original text is reproduced byte for byte, except for changed
+        values and added members, which are spliced into it.
+     */
+    std::string Serialize(const Formatting& fmt) const;
+
+    /// Returns memory used by the document, in bytes
+    size_t GetMemoryUsage() const
+    {
+        return m_text.capacity() + m_nodes.capacity() * sizeof(Node) +
+               m_originalValues.size() * (sizeof(uint32_t) + sizeof(Span) + sizeof(void*)) +
+               m_addedMembers.capacity() * sizeof(m_addedMembers[0]);
+    }
+
+private:
+    struct Span
+    {
+        uint32_t begin = 0, end = 0;
+    };
+
+    struct Node
+    {
+        Kind kind = Kind::Null;
+        uint32_t firstChild = NONE;
+        uint32_t next = NONE;
+        Span key;    // key literal including quotes, empty if not object member
+        Span value;  // scalar literal or the entire container's markup
+    };
+
+    void Parse();
+    size_t ScanString(size_t pos) const;
+    size_t ScanNumber(size_t pos) const;
+    [[noreturn]] void ThrowSyntaxError(size_t pos, const char *what) const;
+
+    std::string Decode(Span literal) const;
+    Span Append(const std::string& literal);
+    std::string LineIndentation(uint32_t pos) const;
+
+    std::string m_text;
+    const size_t m_originalSize;
+    std::vector<Node> m_nodes;
+    uint32_t m_originalNodesCount = 0;
+
+    // original value spans of nodes changed with SetString()
+    std::unordered_map<uint32_t, Span> m_originalValues;
+    // (object, member) nodes added with SetMember(), in order of addition
+    std::vector<std::pair<uint32_t, uint32_t>> m_addedMembers;
+};
+
+
+void JSONDocument::ThrowSyntaxError(size_t pos, const char *what) const
+{
+    int line = 1;
+    size_t lineStart = 0;
+    for (size_t i = 0; i < pos && i < m_text.size(); i++)
+    {
+        if (m_text[i] == '\n')
+        {
+            line++;
+            lineStart = i + 1;
+        }
+    }
+    ThrowReadError(wxString::Format("syntax error at line %d, column %d: %s", line, int(pos - lineStart + 1), what));
+}
+
+
+size_t JSONDocument::ScanString(size_t pos) const
+{
+    const char *data = m_text.data();
+    const size_t size = m_text.size();
+
+    pos++; // opening quote
+    while (pos < size)
+    {
+        const unsigned char c = data[pos];
+        if (c == '"')
+        {
+            return pos + 1;
+        }
+        else if (c == '\\')
+        {
+            if (++pos >= size)
+                break;
+            switch (data[pos])
+            {
+                case '"': case '\\': case '/':
+                case 'b': case 'f': case 'n': case 'r': case 't':
+                    pos++;
+                    break;
+                case 'u':
+                {
+                    auto read_hex4 = [&](size_t at) -> int
+                    {
+                        if (at + 4 > size)
+                            return -1;
+                        int value = 0;
+                        for (size_t i = at; i < at + 4; i++)
+                        {
+                            int h = hex_value(data[i]);
+                            if (h < 0)
+                                return -1;
+                            value = (value << 4) | h;
+                        }
+                        return value;
+                    };
+
+                    int cp = read_hex4(pos + 1);
+                    if (cp < 0)
+                        ThrowSyntaxError(pos, "invalid \\u escape");
+                    pos += 5;
+                    if (cp >= 0xDC00 && cp <= 0xDFFF)
+                        ThrowSyntaxError(pos, "unpaired surrogate in \\u escape");
+                    if (cp >= 0xD800 && cp <= 0xDBFF)
+                    {
+                        int low = (pos + 1 < size && data[pos] == '\\' && data[pos + 1] == 'u') ? read_hex4(pos + 2) : -1;
+                        if (low < 0xDC00 || low > 0xDFFF)
+                            ThrowSyntaxError(pos, "unpaired surrogate in \\u escape");
+                        pos += 6;
+                    }
+                    break;
+                }
+                default:
+                    ThrowSyntaxError(pos, "invalid escape sequence");
+            }
+        }
+        else if (c < 0x20)
+        {
+            ThrowSyntaxError(pos, "control character in string");
+        }
+        else if (c < 0x80)
+        {
+            pos++;
+        }
+        else
+        {
+            // validate UTF-8 sequence:
+            size_t len;
+            uint32_t cp, minimum;
+            if ((c & 0xE0) == 0xC0)
+                { len = 2; cp = c & 0x1F; minimum = 0x80; }
+            else if ((c & 0xF0) == 0xE0)
+                { len = 3; cp = c & 0x0F; minimum = 0x800; }
+            else if ((c & 0xF8) == 0xF0)
+                { len = 4; cp = c & 0x07; minimum = 0x10000; }
+            else
+                ThrowSyntaxError(pos, "invalid UTF-8 byte");
+
+            if (pos + len > size)
+                break;
+            for (size_t i = 1; i < len; i++)
+            {
+                const unsigned char cc = data[pos + i];
+                if ((cc & 0xC0) != 0x80)
+                    ThrowSyntaxError(pos, "invalid UTF-8 byte");
+                cp = (cp << 6) | (cc & 0x3F);
+            }
+            if (cp < minimum || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+                ThrowSyntaxError(pos, "invalid UTF-8 byte");
+            pos += len;
+        }
+    }
+
+    ThrowSyntaxError(size, "unterminated string");
+}
+
+
+size_t JSONDocument::ScanNumber(size_t pos) const
+{
+    const char *data = m_text.data();
+    const size_t size = m_text.size();
+    const size_t start = pos;
+
+    if (data[pos] == '-')
+        pos++;
+
+    if (pos < size && data[pos] == '0')
+    {
+        pos++;
+    }
+    else if (pos < size && is_digit(data[pos]))
+    {
+        while (pos < size && is_digit(data[pos]))
+            pos++;
+    }
+    else
+    {
+        ThrowSyntaxError(start, "invalid number");
+    }
+
+    if (pos < size && data[pos] == '.')
+    {
+        if (++pos >= size || !is_digit(data[pos]))
+            ThrowSyntaxError(start, "invalid number");
+        while (pos < size && is_digit(data[pos]))
+            pos++;
+    }
+
+    if (pos < size && (data[pos] == 'e' || data[pos] == 'E'))
+    {
+        pos++;
+        if (pos < size && (data[pos] == '+' || data[pos] == '-'))
+            pos++;
+        if (pos >= size || !is_digit(data[pos]))
+            ThrowSyntaxError(start, "invalid number");
+        while (pos < size && is_digit(data[pos]))
+            pos++;
+    }
+
+    return pos;
+}
+
+
+void JSONDocument::Parse()
+{
+    if (m_text.size() >= UINT32_MAX)
+        ThrowReadError("file is too large");
+
+    const char *data = m_text.data();
+    const size_t size = m_text.size();
+    size_t pos = 0;
+
+    // UTF-8 BOM is tolerated by json::parse() too
+    if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+        pos = 3;
+
+    auto skip_whitespace = [&]
+    {
+        while (pos < size && is_json_whitespace(data[pos]))
+            pos++;
+    };
+
+    // The parser is iterative, so that deeply nested input can't overflow the stack;
+    // each open container on the stack remembers its last child for appending.
+    struct Open
+    {
+        uint32_t node;
+        uint32_t lastChild;
+    };
+    std::vector<Open> stack;
+    Span key;
+
+    for (;;)
+    {
+        // parse a single value, possibly opening a container:
+        skip_whitespace();
+        if (pos >= size)
+            ThrowSyntaxError(pos, "unexpected end of input");
+
+        const uint32_t index = (uint32_t)m_nodes.size();
+        m_nodes.emplace_back();
+        if (!stack.empty())
+        {
+            auto& parent = stack.back();
+            if (parent.lastChild == NONE)
+                m_nodes[parent.node].firstChild = index;
+            else
+                m_nodes[parent.lastChild].next = index;
+            parent.lastChild = index;
+        }
+
+        Node& node = m_nodes.back();
+        node.key = key;
+        node.value.begin = (uint32_t)pos;
+
+        bool opened = false;
+        switch (data[pos])
+        {
+            case '{':
+            case '[':
+                node.kind = (data[pos] == '{') ? Kind::Object : Kind::Array;
+                stack.push_back({index, NONE});
+                pos++;
+                opened = true;
+                break;
+            case '"':
+                node.kind = Kind::String;
+                pos = ScanString(pos);
+                break;
+            case 't':
+            case 'f':
+            case 'n':
+            {
+                const char *literal = (data[pos] == 't') ? "true" : (data[pos] == 'f') ? "false" : "null";
+                const size_t len = strlen(literal);
+                if (size - pos < len || memcmp(data + pos, literal, len) != 0)
+                    ThrowSyntaxError(pos, "invalid literal");
+                node.kind = (data[pos] == 'n') ? Kind::Null : Kind::Boolean;
+                pos += len;
+                break;
+            }
+            default:
+                if (data[pos] != '-' && !is_digit(data[pos]))
+                    ThrowSyntaxError(pos, "unexpected character");
+                node.kind = Kind::Number;
+                pos = ScanNumber(pos);
+                break;
+        }
+        if (!opened)
+            node.value.end = (uint32_t)pos;
+
+        // then close finished containers and find where the next value starts:
+        key = Span();
+        bool expectValue = false;
+        while (!stack.empty())
+        {
+            skip_whitespace();
+            if (pos >= size)
+                ThrowSyntaxError(pos, "unexpected end of input");
+
+            auto& top = stack.back();
+            auto& container = m_nodes[top.node];
+            const bool isObject = container.kind == Kind::Object;
+            if (data[pos] == (isObject ? '}' : ']'))
+            {
+                container.value.end = (uint32_t)++pos;
+                stack.pop_back();
+                opened = false;
+                continue;
+            }
+
+            if (!opened)
+            {
+                if (data[pos] != ',')
+                    ThrowSyntaxError(pos, isObject ? "expected ',' or '}'" : "expected ',' or ']'");
+                pos++;
+                skip_whitespace();
+            }
+
+            if (isObject)
+            {
+                if (pos >= size || data[pos] != '"')
+                    ThrowSyntaxError(pos, "expected object key");
+                key.begin = (uint32_t)pos;
+                pos = ScanString(pos);
+                key.end = (uint32_t)pos;
+
+                skip_whitespace();
+                if (pos >= size || data[pos] != ':')
+                    ThrowSyntaxError(pos, "expected ':'");
+                pos++;
+            }
+
+            expectValue = true;
+            break;
+        }
+
+        if (!expectValue)
+            break; // root value is complete
+    }
+
+    skip_whitespace();
+    if (pos != size)
+        ThrowSyntaxError(pos, "unexpected content after the end of the document");
+}
+
+
+std::string JSONDocument::Decode(Span literal) const
+{
+    if (literal.end - literal.begin < 2)
+        return std::string();
+
+    // omit the quotes:
+    const char *begin = m_text.data() + literal.begin + 1;
+    const char *end = m_text.data() + literal.end - 1;
+
+    auto escape = std::find(begin, end, '\\');
+    if (escape == end)
+        return std::string(begin, end);
+
+    // the literal was validated by ScanString() already, so don't check for errors:
+    auto read_hex4 = [](const char *s)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++)
+            value = (value << 4) | hex_value(s[i]);
+        return value;
+    };
+
+    std::string out(begin, escape);
+    out.reserve(end - begin);
+    for (const char *s = escape; s < end; ++s)
+    {
+        if (*s != '\\')
+        {
+            out += *s;
+            continue;
+        }
+
+        switch (*++s)
+        {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+            {
+                uint32_t cp = read_hex4(s + 1);
+                s += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF)
+                {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (read_hex4(s + 3) - 0xDC00);
+                    s += 6;
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default: // " \ /
+                out += *s;
+                break;
+        }
+    }
+
+    return out;
+}
+
+
+uint32_t JSONDocument::Find(uint32_t object, const char *key) const
+{
+    if (!IsObject(object))
+        return NONE;
+
+    const size_t keylen = strlen(key);
+    for (auto child: GetChildren(object))
+    {
+        auto& span = m_nodes[child].key;
+        const char *raw = m_text.data() + span.begin + 1;
+        const size_t rawlen = span.end - span.begin - 2;
+
+        if (rawlen == keylen && memcmp(raw, key, keylen) == 0)
+            return child;
+        // escaped keys are rare, but possible:
+        if (memchr(raw, '\\', rawlen) && GetKey(child) == key)
+            return child;
+    }
+
+    return NONE;
+}
+
+
+JSONDocument::Span JSONDocument::Append(const std::string& literal)
+{
+    wxASSERT_MSG( m_text.size() + literal.size() < UINT32_MAX, "JSON document too large" );
+
+    Span span;
+    span.begin = (uint32_t)m_text.size();
+    m_text += literal;
+    span.end = (uint32_t)m_text.size();
+    return span;
+}
+
+
+void JSONDocument::SetString(uint32_t node, const std::string& value)
+{
+    auto& n = m_nodes[node];
+    wxCHECK_RET( n.kind != Kind::Object && n.kind != Kind::Array, "only scalar values can be changed" );
+
+    if (node < m_originalNodesCount)
+        m_originalValues.emplace(node, n.value); // no-op if changed before
+
+    n.kind = Kind::String;
+    n.value = Append(encode_json_string(value));
+}
+
+
+void JSONDocument::SetMember(uint32_t object, const char *key, const std::string& value)
+{
+    wxCHECK_RET( IsObject(object), "members can only be set on objects" );
+
+    auto existing = Find(object, key);
+    if (existing != NONE)
+    {
+        SetString(existing, value);
+        return;
+    }
+
+    // add new member at the end, as json::operator[] would:
+    const uint32_t index = (uint32_t)m_nodes.size();
+    m_nodes.emplace_back();
+    auto& n = m_nodes.back();
+    n.kind = Kind::String;
+    n.key = Append(encode_json_string(key));
+    n.value = Append(encode_json_string(value));
+
+    auto& parent = m_nodes[object];
+    if (parent.firstChild == NONE)
+    {
+        parent.firstChild = index;
+    }
+    else
+    {
+        uint32_t last = parent.firstChild;
+        while (m_nodes[last].next != NONE)
+            last = m_nodes[last].next;
+        m_nodes[last].next = index;
+    }
+
+    m_addedMembers.emplace_back(object, index);
+}
+
+
+std::string JSONDocument::LineIndentation(uint32_t pos) const
+{
+    // returns whitespace at the start of the line containing @a pos
+    uint32_t start = pos;
+    while (start > 0 && m_text[start - 1] != '\n' && m_text[start - 1] != '\r')
+        start--;
+    uint32_t end = start;
+    while (end < pos && (m_text[end] == ' ' || m_text[end] == '\t'))
+        end++;
+    return m_text.substr(start, end - start);
+}
+
+
+std::string JSONDocument::Serialize(const Formatting& fmt) const
+{
+    struct Edit
+    {
+        uint32_t begin, end;  // replaced range of the original text
+        std::string text;
+    };
+    std::vector<Edit> edits;
+    edits.reserve(m_originalValues.size() + m_addedMembers.size());
+
+    auto literal = [this](Span span) { return m_text.substr(span.begin, span.end - span.begin); };
+    auto original_value = [this](uint32_t node)
+    {
+        auto i = m_originalValues.find(node);
+        return (i != m_originalValues.end()) ? i->second : m_nodes[node].value;
+    };
+
+    for (auto& v: m_originalValues)
+        edits.push_back({v.second.begin, v.second.end, literal(m_nodes[v.first].value)});
+
+    std::map<uint32_t, std::vector<uint32_t>> added;
+    for (auto& a: m_addedMembers)
+        added[a.first].push_back(a.second);
+
+    // New members are inserted after the last original member, formatted like it
+    // if there is one, or according to @a fmt if the object was empty:
+    for (auto& a: added)
+    {
+        const uint32_t object = a.first;
+        auto& obj = m_nodes[object];
+
+        uint32_t last = NONE, previous = NONE;
+        for (auto child: GetChildren(object))
+        {
+            if (child >= m_originalNodesCount)
+                break;
+            previous = last;
+            last = child;
+        }
+
+        Edit edit;
+        std::string separator, keySeparator, closing;
+        if (last != NONE)
+        {
+            auto& n = m_nodes[last];
+            edit.begin = edit.end = original_value(last).end;
+
+            // put the new member on its own line only if the last one is on its own line too:
+            auto indentation = LineIndentation(n.key.begin);
+            const uint32_t keyColumn = n.key.begin - (uint32_t)indentation.size();
+            if (keyColumn == 0 || m_text[keyColumn - 1] == '\n' || m_text[keyColumn - 1] == '\r')
+                separator = std::string(",") + fmt.eol + indentation;
+            else if (previous != NONE)
+                separator = m_text.substr(original_value(previous).end, n.key.begin - original_value(previous).end);
+            else
+                separator = ",";
+            keySeparator = m_text.substr(n.key.end, n.value.begin - n.key.end);
+        }
+        else
+        {
+            edit.begin = edit.end = obj.value.begin + 1;
+            if (fmt.indent >= 0)
+            {
+                auto indentation = LineIndentation(obj.value.begin);
+                separator = fmt.eol + indentation + std::string(size_t(fmt.indent), fmt.indent_char);
+                keySeparator = ": ";
+                closing = fmt.eol + indentation;
+            }
+            else
+            {
+                keySeparator = ":";
+            }
+        }
+
+        bool first = true;
+        for (auto member: a.second)
+        {
+            auto& n = m_nodes[member];
+            if (last == NONE && !first)
+                edit.text += ',';
+            edit.text += separator;
+            edit.text += literal(n.key);
+            edit.text += keySeparator;
+            edit.text += literal(n.value);
+            first = false;
+        }
+        edit.text += closing;
+
+        edits.push_back(std::move(edit));
+    }
+
+    std::stable_sort(edits.begin(), edits.end(),
+                     [](const Edit& a, const Edit& b){ return a.begin < b.begin; });
+
+    std::string out;
+    out.reserve(m_text.size());
+    size_t pos = 0;
+    for (auto& e: edits)
+    {
+        out.append(m_text, pos, e.begin - pos);
+        out += e.text;
+        pos = e.end;
+    }
+    out.append(m_text, pos, m_originalSize - pos);
+
+    return out;
+}
+
+
 class JSONUnrecognizedFileException : public JSONFileException
 {
 public:
@@ -116,30 +952,42 @@ bool JSONCatalog::CanLoadFile(const wxString& extension)
 }
 
 
-std::shared_ptr<JSONCatalog> JSONCatalog::Open(const wxString& filename)
+JSONCatalog::JSONCatalog(std::unique_ptr<JSONDocument>&& doc, Type type)
+    : Catalog(type), m_doc(std::move(doc))
 {
-    try
-    {
-        const auto ext = str::to_utf8(wxFileName(filename).GetExt().Lower());
-        std::ifstream f(filename.fn_str(), std::ios::binary);
-        auto data = json_t::parse(f);
+}
 
-        auto cat = CreateForJSON(std::move(data), ext);
-        if (!cat)
-            BOOST_THROW_EXCEPTION(JSONUnrecognizedFileException());
 
-        f.clear();
-        f.seekg(0, std::ios::beg);
-        DetectFileFormatting(f, cat->m_formatting.indent, cat->m_formatting.indent_char, cat->m_formatting.dos_line_endings);
+JSONCatalog::~JSONCatalog()
+{
+}
 
-        cat->Parse();
 
-        return cat;
-    }
-    catch (json::exception& e)
+std::shared_ptr<JSONCatalog> JSONCatalog::Open(const wxString& filename)
+{
+    const auto ext = str::to_utf8(wxFileName(StripGzipExtension(filename)).GetExt().Lower());
+
+    // the file is only read once, both formatting and content are determined
+    // from memory; compressed files are decompressed while reading
+    std::string data;
     {
-        BOOST_THROW_EXCEPTION(JSONFileException(wxString::Format(_("Reading file content failed with the following error: %s"), e.what())));
+        MappedFile f(filename);
+        if (!f.IsOk())
+            BOOST_THROW_EXCEPTION(JSONFileException(wxString::Format(_(L"The file “%s” couldn’t be opened."), wxFileName(filename).GetFullName())));
+        data.assign(f.data(), f.size());
     }
+
+    FormattingRules formatting;
+    DetectFileFormatting(data, formatting.indent, formatting.indent_char, formatting.dos_line_endings);
+
+    auto cat = CreateForJSON(std::make_unique<JSONDocument>(std::move(data)), ext);
+    if (!cat)
+        BOOST_THROW_EXCEPTION(JSONUnrecognizedFileException());
+
+    cat->m_formatting = formatting;
+    cat->Parse();
+
+    return cat;
 }
 
 
@@ -147,6 +995,7 @@ bool JSONCatalog::Save(const wxString& filename, bool /*save_mo*/,
                         ValidationResults& validation_results,
                         CompilationStatus& /*mo_compilation_status*/)
 {
+    TRACE_SPAN("catalog", "Save");
     if ( wxFileExists(filename) && !wxFile::Access(filename, wxFile::write) )
     {
         wxLogError(_(L"File “%s” is read-only and cannot be saved.\nPlease save it under different name."),
@@ -161,7 +1010,7 @@ bool JSONCatalog::Save(const wxString& filename, bool /*save_mo*/,
         f << SaveToBuffer();
     }
 
-    if ( !tempfile.Commit() )
+    if ( (IsGzipFileName(filename) && !tempfile.CompressWithGzip()) || !tempfile.Commit() )
     {
         wxLogError(_(L"Couldn’t save file %s."), filename.c_str());
         return false;
@@ -176,44 +1025,72 @@ bool JSONCatalog::Save(const wxString& filename, bool /*save_mo*/,
 
 std::string JSONCatalog::SaveToBuffer()
 {
-    auto s = m_doc.dump(m_formatting.indent, m_formatting.indent_char, /*ensure_ascii=*/false);
-    if (s.empty())
-        return s; // shouldn't be possible...
+    TRACE_SPAN("catalog", "SaveToBuffer");
+    std::lock_guard<std::mutex> lock(m_documentMutex);
+    SyncDocument();
+
+    // only changed values are written, everything else is kept exactly as it was in the file
+    JSONDocument::Formatting fmt;
+    fmt.indent = m_formatting.indent;
+    fmt.indent_char = m_formatting.indent_char;
+    fmt.eol = m_formatting.dos_line_endings ? "\r\n" : "\n";
+    return m_doc->Serialize(fmt);
+}
 
-    // all POSIX text files must end in newline, but json::dump() doesn't produce it
-    if (s.back() != '\n')
-        s.push_back('\n');
 
-    if (m_formatting.dos_line_endings)
+void JSONCatalog::AddFormatMemoryUsage(CatalogMemoryUsage& usage) const
+{
+    std::lock_guard<std::mutex> lock(m_documentMutex);
+    if (m_doc)
+        usage.document += m_doc->GetMemoryUsage();
+}
+
+
+void JSONCatalog::SyncDocument()
+{
+    if (!m_documentDirty.exchange(false))
+        return;
+
+    for (auto& i: m_items)
     {
-        boost::replace_all(s, "\n", "\r\n");
+        auto& item = static_cast<JSONCatalogItem&>(*i);
+        if (item.m_documentDirty.exchange(false))
+            item.WriteToDocument(*m_doc);
     }
-    return s;
+}
+
+
+void JSONCatalogItem::UpdateInternalRepresentation()
+{
+    m_documentDirty = true;
+    m_owner.m_documentDirty = true;
 }
 
 
 class GenericJSONItem : public JSONCatalogItem
 {
 public:
-    GenericJSONItem(int id, const std::string& key, json_t& node) : JSONCatalogItem(id, node)
+    GenericJSONItem(JSONCatalog& owner, const JSONDocument& doc, int id, const std::string& key, uint32_t node)
+        : JSONCatalogItem(owner, id, node)
     {
         m_string = str::to_wx(key);
-        if (node.is_null())
+        if (doc.IsNull(node))
         {
             m_translations.push_back(wxString());
             m_isTranslated = false;
         }
         else
         {
-            auto trans = str::to_wx(node.get<std::string>());
+            auto trans = str::to_wx(doc.GetString(node));
             m_translations.push_back(trans);
             m_isTranslated = !trans.empty();
         }
     }
 
-    void UpdateInternalRepresentation() override
+protected:
+    void WriteToDocument(JSONDocument& doc) override
     {
-        m_node = str::to_utf8(GetTranslation());
+        doc.SetString(m_node, str::to_utf8(GetTranslation()));
     }
 };
 
@@ -223,34 +1100,34 @@ class GenericJSONCatalog : public JSONCatalog
 public:
     using JSONCatalog::JSONCatalog;
 
-    static bool SupportsFile(const json_t& doc)
+    static bool SupportsFile(const JSONDocument& doc)
     {
         // note that parsing may still fail, this is just pre-flight
-        return doc.is_object();
+        return doc.IsObject(doc.Root());
     }
 
     void Parse() override
     {
         int id = 0;
-        ParseSubtree(id, m_doc, "");
+        ParseSubtree(id, m_doc->Root(), "");
 
         if (m_items.empty())
             BOOST_THROW_EXCEPTION(JSONUnrecognizedFileException());
     }
 
 private:
-    void ParseSubtree(int& id, json_t& node, const std::string& prefix)
+    void ParseSubtree(int& id, uint32_t node, const std::string& prefix)
     {
-        for (auto& el : node.items())
+        auto& doc = *m_doc;
+        for (auto child : doc.GetChildren(node))
         {
-            auto& val = el.value();
-            if (val.is_string() || val.is_null())
+            if (doc.IsString(child) || doc.IsNull(child))
             {
-                m_items.push_back(std::make_shared<GenericJSONItem>(++id, prefix + el.key(), val));
+                m_items.push_back(MakeItem<GenericJSONItem>(*this, doc, ++id, prefix + doc.GetKey(child), child));
             }
-            else if (val.is_object())
+            else if (doc.IsObject(child))
             {
-                ParseSubtree(id, val, prefix + el.key() + ".");
+                ParseSubtree(id, child, prefix + doc.GetKey(child) + ".");
             }
             else
             {
@@ -267,38 +1144,37 @@ private:
 class FlutterItem : public GenericJSONItem
 {
 public:
-    FlutterItem(int id, const std::string& key, json_t& node, const json_t *metadata)
-        : GenericJSONItem(id, key, node), m_metadata(metadata)
+    FlutterItem(JSONCatalog& owner, const JSONDocument& doc, int id, const std::string& key, uint32_t node, uint32_t metadata)
+        : GenericJSONItem(owner, doc, id, key, node)
     {
-        if (metadata)
+        if (metadata != JSONDocument::NONE)
         {
-            if (metadata->contains("context"))
+            auto context = doc.Find(metadata, "context");
+            if (context != JSONDocument::NONE)
             {
                 m_hasContext = true;
-                m_context = str::to_wx(metadata->at("context").get<std::string>());
+                m_context = str::to_wx(doc.GetString(context));
             }
-            if (metadata->contains("description"))
+            auto description = doc.Find(metadata, "description");
+            if (description != JSONDocument::NONE)
             {
-                m_extractedComments.push_back(str::to_wx(metadata->at("description").get<std::string>()));
+                m_extractedComments.push_back(str::to_wx(doc.GetString(description)));
             }
         }
     }
-
-protected:
-    const json_t *m_metadata;
 };
 
 
 class FlutterCatalog : public JSONCatalog
 {
 public:
-    FlutterCatalog(json_t&& doc) : JSONCatalog(std::move(doc), Type::JSON_FLUTTER) {}
+    FlutterCatalog(std::unique_ptr<JSONDocument>&& doc) : JSONCatalog(std::move(doc), Type::JSON_FLUTTER) {}
 
     wxString GetPreferredExtension() const override { return "arb"; }
 
-    static bool SupportsFile(const json_t& doc, const std::string& extension)
+    static bool SupportsFile(const JSONDocument& doc, const std::string& extension)
     {
-        return extension == "arb" || (doc.is_object() && doc.contains("@@locale"));
+        return extension == "arb" || doc.Find(doc.Root(), "@@locale") != JSONDocument::NONE;
     }
 
     bool HasCapability(Catalog::Cap cap) const override
@@ -311,48 +1187,53 @@ public:
     void SetLanguage(Language lang) override
     {
         JSONCatalog::SetLanguage(lang);
-        m_doc["@@locale"] = lang.Code();
+
+        std::lock_guard<std::mutex> lock(m_documentMutex);
+        m_doc->SetMember(m_doc->Root(), "@@locale", lang.Code());
     }
 
     void Parse() override
     {
-        m_language = Language::TryParse(m_doc.value("@@locale", ""));
+        if (!m_doc->IsObject(m_doc->Root()))
+            BOOST_THROW_EXCEPTION(JSONUnrecognizedFileException());
+
+        m_language = Language::TryParse(m_doc->Value(m_doc->Root(), "@@locale"));
 
         int id = 0;
-        ParseSubtree(id, m_doc, "");
+        ParseSubtree(id, m_doc->Root(), "");
     }
 
 private:
-    void ParseSubtree(int& id, json_t& node, const std::string& prefix)
+    void ParseSubtree(int& id, uint32_t node, const std::string& prefix)
     {
-        // find() is O(n) in ordered_json and so looking up @key metadata nodes in the
-        // main loop would result in O(n^2) complexity. Split the iteration into two and
-        // first find metadata, making the fuction O(n*log(n)). Using ordered_map would
-        // yield O(n), but with possibly high constant, so don't do that for now.
-        std::map<std::string, json_t*> metadata;
-        for (auto& el : node.items())
+        auto& doc = *m_doc;
+
+        // Find() is O(n) and so looking up @key metadata nodes in the main loop would
+        // result in O(n^2) complexity. Split the iteration into two and first find
+        // metadata, making the fuction O(n*log(n)).
+        std::map<std::string, uint32_t> metadata;
+        for (auto child : doc.GetChildren(node))
         {
-            auto& key = el.key();
+            auto key = doc.GetKey(child);
             if (!key.empty() && key.front() == '@')
-                metadata.emplace(key.substr(1), &el.value());
+                metadata.emplace(key.substr(1), child);
         }
 
-        for (auto& el : node.items())
+        for (auto child : doc.GetChildren(node))
         {
-            auto& key = el.key();
+            auto key = doc.GetKey(child);
             if (key.empty() || key.front() == '@')
                 continue;
 
-            auto& val = el.value();
-            if (val.is_string())
+            if (doc.IsString(child))
             {
                 auto mi = metadata.find(key);
-                auto meta = (mi != metadata.end()) ? mi->second : nullptr;
-                m_items.push_back(std::make_shared<FlutterItem>(++id, prefix + el.key(), val, meta));
+                auto meta = (mi != metadata.end()) ? mi->second : JSONDocument::NONE;
+                m_items.push_back(MakeItem<FlutterItem>(*this, doc, ++id, prefix + key, child, meta));
             }
-            else if (val.is_object())
+            else if (doc.IsObject(child))
             {
-                ParseSubtree(id, val, prefix + el.key() + ".");
+                ParseSubtree(id, child, prefix + key + ".");
             }
             else
             {
@@ -374,25 +1255,26 @@ class WebExtensionCatalog : public JSONCatalog
 public:
     using JSONCatalog::JSONCatalog;
 
-    static bool SupportsFile(const json_t& doc)
+    static bool SupportsFile(const JSONDocument& doc)
     {
-        if (!doc.is_object() || doc.empty())
+        if (!doc.IsObject(doc.Root()) || doc.IsEmpty(doc.Root()))
             return false;
 
-        auto first = doc.begin().value();
-        return first.is_object() && first.contains("message");
+        auto first = *doc.GetChildren(doc.Root()).begin();
+        return doc.IsObject(first) && doc.Find(first, "message") != JSONDocument::NONE;
     }
 
     void Parse() override
     {
+        auto& doc = *m_doc;
+
         int id = 0;
-        for (auto& el : m_doc.items())
+        for (auto child : doc.GetChildren(doc.Root()))
         {
-            auto& val = el.value();
-            if (!val.is_object())
+            if (!doc.IsObject(child))
                 BOOST_THROW_EXCEPTION(JSONUnrecognizedFileException());
 
-            m_items.push_back(std::make_shared<Item>(++id, el.key(), val));
+            m_items.push_back(MakeItem<Item>(*this, doc, ++id, doc.GetKey(child), child));
         }
 
         if (m_items.empty())
@@ -403,25 +1285,27 @@ protected:
     class Item : public JSONCatalogItem
     {
     public:
-        Item(int id, const std::string& key, json_t& node) : JSONCatalogItem(id, node)
+        Item(JSONCatalog& owner, const JSONDocument& doc, int id, const std::string& key, uint32_t node)
+            : JSONCatalogItem(owner, id, node)
         {
             m_string = str::to_wx(key);
 
-            auto trans = str::to_wx(node.value("message", ""));
+            auto trans = str::to_wx(doc.Value(node, "message"));
             m_translations.push_back(trans);
             m_isTranslated = !trans.empty();
 
-            auto desc = node.value("description", "");
+            auto desc = doc.Value(node, "description");
             if (!desc.empty())
                 m_extractedComments.push_back(str::to_wx(desc));
         }
 
-        void UpdateInternalRepresentation() override
+        std::string GetInternalFormatFlag() const override { return "ph-dollars"; }
+
+    protected:
+        void WriteToDocument(JSONDocument& doc) override
         {
-            m_node["message"] = str::to_utf8(GetTranslation());
+            doc.SetMember(m_node, "message", str::to_utf8(GetTranslation()));
         }
-
-        std::string GetInternalFormatFlag() const override { return "ph-dollars"; }
     };
 };
 
@@ -431,9 +1315,9 @@ class LocalazyCatalog : public JSONCatalog
 public:
     using JSONCatalog::JSONCatalog;
 
-    static bool SupportsFile(const json_t& doc)
+    static bool SupportsFile(const JSONDocument& doc)
     {
-        return doc.value("generator", "") == "Localazy";
+        return doc.Value(doc.Root(), "generator") == "Localazy";
     }
 
     bool HasCapability(Catalog::Cap cap) const override
@@ -445,22 +1329,25 @@ public:
 
     void Parse() override
     {
-        m_header.SetHeader("X-Generator", m_doc.value("generator", ""));
-        m_header.SetHeader("X-Localazy-Project", m_doc.value("projectId", ""));
-        m_language = Language::FromLanguageTag(m_doc.value("targetLocale", ""));
+        auto& doc = *m_doc;
+        const auto root = doc.Root();
+
+        m_header.SetHeader("X-Generator", doc.Value(root, "generator"));
+        m_header.SetHeader("X-Localazy-Project", doc.Value(root, "projectId"));
+        m_language = Language::FromLanguageTag(doc.Value(root, "targetLocale"));
 
         int id = 0;
-        for (auto& file : m_doc.at("files"))
+        for (auto file : doc.GetChildren(doc.At(root, "files")))
         {
-            auto filename = file.value("name", "");
+            auto filename = doc.Value(file, "name");
 
-            for (auto& tr : file.at("translations"))
+            for (auto tr : doc.GetChildren(doc.At(file, "translations")))
             {
                 // FIXME: for now, skip plural forms and string lists
-                if (!tr.at("source").is_string())
+                if (!doc.IsString(doc.At(tr, "source")))
                     continue;
 
-                m_items.push_back(std::make_shared<Item>(++id, filename, tr));
+                m_items.push_back(MakeItem<Item>(*this, doc, ++id, filename, tr));
             }
         }
     }
@@ -468,53 +1355,51 @@ public:
     void SetLanguage(Language lang) override
     {
         JSONCatalog::SetLanguage(lang);
-        m_doc["targetLocale"] = lang.LanguageTag();
+
+        std::lock_guard<std::mutex> lock(m_documentMutex);
+        m_doc->SetMember(m_doc->Root(), "targetLocale", lang.LanguageTag());
     }
 
 protected:
     class Item : public JSONCatalogItem
     {
     public:
-        Item(int id, const std::string& filename, json_t& node)
-            : JSONCatalogItem(id, node), m_filename(filename)
+        Item(JSONCatalog& owner, const JSONDocument& doc, int id, const std::string& filename, uint32_t node)
+            : JSONCatalogItem(owner, id, node), m_filename(filename)
         {
-            m_string = str::to_wx(node.at("source").get<std::string>());
-            auto trans = str::to_wx(node.value("value", ""));
+            m_string = str::to_wx(doc.GetString(doc.At(node, "source")));
+            auto trans = str::to_wx(doc.Value(node, "value"));
             m_translations.push_back(trans);
             m_isTranslated = !trans.empty();
 
-            if (node.contains("meta"))
+            auto meta = doc.Find(node, "meta");
+            if (meta != JSONDocument::NONE)
             {
-                auto& meta = node["meta"];
-                m_moreFlags = str::to_wx(meta.value("placeholders", ""));
-                if (meta.contains("key"))
-                    m_extractedComments.push_back("ID: " + str::to_wx(meta["key"].get<std::string>()));
+                m_moreFlags = str::to_wx(doc.Value(meta, "placeholders"));
+                auto key = doc.Find(meta, "key");
+                if (key != JSONDocument::NONE)
+                    m_extractedComments.push_back("ID: " + str::to_wx(doc.GetString(key)));
             }
 
-            if (node.contains("context"))
+            auto ctxt = doc.Find(node, "context");
+            if (ctxt != JSONDocument::NONE)
             {
-                auto& ctxt = node["context"];
-                auto desc = ctxt.value("description", "");
+                auto desc = doc.Find(ctxt, "description");
+                if (desc != JSONDocument::NONE)
+                    m_extractedComments.push_back(str::to_wx(doc.GetString(desc)));
 
-                if (ctxt.contains("description"))
-                    m_extractedComments.push_back(str::to_wx(ctxt.at("description").get<std::string>()));
-
-                if (ctxt.contains("screenshots"))
+                auto screenshots = doc.Find(ctxt, "screenshots");
+                if (screenshots != JSONDocument::NONE)
                 {
                     if (!m_extractedComments.empty())
                         m_extractedComments.push_back("");
                     m_extractedComments.push_back(_("Screenshots:"));
-                    for (auto& link : ctxt.at("screenshots"))
-                        m_extractedComments.push_back(str::to_wx(link.get<std::string>()));
+                    for (auto link : doc.GetChildren(screenshots))
+                        m_extractedComments.push_back(str::to_wx(doc.GetString(link)));
                 }
             }
         }
 
-        void UpdateInternalRepresentation() override
-        {
-            m_node["value"] = str::to_utf8(GetTranslation());
-        }
-
         wxArrayString GetReferences() const override
         {
             wxArrayString refs;
@@ -523,6 +1408,12 @@ protected:
             return refs;
         }
 
+    protected:
+        void WriteToDocument(JSONDocument& doc) override
+        {
+            doc.SetMember(m_node, "value", str::to_utf8(GetTranslation()));
+        }
+
     private:
         std::string m_filename;
     };
@@ -530,18 +1421,18 @@ protected:
 };
 
 
-std::shared_ptr<JSONCatalog> JSONCatalog::CreateForJSON(json_t&& doc, const std::string& extension)
+std::shared_ptr<JSONCatalog> JSONCatalog::CreateForJSON(std::unique_ptr<JSONDocument>&& doc, const std::string& extension)
 {
     // try specialized implementations first:
-    if (FlutterCatalog::SupportsFile(doc, extension))
+    if (FlutterCatalog::SupportsFile(*doc, extension))
         return std::shared_ptr<JSONCatalog>(new FlutterCatalog(std::move(doc)));
-    if (WebExtensionCatalog::SupportsFile(doc))
+    if (WebExtensionCatalog::SupportsFile(*doc))
         return std::shared_ptr<JSONCatalog>(new WebExtensionCatalog(std::move(doc)));
-    if (LocalazyCatalog::SupportsFile(doc))
+    if (LocalazyCatalog::SupportsFile(*doc))
         return std::shared_ptr<JSONCatalog>(new LocalazyCatalog(std::move(doc)));
 
     // then fall back to generic:
-    if (GenericJSONCatalog::SupportsFile(doc))
+    if (GenericJSONCatalog::SupportsFile(*doc))
         return std::shared_ptr<JSONCatalog>(new GenericJSONCatalog(std::move(doc)));
 
     return nullptr;
@@ -29,10 +29,14 @@
 #include "catalog.h"
 #include "errors.h"
 
-#include "json.h"
-
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 
+class JSONCatalog;
+class JSONDocument;
+
 
 class JSONFileException : public Exception
 {
@@ -44,9 +48,8 @@ public:
 class JSONCatalogItem : public CatalogItem
 {
 public:
-    typedef ordered_json json_t;
-
-    JSONCatalogItem(int id, json_t& node) : m_node(node)
+    /// @a node is index of the item's node in the owner's JSONDocument
+    JSONCatalogItem(JSONCatalog& owner, int id, uint32_t node) : m_owner(owner), m_node(node)
     {
         m_id = id;
         m_isFuzzy = false; // not supported
@@ -57,16 +60,26 @@ public:
     wxArrayString GetReferences() const override { return wxArrayString(); }
 
 protected:
-    json_t& m_node;
+    /// Only marks the item for writing by JSONCatalog::SyncDocument()
+    void UpdateInternalRepresentation() override;
+
+    /// Writes item's content into @a doc; only called by SyncDocument()
+    virtual void WriteToDocument(JSONDocument& doc) = 0;
+
+protected:
+    JSONCatalog& m_owner;
+    uint32_t m_node;
+
+    std::atomic<bool> m_documentDirty{false};
+
+    friend class JSONCatalog;
 };
 
 
 class JSONCatalog : public Catalog
 {
 public:
-    typedef ordered_json json_t;
-
-    ~JSONCatalog() {}
+    ~JSONCatalog();
 
     bool HasCapability(Cap cap) const override;
 
@@ -81,19 +94,28 @@ public:
 
     std::string SaveToBuffer() override;
 
+    void AddFormatMemoryUsage(CatalogMemoryUsage& usage) const override;
+
     Language GetLanguage() const override { return m_language; }
     void SetLanguage(Language lang) override { m_language = lang; }
 
 protected:
-    JSONCatalog(json_t&& doc, Type type = Type::JSON) : Catalog(type), m_doc(std::move(doc)) {}
+    JSONCatalog(std::unique_ptr<JSONDocument>&& doc, Type type = Type::JSON);
 
     virtual void Parse() = 0;
 
+    /// Writes changed items into the document, as XLIFFCatalog::SyncDocument() does.
+    /// Must be called with m_documentMutex locked.
+    void SyncDocument();
+
 private:
-    static std::shared_ptr<JSONCatalog> CreateForJSON(json_t&& doc, const std::string& extension);
+    static std::shared_ptr<JSONCatalog> CreateForJSON(std::unique_ptr<JSONDocument>&& doc, const std::string& extension);
 
 protected:
-    json_t m_doc;
+    mutable std::mutex m_documentMutex;
+    std::atomic<bool> m_documentDirty{false};
+    std::unique_ptr<JSONDocument> m_doc;
+
     Language m_language;
 
     struct FormattingRules
@@ -103,6 +125,8 @@ protected:
         bool dos_line_endings;
     };
     FormattingRules m_formatting;
+
+    friend class JSONCatalogItem;
 };
 
 
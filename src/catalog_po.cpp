@@ -25,16 +25,20 @@
 
 #include "catalog_po.h"
 
+#include "cat_operations.h"
 #include "configuration.h"
 #include "errors.h"
 #include "extractors/extractor.h"
 #include "gexecute.h"
+#include "msgfmt_checks.h"
 #include "str_helpers.h"
+#include "tracing.h"
 #include "utility.h"
 #include "version.h"
 #include "language.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <wx/utils.h>
 #include <wx/tokenzr.h>
 #include <wx/log.h>
@@ -45,11 +49,19 @@
 #include <wx/scopeguard.h>
 #include <wx/stdpaths.h>
 #include <wx/strconv.h>
-#include <wx/memtext.h>
 #include <wx/filename.h>
 
 #include <set>
 #include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <unicode/uchar.h>
+#include <unicode/utf16.h>
 
 #ifdef __WXOSX__
 #import <Foundation/Foundation.h>
@@ -60,6 +72,13 @@
     #include <wx/msgdlg.h>
 #endif
 
+// Parallel parsing and merging use dispatch's background queue, which isn't available
+// in the non-GUI QuickLook extensions that also compile this file:
+#if wxUSE_GUI
+    #include "concurrency.h"
+    #define HAVE_PARALLEL_PROCESSING
+#endif
+
 // ----------------------------------------------------------------------
 // Textfile processing utilities:
 // ----------------------------------------------------------------------
@@ -67,30 +86,128 @@
 namespace
 {
 
+inline bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline bool StartsWith(std::string_view s, std::string_view prefix)
+{
+    return s.size() >= prefix.size() && memcmp(s.data(), prefix.data(), prefix.size()) == 0;
+}
+
+inline bool EndsWith(std::string_view s, std::string_view suffix)
+{
+    return s.size() >= suffix.size() && memcmp(s.data() + s.size() - suffix.size(), suffix.data(), suffix.size()) == 0;
+}
+
+inline std::string_view TrimRight(std::string_view s)
+{
+    while (!s.empty() && IsSpace(s.back()))
+        s.remove_suffix(1);
+    return s;
+}
+
+inline std::string_view WithoutLast(std::string_view s)
+{
+    if (!s.empty())
+        s.remove_suffix(1);
+    return s;
+}
+
+// Returns content of "quoted" line, without the quotes
+inline std::string_view QuotedContent(std::string_view s)
+{
+    return s.size() >= 2 ? s.substr(1, s.size() - 2) : std::string_view();
+}
+
+// Number of code points in UTF-8 text
+inline size_t UTF8Length(std::string_view s)
+{
+    size_t len = 0;
+    for (auto c: s)
+    {
+        if ((c & 0xC0) != 0x80)
+            len++;
+    }
+    return len;
+}
+
+// Only materialize wxString when the parsed value is actually stored:
+inline wxString ToWx(std::string_view s)
+{
+    return str::from_valid_utf8(s.data(), s.size());
+}
+
+// Appends C-unescaped version of s to out
+void AppendUnescaped(std::string& out, std::string_view s)
+{
+    size_t start = 0;
+    for (;;)
+    {
+        auto bs = s.find('\\', start);
+        if (bs == std::string_view::npos)
+        {
+            out.append(s.data() + start, s.size() - start);
+            return;
+        }
+
+        out.append(s.data() + start, bs - start);
+        if (bs + 1 == s.size())
+        {
+            out += '\\';
+            return;
+        }
+
+        const char c = s[bs + 1];
+        switch (c)
+        {
+            case 'a': out += '\a'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'v': out += '\v'; break;
+            case '\\':
+            case '"':
+            case '\'':
+            case '?':
+                out += c;
+                break;
+            default:
+                out += '\\';
+                out += c;
+                break;
+        }
+        start = bs + 2;
+    }
+}
+
 // If input begins with pattern, fill output with end of input (without
 // pattern; strips trailing spaces) and return true.  Return false otherwise
 // and don't touch output. Is permissive about whitespace in the input:
 // a space (' ') in pattern will match any number of any whitespace characters
 // on that position in input.
-bool ReadParam(const wxString& input, const wxString& pattern, wxString& output, bool preserveWhitespace = false)
+bool ReadParam(std::string_view input, std::string_view pattern, std::string_view& output, bool preserveWhitespace = false)
 {
     if (input.size() < pattern.size())
         return false;
 
-    unsigned in_pos = 0;
-    unsigned pat_pos = 0;
+    size_t in_pos = 0;
+    size_t pat_pos = 0;
     while (pat_pos < pattern.size() && in_pos < input.size())
     {
-        const wxChar pat = pattern[pat_pos++];
+        const char pat = pattern[pat_pos++];
 
-        if (pat == _T(' '))
+        if (pat == ' ')
         {
-            if (!wxIsspace(input[in_pos++]))
+            if (!IsSpace(input[in_pos++]))
                 return false;
 
             if (!preserveWhitespace)
             {
-                while (wxIsspace(input[in_pos]))
+                while (in_pos < input.size() && IsSpace(input[in_pos]))
                 {
                     in_pos++;
                     if (in_pos == input.size())
@@ -109,56 +226,15 @@ bool ReadParam(const wxString& input, const wxString& pattern, wxString& output,
     if (pat_pos < pattern.size()) // pattern not fully matched
         return false;
 
-    output = input.Mid(in_pos);
+    output = input.substr(in_pos);
     if (!preserveWhitespace)
-        output.Trim(true); // trailing whitespace
+        output = TrimRight(output); // trailing whitespace
     return true;
 }
 
 
-// Checks if the file was loaded correctly, i.e. that non-empty lines
-// ended up non-empty in memory, after doing charset conversion in
-// wxTextFile. This detects for example files that claim they are in UTF-8
-// while in fact they are not.
-bool VerifyFileCharset(const wxTextFile& f, const wxString& filename,
-                       const wxString& charset)
-{
-    wxTextFile f2;
-
-    if (!f2.Open(filename, wxConvISO8859_1))
-        return false;
-
-    if (f.GetLineCount() != f2.GetLineCount())
-    {
-        int linesCount = (int)f2.GetLineCount() - (int)f.GetLineCount();
-        wxLogError(wxPLURAL(L"%i line of file “%s” was not loaded correctly.",
-                            L"%i lines of file “%s” were not loaded correctly.",
-                            linesCount),
-                   linesCount,
-                   filename.c_str());
-        return false;
-    }
-
-    bool ok = true;
-    size_t cnt = f.GetLineCount();
-    for (size_t i = 0; i < cnt; i++)
-    {
-        if (f[i].empty() && !f2[i].empty()) // wxMBConv conversion failed
-        {
-            wxLogError(
-                _(L"Line %d of file “%s” is corrupted (not valid %s data)."),
-                int(i), filename.c_str(), charset.c_str());
-            ok = false;
-        }
-    }
-
-    return ok;
-}
-
-
-wxTextFileType GetFileCRLFFormat(wxTextFile& po_file)
+wxTextFileType GetFileCRLFFormat(const POTextReader& po_file)
 {
-    wxLogNull null;
     auto crlf = po_file.GuessType();
 
     // Discard any unsupported setting. In particular, we ignore "Mac"
@@ -189,41 +265,366 @@ wxTextFileType GetDesiredCRLFFormat(wxTextFileType existingCRLF)
     }
 }
 
+// Does the line ending at pos end a complete entry, i.e. is it a msgstr line
+// or continuation of one? Walks back over continuation lines to find out.
+bool IsEndOfEntryAt(const char *begin, const char *pos)
+{
+    for (;;)
+    {
+        const char *start = pos;
+        while (start > begin && start[-1] != '\n')
+            --start;
+
+        std::string_view line(start, pos - start);
+        if (StartsWith(line, "msgstr") || StartsWith(line, "#~ msgstr"))
+            return true;
+        if (start == begin || (!StartsWith(line, "\"") && !StartsWith(line, "#~ \"")))
+            return false;
+
+        pos = start - 1;  // points at the previous line's '\n'
+        if (pos > begin && pos[-1] == '\r')
+            --pos;
+    }
+}
+
+// Can a new chunk, parsed independently, start at pos? This is only safe
+// at a blank line between a complete entry and the start of the next one.
+// Starting at the blank line (and not the entry) ensures that the entry's
+// first line goes through ReadTextLine() just as it would in Parse() of
+// the whole file.
+bool IsChunkBoundary(const char *begin, const char *end, const char *pos)
+{
+    const char *next = pos;
+    if (next < end && *next == '\r')
+        ++next;
+    if (next >= end || *next != '\n')
+        return false;
+    ++next;
+
+    std::string_view nextLine(next, std::min<size_t>(end - next, 16));
+    if (StartsWith(nextLine, "#~"))
+    {
+        // deleted entries are only terminated by a new "#~ msgid" line:
+        if (!StartsWith(nextLine, "#~ msgid"))
+            return false;
+    }
+    else if (!StartsWith(nextLine, "#") && !StartsWith(nextLine, "msgid ") && !StartsWith(nextLine, "msgctxt "))
+    {
+        return false;
+    }
+
+    // end of the line preceding the blank one:
+    const char *prev = pos - 1;
+    if (prev > begin && prev[-1] == '\r')
+        --prev;
+    return IsEndOfEntryAt(begin, prev);
+}
+
+// Files larger than this are only partially loaded with CreationFlag_Preview:
+const size_t PREVIEW_MAX_FULL_SIZE = 4 * 1024 * 1024;
+// ...and this much of them is loaded:
+const size_t PREVIEW_LOADED_SIZE = 512 * 1024;
+
+// Returns the size of the initial part of the data, ending at an entry
+// boundary, that is parsed when loading with CreationFlag_Preview
+size_t GetPreviewSize(const char *data, size_t size)
+{
+    if (size <= PREVIEW_MAX_FULL_SIZE)
+        return size;
+
+    const char *end = data + size;
+    const char *pos = data + PREVIEW_LOADED_SIZE;
+    while (pos < end)
+    {
+        auto nl = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        if (!nl)
+            break;
+        pos = nl + 1;
+        if (pos < end && IsChunkBoundary(data, end, pos))
+            return pos - data;
+    }
+    return size;
+}
+
+#ifdef HAVE_PARALLEL_PROCESSING
+
+// Files smaller than this aren't worth parsing in parallel:
+const size_t MIN_PARALLEL_CHUNK_SIZE = 1024 * 1024;
+
+// Splits the file data into chunks that can be parsed independently by
+// POCatalogParser, with boundaries between entries. Returns just one chunk
+// spanning the whole data if the file is too small to benefit from splitting.
+std::vector<std::string_view> SplitIntoParsingChunks(const char *data, size_t size)
+{
+    std::vector<std::string_view> chunks;
+
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const size_t count = std::min(cores, size / MIN_PARALLEL_CHUNK_SIZE);
+    if (count < 2)
+    {
+        chunks.emplace_back(data, size);
+        return chunks;
+    }
+
+    const char *end = data + size;
+    const char *chunkStart = data;
+    for (size_t i = 1; i < count; i++)
+    {
+        const char *pos = std::max(data + i * (size / count), chunkStart + 1);
+        const char *boundary = nullptr;
+        while (pos < end)
+        {
+            auto nl = static_cast<const char*>(memchr(pos, '\n', end - pos));
+            if (!nl)
+                break;
+            pos = nl + 1;
+            if (pos < end && IsChunkBoundary(data, end, pos))
+            {
+                boundary = pos;
+                break;
+            }
+        }
+        if (!boundary)
+            break;
+
+        chunks.emplace_back(chunkStart, boundary - chunkStart);
+        chunkStart = boundary;
+    }
+
+    chunks.emplace_back(chunkStart, end - chunkStart);
+    return chunks;
+}
+
+#endif // HAVE_PARALLEL_PROCESSING
+
 } // anonymous namespace
 
 
+// ----------------------------------------------------------------------
+// POTextReader
+// ----------------------------------------------------------------------
+
+POTextReader::POTextReader(const char *data, size_t length)
+    : m_begin(data), m_end(data + length), m_pos(data),
+      m_currentLine(0),
+      m_encoding(Encoding::Latin1),
+      m_allValidUTF8(false),
+      m_countUnix(0), m_countDos(0), m_countMac(0)
+{
+}
+
+bool POTextReader::SetCharset(const wxString& charset)
+{
+    m_corruptedLines.clear();
+    m_conv.reset();
+
+    auto lower = charset.Lower();
+    if (lower == "utf-8" || lower == "utf8")
+    {
+        m_encoding = Encoding::UTF8;
+        // validating everything at once is faster than doing it line by line:
+        m_allValidUTF8 = str::is_valid_utf8(m_begin, m_end - m_begin);
+        return true;
+    }
+    else if (lower == "iso-8859-1" || lower == "latin1")
+    {
+        m_encoding = Encoding::Latin1;
+        return true;
+    }
+
+    m_encoding = Encoding::Other;
+    m_conv.reset(new wxCSConv(charset));
+    return m_conv->IsOk();
+}
+
+std::string_view POTextReader::GetFirstLine()
+{
+    m_pos = m_begin;
+    m_currentLine = 0;
+    m_countUnix = m_countDos = m_countMac = 0;
+
+    // be lenient about (technically invalid) BOM in UTF-8 files:
+    if (m_encoding == Encoding::UTF8 && m_end - m_begin >= 3 && memcmp(m_begin, "\xEF\xBB\xBF", 3) == 0)
+        m_pos += 3;
+
+    return ReadLine();
+}
+
+std::string_view POTextReader::GetNextLine()
+{
+    m_currentLine++;
+    return ReadLine();
+}
+
+std::string_view POTextReader::ReadLine()
+{
+    if (m_pos >= m_end)
+        return std::string_view();
+
+    const char *start = m_pos;
+    const char *nl = static_cast<const char*>(memchr(start, '\n', m_end - start));
+    const char *eol = nl ? nl : m_end;
+    const char *cr = static_cast<const char*>(memchr(start, '\r', eol - start));
+    if (cr)
+    {
+        if (cr + 1 == nl)
+        {
+            m_countDos++;
+            m_pos = nl + 1;
+        }
+        else
+        {
+            m_countMac++;
+            m_pos = cr + 1;
+        }
+        eol = cr;
+    }
+    else if (nl)
+    {
+        m_countUnix++;
+        m_pos = nl + 1;
+    }
+    else
+    {
+        m_pos = m_end;
+    }
+
+    const size_t len = eol - start;
+    if (len == 0)
+        return std::string_view();
+
+    switch (m_encoding)
+    {
+        case Encoding::UTF8:
+        {
+            // zero-copy fast path, just point into the data:
+            if (m_allValidUTF8 || str::is_valid_utf8(start, len))
+                return std::string_view(start, len);
+            break;
+        }
+
+        case Encoding::Latin1:
+        {
+            auto i = start;
+            while (i < eol && (unsigned char)*i < 0x80)
+                ++i;
+            if (i == eol)
+                return std::string_view(start, len);
+
+            m_lineBuffer.assign(start, i);
+            for (; i < eol; ++i)
+            {
+                const unsigned char c = *i;
+                if (c < 0x80)
+                {
+                    m_lineBuffer += char(c);
+                }
+                else
+                {
+                    m_lineBuffer += char(0xC0 | (c >> 6));
+                    m_lineBuffer += char(0x80 | (c & 0x3F));
+                }
+            }
+            return m_lineBuffer;
+        }
+
+        case Encoding::Other:
+        {
+            wxString decoded(start, *m_conv, len);
+            if (decoded.empty())
+                break;
+            m_lineBuffer = decoded.utf8_string();
+            return m_lineBuffer;
+        }
+    }
+
+    // non-empty line ended up empty, i.e. the conversion failed:
+    m_corruptedLines.push_back(m_currentLine + 1);
+    return std::string_view();
+}
+
+wxTextFileType POTextReader::GuessType() const
+{
+    if (m_countDos > m_countUnix && m_countDos > m_countMac)
+        return wxTextFileType_Dos;
+    if (m_countUnix > m_countDos && m_countUnix > m_countMac)
+        return wxTextFileType_Unix;
+    if (m_countMac > m_countDos && m_countMac > m_countUnix)
+        return wxTextFileType_Mac;
+    return wxTextBuffer::typeDefault;
+}
+
+void POTextReader::ClearStats()
+{
+    m_countUnix = m_countDos = m_countMac = 0;
+    m_corruptedLines.clear();
+}
+
+void POTextReader::AppendStatsFrom(const POTextReader& next)
+{
+    const size_t offset = GetLineBreaksCount();
+    for (auto line: next.m_corruptedLines)
+        m_corruptedLines.push_back(line + offset);
+
+    m_countUnix += next.m_countUnix;
+    m_countDos += next.m_countDos;
+    m_countMac += next.m_countMac;
+}
+
+
 // ----------------------------------------------------------------------
 // Parsers
 // ----------------------------------------------------------------------
 
 bool POCatalogParser::Parse()
 {
-    static const wxString prefix_flags(wxS("#, "));
-    static const wxString prefix_flags_alt(wxS("#= "));
-    static const wxString prefix_autocomments(wxS("#. "));
-    static const wxString prefix_autocomments2(wxS("#.")); // account for empty auto comments
-    static const wxString prefix_references(wxS("#: "));
-    static const wxString prefix_prev_msgid(wxS("#| "));
-    static const wxString prefix_msgctxt(wxS("msgctxt \""));
-    static const wxString prefix_msgid(wxS("msgid \""));
-    static const wxString prefix_msgid_plural(wxS("msgid_plural \""));
-    static const wxString prefix_msgstr(wxS("msgstr \""));
-    static const wxString prefix_msgstr_plural(wxS("msgstr["));
-    static const wxString prefix_deleted(wxS("#~"));
-    static const wxString prefix_deleted_msgid(wxS("#~ msgid"));
-
-    if (m_textFile->GetLineCount() == 0)
+    static const std::string_view prefix_flags("#, ");
+    static const std::string_view prefix_flags_alt("#= ");
+    static const std::string_view prefix_autocomments("#. ");
+    static const std::string_view prefix_autocomments2("#."); // account for empty auto comments
+    static const std::string_view prefix_references("#: ");
+    static const std::string_view prefix_prev_msgid("#| ");
+    static const std::string_view prefix_msgctxt("msgctxt \"");
+    static const std::string_view prefix_msgid("msgid \"");
+    static const std::string_view prefix_msgid_plural("msgid_plural \"");
+    static const std::string_view prefix_msgstr("msgstr \"");
+    static const std::string_view prefix_msgstr_plural("msgstr[");
+    static const std::string_view prefix_deleted("#~");
+    static const std::string_view prefix_deleted_msgid("#~ msgid");
+
+    if (m_textFile->IsEmpty())
         return false;
 
-    wxString line, dummy;
-    wxString mflags, mstr, msgid_plural, mcomment;
-    wxArrayString mrefs, mextractedcomments, mtranslations;
-    wxArrayString msgid_old;
+    // The tokenizer works on UTF-8 slices of the input and only converts to
+    // wxString when a value is passed on to OnEntry(), so the accumulated
+    // values are kept in UTF-8 too:
+    std::string_view line, dummy;
+    std::string mflags, mstr, msgid_plural, mcomment, msgctxt, str;
+    wxArrayString mrefs, mtranslations;
+    // rarely needed, so not converted to wxString at all here:
+    PORawLines mextractedcomments, msgid_old;
     bool has_plural = false;
     bool has_context = false;
-    wxString msgctxt;
     unsigned mlinenum = 0;
 
+    // Reads continuation lines of a multi-line string, leaving the first
+    // line that isn't part of it in 'line':
+    auto readContinuationLines = [&](std::string& out)
+    {
+        while (!(line = ReadTextLine()).empty())
+        {
+            if (line[0] == '\t')
+                line.remove_prefix(1);
+            if (!line.empty() && line.front() == '"' && line.back() == '"')
+            {
+                AppendUnescaped(out, QuotedContent(line));
+                PossibleWrappedLine();
+            }
+            else
+                break;
+        }
+    };
+
     line = m_textFile->GetFirstLine();
     if (line.empty())
         line = ReadTextLine();
@@ -232,104 +633,81 @@ bool POCatalogParser::Parse()
     {
         // ignore empty special tags (except for extracted comments which we
         // DO want to preserve):
-        while (line.length() == 2 && *line.begin() == '#' && (line[1] == ',' || line[1] == '=' || line[1] == ':' || line[1] == '|'))
+        while (line.length() == 2 && line[0] == '#' && (line[1] == ',' || line[1] == '=' || line[1] == ':' || line[1] == '|'))
             line = ReadTextLine();
+        if (line.empty())
+            break;
+
+        // Dispatch on the first one or two bytes, so that at most one or two
+        // prefixes (of the same kind) have to be compared:
+        const char c0 = line[0];
+        const char c1 = line.size() > 1 ? line[1] : '\0';
 
         // flags:
-        if (ReadParam(line, prefix_flags, dummy) || ReadParam(line, prefix_flags_alt, dummy))
+        if (c0 == '#' && ((c1 == ',' && ReadParam(line, prefix_flags, dummy)) || (c1 == '=' && ReadParam(line, prefix_flags_alt, dummy))))
         {
             // see https://lists.gnu.org/archive/html/bug-gettext/2025-06/msg00018.html for introduction of
             // the #= alt form. We currently take the approach of converting #= to #, on write, as msgcat
             // also does, but this is just the initial, interim implementation
-            static wxString prefix_flags_partial(wxS(", "));
-            mflags += prefix_flags_partial;
+            mflags += ", ";
             mflags += dummy;
             line = ReadTextLine();
         }
 
         // auto comments:
-        else if (ReadParam(line, prefix_autocomments, dummy, /*preserveWhitespace=*/true) || ReadParam(line, prefix_autocomments2, dummy, /*preserveWhitespace=*/true))
+        else if (c0 == '#' && c1 == '.' &&
+                 (ReadParam(line, prefix_autocomments, dummy, /*preserveWhitespace=*/true) || ReadParam(line, prefix_autocomments2, dummy, /*preserveWhitespace=*/true)))
         {
             mextractedcomments.Add(dummy);
             line = ReadTextLine();
         }
 
         // references:
-        else if (ReadParam(line, prefix_references, dummy, /*preserveWhitespace=*/true))
+        else if (c0 == '#' && c1 == ':' && ReadParam(line, prefix_references, dummy, /*preserveWhitespace=*/true))
         {
             // Just store the references unmodified, we don't modify this
             // data anywhere.
-            mrefs.push_back(dummy);
+            mrefs.push_back(ToWx(dummy));
             line = ReadTextLine();
         }
 
         // previous msgid value:
-        else if (ReadParam(line, prefix_prev_msgid, dummy))
+        else if (c0 == '#' && c1 == '|' && ReadParam(line, prefix_prev_msgid, dummy))
         {
             msgid_old.Add(dummy);
             line = ReadTextLine();
         }
 
         // msgctxt:
-        else if (ReadParam(line, prefix_msgctxt, dummy))
+        else if (c0 == 'm' && c1 == 's' && ReadParam(line, prefix_msgctxt, dummy))
         {
             has_context = true;
-            msgctxt = UnescapeCString(dummy.RemoveLast());
-            while (!(line = ReadTextLine()).empty())
-            {
-                if (line[0u] == _T('\t'))
-                    line.Remove(0, 1);
-                if (line[0u] == _T('"') && line.Last() == _T('"'))
-                {
-                    msgctxt += UnescapeCString(line.Mid(1, line.Length() - 2));
-                    PossibleWrappedLine();
-                }
-                else
-                    break;
-            }
+            msgctxt.clear();
+            AppendUnescaped(msgctxt, WithoutLast(dummy));
+            readContinuationLines(msgctxt);
         }
 
         // msgid:
-        else if (ReadParam(line, prefix_msgid, dummy))
+        else if (c0 == 'm' && c1 == 's' && ReadParam(line, prefix_msgid, dummy))
         {
-            mstr = UnescapeCString(dummy.RemoveLast());
+            mstr.clear();
+            AppendUnescaped(mstr, WithoutLast(dummy));
             mlinenum = unsigned(m_textFile->GetCurrentLine() + 1);
-            while (!(line = ReadTextLine()).empty())
-            {
-                if (line[0u] == wxS('\t'))
-                    line.Remove(0, 1);
-                if (line[0u] == wxS('"') && line.Last() == wxS('"'))
-                {
-                    mstr += UnescapeCString(line.Mid(1, line.Length() - 2));
-                    PossibleWrappedLine();
-                }
-                else
-                    break;
-            }
+            readContinuationLines(mstr);
         }
 
         // msgid_plural:
-        else if (ReadParam(line, prefix_msgid_plural, dummy))
+        else if (c0 == 'm' && c1 == 's' && ReadParam(line, prefix_msgid_plural, dummy))
         {
-            msgid_plural = UnescapeCString(dummy.RemoveLast());
+            msgid_plural.clear();
+            AppendUnescaped(msgid_plural, WithoutLast(dummy));
             has_plural = true;
             mlinenum = unsigned(m_textFile->GetCurrentLine() + 1);
-            while (!(line = ReadTextLine()).empty())
-            {
-                if (line[0u] == _T('\t'))
-                    line.Remove(0, 1);
-                if (line[0u] == _T('"') && line.Last() == _T('"'))
-                {
-                    msgid_plural += UnescapeCString(line.Mid(1, line.Length() - 2));
-                    PossibleWrappedLine();
-                }
-                else
-                    break;
-            }
+            readContinuationLines(msgid_plural);
         }
 
         // msgstr:
-        else if (ReadParam(line, prefix_msgstr, dummy))
+        else if (c0 == 'm' && c1 == 's' && ReadParam(line, prefix_msgstr, dummy))
         {
             if (has_plural)
             {
@@ -337,20 +715,10 @@ bool POCatalogParser::Parse()
                 return false;
             }
 
-            wxString str = UnescapeCString(dummy.RemoveLast());
-            while (!(line = ReadTextLine()).empty())
-            {
-                if (line[0u] == _T('\t'))
-                    line.Remove(0, 1);
-                if (line[0u] == _T('"') && line.Last() == _T('"'))
-                {
-                    str += UnescapeCString(line.Mid(1, line.Length() - 2));
-                    PossibleWrappedLine();
-                }
-                else
-                    break;
-            }
-            mtranslations.Add(str);
+            str.clear();
+            AppendUnescaped(str, WithoutLast(dummy));
+            readContinuationLines(str);
+            mtranslations.Add(ToWx(str));
 
             bool shouldIgnore = m_ignoreHeader && (mstr.empty() && !has_context);
             if ( shouldIgnore )
@@ -362,26 +730,30 @@ bool POCatalogParser::Parse()
                 if (!mstr.empty() && m_ignoreTranslations)
                     mtranslations.clear();
 
-                if (!OnEntry(mstr, wxEmptyString, false,
-                             has_context, msgctxt,
+                if (!OnEntry(ToWx(mstr), wxEmptyString, false,
+                             has_context, ToWx(msgctxt),
                              mtranslations,
-                             mflags, mrefs, mcomment, mextractedcomments, msgid_old,
+                             ToWx(mflags), mrefs, ToWx(mcomment), mextractedcomments, msgid_old,
                              mlinenum))
                 {
                     return false;
                 }
             }
 
-            mcomment = mstr = msgid_plural = msgctxt = mflags = wxEmptyString;
+            mcomment.clear();
+            mstr.clear();
+            msgid_plural.clear();
+            msgctxt.clear();
+            mflags.clear();
             has_plural = has_context = false;
             mrefs.Clear();
-            mextractedcomments.Clear();
+            mextractedcomments.clear();
             mtranslations.Clear();
-            msgid_old.Clear();
+            msgid_old.clear();
         }
 
         // msgstr[i]:
-        else if (ReadParam(line, prefix_msgstr_plural, dummy))
+        else if (c0 == 'm' && c1 == 's' && ReadParam(line, prefix_msgstr_plural, dummy))
         {
             if (!has_plural)
             {
@@ -389,64 +761,73 @@ bool POCatalogParser::Parse()
                 return false;
             }
 
-            wxString idx = dummy.BeforeFirst(wxS(']'));
-            wxString label_prefix = prefix_msgstr_plural + idx + wxS("] \"");
+            auto makeLabelPrefix = [](std::string_view rest)
+            {
+                std::string label(prefix_msgstr_plural);
+                label += rest.substr(0, rest.find(']'));
+                label += "] \"";
+                return label;
+            };
+            std::string label_prefix = makeLabelPrefix(dummy);
 
             while (ReadParam(line, label_prefix, dummy))
             {
-                wxString str = UnescapeCString(dummy.RemoveLast());
+                str.clear();
+                AppendUnescaped(str, WithoutLast(dummy));
 
                 while (!(line=ReadTextLine()).empty())
                 {
-                    line.Trim(/*fromRight=*/false);
-                    if (line[0u] == wxS('"') && line.Last() == wxS('"'))
+                    while (!line.empty() && IsSpace(line.front()))
+                        line.remove_prefix(1);
+                    if (!line.empty() && line.front() == '"' && line.back() == '"')
                     {
-                        str += UnescapeCString(line.Mid(1, line.Length() - 2));
+                        AppendUnescaped(str, QuotedContent(line));
                         PossibleWrappedLine();
                     }
                     else
                     {
                         if (ReadParam(line, prefix_msgstr_plural, dummy))
-                        {
-                            idx = dummy.BeforeFirst(wxS(']'));
-                            label_prefix = prefix_msgstr_plural + idx + wxS("] \"");
-                        }
+                            label_prefix = makeLabelPrefix(dummy);
                         break;
                     }
                 }
-                mtranslations.Add(str);
+                mtranslations.Add(ToWx(str));
             }
 
             if (m_ignoreTranslations)
                 mtranslations.clear();
 
-            if (!OnEntry(mstr, msgid_plural, true,
-                         has_context, msgctxt,
+            if (!OnEntry(ToWx(mstr), ToWx(msgid_plural), true,
+                         has_context, ToWx(msgctxt),
                          mtranslations,
-                         mflags, mrefs, mcomment, mextractedcomments, msgid_old,
+                         ToWx(mflags), mrefs, ToWx(mcomment), mextractedcomments, msgid_old,
                          mlinenum))
             {
                 return false;
             }
 
-            mcomment = mstr = msgid_plural = msgctxt = mflags = wxEmptyString;
+            mcomment.clear();
+            mstr.clear();
+            msgid_plural.clear();
+            msgctxt.clear();
+            mflags.clear();
             has_plural = has_context = false;
             mrefs.Clear();
-            mextractedcomments.Clear();
+            mextractedcomments.clear();
             mtranslations.Clear();
-            msgid_old.Clear();
+            msgid_old.clear();
         }
 
         // deleted lines:
-        else if (ReadParam(line, prefix_deleted, dummy))
+        else if (c0 == '#' && c1 == '~' && ReadParam(line, prefix_deleted, dummy))
         {
-            wxArrayString deletedLines;
+            PORawLines deletedLines;
             deletedLines.Add(line);
             mlinenum = unsigned(m_textFile->GetCurrentLine() + 1);
             while (!(line = ReadTextLine()).empty())
             {
                 // if line does not start with "#~" anymore, stop reading
-                if (!ReadParam(line, prefix_deleted, dummy))
+                if (!StartsWith(line, prefix_deleted))
                     break;
                 // if the line starts with "#~ msgid", we skipped an empty line
                 // and it's a new entry, so stop reading too (see bug #329)
@@ -459,30 +840,34 @@ bool POCatalogParser::Parse()
             if (!m_ignoreTranslations)
             {
                 if (!OnDeletedEntry(deletedLines,
-                                    mflags, mrefs, mcomment, mextractedcomments, mlinenum))
+                                    ToWx(mflags), mrefs, ToWx(mcomment), mextractedcomments, mlinenum))
                 {
                     return false;
                 }
             }
 
-            mcomment = mstr = msgid_plural = mflags = wxEmptyString;
+            mcomment.clear();
+            mstr.clear();
+            msgid_plural.clear();
+            mflags.clear();
             has_plural = false;
             mrefs.Clear();
-            mextractedcomments.Clear();
+            mextractedcomments.clear();
             mtranslations.Clear();
-            msgid_old.Clear();
+            msgid_old.clear();
         }
 
         // comment:
-        else if (line[0u] == wxS('#'))
+        else if (c0 == '#')
         {
             bool readNewLine = false;
 
             while (!line.empty() &&
-                    line[0u] == wxS('#') &&
-                   (line.Length() < 2 || (line[1u] != wxS(',') && line[1u] != wxS(':') && line[1u] != wxS('.') && line[1u] != wxS('~') )))
+                    line[0] == '#' &&
+                   (line.length() < 2 || (line[1] != ',' && line[1] != ':' && line[1] != '.' && line[1] != '~' )))
             {
-                mcomment << line << wxS('\n');
+                mcomment += line;
+                mcomment += '\n';
                 readNewLine = true;
                 line = ReadTextLine();
             }
@@ -501,29 +886,29 @@ bool POCatalogParser::Parse()
 }
 
 
-wxString POCatalogParser::ReadTextLine()
+std::string_view POCatalogParser::ReadTextLine()
 {
     m_previousLineHardWrapped = m_lastLineHardWrapped;
     m_lastLineHardWrapped = false;
 
-    static const wxString msgid_alone(wxS("msgid \"\""));
-    static const wxString msgstr_alone(wxS("msgstr \"\""));
+    static const std::string_view msgid_alone("msgid \"\"");
+    static const std::string_view msgstr_alone("msgstr \"\"");
 
     for (;;)
     {
         if (m_textFile->Eof())
-            return wxString();
+            return std::string_view();
 
         // read next line and strip insignificant whitespace from it:
-        const auto& ln = m_textFile->GetNextLine();
+        auto ln = m_textFile->GetNextLine();
         if (ln.empty())
             continue;
 
         // gettext tools don't include (extracted) comments in wrapping, so they can't
         // be reliably used to detect file's wrapping either; just skip them.
-        if (!ln.starts_with(wxS("#. ")) && !ln.starts_with(wxS("# ")))
+        if (!StartsWith(ln, "#. ") && !StartsWith(ln, "# "))
         {
-            if (ln.ends_with(wxS("\\n\"")))
+            if (EndsWith(ln, "\\n\""))
             {
                 // Similarly, lines ending with \n are always wrapped, so skip that too.
                 m_lastLineHardWrapped = true;
@@ -539,26 +924,22 @@ wxString POCatalogParser::ReadTextLine()
                 // That "2" is to account for unwrappable comment lines: "#: somethinglong"
                 // See https://github.com/vslavik/poedit/issues/135
                 auto space = ln.find_last_of(' ');
-                if (space != wxString::npos && space > 2)
+                if (space != std::string_view::npos && space > 2)
                 {
-                    m_detectedLineWidth = std::max(m_detectedLineWidth, (int)ln.size());
+                    m_detectedLineWidth = std::max(m_detectedLineWidth, (int)UTF8Length(ln));
                 }
             }
         }
 
-        if (wxIsspace(ln[0]) || wxIsspace(ln.Last()))
-        {
-            auto s = ln.Strip(wxString::both);
-            if (!s.empty())
-                return s;
-        }
-        else
-        {
+        while (!ln.empty() && IsSpace(ln.front()))
+            ln.remove_prefix(1);
+        while (!ln.empty() && IsSpace(ln.back()))
+            ln.remove_suffix(1);
+        if (!ln.empty())
             return ln;
-        }
     }
 
-    return wxString();
+    return std::string_view();
 }
 
 int POCatalogParser::GetWrappingWidth() const
@@ -571,10 +952,12 @@ int POCatalogParser::GetWrappingWidth() const
 
 
 
+// Finds the charset declared in the header. Only the first entry is looked at,
+// because that's where the header is in valid files.
 class POCharsetInfoFinder : public POCatalogParser
 {
     public:
-        POCharsetInfoFinder(wxTextFile *f)
+        POCharsetInfoFinder(POTextReader *f)
                 : POCatalogParser(f), m_charset("UTF-8") {}
         wxString GetCharset() const { return m_charset; }
 
@@ -590,51 +973,160 @@ class POCharsetInfoFinder : public POCatalogParser
                              const wxString& /*flags*/,
                              const wxArrayString& /*references*/,
                              const wxString& /*comment*/,
-                             const wxArrayString& /*extractedComments*/,
-                             const wxArrayString& /*msgid_old*/,
+                             const PORawLines& /*extractedComments*/,
+                             const PORawLines& /*msgid_old*/,
                              unsigned /*lineNumber*/)
         {
             if (msgid.empty() && !has_context)
             {
                 // gettext header:
-                Catalog::HeaderData hdr;
-                hdr.FromString(mtranslations[0]);
-                m_charset = hdr.Charset;
+                m_charset = Catalog::HeaderData::ParseCharset(mtranslations[0]);
                 if (m_charset == "CHARSET")
                     m_charset = "ISO-8859-1";
-                return false; // stop parsing
             }
-            return true;
+            return false; // stop parsing, the header can only be first
         }
-};
 
+        virtual bool OnDeletedEntry(const PORawLines& /*deletedLines*/,
+                                    const wxString& /*flags*/,
+                                    const wxArrayString& /*references*/,
+                                    const wxString& /*comment*/,
+                                    const PORawLines& /*extractedComments*/,
+                                    unsigned /*lineNumber*/)
+        {
+            return false;
+        }
+};
 
 
-class POLoadParser : public POCatalogParser
+// Only reports keys (context, msgid and msgid_plural) of the entries, see
+// POCatalog::ScanKeys()
+class POKeysScanner : public POCatalogParser
 {
     public:
-        POLoadParser(POCatalog& c, wxTextFile *f)
-              : POCatalogParser(f),
-                FileIsValid(false),
-                m_catalog(c), m_nextId(1), m_seenHeaderAlready(false) {}
+        POKeysScanner(POTextReader *f, const POCatalog::ScanKeysHandler& handler)
+                : POCatalogParser(f), FileIsValid(false), m_handler(handler) {}
 
-        // true if the file is valid, i.e. has at least some data
         bool FileIsValid;
 
-        Language GetSpecifiedMsgidLanguage()
-        {
-            auto x_srclang = m_catalog.Header().GetHeader("X-Source-Language");
-            if (x_srclang.empty())
-                x_srclang = m_catalog.m_header.GetHeader("X-Loco-Source-Locale");
-            if (!x_srclang.empty())
-            {
-                auto parsed = Language::TryParse(str::to_utf8(x_srclang));
-                if (parsed.IsValid())
-                    return parsed;
-            }
-            return Language();
-        }
-
+    protected:
+        const POCatalog::ScanKeysHandler& m_handler;
+
+        virtual bool OnEntry(const wxString& msgid,
+                             const wxString& msgid_plural,
+                             bool /*has_plural*/,
+                             bool has_context,
+                             const wxString& context,
+                             const wxArrayString& /*mtranslations*/,
+                             const wxString& /*flags*/,
+                             const wxArrayString& /*references*/,
+                             const wxString& /*comment*/,
+                             const PORawLines& /*extractedComments*/,
+                             const PORawLines& /*msgid_old*/,
+                             unsigned /*lineNumber*/)
+        {
+            FileIsValid = true;
+            if (msgid.empty() && !has_context)
+                return true; // gettext header
+            m_handler(msgid, msgid_plural, context);
+            return true;
+        }
+
+        virtual bool OnDeletedEntry(const PORawLines& /*deletedLines*/,
+                                    const wxString& /*flags*/,
+                                    const wxArrayString& /*references*/,
+                                    const wxString& /*comment*/,
+                                    const PORawLines& /*extractedComments*/,
+                                    unsigned /*lineNumber*/)
+        {
+            return true;
+        }
+};
+
+
+
+// Parses the content of an obsolete entry, with the "#~" prefixes removed
+class PODeletedEntryParser : public POCatalogParser
+{
+    public:
+        PODeletedEntryParser(POTextReader *f)
+                : POCatalogParser(f), Found(false), HasPlural(false), HasContext(false) {}
+
+        bool Found;
+        wxString Msgid, MsgidPlural, Context;
+        bool HasPlural, HasContext;
+        wxArrayString Translations;
+
+    protected:
+        virtual bool OnEntry(const wxString& msgid,
+                             const wxString& msgid_plural,
+                             bool has_plural,
+                             bool has_context,
+                             const wxString& context,
+                             const wxArrayString& mtranslations,
+                             const wxString& /*flags*/,
+                             const wxArrayString& /*references*/,
+                             const wxString& /*comment*/,
+                             const PORawLines& /*extractedComments*/,
+                             const PORawLines& /*msgid_old*/,
+                             unsigned /*lineNumber*/)
+        {
+            Found = true;
+            Msgid = msgid;
+            MsgidPlural = msgid_plural;
+            HasPlural = has_plural;
+            HasContext = has_context;
+            Context = context;
+            Translations = mtranslations;
+            return false; // there's only one entry
+        }
+};
+
+
+class POLoadParser : public POCatalogParser
+{
+    public:
+        POLoadParser(POCatalog& c, POTextReader *f)
+              : POCatalogParser(f),
+                FileIsValid(false),
+                m_catalog(c), m_nextId(1), m_seenHeaderAlready(false),
+                m_statisticsOnly(false) {}
+
+        // true if the file is valid, i.e. has at least some data
+        bool FileIsValid;
+
+        /// Only collect statistics into m_precomputedStats, don't create items
+        void StatisticsOnly(bool statsOnly)
+        {
+            m_statisticsOnly = statsOnly;
+            m_catalog.m_precomputedStats.valid = statsOnly;
+        }
+
+        Language GetSpecifiedMsgidLanguage()
+        {
+            auto x_srclang = m_catalog.Header().GetHeader("X-Source-Language");
+            if (x_srclang.empty())
+                x_srclang = m_catalog.m_header.GetHeader("X-Loco-Source-Locale");
+            if (!x_srclang.empty())
+            {
+                auto parsed = Language::TryParse(str::to_utf8(x_srclang));
+                if (parsed.IsValid())
+                    return parsed;
+            }
+            return Language();
+        }
+
+#ifdef HAVE_PARALLEL_PROCESSING
+        /** Parses \a chunks of the file (as returned by SplitIntoParsingChunks)
+            concurrently and stitches the results together in file order, with
+            the same outcome as Parse() on the whole file.
+
+            Line statistics of all chunks are accumulated into the reader
+            this parser was created with.
+         */
+        bool ParseInParallel(const std::vector<std::string_view>& chunks, const wxString& charset);
+#endif
+
     protected:
         POCatalog& m_catalog;
 
@@ -647,22 +1139,25 @@ class POLoadParser : public POCatalogParser
                              const wxString& flags,
                              const wxArrayString& references,
                              const wxString& comment,
-                             const wxArrayString& extractedComments,
-                             const wxArrayString& msgid_old,
+                             const PORawLines& extractedComments,
+                             const PORawLines& msgid_old,
                              unsigned lineNumber);
 
-        virtual bool OnDeletedEntry(const wxArrayString& deletedLines,
+        virtual bool OnDeletedEntry(const PORawLines& deletedLines,
                                     const wxString& flags,
                                     const wxArrayString& references,
                                     const wxString& comment,
-                                    const wxArrayString& extractedComments,
+                                    const PORawLines& extractedComments,
                                     unsigned lineNumber);
 
         virtual void OnIgnoredEntry() { FileIsValid = true; }
 
     private:
+        void CountEntry(const wxString& flags, const wxArrayString& translations);
+
         int m_nextId;
         bool m_seenHeaderAlready;
+        bool m_statisticsOnly;
 };
 
 
@@ -675,14 +1170,12 @@ bool POLoadParser::OnEntry(const wxString& msgid,
                          const wxString& flags,
                          const wxArrayString& references,
                          const wxString& comment,
-                         const wxArrayString& extractedComments,
-                         const wxArrayString& msgid_old,
+                         const PORawLines& extractedComments,
+                         const PORawLines& msgid_old,
                          unsigned lineNumber)
 {
     FileIsValid = true;
 
-    static const wxString MSGCAT_CONFLICT_MARKER("#-#-#-#-#");
-
     if (msgid.empty() && !has_context)
     {
         if (!m_seenHeaderAlready)
@@ -690,7 +1183,7 @@ bool POLoadParser::OnEntry(const wxString& msgid,
             // gettext header:
             m_catalog.m_header.FromString(mtranslations[0]);
             m_catalog.m_header.Comment = comment;
-            for (const auto& s : extractedComments)
+            for (const auto& s : extractedComments.ToArray())
                 m_catalog.m_header.Comment += "\n#. " + s;
             for (const auto& s : references)
                 m_catalog.m_header.Comment += "\n#: " + s;
@@ -700,9 +1193,15 @@ bool POLoadParser::OnEntry(const wxString& msgid,
         }
         // else: ignore duplicate header in malformed files
     }
+    else if (m_statisticsOnly)
+    {
+        if (has_plural)
+            m_catalog.m_hasPluralItems = true;
+        CountEntry(flags, mtranslations);
+    }
     else
     {
-        auto d = std::make_shared<POCatalogItem>();
+        auto d = m_catalog.MakeItem<POCatalogItem>();
         d->SetId(m_nextId++);
         if (!flags.empty())
             d->SetFlags(flags);
@@ -717,45 +1216,160 @@ bool POLoadParser::OnEntry(const wxString& msgid,
         d->SetTranslations(mtranslations);
         d->SetComment(comment);
         d->SetLineNumber(lineNumber);
-        d->SetRawReferences(references);
+        d->SetRawReferences(m_catalog.m_internedStrings, references);
 
-        for (auto i: extractedComments)
-        {
-            // Sometimes, msgcat produces conflicts in extracted comments; see the gory details:
-            // https://groups.google.com/d/topic/poedit/j41KuvXtVUU/discussion
-            // As a workaround, just filter them out.
-            // FIXME: Fix this properly... but not using msgcat in the first place
-            if (i.starts_with(MSGCAT_CONFLICT_MARKER) && i.ends_with(MSGCAT_CONFLICT_MARKER))
-                continue;
-            d->AddExtractedComments(i);
-        }
-        d->SetOldMsgid(msgid_old);
+        d->SetLazyMetadata(extractedComments, msgid_old);
         m_catalog.AddItem(d);
     }
     return true;
 }
 
-bool POLoadParser::OnDeletedEntry(const wxArrayString& deletedLines,
+bool POLoadParser::OnDeletedEntry(const PORawLines& deletedLines,
                                 const wxString& flags,
                                 const wxArrayString& /*references*/,
                                 const wxString& comment,
-                                const wxArrayString& extractedComments,
+                                const PORawLines& extractedComments,
                                 unsigned lineNumber)
 {
     FileIsValid = true;
 
+    if (m_statisticsOnly)
+        return true;
+
     POCatalogDeletedData d;
     if (!flags.empty()) d.SetFlags(flags);
-    d.SetDeletedLines(deletedLines);
+    d.SetRawDeletedLines(deletedLines);
     d.SetComment(comment);
     d.SetLineNumber(lineNumber);
-    for (size_t i = 0; i < extractedComments.GetCount(); i++)
-      d.AddExtractedComments(extractedComments[i]);
+    extractedComments.ForEach([&](std::string_view c){ d.AddExtractedComments(ToWx(c)); });
     m_catalog.AddDeletedItem(d);
 
     return true;
 }
 
+void POLoadParser::CountEntry(const wxString& flags, const wxArrayString& translations)
+{
+    // keep in sync with how CatalogItem::SetFlags() and SetTranslations()
+    // determine fuzzy and translated state used by GetStatistics():
+    static const wxString flag_fuzzy(wxS(", fuzzy"));
+
+    const bool fuzzy = flags.find(flag_fuzzy) != wxString::npos;
+    bool translated = true;
+    for (auto& t: translations)
+    {
+        if (t.empty())
+        {
+            translated = false;
+            break;
+        }
+    }
+
+    auto& stats = m_catalog.m_precomputedStats;
+    stats.all++;
+    if (fuzzy)
+        stats.fuzzy++;
+    if (!translated)
+        stats.untranslated++;
+    if (fuzzy || !translated)
+        stats.unfinished++;
+}
+
+#ifdef HAVE_PARALLEL_PROCESSING
+
+bool POLoadParser::ParseInParallel(const std::vector<std::string_view>& chunks, const wxString& charset)
+{
+    struct Chunk
+    {
+        std::unique_ptr<POCatalog> catalog;
+        std::unique_ptr<POTextReader> reader;
+        std::unique_ptr<POLoadParser> parser;
+        bool ok = false;
+        std::exception_ptr error;
+    };
+
+    const size_t count = chunks.size();
+    std::vector<Chunk> parsed(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& c = parsed[i];
+        c.catalog.reset(new POCatalog(Catalog::Type::PO));
+        c.catalog->m_internedStrings = m_catalog.m_internedStrings;
+        c.reader.reset(new POTextReader(chunks[i].data(), chunks[i].size()));
+        if (!c.reader->SetCharset(charset))
+            return false;
+        c.parser.reset(new POLoadParser(*c.catalog, c.reader.get()));
+        c.parser->IgnoreHeader(m_ignoreHeader);
+        c.parser->IgnoreTranslations(m_ignoreTranslations);
+        c.parser->StatisticsOnly(m_statisticsOnly);
+    }
+
+    dispatch::parallel_for(count, [&parsed](size_t i)
+    {
+        auto& c = parsed[i];
+        try
+        {
+            c.ok = c.parser->Parse();
+        }
+        catch (...)
+        {
+            c.error = std::current_exception();
+        }
+    });
+
+    m_textFile->ClearStats();
+
+    for (auto& c: parsed)
+    {
+        if (c.error)
+            std::rethrow_exception(c.error);
+        if (!c.ok)
+            return false;
+
+        const int lineOffset = (int)m_textFile->GetLineBreaksCount();
+        m_textFile->AppendStatsFrom(*c.reader);
+
+        auto& chunk = *c.parser;
+        auto& cat = *c.catalog;
+
+        FileIsValid = FileIsValid || chunk.FileIsValid;
+
+        if (chunk.m_seenHeaderAlready && !m_seenHeaderAlready)
+        {
+            m_catalog.m_header = cat.m_header;
+            m_seenHeaderAlready = true;
+        }
+
+        if (cat.m_hasPluralItems)
+            m_catalog.m_hasPluralItems = true;
+
+        auto& stats = m_catalog.m_precomputedStats;
+        stats.all += cat.m_precomputedStats.all;
+        stats.fuzzy += cat.m_precomputedStats.fuzzy;
+        stats.untranslated += cat.m_precomputedStats.untranslated;
+        stats.unfinished += cat.m_precomputedStats.unfinished;
+
+        for (auto& item: cat.m_items)
+        {
+            item->SetId(m_nextId++);
+            item->SetLineNumber(item->GetLineNumber() + lineOffset);
+            m_catalog.m_items.push_back(item);
+        }
+
+        for (auto& item: cat.m_deletedItems)
+        {
+            item.SetLineNumber(item.GetLineNumber() + lineOffset);
+            m_catalog.AddDeletedItem(item);
+        }
+
+        m_detectedLineWidth = std::max(m_detectedLineWidth, chunk.m_detectedLineWidth);
+        m_detectedWrappedLines = m_detectedWrappedLines || chunk.m_detectedWrappedLines;
+    }
+
+    return true;
+}
+
+#endif // HAVE_PARALLEL_PROCESSING
+
 
 // ----------------------------------------------------------------------
 // POCatalogItem class
@@ -763,56 +1377,190 @@ bool POLoadParser::OnDeletedEntry(const wxArrayString& deletedLines,
 
 wxArrayString POCatalogItem::GetReferences() const
 {
-    // A line may contain several references, separated by white-space.
     // Traditionally, each reference was in the form "path_name:line_number", but non
     // standard references are sometime used too, including hyperlinks.
-    // Filenames that contain spaces are supported - they must be enclosed by Unicode
-    // characters U+2068 and U+2069.
-    wxArrayString refs;
+    // Filenames that contain spaces are supported - they are enclosed by Unicode
+    // characters U+2068 and U+2069, which are removed here.
+    wxArrayString refs = GetRawReferences();
+    for (auto& r: refs)
+    {
+        if (r.find_first_of(L"\u2068\u2069") != wxString::npos)
+        {
+            r.Replace(L"\u2068", wxString());
+            r.Replace(L"\u2069", wxString());
+        }
+    }
+    return refs;
+}
 
-    for (auto ref = m_references.begin(); ref != m_references.end(); ++ref)
+wxArrayString POCatalogItem::GetRawReferences() const
+{
+    wxArrayString refs;
+    refs.reserve(m_references.size());
+    for (auto& r: m_references)
     {
-        auto line = ref->Strip(wxString::both);
-        wxString buf;
+        wxString s = m_referenceStrings->Get(r.path);
+        if (r.line)
+            s << ':' << r.line;
+        refs.push_back(s);
+    }
+    return refs;
+}
+
+void POCatalogItem::SetRawReferences(const std::shared_ptr<InternedStrings>& strings, const wxArrayString& lines)
+{
+    m_referenceStrings = strings;
+    m_references.clear();
 
-        auto i = line.begin();
-        while (i != line.end())
+    auto addRef = [=](const wxString& ref)
+    {
+        // Split off line number, if the reference is "path:line"; anything
+        // that couldn't be reconstructed exactly is kept whole in the path:
+        Reference r{0, 0};
+        auto colon = ref.rfind(':');
+        if (colon != wxString::npos && colon > 0 && colon + 1 < ref.length() && ref.length() - colon - 1 <= 9 && ref[colon + 1] != '0')
         {
-            const wchar_t c = *i;
-            if (wxIsspace(c))
+            uint32_t line = 0;
+            for (size_t i = colon + 1; i < ref.length(); i++)
             {
-                // store reference text encountered so far:
-                if (!buf.empty())
+                const wchar_t c = ref[i];
+                if (c < '0' || c > '9')
                 {
-                    refs.push_back(buf);
-                    buf.clear();
+                    line = 0;
+                    break;
                 }
-                ++i;
+                line = line * 10 + (c - '0');
             }
-            else if (c == L'\u2068')
+            r.line = line;
+        }
+
+        r.path = strings->Intern(r.line ? ref.substr(0, colon) : ref);
+        m_references.push_back(r);
+    };
+
+    // A line may contain several references, separated by white-space. Filenames
+    // with spaces are enclosed in U+2068 and U+2069 and kept intact:
+    for (auto& line: lines)
+    {
+        wxString ref;
+        bool isolated = false;
+        for (auto i = line.begin(); ; ++i)
+        {
+            const bool atEnd = (i == line.end());
+            if (atEnd || (!isolated && wxIsspace(*i)))
             {
-                // quoted filename between U+2068 and U+2069:
-                ++i;
-                while (i != line.end() && *i != L'\u2069')
+                if (!ref.empty())
                 {
-                    buf += *i;
-                    ++i;
+                    addRef(ref);
+                    ref.clear();
                 }
-                if (i != line.end())
-                    ++i; // skip trailing U+2069
-            }
-            else
-            {
-                buf += c;
-                ++i;
+                if (atEnd)
+                    break;
+                continue;
             }
+            if (*i == L'\u2068')
+                isolated = true;
+            else if (*i == L'\u2069')
+                isolated = false;
+            ref += *i;
         }
-
-        if (!buf.empty())
-            refs.push_back(buf);
     }
+}
 
-    return refs;
+bool POCatalogItem::HasSameReferences(const POCatalogItem& other) const
+{
+    if (m_referenceStrings == other.m_referenceStrings || m_references.empty() || other.m_references.empty())
+        return m_references == other.m_references;
+    else
+        return GetRawReferences() == other.GetRawReferences();
+}
+
+namespace
+{
+
+// Guards conversion of lazy metadata; items are converted rarely and quickly,
+// so there's no need for per-item mutexes.
+std::mutex gs_lazyMetadataMutex;
+
+// Sometimes, msgcat produces conflicts in extracted comments; see the gory details:
+// https://groups.google.com/d/topic/poedit/j41KuvXtVUU/discussion
+// As a workaround, just filter them out.
+// FIXME: Fix this properly... but not using msgcat in the first place
+inline bool IsMsgcatConflictMarker(std::string_view s)
+{
+    static const std::string_view MSGCAT_CONFLICT_MARKER("#-#-#-#-#");
+    return StartsWith(s, MSGCAT_CONFLICT_MARKER) &&
+           s.substr(s.size() - MSGCAT_CONFLICT_MARKER.size()) == MSGCAT_CONFLICT_MARKER;
+}
+
+} // anonymous namespace
+
+wxArrayString PORawLines::ToArray() const
+{
+    wxArrayString out;
+    out.reserve(m_count);
+    ForEach([&](std::string_view line){ out.push_back(ToWx(line)); });
+    return out;
+}
+
+void POCatalogItem::SetLazyMetadata(const PORawLines& extractedComments, const PORawLines& oldMsgid)
+{
+    m_lazyExtractedComments.clear();
+    extractedComments.ForEach([&](std::string_view c)
+    {
+        if (!IsMsgcatConflictMarker(c))
+            m_lazyExtractedComments.Add(c);
+    });
+    m_lazyOldMsgid = oldMsgid;
+
+    m_extractedComments.clear();
+    m_oldMsgid.clear();
+    m_hasLazyMetadata.store(!m_lazyExtractedComments.empty() || !m_lazyOldMsgid.empty(), std::memory_order_release);
+}
+
+void POCatalogItem::LoadLazyMetadata()
+{
+    std::lock_guard<std::mutex> lock(gs_lazyMetadataMutex);
+    if (!m_hasLazyMetadata.load(std::memory_order_relaxed))
+        return;
+
+    m_extractedComments = m_lazyExtractedComments.ToArray();
+    m_oldMsgid = m_lazyOldMsgid.ToArray();
+    m_lazyExtractedComments = PORawLines();
+    m_lazyOldMsgid = PORawLines();
+    m_hasLazyMetadata.store(false, std::memory_order_release);
+}
+
+POCatalogItemPtr POCatalogItem::CloneForSaving() const
+{
+    auto copy = std::make_shared<POCatalogItem>();
+    copy->m_string = m_string;
+    copy->m_plural = m_plural;
+    copy->m_hasPlural = m_hasPlural;
+    copy->m_hasContext = m_hasContext;
+    copy->m_context = m_context;
+    copy->m_translations = m_translations;
+    {
+        // unconverted metadata are copied as-is and only converted when
+        // the copy is written:
+        std::lock_guard<std::mutex> lock(gs_lazyMetadataMutex);
+        copy->m_extractedComments = m_extractedComments;
+        copy->m_oldMsgid = m_oldMsgid;
+        if (m_hasLazyMetadata.load(std::memory_order_relaxed))
+        {
+            copy->m_lazyExtractedComments = m_lazyExtractedComments;
+            copy->m_lazyOldMsgid = m_lazyOldMsgid;
+            copy->m_hasLazyMetadata.store(true, std::memory_order_relaxed);
+        }
+    }
+    copy->m_isFuzzy = m_isFuzzy;
+    copy->m_isTranslated = m_isTranslated;
+    copy->m_moreFlags = m_moreFlags;
+    copy->m_comment = m_comment;
+    copy->m_references = m_references;
+    copy->m_referenceStrings = m_referenceStrings;
+    copy->m_sideloaded = m_sideloaded;
+    return copy;
 }
 
 
@@ -888,28 +1636,60 @@ static inline wxString GetCurrentTimeString()
 }
 
 
-void POCatalog::Load(const wxString& po_file, int flags)
+bool POCatalog::ScanKeys(const wxString& po_file, const ScanKeysHandler& handler)
 {
-    wxTextFile f;
+    TRACE_SPAN("catalog", "ScanKeys");
+
+    MappedFile data(po_file);
+    if (!data.IsOk())
+        return false;
+
+    POTextReader f(data.data(), data.size());
+
+    wxString charset;
+    {
+        wxLogNull null; // parsing errors will be reported when actually loading the file
+        POCharsetInfoFinder charsetFinder(&f);
+        charsetFinder.Parse();
+        charset = charsetFinder.GetCharset();
+    }
+
+    if (!f.SetCharset(charset))
+        return false;
+
+    wxLogNull null;
+    POKeysScanner scanner(&f, handler);
+    scanner.IgnoreTranslations(true);
+    return scanner.Parse() && scanner.FileIsValid;
+}
 
+
+void POCatalog::Load(const wxString& po_file, int flags)
+{
     Clear();
     m_fileName = po_file;
     m_header.BasePath = wxEmptyString;
 
     wxString ext;
-    wxFileName::SplitPath(po_file, nullptr, nullptr, &ext);
+    wxFileName::SplitPath(StripGzipExtension(po_file), nullptr, nullptr, &ext);
     if (ext.CmpNoCase("pot") == 0 || (flags & CreationFlag_IgnoreTranslations))
         m_fileType = Type::POT;
     else
         m_fileType = Type::PO;
 
-    /* Load the .po file: */
+    /* Load the .po file (decompressing it if it's gzipped): */
 
-    if (!f.Open(po_file, wxConvISO8859_1))
+    MappedFile data(po_file);
+    if (!data.IsOk())
     {
         BOOST_THROW_EXCEPTION(Exception(_(L"Couldn’t load the file, it is probably damaged.")));
     }
 
+    // only the beginning of large files is parsed for previews:
+    const size_t size = (flags & CreationFlag_Preview) ? GetPreviewSize(data.data(), data.size()) : data.size();
+
+    POTextReader f(data.data(), size);
+
     {
         wxLogNull null; // don't report parsing errors from here, report them later
         POCharsetInfoFinder charsetFinder(&f);
@@ -917,26 +1697,47 @@ void POCatalog::Load(const wxString& po_file, int flags)
         m_header.Charset = charsetFinder.GetCharset();
     }
 
-    f.Close();
-    wxCSConv encConv(m_header.Charset);
-    if (!f.Open(po_file, encConv))
+    if (!f.SetCharset(m_header.Charset))
     {
         BOOST_THROW_EXCEPTION(Exception(_(L"Couldn’t load the file, it is probably damaged.")));
     }
 
-    if (!VerifyFileCharset(f, po_file, m_header.Charset))
-    {
-        wxLogError(_("There were errors when loading the file. Some data may be missing or corrupted as the result."));
-    }
-
     POLoadParser parser(*this, &f);
     parser.IgnoreHeader(flags & CreationFlag_IgnoreHeader);
     parser.IgnoreTranslations(flags & CreationFlag_IgnoreTranslations);
-    if (!parser.Parse())
+    parser.StatisticsOnly(flags & CreationFlag_StatisticsOnly);
+
+    bool parsed;
+    {
+        TRACE_SPAN("catalog", "Parse");
+#ifdef HAVE_PARALLEL_PROCESSING
+        // Large files are split at entry boundaries and parsed on multiple cores:
+        auto chunks = SplitIntoParsingChunks(data.data(), size);
+        if (chunks.size() > 1)
+            parsed = parser.ParseInParallel(chunks, m_header.Charset);
+        else
+#endif
+            parsed = parser.Parse();
+    }
+
+    if (!parsed)
     {
         BOOST_THROW_EXCEPTION(Exception(_(L"Couldn’t load the file, it is probably damaged.")));
     }
 
+    // Check that the file was decoded correctly, i.e. that non-empty lines didn't end
+    // up empty after charset conversion. This detects for example files that claim
+    // they are in UTF-8 while in fact they are not.
+    if (!f.GetCorruptedLines().empty())
+    {
+        for (auto line: f.GetCorruptedLines())
+        {
+            wxLogError(_(L"Line %d of file “%s” is corrupted (not valid %s data)."),
+                       int(line), po_file.c_str(), m_header.Charset.c_str());
+        }
+        wxLogError(_("There were errors when loading the file. Some data may be missing or corrupted as the result."));
+    }
+
     m_sourceLanguage = parser.GetSpecifiedMsgidLanguage();  // may be, and likely will, invalid
 
     m_fileCRLF = GetFileCRLFFormat(f);
@@ -949,12 +1750,26 @@ void POCatalog::Load(const wxString& po_file, int flags)
         BOOST_THROW_EXCEPTION(Exception(_(L"Couldn’t load the file, it is probably damaged.")));
     }
 
-    f.Close();
-
     FixupCommonIssues();
 
     if ( flags & CreationFlag_IgnoreHeader )
         CreateNewHeader();
+
+    if (size < data.size())
+    {
+        // estimate statistics of the whole file from the loaded part, assuming
+        // the same density and composition of entries in the rest of it:
+        const double scale = double(data.size()) / size;
+        int all, fuzzy, untranslated, unfinished;
+        GetStatistics(&all, &fuzzy, nullptr, &untranslated, &unfinished);
+        m_precomputedStats.all = int(all * scale);
+        m_precomputedStats.fuzzy = int(fuzzy * scale);
+        m_precomputedStats.untranslated = int(untranslated * scale);
+        m_precomputedStats.unfinished = int(unfinished * scale);
+        m_precomputedStats.valid = true;
+        m_partiallyLoaded = true;
+        wxLogTrace("poedit", "preview: loaded %d of %d bytes", (int)size, (int)data.size());
+    }
 }
 
 
@@ -976,6 +1791,7 @@ void POCatalog::FixupCommonIssues()
             {
                 auto poi = std::dynamic_pointer_cast<POCatalogItem>(i);
                 poi->m_moreFlags.Replace("php-format", "no-php-format");
+                poi->UpdateInternalRepresentation();
             }
         }
     }
@@ -1027,94 +1843,680 @@ void POCatalog::Clear()
 {
     // Catalog base class fields:
     m_items.clear();
+    m_precomputedStats = PrecomputedStatistics();
+    m_partiallyLoaded = false;
+    InvalidateChangeTracking();
 
     // PO-specific fields:
     m_deletedItems.clear();
 }
 
 
-// misc file-saving helpers
+// ----------------------------------------------------------------------
+// PO file writing
+// ----------------------------------------------------------------------
+
 namespace
 {
 
-inline bool CanEncodeStringToCharset(const wxString& s, wxMBConv& conv)
-{
-    if (s.empty())
-        return true;
-    const wxCharBuffer converted(s.mb_str(conv));
-    if ( converted.length() == 0 )
-        return false;
-    return true;
-}
+#ifdef HAVE_PARALLEL_PROCESSING
+// Catalogs with fewer entries than this aren't worth formatting in parallel:
+const size_t MIN_PARALLEL_SAVE_ITEMS = 10000;
+// Number of entries formatted as one unit of work when saving in parallel:
+const size_t PARALLEL_SAVE_CHUNK_ITEMS = 1000;
+#endif
 
-bool CanEncodeToCharset(const wxTextBuffer& f, const wxString& charset)
+// Line breaking classes from UAX #14 used by FindLineBreaks()
+enum LineBreakClass
 {
-    if (charset.Lower() == "utf-8" || charset.Lower() == "utf8")
-        return true;
+    LineBreak_OP, LineBreak_CL, LineBreak_CP, LineBreak_QU, LineBreak_GL, LineBreak_NS,
+    LineBreak_EX, LineBreak_SY, LineBreak_IS, LineBreak_PR, LineBreak_PO, LineBreak_NU,
+    LineBreak_AL, LineBreak_ID, LineBreak_IN, LineBreak_HY, LineBreak_BA, LineBreak_BB,
+    LineBreak_B2, LineBreak_ZW, LineBreak_CM, LineBreak_WJ, LineBreak_H2, LineBreak_H3,
+    LineBreak_JL, LineBreak_JV, LineBreak_JT,
+    LineBreak_SP
+};
 
-    wxCSConv conv(charset);
+/*
+    UAX #14 pair table, indexed by the class before and after the break:
+      _  direct break opportunity
+      %  break opportunity only if there are spaces in between
+      #  combining mark, belongs to the preceding character unless after spaces
+      @  ditto, but never a break opportunity
+      ^  prohibited break
+ */
+const char LINE_BREAK_PAIRS[LineBreak_SP][LineBreak_SP + 1] =
+{
+    "^^^^^^^^^^^^^^^^^^^^@^^^^^^", // OP
+    "_^^%%^^^^%%____%%__^#^_____", // CL
+    "_^^%%^^^^%%%%__%%__^#^_____", // CP
+    "^^^%%%^^^%%%%%%%%%%^#^%%%%%", // QU
+    "%^^%%%^^^%%%%%%%%%%^#^%%%%%", // GL
+    "_^^%%%^^^______%%__^#^_____", // NS
+    "_^^%%%^^^______%%__^#^_____", // EX
+    "_^^%%%^^^__%___%%__^#^_____", // SY
+    "_^^%%%^^^__%%__%%__^#^_____", // IS
+    "%^^%%%^^^__%%%_%%__^#^%%%%%", // PR
+    "%^^%%%^^^__%%__%%__^#^_____", // PO
+    "%^^%%%^^^%%%%_%%%__^#^_____", // NU
+    "%^^%%%^^^%%%%_%%%__^#^_____", // AL
+    "_^^%%%^^^_%___%%%__^#^_____", // ID
+    "_^^%%%^^^_____%%%__^#^_____", // IN
+    "_^^%_%^^^__%___%%__^#^_____", // HY
+    "_^^%_%^^^______%%__^#^_____", // BA
+    "%^^%%%^^^%%%%%%%%%%^#^%%%%%", // BB
+    "_^^%%%^^^______%%_^^#^_____", // B2
+    "___________________^_______", // ZW
+    "%^^%%%^^^__%%_%%%__^#^_____", // CM
+    "%^^%%%^^^%%%%%%%%%%^#^%%%%%", // WJ
+    "_^^%%%^^^_%___%%%__^#^___%%", // H2
+    "_^^%%%^^^_%___%%%__^#^____%", // H3
+    "_^^%%%^^^_%___%%%__^#^%%%%_", // JL
+    "_^^%%%^^^_%___%%%__^#^___%%", // JV
+    "_^^%%%^^^_%___%%%__^#^____%", // JT
+};
 
-    const size_t lines = f.GetLineCount();
-    for ( size_t i = 0; i < lines; i++ )
+LineBreakClass GetLineBreakClass(UChar32 c)
+{
+    switch (u_getIntPropertyValue(c, UCHAR_LINE_BREAK))
     {
-        if ( !CanEncodeStringToCharset(f.GetLine(i), conv) )
-            return false;
+        case U_LB_OPEN_PUNCTUATION:             return LineBreak_OP;
+        case U_LB_CLOSE_PUNCTUATION:            return LineBreak_CL;
+        case U_LB_CLOSE_PARENTHESIS:            return LineBreak_CP;
+        case U_LB_QUOTATION:                    return LineBreak_QU;
+        case U_LB_GLUE:                         return LineBreak_GL;
+        case U_LB_NONSTARTER:
+        case U_LB_CONDITIONAL_JAPANESE_STARTER: return LineBreak_NS;
+        case U_LB_EXCLAMATION:                  return LineBreak_EX;
+        case U_LB_BREAK_SYMBOLS:                return LineBreak_SY;
+        case U_LB_INFIX_NUMERIC:                return LineBreak_IS;
+        case U_LB_PREFIX_NUMERIC:               return LineBreak_PR;
+        case U_LB_POSTFIX_NUMERIC:              return LineBreak_PO;
+        case U_LB_NUMERIC:                      return LineBreak_NU;
+        case U_LB_IDEOGRAPHIC:
+        case U_LB_E_BASE:
+        case U_LB_E_MODIFIER:                   return LineBreak_ID;
+        case U_LB_INSEPARABLE:                  return LineBreak_IN;
+        case U_LB_HYPHEN:                       return LineBreak_HY;
+        case U_LB_BREAK_AFTER:                  return LineBreak_BA;
+        case U_LB_BREAK_BEFORE:                 return LineBreak_BB;
+        case U_LB_BREAK_BOTH:                   return LineBreak_B2;
+        case U_LB_ZWSPACE:                      return LineBreak_ZW;
+        case U_LB_COMBINING_MARK:
+        case U_LB_ZWJ:                          return LineBreak_CM;
+        case U_LB_WORD_JOINER:                  return LineBreak_WJ;
+        case U_LB_H2:                           return LineBreak_H2;
+        case U_LB_H3:                           return LineBreak_H3;
+        case U_LB_JL:                           return LineBreak_JL;
+        case U_LB_JV:                           return LineBreak_JV;
+        case U_LB_JT:                           return LineBreak_JT;
+        case U_LB_SPACE:                        return LineBreak_SP;
+        case U_LB_COMPLEX_CONTEXT:
+        {
+            auto type = u_charType(c);
+            return (type == U_NON_SPACING_MARK || type == U_COMBINING_SPACING_MARK) ? LineBreak_CM : LineBreak_AL;
+        }
+        default:                                return LineBreak_AL;
     }
+}
 
-    return true;
+// Width of the character in columns, as libunistring's uc_width() computes it
+int GetCharWidth(UChar32 c)
+{
+    if (c < 0x20 || (c >= 0x7f && c < 0xa0))
+        return 0;
+    if (c == 0xad)  // soft hyphen
+        return 1;
+    switch (u_charType(c))
+    {
+        case U_NON_SPACING_MARK:
+        case U_ENCLOSING_MARK:
+        case U_FORMAT_CHAR:
+            return 0;
+        default:
+            break;
+    }
+    auto width = u_getIntPropertyValue(c, UCHAR_EAST_ASIAN_WIDTH);
+    return (width == U_EA_WIDE || width == U_EA_FULLWIDTH) ? 2 : 1;
 }
 
-template<typename Func>
-inline void SplitIntoLines(const wxString& text, Func&& f)
+inline bool IsOpeningQuote(UChar32 c)
+{
+    return u_charType(c) == U_INITIAL_PUNCTUATION;
+}
+
+inline bool IsHebrewLetter(UChar32 c)
+{
+    return u_getIntPropertyValue(c, UCHAR_LINE_BREAK) == U_LB_HEBREW_LETTER;
+}
+
+/**
+    Finds line break opportunities in \a text according to UAX #14,
+    i.e. positions before which the line may be broken.
+
+    \a prohibited marks positions where breaking is not allowed regardless.
+ */
+void FindLineBreaks(const std::vector<UChar32>& text, const std::vector<bool>& prohibited, std::vector<bool>& breaks)
 {
+    breaks.assign(text.size(), false);
     if (text.empty())
         return;
 
-    wxString::const_iterator last = text.begin();
-    for (wxString::const_iterator i = text.begin(); i != text.end(); ++i)
+    auto prev = GetLineBreakClass(text[0]);
+    if (prev == LineBreak_SP)
+        prev = LineBreak_WJ;
+    else if (prev == LineBreak_CM)
+        prev = LineBreak_AL;
+    bool afterOpeningQuote = IsOpeningQuote(text[0]);
+    bool afterHebrewLetter = IsHebrewLetter(text[0]);
+    bool afterHebrewHyphen = false;
+    bool afterSpace = false;
+
+    for (size_t i = 1; i < text.size(); i++)
     {
-        if (*i == '\n')
+        const auto cls = GetLineBreakClass(text[i]);
+        if (cls == LineBreak_SP)
         {
-            f(wxString(last, i), false);
-            last = i + 1;
+            afterSpace = true;
+            continue;
+        }
+
+        char action = LINE_BREAK_PAIRS[prev][cls];
+        // don't break after an opening quote and spaces following it
+        if (afterSpace && afterOpeningQuote)
+            action = '^';
+        // nor after hyphens in Hebrew words
+        if (!afterSpace && afterHebrewHyphen)
+            action = '^';
+
+        bool canBreak;
+        switch (action)
+        {
+            case '_':
+                canBreak = true;
+                break;
+            case '%':
+                canBreak = afterSpace;
+                break;
+            case '#':
+            case '@':
+                canBreak = (action == '#') && afterSpace;
+                if (!afterSpace)
+                    continue;  // attached to the previous character, keeps its class
+                break;
+            default:
+                canBreak = false;
+                break;
         }
-    }
 
-    if (last != text.end())
-        f(wxString(last, text.end()), true);
+        breaks[i] = canBreak && !prohibited[i];
+        afterOpeningQuote = IsOpeningQuote(text[i]) &&
+                            (afterSpace || prev == LineBreak_OP || prev == LineBreak_QU || prev == LineBreak_GL || prev == LineBreak_ZW);
+        afterHebrewHyphen = (cls == LineBreak_HY || cls == LineBreak_BA) && afterHebrewLetter && !afterSpace;
+        afterHebrewLetter = IsHebrewLetter(text[i]);
+        afterSpace = false;
+        prev = cls;
+    }
 }
 
-void SaveMultiLines(wxTextBuffer &f, const wxString& text)
+/**
+    Formats string for output in the same way gettext tools do it, i.e.
+    escaped, split after newlines and wrapped to fit into \a width columns.
+
+    \a prefix is prepended to all lines (e.g. "#~ " for obsolete entries),
+    \a keyword only to the first one. Lines are passed to \a addLine.
+ */
+template<typename Func>
+void FormatPOString(const wxString& prefix, const wxString& keyword, const wxString& text, int width, Func&& addLine)
 {
-    SplitIntoLines(text, [&f](wxString&& s, bool)
+    const wxString firstPrefix = prefix + keyword + " ";
+    if (width == POCatalog::NO_WRAPPING)
+        width = std::numeric_limits<int>::max() / 2;
+
+    // Quick check for the very common case of short single-line strings:
+    const size_t newline = text.find('\n');
+    if ((newline == wxString::npos || newline == text.length() - 1) &&
+        firstPrefix.length() + 2 * text.length() + 2 < (size_t)width)
     {
-        f.AddLine(s);
-    });
+        addLine(firstPrefix + "\"" + EscapeCString(text) + "\"");
+        return;
+    }
+
+    if (text.empty())
+    {
+        addLine(firstPrefix + "\"\"");
+        return;
+    }
+
+    bool firstLine = true;
+    std::vector<UChar32> chars;
+    std::vector<size_t> offsets;
+    std::vector<bool> prohibited, breaks;
+    std::vector<size_t> cuts;
+
+    auto segStart = text.begin();
+    while (segStart != text.end())
+    {
+        // Find the next segment, terminated by a newline; escape it and remember
+        // where its characters are in the output, so that it can be split:
+        wxString escaped;
+        chars.clear();
+        offsets.clear();
+        prohibited.clear();
+
+        auto i = segStart;
+        for (; i != text.end(); ++i)
+        {
+            const auto charStart = i;
+            UChar32 c = (wchar_t)*i;
+#if SIZEOF_WCHAR_T == 2
+            if (U16_IS_LEAD(c) && i + 1 != text.end() && U16_IS_TRAIL((wchar_t)*(i + 1)))
+            {
+                ++i;
+                c = U16_GET_SUPPLEMENTARY(c, (wchar_t)*i);
+            }
+#endif
+            char esc = 0;
+            switch (c)
+            {
+                case '"':  esc = '"';  break;
+                case '\\': esc = '\\'; break;
+                case '\a': esc = 'a';  break;
+                case '\b': esc = 'b';  break;
+                case '\f': esc = 'f';  break;
+                case '\n': esc = 'n';  break;
+                case '\r': esc = 'r';  break;
+                case '\t': esc = 't';  break;
+                case '\v': esc = 'v';  break;
+                default:               break;
+            }
+
+            if (esc)
+            {
+                // escape sequences are never split
+                offsets.push_back(escaped.length());
+                chars.push_back('\\');
+                prohibited.push_back(false);
+                escaped += '\\';
+                offsets.push_back(escaped.length());
+                chars.push_back(esc);
+                prohibited.push_back(true);
+                escaped += esc;
+            }
+            else
+            {
+                offsets.push_back(escaped.length());
+                chars.push_back(c);
+                prohibited.push_back(false);
+                escaped.append(charStart, i + 1);
+            }
+
+            if (c == '\n')
+            {
+                // don't break immediately before the \n at the end
+                prohibited[prohibited.size() - 2] = true;
+                ++i;
+                break;
+            }
+        }
+        segStart = i;
+        offsets.push_back(escaped.length());
+
+        FindLineBreaks(chars, prohibited, breaks);
+
+        for (;;)
+        {
+            // Like libunistring's ulc_width_linebreaks(), break greedily at
+            // the last opportunity before the line gets too long. One more
+            // column is needed for the closing quote.
+            const int maxColumn = width - 1;
+            int column = int(firstLine ? firstPrefix.length() : prefix.length()) + 1;
+            int pieceWidth = 0;
+            size_t lastOpportunity = 0;
+            cuts.clear();
+            for (size_t n = 0; n < chars.size(); n++)
+            {
+                if (breaks[n])
+                {
+                    if (lastOpportunity && column + pieceWidth > maxColumn)
+                    {
+                        cuts.push_back(lastOpportunity);
+                        column = int(prefix.length()) + 1;
+                    }
+                    lastOpportunity = n;
+                    column += pieceWidth;
+                    pieceWidth = 0;
+                }
+                pieceWidth += GetCharWidth(chars[n]);
+            }
+            if (lastOpportunity && column + pieceWidth > maxColumn)
+                cuts.push_back(lastOpportunity);
+
+            // If the string doesn't fit on the first line, it starts on the next one:
+            if (firstLine && (segStart != text.end() || !cuts.empty()))
+            {
+                addLine(firstPrefix + "\"\"");
+                firstLine = false;
+                continue;
+            }
+            break;
+        }
+
+        size_t start = 0;
+        cuts.push_back(chars.size());
+        for (auto cut: cuts)
+        {
+            const wxString piece = escaped.substr(offsets[start], offsets[cut] - offsets[start]);
+            addLine((firstLine ? firstPrefix : prefix) + "\"" + piece + "\"");
+            firstLine = false;
+            start = cut;
+        }
+    }
 }
 
-/** Adds \n characters as necessary for good-looking output
+} // anonymous namespace
+
+
+/// Output of a single entry, encoded and formatted for the file.
+struct POFormattedEntry
+{
+    std::string data;
+    size_t lineCount = 0;
+};
+
+
+/**
+    Streaming writer of PO files.
+
+    Lines are encoded into the output charset as soon as they are added and
+    are collected in a single buffer, which is flushed into the output file
+    (if there is one) in large blocks. Strings are escaped and wrapped in the
+    same way gettext tools do it.
  */
-wxString FormatStringForFile(const wxString& text)
+class POCatalogWriter
 {
-    wxString s;
-    s.reserve(text.length() + 16);
+public:
+    /// Size of buffered data that triggers writing it into the file
+    static const size_t FLUSH_THRESHOLD = 256 * 1024;
+
+    /// \a wrapping is line width or POCatalog::NO_WRAPPING.
+    POCatalogWriter(wxTextFileType crlf, int wrapping)
+        : m_crlf(crlf == wxTextFileType_None ? wxTextFileType_Unix : crlf),
+          m_eol(wxString(wxTextBuffer::GetEOL(m_crlf)).ToStdString()),
+          m_wrapping(wrapping)
+    {
+        SetCharset("UTF-8");
+    }
 
-    static wxString quoted_newline(wxS("\"\n\""));
+    /// Creates in-memory writer with the same settings, for formatting part
+    /// of the output separately, to be added with Append() later.
+    std::unique_ptr<POCatalogWriter> CreatePart() const
+    {
+        std::unique_ptr<POCatalogWriter> part(new POCatalogWriter(m_crlf, m_wrapping));
+        part->SetCharset(m_charset);
+        return part;
+    }
 
-    SplitIntoLines(text, [&s](wxString&& piece, bool last)
+    /// Appends output of a writer created with CreatePart().
+    void Append(POCatalogWriter& part)
     {
-        if (!s.empty())
-            s += quoted_newline;
-        if (!last)
-            piece += '\n';
-        EscapeCStringInplace(piece);
-        s += piece;
-    });
+        m_buffer.append(part.m_buffer);
+        m_lineCount += part.m_lineCount;
+        m_encodingErrors = m_encodingErrors || part.m_encodingErrors;
+        part.m_buffer.clear();
 
-    return s;
-}
+        if (m_file.IsOpened() && m_buffer.size() >= FLUSH_THRESHOLD)
+            Flush();
+    }
 
-} // anonymous namespace
+    /// Adds entry formatted previously by a writer with the same settings.
+    void AddFormatted(const POFormattedEntry& entry)
+    {
+        m_buffer.append(entry.data);
+        m_lineCount += entry.lineCount;
+
+        if (m_file.IsOpened() && m_buffer.size() >= FLUSH_THRESHOLD)
+            Flush();
+    }
+
+    /// Writes the output into the file, instead of only collecting it.
+    bool Create(const wxString& filename)
+    {
+        m_filename = filename;
+        return m_file.Create(filename, /*overwrite=*/true);
+    }
+
+    /// Sets encoding of the output, must be called before adding any lines.
+    void SetCharset(const wxString& charset)
+    {
+        m_charset = charset;
+        const wxString lower = charset.Lower();
+        if (lower == "utf-8" || lower == "utf8")
+        {
+            m_conv.reset();
+        }
+        else
+        {
+            m_conv.reset(new wxCSConv(charset));
+            if (!m_conv->IsOk())
+                m_encodingErrors = true;
+        }
+    }
+
+    /// Discards everything written so far, so that it can be redone.
+    bool Rewind()
+    {
+        m_buffer.clear();
+        m_lineCount = 0;
+        m_encodingErrors = false;
+        if (m_file.IsOpened())
+        {
+            m_file.Close();
+            return Create(m_filename);
+        }
+        return true;
+    }
+
+    /// Preallocates the buffer if all output is kept in memory
+    void Reserve(size_t size) { m_buffer.reserve(size); }
+
+    /// Were there any characters not representable in the charset?
+    bool HasEncodingErrors() const { return m_encodingErrors; }
+
+    size_t GetLineCount() const { return m_lineCount; }
+
+    void AddLine(const wxString& line)
+    {
+        if (!line.empty())
+        {
+            if (m_conv)
+            {
+                const wxCharBuffer buf(line.mb_str(*m_conv));
+                if (buf.length() == 0)
+                    m_encodingErrors = true;
+                m_buffer.append(buf.data(), buf.length());
+            }
+            else
+            {
+                str::append_utf8(m_buffer, line.wx_str(), line.length());
+            }
+        }
+        m_buffer.append(m_eol);
+        m_lineCount++;
+
+        if (m_file.IsOpened() && m_buffer.size() >= FLUSH_THRESHOLD)
+            Flush();
+    }
+
+    /// Adds \a text that may contain several lines.
+    void AddMultiLines(const wxString& text)
+    {
+        if (text.empty())
+            return;
+
+        size_t start = 0;
+        for (;;)
+        {
+            const size_t end = text.find('\n', start);
+            if (end == wxString::npos)
+            {
+                if (start < text.length())
+                    AddLine(text.substr(start));
+                return;
+            }
+            AddLine(text.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+
+    /// Adds keyword and its string value, formatted as gettext would do it.
+    void AddString(const wxString& keyword, const wxString& text, const wxString& prefix = wxString())
+    {
+        FormatPOString(prefix, keyword, text, m_wrapping, [this](const wxString& line){ AddLine(line); });
+    }
+
+    /// Adds references, filled into lines in the same way as gettext tools do it.
+    void AddReferences(const wxArrayString& rawLines)
+    {
+        // References are wrapped even if strings aren't, see msgcat's documentation of --no-wrap
+        const size_t width = m_wrapping > 0 ? m_wrapping : 79;
+
+        wxString line(wxS("#:"));
+        for (auto& raw: rawLines)
+        {
+            // Split into individual references; filenames with spaces are enclosed
+            // in U+2068 and U+2069 and kept intact:
+            wxString ref;
+            bool isolated = false;
+            for (auto i = raw.begin(); ; ++i)
+            {
+                const bool atEnd = (i == raw.end());
+                if (atEnd || (!isolated && wxIsspace(*i)))
+                {
+                    if (!ref.empty())
+                    {
+                        if (line.length() > 2 && line.length() + ref.length() >= width)
+                        {
+                            AddLine(line);
+                            line = wxS("#:");
+                        }
+                        line << ' ' << ref;
+                        ref.clear();
+                    }
+                    if (atEnd)
+                        break;
+                    continue;
+                }
+                if (*i == L'\u2068')
+                    isolated = true;
+                else if (*i == L'\u2069')
+                    isolated = false;
+                ref += *i;
+            }
+        }
+        if (line.length() > 2)
+            AddLine(line);
+    }
+
+    /**
+        Adds lines with keywords and strings (e.g. obsolete entries), as they
+        were read from the file, rewrapped.
+
+        If \a prefix is given, it is used for all lines. Otherwise, lines
+        include their "#~" or "#~|" prefix already.
+     */
+    void AddRawLines(const wxArrayString& lines, const wxString& prefix = wxString())
+    {
+        wxString pendingPrefix, pendingKeyword, pendingValue;
+        bool pending = false;
+
+        auto flush = [&]
+        {
+            if (pending)
+                AddString(pendingKeyword, UnescapeCString(pendingValue), pendingPrefix);
+            pending = false;
+        };
+
+        for (auto& ln: lines)
+        {
+            wxString linePrefix = prefix;
+            wxString content = ln;
+            if (prefix.empty())
+            {
+                if (ln.StartsWith(wxS("#~| ")))
+                    linePrefix = wxS("#~| ");
+                else if (ln.StartsWith(wxS("#~ ")))
+                    linePrefix = wxS("#~ ");
+                content = ln.substr(linePrefix.length());
+            }
+
+            const size_t quote = content.find('"');
+            const bool quoted = !linePrefix.empty() && quote != wxString::npos &&
+                                content.length() >= quote + 2 && content.Last() == '"';
+            if (quoted && quote == 0 && pending && linePrefix == pendingPrefix)
+            {
+                pendingValue += content.substr(1, content.length() - 2);
+            }
+            else if (quoted && quote > 1 && content[quote - 1] == ' ' && IsKeyword(content.substr(0, quote - 1)))
+            {
+                flush();
+                pending = true;
+                pendingPrefix = linePrefix;
+                pendingKeyword = content.substr(0, quote - 1);
+                pendingValue = content.substr(quote + 1, content.length() - quote - 2);
+            }
+            else
+            {
+                flush();
+                AddLine(prefix + ln);
+            }
+        }
+        flush();
+    }
+
+    /// Writes any remaining data into the file and closes it.
+    bool Close()
+    {
+        if (!m_file.IsOpened())
+            return true;
+        const bool ok = Flush();
+        return m_file.Close() && ok;
+    }
+
+    /// Output collected so far, if not writing into a file
+    std::string& GetBuffer() { return m_buffer; }
+
+private:
+    static bool IsKeyword(const wxString& s)
+    {
+        return s == "msgid" || s == "msgstr" || s == "msgctxt" || s == "msgid_plural" ||
+               (s.StartsWith("msgstr[") && s.Last() == ']');
+    }
+
+    bool Flush()
+    {
+        if (m_buffer.empty())
+            return true;
+        const bool ok = m_file.Write(m_buffer.data(), m_buffer.size()) == m_buffer.size();
+        if (!ok)
+            m_writeErrors = true;
+        m_buffer.clear();
+        return ok && !m_writeErrors;
+    }
+
+    const wxTextFileType m_crlf;
+    const std::string m_eol;
+    const int m_wrapping;
+    wxString m_charset;
+    std::unique_ptr<wxCSConv> m_conv;
+
+    wxString m_filename;
+    wxFile m_file;
+    std::string m_buffer;
+    size_t m_lineCount = 0;
+    bool m_encodingErrors = false;
+    bool m_writeErrors = false;
+};
 
 
 #ifdef __WXOSX__
@@ -1133,11 +2535,8 @@ wxString FormatStringForFile(const wxString& text)
 #endif // __WXOSX__
 
 
-bool POCatalog::Save(const wxString& po_file, bool save_mo,
-                     ValidationResults& validation_results, CompilationStatus& mo_compilation_status)
+bool POCatalog::PrepareForSaving(const wxString& po_file)
 {
-    mo_compilation_status = CompilationStatus::NotDone;
-
     if ( wxFileExists(po_file) && !wxFile::Access(po_file, wxFile::write) )
     {
         wxLogError(_(L"File “%s” is read-only and cannot be saved.\nPlease save it under different name."),
@@ -1166,15 +2565,31 @@ bool POCatalog::Save(const wxString& po_file, bool save_mo,
             break;
     }
 
+    return true;
+}
+
+
+bool POCatalog::Save(const wxString& po_file, bool save_mo,
+                     ValidationResults& validation_results, CompilationStatus& mo_compilation_status)
+{
+    TRACE_SPAN("catalog", "Save");
+    mo_compilation_status = CompilationStatus::NotDone;
+
+#if wxUSE_GUI
+    // This save supersedes any unfinished background one:
+    WaitForBackgroundSave();
+    m_backgroundSave.reset();
+#endif
+
+    if (!PrepareForSaving(po_file))
+        return false;
+
     TempOutputFileFor po_file_temp_obj(po_file);
     const wxString po_file_temp = po_file_temp_obj.FileName();
 
-    wxTextFileType outputCrlf = GetDesiredCRLFFormat(m_fileCRLF);
-    // Save into Unix line endings first and only if Windows is required,
-    // reformat the file later. This is because msgcat cannot handle DOS
-    // input particularly well.
-
-    if ( !DoSaveOnly(po_file_temp, wxTextFileType_Unix) )
+    // The file is written formatted in the same way msgcat would format it,
+    // so that it looks the same as if edited with gettext tools:
+    if ( !DoSaveOnly(po_file_temp, GetDesiredCRLFFormat(m_fileCRLF)) )
     {
         wxLogError(_(L"Couldn’t save file %s."), po_file.c_str());
         return false;
@@ -1191,88 +2606,30 @@ bool POCatalog::Save(const wxString& po_file, bool save_mo,
         wxLogError("%s", DescribeCurrentException());
     }
 
-    // Now that the file was written, run msgcat to re-format it according
-    // to the usual format. This is a (barely) passable fix for #25 until
-    // proper preservation of formatting is implemented.
-
-    bool msgcat_ok = false;
+    // validated above, msgfmt can't read compressed files:
+    if ( IsGzipFileName(po_file) && !po_file_temp_obj.CompressWithGzip() )
     {
-        wxArrayString args { "msgcat", "--force-po" };
-
-        int wrapping = DEFAULT_WRAPPING;
-        if (wxConfig::Get()->ReadBool("keep_crlf", true))
-            wrapping = m_fileWrappingWidth;
-
-        if (wrapping == DEFAULT_WRAPPING)
-        {
-            if (wxConfig::Get()->ReadBool("wrap_po_files", true))
-            {
-                wrapping = (int)wxConfig::Get()->ReadLong("wrap_po_files_width", 79);
-            }
-            else
-            {
-                wrapping = NO_WRAPPING;
-            }
-        }
-
-        if (wrapping == NO_WRAPPING)
-            args.push_back("--no-wrap");
-        else if (wrapping != DEFAULT_WRAPPING)
-            args.push_back(wxString::Format("--width=%d", wrapping));
-
-        TempOutputFileFor po_file_temp2_obj(po_file_temp);
-        const wxString po_file_temp2 = po_file_temp2_obj.FileName();
+        wxLogError(_(L"Couldn’t save file %s."), po_file.c_str());
+        return false;
+    }
 
-        args.push_back("-o");
-        args.push_back(po_file_temp2);
-        args.push_back(po_file_temp);
+    if ( !po_file_temp_obj.Commit() )
+    {
+        wxLogError(_(L"Couldn’t save file %s."), po_file.c_str());
+    }
 
-        wxLogTrace("poedit", "formatting file with %s", wxJoin(args, ' '));
+    SaveCompiledMO(po_file, save_mo, mo_compilation_status);
 
-        // Ignore msgcat errors output (but not exit code), because it
-        //   a) complains about things DoValidate() already complained above
-        //   b) issues warnings about source-extraction things (e.g. using non-ASCII
-        //      msgids) that, while correct, are not something a *translator* can
-        //      do anything about.
-        GettextRunner runner;
-        msgcat_ok = runner.run_sync(args) && wxFileExists(po_file_temp2);
+    SetFileName(po_file);
 
-        // msgcat always outputs Unix line endings, so we need to reformat the file
-        if (msgcat_ok && outputCrlf == wxTextFileType_Dos)
-        {
-            wxCSConv conv(m_header.Charset);
-            wxTextFile finalFile(po_file_temp2);
-            if (finalFile.Open(conv))
-                finalFile.Write(outputCrlf, conv);
-        }
+    return true;
+}
 
-        if (!TempOutputFileFor::ReplaceFile(po_file_temp2, po_file))
-            msgcat_ok = false;
-    }
 
-    if ( msgcat_ok )
-    {
-        wxRemoveFile(po_file_temp);
-    }
-    else
-    {
-        if ( !po_file_temp_obj.Commit() )
-        {
-            wxLogError(_(L"Couldn’t save file %s."), po_file.c_str());
-        }
-        else
-        {
-            // Only shows msgcat's failure warning if we don't also get
-            // validation errors, because if we do, the cause is likely the
-            // same.
-            if ( !validation_results.errors )
-            {
-                wxLogWarning(_("There was a problem formatting the file nicely (but it was saved all right)."));
-            }
-        }
-    }
+void POCatalog::SaveCompiledMO(const wxString& po_file, bool save_mo, CompilationStatus& mo_compilation_status)
+{
+    mo_compilation_status = CompilationStatus::NotDone;
 
-    
     /* If the user wants it, compile .mo file right now: */
 
     bool compileMO = save_mo;
@@ -1281,33 +2638,17 @@ bool POCatalog::Save(const wxString& po_file, bool save_mo,
 
     if (m_fileType == Type::PO && compileMO)
     {
-        const wxString mo_file = wxFileName::StripExtension(po_file) + ".mo";
+        const wxString mo_file = wxFileName::StripExtension(StripGzipExtension(po_file)) + ".mo";
         TempOutputFileFor mo_file_temp_obj(mo_file);
         const wxString mo_file_temp = mo_file_temp_obj.FileName();
 
-        {
-            // Ignore msgfmt errors output (but not exit code), because it
-            // complains about things DoValidate() already complained above.
-            if (GettextRunner().run_sync("msgfmt", "-o", mo_file_temp, CliSafeFileName(po_file)))
-            {
-                mo_compilation_status = CompilationStatus::Success;
-            }
-            else
-            {
-                // Don't report errors, they were reported as part of validation
-                // step above.  Notice that we run msgfmt *without* the -c flag
-                // here to create the MO file in as many cases as possible, even if
-                // it has some errors.
-                //
-                // Still, msgfmt has the ugly habit of sometimes returning non-zero
-                // exit code, reporting "fatal errors" and *still* producing a usable
-                // .mo file. If this happens, don't pretend the file wasn't created.
-                if (wxFileName::FileExists(mo_file_temp))
-                    mo_compilation_status = CompilationStatus::Success;
-                else
-                    mo_compilation_status = CompilationStatus::Error;
-            }
-        }
+        // Compile in-process from the items instead of running msgfmt on the saved
+        // file. Validation errors were already reported by Validate() above and
+        // the MO file is created even if there are some, as msgfmt without -c would.
+        if (DoCompileToMO(mo_file_temp))
+            mo_compilation_status = CompilationStatus::Success;
+        else
+            mo_compilation_status = CompilationStatus::Error;
 
         // Move the MO from temporary location to the final one, if it was created
         if (mo_compilation_status == CompilationStatus::Success)
@@ -1347,39 +2688,349 @@ bool POCatalog::Save(const wxString& po_file, bool save_mo,
 #endif // __WXOSX__/!__WXOSX__
         }
     }
+}
 
-    SetFileName(po_file);
 
-    return true;
+std::string POCatalog::SaveToBuffer()
+{
+    TRACE_SPAN("catalog", "SaveToBuffer");
+    POCatalogWriter f(wxTextFileType_Unix, GetOutputWrappingWidth());
+
+    // Rough estimate of the output size, to avoid reallocations:
+    size_t size = 1024;
+    for (auto& i: m_items)
+        size += 2 * (i->GetRawString().length() + i->GetTranslation().length()) + 64;
+    f.Reserve(size);
+
+    if (!DoSaveOnly(f))
+        return std::string();
+    return std::move(f.GetBuffer());
 }
 
 
-std::string POCatalog::SaveToBuffer()
+#if wxUSE_GUI
+
+/// State of a save done by SaveInBackground(), shared with the background thread.
+struct POCatalog::BackgroundSave
 {
-    class StringSerializer : public wxMemoryText
+    struct Entry
     {
-    public:
-        bool OnWrite(wxTextFileType typeNew, const wxMBConv& conv) override
+        // catalog's item; only accessed on the main thread
+        POCatalogItemPtr item;
+        // copy of the item's data if it needs to be formatted, with its revision
+        POCatalogItemPtr copy;
+        unsigned revision = 0;
+
+        std::shared_ptr<const POFormattedEntry> formatted;
+        int lineNumber = 0;
+    };
+
+    explicit BackgroundSave(const wxString& po_file) : tempFile(po_file), compressed(IsGzipFileName(po_file)) {}
+
+    // Prepared on the main thread and not modified afterwards:
+    TempOutputFileFor tempFile;
+    const bool compressed;
+    wxTextFileType crlf = wxTextFileType_Unix;
+    int wrapping = DEFAULT_WRAPPING;
+    wxString charset;
+    wxString settings;
+    bool isPOT = false;
+    unsigned pluralsCount = 0;
+    std::unique_ptr<POCatalogWriter> header;
+
+    // Filled in by Run():
+    std::vector<Entry> entries;
+    POCatalogDeletedDataArray deletedItems;
+    bool ok = false;
+    std::atomic<bool> encodingErrors{false};
+
+    /// Formats and writes the file; runs on a background thread.
+    void Run();
+    /// Waits until Run() is finished.
+    void Wait();
+
+private:
+    void FormatEntries(const std::vector<size_t>& indexes, size_t first, size_t last);
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_finished = false;
+};
+
+
+void POCatalog::BackgroundSave::FormatEntries(const std::vector<size_t>& indexes, size_t first, size_t last)
+{
+    POCatalogWriter w(crlf, wrapping);
+    w.SetCharset(charset);
+
+    for (size_t i = first; i < last; i++)
+    {
+        auto& e = entries[indexes[i]];
+        WriteItem(w, *e.copy, isPOT, pluralsCount);
+
+        auto formatted = std::make_shared<POFormattedEntry>();
+        formatted->data = w.GetBuffer();
+        formatted->lineCount = w.GetLineCount();
+        e.formatted = formatted;
+
+        if (w.HasEncodingErrors())
+            encodingErrors = true;
+        w.Rewind();
+    }
+}
+
+void POCatalog::BackgroundSave::Run()
+{
+    try
+    {
+        std::vector<size_t> pending;
+        for (size_t i = 0; i < entries.size(); i++)
         {
-            size_t cnt = GetLineCount();
-            for (size_t n = 0; n < cnt; n++)
+            if (!entries[i].formatted)
+                pending.push_back(i);
+        }
+
+        if (pending.size() >= MIN_PARALLEL_SAVE_ITEMS)
+        {
+            const size_t chunksCount = (pending.size() + PARALLEL_SAVE_CHUNK_ITEMS - 1) / PARALLEL_SAVE_CHUNK_ITEMS;
+            dispatch::parallel_for(chunksCount, [&](size_t n)
             {
-                auto ln = GetLine(n) +
-                          GetEOL(typeNew == wxTextFileType_None ? GetLineType(n) : typeNew);
-                auto buf = ln.mb_str(conv);
-                buffer.append(buf.data(), buf.length());
+                const size_t first = n * PARALLEL_SAVE_CHUNK_ITEMS;
+                FormatEntries(pending, first, std::min(pending.size(), first + PARALLEL_SAVE_CHUNK_ITEMS));
+            });
+        }
+        else
+        {
+            FormatEntries(pending, 0, pending.size());
+        }
+
+        // Encoding errors are handled by redoing the save synchronously, see SaveInBackground():
+        if (!encodingErrors)
+        {
+            POCatalogWriter f(crlf, wrapping);
+            bool written = f.Create(tempFile.FileName());
+            if (written)
+            {
+                f.SetCharset(charset);
+                f.Append(*header);
+                for (auto& e: entries)
+                {
+                    e.lineNumber = int(f.GetLineCount() + 1);
+                    f.AddFormatted(*e.formatted);
+                }
+                POCatalog::WriteDeletedItems(f, deletedItems);
+                if (f.HasEncodingErrors())
+                    encodingErrors = true;
+                written = f.Close();
             }
-            return true;
+
+            if (written && compressed)
+                written = tempFile.CompressWithGzip();
+
+            ok = written && !encodingErrors && tempFile.Commit();
+        }
+    }
+    catch (...)
+    {
+        ok = false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_finished = true;
+    m_cv.notify_all();
+}
+
+void POCatalog::BackgroundSave::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this]{ return m_finished; });
+}
+
+
+void POCatalog::SaveInBackground(const wxString& po_file, bool save_mo, BackgroundSaveHandler completionHandler)
+{
+    // Only one save may write the file at a time; this is normally done already:
+    WaitForBackgroundSave();
+
+    if (!PrepareForSaving(po_file))
+    {
+        completionHandler(false, ValidationResults(), CompilationStatus::NotDone);
+        return;
+    }
+
+    auto save = std::make_shared<BackgroundSave>(po_file);
+    save->crlf = GetDesiredCRLFFormat(m_fileCRLF);
+    if (save->crlf == wxTextFileType_None)
+        save->crlf = wxTextFileType_Unix;
+    save->wrapping = GetOutputWrappingWidth();
+    save->isPOT = m_fileType == Type::POT;
+    save->pluralsCount = std::max(GetPluralFormsCountPresentInItems(), GetPluralForms().nplurals());
+
+    save->header.reset(new POCatalogWriter(save->crlf, save->wrapping));
+    WriteHeader(*save->header);
+    save->charset = m_header.Charset;
+
+    // Previously saved output of entries can only be reused if nothing affecting it changed;
+    // sideloaded data aren't tracked, so don't reuse anything if there are any:
+    const bool sideloaded = HasSideloadedReferenceFile();
+    save->settings = wxString::Format("%s;%d;%d;%d;%u;%d", save->charset, (int)save->crlf, save->wrapping,
+                                      (int)save->isPOT, save->pluralsCount, (int)sideloaded);
+    const bool canReuse = !sideloaded && save->settings == m_formattedEntriesSettings;
+
+    // Snapshot the data, copying only entries that changed since they were last saved, because
+    // the catalog may be modified by the user while it's being written:
+    save->entries.resize(m_items.size());
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+        auto& e = save->entries[i];
+        e.item = std::static_pointer_cast<POCatalogItem>(m_items[i]);
+        if (canReuse && e.item->m_formatted)
+        {
+            e.formatted = e.item->m_formatted;
+        }
+        else
+        {
+            e.copy = e.item->CloneForSaving();
+            e.revision = e.item->m_formattedRevision;
         }
+    }
+    save->deletedItems = m_deletedItems;
+
+    m_backgroundSave = save;
+
+    dispatch::async([save]{ save->Run(); })
+    .then_on_main([=]{ FinishBackgroundSave(save, po_file, save_mo, completionHandler); });
+}
+
+
+void POCatalog::FinishBackgroundSave(std::shared_ptr<BackgroundSave> save,
+                                     const wxString& po_file, bool save_mo,
+                                     BackgroundSaveHandler completionHandler)
+{
+    // If another save was started in the meantime, it has more recent information on the file:
+    const bool superseded = (m_backgroundSave != save);
+
+    if (save->encodingErrors)
+    {
+        // Let the synchronous save report and fix this by switching to UTF-8:
+        ValidationResults validation_results;
+        CompilationStatus mo_compilation_status = CompilationStatus::NotDone;
+        bool ok = superseded || Save(po_file, save_mo, validation_results, mo_compilation_status);
+        completionHandler(ok, validation_results, mo_compilation_status);
+        return;
+    }
+
+    if (!save->ok)
+    {
+        if (!superseded)
+            m_backgroundSave.reset();
+        wxLogError(_(L"Couldn’t save file %s."), po_file.c_str());
+        completionHandler(false, ValidationResults(), CompilationStatus::NotDone);
+        return;
+    }
 
-        std::string buffer;
+    if (superseded)
+    {
+        completionHandler(true, ValidationResults(), CompilationStatus::NotDone);
+        return;
+    }
+
+    // Keep the output for entries that weren't changed while it was being written:
+    for (auto& e: save->entries)
+    {
+        e.item->SetLineNumber(e.lineNumber);
+        if (e.copy && e.item->m_formattedRevision == e.revision)
+            e.item->m_formatted = e.formatted;
+    }
+    m_formattedEntriesSettings = save->settings;
+    InvalidateLineIndex();
+
+    if (m_deletedItems.size() == save->deletedItems.size())
+    {
+        for (size_t i = 0; i < m_deletedItems.size(); i++)
+            m_deletedItems[i].SetLineNumber(save->deletedItems[i].GetLineNumber());
+    }
+
+    SetFileName(po_file);
+
+    ValidationResults validation_results;
+    try
+    {
+        validation_results = Catalog::Validate();
+        if (HasCapability(Catalog::Cap::Translations))
+            ValidateWithNativeChecks(validation_results);
+    }
+    catch (...)
+    {
+        wxLogError("%s", DescribeCurrentException());
+    }
+
+    auto finish = [=](ValidationResults res)
+    {
+        CompilationStatus mo_compilation_status = CompilationStatus::NotDone;
+        if (m_backgroundSave == save)
+        {
+            m_backgroundSave.reset();
+            SaveCompiledMO(po_file, save_mo, mo_compilation_status);
+        }
+        completionHandler(true, res, mo_compilation_status);
     };
 
-    StringSerializer f;
+    // (msgfmt can't read compressed files, only native checks are done for them)
+    if (!HasCapability(Catalog::Cap::Translations) || !NeedsMsgfmtValidation() || save->compressed)
+    {
+        finish(validation_results);
+        return;
+    }
 
-    if (!DoSaveOnly(f, wxTextFileType_Unix))
-        return std::string();
-    return f.buffer;
+    // Cross-check the written file with msgfmt without waiting for it:
+    auto gtr = std::make_shared<GettextRunner>();
+    gtr->run_async("msgfmt", "-o", "/dev/null", "-c", CliSafeFileName(po_file))
+    .then_on_main([=](dispatch::future<subprocess::Output> output)
+    {
+        ValidationResults res(validation_results);
+        try
+        {
+            if (m_backgroundSave == save)
+                AddMsgfmtIssues(res, gtr->parse_stderr(output.get()));
+        }
+        catch (...)
+        {
+            wxLogError("%s", DescribeCurrentException());
+        }
+        finish(res);
+    });
+}
+
+
+void POCatalog::WaitForBackgroundSave()
+{
+    if (m_backgroundSave)
+        m_backgroundSave->Wait();
+}
+
+#endif // wxUSE_GUI
+
+
+void POCatalogItem::AddMemoryUsage(CatalogMemoryUsage& usage) const
+{
+    CatalogItem::AddMemoryUsage(usage);
+
+    usage.strings += m_lazyExtractedComments.GetMemoryUsage() + m_lazyOldMsgid.GetMemoryUsage();
+    usage.references += m_references.capacity() * sizeof(Reference);
+    if (m_formatted)
+        usage.caches += sizeof(POFormattedEntry) + m_formatted->data.capacity();
+}
+
+
+void POCatalog::AddFormatMemoryUsage(CatalogMemoryUsage& usage) const
+{
+    // file paths in references are shared by all items:
+    usage.references += m_internedStrings->GetMemoryUsage();
+
+    usage.items += m_deletedItems.capacity() * sizeof(POCatalogDeletedData);
+    for (auto& d: m_deletedItems)
+        usage.strings += d.GetMemoryUsage();
 }
 
 
@@ -1389,177 +3040,439 @@ bool POCatalog::CompileToMO(const wxString& mo_file,
 {
     mo_compilation_status = CompilationStatus::NotDone;
 
-    TempDirectory tmpdir;
-    if ( !tmpdir.IsOk() )
+    validation_results = Validate(/*fileWithSameContent=*/wxString());
+
+    TempOutputFileFor mo_file_temp_obj(mo_file);
+    const wxString mo_file_temp = mo_file_temp_obj.FileName();
+
+    if (!DoCompileToMO(mo_file_temp))
+    {
+        mo_compilation_status = CompilationStatus::Error;
         return false;
+    }
 
-    wxFileName mofn(mo_file);
-    wxString po_file_temp = tmpdir.CreateFileName(mofn.GetName() + ".po");
+    mo_compilation_status = CompilationStatus::Success;
 
-    if ( !DoSaveOnly(po_file_temp, wxTextFileType_Unix) )
+    if ( !mo_file_temp_obj.Commit() )
     {
-        wxLogError(_(L"Couldn’t save file %s."), po_file_temp.c_str());
+        wxLogError(_(L"Couldn’t save file %s."), mo_file.c_str());
         return false;
     }
 
-    validation_results = Validate(/*fileWithSameContent=*/po_file_temp);
+    return true;
+}
 
-    TempOutputFileFor mo_file_temp_obj(mo_file);
-    const wxString mo_file_temp = mo_file_temp_obj.FileName();
 
-    GettextRunner runner;
-    runner.run_sync("msgfmt", "-o", mo_file_temp, po_file_temp);
+namespace
+{
 
-    // Ignore msgfmt errors output (but not exit code), because it
-    // complains about things DoValidate() already complained above.
-    //
-    // Don't check return code either:
-    // msgfmt has the ugly habit of sometimes returning non-zero
-    // exit code, reporting "fatal errors" and *still* producing a usable
-    // .mo file. If this happens, don't pretend the file wasn't created.
-    if (!wxFileName::FileExists(mo_file_temp))
+// Hash function used by GNU gettext for MO files' hash table
+uint32_t MOHashString(const char *str)
+{
+    uint32_t hval = 0;
+    while (*str != '\0')
     {
-        mo_compilation_status = CompilationStatus::Error;
-        return false;
+        hval <<= 4;
+        hval += (unsigned char)*str++;
+        const uint32_t g = hval & (0xfU << 28);
+        if (g != 0)
+        {
+            hval ^= g >> 24;
+            hval ^= g;
+        }
     }
-    else
+    return hval;
+}
+
+bool IsPrime(uint32_t n)
+{
+    for (uint32_t d = 3; d * d <= n; d += 2)
     {
-        mo_compilation_status = CompilationStatus::Success;
+        if (n % d == 0)
+            return false;
     }
+    return true;
+}
 
-    if ( !mo_file_temp_obj.Commit() )
+// Hash table size that msgfmt would use for given number of strings
+uint32_t MOHashTableSize(uint32_t count)
+{
+    uint32_t size = (count * 4) / 3;
+    size |= 1;
+    while (!IsPrime(size))
+        size += 2;
+    return size <= 2 ? 3 : size;
+}
+
+} // anonymous namespace
+
+
+bool POCatalog::DoCompileToMO(const wxString& mo_file)
+{
+    TRACE_SPAN("catalog", "CompileToMO");
+    // See https://www.gnu.org/software/gettext/manual/html_node/MO-Files.html
+    // for description of the format; the output is identical to what msgfmt
+    // produces (without the -c flag) from the file saved by DoSaveOnly().
+
+    if (!m_header.Charset || m_header.Charset == "CHARSET")
+        m_header.Charset = "UTF-8";
+
+    const bool isUTF8 = m_header.Charset.Lower() == "utf-8";
+    wxCSConv conv(m_header.Charset);
+
+    bool encodingOk = true;
+    auto encode = [&](const wxString& s, std::string& out)
     {
-        wxLogError(_(L"Couldn’t save file %s."), mo_file.c_str());
+        if (s.empty())
+            return;
+        if (isUTF8)
+        {
+            str::append_utf8(out, s.wx_str(), s.length());
+            return;
+        }
+        size_t len;
+        auto buf = conv.cWC2MB(s.wc_str(), s.length(), &len);
+        if (len == wxCONV_FAILED)
+            encodingOk = false;
+        else
+            out.append(buf.data(), len);
+    };
+
+    struct Message
+    {
+        std::string id, str;
+    };
+    std::vector<Message> messages;
+    messages.reserve(m_items.size() + 1);
+
+    messages.emplace_back();
+    encode(UnescapeCString(m_header.ToString()), messages.back().str);
+
+    const auto pluralsCount = std::max(GetPluralFormsCountPresentInItems(), GetPluralForms().nplurals());
+
+    for (auto& item: m_items)
+    {
+        // msgfmt excludes untranslated and fuzzy entries:
+        if (item->IsFuzzy() || item->GetTranslation().empty())
+            continue;
+
+        Message m;
+        if (item->HasContext())
+        {
+            encode(item->GetContext(), m.id);
+            m.id += '\x04';
+        }
+        encode(item->GetRawString(), m.id);
+
+        if (item->HasPlural())
+        {
+            m.id += '\0';
+            encode(item->GetRawPluralString(), m.id);
+            for (unsigned i = 0; i < pluralsCount; i++)
+            {
+                if (i > 0)
+                    m.str += '\0';
+                encode(item->GetTranslation(i), m.str);
+            }
+        }
+        else
+        {
+            encode(item->GetTranslation(), m.str);
+        }
+
+        messages.push_back(std::move(m));
+    }
+
+    if (!encodingOk)
         return false;
+
+    // Strings are sorted by msgid, as C strings (i.e. ignoring plural part):
+    std::stable_sort(messages.begin(), messages.end(), [](const Message& a, const Message& b)
+    {
+        return strcmp(a.id.c_str(), b.id.c_str()) < 0;
+    });
+
+    const uint32_t count = (uint32_t)messages.size();
+    const uint32_t hashSize = MOHashTableSize(count);
+
+    std::vector<uint32_t> hashTable(hashSize, 0);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t hash = MOHashString(messages[i].id.c_str());
+        uint32_t idx = hash % hashSize;
+        if (hashTable[idx] != 0)
+        {
+            const uint32_t incr = 1 + (hash % (hashSize - 2));
+            do
+            {
+                if (idx >= hashSize - incr)
+                    idx -= hashSize - incr;
+                else
+                    idx += incr;
+            } while (hashTable[idx] != 0);
+        }
+        hashTable[idx] = i + 1;
     }
 
-    return true;
-}
+    const uint32_t origTableOffset = 7 * 4;
+    const uint32_t transTableOffset = origTableOffset + count * 8;
+    const uint32_t hashTableOffset = transTableOffset + count * 8;
+    const uint32_t stringsOffset = hashTableOffset + hashSize * 4;
+
+    std::vector<uint32_t> tables;
+    tables.reserve(7 + count * 4 + hashSize);
+    tables.insert(tables.end(), {0x950412de /*magic*/, 0 /*revision*/, count,
+                                 origTableOffset, transTableOffset,
+                                 hashSize, hashTableOffset});
+
+    std::string strings;
+    uint32_t offset = stringsOffset;
+    std::vector<uint32_t> transTable;
+    transTable.reserve(count * 2);
+    for (auto& m: messages)
+    {
+        tables.push_back((uint32_t)m.id.size());
+        tables.push_back(offset);
+        strings += m.id;
+        strings += '\0';
+        offset += (uint32_t)m.id.size() + 1;
+    }
+    for (auto& m: messages)
+    {
+        transTable.push_back((uint32_t)m.str.size());
+        transTable.push_back(offset);
+        strings += m.str;
+        strings += '\0';
+        offset += (uint32_t)m.str.size() + 1;
+    }
+    tables.insert(tables.end(), transTable.begin(), transTable.end());
+    tables.insert(tables.end(), hashTable.begin(), hashTable.end());
 
+    wxFile f;
+    if (!f.Create(mo_file, /*overwrite=*/true))
+        return false;
 
+    const size_t tablesSize = tables.size() * sizeof(uint32_t);
+    if (f.Write(tables.data(), tablesSize) != tablesSize ||
+        f.Write(strings.data(), strings.size()) != strings.size())
+    {
+        return false;
+    }
+
+    return f.Close();
+}
 
 
 bool POCatalog::DoSaveOnly(const wxString& po_file, wxTextFileType crlf)
 {
-    wxTextFile f;
+    POCatalogWriter f(crlf, GetOutputWrappingWidth());
     if (!f.Create(po_file))
         return false;
 
-    return DoSaveOnly(f, crlf);
+    if (!DoSaveOnly(f))
+    {
+        f.Close();
+        return false;
+    }
+
+    return f.Close();
 }
 
-bool POCatalog::DoSaveOnly(wxTextBuffer& f, wxTextFileType crlf)
+bool POCatalog::DoSaveOnly(POCatalogWriter& f)
 {
     const bool isPOT = m_fileType == Type::POT;
 
     /* Save .po file: */
+    WriteHeader(f);
+
+    const unsigned pluralsCount = std::max(GetPluralFormsCountPresentInItems(), GetPluralForms().nplurals());
+
+    auto saveItem = [isPOT, pluralsCount](POCatalogWriter& w, POCatalogItem& data)
+    {
+        data.SetLineNumber(int(w.GetLineCount()+1));
+        WriteItem(w, data, isPOT, pluralsCount);
+    };
+
+#ifdef HAVE_PARALLEL_PROCESSING
+    if (m_items.size() >= MIN_PARALLEL_SAVE_ITEMS)
+    {
+        // Entries are formatted independently of each other, so do it for chunks
+        // of them in parallel into separate buffers, then concatenate them in order.
+        // Only a limited number of chunks is kept in memory at any time.
+        const size_t itemsCount = m_items.size();
+        const size_t chunksCount = (itemsCount + PARALLEL_SAVE_CHUNK_ITEMS - 1) / PARALLEL_SAVE_CHUNK_ITEMS;
+        const size_t batchSize = 2 * std::max(1u, std::thread::hardware_concurrency());
+
+        std::vector<std::unique_ptr<POCatalogWriter>> parts;
+        for (size_t batchStart = 0; batchStart < chunksCount; batchStart += batchSize)
+        {
+            const size_t batchEnd = std::min(chunksCount, batchStart + batchSize);
+            parts.clear();
+            for (size_t c = batchStart; c < batchEnd; c++)
+                parts.push_back(f.CreatePart());
+
+            dispatch::parallel_for(batchEnd - batchStart, [&](size_t n)
+            {
+                const size_t first = (batchStart + n) * PARALLEL_SAVE_CHUNK_ITEMS;
+                const size_t last = std::min(itemsCount, first + PARALLEL_SAVE_CHUNK_ITEMS);
+                for (size_t i = first; i < last; i++)
+                    saveItem(*parts[n], static_cast<POCatalogItem&>(*m_items[i]));
+            });
+
+            for (size_t n = 0; n < parts.size(); n++)
+            {
+                // line numbers were relative to the part:
+                const int lineOffset = (int)f.GetLineCount();
+                const size_t first = (batchStart + n) * PARALLEL_SAVE_CHUNK_ITEMS;
+                const size_t last = std::min(itemsCount, first + PARALLEL_SAVE_CHUNK_ITEMS);
+                for (size_t i = first; i < last; i++)
+                {
+                    auto& item = static_cast<POCatalogItem&>(*m_items[i]);
+                    item.SetLineNumber(item.GetLineNumber() + lineOffset);
+                }
+
+                f.Append(*parts[n]);
+            }
+        }
+    }
+    else
+#endif // HAVE_PARALLEL_PROCESSING
+    {
+        for (auto& data: m_items)
+            saveItem(f, static_cast<POCatalogItem&>(*data));
+    }
+
+    // Write back deleted items in the file so that they're not lost
+    WriteDeletedItems(f, m_deletedItems);
+
+    // items' line numbers now correspond to the new file:
+    InvalidateLineIndex();
+
+    if (f.HasEncodingErrors())
+    {
+#if wxUSE_GUI
+        wxString msg;
+        msg.Printf(_(L"The file couldn’t be saved in “%s” charset as specified in translation settings.\n\nIt was saved in UTF-8 instead and the setting was modified accordingly."),
+                   m_header.Charset.c_str());
+        wxMessageBox(msg, _("Error saving file"),
+                     wxOK | wxICON_EXCLAMATION);
+#endif
+        m_header.Charset = "UTF-8";
+
+        // Re-do the save again because we modified a header:
+        if (!f.Rewind())
+            return false;
+        return DoSaveOnly(f);
+    }
+
+    return true;
+}
+
+void POCatalog::WriteHeader(POCatalogWriter& f)
+{
     if (!m_header.Charset || m_header.Charset == "CHARSET")
         m_header.Charset = "UTF-8";
 
-    SaveMultiLines(f, m_header.Comment);
-    if (isPOT)
+    f.SetCharset(m_header.Charset);
+
+    f.AddMultiLines(m_header.Comment);
+    if (m_fileType == Type::POT)
         f.AddLine(wxS("#, fuzzy"));
     f.AddLine(wxS("msgid \"\""));
-    f.AddLine(wxS("msgstr \"\""));
-    wxString pohdr = wxString(wxS("\"")) + m_header.ToString(wxS("\"\n\""));
-    pohdr.RemoveLast();
-    SaveMultiLines(f, pohdr);
+    f.AddString(wxS("msgstr"), UnescapeCString(m_header.ToString(wxString())));
     f.AddLine(wxEmptyString);
+}
 
-    auto pluralsCount = std::max(GetPluralFormsCountPresentInItems(), GetPluralForms().nplurals());
-
-    for (auto& data_: m_items)
+/*static*/
+void POCatalog::WriteItem(POCatalogWriter& w, const POCatalogItem& data, bool isPOT, unsigned pluralsCount)
+{
+    w.AddMultiLines(data.GetComment());
+    for (unsigned i = 0; i < data.GetExtractedComments().GetCount(); i++)
+    {
+        if (data.GetExtractedComments()[i].empty())
+          w.AddLine(wxS("#."));
+        else
+          w.AddLine(wxS("#. ") + data.GetExtractedComments()[i]);
+    }
+    w.AddReferences(data.GetRawReferences());
+    wxString dummy = data.GetFlags();
+    if (!dummy.empty())
+        w.AddLine(wxS("#") + dummy);
+    w.AddRawLines(data.GetOldMsgidRaw(), wxS("#| "));
+    if ( data.HasContext() )
     {
-        auto data = std::static_pointer_cast<POCatalogItem>(data_);
+        w.AddString(wxS("msgctxt"), data.GetContext());
+    }
+    w.AddString(wxS("msgid"), data.GetRawString());
+    if (data.HasPlural())
+    {
+        w.AddString(wxS("msgid_plural"), data.GetRawPluralString());
 
-        data->SetLineNumber(int(f.GetLineCount()+1));
-        SaveMultiLines(f, data->GetComment());
-        for (unsigned i = 0; i < data->GetExtractedComments().GetCount(); i++)
-        {
-            if (data->GetExtractedComments()[i].empty())
-              f.AddLine(wxS("#."));
-            else
-              f.AddLine(wxS("#. ") + data->GetExtractedComments()[i]);
-        }
-        for (unsigned i = 0; i < data->GetRawReferences().GetCount(); i++)
-            f.AddLine(wxS("#: ") + data->GetRawReferences()[i]);
-        wxString dummy = data->GetFlags();
-        if (!dummy.empty())
-            f.AddLine(wxS("#") + dummy);
-        for (unsigned i = 0; i < data->GetOldMsgidRaw().GetCount(); i++)
-            f.AddLine(wxS("#| ") + data->GetOldMsgidRaw()[i]);
-        if ( data->HasContext() )
+        for (unsigned i = 0; i < pluralsCount; i++)
         {
-            SaveMultiLines(f, wxS("msgctxt \"") + FormatStringForFile(data->GetContext()) + wxS("\""));
+            w.AddString(wxString::Format(wxS("msgstr[%u]"), i), data.GetTranslation(i));
         }
-        dummy = FormatStringForFile(data->GetRawString());
-        SaveMultiLines(f, wxS("msgid \"") + dummy + wxS("\""));
-        if (data->HasPlural())
+    }
+    else
+    {
+        if (isPOT)
         {
-            dummy = FormatStringForFile(data->GetRawPluralString());
-            SaveMultiLines(f, wxS("msgid_plural \"") + dummy + wxS("\""));
-
-            for (unsigned i = 0; i < pluralsCount; i++)
-            {
-                dummy = FormatStringForFile(data->GetTranslation(i));
-                wxString hdr = wxString::Format(wxS("msgstr[%u] \""), i);
-                SaveMultiLines(f, hdr + dummy + wxS("\""));
-            }
+            w.AddLine(wxS("msgstr \"\""));
         }
         else
         {
-            if (isPOT)
-            {
-                f.AddLine(wxS("msgstr \"\""));
-            }
-            else
-            {
-                dummy = FormatStringForFile(data->GetTranslation());
-                SaveMultiLines(f, wxS("msgstr \"") + dummy + wxS("\""));
-            }
+            w.AddString(wxS("msgstr"), data.GetTranslation());
         }
-        f.AddLine(wxEmptyString);
     }
+    w.AddLine(wxEmptyString);
+}
 
-    // Write back deleted items in the file so that they're not lost
-    for (unsigned itemIdx = 0; itemIdx < m_deletedItems.size(); itemIdx++)
+/*static*/
+void POCatalog::WriteDeletedItems(POCatalogWriter& f, POCatalogDeletedDataArray& items)
+{
+    for (unsigned itemIdx = 0; itemIdx < items.size(); itemIdx++)
     {
         if ( itemIdx != 0 )
             f.AddLine(wxEmptyString);
 
-        POCatalogDeletedData& deletedItem = m_deletedItems[itemIdx];
+        POCatalogDeletedData& deletedItem = items[itemIdx];
         deletedItem.SetLineNumber(int(f.GetLineCount()+1));
-        SaveMultiLines(f, deletedItem.GetComment());
+        f.AddMultiLines(deletedItem.GetComment());
         for (unsigned i = 0; i < deletedItem.GetExtractedComments().GetCount(); i++)
             f.AddLine(wxS("#. ") + deletedItem.GetExtractedComments()[i]);
-        for (unsigned i = 0; i < deletedItem.GetRawReferences().GetCount(); i++)
-            f.AddLine(wxS("#: ") + deletedItem.GetRawReferences()[i]);
+        f.AddReferences(deletedItem.GetRawReferences());
         wxString dummy = deletedItem.GetFlags();
         if (!dummy.empty())
             f.AddLine(wxS("#") + dummy);
 
-        for (size_t j = 0; j < deletedItem.GetDeletedLines().GetCount(); j++)
-            f.AddLine(deletedItem.GetDeletedLines()[j]);
+        f.AddRawLines(deletedItem.GetDeletedLines());
     }
+}
 
-    if (!CanEncodeToCharset(f, m_header.Charset))
-    {
-#if wxUSE_GUI
-        wxString msg;
-        msg.Printf(_(L"The file couldn’t be saved in “%s” charset as specified in translation settings.\n\nIt was saved in UTF-8 instead and the setting was modified accordingly."),
-                   m_header.Charset.c_str());
-        wxMessageBox(msg, _("Error saving file"),
-                     wxOK | wxICON_EXCLAMATION);
-#endif
-        m_header.Charset = "UTF-8";
 
-        // Re-do the save again because we modified a header:
-        f.Clear();
-        return DoSaveOnly(f, crlf);
+int POCatalog::GetOutputWrappingWidth() const
+{
+    int wrapping = DEFAULT_WRAPPING;
+    if (wxConfig::Get()->ReadBool("keep_crlf", true))
+        wrapping = m_fileWrappingWidth;
+
+    if (wrapping == DEFAULT_WRAPPING)
+    {
+        if (wxConfig::Get()->ReadBool("wrap_po_files", true))
+        {
+            wrapping = (int)wxConfig::Get()->ReadLong("wrap_po_files_width", 79);
+        }
+        else
+        {
+            wrapping = NO_WRAPPING;
+        }
     }
 
-    // Otherwise everything can be safely saved:
-    return f.Write(crlf, wxCSConv(m_header.Charset));
+    // gettext tools' default:
+    if (wrapping == DEFAULT_WRAPPING)
+        wrapping = 79;
+
+    return wrapping;
 }
 
 void POCatalog::SetLanguage(Language lang)
@@ -1585,112 +3498,459 @@ PluralFormsExpr POCatalog::GetPluralForms() const
     return PluralFormsExpr(str::to_utf8(hdr));
 }
 
-bool POCatalog::HasWrongPluralFormsCount() const
+bool POCatalog::HasWrongPluralFormsCount() const
+{
+    unsigned count = GetPluralFormsCountPresentInItems();
+    if ( count == 0 )
+        return false; // nothing translated, so we can't tell
+
+    // if 'count' is less than the count from header, it may simply mean there
+    // are untranslated strings
+    if ( count > GetPluralForms().nplurals() )
+        return true;
+
+    return false;
+}
+
+
+namespace
+{
+
+// Hash of item's msgid and context, for fast detection of duplicates
+inline uint64_t hash_msgid(const CatalogItem& item)
+{
+    const wxString& ctxt = item.GetContext();
+    const wxString& msgid = item.GetRawString();
+    auto hash = HashFNV1a(ctxt.wc_str(), ctxt.length() * sizeof(wchar_t));
+    hash = HashFNV1a("\x04", 1, hash);
+    return HashFNV1a(msgid.wc_str(), msgid.length() * sizeof(wchar_t), hash);
+}
+
+// Returns previously seen item with the same msgid and context as @a item,
+// or adds @a item to @a seen and returns nullptr if there's none.
+template<typename T>
+T *find_or_add_msgid(std::unordered_multimap<uint64_t, T*>& seen, T *item)
+{
+    const auto hash = hash_msgid(*item);
+    auto range = seen.equal_range(hash);
+    for (auto i = range.first; i != range.second; ++i)
+    {
+        if (i->second->GetRawString() == item->GetRawString() && i->second->GetContext() == item->GetContext())
+            return i->second;
+    }
+    seen.emplace(hash, item);
+    return nullptr;
+}
+
+// Adds flags from @a more that aren't in @a flags yet; both are in the ", flag1, flag2" form
+inline wxString merge_flags(wxString flags, const wxString& more)
+{
+    wxStringTokenizer tkn(more, ",");
+    while (tkn.HasMoreTokens())
+    {
+        auto f = tkn.GetNextToken().Strip(wxString::both);
+        if (!f.empty() && (flags + ",").find(", " + f + ",") == wxString::npos)
+            flags += ", " + f;
+    }
+    return flags;
+}
+
+// Adds references and extracted comments of @a src to @a item, skipping already present ones
+inline void merge_source_info(POCatalogItem& item, const POCatalogItem& src, const std::shared_ptr<InternedStrings>& interned)
+{
+    auto refs = item.GetRawReferences();
+    const size_t refsCount = refs.size();
+    for (auto& r: src.GetRawReferences())
+    {
+        if (refs.Index(r) == wxNOT_FOUND)
+            refs.push_back(r);
+    }
+    if (refs.size() != refsCount)
+        item.SetRawReferences(interned, refs);
+
+    for (auto& c: src.GetExtractedComments())
+    {
+        if (item.GetExtractedComments().Index(c) == wxNOT_FOUND)
+            item.AddExtractedComments(c);
+    }
+}
+
+} // anonymous namespace
+
+
+bool POCatalog::HasDuplicateItems() const
+{
+    std::unordered_multimap<uint64_t, const CatalogItem*> seen;
+    seen.reserve(m_items.size());
+    for (auto& item: m_items)
+    {
+        if (find_or_add_msgid(seen, static_cast<const CatalogItem*>(item.get())))
+            return true;
+    }
+    return false;
+}
+
+bool POCatalog::FixDuplicateItems()
+{
+    // Merge repeated entries into their first occurrence in place, similarly
+    // to what msguniq does: references, comments and flags are combined. If
+    // only some of the occurrences are translated, their translation is used;
+    // if they have conflicting translations, the first one is kept, but marked
+    // as fuzzy so that the translator can review it.
+    std::unordered_multimap<uint64_t, POCatalogItem*> seen;
+    seen.reserve(m_items.size());
+
+    CatalogItemArray unique;
+    unique.reserve(m_items.size());
+
+    for (auto& ptr: m_items)
+    {
+        auto item = static_cast<POCatalogItem*>(ptr.get());
+        auto first = find_or_add_msgid(seen, item);
+        if (!first)
+        {
+            unique.push_back(ptr);
+            continue;
+        }
+
+        merge_source_info(*first, *item, m_internedStrings);
+
+        if (first->GetComment().empty())
+            first->SetComment(item->GetComment());
+
+        bool fuzzy = first->IsFuzzy();
+        if (item->IsTranslated() && first->HasPlural() == item->HasPlural())
+        {
+            if (!first->IsTranslated())
+            {
+                first->SetTranslations(item->GetTranslations());
+                fuzzy = item->IsFuzzy();
+            }
+            else if (first->GetTranslations() != item->GetTranslations())
+            {
+                fuzzy = true;
+            }
+        }
+
+        auto flags = merge_flags(first->GetFlags(), item->GetFlags());
+        flags.Replace(", fuzzy", wxString());
+        if (fuzzy)
+            flags = ", fuzzy" + flags;
+        first->SetFlags(flags);
+    }
+
+    if (unique.size() == m_items.size())
+        return true;
+
+    m_items.swap(unique);
+    for (size_t i = 0; i < m_items.size(); i++)
+        m_items[i]->SetId(int(i + 1));
+    InvalidateChangeTracking();
+
+    return true;
+}
+
+
+Catalog::ValidationResults POCatalog::Validate(const wxString& fileWithSameContent)
+{
+    ValidationResults res = Catalog::Validate(fileWithSameContent);
+
+    if (!HasCapability(Catalog::Cap::Translations))
+        return res;  // no errors in POT files
+
+#if wxUSE_GUI
+    ValidateWithNativeChecks(res);
+    if (!NeedsMsgfmtValidation())
+        return res;
+#endif
+
+    // msgfmt can't read compressed files, validate an uncompressed copy instead:
+    if (!fileWithSameContent.empty() && !IsGzipFileName(fileWithSameContent))
+    {
+        ValidateWithMsgfmt(res, fileWithSameContent);
+    }
+    else
+    {
+        TempDirectory tmpdir;
+        if ( !tmpdir.IsOk() )
+            return res;
+
+        wxString tmp_po = tmpdir.CreateFileName("validated.po");
+        if ( !DoSaveOnly(tmp_po, wxTextFileType_Unix) )
+            return res;
+
+        ValidateWithMsgfmt(res, tmp_po);
+    }
+
+    return res;
+}
+
+#if wxUSE_GUI
+void POCatalog::ValidateWithNativeChecks(ValidationResults& res)
+{
+    TRACE_SPAN("qa", "ValidateWithNativeChecks");
+
+    MsgfmtChecker checker(GetPluralForms());
+    res.errors += dispatch::parallel_reduce(m_items.size(), 0, [&](size_t i)
+    {
+        auto& item = m_items[i];
+        auto error = checker.Check(*item->GetSnapshot());
+        if (error.empty())
+            return 0;
+        item->SetIssue(CatalogItem::Issue::Error, error);
+        return 1;
+    },
+    std::plus<int>());
+}
+
+
+void POCatalog::ValidateInBackground(const wxString& fileWithSameContent,
+                                     ValidationProgressHandler progressHandler,
+                                     ValidationCompletionHandler completionHandler)
+{
+    if (!HasCapability(Catalog::Cap::Translations))
+    {
+        // no errors in POT files
+        Catalog::ValidateInBackground(fileWithSameContent, progressHandler, completionHandler);
+        return;
+    }
+
+    // Errors are only valid for items that weren't modified since, so
+    // remember what was checked:
+    auto snapshot = TakeSnapshot();
+
+    // Errors take precedence over QA warnings, so they are applied after
+    // them, but found concurrently with QA checks:
+    auto checker = std::make_shared<MsgfmtChecker>(GetPluralForms());
+    auto native = std::make_shared<dispatch::future<std::vector<wxString>>>(dispatch::async([=]
+    {
+        TRACE_SPAN("qa", "ValidateWithNativeChecks");
+        return dispatch::parallel_transform(snapshot->GetCount(), [&](size_t i){ return checker->Check((*snapshot)[i]); });
+    }));
+
+    std::shared_ptr<GettextRunner> gtr;
+    std::shared_ptr<dispatch::future<subprocess::Output>> msgfmt;
+    std::shared_ptr<TempDirectory> tmpdir;
+    if (NeedsMsgfmtValidation())
+    {
+        wxString po_file(IsGzipFileName(fileWithSameContent) ? wxString() : fileWithSameContent);
+        if (po_file.empty())
+        {
+            tmpdir = std::make_shared<TempDirectory>();
+            if (tmpdir->IsOk())
+                po_file = tmpdir->CreateFileName("validated.po");
+            if (!tmpdir->IsOk() || !DoSaveOnly(po_file, wxTextFileType_Unix))
+                po_file.clear();
+        }
+        if (!po_file.empty())
+        {
+            gtr = std::make_shared<GettextRunner>();
+            msgfmt = std::make_shared<dispatch::future<subprocess::Output>>(
+                            gtr->run_async("msgfmt", "-o", "/dev/null", "-c", CliSafeFileName(po_file)));
+        }
+    }
+
+    // Sets error on catalog's item with given index if it wasn't modified since the snapshot
+    auto setError = [=](int index, const wxString& error, ValidationResults& res, CatalogItemArray& updated)
+    {
+        if (index < 0 || index >= (int)snapshot->GetCount() || index >= (int)m_items.size())
+            return;
+        auto& item = m_items[index];
+        auto& checked = (*snapshot)[index];
+        if (checked.GetItem() != item || checked.GetRevision() != item->GetRevision() || item->HasError())
+            return;
+
+        res.errors++;
+        item->SetIssue(CatalogItem::Issue::Error, error);
+        updated.push_back(item);
+    };
+
+    auto applyMsgfmt = [=](ValidationResults res)
+    {
+        msgfmt->then_on_main([=](dispatch::future<subprocess::Output> output)
+        {
+            (void)tmpdir;  // keep the file until msgfmt is done with it
+            ValidationResults results(res);
+            try
+            {
+                CatalogItemArray updated;
+                std::vector<ParsedGettextErrors::Item> located;
+                std::vector<int> lines;
+                for (auto& i: gtr->parse_stderr(output.get()).items)
+                {
+                    // ignore msgfmt output w/o a location, it's status information
+                    if (i.has_location())
+                    {
+                        located.push_back(i);
+                        lines.push_back(i.line);
+                    }
+                }
+                auto indexes = FindItemIndexesByLines(lines);
+                for (size_t n = 0; n < located.size(); n++)
+                    setError(indexes[n], located[n].text, results, updated);
+                if (!updated.empty())
+                    progressHandler(updated);
+            }
+            catch (...)
+            {
+                wxLogError("%s", DescribeCurrentException());
+            }
+            completionHandler(results);
+        });
+    };
+
+    Catalog::ValidateInBackground(fileWithSameContent, progressHandler, [=](const ValidationResults& qaResults)
+    {
+        native->then_on_main([=](dispatch::future<std::vector<wxString>> errors)
+        {
+            ValidationResults res(qaResults);
+            try
+            {
+                CatalogItemArray updated;
+                auto found = errors.get();
+                for (size_t i = 0; i < found.size(); i++)
+                {
+                    if (!found[i].empty())
+                        setError((int)i, found[i], res, updated);
+                }
+                if (!updated.empty())
+                    progressHandler(updated);
+            }
+            catch (...)
+            {
+                wxLogError("%s", DescribeCurrentException());
+            }
+
+            if (msgfmt)
+                applyMsgfmt(res);
+            else
+                completionHandler(res);
+        });
+    });
+}
+#endif // wxUSE_GUI
+
+bool POCatalog::NeedsMsgfmtValidation() const
 {
-    unsigned count = GetPluralFormsCountPresentInItems();
-    if ( count == 0 )
-        return false; // nothing translated, so we can't tell
-
-    // if 'count' is less than the count from header, it may simply mean there
-    // are untranslated strings
-    if ( count > GetPluralForms().nplurals() )
+    if (Config::ValidateWithMsgfmt())
         return true;
 
-    return false;
-}
-
-
-bool POCatalog::HasDuplicateItems() const
-{
-    typedef std::pair<wxString, wxString> MsgId;
-    std::set<MsgId> ids;
+    // MsgfmtChecker only checks some format strings, so keep using msgfmt
+    // for files with others (e.g. php-format), which it checks too:
     for (auto& item: m_items)
     {
-        if (!ids.emplace(std::make_pair(item->GetContext(), item->GetRawString())).second)
+        auto fmt = item->GetFormatFlag();
+        if (!fmt.empty() && !MsgfmtChecker::IsFormatSupported(fmt))
             return true;
     }
     return false;
 }
 
-bool POCatalog::FixDuplicateItems()
-{
-    auto oldname = m_fileName;
-
-    TempDirectory tmpdir;
-    if ( !tmpdir.IsOk() )
-        return false;
 
-    wxString ext;
-    wxFileName::SplitPath(m_fileName, nullptr, nullptr, &ext);
-    wxString po_file_temp = tmpdir.CreateFileName("catalog." + ext);
-    wxString po_file_fixed = tmpdir.CreateFileName("fixed." + ext);
+void POCatalog::ValidateWithMsgfmt(Catalog::ValidationResults& res, const wxString& po_file)
+{
+    GettextRunner gtr;
+    auto output = gtr.run_sync("msgfmt", "-o", "/dev/null", "-c", CliSafeFileName(po_file));
+    AddMsgfmtIssues(res, gtr.parse_stderr(output));
+}
 
-    if ( !DoSaveOnly(po_file_temp, wxTextFileType_Unix) )
+void POCatalog::AddMsgfmtIssues(Catalog::ValidationResults& res, const ParsedGettextErrors& errors)
+{
+    // ignore msgfmt output w/o a location because msgfmt outputs status information
+    // (e.g. "N errors found") to stderr too
+    std::vector<const ParsedGettextErrors::Item*> located;
+    std::vector<int> lines;
+    for (auto& i: errors.items)
     {
-        wxLogError(_(L"Couldn’t save file %s."), po_file_temp.c_str());
-        return false;
+        if (i.has_location())
+        {
+            located.push_back(&i);
+            lines.push_back(i.line);
+        }
     }
 
-    GettextRunner().run_sync("msguniq", "-o", CliSafeFileName(po_file_fixed), CliSafeFileName(po_file_temp));
-
-    if (!wxFileName::FileExists(po_file_fixed))
-        return false;
-
-    Load(po_file_fixed);
-    m_fileName = oldname;
-    PostCreation();
-
-    return true;
+    auto indexes = FindItemIndexesByLines(lines);
+    for (size_t n = 0; n < located.size(); n++)
+    {
+        if (indexes[n] == -1)
+            continue;
+        auto& item = m_items[indexes[n]];
+        // when cross-checking, don't report errors already found natively twice
+        if (!item->HasError())
+        {
+            res.errors++;
+            item->SetIssue(CatalogItem::Issue::Error, located[n]->text);
+        }
+    }
 }
 
 
-Catalog::ValidationResults POCatalog::Validate(const wxString& fileWithSameContent)
+bool POCatalog::UpdateFromReloaded(const POCatalog& reloaded, std::vector<int>& changedItems)
 {
-    ValidationResults res = Catalog::Validate(fileWithSameContent);
+    changedItems.clear();
 
-    if (!HasCapability(Catalog::Cap::Translations))
-        return res;  // no errors in POT files
+    if (m_fileType != reloaded.m_fileType || m_items.size() != reloaded.m_items.size())
+        return false;
 
-    if (!fileWithSameContent.empty())
-    {
-        ValidateWithMsgfmt(res, fileWithSameContent);
-    }
-    else
+    // entries must be identical, only their content may differ:
+    const size_t count = m_items.size();
+    for (size_t i = 0; i < count; i++)
     {
-        TempDirectory tmpdir;
-        if ( !tmpdir.IsOk() )
-            return res;
-
-        wxString tmp_po = tmpdir.CreateFileName("validated.po");
-        if ( !DoSaveOnly(tmp_po, wxTextFileType_Unix) )
-            return res;
-
-        ValidateWithMsgfmt(res, tmp_po);
+        auto& a = m_items[i];
+        auto& b = reloaded.m_items[i];
+        if (a->HasContext() != b->HasContext() ||
+            a->GetContext() != b->GetContext() ||
+            a->GetRawString() != b->GetRawString())
+        {
+            return false;
+        }
     }
 
-    return res;
-}
-
-void POCatalog::ValidateWithMsgfmt(Catalog::ValidationResults& res, const wxString& po_file)
-{
-    GettextRunner gtr;
-    auto output = gtr.run_sync("msgfmt", "-o", "/dev/null", "-c", CliSafeFileName(po_file));
-    auto errors = gtr.parse_stderr(output);
+    auto sameContent = [](const POCatalogItem& a, const POCatalogItem& b)
+    {
+        return !a.IsModified() && !a.IsPreTranslated() &&
+               a.HasPlural() == b.HasPlural() &&
+               a.GetRawPluralString() == b.GetRawPluralString() &&
+               a.GetTranslations() == b.GetTranslations() &&
+               a.IsFuzzy() == b.IsFuzzy() &&
+               a.GetFlags() == b.GetFlags() &&
+               a.GetComment() == b.GetComment() &&
+               a.GetExtractedComments() == b.GetExtractedComments() &&
+               a.GetOldMsgidRaw() == b.GetOldMsgidRaw() &&
+               a.HasSameReferences(b);
+    };
 
-    for (auto& i: errors.items)
+    for (size_t i = 0; i < count; i++)
     {
-        if (i.has_location())
+        auto a = std::static_pointer_cast<POCatalogItem>(m_items[i]);
+        auto b = std::static_pointer_cast<POCatalogItem>(reloaded.m_items[i]);
+        if (sameContent(*a, *b))
         {
-            auto item = FindItemByLine(i.line);
-            if (item)
-            {
-                res.errors++;
-                item->SetIssue(CatalogItem::Issue::Error, i.text);
-            }
+            // positions of entries may shift even if they didn't change
+            a->SetLineNumber(b->GetLineNumber());
+        }
+        else
+        {
+            b->SetId(a->GetId());
+            m_items[i] = b;
+            changedItems.push_back((int)i);
         }
-        // else: ignore msgfmt output w/o a location because msgfmt outputs status information
-        //       (e.g. "N errors found") to stderr too
     }
+
+    if (!changedItems.empty())
+        InvalidateChangeTracking();
+    else
+        InvalidateLineIndex();
+
+    m_header = reloaded.m_header;
+    m_sourceLanguage = reloaded.m_sourceLanguage;
+    m_sourceIsSymbolicID = reloaded.m_sourceIsSymbolicID;
+    m_deletedItems = reloaded.m_deletedItems;
+    m_fileCRLF = reloaded.m_fileCRLF;
+    m_fileWrappingWidth = reloaded.m_fileWrappingWidth;
+    m_hasPluralItems = reloaded.m_hasPluralItems;
+
+    return true;
 }
 
 
@@ -1721,6 +3981,7 @@ bool POCatalog::UpdateFromPOT(POCatalogPtr pot, bool replace_header)
         case Type::POT:
         {
             m_items = pot->m_items;
+            InvalidateChangeTracking();
             m_sourceLanguage = pot->m_sourceLanguage;
             m_sourceIsSymbolicID = pot->m_sourceIsSymbolicID;
             m_hasPluralItems = pot->m_hasPluralItems;
@@ -1747,51 +4008,559 @@ POCatalogPtr POCatalog::CreateFromPOT(POCatalogPtr pot)
         return nullptr;
 }
 
+namespace
+{
+
+/**
+    Computes similarity of strings in the same way as gettext's fstrcmp()
+    does, i.e. as 2*LCS/(len1+len2), for many strings compared to the same one.
+
+    Uses bit-parallel computation of LCS length (Hyyrö 2004), which is
+    considerably faster than the classic dynamic programming approach.
+ */
+class SimilarityMeasure
+{
+public:
+    explicit SimilarityMeasure(const std::wstring& str) : m_length(str.length())
+    {
+        m_words = (m_length + 63) / 64;
+        for (size_t i = 0; i < m_length; i++)
+        {
+            auto& mask = m_masks[str[i]];
+            if (mask.empty())
+                mask.resize(m_words, 0);
+            mask[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+
+    double Similarity(const std::wstring& other)
+    {
+        const size_t total = m_length + other.length();
+        if (total == 0)
+            return 1.0;
+        return double(2 * LCSLength(other)) / total;
+    }
+
+private:
+    size_t LCSLength(const std::wstring& other)
+    {
+        m_v.assign(m_words, ~uint64_t(0));
+        for (auto c: other)
+        {
+            auto i = m_masks.find(c);
+            if (i == m_masks.end())
+                continue;  // the value wouldn't change
+
+            // V = (V + U) | (V - U) where U = V & M[c], with carry/borrow across words:
+            const auto& mask = i->second;
+            uint64_t carry = 0, borrow = 0;
+            for (size_t w = 0; w < m_words; w++)
+            {
+                const uint64_t v = m_v[w];
+                const uint64_t u = v & mask[w];
+
+                const uint64_t sum1 = v + u;
+                const uint64_t sum = sum1 + carry;
+                carry = (sum1 < v) | (sum < sum1);
+
+                const uint64_t diff1 = v - u;
+                const uint64_t diff = diff1 - borrow;
+                borrow = (v < u) | (diff1 < borrow);
+
+                m_v[w] = sum | diff;
+            }
+        }
+
+        // LCS length is the number of zero bits within the string's length:
+        size_t lcs = 0;
+        for (size_t w = 0; w < m_words; w++)
+        {
+            uint64_t zeros = ~m_v[w];
+            if (w == m_words - 1 && m_length % 64)
+                zeros &= (uint64_t(1) << (m_length % 64)) - 1;
+            for (; zeros; zeros &= zeros - 1)
+                lcs++;
+        }
+        return lcs;
+    }
+
+    size_t m_length, m_words;
+    std::unordered_map<wchar_t, std::vector<uint64_t>> m_masks;
+    std::vector<uint64_t> m_v;
+};
+
+
+/**
+    Finds the most similar translated entry to a new source string, as
+    msgmerge's fuzzy matching does.
+
+    Instead of comparing against every entry, candidates are preselected
+    using an index of character trigrams and only the ones sharing most
+    trigrams with the string are compared exactly.
+ */
+class FuzzyMatcher
+{
+public:
+    /// Threshold used by msgmerge to consider strings similar
+    static constexpr double THRESHOLD = 0.6;
+    /// How many of the best candidates found in the index are compared
+    static constexpr size_t MAX_COMPARED = 50;
+    /// Trigrams shared by more candidates than this are considered too common
+    static constexpr size_t MAX_COMMON_POSTINGS = 1000;
+
+    explicit FuzzyMatcher(const std::vector<CatalogItemPtr>& candidates) : m_candidates(candidates)
+    {
+        m_strings.reserve(candidates.size());
+        std::vector<uint64_t> trigrams;
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            m_strings.push_back(candidates[i]->GetRawString().ToStdWstring());
+            GetTrigrams(m_strings.back(), trigrams);
+            for (auto t: trigrams)
+                m_index[t].push_back((uint32_t)i);
+        }
+    }
+
+    /// Per-thread scratch space for FindBestMatch()
+    typedef std::vector<uint32_t> Scratch;
+
+    /**
+        Returns the most similar candidate or nullptr if there's none.
+
+        Can be called from multiple threads concurrently, as long as each
+        uses its own \a counts.
+     */
+    CatalogItemPtr FindBestMatch(const CatalogItemPtr& item, Scratch& counts) const
+    {
+        counts.resize(m_candidates.size(), 0);
+
+        const auto str = item->GetRawString().ToStdWstring();
+
+        std::vector<uint64_t> trigrams;
+        GetTrigrams(str, trigrams);
+        if (trigrams.empty())
+            return nullptr;  // too short for meaningful fuzzy matching
+
+        std::vector<const std::vector<uint32_t>*> postings;
+        for (auto t: trigrams)
+        {
+            auto i = m_index.find(t);
+            if (i != m_index.end())
+                postings.push_back(&i->second);
+        }
+
+        // Rare trigrams are the most selective ones; very common ones (e.g.
+        // from shared prefixes) only add cost, so use them only if nothing
+        // better was found:
+        std::sort(postings.begin(), postings.end(), [](auto a, auto b){ return a->size() < b->size(); });
+        std::vector<uint32_t> touched;
+        for (auto p: postings)
+        {
+            if (p->size() > MAX_COMMON_POSTINGS && !touched.empty())
+                break;
+            for (auto c: *p)
+            {
+                if (counts[c]++ == 0)
+                    touched.push_back(c);
+            }
+        }
+
+        // Similarity can't exceed 2*min(len)/(len1+len2), so skip candidates
+        // whose length differs too much right away:
+        const size_t len = str.length();
+        touched.erase(std::remove_if(touched.begin(), touched.end(), [&](uint32_t c)
+        {
+            const size_t clen = m_strings[c].length();
+            if (2.0 * std::min(len, clen) / (len + clen) > THRESHOLD)
+                return false;
+            counts[c] = 0;
+            return true;
+        }), touched.end());
+
+        const size_t compared = std::min(touched.size(), MAX_COMPARED);
+        std::partial_sort(touched.begin(), touched.begin() + compared, touched.end(), [&](uint32_t a, uint32_t b)
+        {
+            return counts[a] > counts[b];
+        });
+
+        SimilarityMeasure measure(str);
+        double bestScore = THRESHOLD;
+        CatalogItemPtr best;
+        for (size_t i = 0; i < compared; i++)
+        {
+            auto& c = m_candidates[touched[i]];
+            // like msgmerge, give small advantage to entries with the same context:
+            const double bonus = (c->HasContext() == item->HasContext() && c->GetContext() == item->GetContext()) ? 0.00001 : 0.0;
+            const double score = measure.Similarity(m_strings[touched[i]]) + bonus;
+            if (score > bestScore)
+            {
+                bestScore = score;
+                best = c;
+            }
+        }
+
+        for (auto c: touched)
+            counts[c] = 0;
+
+        return best;
+    }
+
+private:
+    static void GetTrigrams(const std::wstring& s, std::vector<uint64_t>& out)
+    {
+        out.clear();
+        for (size_t i = 0; i + 3 <= s.length(); i++)
+        {
+            out.push_back((uint64_t(s[i]) << 42) | (uint64_t(s[i+1]) << 21) | uint64_t(s[i+2]));
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    const std::vector<CatalogItemPtr>& m_candidates;
+    std::vector<std::wstring> m_strings;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> m_index;
+};
+
+// Number of strings processed by FindFuzzyMatches() at once
+const size_t FUZZY_MATCH_BATCH_SIZE = 256;
+
+/**
+    Finds fuzzy matches for all \a items for which \a needed is true.
+
+    Each lookup is independent of the others, so they are processed in
+    parallel, in chunks of FUZZY_MATCH_BATCH_SIZE.
+ */
+std::vector<CatalogItemPtr> FindFuzzyMatches(const std::vector<CatalogItemPtr>& candidates,
+                                             const CatalogItemArray& items,
+                                             const std::vector<bool>& needed)
+{
+    const FuzzyMatcher matcher(candidates);
+    const size_t count = items.size();
+    std::vector<CatalogItemPtr> results(count);
+
+    // Each chunk writes a distinct range of results; merging is a bulk
+    // operation, so don't compete with interactive work for the threads:
+    const size_t chunks = (count + FUZZY_MATCH_BATCH_SIZE - 1) / FUZZY_MATCH_BATCH_SIZE;
+    dispatch::parallel_for(chunks, [&](size_t n)
+    {
+        FuzzyMatcher::Scratch scratch;
+        const size_t last = std::min((n + 1) * FUZZY_MATCH_BATCH_SIZE, count);
+        for (size_t i = n * FUZZY_MATCH_BATCH_SIZE; i < last; i++)
+        {
+            if (needed[i])
+                results[i] = matcher.FindBestMatch(items[i], scratch);
+        }
+    },
+    dispatch::priority::bulk);
+
+    return results;
+}
+
+// Key for matching entries when merging, msgmerge-style: only by msgctxt and msgid
+inline MergeStats::Key make_key_for_merge(const CatalogItemPtr& i)
+{
+    return {i->GetRawString(), wxString(), i->GetContext()};
+}
+
+inline wxString QuotedForFile(const wxString& s)
+{
+    return "\"" + EscapeCString(s) + "\"";
+}
+
+} // anonymous namespace
+
+
 bool POCatalog::Merge(const POCatalogPtr& refcat)
 {
-    wxString oldname = m_fileName;
-    wxON_BLOCK_EXIT_SET(m_fileName, oldname);
+    TRACE_SPAN("catalog", "Merge");
+    const bool fuzzyMatching = Config::MergeBehavior() != Merge_None;
+    const unsigned nplurals = std::max(1u, (unsigned)GetPluralForms().nplurals());
+
+    std::map<MergeStats::Key, CatalogItemPtr> existing;
+    build_item_map<make_key_for_merge>(existing, *this);
+
+    // Like msgmerge, revive obsolete entries whose strings are used again.
+    // They are only used if there's no live entry with the same key:
+    auto obsoleteArena = std::make_shared<CatalogItemsArena>();
+    std::map<MergeStats::Key, std::pair<size_t, POCatalogItemPtr>> obsolete;
+    for (size_t i = 0; i < m_deletedItems.size(); i++)
+    {
+        auto item = MakeItemFromDeleted(m_deletedItems[i], obsoleteArena);
+        if (!item)
+            continue;
+        auto key = make_key_for_merge(item);
+        if (existing.find(key) == existing.end())
+            obsolete.emplace(key, std::make_pair(i, item));
+    }
 
-    TempDirectory tmpdir;
-    if ( !tmpdir.IsOk() )
-        return false;
+    std::vector<CatalogItemPtr> translated;
+    if (fuzzyMatching)
+    {
+        for (auto& i: m_items)
+        {
+            if (!i->GetTranslation().empty())
+                translated.push_back(i);
+        }
+    }
+
+    // Fuzzy matching is by far the most expensive part of merging, so do it
+    // upfront for all strings that don't have an exact match:
+    std::vector<CatalogItemPtr> fuzzyMatches;
+    if (!translated.empty())
+    {
+        std::vector<bool> needed(refcat->m_items.size());
+        for (size_t i = 0; i < needed.size(); i++)
+        {
+            auto key = make_key_for_merge(refcat->m_items[i]);
+            needed[i] = existing.find(key) == existing.end() && obsolete.find(key) == obsolete.end();
+        }
+        fuzzyMatches = FindFuzzyMatches(translated, refcat->m_items, needed);
+    }
+
+    std::set<const CatalogItem*> used;
+    std::set<size_t> revived;
+    CatalogItemArray merged;
+    merged.reserve(refcat->m_items.size());
+    // all items are replaced, so don't keep old items' memory around:
+    auto mergedArena = std::make_shared<CatalogItemsArena>();
+    bool hasPluralItems = false;
+
+    for (size_t index = 0; index < refcat->m_items.size(); index++)
+    {
+        auto ref = std::static_pointer_cast<POCatalogItem>(refcat->m_items[index]);
+        auto item = CatalogItemsArena::Make<POCatalogItem>(mergedArena);
+        item->SetId(int(merged.size() + 1));
+
+        // source data always come from the reference:
+        item->SetString(ref->GetRawString());
+        if (ref->HasPlural())
+        {
+            item->SetPluralString(ref->GetRawPluralString());
+            hasPluralItems = true;
+        }
+        if (ref->HasContext())
+            item->SetContext(ref->GetContext());
+        item->SetRawReferences(m_internedStrings, ref->GetRawReferences());
+        for (auto& c: ref->GetExtractedComments())
+            item->AddExtractedComments(c);
+
+        POCatalogItemPtr def;
+        bool isFuzzyMatch = false;
+        bool isRevived = false;
+
+        const auto key = make_key_for_merge(ref);
+        auto e = existing.find(key);
+        auto o = obsolete.find(key);
+        if (e != existing.end())
+        {
+            def = std::static_pointer_cast<POCatalogItem>(e->second);
+        }
+        else if (o != obsolete.end() && revived.insert(o->second.first).second)
+        {
+            // msgmerge marks revived entries as fuzzy, they may be outdated:
+            def = o->second.second;
+            isRevived = true;
+        }
+        else if (!fuzzyMatches.empty() && fuzzyMatches[index])
+        {
+            def = std::static_pointer_cast<POCatalogItem>(fuzzyMatches[index]);
+            isFuzzyMatch = true;
+        }
+
+        bool fuzzy = false;
+        wxArrayString translations;
+        if (def)
+        {
+            used.insert(def.get());
+            item->SetComment(def->GetComment());
+
+            translations = def->GetTranslations();
+            if (ref->HasPlural() != def->HasPlural() || ref->GetRawPluralString() != def->GetRawPluralString())
+            {
+                // can't reuse translations of different plurality as they are:
+                if (ref->HasPlural() != def->HasPlural())
+                {
+                    translations.assign(ref->HasPlural() ? nplurals : 1, wxString());
+                    translations[0] = def->GetTranslation(0);
+                }
+                isFuzzyMatch = true;
+            }
+
+            fuzzy = isFuzzyMatch || isRevived || def->IsFuzzy();
+
+            if (isFuzzyMatch)
+            {
+                wxArrayString old;
+                if (def->HasContext())
+                    old.push_back("msgctxt " + QuotedForFile(def->GetContext()));
+                old.push_back("msgid " + QuotedForFile(def->GetRawString()));
+                if (def->HasPlural())
+                    old.push_back("msgid_plural " + QuotedForFile(def->GetRawPluralString()));
+                item->SetOldMsgid(old);
+            }
+            else if (def->IsFuzzy())
+            {
+                item->SetOldMsgid(def->GetOldMsgidRaw());
+            }
+        }
+        else
+        {
+            translations.assign(ref->HasPlural() ? nplurals : 1, wxString());
+        }
 
-    wxString tmp1 = tmpdir.CreateFileName("ref.pot");
-    wxString tmp2 = tmpdir.CreateFileName("input.po");
-    wxString tmp3 = tmpdir.CreateFileName("output.po");
+        item->SetFlags(fuzzy ? ", fuzzy" + ref->m_moreFlags : ref->m_moreFlags);
+        item->SetTranslations(translations);
+        merged.push_back(item);
+    }
+
+    // Translations that are no longer used become obsolete entries, placed
+    // before the ones that were already obsolete:
+    POCatalogDeletedDataArray deleted;
+    for (auto& i: m_items)
+    {
+        if (used.find(i.get()) != used.end() || i->GetTranslation().empty())
+            continue;
 
-    refcat->DoSaveOnly(tmp1, wxTextFileType_Unix);
-    DoSaveOnly(tmp2, wxTextFileType_Unix);
+        wxArrayString lines;
+        if (i->HasContext())
+            lines.push_back("#~ msgctxt " + QuotedForFile(i->GetContext()));
+        lines.push_back("#~ msgid " + QuotedForFile(i->GetRawString()));
+        if (i->HasPlural())
+        {
+            lines.push_back("#~ msgid_plural " + QuotedForFile(i->GetRawPluralString()));
+            for (unsigned n = 0; n < i->GetNumberOfTranslations(); n++)
+                lines.push_back(wxString::Format("#~ msgstr[%u] ", n) + QuotedForFile(i->GetTranslation(n)));
+        }
+        else
+        {
+            lines.push_back("#~ msgstr " + QuotedForFile(i->GetTranslation()));
+        }
 
-    std::vector<wxString> args { "msgmerge", "-q", "--force-po", "--previous" };
-    if (Config::MergeBehavior() == Merge_None)
+        POCatalogDeletedData d(lines);
+        d.SetComment(i->GetComment());
+        d.SetFlags(i->GetFlags());
+        deleted.push_back(d);
+    }
+    for (size_t i = 0; i < m_deletedItems.size(); i++)
     {
-        args.push_back("--no-fuzzy-matching");
+        // revived entries aren't obsolete anymore:
+        if (revived.find(i) == revived.end())
+            deleted.push_back(m_deletedItems[i]);
     }
 
-    args.push_back("-o");
-    args.push_back(tmp3);
-    args.push_back(tmp2);
-    args.push_back(tmp1);
+    m_items.swap(merged);
+    m_itemsArena = mergedArena;
+    InvalidateChangeTracking();
+    m_deletedItems.swap(deleted);
+    m_hasPluralItems = hasPluralItems;
+
+    // like msgmerge, update header fields that describe the source:
+    if (!refcat->m_header.CreationDate.empty())
+        m_header.CreationDate = refcat->m_header.CreationDate;
+    if (refcat->m_header.HasHeader("Report-Msgid-Bugs-To"))
+        m_header.SetHeader("Report-Msgid-Bugs-To", refcat->m_header.GetHeader("Report-Msgid-Bugs-To"));
+
+    FixupCommonIssues();
+
+    return true;
+}
+
+
+POCatalogPtr POCatalog::Concatenate(const std::vector<POCatalogPtr>& catalogs)
+{
+    wxCHECK_MSG( !catalogs.empty(), nullptr, "no catalogs to concatenate" );
+    if (catalogs.size() == 1)
+        return catalogs.front();
+
+    return DoConcatenate(catalogs);
+}
+
+
+POCatalogPtr POCatalog::DoConcatenate(const std::vector<POCatalogPtr>& catalogs)
+{
+    POCatalogPtr result(new POCatalog(Type::POT));
+    result->m_header = catalogs.front()->m_header;
+    result->m_sourceLanguage = catalogs.front()->m_sourceLanguage;
+    result->m_sourceIsSymbolicID = catalogs.front()->m_sourceIsSymbolicID;
 
-    GettextRunner runner;
-    auto output = runner.run_sync(args);
-    // FIXME: Don't do that here, report as part of return value instead
-    runner.parse_stderr(output).log_errors();
+    // Like msgcat --use-first: entries are in the order of their first occurrence
+    // and their source data come from it, while references, extracted comments
+    // and flags of all occurrences are merged:
+    std::map<MergeStats::Key, POCatalogItemPtr> existing;
 
-    if (output)
+    for (auto& cat: catalogs)
     {
-        const wxString charset = m_header.Charset;
+        for (auto& i: cat->m_items)
+        {
+            auto src = std::static_pointer_cast<POCatalogItem>(i);
+            const auto key = make_key_for_merge(src);
+
+            auto e = existing.find(key);
+            if (e == existing.end())
+            {
+                auto item = result->MakeItem<POCatalogItem>();
+                item->SetId(int(result->m_items.size() + 1));
+                item->SetString(src->GetRawString());
+                if (src->HasPlural())
+                {
+                    item->SetPluralString(src->GetRawPluralString());
+                    result->m_hasPluralItems = true;
+                }
+                if (src->HasContext())
+                    item->SetContext(src->GetContext());
+                item->SetRawReferences(result->m_internedStrings, src->GetRawReferences());
+                for (auto& c: src->GetExtractedComments())
+                    item->AddExtractedComments(c);
+                item->SetComment(src->GetComment());
+                item->SetFlags(src->GetFlags());
+                item->SetTranslations(src->GetTranslations());
+
+                result->m_items.push_back(item);
+                existing.emplace(key, item);
+                continue;
+            }
+
+            auto& item = e->second;
+            merge_source_info(*item, *src, result->m_internedStrings);
 
-        Load(tmp3);
-        m_fileName = oldname;
-        PostCreation();
+            auto flags = merge_flags(item->GetFlags(), src->GetFlags());
+            if (flags != item->GetFlags())
+                item->SetFlags(flags);
+        }
+    }
+
+    return result;
+}
 
-        // msgmerge doesn't always preserve the charset, it tends to pick
-        // the most generic one of the charsets used, so if we are merging with
-        // UTF-8 catalog, it will become UTF-8. Some people hate this.
-        m_header.Charset = charset;
+
+POCatalogPtr POCatalog::CreateFromExtracted(const std::vector<ExtractedMessage>& messages)
+{
+    // Create an entry for every message first and let DoConcatenate() merge
+    // repeated occurrences of the same string:
+    POCatalogPtr raw(new POCatalog(Type::POT));
+    raw->CreateNewHeader();
+    raw->m_items.reserve(messages.size());
+
+    for (auto& m: messages)
+    {
+        auto item = raw->MakeItem<POCatalogItem>();
+        item->SetString(m.string);
+        if (m.hasPlural)
+            item->SetPluralString(m.pluralString);
+        wxArrayString translations;
+        translations.assign(m.hasPlural ? 2 : 1, wxString());
+        item->SetTranslations(translations);
+        if (m.hasContext)
+            item->SetContext(m.context);
+        for (auto& c: m.extractedComments)
+            item->AddExtractedComments(c);
+        item->SetFlags(m.flags);
+        item->SetRawReferences(raw->m_internedStrings, m.references);
+        raw->m_items.push_back(item);
     }
 
-    return (bool)output;
+    auto result = DoConcatenate({raw});
+    result->PostCreation();
+    return result;
 }
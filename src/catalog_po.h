@@ -28,12 +28,68 @@
 
 #include "catalog.h"
 
+#include <functional>
+#include <string>
+#include <string_view>
+
 class POCatalogItem;
 class POCatalog;
+class POCatalogWriter;
+struct POFormattedEntry;
+struct ParsedGettextErrors;
 typedef std::shared_ptr<POCatalogItem> POCatalogItemPtr;
 typedef std::shared_ptr<POCatalog> POCatalogPtr;
 
 
+/**
+    Lines of UTF-8 text stored compactly in a single string.
+
+    Used for rarely needed parts of PO entries, which are only converted into
+    wxStrings when accessed. Lines are separated by '\n', which can't be part
+    of a line read from a file.
+ */
+class PORawLines
+{
+public:
+    void Add(std::string_view line)
+    {
+        if (m_count++)
+            m_data += '\n';
+        m_data.append(line.data(), line.size());
+    }
+
+    bool empty() const { return m_count == 0; }
+    size_t size() const { return m_count; }
+    void clear() { m_data.clear(); m_count = 0; }
+
+    /// Calls @a func with every line as std::string_view
+    template<typename F>
+    void ForEach(F&& func) const
+    {
+        size_t start = 0;
+        for (unsigned i = 0; i < m_count; i++)
+        {
+            size_t end = m_data.find('\n', start);
+            if (end == std::string::npos)
+                end = m_data.size();
+            func(std::string_view(m_data.data() + start, end - start));
+            start = end + 1;
+        }
+    }
+
+    /// Converts the lines into wxStrings
+    wxArrayString ToArray() const;
+
+    bool operator==(const PORawLines& other) const { return m_count == other.m_count && m_data == other.m_data; }
+
+    size_t GetMemoryUsage() const { return m_data.capacity(); }
+
+private:
+    std::string m_data;
+    unsigned m_count = 0;
+};
+
+
 class POCatalogItem : public CatalogItem
 {
 public:
@@ -42,17 +98,64 @@ public:
 
     wxArrayString GetReferences() const override;
 
+    void AddMemoryUsage(CatalogMemoryUsage& usage) const override;
+
 protected:
-    const wxArrayString& GetRawReferences() const { return m_references; }
-    void SetRawReferences(const wxArrayString& ref) { m_references = ref; }
+    /// Returns references as they are written into the file (one per line).
+    wxArrayString GetRawReferences() const;
+
+    /// Sets references from raw "#:" lines, interning file paths in @a strings.
+    void SetRawReferences(const std::shared_ptr<InternedStrings>& strings, const wxArrayString& lines);
+
+    /// Faster equivalent of comparing GetRawReferences() of both items.
+    bool HasSameReferences(const POCatalogItem& other) const;
+
+    /**
+        Sets extracted comments and previous msgid lines as read from the file,
+        without converting them until they are first needed.
+
+        Extracted comments produced by msgcat conflicts are filtered out.
+     */
+    void SetLazyMetadata(const PORawLines& extractedComments, const PORawLines& oldMsgid);
+
+    void LoadLazyMetadata() override;
 
-    void UpdateInternalRepresentation() override {}
+    // any change to the entry invalidates its previously saved output:
+    void UpdateInternalRepresentation() override
+    {
+        m_formatted.reset();
+        m_formattedRevision++;
+    }
+
+    /// Creates a copy of everything that is written into the PO file,
+    /// so that it can be formatted on another thread.
+    POCatalogItemPtr CloneForSaving() const;
 
     friend class POLoadParser;
     friend class POCatalog;
 
 protected:
-    wxArrayString m_references;
+    // Reference to source code, usually in "path:line" form, with the path
+    // stored in catalog's interned strings table
+    struct Reference
+    {
+        InternedStrings::Id path;
+        uint32_t line; // 0 if there's no line number
+
+        bool operator==(const Reference& other) const { return path == other.path && line == other.line; }
+    };
+
+    std::vector<Reference> m_references;
+    std::shared_ptr<InternedStrings> m_referenceStrings;
+
+    // unconverted metadata, valid while m_hasLazyMetadata is set
+    PORawLines m_lazyExtractedComments, m_lazyOldMsgid;
+
+    // Output of the entry from the last save, if it didn't change since then;
+    // m_formattedRevision counts all changes to the output, including direct
+    // modifications by POCatalog that CatalogItem::GetRevision() doesn't cover
+    std::shared_ptr<const POFormattedEntry> m_formatted;
+    unsigned m_formattedRevision = 0;
 };
 
 
@@ -69,8 +172,7 @@ public:
     POCatalogDeletedData()
             : m_lineNum(0) {}
     POCatalogDeletedData(const wxArrayString& deletedLines)
-            : m_deletedLines(deletedLines),
-              m_lineNum(0) {}
+            : m_lineNum(0) { SetDeletedLines(deletedLines); }
 
     POCatalogDeletedData(const POCatalogDeletedData& dt)
             : m_deletedLines(dt.m_deletedLines),
@@ -81,7 +183,10 @@ public:
               m_lineNum(dt.m_lineNum) {}
 
     /// Returns the deleted lines.
-    const wxArrayString& GetDeletedLines() const { return m_deletedLines; }
+    wxArrayString GetDeletedLines() const { return m_deletedLines.ToArray(); }
+
+    /// Returns the deleted lines as stored, in UTF-8.
+    const PORawLines& GetRawDeletedLines() const { return m_deletedLines; }
 
     /// Returns references (#:) lines for the entry
     const wxArrayString& GetRawReferences() const { return m_references; }
@@ -105,7 +210,23 @@ public:
     /// Sets the string.
     void SetDeletedLines(const wxArrayString& a)
     {
-        m_deletedLines = a;
+        m_deletedLines.clear();
+        for (auto& line: a)
+            m_deletedLines.Add(line.utf8_string());
+    }
+
+    /// Sets the deleted lines as read from the file, in UTF-8.
+    void SetRawDeletedLines(const PORawLines& lines)
+    {
+        m_deletedLines = lines;
+    }
+
+    /// Returns approximate memory used by the entry's data
+    size_t GetMemoryUsage() const
+    {
+        return m_deletedLines.GetMemoryUsage() + CatalogMemoryUsage::Of(m_flags) +
+               CatalogMemoryUsage::Of(m_comment) + CatalogMemoryUsage::Of(m_references) +
+               CatalogMemoryUsage::Of(m_extractedComments);
     }
 
     /// Sets the comment.
@@ -135,7 +256,8 @@ public:
     }
 
 private:
-    wxArrayString m_deletedLines;
+    // obsolete entries are rarely looked at, so they are kept unconverted
+    PORawLines m_deletedLines;
 
     wxArrayString m_references, m_extractedComments;
     wxString m_flags;
@@ -146,6 +268,24 @@ private:
 typedef std::vector<POCatalogDeletedData> POCatalogDeletedDataArray;
 
 
+/// Source string extracted from source code by an in-process extractor.
+struct ExtractedMessage
+{
+    wxString string;
+    wxString pluralString;
+    bool hasPlural = false;
+    wxString context;
+    bool hasContext = false;
+
+    /// Comments for translators (#.)
+    wxArrayString extractedComments;
+    /// gettext flags, in the same form as CatalogItem::GetFlags() uses (e.g. ", c-format")
+    wxString flags;
+    /// References to source code, usually in "path:line" form
+    wxArrayString references;
+};
+
+
 class POCatalog : public Catalog
 {
 protected:
@@ -190,8 +330,36 @@ public:
 
     std::string SaveToBuffer() override;
 
+#if wxUSE_GUI
+    typedef std::function<void(bool ok, const ValidationResults& validation_results,
+                               CompilationStatus mo_compilation_status)> BackgroundSaveHandler;
+
+    /**
+        Saves the catalog like Save(), but writes the file in the background.
+
+        Only entries modified since they were last saved are copied on the
+        calling thread, the rest is written using their output from the
+        previous save. The file is formatted and atomically moved into place
+        on a background thread; validation and MO compilation are done on
+        the main thread after it was written.
+
+         completionHandler is called on the main thread when done. The
+        catalog must be kept alive until then.
+     */
+    void SaveInBackground(const wxString& po_file, bool save_mo, BackgroundSaveHandler completionHandler);
+
+    /// Waits until the file written by SaveInBackground(), if any, is in place.
+    void WaitForBackgroundSave();
+#endif
+
     ValidationResults Validate(const wxString& fileWithSameContent) override;
 
+#if wxUSE_GUI
+    void ValidateInBackground(const wxString& fileWithSameContent,
+                              ValidationProgressHandler progressHandler,
+                              ValidationCompletionHandler completionHandler) override;
+#endif
+
     /// Compiles the catalog into binary MO file.
     bool CompileToMO(const wxString& mo_file,
                      ValidationResults& validation_results,
@@ -213,14 +381,62 @@ public:
     bool HasDeletedItems() const override
         { return !m_deletedItems.empty(); }
 
+    int GetDeletedItemsCount() const override
+        { return int(m_deletedItems.size()); }
+
     void RemoveDeletedItems() override
         { m_deletedItems.clear(); }
 
+    void AddFormatMemoryUsage(CatalogMemoryUsage& usage) const override;
+
+    /**
+        Updates the catalog in-place with content of @a reloaded, which is
+        a newer version of the same file freshly loaded from disk.
+
+        This is only possible if both contain the same entries (identified
+        by context and source string) in the same order. Only items whose
+        content differs are replaced; their indexes are stored into
+        @a changedItems.
+
+        @return false if entries differ and the catalog wasn't modified;
+                full reload is needed in that case.
+     */
+    bool UpdateFromReloaded(const POCatalog& reloaded, std::vector<int>& changedItems);
+
+    typedef std::function<void(const wxString& msgid, const wxString& msgid_plural, const wxString& context)> ScanKeysHandler;
+
+    /**
+        Reads only the keys of entries in PO or POT file @a po_file, without
+        loading it, and calls @a handler for each of them, in file order.
+
+        This is much faster than loading the file, e.g. for quickly finding
+        out what updating from a POT file would change.
+
+        @return false if the file couldn't be read or parsed.
+     */
+    static bool ScanKeys(const wxString& po_file, const ScanKeysHandler& handler);
+
     /// Updates the catalog from POT file.
     bool UpdateFromPOT(const wxString& pot_file, bool replace_header = false);
     bool UpdateFromPOT(POCatalogPtr pot, bool replace_header = false);
     static POCatalogPtr CreateFromPOT(POCatalogPtr pot);
 
+    /**
+        Concatenates POT catalogs into one, like msgcat --use-first does.
+
+        Entries occurring in more than one catalog are merged into one, with
+        their references, extracted comments and flags combined.
+     */
+    static POCatalogPtr Concatenate(const std::vector<POCatalogPtr>& catalogs);
+
+    /**
+        Creates POT catalog from strings extracted by in-process extractors.
+
+        Like with xgettext output, entries are in the order of their first
+        occurrence and repeated occurrences of the same string are merged.
+     */
+    static POCatalogPtr CreateFromExtracted(const std::vector<ExtractedMessage>& messages);
+
 protected:
     /** Loads catalog from .po file.
         If file named po_file ".poedit" (e.g. "cs.po.poedit") exists,
@@ -249,14 +465,45 @@ protected:
     /// Fix commonly encountered fixable problems with loaded files
     void FixupCommonIssues();
 
+#if wxUSE_GUI
+    /// Runs msgfmt's checks implemented in MsgfmtChecker on all items.
+    void ValidateWithNativeChecks(ValidationResults& res);
+#endif
+    /// Should msgfmt be run in addition to (or instead of) the native checks?
+    bool NeedsMsgfmtValidation() const;
     void ValidateWithMsgfmt(ValidationResults& res, const wxString& po_file);
+    void AddMsgfmtIssues(ValidationResults& res, const ParsedGettextErrors& errors);
+    /// Writes binary MO file compiled directly from catalog's items,
+    /// with the same content msgfmt would produce.
+    bool DoCompileToMO(const wxString& mo_file);
+
+    /// Checks if the file can be written and updates header's timestamps.
+    bool PrepareForSaving(const wxString& po_file);
+    /// Compiles MO file for the saved \a po_file, if enabled.
+    void SaveCompiledMO(const wxString& po_file, bool save_mo, CompilationStatus& mo_compilation_status);
+
+    /// Implementation of Concatenate(), merging duplicates even if there's only one catalog.
+    static POCatalogPtr DoConcatenate(const std::vector<POCatalogPtr>& catalogs);
+
     bool DoSaveOnly(const wxString& po_file, wxTextFileType crlf);
-    bool DoSaveOnly(wxTextBuffer& f, wxTextFileType crlf);
+    bool DoSaveOnly(POCatalogWriter& f);
+
+    void WriteHeader(POCatalogWriter& f);
+    static void WriteItem(POCatalogWriter& f, const POCatalogItem& data, bool isPOT, unsigned pluralsCount);
+    /// Writes deleted items, updating their line numbers
+    static void WriteDeletedItems(POCatalogWriter& f, POCatalogDeletedDataArray& items);
+
+    /// Returns line width to use when saving, or NO_WRAPPING
+    int GetOutputWrappingWidth() const;
 
     /** Merges the catalog with reference catalog
         (in the sense of msgmerge -- this catalog is old one with
         translations, \a refcat is reference catalog created by Update().)
 
+        The merge is done in-process, with fuzzy matching of new strings
+        to existing translations if enabled in preferences. Obsolete
+        entries whose strings are used again are revived as fuzzy.
+
         \return true if the merge was successful, false otherwise.
                 Note that if it returns false, the catalog was
                 \em not modified!
@@ -266,20 +513,103 @@ protected:
 protected:
     POCatalogDeletedDataArray m_deletedItems;
 
+    // Interned metadata shared by the items (paths in references)
+    std::shared_ptr<InternedStrings> m_internedStrings = std::make_shared<InternedStrings>();
+
     wxTextFileType m_fileCRLF;
     int m_fileWrappingWidth;
     bool m_hasPluralItems = false;
 
+#if wxUSE_GUI
+    struct BackgroundSave;
+    void FinishBackgroundSave(std::shared_ptr<BackgroundSave> save,
+                              const wxString& po_file, bool save_mo,
+                              BackgroundSaveHandler completionHandler);
+
+    std::shared_ptr<BackgroundSave> m_backgroundSave;
+    // output settings that entries' saved output was formatted with
+    wxString m_formattedEntriesSettings;
+#endif
+
     friend class POLoadParser;
     friend class Catalog;
 };
 
 
+/**
+    Internal class - sequential reader of PO file's lines.
+
+    Operates on raw (typically memory-mapped) file data and returns lines as
+    UTF-8 slices of it. Lines are only transcoded (into an internal buffer,
+    valid until the next line is read) if the file is not in UTF-8 or ASCII.
+ */
+class POTextReader
+{
+public:
+    POTextReader(const char *data, size_t length);
+
+    /// Sets the charset used for decoding lines (ISO-8859-1 by default).
+    /// Returns false if the charset is not supported.
+    bool SetCharset(const wxString& charset);
+
+    bool IsEmpty() const { return m_begin == m_end; }
+
+    /// Rewinds to the start of data and returns the first line
+    std::string_view GetFirstLine();
+    /// Returns the next line; must not be called if Eof() is true
+    std::string_view GetNextLine();
+    /// Is there no next line to read?
+    bool Eof() const { return m_pos >= m_end; }
+
+    /// Returns 0-based index of the line last returned
+    size_t GetCurrentLine() const { return m_currentLine; }
+
+    /// Guesses line endings type from lines read so far
+    wxTextFileType GuessType() const;
+
+    /// 1-based numbers of lines that couldn't be decoded in used charset
+    const std::vector<size_t>& GetCorruptedLines() const { return m_corruptedLines; }
+
+    /// Number of line terminators encountered so far
+    size_t GetLineBreaksCount() const { return m_countUnix + m_countDos + m_countMac; }
+
+    /// Forgets line endings and corrupted lines statistics collected so far
+    void ClearStats();
+
+    /** Adds statistics collected by another reader that read the data
+        immediately following this reader's data, adjusting line numbers
+        as if it was all read by this reader.
+     */
+    void AppendStatsFrom(const POTextReader& next);
+
+private:
+    std::string_view ReadLine();
+
+    enum class Encoding
+    {
+        UTF8,
+        Latin1,
+        Other
+    };
+
+    const char *m_begin, *m_end, *m_pos;
+    size_t m_currentLine;
+    std::string m_lineBuffer;
+
+    Encoding m_encoding;
+    // is all of the data valid UTF-8, so that lines don't need to be checked individually?
+    bool m_allValidUTF8;
+    std::unique_ptr<wxCSConv> m_conv;
+    std::vector<size_t> m_corruptedLines;
+    size_t m_countUnix, m_countDos, m_countMac;
+};
+
+
 /// Internal class - used for parsing of po files.
 class POCatalogParser
 {
 public:
-    POCatalogParser(wxTextFile *f)
+    POCatalogParser(POTextReader *f)
         : m_textFile(f),
           m_detectedLineWidth(0),
           m_detectedWrappedLines(false),
@@ -307,7 +637,7 @@ public:
 
 protected:
     // Read one line from file, remove all \r and \n characters, ignore empty lines:
-    wxString ReadTextLine();
+    std::string_view ReadTextLine();
 
     void PossibleWrappedLine()
     {
@@ -328,19 +658,19 @@ protected:
                          const wxString& flags,
                          const wxArrayString& references,
                          const wxString& comment,
-                         const wxArrayString& extractedComments,
-                         const wxArrayString& msgid_old,
+                         const PORawLines& extractedComments,
+                         const PORawLines& msgid_old,
                          unsigned lineNumber) = 0;
 
     /** Called when new deleted entry was parsed. Parsing continues
         if returned value is true and is cancelled if it
         is false. Defaults to an empty implementation.
      */
-    virtual bool OnDeletedEntry(const wxArrayString& /*deletedLines*/,
+    virtual bool OnDeletedEntry(const PORawLines& /*deletedLines*/,
                                 const wxString& /*flags*/,
                                 const wxArrayString& /*references*/,
                                 const wxString& /*comment*/,
-                                const wxArrayString& /*extractedComments*/,
+                                const PORawLines& /*extractedComments*/,
                                 unsigned /*lineNumber*/)
     {
         return true;
@@ -349,7 +679,7 @@ protected:
     virtual void OnIgnoredEntry() {}
 
     /// Textfile being parsed.
-    wxTextFile *m_textFile;
+    POTextReader *m_textFile;
     int m_detectedLineWidth;
     bool m_detectedWrappedLines;
     bool m_lastLineHardWrapped, m_previousLineHardWrapped;
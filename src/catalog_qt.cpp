@@ -27,6 +27,7 @@
 
 #include "configuration.h"
 #include "str_helpers.h"
+#include "tracing.h"
 #include "utility.h"
 
 #include <wx/intl.h>
@@ -71,12 +72,6 @@ QtLinguistReadException::QtLinguistReadException(const wxString& what)
 {}
 
 
-QtLinguistCatalogItem::document_lock::document_lock(QtLinguistCatalogItem *parent)
-    : std::lock_guard<std::mutex>(parent->m_owner.m_documentMutex)
-{
-}
-
-
 QtLinguistCatalogItem::QtLinguistCatalogItem(QtLinguistCatalog& owner, int itemId, xml_node node)
     : m_owner(owner), m_node(node)
 {
@@ -190,9 +185,13 @@ wxArrayString QtLinguistCatalogItem::GetReferences() const
 
 void QtLinguistCatalogItem::UpdateInternalRepresentation()
 {
-    // modifications in the pugixml tree can affect other nodes, we must lock the entire document
-    document_lock lock(this);
+    m_documentDirty = true;
+    m_owner.m_documentDirty = true;
+}
+
 
+void QtLinguistCatalogItem::WriteToDocument()
+{
     auto translation = m_node.child("translation");
 
     if (!translation)
@@ -240,6 +239,20 @@ void QtLinguistCatalogItem::UpdateInternalRepresentation()
 }
 
 
+void QtLinguistCatalog::SyncDocument()
+{
+    if (!m_documentDirty.exchange(false))
+        return;
+
+    for (auto& i: m_items)
+    {
+        auto& item = static_cast<QtLinguistCatalogItem&>(*i);
+        if (item.m_documentDirty.exchange(false))
+            item.WriteToDocument();
+    }
+}
+
+
 bool QtLinguistCatalog::HasCapability(Catalog::Cap cap) const
 {
     switch (cap)
@@ -264,7 +277,7 @@ bool QtLinguistCatalog::CanLoadFile(const wxString& extension)
 std::shared_ptr<QtLinguistCatalog> QtLinguistCatalog::Open(const wxString& filename)
 {
     xml_document doc;
-    auto result = doc.load_file(filename.fn_str(), PUGI_PARSE_FLAGS);
+    auto result = load_file_decompressing(doc, filename);
     if (!result)
         BOOST_THROW_EXCEPTION(QtLinguistReadException(result.description()));
 
@@ -285,21 +298,29 @@ void QtLinguistCatalog::Parse(pugi::xml_node root)
 
     m_sourceLanguage = Language::TryParseWithValidation(root.attribute("sourcelanguage").value());
     m_language = Language::TryParseWithValidation(root.attribute("language").value());
+    UpdatePluralForms();
 
-    int id = 0;
+    // find all messages first, so that the (much more expensive) creation of
+    // items can be done in parallel:
+    std::vector<pugi::xml_node> messages;
 
     for (auto context : root.children("context"))
     {
         auto name = str::to_wx(context.child("name").text().get());
-        ParseSubtree(id, context, name);
+        ParseSubtree(messages, context, name);
     }
 
     // also handle messages directly under TS (some files have this structure)
-    ParseSubtree(id, root, wxEmptyString);
+    ParseSubtree(messages, root, wxEmptyString);
+
+    CreateItems(messages.size(), [this,&messages](size_t i)
+    {
+        return MakeItem<QtLinguistCatalogItem>(*this, int(i + 1), messages[i]);
+    });
 }
 
 
-void QtLinguistCatalog::ParseSubtree(int& id, pugi::xml_node root, [[maybe_unused]]const wxString& context)
+void QtLinguistCatalog::ParseSubtree(std::vector<pugi::xml_node>& messages, pugi::xml_node root, [[maybe_unused]]const wxString& context)
 {
     // TODO: "context" in QT Linguist is something like "part of source code", e.g. specific file
     //       or component such as "MainWindow". It doesn't have equivalent in Poedit, so just ignore it
@@ -310,12 +331,12 @@ void QtLinguistCatalog::ParseSubtree(int& id, pugi::xml_node root, [[maybe_unuse
         auto type = message.child("translation").attribute("type").value();
         if (strcmp(type, "vanished") == 0 || strcmp(type, "obsolete") == 0)
         {
-            m_hasDeletedItems = true;
-            // skip deleted messages
+            // skip deleted messages, but remember them for RemoveDeletedItems()
+            m_deletedMessages.push_back(message);
             continue;
         }
 
-        m_items.push_back(std::make_shared<QtLinguistCatalogItem>(*this, ++id, message));
+        messages.push_back(message);
     }
 }
 
@@ -324,6 +345,7 @@ bool QtLinguistCatalog::Save(const wxString& filename, bool /*save_mo*/,
                              ValidationResults& validation_results,
                              CompilationStatus& /*mo_compilation_status*/)
 {
+    TRACE_SPAN("catalog", "Save");
     if ( wxFileExists(filename) && !wxFile::Access(filename, wxFile::write) )
     {
         wxLogError(_(L"File “%s” is read-only and cannot be saved.\nPlease save it under different name."),
@@ -333,10 +355,14 @@ bool QtLinguistCatalog::Save(const wxString& filename, bool /*save_mo*/,
 
     TempOutputFileFor tempfile(filename);
 
-    // format_no_empty_element_tags (i.e. <translation></translation> is convention in .ts files
-    m_doc.save_file(tempfile.FileName().fn_str(), "\t", format_raw | format_no_empty_element_tags);
+    {
+        std::lock_guard<std::mutex> lock(m_documentMutex);
+        SyncDocument();
+        // format_no_empty_element_tags (i.e. <translation></translation> is convention in .ts files
+        m_doc.save_file(tempfile.FileName().fn_str(), "\t", format_raw | format_no_empty_element_tags);
+    }
 
-    if (!tempfile.Commit())
+    if ((IsGzipFileName(filename) && !tempfile.CompressWithGzip()) || !tempfile.Commit())
     {
         wxLogError(_(L"Couldn’t save file %s."), filename.c_str());
         return false;
@@ -351,10 +377,22 @@ bool QtLinguistCatalog::Save(const wxString& filename, bool /*save_mo*/,
 
 std::string QtLinguistCatalog::SaveToBuffer()
 {
-    std::ostringstream s;
+    TRACE_SPAN("catalog", "SaveToBuffer");
+    std::lock_guard<std::mutex> lock(m_documentMutex);
+    SyncDocument();
+
+    StringOutputStream s;
     // format_no_empty_element_tags (i.e. <translation></translation> is convention in .ts files
     m_doc.save(s, "\t", format_raw | format_no_empty_element_tags);
-    return s.str();
+    return s.TakeString();
+}
+
+
+void QtLinguistCatalog::AddFormatMemoryUsage(CatalogMemoryUsage& usage) const
+{
+    std::lock_guard<std::mutex> lock(m_documentMutex);
+    usage.document += estimate_memory_usage(m_doc);
+    usage.items += m_deletedMessages.capacity() * sizeof(xml_node);
 }
 
 
@@ -362,24 +400,23 @@ void QtLinguistCatalog::SetLanguage(Language lang)
 {
     m_language = lang;
     attribute(GetXMLRoot(), "language") = lang.Code().c_str();
+    UpdatePluralForms();
 }
 
 
-PluralFormsExpr QtLinguistCatalog::GetPluralForms() const
+void QtLinguistCatalog::UpdatePluralForms()
 {
+    // Resolved once per language change rather than on every GetPluralForms()
+    // call, which is frequent (e.g. for every displayed plural item).
     static const std::unordered_map<std::string, std::string> forms = {
         #include "catalog_qt_plurals.h"
     };
 
     auto it = forms.find(m_language.LanguageTag());
-    if (it != forms.end())
-        return PluralFormsExpr(it->second);
-
-    it = forms.find(m_language.Lang());
-    if (it != forms.end())
-        return PluralFormsExpr(it->second);
+    if (it == forms.end())
+        it = forms.find(m_language.Lang());
 
-    return PluralFormsExpr::English();
+    m_pluralForms = (it != forms.end()) ? PluralFormsExpr(it->second) : PluralFormsExpr::English();
 }
 
 
@@ -387,11 +424,12 @@ void QtLinguistCatalog::RemoveDeletedItems()
 {
     std::lock_guard<std::mutex> lock(m_documentMutex);
 
-    const auto xpath_query = "//message[translation[@type='vanished' or @type='obsolete']]";
-    for (auto& x: m_doc.select_nodes(xpath_query))
+    // Deleted messages were already found by Parse(), so there's no need to
+    // search the whole document for them again. Removing a node doesn't
+    // invalidate handles to other nodes.
+    for (auto node: m_deletedMessages)
     {
-        auto node = x.node();
-        auto parent = x.parent();
+        auto parent = node.parent();
 
         auto sibling = node.previous_sibling();
         if (sibling && pugi::is_whitespace_only(sibling))
@@ -402,5 +440,6 @@ void QtLinguistCatalog::RemoveDeletedItems()
         parent.remove_child(node);
     }
 
-    m_hasDeletedItems = false;
+    m_deletedMessages.clear();
+    m_deletedMessages.shrink_to_fit();
 }
@@ -32,6 +32,7 @@
 
 #include "pugixml.h"
 
+#include <atomic>
 #include <mutex>
 #include <vector>
 
@@ -62,17 +63,20 @@ public:
     wxArrayString GetReferences() const override;
 
 protected:
+    /// Only marks the item for writing by QtLinguistCatalog::SyncDocument()
     void UpdateInternalRepresentation() override;
 
-    struct document_lock : public std::lock_guard<std::mutex>
-    {
-        document_lock(QtLinguistCatalogItem *parent);
-    };
+    /// Writes item's content into the DOM; only called by SyncDocument()
+    void WriteToDocument();
 
 protected:
     QtLinguistCatalog& m_owner;
     pugi::xml_node m_node;
     wxString m_symbolicId;
+
+    std::atomic<bool> m_documentDirty{false};
+
+    friend class QtLinguistCatalog;
 };
 
 
@@ -94,12 +98,15 @@ public:
 
     std::string SaveToBuffer() override;
 
+    void AddFormatMemoryUsage(CatalogMemoryUsage& usage) const override;
+
     Language GetLanguage() const override { return m_language; }
     void SetLanguage(Language lang) override;
 
-    PluralFormsExpr GetPluralForms() const override;
+    PluralFormsExpr GetPluralForms() const override { return m_pluralForms; }
 
-    bool HasDeletedItems() const override { return m_hasDeletedItems; }
+    bool HasDeletedItems() const override { return !m_deletedMessages.empty(); }
+    int GetDeletedItemsCount() const override { return int(m_deletedMessages.size()); }
     void RemoveDeletedItems() override;
 
     pugi::xml_node GetXMLRoot() const { return m_doc.child("TS"); }
@@ -111,14 +118,23 @@ protected:
     }
 
     void Parse(pugi::xml_node root);
-    void ParseSubtree(int& id, pugi::xml_node root, const wxString& context);
+    void UpdatePluralForms();
+    void ParseSubtree(std::vector<pugi::xml_node>& messages, pugi::xml_node root, const wxString& context);
+
+    /// Writes changed items into the DOM, as XLIFFCatalog::SyncDocument() does.
+    /// Must be called with m_documentMutex locked.
+    void SyncDocument();
 
 protected:
-    std::mutex m_documentMutex;
+    mutable std::mutex m_documentMutex;
+    std::atomic<bool> m_documentDirty{false};
     pugi::xml_document m_doc;
 
     Language m_language;
-    bool m_hasDeletedItems = false;
+    PluralFormsExpr m_pluralForms;
+
+    /// Vanished and obsolete messages found when parsing, in document order
+    std::vector<pugi::xml_node> m_deletedMessages;
 
     friend class QtLinguistCatalogItem;
 };
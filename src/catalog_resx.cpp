@@ -27,6 +27,7 @@
 
 #include "configuration.h"
 #include "str_helpers.h"
+#include "tracing.h"
 #include "utility.h"
 
 #include <wx/intl.h>
@@ -67,12 +68,6 @@ RESXReadException::RESXReadException(const wxString& what)
 {}
 
 
-RESXCatalogItem::document_lock::document_lock(RESXCatalogItem *parent)
-    : std::lock_guard<std::mutex>(parent->m_owner.m_documentMutex)
-{
-}
-
-
 RESXCatalogItem::RESXCatalogItem(RESXCatalog& owner, int itemId, xml_node node) 
     : m_owner(owner), m_node(node)
 {
@@ -110,12 +105,16 @@ RESXCatalogItem::RESXCatalogItem(RESXCatalog& owner, int itemId, xml_node node)
 
 
 void RESXCatalogItem::UpdateInternalRepresentation()
+{
+    m_documentDirty = true;
+    m_owner.m_documentDirty = true;
+}
+
+
+void RESXCatalogItem::WriteToDocument()
 {
     wxASSERT(m_translations.size() == 1); // RESX doesn't support plurals
     
-    // modifications in the pugixml tree can affect other nodes, we must lock the entire document
-    document_lock lock(this);
-    
     auto value = m_node.child("value");
     if (!value)
         value = m_node.append_child("value");
@@ -124,6 +123,20 @@ void RESXCatalogItem::UpdateInternalRepresentation()
 }
 
 
+void RESXCatalog::SyncDocument()
+{
+    if (!m_documentDirty.exchange(false))
+        return;
+
+    for (auto& i: m_items)
+    {
+        auto& item = static_cast<RESXCatalogItem&>(*i);
+        if (item.m_documentDirty.exchange(false))
+            item.WriteToDocument();
+    }
+}
+
+
 bool RESXCatalog::HasCapability(Catalog::Cap cap) const
 {
     switch (cap)
@@ -150,7 +163,7 @@ bool RESXCatalog::CanLoadFile(const wxString& extension)
 std::shared_ptr<RESXCatalog> RESXCatalog::Open(const wxString& filename)
 {
     xml_document doc;
-    auto result = doc.load_file(filename.fn_str(), PUGI_PARSE_FLAGS);
+    auto result = load_file_decompressing(doc, filename);
     if (!result)
         BOOST_THROW_EXCEPTION(RESXReadException(result.description()));
 
@@ -167,8 +180,9 @@ std::shared_ptr<RESXCatalog> RESXCatalog::Open(const wxString& filename)
 
 void RESXCatalog::Parse(pugi::xml_node root)
 {
-    int id = 0;
-    
+    // find all <data> nodes first, so that the items can be created in parallel:
+    std::vector<xml_node> nodes;
+
     // Parse all <data> elements - these contain the translatable strings
     for (auto data : root.children("data"))
     {
@@ -184,8 +198,13 @@ void RESXCatalog::Parse(pugi::xml_node root)
         if (name.empty())
             continue;
             
-        m_items.push_back(std::make_shared<RESXCatalogItem>(*this, ++id, data));
+        nodes.push_back(data);
     }
+
+    CreateItems(nodes.size(), [this,&nodes](size_t i)
+    {
+        return MakeItem<RESXCatalogItem>(*this, int(i + 1), nodes[i]);
+    });
 }
 
 
@@ -193,6 +212,7 @@ bool RESXCatalog::Save(const wxString& filename, bool /*save_mo*/,
                        ValidationResults& validation_results,
                        CompilationStatus& /*mo_compilation_status*/)
 {
+    TRACE_SPAN("catalog", "Save");
     if ( wxFileExists(filename) && !wxFile::Access(filename, wxFile::write) )
     {
         wxLogError(_(L"File “%s” is read-only and cannot be saved.\nPlease save it under different name."),
@@ -202,9 +222,13 @@ bool RESXCatalog::Save(const wxString& filename, bool /*save_mo*/,
 
     TempOutputFileFor tempfile(filename);
 
-    m_doc.save_file(tempfile.FileName().fn_str(), "\t", format_raw);
+    {
+        std::lock_guard<std::mutex> lock(m_documentMutex);
+        SyncDocument();
+        m_doc.save_file(tempfile.FileName().fn_str(), "\t", format_raw);
+    }
 
-    if (!tempfile.Commit())
+    if ((IsGzipFileName(filename) && !tempfile.CompressWithGzip()) || !tempfile.Commit())
     {
         wxLogError(_(L"Couldn’t save file %s."), filename.c_str());
         return false;
@@ -219,9 +243,20 @@ bool RESXCatalog::Save(const wxString& filename, bool /*save_mo*/,
 
 std::string RESXCatalog::SaveToBuffer()
 {
-    std::ostringstream s;
+    TRACE_SPAN("catalog", "SaveToBuffer");
+    std::lock_guard<std::mutex> lock(m_documentMutex);
+    SyncDocument();
+
+    StringOutputStream s;
     m_doc.save(s, "\t", format_raw);
-    return s.str();
+    return s.TakeString();
+}
+
+
+void RESXCatalog::AddFormatMemoryUsage(CatalogMemoryUsage& usage) const
+{
+    std::lock_guard<std::mutex> lock(m_documentMutex);
+    usage.document += estimate_memory_usage(m_doc);
 }
 
 
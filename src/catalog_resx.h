@@ -31,6 +31,7 @@
 
 #include "pugixml.h"
 
+#include <atomic>
 #include <mutex>
 #include <vector>
 
@@ -61,17 +62,20 @@ public:
     wxArrayString GetReferences() const override { return wxArrayString(); }
 
 protected:
+    /// Only marks the item for writing by RESXCatalog::SyncDocument()
     void UpdateInternalRepresentation() override;
 
-    struct document_lock : public std::lock_guard<std::mutex>
-    {
-        document_lock(RESXCatalogItem *parent);
-    };
+    /// Writes item's content into the DOM; only called by SyncDocument()
+    void WriteToDocument();
 
 protected:
     RESXCatalog& m_owner;
     pugi::xml_node m_node;
     wxString m_symbolicId;
+
+    std::atomic<bool> m_documentDirty{false};
+
+    friend class RESXCatalog;
 };
 
 
@@ -93,6 +97,8 @@ public:
 
     std::string SaveToBuffer() override;
 
+    void AddFormatMemoryUsage(CatalogMemoryUsage& usage) const override;
+
     Language GetLanguage() const override { return m_language; }
     void SetLanguage(Language lang) override;
 
@@ -106,8 +112,13 @@ protected:
 
     void Parse(pugi::xml_node root);
 
+    /// Writes changed items into the DOM, as XLIFFCatalog::SyncDocument() does.
+    /// Must be called with m_documentMutex locked.
+    void SyncDocument();
+
 protected:
-    std::mutex m_documentMutex;
+    mutable std::mutex m_documentMutex;
+    std::atomic<bool> m_documentDirty{false};
     pugi::xml_document m_doc;
     Language m_language;
 
@@ -0,0 +1,176 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "catalog_stats.h"
+
+#include "str_helpers.h"
+#include "unicode_helpers.h"
+
+#include <unicode/uchar.h>
+#include <unicode/utf16.h>
+
+
+namespace
+{
+
+// Items are cheap to process, don't create tasks for too few of them:
+const size_t STATS_CHUNK_SIZE = 500;
+
+CatalogStatistics::Counts& operator+=(CatalogStatistics::Counts& counts, const ItemTextCounts& item)
+{
+    counts.strings++;
+    counts.sourceWords += item.sourceWords;
+    counts.sourceChars += item.sourceChars;
+    counts.translationWords += item.translationWords;
+    counts.translationChars += item.translationChars;
+    return counts;
+}
+
+} // anonymous namespace
+
+
+void CountWords(const wxString& text, const Language& lang, uint32_t& words, uint32_t& chars)
+{
+    if (text.empty())
+        return;
+
+    static thread_local str::UCharScratchBuffer s_buffer;
+    auto utext = str::to_icu(text, s_buffer);
+
+    // characters are counted separately from words, so that e.g. punctuation is included:
+    for (int32_t i = 0; utext[i];)
+    {
+        UChar32 c;
+        U16_NEXT(utext, i, -1, c);
+        if (!u_isUWhiteSpace(c))
+            chars++;
+    }
+
+    unicode::BreakIterator bi(UBRK_WORD, lang);
+    bi.set_text(utext);
+    bi.begin();
+    while (bi.next() != bi.end())
+    {
+        // UBRK_WORD_NONE is for spaces and punctuation, anything else is some kind of word
+        const int32_t status = bi.rule();
+        if (status < UBRK_WORD_NONE || status >= UBRK_WORD_NONE_LIMIT)
+            words++;
+    }
+}
+
+
+const ItemTextCounts& CatalogItemSnapshot::GetTextCounts(const Language& srclang, const Language& lang) const
+{
+    // Languages aren't part of the cache key, because ICU's word breaking is
+    // determined by the script rather than the language in practice.
+    std::call_once(m_textCountsOnce, [&]
+    {
+        CountWords(m_string, srclang, m_textCounts.sourceWords, m_textCounts.sourceChars);
+        if (m_hasPlural)
+            CountWords(m_plural, srclang, m_textCounts.sourceWords, m_textCounts.sourceChars);
+
+        for (auto& t: m_translations)
+            CountWords(t, lang, m_textCounts.translationWords, m_textCounts.translationChars);
+    });
+    return m_textCounts;
+}
+
+
+CatalogStatistics::Counts& CatalogStatistics::Counts::operator+=(const Counts& other)
+{
+    strings += other.strings;
+    sourceWords += other.sourceWords;
+    sourceChars += other.sourceChars;
+    translationWords += other.translationWords;
+    translationChars += other.translationChars;
+    return *this;
+}
+
+
+CatalogStatistics::Counts CatalogStatistics::Total() const
+{
+    Counts c(translated);
+    c += fuzzy;
+    c += untranslated;
+    return c;
+}
+
+
+CatalogStatistics::Counts CatalogStatistics::Unfinished() const
+{
+    Counts c(fuzzy);
+    c += untranslated;
+    return c;
+}
+
+
+CatalogStatistics& CatalogStatistics::operator+=(const CatalogStatistics& other)
+{
+    translated += other.translated;
+    fuzzy += other.fuzzy;
+    untranslated += other.untranslated;
+    return *this;
+}
+
+
+CatalogStatistics CatalogStatistics::Compute(const CatalogSnapshot& snapshot)
+{
+    auto& items = snapshot.items();
+    auto& srclang = snapshot.GetSourceLanguage();
+    auto& lang = snapshot.GetLanguage();
+
+    dispatch::parallel_options options;
+    options.chunk_size = STATS_CHUNK_SIZE;
+
+    return dispatch::parallel_reduce(items.size(), CatalogStatistics(),
+        [&](size_t i)
+        {
+            auto& item = *items[i];
+            CatalogStatistics stats;
+            auto& counts = item.GetTextCounts(srclang, lang);
+            if (!item.IsTranslated())
+                stats.untranslated += counts;
+            else if (item.IsFuzzy())
+                stats.fuzzy += counts;
+            else
+                stats.translated += counts;
+            return stats;
+        },
+        [](CatalogStatistics a, const CatalogStatistics& b)
+        {
+            a += b;
+            return a;
+        },
+        options);
+}
+
+
+dispatch::future<CatalogStatistics> CatalogStatistics::ComputeAsync(CatalogSnapshotPtr snapshot)
+{
+    return dispatch::async([snapshot]
+    {
+        return Compute(*snapshot);
+    });
+}
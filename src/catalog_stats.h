@@ -0,0 +1,83 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_catalog_stats_h
+#define Poedit_catalog_stats_h
+
+#include "catalog.h"
+#include "concurrency.h"
+
+
+/**
+    Detailed statistics of catalog's content.
+
+    Unlike Catalog::GetStatistics(), which only counts strings, this includes
+    source and translation word and character counts (not counting
+    whitespace), e.g. for estimating the amount of work or its price. Words
+    are determined using ICU word breaking rules.
+ */
+struct CatalogStatistics
+{
+    struct Counts
+    {
+        unsigned strings = 0;
+        unsigned sourceWords = 0, sourceChars = 0;
+        unsigned translationWords = 0, translationChars = 0;
+
+        Counts& operator+=(const Counts& other);
+    };
+
+    /// Finished translations, i.e. translated and not fuzzy
+    Counts translated;
+    /// Translated, but needing work (fuzzy)
+    Counts fuzzy;
+    Counts untranslated;
+
+    /// All items
+    Counts Total() const;
+
+    /// Unfinished items, i.e. untranslated or fuzzy
+    Counts Unfinished() const;
+
+    CatalogStatistics& operator+=(const CatalogStatistics& other);
+
+    /**
+        Computes statistics of @a snapshot.
+
+        Items are processed in parallel and their counts are cached in the
+        items' snapshots, so recomputing later only processes items that were
+        modified in the meantime.
+     */
+    static CatalogStatistics Compute(const CatalogSnapshot& snapshot);
+
+    /// Asynchronous version of Compute(), doesn't block the calling thread
+    static dispatch::future<CatalogStatistics> ComputeAsync(CatalogSnapshotPtr snapshot);
+};
+
+
+/// Counts words and non-whitespace characters in @a text
+void CountWords(const wxString& text, const Language& lang, uint32_t& words, uint32_t& chars);
+
+#endif // Poedit_catalog_stats_h
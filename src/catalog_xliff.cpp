@@ -27,6 +27,7 @@
 
 #include "configuration.h"
 #include "str_helpers.h"
+#include "tracing.h"
 #include "utility.h"
 
 #include <wx/intl.h>
@@ -34,10 +35,20 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
 #include <memory>
 #include <set>
 #include <sstream>
 
+// dispatch's background queue isn't available in the non-GUI QuickLook extensions:
+#if wxUSE_GUI
+    #include "concurrency.h"
+    #define HAVE_PARALLEL_PROCESSING
+#endif
+
 using namespace pugi;
 
 
@@ -109,6 +120,14 @@ inline std::string get_node_text_with_metadata(xml_node node, const XLIFFStringM
     return s;
 }
 
+inline std::string expand_placeholders(std::string&& text, const XLIFFStringMetadata& metadata)
+{
+    std::string s(std::move(text));
+    for (auto& ph: metadata.substitutions)
+        boost::replace_all(s, ph.placeholder, ph.markup);
+    return s;
+}
+
 bool set_node_text_with_metadata(xml_node node, std::string&& text, const XLIFFStringMetadata& metadata)
 {
     if (metadata.isPlainText)
@@ -118,9 +137,7 @@ bool set_node_text_with_metadata(xml_node node, std::string&& text, const XLIFFS
     }
     else
     {
-        std::string s(std::move(text));
-        for (auto& ph: metadata.substitutions)
-            boost::replace_all(s, ph.placeholder, ph.markup);
+        auto s = expand_placeholders(std::move(text), metadata);
 
         remove_all_children(node);
         auto result = node.append_buffer(s.c_str(), s.size(), PUGI_PARSE_FLAGS, encoding_utf8);
@@ -137,6 +154,18 @@ bool set_node_text_with_metadata(xml_node node, std::string&& text, const XLIFFS
     }
 }
 
+/// Check if the text would be accepted by set_node_text_with_metadata(), without modifying any DOM
+bool is_valid_text_with_metadata(std::string&& text, const XLIFFStringMetadata& metadata)
+{
+    if (metadata.isPlainText)
+        return true;
+
+    auto s = expand_placeholders(std::move(text), metadata);
+    xml_document doc;
+    auto result = doc.append_buffer(s.c_str(), s.size(), PUGI_PARSE_FLAGS, encoding_utf8);
+    return result.status == status_ok || result.status == status_no_document_element;
+}
+
 /// Check if a string contains only digit (e.g. "42")
 inline bool is_numeric_only(const std::string& s)
 {
@@ -396,6 +425,152 @@ protected:
 };
 
 
+// Number of units parsed by one (possibly parallel) task in streaming mode
+const size_t PARALLEL_PARSE_CHUNK_UNITS = 1000;
+
+
+// Helpers for scanning raw XML markup in streaming mode:
+
+inline bool starts_with(const char *p, const char *end, const char *prefix)
+{
+    const size_t len = strlen(prefix);
+    return size_t(end - p) >= len && memcmp(p, prefix, len) == 0;
+}
+
+// Returns position right after the first occurrence of @a what, or nullptr
+inline const char *skip_past(const char *p, const char *end, const char *what)
+{
+    const size_t len = strlen(what);
+    auto i = std::search(p, end, what, what + len);
+    return i == end ? nullptr : i + len;
+}
+
+// Returns position right after the '>' that ends tag or declaration starting at @a p, or nullptr
+const char *skip_tag(const char *p, const char *end)
+{
+    char quote = 0;
+    int brackets = 0;  // internal subset of <!DOCTYPE
+    for (; p < end; ++p)
+    {
+        const char c = *p;
+        if (quote)
+        {
+            if (c == quote)
+                quote = 0;
+        }
+        else if (c == '"' || c == '\'')
+            quote = c;
+        else if (c == '[')
+            brackets++;
+        else if (c == ']')
+            brackets--;
+        else if (c == '>' && brackets <= 0)
+            return p + 1;
+    }
+    return nullptr;
+}
+
+// If @a p points to a comment, CDATA section, processing instruction or declaration,
+// returns the position right after it (end if unterminated); returns @a p otherwise
+const char *skip_non_element_markup(const char *p, const char *end)
+{
+    const char *next;
+    if (starts_with(p, end, "<!--"))
+        next = skip_past(p + 4, end, "-->");
+    else if (starts_with(p, end, "<![CDATA["))
+        next = skip_past(p + 9, end, "]]>");
+    else if (starts_with(p, end, "<?"))
+        next = skip_past(p + 2, end, "?>");
+    else if (starts_with(p, end, "<!"))
+        next = skip_tag(p, end);
+    else
+        return p;
+    return next ? next : end;
+}
+
+inline const char *skip_name(const char *p, const char *end)
+{
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' && *p != '/' && *p != '>')
+        ++p;
+    return p;
+}
+
+inline bool is_name(const char *begin, const char *end, const std::string& name)
+{
+    return size_t(end - begin) == name.size() && memcmp(begin, name.data(), name.size()) == 0;
+}
+
+// Returns position right after the end of element @a name whose start tag ends at @a p, or nullptr
+const char *find_element_end(const char *p, const char *end, const std::string& name)
+{
+    int depth = 0;
+    while ((p = (const char*)memchr(p, '<', end - p)) != nullptr)
+    {
+        auto next = skip_non_element_markup(p, end);
+        if (next != p)
+        {
+            p = next;
+            continue;
+        }
+
+        auto tagEnd = skip_tag(p, end);
+        if (!tagEnd)
+            return nullptr;
+
+        const bool closing = p[1] == '/';
+        auto n = p + (closing ? 2 : 1);
+        if (is_name(n, skip_name(n, end), name))
+        {
+            if (closing)
+            {
+                if (depth-- == 0)
+                    return tagEnd;
+            }
+            else if (tagEnd[-2] != '/')
+            {
+                depth++;
+            }
+        }
+        p = tagEnd;
+    }
+    return nullptr;
+}
+
+// Streaming mode only supports UTF-8 files (which XLIFF files virtually always are)
+bool is_utf8_xml(const char *data, size_t size)
+{
+    if (size < 2 || data[0] == 0 || data[1] == 0 || uint8_t(data[0]) == 0xFE || uint8_t(data[0]) == 0xFF)
+        return false;  // UTF-16 or UTF-32, with or without BOM
+
+    auto end = data + std::min(size, size_t(256));
+    if (!starts_with(data, end, "<?xml") && !starts_with(data, end, "\xEF\xBB\xBF<?xml"))
+        return true;  // no declaration, UTF-8 is the default
+    auto declEnd = skip_past(data, end, "?>");
+    auto enc = skip_past(data, declEnd ? declEnd : end, "encoding=");
+    if (!enc || enc == end)
+        return true;
+    const char quote = *enc;
+    std::string value(enc + 1, std::find(enc + 1, end, quote));
+    return boost::iequals(value, "utf-8") || boost::iequals(value, "utf8");
+}
+
+// Returns markup of @a node's start tag with current attributes
+std::string get_start_tag_markup(xml_node node, bool selfClosing)
+{
+    xml_document doc;
+    auto copy = doc.append_child(node.name());
+    for (auto a: node.attributes())
+        copy.append_copy(a);
+
+    std::ostringstream s;
+    copy.print(s, "", selfClosing ? format_raw : format_raw | format_no_empty_element_tags);
+    auto markup = s.str();
+    if (!selfClosing)
+        markup.erase(markup.size() - strlen(node.name()) - 3);  // </name>
+    return markup;
+}
+
+
 
 } // anonymous namespace
 
@@ -406,9 +581,57 @@ XLIFFReadException::XLIFFReadException(const wxString& what)
 {}
 
 
-XLIFFCatalogItem::document_lock::document_lock(XLIFFCatalogItem *parent)
-    : std::lock_guard<std::mutex>(parent->m_owner.m_documentMutex)
+void XLIFFCatalogItem::UpdateInternalRepresentation()
+{
+    // Check the markup now, so that the error is shown immediately, even
+    // though the translation is only written into the DOM when saving:
+    if (!is_valid_text_with_metadata(str::to_utf8(GetTranslation()), m_metadata))
+    {
+        // TRANSLATORS: Shown as error if a translation of XLIFF markup is not valid XML
+        SetIssue(Issue::Error, _("Broken markup in translation string."));
+    }
+
+    m_documentDirty = true;
+    m_owner.m_documentDirty = true;
+}
+
+
+void XLIFFCatalogItem::DetachFromDocument()
+{
+    // the item isn't shared with other threads yet, so no locking is needed
+    if (m_hasLazyMetadata.exchange(false))
+        LoadNotes();
+
+    m_references = GetReferences();
+    m_node = xml_node();
+}
+
+
+void XLIFFCatalogItem::LoadLazyMetadata()
 {
+    // The DOM may be modified by SyncDocument() concurrently, so lock it; this
+    // also ensures the notes are only loaded once if more threads get here.
+    std::lock_guard<std::mutex> lock(m_owner.m_documentMutex);
+    if (!m_hasLazyMetadata.load(std::memory_order_relaxed))
+        return;
+
+    if (m_node)
+        LoadNotes();
+    m_hasLazyMetadata.store(false, std::memory_order_release);
+}
+
+
+void XLIFFCatalog::SyncDocument()
+{
+    if (!m_documentDirty.exchange(false))
+        return;
+
+    for (auto& i: m_items)
+    {
+        auto& item = static_cast<XLIFFCatalogItem&>(*i);
+        if (item.m_documentDirty.exchange(false))
+            item.WriteToDocument(item.m_node);
+    }
 }
 
 
@@ -435,10 +658,511 @@ bool XLIFFCatalog::CanLoadFile(const wxString& extension)
 }
 
 
+// ----------------------------------------------------------------------
+// Index of the source file, for streaming mode and in-place saving
+// ----------------------------------------------------------------------
+
+struct XLIFFCatalog::SourceIndex
+{
+    typedef std::pair<size_t, size_t> Span;
+
+    struct Unit
+    {
+        Span markup;                     // position of unit's markup in the file
+        unsigned wrapper;                // index into wrappers
+        unsigned firstItem, itemCount;   // range of m_items created from the unit
+        xml_node node;                   // unit's node in the DOM (not in streaming mode)
+    };
+
+    // Enclosing <group> elements of a unit, they affect items' symbolic IDs
+    struct Wrapper
+    {
+        std::string open, close;
+        unsigned depth;
+    };
+
+    // The file is only mapped while it's being read, so that it isn't locked
+    // (on Windows) and can be safely changed by other applications:
+    wxString filename;
+    std::unique_ptr<MappedFile> file;
+    wxULongLong fileSize;
+    wxDateTime fileTime;
+
+    std::vector<Unit> units;
+    std::vector<Wrapper> wrappers;
+    // <xliff> and <file> start tags outside of units, patched if the language changes:
+    std::vector<Span> languageTags;
+
+    /// Maps the file, returns false if it can't be indexed
+    bool Open(const wxString& fn);
+
+    /// Maps the file again if it wasn't modified since Open()
+    bool Reopen()
+    {
+        wxFileName fn(filename);
+        if (fn.GetSize() != fileSize || fn.GetModificationTime() != fileTime)
+            return false;
+        file.reset(new MappedFile(filename));
+        return file->IsOk() && file->size() == fileSize.GetValue();
+    }
+
+    void Close() { file.reset(); }
+
+    /// Finds units in the file, puts the rest of the markup into @a skeleton if not null
+    bool Scan(std::string *skeleton);
+
+    /// Parses unit's markup into @a doc, returns the unit's node
+    xml_node ParseUnit(const Unit& unit, xml_document& doc) const;
+};
+
+
+struct XLIFFCatalog::SourceLayout
+{
+    std::vector<SourceIndex::Unit> units;
+    std::vector<SourceIndex::Span> languageTags;
+    std::vector<size_t> changedUnits;
+};
+
+
+bool XLIFFCatalog::SourceIndex::Open(const wxString& fn)
+{
+    filename = fn;
+    fileSize = wxFileName::GetSize(fn);
+    fileTime = wxFileName(fn).GetModificationTime();
+    file.reset(new MappedFile(fn));
+    return file->IsOk() && is_utf8_xml(file->data(), file->size());
+}
+
+
+bool XLIFFCatalog::SourceIndex::Scan(std::string *skeleton)
+{
+    struct OpenElement
+    {
+        std::string name;
+        const char *begin, *end;
+    };
+    std::vector<OpenElement> stack;
+    bool stackChanged = true;
+
+    const char *data = file->data();
+    const char *end = data + file->size();
+    const char *copied = data;  // skeleton already has everything before this point
+    const char *p = data;
+
+    while ((p = (const char*)memchr(p, '<', end - p)) != nullptr)
+    {
+        auto next = skip_non_element_markup(p, end);
+        if (next != p)
+        {
+            p = next;
+            continue;
+        }
+
+        auto tagEnd = skip_tag(p, end);
+        if (!tagEnd)
+            return false;
+
+        if (p[1] == '/')
+        {
+            auto n = p + 2;
+            if (!stack.empty() && is_name(n, skip_name(n, end), stack.back().name))
+            {
+                stack.pop_back();
+                stackChanged = true;
+            }
+            p = tagEnd;
+            continue;
+        }
+
+        const std::string name(p + 1, skip_name(p + 1, end));
+        const bool selfClosing = tagEnd[-2] == '/';
+
+        // XLIFF 1.x uses <trans-unit>, 2.x <unit>; neither has the other element
+        if (name == "trans-unit" || name == "unit")
+        {
+            auto unitEnd = selfClosing ? tagEnd : find_element_end(tagEnd, end, name);
+            if (!unitEnd)
+                return false;
+
+            if (stackChanged)
+            {
+                Wrapper w;
+                size_t first = stack.size();
+                while (first > 0 && stack[first - 1].name == "group")
+                    first--;
+                w.depth = unsigned(stack.size() - first);
+                for (size_t i = first; i < stack.size(); i++)
+                {
+                    w.open.append(stack[i].begin, stack[i].end);
+                    w.close.append("</group>");
+                }
+                if (wrappers.empty() || wrappers.back().open != w.open)
+                    wrappers.push_back(std::move(w));
+                stackChanged = false;
+            }
+
+            units.push_back({{size_t(p - data), size_t(unitEnd - data)}, unsigned(wrappers.size() - 1), 0, 0, xml_node()});
+
+            // whitespace between units is of no interest, don't waste DOM nodes on it:
+            if (skeleton && !std::all_of(copied, p, [](char c){ return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }))
+                skeleton->append(copied, p);
+            copied = p = unitEnd;
+            continue;
+        }
+
+        if (name == "xliff" || name == "file")
+            languageTags.emplace_back(size_t(p - data), size_t(tagEnd - data));
+
+        if (!selfClosing)
+        {
+            stack.push_back({name, p, tagEnd});
+            stackChanged = true;
+        }
+        p = tagEnd;
+    }
+
+    if (skeleton)
+        skeleton->append(copied, end);
+    return true;
+}
+
+
+xml_node XLIFFCatalog::SourceIndex::ParseUnit(const Unit& unit, xml_document& doc) const
+{
+    auto& wrapper = wrappers[unit.wrapper];
+    const char *markup = file->data() + unit.markup.first;
+    const size_t len = unit.markup.second - unit.markup.first;
+
+    xml_parse_result result;
+    if (wrapper.depth == 0)
+    {
+        result = doc.load_buffer(markup, len, PUGI_PARSE_FLAGS, encoding_utf8);
+    }
+    else
+    {
+        std::string s;
+        s.reserve(wrapper.open.size() + len + wrapper.close.size());
+        s.append(wrapper.open).append(markup, len).append(wrapper.close);
+        result = doc.load_buffer(s.data(), s.size(), PUGI_PARSE_FLAGS, encoding_utf8);
+    }
+    if (!result)
+        BOOST_THROW_EXCEPTION(XLIFFReadException(result.description()));
+
+    xml_node node = doc;
+    for (unsigned i = 0; i <= wrapper.depth; i++)
+        node = node.find_child([](xml_node n){ return n.type() == node_element; });
+    return node;
+}
+
+
+std::shared_ptr<XLIFFCatalog> XLIFFCatalog::OpenStreamedImpl(const wxString& filename, InstanceCreatorImpl& creator)
+{
+    auto source = std::make_shared<SourceIndex>();
+    if (!source->Open(filename))
+        return nullptr;
+
+    // if the scanner can't make sense of the file, let pugixml report the error:
+    std::string skeleton;
+    if (!source->Scan(&skeleton))
+        return nullptr;
+
+    xml_document doc;
+    auto result = doc.load_buffer(skeleton.data(), skeleton.size(), PUGI_PARSE_FLAGS, encoding_utf8);
+    if (!result)
+        return nullptr;
+
+    auto xliff_root = doc.child("xliff");
+    std::string xliff_version = xliff_root.attribute("version").value();
+
+    auto cat = creator.CreateFromDoc(std::move(doc), xliff_version);
+    if (!cat)
+        BOOST_THROW_EXCEPTION(XLIFFReadException(wxString::Format(_("unsupported version (%s)"), xliff_version)));
+
+    cat->m_source = source;
+    cat->m_streamed = true;
+    cat->Parse(xliff_root);  // only picks up the languages, there are no units in the skeleton
+    cat->ParseStreamedUnits();
+    source->Close();
+
+    return cat;
+}
+
+
+void XLIFFCatalog::ParseStreamedUnits()
+{
+    auto& units = m_source->units;
+
+    // Units are parsed in chunks, each with its own scratch document, and
+    // the items are numbered afterwards, because the number of items in
+    // a unit isn't known before parsing it:
+    const size_t chunks = (units.size() + PARALLEL_PARSE_CHUNK_UNITS - 1) / PARALLEL_PARSE_CHUNK_UNITS;
+    std::vector<std::vector<std::shared_ptr<XLIFFCatalogItem>>> created(chunks);
+    std::vector<std::exception_ptr> errors(chunks);
+
+    auto parse_chunk = [&](size_t n)
+    {
+        try
+        {
+            xml_document doc;
+            std::vector<xml_node> nodes;
+            const size_t end = std::min(units.size(), (n + 1) * PARALLEL_PARSE_CHUNK_UNITS);
+            for (size_t i = n * PARALLEL_PARSE_CHUNK_UNITS; i < end; i++)
+            {
+                auto unit = m_source->ParseUnit(units[i], doc);
+
+                nodes.clear();
+                CollectItemNodes(unit, nodes);
+
+                units[i].itemCount = (unsigned)nodes.size();
+                for (auto node: nodes)
+                {
+                    auto item = CreateItem(0, node);
+                    item->DetachFromDocument();
+                    created[n].push_back(item);
+                }
+            }
+        }
+        catch (...)
+        {
+            errors[n] = std::current_exception();
+        }
+    };
+
+#ifdef HAVE_PARALLEL_PROCESSING
+    dispatch::parallel_for(chunks, parse_chunk);
+#else
+    for (size_t n = 0; n < chunks; n++)
+        parse_chunk(n);
+#endif
+
+    for (auto& e: errors)
+    {
+        if (e)
+            std::rethrow_exception(e);
+    }
+
+    int id = 0;
+    for (auto& chunk: created)
+    {
+        for (auto& item: chunk)
+        {
+            item->SetId(++id);
+            m_items.push_back(item);
+        }
+    }
+
+    unsigned first = 0;
+    for (auto& u: units)
+    {
+        u.firstItem = first;
+        first += u.itemCount;
+    }
+}
+
+
+void XLIFFCatalog::IndexSource(const wxString& filename)
+{
+    m_source.reset();
+
+    // compressed files can't be updated in place, they are always saved whole:
+    if (IsGzipFileName(filename))
+        return;
+
+    auto source = std::make_shared<SourceIndex>();
+    if (!source->Open(filename) || !source->Scan(nullptr))
+        return;
+
+    // match scanned units with DOM nodes and items; if anything doesn't fit,
+    // just don't use the index and serialize the entire DOM when saving
+    auto domUnits = m_doc.select_nodes("//trans-unit | //unit");
+    if (domUnits.size() != source->units.size())
+        return;
+
+    std::vector<xml_node> nodes;
+    size_t itemIndex = 0;
+    for (size_t i = 0; i < source->units.size(); i++)
+    {
+        auto& u = source->units[i];
+        u.node = domUnits[i].node();
+
+        nodes.clear();
+        CollectItemNodes(u.node, nodes);
+
+        u.firstItem = (unsigned)itemIndex;
+        u.itemCount = (unsigned)nodes.size();
+        for (auto node: nodes)
+        {
+            if (itemIndex >= m_items.size() || static_cast<XLIFFCatalogItem&>(*m_items[itemIndex]).m_node != node)
+                return;
+            itemIndex++;
+        }
+    }
+    if (itemIndex != m_items.size())
+        return;
+
+    source->Close();
+    m_source = source;
+}
+
+
+void XLIFFCatalog::WriteInPlace(std::ostream& out, bool takeChanges, SourceLayout& layout)
+{
+    auto& src = *m_source;
+    const char *data = src.file->data();
+    size_t written = 0;
+
+    auto write = [&](const char *s, size_t len)
+    {
+        out.write(s, len);
+        written += len;
+    };
+
+    // language is stored in the DOM, in the corresponding elements:
+    std::vector<xml_node> languageNodes;
+    if (m_languageChanged)
+    {
+        for (auto x: m_doc.select_nodes("//xliff | //file"))
+            languageNodes.push_back(x.node());
+        if (languageNodes.size() != src.languageTags.size())
+            languageNodes.clear();  // shouldn't happen, but better safe than sorry
+    }
+
+    size_t pos = 0;
+    size_t nextTag = 0;
+    auto copy_until = [&](size_t until)
+    {
+        for (; nextTag < src.languageTags.size() && src.languageTags[nextTag].first < until; ++nextTag)
+        {
+            auto tag = src.languageTags[nextTag];
+            write(data + pos, tag.first - pos);
+            const size_t begin = written;
+            if (languageNodes.empty())
+            {
+                write(data + tag.first, tag.second - tag.first);
+            }
+            else
+            {
+                auto markup = get_start_tag_markup(languageNodes[nextTag], data[tag.second - 2] == '/');
+                write(markup.data(), markup.size());
+            }
+            layout.languageTags.emplace_back(begin, written);
+            pos = tag.second;
+        }
+        write(data + pos, until - pos);
+        pos = until;
+    };
+
+    xml_document doc;
+    std::vector<xml_node> nodes;
+    layout.units.reserve(src.units.size());
+
+    for (size_t i = 0; i < src.units.size(); i++)
+    {
+        auto u = src.units[i];
+        copy_until(u.markup.first);
+
+        bool changed = false;
+        for (unsigned k = 0; k < u.itemCount; k++)
+        {
+            auto& item = static_cast<XLIFFCatalogItem&>(*m_items[u.firstItem + k]);
+            changed |= takeChanges ? item.m_documentDirty.exchange(false) : item.m_documentDirty.load();
+        }
+
+        const size_t begin = written;
+        if (changed)
+        {
+            xml_node unit;
+            if (m_streamed)
+            {
+                unit = src.ParseUnit(u, doc);
+                nodes.clear();
+                CollectItemNodes(unit, nodes);
+                wxASSERT( nodes.size() == u.itemCount );
+                for (unsigned k = 0; k < u.itemCount && k < nodes.size(); k++)
+                    static_cast<XLIFFCatalogItem&>(*m_items[u.firstItem + k]).WriteToDocument(nodes[k]);
+            }
+            else
+            {
+                unit = u.node;
+                for (unsigned k = 0; k < u.itemCount; k++)
+                {
+                    auto& item = static_cast<XLIFFCatalogItem&>(*m_items[u.firstItem + k]);
+                    item.WriteToDocument(item.m_node);
+                }
+            }
+
+            std::ostringstream s;
+            unit.print(s, "\t", format_raw);
+            auto markup = s.str();
+            write(markup.data(), markup.size());
+            layout.changedUnits.push_back(i);
+        }
+        else
+        {
+            write(data + u.markup.first, u.markup.second - u.markup.first);
+        }
+        pos = u.markup.second;
+
+        u.markup = {begin, written};
+        layout.units.push_back(u);
+    }
+
+    copy_until(src.file->size());
+}
+
+
+bool XLIFFCatalog::SaveInPlace(const wxString& filename)
+{
+    TempOutputFileFor tempfile(filename);
+    SourceLayout layout;
+    bool ok;
+    {
+        std::ofstream f(tempfile.FileName().fn_str(), std::ios::binary);
+        WriteInPlace(f, /*takeChanges=*/true, layout);
+        f.close();
+        ok = !f.fail();
+    }
+
+    // memory-mapped files can't be replaced on Windows, release the mapping first:
+    m_source->Close();
+    if (ok)
+        ok = tempfile.Commit();
+
+    if (!ok)
+    {
+        // the changes weren't saved, keep them for the next attempt:
+        for (auto i: layout.changedUnits)
+        {
+            auto& u = m_source->units[i];
+            for (unsigned k = 0; k < u.itemCount; k++)
+                static_cast<XLIFFCatalogItem&>(*m_items[u.firstItem + k]).m_documentDirty = true;
+        }
+        return false;
+    }
+
+    // the offsets in layout are valid for the new file; if it can't be
+    // opened for some reason, the next save will fail in Reopen():
+    auto saved = std::make_shared<SourceIndex>();
+    saved->Open(filename);
+    saved->Close();
+    saved->units = std::move(layout.units);
+    saved->wrappers = std::move(m_source->wrappers);
+    saved->languageTags = std::move(layout.languageTags);
+    m_source = saved;
+    return true;
+}
+
+
 std::shared_ptr<XLIFFCatalog> XLIFFCatalog::OpenImpl(const wxString& filename, InstanceCreatorImpl& creator)
 {
+    if (!IsGzipFileName(filename) && wxFileName::GetSize(filename).GetValue() >= (wxULongLong_t)STREAMING_MODE_THRESHOLD)
+    {
+        if (auto cat = OpenStreamedImpl(filename, creator))
+            return cat;
+    }
+
     xml_document doc;
-    auto result = doc.load_file(filename.fn_str(), PUGI_PARSE_FLAGS);
+    auto result = load_file_decompressing(doc, filename);
     if (!result)
         BOOST_THROW_EXCEPTION(XLIFFReadException(result.description()));
 
@@ -450,6 +1174,7 @@ std::shared_ptr<XLIFFCatalog> XLIFFCatalog::OpenImpl(const wxString& filename, I
         BOOST_THROW_EXCEPTION(XLIFFReadException(wxString::Format(_("unsupported version (%s)"), xliff_version)));
 
     cat->Parse(xliff_root);
+    cat->IndexSource(filename);
 
     return cat;
 }
@@ -483,6 +1208,7 @@ bool XLIFFCatalog::Save(const wxString& filename, bool /*save_mo*/,
                         ValidationResults& validation_results,
                         CompilationStatus& /*mo_compilation_status*/)
 {
+    TRACE_SPAN("catalog", "Save");
     if ( wxFileExists(filename) && !wxFile::Access(filename, wxFile::write) )
     {
         wxLogError(_(L"File “%s” is read-only and cannot be saved.\nPlease save it under different name."),
@@ -490,14 +1216,40 @@ bool XLIFFCatalog::Save(const wxString& filename, bool /*save_mo*/,
         return false;
     }
 
-    TempOutputFileFor tempfile(filename);
+    {
+        std::lock_guard<std::mutex> lock(m_documentMutex);
+
+        // Only write changed units if possible, copying the rest from the
+        // original file. This is not only faster, but also preserves the
+        // file's formatting as much as possible.
+        if (m_source && !IsGzipFileName(filename) && m_source->Reopen())
+        {
+            if (!SaveInPlace(filename))
+            {
+                wxLogError(_(L"Couldn’t save file %s."), filename.c_str());
+                return false;
+            }
+        }
+        else if (m_streamed)
+        {
+            wxLogError(_(L"File “%s” was modified by another application and cannot be saved."), m_source->filename.c_str());
+            return false;
+        }
+        else
+        {
+            TempOutputFileFor tempfile(filename);
 
-    m_doc.save_file(tempfile.FileName().fn_str(), "\t", format_raw);
+            SyncDocument();
+            m_doc.save_file(tempfile.FileName().fn_str(), "\t", format_raw);
 
-    if ( !tempfile.Commit() )
-    {
-        wxLogError(_(L"Couldn’t save file %s."), filename.c_str());
-        return false;
+            if ( (IsGzipFileName(filename) && !tempfile.CompressWithGzip()) || !tempfile.Commit() )
+            {
+                wxLogError(_(L"Couldn’t save file %s."), filename.c_str());
+                return false;
+            }
+
+            IndexSource(filename);
+        }
     }
 
     validation_results = Validate();
@@ -509,9 +1261,43 @@ bool XLIFFCatalog::Save(const wxString& filename, bool /*save_mo*/,
 
 std::string XLIFFCatalog::SaveToBuffer()
 {
-    std::ostringstream s;
+    TRACE_SPAN("catalog", "SaveToBuffer");
+    std::lock_guard<std::mutex> lock(m_documentMutex);
+
+    StringOutputStream s;
+    if (m_source && m_source->Reopen())
+    {
+        SourceLayout unused;
+        WriteInPlace(s, /*takeChanges=*/false, unused);
+        m_source->Close();
+        return s.TakeString();
+    }
+    else if (m_streamed)
+    {
+        BOOST_THROW_EXCEPTION(XLIFFException(wxString::Format(_(L"File “%s” was modified by another application and cannot be saved."), m_source->filename)));
+    }
+
+    SyncDocument();
     m_doc.save(s, "\t", format_raw);
-    return s.str();
+    return s.TakeString();
+}
+
+
+void XLIFFCatalog::AddFormatMemoryUsage(CatalogMemoryUsage& usage) const
+{
+    std::lock_guard<std::mutex> lock(m_documentMutex);
+
+    // in streaming mode, this is only the document without units:
+    usage.document += estimate_memory_usage(m_doc);
+
+    if (m_source)
+    {
+        usage.document += m_source->units.capacity() * sizeof(SourceIndex::Unit) +
+                          m_source->wrappers.capacity() * sizeof(SourceIndex::Wrapper) +
+                          m_source->languageTags.capacity() * sizeof(SourceIndex::Span);
+        for (auto& w: m_source->wrappers)
+            usage.document += w.open.capacity() + w.close.capacity();
+    }
 }
 
 
@@ -570,7 +1356,12 @@ public:
             m_translations.push_back("");
         }
 
-        for (auto note: node.children("note"))
+        m_hasLazyMetadata = true;
+    }
+
+    void LoadNotes() override
+    {
+        for (auto note: m_node.children("note"))
         {
             std::string noteText = note.text().get();
             if (noteText == "No comment provided by engineer.")  // Xcode does that
@@ -582,34 +1373,28 @@ public:
         }
     }
 
-    void UpdateInternalRepresentation() override
+    void WriteToDocument(xml_node node) override
     {
         wxASSERT( m_translations.size() == 1 ); // no plurals
 
-        // modifications in the pugixml tree can affect other nodes, we must lock the entire document
-        document_lock lock(this);
-
-        auto target = m_node.child("target");
+        auto target = node.child("target");
         if (!target)
         {
-            auto ws_after = m_node.first_child();
-            auto prev = m_node.child("seg-source");
+            auto ws_after = node.first_child();
+            auto prev = node.child("seg-source");
             if (!prev)
-                prev = m_node.child("source");
-            target = m_node.insert_child_after("target", prev);
+                prev = node.child("source");
+            target = node.insert_child_after("target", prev);
             // indent the <target> tag in the same way <source> is indented under its parent:
             if (ws_after.type() == node_pcdata)
-                m_node.insert_child_after(node_pcdata, prev).text() = ws_after.text().get();
+                node.insert_child_after(node_pcdata, prev).text() = ws_after.text().get();
         }
 
         auto trans = GetTranslation();
         if (!trans.empty())
         {
-            if (!set_node_text_with_metadata(target, str::to_utf8(trans), m_metadata))
-            {
-                // TRANSLATORS: Shown as error if a translation of XLIFF markup is not valid XML
-                SetIssue(Issue::Error, _("Broken markup in translation string."));
-            }
+            // broken markup was already reported by UpdateInternalRepresentation()
+            set_node_text_with_metadata(target, str::to_utf8(trans), m_metadata);
         }
         else // no translation
         {
@@ -635,6 +1420,9 @@ public:
 
     wxArrayString GetReferences() const override
     {
+        if (!m_node)
+            return m_references;
+
         wxArrayString refs;
         for (auto loc: m_node.select_nodes(".//context-group[@purpose='location']"))
         {
@@ -672,7 +1460,7 @@ public:
 
 void XLIFF1Catalog::Parse(pugi::xml_node root)
 {
-    int id = 0;
+    std::vector<xml_node> nodes;
     bool extractedLanguage = false;
 
     for (auto file: root.children("file"))
@@ -688,17 +1476,26 @@ void XLIFF1Catalog::Parse(pugi::xml_node root)
         }
 
         for (auto unit: file.select_nodes(".//trans-unit"))
-        {
-            auto node = unit.node();
-            if (strcmp(node.attribute("translate").value(), "no") == 0)
-                continue;
-
-            if (m_subversion == 0)
-                m_items.push_back(std::make_shared<XLIFF10CatalogItem>(*this, ++id, node));
-            else
-                m_items.push_back(std::make_shared<XLIFF12CatalogItem>(*this, ++id, node));
-        }
+            CollectItemNodes(unit.node(), nodes);
     }
+
+    CreateItems(nodes.size(), [this,&nodes](size_t i){ return CreateItem(int(i + 1), nodes[i]); });
+}
+
+
+void XLIFF1Catalog::CollectItemNodes(pugi::xml_node unit, std::vector<pugi::xml_node>& out) const
+{
+    if (strcmp(unit.name(), "trans-unit") == 0 && strcmp(unit.attribute("translate").value(), "no") != 0)
+        out.push_back(unit);
+}
+
+
+std::shared_ptr<XLIFFCatalogItem> XLIFF1Catalog::CreateItem(int id, pugi::xml_node node)
+{
+    if (m_subversion == 0)
+        return MakeItem<XLIFF10CatalogItem>(*this, id, node);
+    else
+        return MakeItem<XLIFF12CatalogItem>(*this, id, node);
 }
 
 
@@ -755,6 +1552,11 @@ public:
         std::string substate = node.attribute("subState").value();
         m_isFuzzy = (m_isTranslated && state == "initial") || (substate == "poedit:fuzzy");
 
+        m_hasLazyMetadata = true;
+    }
+
+    void LoadNotes() override
+    {
         for (auto note: unit().select_nodes(".//note[not(@category='location')]"))
         {
             std::string noteText = note.node().text().get();
@@ -765,43 +1567,37 @@ public:
         }
     }
 
-    void UpdateInternalRepresentation() override
+    void WriteToDocument(xml_node node) override
     {
         wxASSERT( m_translations.size() == 1 ); // no plurals
 
-        // modifications in the pugixml tree can affect other nodes, we must lock the entire document
-        document_lock lock(this);
-
-        auto target = m_node.child("target");
+        auto target = node.child("target");
         if (!target)
         {
-            auto ws_after = m_node.first_child();
-            auto source = m_node.child("source");
-            target = m_node.insert_child_after("target", source);
+            auto ws_after = node.first_child();
+            auto source = node.child("source");
+            target = node.insert_child_after("target", source);
             // indent the <target> tag in the same way <source> is indented under its parent:
             if (ws_after.type() == node_pcdata)
-                m_node.insert_child_after(node_pcdata, source).text() = ws_after.text().get();
+                node.insert_child_after(node_pcdata, source).text() = ws_after.text().get();
         }
 
         auto trans = GetTranslation();
         if (!trans.empty())
         {
-            attribute(m_node, "state") = "translated";
+            attribute(node, "state") = "translated";
             if (m_isFuzzy)
-                attribute(m_node, "subState") = "poedit:fuzzy";
+                attribute(node, "subState") = "poedit:fuzzy";
             else
-                m_node.remove_attribute("subState");
+                node.remove_attribute("subState");
 
-            if (!set_node_text_with_metadata(target, str::to_utf8(trans), m_metadata))
-            {
-                // TRANSLATORS: Shown as error if a translation of XLIFF markup is not valid XML
-                SetIssue(Issue::Error, _("Broken markup in translation string."));
-            }
+            // broken markup was already reported by UpdateInternalRepresentation()
+            set_node_text_with_metadata(target, str::to_utf8(trans), m_metadata);
         }
         else // no translation
         {
-            m_node.remove_attribute("state");
-            m_node.remove_attribute("subState");
+            node.remove_attribute("state");
+            node.remove_attribute("subState");
             remove_all_children(target);
             // Ensure the node is shown as <target></target> rather than <target/>.
             // The spec is unclear in this regard and the former is more expected.
@@ -811,6 +1607,9 @@ public:
 
     wxArrayString GetReferences() const override
     {
+        if (!m_node)
+            return m_references;
+
         wxArrayString refs;
         for (auto note: unit().select_nodes(".//note[@category='location']"))
         {
@@ -830,15 +1629,33 @@ void XLIFF2Catalog::Parse(pugi::xml_node root)
     m_sourceLanguage = Language::FromLanguageTag(root.attribute("srcLang").value());
     m_language = Language::FromLanguageTag(root.attribute("trgLang").value());
 
-    int id = 0;
+    std::vector<xml_node> nodes;
     for (auto segment: root.select_nodes(".//segment"))
     {
         auto node = segment.node();
         if (strcmp(node.parent().attribute("translate").value(), "no") == 0)
             continue;
 
-        m_items.push_back(std::make_shared<XLIFF2CatalogItem>(*this, ++id, node));
+        nodes.push_back(node);
     }
+
+    CreateItems(nodes.size(), [this,&nodes](size_t i){ return CreateItem(int(i + 1), nodes[i]); });
+}
+
+
+void XLIFF2Catalog::CollectItemNodes(pugi::xml_node unit, std::vector<pugi::xml_node>& out) const
+{
+    if (strcmp(unit.name(), "unit") != 0 || strcmp(unit.attribute("translate").value(), "no") == 0)
+        return;
+
+    for (auto segment: unit.select_nodes(".//segment"))
+        out.push_back(segment.node());
+}
+
+
+std::shared_ptr<XLIFFCatalogItem> XLIFF2Catalog::CreateItem(int id, pugi::xml_node node)
+{
+    return MakeItem<XLIFF2CatalogItem>(*this, id, node);
 }
 
 
@@ -31,7 +31,10 @@
 
 #include "pugixml.h"
 
+#include <atomic>
+#include <memory>
 #include <mutex>
+#include <ostream>
 #include <vector>
 
 
@@ -81,16 +84,31 @@ public:
     wxString GetRawSymbolicId() const override { return m_symbolicId; }
 
 protected:
-    struct document_lock : public std::lock_guard<std::mutex>
-    {
-        document_lock(XLIFFCatalogItem *parent);
-    };
+    /// Only marks the item for writing by XLIFFCatalog::SyncDocument()
+    void UpdateInternalRepresentation() override;
+
+    /// Writes item's content into @a node of the DOM; only called by XLIFFCatalog
+    virtual void WriteToDocument(pugi::xml_node node) = 0;
+
+    /// Forget the node, which is about to be destroyed (used in streaming mode)
+    void DetachFromDocument();
+
+    /// Notes are only extracted from the DOM when first needed, see LoadNotes()
+    void LoadLazyMetadata() override;
+
+    /// Extracts notes into m_extractedComments; called with m_node valid
+    virtual void LoadNotes() = 0;
 
 protected:
     XLIFFCatalog& m_owner;
     pugi::xml_node m_node;
     XLIFFStringMetadata m_metadata;
     wxString m_symbolicId;
+    wxArrayString m_references;  // only used by detached items
+
+    std::atomic<bool> m_documentDirty{false};
+
+    friend class XLIFFCatalog;
 };
 
 
@@ -99,6 +117,9 @@ class XLIFFCatalog : public Catalog
 public:
     ~XLIFFCatalog() {}
 
+    /// Files larger than this are opened in streaming mode, see OpenStreamedImpl()
+    static constexpr wxFileOffset STREAMING_MODE_THRESHOLD = 64 * 1024 * 1024;
+
     bool HasCapability(Cap cap) const override;
 
     static bool CanLoadFile(const wxString& extension);
@@ -112,8 +133,10 @@ public:
 
     std::string SaveToBuffer() override;
 
+    void AddFormatMemoryUsage(CatalogMemoryUsage& usage) const override;
+
     Language GetLanguage() const override { return m_language; }
-    void SetLanguage(Language lang) override { m_language = lang; }
+    void SetLanguage(Language lang) override { m_language = lang; m_languageChanged = true; }
 
     pugi::xml_node GetXMLRoot() const { return m_doc.child("xliff"); }
     std::string GetXPathValue(const char* xpath) const;
@@ -130,12 +153,55 @@ protected:
 
     static std::shared_ptr<XLIFFCatalog> OpenImpl(const wxString& filename, InstanceCreatorImpl& creator);
 
+    /**
+        Opens the file without building DOM for the entire document.
+
+        The file is memory-mapped and scanned for translation units, which are
+        parsed one at a time; only the rest of the document is kept as DOM.
+        When saving, the file is copied verbatim except for units with modified
+        items. Returns nullptr if the file can't be loaded this way.
+     */
+    static std::shared_ptr<XLIFFCatalog> OpenStreamedImpl(const wxString& filename, InstanceCreatorImpl& creator);
+
     virtual void Parse(pugi::xml_node root) = 0;
 
+    /// Appends nodes of catalog items contained in translation @a unit to @a out
+    virtual void CollectItemNodes(pugi::xml_node unit, std::vector<pugi::xml_node>& out) const = 0;
+    /// Creates catalog item for a node found by CollectItemNodes()
+    virtual std::shared_ptr<XLIFFCatalogItem> CreateItem(int id, pugi::xml_node node) = 0;
+
+    /**
+        Writes changed items into the DOM.
+
+        Items don't modify the shared pugixml tree themselves, because that
+        would require serializing all changes to the catalog; instead, the
+        changes are synced in one batch before the document is saved.
+        Must be called with m_documentMutex locked.
+     */
+    void SyncDocument();
+
+    // index of units in the source file, for streaming mode and in-place saving:
+    struct SourceIndex;
+    struct SourceLayout;
+    void ParseStreamedUnits();
+    void IndexSource(const wxString& filename);
+
+    /// Writes the file by copying the source and re-serializing changed units only.
+    /// Must be called with m_documentMutex locked, as must SaveInPlace().
+    void WriteInPlace(std::ostream& out, bool takeChanges, SourceLayout& layout);
+    bool SaveInPlace(const wxString& filename);
+
 protected:
-    std::mutex m_documentMutex;
+    mutable std::mutex m_documentMutex;
+    std::atomic<bool> m_documentDirty{false};
     pugi::xml_document m_doc;
     Language m_language;
+    bool m_languageChanged = false;
+
+    // not set if the file couldn't be indexed
+    std::shared_ptr<SourceIndex> m_source;
+    // in streaming mode, m_doc only has the document without units
+    bool m_streamed = false;
 
     friend class XLIFFCatalogItem;
 };
@@ -153,6 +219,8 @@ public:
 
 protected:
     void Parse(pugi::xml_node root) override;
+    void CollectItemNodes(pugi::xml_node unit, std::vector<pugi::xml_node>& out) const override;
+    std::shared_ptr<XLIFFCatalogItem> CreateItem(int id, pugi::xml_node node) override;
 
     int m_subversion;
 };
@@ -167,6 +235,8 @@ public:
 
 protected:
     void Parse(pugi::xml_node root) override;
+    void CollectItemNodes(pugi::xml_node unit, std::vector<pugi::xml_node>& out) const override;
+    std::shared_ptr<XLIFFCatalogItem> CreateItem(int id, pugi::xml_node node) override;
 };
 
 #endif // Poedit_catalog_xliff_h
@@ -27,8 +27,92 @@
 
 #ifdef HAVE_HTTP_CLIENT
 
+#include "catalog.h"
 #include "crowdin_client.h"
+#include "edapp.h"
+#include "errors.h"
+#include "json.h"
 #include "localazy_client.h"
+#include "utility.h"
+
+#include <fstream>
+#include <map>
+#include <unordered_map>
+
+#include <wx/filename.h>
+#include <wx/log.h>
+
+
+namespace
+{
+
+// If more items than this changed, the whole file is uploaded, because
+// uploading them individually would be slower
+const size_t MAX_CHANGED_ITEMS_FOR_DELTA = 100;
+
+// Version of the sync state file format, increment when changing it
+const int SYNC_STATE_VERSION = 1;
+
+// Synced state of a file: hash of item's identity -> hash of its translation
+typedef std::map<uint64_t, uint64_t> SyncState;
+
+uint64_t HashString(const wxString& s, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    const auto utf8 = s.utf8_str();
+    hash = HashFNV1a(utf8.data(), utf8.length(), hash);
+    // include the terminator so that different splits of the same text differ:
+    return HashFNV1a("", 1, hash);
+}
+
+uint64_t HashItemKey(const CatalogItem& item)
+{
+    auto hash = HashString(item.HasContext() ? "\x01" + item.GetContext() : wxString());
+    hash = HashString(item.GetRawString(), hash);
+    return HashString(item.GetRawPluralString(), hash);
+}
+
+uint64_t HashItemValue(const CatalogItem& item)
+{
+    auto hash = HashString(item.IsFuzzy() ? "fuzzy" : "");
+    for (auto& t: item.GetTranslations())
+        hash = HashString(t, hash);
+    return hash;
+}
+
+wxString GetSyncStateFile(const CloudAccountClient::FileSyncMetadata& meta)
+{
+    return PoeditApp::GetCacheDir(wxString::FromUTF8(meta.service)) + "/sync-" + wxString::FromUTF8(meta.SyncStateKey()) + ".json";
+}
+
+bool LoadSyncState(const CloudAccountClient::FileSyncMetadata& meta, SyncState& state)
+{
+    if (meta.SyncStateKey().empty())
+        return false;
+
+    try
+    {
+        const auto filename = GetSyncStateFile(meta);
+        if (!wxFileName::FileExists(filename))
+            return false;
+
+        std::ifstream f(filename.fn_str());
+        auto data = json::parse(f);
+        if (get_value(data, "version", 0) != SYNC_STATE_VERSION)
+            return false;
+
+        for (auto& i: data.at("items"))
+            state.emplace(i.at(0).get<uint64_t>(), i.at(1).get<uint64_t>());
+        return true;
+    }
+    catch (...)
+    {
+        // corrupted state only means the whole file will be uploaded
+        wxLogTrace("poedit.cloud", "Failed to load sync state: %s", DescribeCurrentException());
+        return false;
+    }
+}
+
+} // anonymous namespace
 
 
 CloudAccountClient& CloudAccountClient::Get(const std::string& service_name)
@@ -62,4 +146,138 @@ std::shared_ptr<CloudAccountClient::FileSyncMetadata> CloudAccountClient::Extrac
 }
 
 
+dispatch::future<CatalogPtr> CloudAccountClient::DownloadCatalog(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta)
+{
+    return DownloadFile(output_file, meta)
+           .then([output_file]
+           {
+               return Catalog::Create(output_file);
+           });
+}
+
+
+void CloudAccountClient::RememberSyncedState(const Catalog& catalog, const FileSyncMetadata& meta)
+{
+    if (meta.SyncStateKey().empty())
+        return;
+
+    try
+    {
+        json data;
+        data["version"] = SYNC_STATE_VERSION;
+        auto& out = data["items"] = json::array();
+        for (auto& item: catalog.items())
+            out.push_back({HashItemKey(*item), HashItemValue(*item)});
+
+        const auto filename = GetSyncStateFile(meta);
+        wxFileName::Mkdir(wxFileName(filename).GetPath(), wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
+
+        TempOutputFileFor temp(filename);
+        {
+            std::ofstream f(temp.FileName().fn_str(), std::ios::binary | std::ios::trunc);
+            f << data.dump();
+        }
+        temp.Commit();
+    }
+    catch (...)
+    {
+        wxLogTrace("poedit.cloud", "Failed to save sync state: %s", DescribeCurrentException());
+    }
+}
+
+
+bool CloudAccountClient::MergeRemoteChanges(Catalog& catalog, const Catalog& remote, const FileSyncMetadata& meta,
+                                            std::vector<CatalogItemPtr>& updated, int& conflicts)
+{
+    updated.clear();
+    conflicts = 0;
+
+    SyncState previous;
+    if (!LoadSyncState(meta, previous))
+        return false;
+
+    std::unordered_map<uint64_t, CatalogItemPtr> remoteItems;
+    for (auto& item: remote.items())
+        remoteItems.emplace(HashItemKey(*item), item);
+
+    for (auto& item: catalog.items())
+    {
+        const auto key = HashItemKey(*item);
+        auto r = remoteItems.find(key);
+        auto p = previous.find(key);
+        if (r == remoteItems.end() || p == previous.end())
+            continue;
+
+        const auto remoteValue = HashItemValue(*r->second);
+        if (remoteValue == p->second)
+            continue; // not changed remotely
+
+        const auto localValue = HashItemValue(*item);
+        if (localValue == remoteValue)
+            continue; // same change made on both sides
+
+        if (localValue != p->second)
+        {
+            // changed differently on both sides, keep the local edit
+            conflicts++;
+            continue;
+        }
+
+        item->SetTranslations(r->second->GetTranslations());
+        item->SetFuzzy(r->second->IsFuzzy());
+        updated.push_back(item);
+    }
+
+    RememberSyncedState(remote, meta);
+    return true;
+}
+
+
+dispatch::future<void> CloudAccountClient::UploadChanges(CatalogPtr catalog, std::shared_ptr<FileSyncMetadata> meta)
+{
+    auto upload_all = [=]
+    {
+        return UploadFile(catalog->SaveToBuffer(), meta)
+               .then([=]{ RememberSyncedState(*catalog, *meta); });
+    };
+
+    SyncState previous;
+    if (!LoadSyncState(*meta, previous))
+        return upload_all();
+
+    std::vector<CatalogItemPtr> changed;
+    for (auto& item: catalog->items())
+    {
+        auto i = previous.find(HashItemKey(*item));
+        if (i == previous.end())
+            return upload_all(); // new string, e.g. after updating from sources
+        if (i->second != HashItemValue(*item))
+        {
+            changed.push_back(item);
+            if (changed.size() > MAX_CHANGED_ITEMS_FOR_DELTA)
+                return upload_all();
+        }
+    }
+
+    wxLogTrace("poedit.cloud", "%d items changed since last sync", (int)changed.size());
+    if (changed.empty())
+        return dispatch::make_ready_future();
+
+    return UploadChangedItems(catalog, meta, changed)
+        .then([=](bool uploaded) -> dispatch::future<void>
+        {
+            if (!uploaded)
+                return upload_all();
+            RememberSyncedState(*catalog, *meta);
+            return dispatch::make_ready_future();
+        });
+}
+
+
+dispatch::future<bool> CloudAccountClient::UploadChangedItems(CatalogPtr, std::shared_ptr<FileSyncMetadata>, std::vector<CatalogItemPtr>)
+{
+    return dispatch::make_ready_future(false);
+}
+
+
 #endif // #ifdef HAVE_HTTP_CLIENT
@@ -34,8 +34,10 @@
 #include <memory>
 #include <string>
 #include <variant>
+#include <vector>
 
 class Catalog;
+class CatalogItem;
 
 
 /**
@@ -135,6 +137,10 @@ public:
 
         /// Service (Crowdin etc.) the account is for
         std::string service;
+
+        /// Identifies the remote file and language for remembering its last
+        /// synced state. Empty if changes can't be uploaded separately.
+        virtual std::string SyncStateKey() const { return std::string(); }
     };
 
     /// Create filename on local filesystem suitable for the remote file
@@ -156,15 +162,65 @@ public:
     /// Asynchronously download specific file into @a output_file, using data from ExtractSyncMetadata().
     virtual dispatch::future<void> DownloadFile(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta) = 0;
 
+    /**
+        Asynchronously download file into @a output_file and load it.
+
+        The catalog is parsed on a background thread right after downloading
+        and is ready for use when the returned future is fulfilled. The
+        default implementation loads the file written by DownloadFile().
+     */
+    virtual dispatch::future<std::shared_ptr<Catalog>> DownloadCatalog(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta);
+
     /**
         Asynchronously upload a file.
 
         The file is stored in a memory buffer and the destination information is provided by ExtractSyncMetadata().
+        The buffer is taken over and sent without copying it.
      */
-    virtual dispatch::future<void> UploadFile(const std::string& file_buffer, std::shared_ptr<FileSyncMetadata> meta) = 0;
+    virtual dispatch::future<void> UploadFile(std::string file_buffer, std::shared_ptr<FileSyncMetadata> meta) = 0;
+
+    /**
+        Asynchronously upload translations changed since the last sync.
+
+        Only the items that changed since the last successful sync of the file
+        are uploaded, with UploadChangedItems(). Falls back to uploading the whole
+        file with UploadFile() if there's no record of the previous sync, if
+        too many items changed or if the service can't upload them separately.
+     */
+    dispatch::future<void> UploadChanges(std::shared_ptr<Catalog> catalog, std::shared_ptr<FileSyncMetadata> meta);
+
+    /// Remember @a catalog's content as the last synced state, e.g. after downloading it.
+    static void RememberSyncedState(const Catalog& catalog, const FileSyncMetadata& meta);
+
+    /**
+        Merges translations changed remotely since the last sync into @a catalog.
+
+        The last synced state is used to tell which side changed each item.
+        Items changed only in @a remote are updated and returned in @a updated.
+        Items changed only locally are kept, to be uploaded by UploadChanges().
+        If both sides changed an item differently, the local edit is kept too
+        and the item is counted in @a conflicts. Only translations are merged;
+        items present on one side only are left alone.
+
+        Returns false, without modifying anything, if there's no record of
+        the last sync. Otherwise @a remote becomes the new last synced state.
+     */
+    static bool MergeRemoteChanges(Catalog& catalog, const Catalog& remote, const FileSyncMetadata& meta,
+                                   std::vector<std::shared_ptr<CatalogItem>>& updated, int& conflicts);
 
 protected:
     CloudAccountClient() {}
+
+    /**
+        Asynchronously upload translations of changed @a items only.
+
+        Returned future's value is false if it wasn't possible to upload the
+        items individually, and nothing was uploaded; the whole file is uploaded
+        instead in that case. The default implementation always returns false.
+     */
+    virtual dispatch::future<bool> UploadChangedItems(std::shared_ptr<Catalog> catalog,
+                                                      std::shared_ptr<FileSyncMetadata> meta,
+                                                      std::vector<std::shared_ptr<CatalogItem>> items);
 };
 
 #endif // !HAVE_HTTP_CLIENT
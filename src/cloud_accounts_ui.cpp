@@ -699,7 +699,7 @@ public:
 
     dispatch::future<void> Upload(CatalogPtr file) override
     {
-        return m_account.UploadFile(file->SaveToBuffer(), m_meta);
+        return m_account.UploadChanges(file, m_meta);
     }
 
 protected:
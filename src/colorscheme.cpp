@@ -199,6 +199,13 @@ wxColour ColorScheme::DoGet(Color color, Mode mode)
         case Color::SyntaxFormat:
             return mode == Dark ? sRGB(250, 165, 251) : sRGB(178, 52, 197);
 
+        // Text differences:
+
+        case Color::DiffDeletedBg:
+            return mode == Dark ? sRGB(120, 40, 44) : sRGB(255, 215, 213);
+        case Color::DiffInsertedBg:
+            return mode == Dark ? sRGB(30, 95, 48) : sRGB(204, 240, 208);
+
         // Attention bar:
 
 #ifdef __WXGTK__
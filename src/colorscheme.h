@@ -76,6 +76,9 @@ enum class Color : size_t
     SyntaxMarkup,
     SyntaxFormat,
 
+    DiffDeletedBg,
+    DiffInsertedBg,
+
     AttentionWarningBackground,
     AttentionQuestionBackground,
     AttentionErrorBackground,
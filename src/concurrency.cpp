@@ -28,6 +28,9 @@
 #include "errors.h"
 #include <wx/log.h>
 
+#include <deque>
+#include <vector>
+
 // All this is for rethrow_for_boost:
 #if defined(HAVE_HTTP_CLIENT)
   #include "http_client.h"
@@ -91,9 +94,23 @@ exception_ptr dispatch::current_exception()
 
 #include <dispatch/dispatch.h>
 
-void detail::dispatch_async_cxx(boost::executors::work&& f)
+void detail::dispatch_async_cxx(boost::executors::work&& f, priority prio)
 {
-    dispatch_queue_t dq = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    long queuePriority;
+    switch (prio)
+    {
+        case priority::interactive:
+            queuePriority = DISPATCH_QUEUE_PRIORITY_HIGH;
+            break;
+        case priority::normal:
+            queuePriority = DISPATCH_QUEUE_PRIORITY_DEFAULT;
+            break;
+        case priority::bulk:
+            queuePriority = DISPATCH_QUEUE_PRIORITY_LOW;
+            break;
+    }
+
+    dispatch_queue_t dq = dispatch_get_global_queue(queuePriority, 0);
     dispatch_async(dq, [f{std::move(f)}]() mutable {
         try
         {
@@ -108,25 +125,185 @@ void detail::dispatch_async_cxx(boost::executors::work&& f)
     });
 }
 
+#elif !defined(USE_PPL_DISPATCH)
+
+namespace
+{
+
+/**
+    Thread pool with work-stealing and priority classes.
+
+    Every worker thread has its own queues (one per priority); tasks submitted
+    from a worker go to its own queue and tasks submitted from other threads go
+    to shared queues. Idle workers take work in this order: the highest
+    priority first, then their own most recently added task, the oldest shared
+    task, and finally the oldest task stolen from another worker's queue.
+ */
+class work_stealing_pool
+{
+public:
+    explicit work_stealing_pool(size_t threads)
+    {
+        for (size_t i = 0; i < threads; i++)
+            m_workers.emplace_back(new worker);
+        for (size_t i = 0; i < threads; i++)
+            std::thread([this, i]{ run(i); }).detach();
+    }
+
+    void submit(boost::executors::work&& f, priority prio)
+    {
+        auto& q = (ms_currentPool == this) ? m_workers[ms_currentWorker]->queues[int(prio)]
+                                           : m_shared[int(prio)];
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(std::move(f));
+        }
+
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_pending++;
+        m_wakeup.notify_one();
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_closed = true;
+        m_wakeup.notify_all();
+    }
+
+private:
+    static const int PRIORITIES = 3;
+
+    struct queue
+    {
+        std::mutex mutex;
+        std::deque<boost::executors::work> tasks;
+
+        bool pop_front(boost::executors::work& out)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty())
+                return false;
+            out = std::move(tasks.front());
+            tasks.pop_front();
+            return true;
+        }
+
+        bool pop_back(boost::executors::work& out)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty())
+                return false;
+            out = std::move(tasks.back());
+            tasks.pop_back();
+            return true;
+        }
+    };
+
+    struct worker
+    {
+        queue queues[PRIORITIES];
+    };
+
+    bool try_take(size_t self, boost::executors::work& out)
+    {
+        const size_t count = m_workers.size();
+        for (int p = 0; p < PRIORITIES; p++)
+        {
+            if (m_workers[self]->queues[p].pop_back(out) || m_shared[p].pop_front(out))
+                return true;
+            for (size_t i = 1; i < count; i++)
+            {
+                if (m_workers[(self + i) % count]->queues[p].pop_front(out))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    void run(size_t self)
+    {
+        ms_currentPool = this;
+        ms_currentWorker = self;
+
+        for (;;)
+        {
+            // Claim one of the pending tasks first. It is guaranteed to be in
+            // some queue, but the search may miss it while other workers are
+            // taking tasks concurrently, so repeat it until found:
+            {
+                std::unique_lock<std::mutex> lock(m_sleepMutex);
+                m_wakeup.wait(lock, [=]{ return m_pending > 0 || m_closed; });
+                if (m_closed)
+                    return;
+                m_pending--;
+            }
+
+            boost::executors::work f;
+            while (!try_take(self, f))
+                std::this_thread::yield();
+
+            try
+            {
+                f();
+            }
+            catch (...)
+            {
+                // FIXME: This is gross. Should be reported better and properly, but this
+                //        is consistent with pplx/ConcurrencyRT/futures, so do it for now.
+                wxLogDebug("uncaught exception: %s", DescribeCurrentException());
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<worker>> m_workers;
+    queue m_shared[PRIORITIES];
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeup;
+    size_t m_pending = 0;
+    bool m_closed = false;
+
+    static thread_local work_stealing_pool *ms_currentPool;
+    static thread_local size_t ms_currentWorker;
+};
+
+thread_local work_stealing_pool *work_stealing_pool::ms_currentPool = nullptr;
+thread_local size_t work_stealing_pool::ms_currentWorker = 0;
+
+std::unique_ptr<work_stealing_pool> gs_work_stealing_pool;
+static std::once_flag gs_work_stealing_pool_flag;
+
+} // anonymous namespace
+
+void detail::work_stealing_submit(boost::executors::work&& f, priority prio)
+{
+    std::call_once(gs_work_stealing_pool_flag, []{
+        gs_work_stealing_pool.reset(new work_stealing_pool(std::max(2u, std::thread::hardware_concurrency())));
+    });
+    gs_work_stealing_pool->submit(std::move(f), prio);
+}
+
 #endif // HAVE_DISPATCH
 
 
 namespace
 {
 
-std::unique_ptr<dispatch::detail::background_queue_executor> gs_background_executor;
+std::unique_ptr<dispatch::detail::background_queue_executor> gs_background_executors[3];
 std::unique_ptr<dispatch::detail::main_thread_executor> gs_main_thread_executor;
 static std::once_flag gs_background_executor_flag, gs_main_thread_executor_flag;
 
 }
 
 dispatch::detail::background_queue_executor&
-dispatch::detail::background_queue_executor::get()
+dispatch::detail::background_queue_executor::get(priority prio)
 {
     std::call_once(gs_background_executor_flag, []{
-        gs_background_executor.reset(new background_queue_executor);
+        for (int i = 0; i < 3; i++)
+            gs_background_executors[i].reset(new background_queue_executor(priority(i)));
     });
-    return *gs_background_executor;
+    return *gs_background_executors[int(prio)];
 }
 
 dispatch::detail::main_thread_executor&
@@ -140,13 +317,21 @@ dispatch::detail::main_thread_executor::get()
 
 void dispatch::cleanup()
 {
-    if (gs_background_executor)
-        gs_background_executor->close();
+    for (auto& e: gs_background_executors)
+    {
+        if (e)
+            e->close();
+    }
     if (gs_main_thread_executor)
         gs_main_thread_executor->close();
 
+#if !defined(HAVE_DISPATCH) && !defined(USE_PPL_DISPATCH)
+    if (gs_work_stealing_pool)
+        gs_work_stealing_pool->close();
+#endif
+
     // Don't destroy executor objects, because some still-in-fly tasks may be
     // referencing them.
     // Ideally, we would like to shut down worker queues, but that's easier said than done
-    // (except boost's basic_thread_pool).
+    // (except for our own thread pool).
 }
@@ -57,10 +57,6 @@
 #include <boost/chrono/duration.hpp>
 #include <boost/throw_exception.hpp>
 
-#if !defined(HAVE_DISPATCH) && !defined(USE_PPL_DISPATCH)
-    #include <boost/thread/executors/basic_thread_pool.hpp>
-#endif
-
 #if defined(HAVE_PPL)
     #if defined(_MSC_VER)
         #include <concrt.h>
@@ -71,14 +67,22 @@
     #endif
 #endif
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 #include <wx/app.h>
 #include <wx/weakref.h>
 
+#include "progress.h"
+
 
 namespace dispatch
 {
@@ -89,6 +93,24 @@ template<typename T>
 class future;
 
 
+/**
+    Priority class of background tasks.
+
+    Queued tasks of a higher priority are started before any queued tasks of
+    lower priorities. Tasks that are already running are not interrupted, so
+    long operations should be split into many smaller tasks.
+ */
+enum class priority
+{
+    /// Tasks the user is waiting for, e.g. suggestions for the current item
+    interactive,
+    /// Default priority
+    normal,
+    /// Long-running processing of many items, e.g. pre-translating whole file
+    bulk
+};
+
+
 // implementation details
 
 namespace detail
@@ -118,20 +140,25 @@ private:
 
 #if defined(HAVE_DISPATCH)
 
-extern void dispatch_async_cxx(boost::executors::work&& f);
+extern void dispatch_async_cxx(boost::executors::work&& f, priority prio);
 
 class background_queue_executor : public custom_executor
 {
 public:
-    static background_queue_executor& get();
+    explicit background_queue_executor(priority prio) : m_priority(prio) {}
+
+    static background_queue_executor& get(priority prio = priority::normal);
 
     void submit(work&& closure) override
     {
         if (closed())
             return;
 
-        dispatch_async_cxx(std::forward<work>(closure));
+        dispatch_async_cxx(std::forward<work>(closure), m_priority);
     }
+
+private:
+    priority m_priority;
 };
 
 #elif defined(USE_PPL_DISPATCH)
@@ -139,31 +166,42 @@ public:
 class background_queue_executor : public custom_executor
 {
 public:
-    static background_queue_executor& get();
+    explicit background_queue_executor(priority) {}
+
+    static background_queue_executor& get(priority prio = priority::normal);
 
     void submit(work&& closure)
     {
         if (closed())
             return;
 
+        // PPL has no per-task priorities; its scheduler is work-stealing already
         pplx::create_task([f{std::move(closure)}]() mutable { f(); });
     }
 };
 
 #else // !HAVE_DISPATCH && !USE_PPL_DISPATCH
 
-class background_queue_executor : public boost::basic_thread_pool
+/// Submits work to the shared work-stealing thread pool, see concurrency.cpp.
+extern void work_stealing_submit(boost::executors::work&& f, priority prio);
+
+class background_queue_executor : public custom_executor
 {
 public:
-    static background_queue_executor& get();
+    explicit background_queue_executor(priority prio) : m_priority(prio) {}
 
-    void submit(work&& closure)
+    static background_queue_executor& get(priority prio = priority::normal);
+
+    void submit(work&& closure) override
     {
         if (closed())
             return;
 
-        boost::basic_thread_pool::submit(std::forward<work>(closure));
+        work_stealing_submit(std::forward<work>(closure), m_priority);
     }
+
+private:
+    priority m_priority;
 };
 
 #endif // HAVE_DISPATCH etc.
@@ -624,11 +662,11 @@ void fulfill_promise_from_future(std::shared_ptr<promise<T>> p, future<T>&& f)
 }
 
 
-/// Enqueue an operation for background processing.
+/// Enqueue an operation for background processing with given priority.
 template<class F>
-inline auto async(F&& f) -> future<typename detail::future_unwrapper<typename std::invoke_result<F>::type>::type>
+inline auto async(priority prio, F&& f) -> future<typename detail::future_unwrapper<typename std::invoke_result<F>::type>::type>
 {
-    return {boost::async(detail::background_queue_executor::get(), [f{std::forward<F>(f)}]() {
+    return {boost::async(detail::background_queue_executor::get(prio), [f{std::forward<F>(f)}]() {
         try
         {
             return detail::call_and_unwrap_if_future(f);
@@ -637,6 +675,109 @@ inline auto async(F&& f) -> future<typename detail::future_unwrapper<typename st
     })};
 }
 
+/// Enqueue an operation for background processing.
+template<class F>
+inline auto async(F&& f) -> future<typename detail::future_unwrapper<typename std::invoke_result<F>::type>::type>
+{
+    return async(priority::normal, std::forward<F>(f));
+}
+
+
+/**
+    Calls \a func(i) for every i in [0, count) concurrently, on background
+    threads as well as on the calling one, and waits until all calls finish.
+
+    The calling thread participates, so that this works even if all background
+    threads are busy (possibly waiting for other such work). \a func must not
+    throw. Background threads' help is requested with priority \a prio.
+ */
+template<typename Func>
+void parallel_for(size_t count, Func&& func, priority prio = priority::normal)
+{
+    // Shared with the background tasks, which may outlive this function call
+    // if they only get to run after all work was already done; func is only
+    // called while there's work left, i.e. during the call:
+    struct State
+    {
+        State(size_t count_, Func& func_) : count(count_), func(func_) {}
+
+        const size_t count;
+        Func& func;
+        std::atomic<size_t> next{0};
+        size_t done = 0;
+        std::mutex mutex;
+        std::condition_variable cv;
+
+        void Run()
+        {
+            for (;;)
+            {
+                const size_t i = next++;
+                if (i >= count)
+                    return;
+
+                func(i);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (++done == count)
+                    cv.notify_all();
+            }
+        }
+    };
+
+    auto state = std::make_shared<State>(count, func);
+
+    const size_t threads = std::min(size_t(std::max(1u, std::thread::hardware_concurrency())), count);
+    for (size_t i = 1; i < threads; i++)
+        dispatch::async(prio, [state]{ state->Run(); });
+    state->Run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&]{ return state->done == count; });
+}
+
+
+/**
+    Sorts [first, last) using \a comp, like std::sort(), but in parallel
+    if the range is large enough for it to be worth it.
+
+    \a comp must be safe to call from multiple threads concurrently.
+ */
+template<typename RandomIt, typename Compare>
+void parallel_sort(RandomIt first, RandomIt last, Compare comp)
+{
+    const size_t PARALLEL_SORT_MIN_SIZE = 10000;
+
+    const size_t count = size_t(last - first);
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if (count < PARALLEL_SORT_MIN_SIZE || threads == 1)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    // Sort equally-sized chunks concurrently, then merge neighbouring chunks
+    // (also concurrently) until there's only one:
+    const size_t chunk = (count + threads - 1) / threads;
+    parallel_for(threads, [&](size_t n)
+    {
+        std::sort(first + std::min(n * chunk, count), first + std::min((n + 1) * chunk, count), comp);
+    });
+
+    for (size_t width = chunk; width < count; width *= 2)
+    {
+        const size_t merges = (count + 2 * width - 1) / (2 * width);
+        parallel_for(merges, [&](size_t n)
+        {
+            const size_t begin = n * 2 * width;
+            const size_t middle = std::min(begin + width, count);
+            const size_t end = std::min(begin + 2 * width, count);
+            if (middle < end)
+                std::inplace_merge(first + begin, first + middle, first + end, comp);
+        });
+    }
+}
+
 
 /// Run an operation on the main thread.
 template<class F>
@@ -692,6 +833,198 @@ private:
 typedef std::shared_ptr<cancellation_token> cancellation_token_ptr;
 
 
+/// Options for the chunked parallel algorithms below
+struct parallel_options
+{
+    /// Number of indices processed by a single task; 0 to choose automatically
+    size_t chunk_size = 0;
+
+    /// Priority of background threads' help
+    priority prio = priority::normal;
+
+    /// If set, remaining chunks are skipped once cancelled and cancellation_exception is thrown
+    cancellation_token_ptr cancellation;
+
+    /// If set, incremented by the number of processed indices after every chunk
+    Progress *progress = nullptr;
+};
+
+namespace detail
+{
+
+/**
+    Calls \a func(n, begin, end) for chunks of [0, count) concurrently, where
+    \a n is the index of the chunk. Exceptions thrown by \a func are rethrown
+    once all chunks are done.
+ */
+template<typename Func>
+void parallel_chunks(size_t count, size_t chunk, const parallel_options& options, Func&& func)
+{
+    const size_t chunks = (count + chunk - 1) / chunk;
+    std::vector<std::exception_ptr> errors(chunks);
+
+    parallel_for(chunks, [&](size_t n)
+    {
+        if (options.cancellation && options.cancellation->is_cancelled())
+            return;
+
+        const size_t begin = n * chunk;
+        const size_t end = std::min(begin + chunk, count);
+        try
+        {
+            func(n, begin, end);
+        }
+        catch (...)
+        {
+            errors[n] = std::current_exception();
+        }
+
+        if (options.progress)
+            options.progress->increment(int(end - begin));
+    }, options.prio);
+
+    for (auto& e: errors)
+    {
+        if (e)
+            std::rethrow_exception(e);
+    }
+
+    if (options.cancellation)
+        options.cancellation->throw_if_cancelled();
+}
+
+inline size_t parallel_chunk_size(size_t count, const parallel_options& options)
+{
+    if (options.chunk_size)
+        return options.chunk_size;
+    // a few chunks per thread to balance uneven work, but not too many to amortize the overhead:
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    return std::max(size_t(1), count / (threads * 8));
+}
+
+} // namespace detail
+
+
+/**
+    Calls \a func(begin, end) for consecutive chunks of [0, count)
+    concurrently and waits until all calls finish.
+
+    Unlike parallel_for(), the cost of scheduling is paid once per chunk rather
+    than per index, \a func may throw (the exception is rethrown once all
+    chunks are done) and cancellation and progress reporting are supported,
+    see parallel_options.
+ */
+template<typename Func>
+void parallel_for_chunked(size_t count, Func&& func, const parallel_options& options = parallel_options())
+{
+    if (count == 0)
+        return;
+
+    detail::parallel_chunks(count, detail::parallel_chunk_size(count, options), options,
+                            [&](size_t, size_t begin, size_t end){ func(begin, end); });
+}
+
+
+/// Calls \a func(item) for every item of random-access \a items (e.g. CatalogItemArray) concurrently, in chunks.
+template<typename Container, typename Func>
+void parallel_for_each(Container& items, Func&& func, const parallel_options& options = parallel_options())
+{
+    parallel_for_chunked(items.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            func(items[i]);
+    }, options);
+}
+
+
+/// Returns vector of \a func(i) for all i in [0, count), computed concurrently in chunks.
+template<typename Func>
+auto parallel_transform(size_t count, Func&& func, const parallel_options& options = parallel_options())
+    -> std::vector<typename std::invoke_result<Func, size_t>::type>
+{
+    std::vector<typename std::invoke_result<Func, size_t>::type> results(count);
+    parallel_for_chunked(count, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            results[i] = func(i);
+    }, options);
+    return results;
+}
+
+
+/**
+    Combines \a map(i) for all i in [0, count) using \a reduce, starting with
+    \a init, concurrently in chunks.
+
+    \a reduce must be associative; chunks' partial results are combined in
+    order, so it doesn't need to be commutative.
+ */
+template<typename T, typename Map, typename Reduce>
+T parallel_reduce(size_t count, T init, Map&& map, Reduce&& reduce, const parallel_options& options = parallel_options())
+{
+    if (count == 0)
+        return init;
+
+    const size_t chunk = detail::parallel_chunk_size(count, options);
+    std::vector<std::optional<T>> partials((count + chunk - 1) / chunk);
+
+    detail::parallel_chunks(count, chunk, options, [&](size_t n, size_t begin, size_t end)
+    {
+        T value = map(begin);
+        for (size_t i = begin + 1; i < end; i++)
+            value = reduce(std::move(value), map(i));
+        partials[n] = std::move(value);
+    });
+
+    for (auto& p: partials)
+        init = reduce(std::move(init), std::move(*p));
+    return init;
+}
+
+
+
+
+
+/**
+    Group of background tasks that can be cancelled together.
+
+    Cancellation is cooperative: tasks aren't removed from the executor's
+    queue. Once the group is cancelled, its tasks that didn't start yet still
+    take their turn in the queue and occupy a worker briefly, but they fail
+    with cancellation_exception without running their code. Tasks that are
+    already running are only signalled through token(), which long-running
+    tasks should check periodically.
+ */
+class task_group
+{
+public:
+    task_group() : m_token(std::make_shared<cancellation_token>()) {}
+
+    /// Creates group cancelled by (possibly shared) existing @a token.
+    explicit task_group(cancellation_token_ptr token) : m_token(std::move(token)) {}
+
+    /// Enqueue an operation for background processing as part of the group.
+    template<class F>
+    auto async(F&& f, priority prio = priority::normal) -> future<typename detail::future_unwrapper<typename std::invoke_result<F>::type>::type>
+    {
+        return dispatch::async(prio, [token = m_token, f{std::forward<F>(f)}]
+        {
+            token->throw_if_cancelled();
+            return f();
+        });
+    }
+
+    /// Makes not yet started tasks fail when dequeued and signals the running ones.
+    void cancel() { m_token->cancel(); }
+
+    bool is_cancelled() const { return m_token->is_cancelled(); }
+
+    /// Token for running tasks to check for cancellation.
+    const cancellation_token_ptr& token() const { return m_token; }
+
+private:
+    cancellation_token_ptr m_token;
+};
 
 
 
@@ -701,4 +1034,119 @@ extern void cleanup();
 } // namespace dispatch
 
 
+
+// ----------------------------------------------------------------------
+// Coroutines support
+// ----------------------------------------------------------------------
+
+// Only available when compiling as C++20 (or newer); code shared by all
+// platforms must still use continuations as long as some build as C++17.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#define HAVE_COROUTINES
+
+#include <coroutine>
+
+namespace dispatch
+{
+
+namespace detail
+{
+
+template<typename T>
+class future_awaiter
+{
+public:
+    future_awaiter(boost::future<T>&& f) : m_future(std::move(f)) {}
+
+    bool await_ready() const { return m_future.is_ready(); }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        // m_future is consumed by then(), the ready one is given to the continuation:
+        m_future.then(background_queue_executor::get(), [this, h](boost::future<T> ready)
+        {
+            m_ready = std::move(ready);
+            h.resume();
+        });
+    }
+
+    T await_resume() { return m_ready.valid() ? m_ready.get() : m_future.get(); }
+
+private:
+    boost::future<T> m_future, m_ready;
+};
+
+template<typename T>
+struct future_promise_base
+{
+    promise<T> p;
+
+    future<T> get_return_object() { return p.get_future(); }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void unhandled_exception() { set_current_exception(p); }
+};
+
+} // namespace detail
+
+
+/**
+    Awaiting a future suspends the coroutine until the future is ready, then
+    continues it on a background thread (or immediately, if already ready).
+
+    Use resume_on_main() to switch to the main thread afterwards if needed.
+ */
+template<typename T>
+detail::future_awaiter<T> operator co_await(future<T>&& f) { return f.move_to_boost(); }
+
+template<typename T>
+detail::future_awaiter<T> operator co_await(future<T>& f) { return f.move_to_boost(); }
+
+
+/// Awaitable switching the coroutine to the main thread: co_await dispatch::resume_on_main();
+struct resume_on_main
+{
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> h) { detail::main_thread_executor::get().submit([h]{ h.resume(); }); }
+    void await_resume() {}
+};
+
+/// Awaitable switching the coroutine to a background thread: co_await dispatch::resume_in_background();
+struct resume_in_background
+{
+    explicit resume_in_background(priority prio_ = priority::normal) : prio(prio_) {}
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> h) { detail::background_queue_executor::get(prio).submit([h]{ h.resume(); }); }
+    void await_resume() {}
+
+    priority prio;
+};
+
+} // namespace dispatch
+
+
+/// Functions returning dispatch::future<T> can be coroutines, started eagerly on the calling thread.
+template<typename T, typename... Args>
+struct std::coroutine_traits<dispatch::future<T>, Args...>
+{
+    struct promise_type : dispatch::detail::future_promise_base<T>
+    {
+        void return_value(T value) { this->p.set_value(std::move(value)); }
+    };
+};
+
+template<typename... Args>
+struct std::coroutine_traits<dispatch::future<void>, Args...>
+{
+    struct promise_type : dispatch::detail::future_promise_base<void>
+    {
+        void return_void() { this->p.set_value(); }
+    };
+};
+
+#endif // __cpp_impl_coroutine
+
+
 #endif // Poedit_concurrency_h
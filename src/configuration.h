@@ -57,12 +57,32 @@ public:
     static bool UseTM() { return Read("/use_tm", true); }
     static void UseTM(bool use) { Write("/use_tm", use); }
 
+    // Fill in newly entered translations into untranslated items with the same source text:
+    static bool PropagateTranslations() { return Read("/propagate_translations", false); }
+    static void PropagateTranslations(bool use) { Write("/propagate_translations", use); }
+
     static bool CheckForBetaUpdates() { return Read("/check_for_beta_updates", false); }
     static void CheckForBetaUpdates(bool use) { Write("/check_for_beta_updates", use); }
 
     static ::PretranslateSettings PretranslateSettings();
     static void PretranslateSettings(::PretranslateSettings s);
 
+    // Tuning of the translation memory's index; not exposed in the UI, only
+    // meant for very large TMs:
+    static bool TMConcurrentMerges() { return Read("/tm/concurrent_merges", true); }
+    static long TMRAMBufferSizeMB() { return Read("/tm/ram_buffer_size", (long)48); }
+    static long TMMergeFactor() { return Read("/tm/merge_factor", (long)10); }
+    // keep a separate index for each language pair:
+    static bool TMPartitionByLanguage() { return Read("/tm/partition_by_language", false); }
+    // store each source text only once, shared by all languages:
+    static bool TMCompactStorage() { return Read("/tm/compact_storage", false); }
+    // access index files through memory mapping instead of buffered reads:
+#ifdef __WXMSW__
+    static bool TMMemoryMappedIO() { return Read("/tm/mmap", false); }
+#else
+    static bool TMMemoryMappedIO() { return Read("/tm/mmap", true); }
+#endif
+
     // What to do during merge
     static ::MergeBehavior MergeBehavior();
     static void MergeBehavior(::MergeBehavior b);
@@ -70,18 +90,40 @@ public:
     static bool ShowWarnings() { return Read("/show_warnings", true); }
     static void ShowWarnings(bool show) { Write("/show_warnings", show); }
 
+    // Always run msgfmt -c in addition to the built-in checks of PO files when
+    // validating, not only for files with format strings the built-in checks
+    // don't cover; not exposed in the UI, only for diagnosing differences:
+    static bool ValidateWithMsgfmt() { return Read("/validate_with_msgfmt", false); }
+
+    // Exports to HTML are split into pages of this many entries; 0 disables it:
+    static long HTMLExportPageSize() { return Read("/html_export_page_size", (long)10000); }
+
+    // Total size of in-memory caches (see CacheRegistry) in MB, 0 for unlimited;
+    // not exposed in the UI:
+    static long CachesMemoryBudgetMB() { return Read("/caches_memory_budget", (long)256); }
+
     static std::string CloudLastProject() { return Read("/cloud_last_project", std::string()); }
     static void CloudLastProject(const std::string& prj) { return Write("/cloud_last_project", prj); }
 
     static std::string LocalazyMetadata() { return Read("/accounts/localazy/metadata", std::string()); }
     static void LocalazyMetadata(const std::string& prj) { return Write("/accounts/localazy/metadata", prj); }
 
+    static std::string RemoteTMURL() { return Read("/remote_tm/url", std::string()); }
+    static void RemoteTMURL(const std::string& url) { Write("/remote_tm/url", url); }
+
     static time_t OTATranslationLastCheck() { return Read("/ota/last_check", (long)0); }
     static void OTATranslationLastCheck(time_t when) { Write("/ota/last_check", (long)when); }
 
     static std::string OTATranslationEtag() { return Read("/ota/etag", std::string()); }
     static void OTATranslationEtag(const std::string& etag) { Write("/ota/etag", etag); }
 
+    static std::string OTATranslationLastModified() { return Read("/ota/last_modified", std::string()); }
+    static void OTATranslationLastModified(const std::string& when) { Write("/ota/last_modified", when); }
+
+    // version/language of the file that the ETag and Last-Modified values belong to:
+    static std::string OTATranslationFile() { return Read("/ota/file", std::string()); }
+    static void OTATranslationFile(const std::string& file) { Write("/ota/file", file); }
+
 private:
     template<typename T>
     static T Read(const std::string& key, T defval)
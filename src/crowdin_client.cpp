@@ -28,23 +28,30 @@
 
 #include "catalog.h"
 #include "catalog_xliff.h"
+#include "edapp.h"
 #include "errors.h"
 #include "http_client.h"
-#include "keychain/keytar.h"
+#include "keychain_cache.h"
 #include "str_helpers.h"
+#include "utility.h"
 
+#include <algorithm>
+#include <deque>
+#include <fstream>
 #include <functional>
 #include <mutex>
 #include <stack>
 #include <iostream>
 #include <ctime>
 #include <regex>
+#include <thread>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
+#include <wx/filename.h>
 #include <wx/translation.h>
 #include <wx/utils.h>
 
@@ -93,6 +100,67 @@ std::string base64_decode_json_part(const std::string &in)
     return out;
 }
 
+
+// Crowdin API returns at most this many items per request:
+const int PAGE_SIZE = 500;
+
+// Number of pages requested concurrently once the listing doesn't fit into one:
+const int CONCURRENT_PAGES = 4;
+
+std::string page_url(const std::string& url, int offset)
+{
+    return url + (url.find('?') == std::string::npos ? '?' : '&') +
+           "limit=" + std::to_string(PAGE_SIZE) + "&offset=" + std::to_string(offset);
+}
+
+dispatch::future<json> get_remaining_pages(http_client *api, const std::string& url, int offset, std::shared_ptr<json> items)
+{
+    std::vector<std::string> urls;
+    for (int i = 0; i < CONCURRENT_PAGES; i++)
+        urls.push_back(page_url(url, offset + i * PAGE_SIZE));
+
+    return api->get_batch(urls)
+    .then([=](std::vector<json> pages) -> dispatch::future<json>
+    {
+        // All pages are fetched, even those past the end (which are empty):
+        bool complete = false;
+        for (auto& r: pages)
+        {
+            auto& data = r.at("data");
+            if (!complete)
+            {
+                for (auto& i: data)
+                    items->push_back(std::move(i));
+            }
+            if (data.size() < size_t(PAGE_SIZE))
+                complete = true;
+        }
+
+        if (complete)
+            return dispatch::make_ready_future(std::move(*items));
+        else
+            return get_remaining_pages(api, url, offset + CONCURRENT_PAGES * PAGE_SIZE, items);
+    });
+}
+
+/**
+    Fetches all items of a paginated Crowdin API listing at @a url.
+
+    Most listings fit into a single page; if not, the rest is fetched
+    several pages at a time. Returns array of the "data" items.
+ */
+dispatch::future<json> get_all_pages(http_client *api, const std::string& url)
+{
+    return api->get(page_url(url, 0))
+    .then([=](json r) -> dispatch::future<json>
+    {
+        auto items = std::make_shared<json>(std::move(r.at("data")));
+        if (items->size() < size_t(PAGE_SIZE))
+            return dispatch::make_ready_future(std::move(*items));
+        return get_remaining_pages(api, url, PAGE_SIZE, items);
+    });
+}
+
 } // anonymous namespace
 
 
@@ -196,6 +264,7 @@ private:
 
 
 CrowdinClient::CrowdinClient()
+    : m_scheduler(std::make_unique<http_scheduler>("https://crowdin.com/", /*max_bulk_ops=*/4))
 {
     SignInIfAuthorized();
 }
@@ -253,7 +322,7 @@ bool CrowdinClient::IsOAuthCallback(const std::string& uri)
 
 dispatch::future<CloudAccountClient::UserInfo> CrowdinClient::GetUserInfo()
 {
-    return m_api->get("user")
+    return m_scheduler->schedule<json>(http_scheduler::priority::interactive, [this]{ return m_api->get("user"); })
         .then([](json r)
         {
             wxLogTrace("poedit.crowdin", "Got user info: %s", r.dump().c_str());
@@ -298,14 +367,13 @@ dispatch::future<CloudAccountClient::UserInfo> CrowdinClient::GetUserInfo()
 
 dispatch::future<std::vector<CloudAccountClient::ProjectInfo>> CrowdinClient::GetUserProjects()
 {
-    // TODO: handle pagination if projects more than 500
-    //       (what is quite rare case I guess)
-    return m_api->get("projects?limit=500")
+    auto api = m_api.get();
+    return m_scheduler->schedule<json>(http_scheduler::priority::interactive, [api]{ return get_all_pages(api, "projects"); })
         .then([](json r)
         {
             wxLogTrace("poedit.crowdin", "Got projects: %s", r.dump().c_str());
             std::vector<ProjectInfo> all;
-            for (const auto& d : r["data"])
+            for (const auto& d : r)
             {
                 const json& i = d["data"];
                 all.push_back(
@@ -328,10 +396,11 @@ dispatch::future<CrowdinClient::ProjectDetails> CrowdinClient::GetProjectDetails
 
     auto url = "projects/" + std::to_string(project_id);
     auto prj = std::make_shared<ProjectDetails>();
+    auto validator = std::make_shared<std::string>();
     static const int NO_ID = -1;
 
-    return m_api->get(url)
-    .then([this, url, prj](json r)
+    return m_scheduler->schedule<json>(http_scheduler::priority::interactive, [this, url]{ return m_api->get(url); })
+    .then([this, url, prj, project_id, validator](json r) -> dispatch::future<ProjectDetails>
     {
         // Handle project info
         const json& d = r["data"];
@@ -348,115 +417,224 @@ dispatch::future<CrowdinClient::ProjectDetails> CrowdinClient::GetProjectDetails
         for (const auto& langCode: d.at("targetLanguageIds"))
             prj->languages.push_back(Language::FromLanguageTag(std::string(langCode)));
 
-        //TODO: get more until all files gotten (if more than 500)
-        return m_api->get(url + "/files?limit=500");
-    })
-    .then([this, url, prj](json r)
-    {
-        // Handle project files
-        for (auto& i : r["data"])
+        // The project's structure only changes with some activity in it, so
+        // the cached listing of files is valid as long as this is unchanged:
+        *validator = get_value(d, "lastActivity", std::string()) + "|" +
+                     get_value(d, "updatedAt", std::string());
+        if (LoadCachedProjectFiles(project_id, *validator, prj->files))
         {
-            const json& d = i["data"];
-            if (d["type"] != "assets")
-            {
-                ProjectFile f;
-                auto internal = std::make_shared<FileInternal>();
-                f.internal = internal;
-
-                d.at("id").get_to(internal->id);
-                internal->fullPath = '/' + d.at("name").get<std::string>();
-                internal->dirId = get_value(d, "directoryId", NO_ID);
-                internal->branchId = get_value(d, "branchId", NO_ID);
-                d.at("name").get_to(internal->fileName);
-                f.title = str::to_wstring(get_value(d, "title", internal->fileName));
-                prj->files.push_back(std::move(f));
-            }
+            wxLogTrace("poedit.crowdin", "Using cached files of project %d", project_id);
+            return dispatch::make_ready_future(std::move(*prj));
         }
-        //TODO: get more until all dirs gotten (if more than 500)
-        return m_api->get(url + "/directories?limit=500");
-    })
-    .then([this, url, prj](json r)
-    {
-        // Handle directories
-        struct dir_info
-        {
-            std::string name, title;
-            int parentId;
-        };
-        std::map<int, dir_info> dirs;
 
-        for (const auto& i : r["data"])
+        // Files, directories and branches are independent, fetch them concurrently:
+        auto files = get_all_pages(m_api.get(), url + "/files");
+        auto directories = get_all_pages(m_api.get(), url + "/directories");
+        auto branches = get_all_pages(m_api.get(), url + "/branches");
+        auto listings = std::make_shared<std::vector<dispatch::future<json>>>();
+        listings->push_back(std::move(files));
+        listings->push_back(std::move(directories));
+        listings->push_back(std::move(branches));
+
+        return dispatch::async([prj, listings, project_id, validator]
         {
-            const json& d = i["data"];
-            const json& parent = d["directoryId"];
-            std::string name;
-            d.at("name").get_to(name);
-            dirs.insert(
+            auto files = (*listings)[0].get();
+            auto directories = (*listings)[1].get();
+            auto branches = (*listings)[2].get();
+
+            // Handle project files
+            for (auto& i : files)
             {
-                d.at("id").get<int>(),
+                const json& d = i["data"];
+                if (d["type"] != "assets")
                 {
-                    name,
-                    get_value(d, "title", name),
-                    parent.is_null() ? NO_ID : parent.get<int>()
+                    ProjectFile f;
+                    auto internal = std::make_shared<FileInternal>();
+                    f.internal = internal;
+
+                    d.at("id").get_to(internal->id);
+                    internal->fullPath = '/' + d.at("name").get<std::string>();
+                    internal->dirId = get_value(d, "directoryId", NO_ID);
+                    internal->branchId = get_value(d, "branchId", NO_ID);
+                    d.at("name").get_to(internal->fileName);
+                    f.title = str::to_wstring(get_value(d, "title", internal->fileName));
+                    prj->files.push_back(std::move(f));
                 }
-            });
-        }
+            }
 
-        for (auto& i : prj->files)
-        {
-            auto internal = std::static_pointer_cast<FileInternal>(i.internal);
-            std::list<std::string> path;
-            int dirId = internal->dirId;
-            while (dirId != NO_ID)
+            // Handle directories
+            struct dir_info
+            {
+                std::string name, title;
+                int parentId;
+            };
+            std::map<int, dir_info> dirs;
+
+            for (const auto& i : directories)
             {
-                const auto& dir = dirs[dirId];
-                path.push_front(dir.title);
-                internal->fullPath.insert(0, '/' + dir.name);
-                dirId = dir.parentId;
+                const json& d = i["data"];
+                const json& parent = d["directoryId"];
+                std::string name;
+                d.at("name").get_to(name);
+                dirs.insert(
+                {
+                    d.at("id").get<int>(),
+                    {
+                        name,
+                        get_value(d, "title", name),
+                        parent.is_null() ? NO_ID : parent.get<int>()
+                    }
+                });
             }
-            internal->dirName = boost::join(path, "/");
-        }
-    })
-    .then([this, url]()
-    {
-        //TODO: get more until all branches gotten (if more than 500)
-        return m_api->get(url + "/branches?limit=500");
-    })
-    .then([this, url, prj](json r)
+
+            for (auto& i : prj->files)
+            {
+                auto internal = std::static_pointer_cast<FileInternal>(i.internal);
+                std::list<std::string> path;
+                int dirId = internal->dirId;
+                while (dirId != NO_ID)
+                {
+                    const auto& dir = dirs[dirId];
+                    path.push_front(dir.title);
+                    internal->fullPath.insert(0, '/' + dir.name);
+                    dirId = dir.parentId;
+                }
+                internal->dirName = boost::join(path, "/");
+            }
+
+            // Handle branches
+            struct branch_info
+            {
+                std::string name, title;
+            };
+            std::map<int, branch_info> branchesMap;
+
+            for (const auto& i : branches)
+            {
+                const json& d = i.at("data");
+                const auto name = d.at("name").get<std::string>();
+                const std::string title = get_value(d, "title", name);
+                branchesMap.insert({d.at("id").get<int>(), {name, title}});
+            }
+
+            for (auto& i : prj->files)
+            {
+                auto internal = std::static_pointer_cast<FileInternal>(i.internal);
+                std::wstring branchName;
+
+                if (internal->branchId != NO_ID)
+                {
+                    branchName = str::to_wstring(branchesMap[internal->branchId].title);
+                    internal->fullPath.insert(0, '/' + branchesMap[internal->branchId].name);
+                }
+
+                if (!branchName.empty())
+                    i.description += branchName + L" → ";
+                i.description += str::to_wstring(internal->fullPath);
+            }
+
+            SaveProjectFilesToCache(project_id, *validator, prj->files);
+
+            return std::move(*prj);
+        });
+    });
+}
+
+
+namespace
+{
+
+wxString GetProjectCacheFile(int project_id)
+{
+    return PoeditApp::GetCacheDir("Crowdin") + wxString::Format("/project-%d.json", project_id);
+}
+
+// Version of the cache format, increment when changing it
+const int PROJECT_CACHE_VERSION = 1;
+
+} // anonymous namespace
+
+
+bool CrowdinClient::LoadCachedProjectFiles(int project_id, const std::string& validator, std::vector<ProjectFile>& files)
+{
+    try
     {
-        // Handle branches
-        struct branch_info
-        {
-            std::string name, title;
-        };
-        std::map<int, branch_info> branches;
+        const auto filename = GetProjectCacheFile(project_id);
+        if (!wxFileName::FileExists(filename))
+            return false;
+
+        std::ifstream f(filename.fn_str());
+        auto cache = json::parse(f);
+        if (get_value(cache, "version", 0) != PROJECT_CACHE_VERSION || get_value(cache, "validator", std::string()) != validator)
+            return false;
 
-        for (const auto& i : r.at("data"))
+        std::vector<ProjectFile> loaded;
+        for (auto& i: cache.at("files"))
         {
-            const json& d = i.at("data");
-            const auto name = d.at("name").get<std::string>();
-            const std::string title = get_value(d, "title", name);
-            branches.insert({d.at("id").get<int>(), {name, title}});
+            ProjectFile pf;
+            auto internal = std::make_shared<FileInternal>();
+            pf.internal = internal;
+            pf.title = i.at("title").get<std::wstring>();
+            pf.description = i.at("description").get<std::wstring>();
+            i.at("id").get_to(internal->id);
+            i.at("dirId").get_to(internal->dirId);
+            i.at("branchId").get_to(internal->branchId);
+            i.at("fileName").get_to(internal->fileName);
+            i.at("dirName").get_to(internal->dirName);
+            i.at("fullPath").get_to(internal->fullPath);
+            loaded.push_back(std::move(pf));
         }
 
-        for (auto& i : prj->files)
-        {
-            auto internal = std::static_pointer_cast<FileInternal>(i.internal);
-            std::wstring branchName;
+        files = std::move(loaded);
+        return true;
+    }
+    catch (...)
+    {
+        // corrupted cache is not an error, it's just ignored and re-fetched
+        wxLogTrace("poedit.crowdin", "Failed to load cached project: %s", DescribeCurrentException());
+        return false;
+    }
+}
 
-            if (internal->branchId != NO_ID)
-            {
-                branchName = str::to_wstring(branches[internal->branchId].title);
-                internal->fullPath.insert(0, '/' + branches[internal->branchId].name);
-            }
 
-            if (!branchName.empty())
-                i.description += branchName + L" → ";
-            i.description += str::to_wstring(internal->fullPath);
+void CrowdinClient::SaveProjectFilesToCache(int project_id, const std::string& validator, const std::vector<ProjectFile>& files)
+{
+    try
+    {
+        json cache;
+        cache["version"] = PROJECT_CACHE_VERSION;
+        cache["validator"] = validator;
+        auto& out = cache["files"] = json::array();
+        for (auto& pf: files)
+        {
+            auto internal = std::static_pointer_cast<FileInternal>(pf.internal);
+            out.push_back(
+            {
+                {"title", pf.title},
+                {"description", pf.description},
+                {"id", internal->id},
+                {"dirId", internal->dirId},
+                {"branchId", internal->branchId},
+                {"fileName", internal->fileName},
+                {"dirName", internal->dirName},
+                {"fullPath", internal->fullPath}
+            });
         }
 
-        return std::move(*prj);
-    });
+        const auto filename = GetProjectCacheFile(project_id);
+        wxFileName::Mkdir(wxFileName(filename).GetPath(), wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
+
+        TempOutputFileFor temp(filename);
+        {
+            std::ofstream f(temp.FileName().fn_str(), std::ios::binary | std::ios::trunc);
+            f << cache.dump();
+        }
+        temp.Commit();
+    }
+    catch (...)
+    {
+        wxLogTrace("poedit.crowdin", "Failed to cache project: %s", DescribeCurrentException());
+    }
 }
 
 
@@ -500,10 +678,86 @@ std::wstring CrowdinClient::CreateLocalFilename(const ProjectInfo& project, cons
 }
 
 
-static void PostprocessDownloadedXLIFF(const wxString& filename)
+namespace
+{
+
+/**
+    Runs post-processing of downloaded files (parsing them and saving changes).
+
+    This is CPU and memory heavy for large files, so only a few files are
+    processed at once when syncing many of them; the rest wait in a queue
+    instead of occupying all background threads.
+ */
+class postprocessing_queue
+{
+public:
+    static postprocessing_queue& get()
+    {
+        // intentionally leaked, tasks may still run during shutdown
+        static auto instance = new postprocessing_queue;
+        return *instance;
+    }
+
+    dispatch::future<CatalogPtr> run(std::function<CatalogPtr()>&& func)
+    {
+        auto pr = std::make_shared<dispatch::promise<CatalogPtr>>();
+        auto job = [pr, func{std::move(func)}]
+        {
+            try
+            {
+                pr->set_value(func());
+            }
+            catch (...)
+            {
+                dispatch::set_current_exception(pr);
+            }
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(std::move(job));
+        }
+        pump();
+        return pr->get_future();
+    }
+
+private:
+    postprocessing_queue() : m_maxRunning(std::max(1, int(std::thread::hardware_concurrency()) / 2)), m_running(0) {}
+
+    void pump()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (m_running < m_maxRunning && !m_queue.empty())
+        {
+            auto job = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_running++;
+            dispatch::async([this, job{std::move(job)}]
+            {
+                job();
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_running--;
+                }
+                pump();
+            });
+        }
+    }
+
+    const int m_maxRunning;
+    std::mutex m_mutex;
+    std::deque<std::function<void()>> m_queue;
+    int m_running;
+};
+
+} // anonymous namespace
+
+
+static CatalogPtr PostprocessDownloadedXLIFF(const wxString& filename)
 {
     // Crowdin XLIFF files have translations pre-filled with the source text if
     // not yet translated. Undo this as it is undesirable to translators.
+    // The loaded catalog is returned for reuse, nullptr on failure.
     try
     {
         auto cat = Catalog::Create(filename);
@@ -524,10 +778,12 @@ static void PostprocessDownloadedXLIFF(const wxString& filename)
             Catalog::CompilationStatus dummy2;
             cat->Save(filename, false, dummy1, dummy2);
         }
+
+        return cat;
     }
     catch (...)
     {
-        return;
+        return nullptr;
     }
 }
 
@@ -597,7 +853,7 @@ std::shared_ptr<CrowdinClient::FileSyncMetadata> CrowdinClient::DoExtractSyncMet
 }
 
 
-dispatch::future<void> CrowdinClient::DownloadFile(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta_)
+dispatch::future<CatalogPtr> CrowdinClient::DoDownloadFile(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta_, bool load)
 {
     auto meta = std::dynamic_pointer_cast<CrowdinSyncMetadata>(meta_);
     auto const forceExportAsXliff = !meta->xliffRemoteFilename.empty();
@@ -632,12 +888,36 @@ dispatch::future<void> CrowdinClient::DownloadFile(const std::wstring& output_fi
             wxString outfile(output_file);
             file.move_to(outfile);
 
-            if (isXLIFFNative || isXLIFFConverted)
-                PostprocessDownloadedXLIFF(outfile);
+            const bool postprocess = isXLIFFNative || isXLIFFConverted;
+            if (!postprocess && !load)
+                return dispatch::make_ready_future(CatalogPtr());
+
+            // the file is parsed only once, for both post-processing and the caller:
+            return postprocessing_queue::get().run([=]
+            {
+                CatalogPtr cat;
+                if (postprocess)
+                    cat = PostprocessDownloadedXLIFF(outfile);
+                if (!cat && load)
+                    cat = Catalog::Create(outfile);
+                return cat;
+            });
         });
 }
 
 
+dispatch::future<void> CrowdinClient::DownloadFile(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta)
+{
+    return DoDownloadFile(output_file, meta, /*load=*/false).then([](CatalogPtr){});
+}
+
+
+dispatch::future<CatalogPtr> CrowdinClient::DownloadCatalog(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta)
+{
+    return DoDownloadFile(output_file, meta, /*load=*/true);
+}
+
+
 dispatch::future<void> CrowdinClient::DownloadFile(const std::wstring& output_file, const ProjectInfo& project, const ProjectFile& file, const Language& lang)
 {
     auto internal = std::static_pointer_cast<FileInternal>(file.internal);
@@ -653,7 +933,112 @@ dispatch::future<void> CrowdinClient::DownloadFile(const std::wstring& output_fi
 }
 
 
-dispatch::future<void> CrowdinClient::UploadFile(const std::string& file_buffer, std::shared_ptr<CrowdinClient::FileSyncMetadata> meta_)
+/// Queue of DownloadFiles() requests, running up to max_in_flight of them at once
+class CrowdinClient::bulk_download : public std::enable_shared_from_this<bulk_download>
+{
+public:
+    bulk_download(CrowdinClient& owner, const ProjectInfo& project, std::vector<DownloadRequest>&& files,
+                  int max_in_flight, DownloadProgressCallback&& on_progress)
+        : m_owner(owner),
+          m_project(project),
+          m_files(std::move(files)),
+          m_maxInFlight(std::max(1, max_in_flight)),
+          m_onProgress(std::move(on_progress)),
+          m_results(m_files.size()),
+          m_next(0), m_completed(0)
+    {
+    }
+
+    dispatch::future<DownloadResults> start()
+    {
+        if (m_files.empty())
+            return dispatch::make_ready_future(DownloadResults());
+
+        auto initial = std::min(m_files.size(), size_t(m_maxInFlight));
+        for (size_t i = 0; i < initial; i++)
+            start_next();
+        return m_promise.get_future();
+    }
+
+private:
+    void start_next()
+    {
+        size_t index;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_next == m_files.size())
+                return;
+            index = m_next++;
+        }
+        download(index);
+    }
+
+    void download(size_t index)
+    {
+        auto self = shared_from_this();
+
+        // the scheduler takes care of retrying rate-limited requests and of waiting while offline
+        m_owner.m_scheduler->schedule(http_scheduler::priority::bulk, [self, index]
+            {
+                auto& r = self->m_files[index];
+                return self->m_owner.DownloadFile(r.output_file, self->m_project, r.file, r.lang);
+            })
+            .then([self, index]
+            {
+                self->finished(index, nullptr);
+            })
+            .catch_all([self, index](dispatch::exception_ptr e)
+            {
+                self->finished(index, e);
+            });
+    }
+
+    void finished(size_t index, dispatch::exception_ptr error)
+    {
+        bool all_done;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_results[index] = error;
+            all_done = (++m_completed == m_files.size());
+        }
+
+        if (m_onProgress)
+        {
+            auto self = shared_from_this();
+            dispatch::on_main([self, index, error]{ self->m_onProgress(index, error); });
+        }
+
+        if (all_done)
+            m_promise.set_value(m_results);
+        else
+            start_next();
+    }
+
+    CrowdinClient& m_owner;
+    const ProjectInfo m_project;
+    const std::vector<DownloadRequest> m_files;
+    const int m_maxInFlight;
+    DownloadProgressCallback m_onProgress;
+
+    std::mutex m_mutex;
+    DownloadResults m_results;
+    size_t m_next, m_completed;
+    dispatch::promise<DownloadResults> m_promise;
+};
+
+
+dispatch::future<CrowdinClient::DownloadResults>
+CrowdinClient::DownloadFiles(const ProjectInfo& project, std::vector<DownloadRequest> files,
+                             int max_in_flight, DownloadProgressCallback on_progress)
+{
+    wxLogTrace("poedit.crowdin", "DownloadFiles(count=%d, max_in_flight=%d)", int(files.size()), max_in_flight);
+
+    auto bulk = std::make_shared<bulk_download>(*this, project, std::move(files), max_in_flight, std::move(on_progress));
+    return bulk->start();
+}
+
+
+dispatch::future<void> CrowdinClient::UploadFile(std::string file_buffer, std::shared_ptr<CrowdinClient::FileSyncMetadata> meta_)
 {
     auto meta = std::dynamic_pointer_cast<CrowdinSyncMetadata>(meta_);
 
@@ -661,7 +1046,7 @@ dispatch::future<void> CrowdinClient::UploadFile(const std::string& file_buffer,
 
     return m_api->post(
             "storages",
-            octet_stream_data(file_buffer),
+            octet_stream_data(std::move(file_buffer)),
             { { "Crowdin-API-FileName", "crowdin." + meta->extension } }
         )
         .then([this, meta] (json r) {
@@ -681,6 +1066,80 @@ dispatch::future<void> CrowdinClient::UploadFile(const std::string& file_buffer,
 }
 
 
+dispatch::future<bool> CrowdinClient::UploadChangedItems(CatalogPtr /*catalog*/, std::shared_ptr<FileSyncMetadata> meta_, std::vector<CatalogItemPtr> items)
+{
+    auto meta = std::dynamic_pointer_cast<CrowdinSyncMetadata>(meta_);
+
+    wxLogTrace("poedit.crowdin", "UploadChangedItems(project_id=%d, lang=%s, file_id=%d, count=%d)", meta->projectId, meta->lang.LanguageTag().c_str(), meta->fileId, (int)items.size());
+
+    // Translations are added one by one with the string-level API, which can't
+    // remove translations or mark them as fuzzy the way file import does:
+    for (auto& item: items)
+    {
+        if (item->HasPlural() || item->IsFuzzy() || !item->IsTranslated())
+            return dispatch::make_ready_future(false);
+    }
+
+    const std::string project = "projects/" + std::to_string(meta->projectId);
+
+    // Look up all strings' IDs first, so that nothing is uploaded if some can't be matched:
+    std::vector<std::string> lookups;
+    for (auto& item: items)
+    {
+        lookups.push_back(project + "/strings?fileId=" + std::to_string(meta->fileId) +
+                          "&scope=text&filter=" + http_client::url_encode(item->GetString().ToStdWstring()));
+    }
+
+    return m_api->get_batch(lookups)
+    .then([=](std::vector<json> found)
+    {
+        std::vector<int> ids;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            const auto text = items[i]->GetString().utf8_string();
+            int id = -1;
+            for (auto& s: found[i].at("data"))
+            {
+                auto& d = s.at("data");
+                if (!d.at("text").is_string() || d.at("text").get<std::string>() != text)
+                    continue;
+                if (id != -1)
+                    return false; // ambiguous, can't tell which string to update
+                id = d.at("id").get<int>();
+            }
+            if (id == -1)
+                return false;
+            ids.push_back(id);
+        }
+
+        std::vector<dispatch::future<json>> uploads;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            uploads.push_back(m_api->post(project + "/translations", json_data({
+                { "stringId", ids[i] },
+                { "languageId", meta->lang.LanguageTag() },
+                { "text", items[i]->GetTranslation().utf8_string() }
+            })));
+        }
+
+        try
+        {
+            for (auto& u: uploads)
+                u.get();
+        }
+        catch (...)
+        {
+            // e.g. identical translation already exists; uploading the whole file handles that
+            wxLogTrace("poedit.crowdin", "Failed to upload changed items: %s", DescribeCurrentException());
+            return false;
+        }
+
+        wxLogTrace("poedit.crowdin", "Uploaded %d changed items", (int)items.size());
+        return true;
+    });
+}
+
+
 bool CrowdinClient::InitWithAuthToken(const crowdin_token& token)
 {
     wxLogTrace("poedit.crowdin", "Authorization: %s", token.encoded.c_str());
@@ -724,9 +1183,9 @@ CrowdinClient::crowdin_token CrowdinClient::GetValidToken() const
 
     // Our tokens stored in keychain have the form of <version>:<token>, so not
     // only do we have to check for token's existence but also that its version
-    // is current:
-    std::string token;
-    if (keytar::GetPassword("Crowdin", "", &token) && token.substr(0, 2) == "2:")
+    // is current. The keychain is only waited for if it wasn't preloaded yet.
+    std::string token = KeychainCache::Get().GetPassword("Crowdin").get();
+    if (token.substr(0, 2) == "2:")
     {
         token = token.substr(2);
     }
@@ -750,7 +1209,7 @@ void CrowdinClient::SaveAndSetToken(const std::string& token)
 
     m_cachedAuthToken = std::make_unique<crowdin_token>(ct);
     if (InitWithAuthToken(ct))
-        keytar::AddPassword("Crowdin", "", "2:" + ct.encoded);
+        KeychainCache::Get().SetPassword("Crowdin", "", "2:" + ct.encoded);
 }
 
 
@@ -758,7 +1217,10 @@ void CrowdinClient::SignOut()
 {
     m_api.reset();
     m_cachedAuthToken.reset();
-    keytar::DeletePassword("Crowdin", "");
+    KeychainCache::Get().DeletePassword("Crowdin");
+
+    // Cached projects' structure is no longer available to the user:
+    wxFileName::Rmdir(PoeditApp::GetCacheDir("Crowdin"), wxPATH_RMDIR_RECURSIVE);
 }
 
 
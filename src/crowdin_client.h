@@ -28,11 +28,15 @@
 
 #ifdef HAVE_HTTP_CLIENT
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "cloud_accounts.h"
 #include "language.h"
 
+class http_scheduler;
+
 
 /**
     Client to the Crowdin platform.
@@ -92,12 +96,47 @@ public:
     /// Asynchronously download specific Crowdin file into @a output_file.
     dispatch::future<void> DownloadFile(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta) override;
 
+    /// Asynchronously download specific Crowdin file into @a output_file and load it.
+    dispatch::future<std::shared_ptr<Catalog>> DownloadCatalog(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta) override;
+
+    /// Single file in single language to download with DownloadFiles()
+    struct DownloadRequest
+    {
+        std::wstring output_file;
+        ProjectFile file;
+        Language lang;
+    };
+
+    /// Outcome of DownloadFiles() for each request, nullptr if it succeeded
+    typedef std::vector<dispatch::exception_ptr> DownloadResults;
+
+    /// Called on the main thread when a file from DownloadFiles() finishes
+    typedef std::function<void(size_t index, dispatch::exception_ptr error)> DownloadProgressCallback;
+
+    /**
+        Asynchronously download many files, possibly in many languages, at once.
+
+        At most @a max_in_flight builds or downloads run concurrently, as bulk
+        operations that yield to interactive ones. While offline, downloads wait
+        for the network to become available again. Requests that fail transiently,
+        e.g. due to Crowdin's rate limiting (HTTP 429), are retried with exponential
+        backoff. Failure of one file doesn't abort the others; errors are reported
+        in the result, in the same order as @a files.
+
+        @a on_progress, if set, is called as each of the files finishes.
+     */
+    dispatch::future<DownloadResults> DownloadFiles(const ProjectInfo& project,
+                                                    std::vector<DownloadRequest> files,
+                                                    int max_in_flight = 4,
+                                                    DownloadProgressCallback on_progress = DownloadProgressCallback());
+
     /// Asynchronously upload specific Crowdin file data.
-    dispatch::future<void> UploadFile(const std::string& file_buffer, std::shared_ptr<FileSyncMetadata> meta) override;
+    dispatch::future<void> UploadFile(std::string file_buffer, std::shared_ptr<FileSyncMetadata> meta) override;
 
 private:
     class crowdin_http_client;
     class crowdin_token;
+    class bulk_download;
 
     struct FileInternal : public ProjectFile::Internal
     {
@@ -112,20 +151,36 @@ private:
         int projectId, fileId;
         std::string xliffRemoteFilename;
         std::string extension;
+
+        std::string SyncStateKey() const override
+            { return std::to_string(projectId) + "-" + std::to_string(fileId) + "-" + lang.LanguageTag(); }
     };
 
+    dispatch::future<bool> UploadChangedItems(std::shared_ptr<Catalog> catalog,
+                                              std::shared_ptr<FileSyncMetadata> meta,
+                                              std::vector<std::shared_ptr<CatalogItem>> items) override;
+
     CrowdinClient();
     ~CrowdinClient();
 
+    // Common implementation of DownloadFile() and DownloadCatalog(), returns
+    // the catalog if it was loaded (always if @a load is true)
+    dispatch::future<std::shared_ptr<Catalog>> DoDownloadFile(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta, bool load);
+
     // Initialize m_api for use with given authorization; must be called before use
     bool InitWithAuthToken(const crowdin_token& token);
 
+    /// Loads @a files from cache if it is still valid, as indicated by @a validator
+    static bool LoadCachedProjectFiles(int project_id, const std::string& validator, std::vector<ProjectFile>& files);
+    static void SaveProjectFilesToCache(int project_id, const std::string& validator, const std::vector<ProjectFile>& files);
+
     void SignInIfAuthorized();
     void SaveAndSetToken(const std::string& token);
     crowdin_token GetValidToken() const;
 
     mutable std::unique_ptr<crowdin_token> m_cachedAuthToken;
     std::unique_ptr<crowdin_http_client> m_api;
+    std::unique_ptr<http_scheduler> m_scheduler;
     std::shared_ptr<dispatch::promise<void>> m_authCallback;
     std::string m_authCallbackExpectedState;
 
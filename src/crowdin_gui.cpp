@@ -397,7 +397,7 @@ void CrowdinSyncFile(wxWindow *parent, std::shared_ptr<Catalog> catalog,
     // TODO: nicer API for this.
     // This must be done right after entering the modal loop (on non-OSX)
     dlg->CallAfter([=]{
-        CrowdinClient::Get().UploadFile(catalog->SaveToBuffer(), meta)
+        CrowdinClient::Get().UploadChanges(catalog, meta)
         .then([=]
         {
             auto tmpdir = std::make_shared<TempDirectory>();
@@ -407,10 +407,14 @@ void CrowdinSyncFile(wxWindow *parent, std::shared_ptr<Catalog> catalog,
                 dlg->UpdateMessage(_(L"Downloading latest translations…"));
             });
 
-            return CrowdinClient::Get().DownloadFile(outfile.ToStdWstring(), meta)
-                .then_on_main([=]
+            return CrowdinClient::Get().DownloadCatalog(outfile.ToStdWstring(), meta)
+                .then([=](CatalogPtr newcat)
+                {
+                    CloudAccountClient::RememberSyncedState(*newcat, *meta);
+                    return newcat;
+                })
+                .then_on_main([=](CatalogPtr newcat)
                 {
-                    auto newcat = Catalog::Create(outfile);
                     newcat->SetFileName(catalog->GetFileName());
 
                     tmpdir->Clear();
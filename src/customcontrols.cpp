@@ -155,6 +155,65 @@ wxString WrapTextAtWidth(const wxString& text_, int width, Language lang, wxWind
 }
 
 
+/**
+    Maps positions in @a text to positions in @a modified, which is the same
+    text with line breaks or direction marks inserted and some whitespace
+    removed, as done by bidi::platform_mark_direction() and WrapTextAtWidth().
+ */
+std::vector<size_t> MapTextPositions(const wxString& text, const wxString& modified)
+{
+    std::vector<size_t> out(text.length() + 1);
+    size_t i = 0, j = 0;
+    while (i < text.length())
+    {
+        if (j < modified.length() && text[i] == modified[j])
+        {
+            out[i++] = j++;
+        }
+        else if (j < modified.length() && !bidi::is_direction_mark(modified[j]) && wxIsspace(text[i]))
+        {
+            out[i++] = j;  // removed
+        }
+        else if (j < modified.length())
+        {
+            j++;  // inserted
+        }
+        else
+        {
+            out[i++] = j;
+        }
+    }
+    out[i] = j;
+    return out;
+}
+
+
+wxString ApplyHighlights(const wxString& text, const std::vector<AutoWrappingText::Highlight>& highlights)
+{
+    auto escape = [](wxString s)
+    {
+        // '&' marks mnemonics in markup too:
+        s.Replace("&", "&&");
+        return wxControl::EscapeMarkup(s);
+    };
+
+    wxString out;
+    size_t pos = 0;
+    for (auto& h: highlights)
+    {
+        if (h.start < pos || h.end <= h.start || h.end > text.length())
+            continue;
+        out += escape(text.substr(pos, h.start - pos));
+        out += h.openTag;
+        out += escape(text.substr(h.start, h.end - h.start));
+        out += h.closeTag;
+        pos = h.end;
+    }
+    out += escape(text.substr(pos));
+    return out;
+}
+
+
 } // anonymous namespace
 
 
@@ -211,8 +270,25 @@ void AutoWrappingText::SetAlignment(TextDirection dir)
 }
 
 void AutoWrappingText::SetAndWrapLabel(const wxString& label)
+{
+    SetAndWrapLabel(label, {});
+}
+
+void AutoWrappingText::SetAndWrapLabel(const wxString& label, const std::vector<Highlight>& highlights)
 {
     m_text = bidi::platform_mark_direction(label);
+
+    m_highlights = highlights;
+    if (!m_highlights.empty())
+    {
+        auto positions = MapTextPositions(label, m_text);
+        for (auto& h: m_highlights)
+        {
+            h.start = positions[std::min(h.start, label.length())];
+            h.end = positions[std::min(h.end, label.length())];
+        }
+    }
+
     if (!m_language.IsValid())
         SetAlignment(bidi::get_base_direction(m_text));
 
@@ -259,7 +335,22 @@ bool AutoWrappingText::RewrapForWidth(int width)
 
     const int wrapAt = wxMax(0, width - PX(4));
     wxWindowUpdateLocker lock(this);
-    SetLabel(WrapTextAtWidth(m_text, wrapAt, m_language, this));
+    auto wrapped = WrapTextAtWidth(m_text, wrapAt, m_language, this);
+    if (m_highlights.empty())
+    {
+        SetLabel(wrapped);
+    }
+    else
+    {
+        auto positions = MapTextPositions(m_text, wrapped);
+        auto highlights = m_highlights;
+        for (auto& h: highlights)
+        {
+            h.start = positions[h.start];
+            h.end = positions[h.end];
+        }
+        SetLabelMarkup(ApplyHighlights(wrapped, highlights));
+    }
 
     InvalidateBestSize();
     return true;
@@ -42,6 +42,7 @@ class WXDLLIMPEXP_ADV wxActivityIndicator;
 
 #include <exception>
 #include <functional>
+#include <vector>
 
 
 /// Label marking a subsection of a dialog:
@@ -62,6 +63,16 @@ public:
 
     void SetAndWrapLabel(const wxString& label);
 
+    /// Range of the label's text displayed using markup, see SetAndWrapLabel()
+    struct Highlight
+    {
+        size_t start, end;
+        wxString openTag, closeTag;  // e.g. "<b>" and "</b>"
+    };
+
+    /// Like SetAndWrapLabel(), but displays non-overlapping @a highlights using markup
+    void SetAndWrapLabel(const wxString& label, const std::vector<Highlight>& highlights);
+
     bool InformFirstDirection(int direction, int size, int availableOtherDir) override;
 
     void SetLabel(const wxString& label) override;
@@ -75,6 +86,7 @@ protected:
 #endif
 
     wxString m_text;
+    std::vector<Highlight> m_highlights;  // with positions in m_text
     int m_wrapWidth;
     Language m_language;
 };
@@ -78,6 +78,8 @@
 #endif
 
 #include "app_updates.h"
+#include "batch.h"
+#include "cache_registry.h"
 #include "colorscheme.h"
 #include "concurrency.h"
 #include "configuration.h"
@@ -96,11 +98,16 @@
 #include "hidpi.h"
 #include "http_client.h"
 #include "icons.h"
+#include "keychain_cache.h"
 #include "version.h"
 #include "progress_ui.h"
+#include "stall_detector.h"
 #include "recent_files.h"
 #include "str_helpers.h"
+#include "tm/remote_tm.h"
+#include "tm/tm_service.h"
 #include "tm/transmem.h"
+#include "tracing.h"
 #include "utility.h"
 #include "prefsdlg.h"
 #include "errors.h"
@@ -195,9 +202,12 @@ private:
 
         wxConnectionBase *OnAcceptConnection(const wxString& topic) override
         {
-            if (topic != IPC_TOPIC)
-                return nullptr;
-            return new Connection(m_app);
+            if (topic == IPC_TOPIC)
+                return new Connection(m_app);
+            // other processes, e.g. batch jobs, using this instance's TM:
+            if (topic == TMService::IPC_TOPIC)
+                return TMService::CreateServerConnection();
+            return nullptr;
         }
 
     private:
@@ -323,6 +333,8 @@ static wxArrayString gs_filesToOpen;
 #endif
 static int gs_lineToOpen = 0;
 static wxString gs_uriToHandle;
+static BatchOptions gs_batch;
+static int gs_batchExitCode = 0;
 
 extern void InitXmlResource();
 
@@ -356,6 +368,9 @@ bool PoeditApp::OnInit()
     if (!wxApp::OnInit())
         return false;
 
+    // (tracing is enabled by command line parsing in wxApp::OnInit())
+    TRACE_SPAN("startup", "OnInit");
+
 #ifdef __WXOSX__
     // macOS 10.15 Vista throws a fit and bombards the user with scary UAC prompt
     // if a subprocess, shell or gettext, is launched with CWD within a "protected"
@@ -366,13 +381,15 @@ bool PoeditApp::OnInit()
 #endif
 
 #ifndef __WXOSX__
-    m_remoteServer.reset(new RemoteServer(this));
+    if (!gs_batch.IsRequested())
+        m_remoteServer.reset(new RemoteServer(this));
 #endif
 
     InitHiDPIHandling();
 
 #ifdef __WXOSX__
-    PFMoveToApplicationsFolderIfNecessary();
+    if (!gs_batch.IsRequested())
+        PFMoveToApplicationsFolderIfNecessary();
 
     wxSystemOptions::SetOption(wxMAC_TEXTCONTROL_USE_SPELL_CHECKER, 1);
 
@@ -419,6 +436,8 @@ bool PoeditApp::OnInit()
 
     Config::Initialize(CFG_FILE.ToStdWstring());
 
+    CacheRegistry::StartMonitoring();
+
 #ifndef __WXOSX__
     wxImage::AddHandler(new wxPNGHandler);
 #endif
@@ -446,6 +465,24 @@ bool PoeditApp::OnInit()
 
     SetupLanguage();
 
+    if (gs_batch.IsRequested())
+    {
+        StartBatch();
+        return true;
+    }
+
+    // Subsystems that aren't needed to show the first window are initialized
+    // in background once it is shown, instead of on their first use:
+    CallAfter([]
+    {
+        if (Config::UseTM())
+            TranslationMemory::Preload();
+        dispatch::async(dispatch::priority::bulk, []{ Language::PreloadNames(); });
+#ifdef HAVE_HTTP_CLIENT
+        KeychainCache::Get().Preload(CrowdinClient::SERVICE_NAME);
+#endif
+    });
+
 #ifdef __WXOSX__
     CreateMenu(Menu::Global);
     // so that help menu is correctly merged with system-provided menu
@@ -501,6 +538,28 @@ void PoeditApp::OnEventLoopEnter(wxEventLoopBase *loop)
         FileMonitor::EventLoopStarted();
 }
 
+void PoeditApp::StartBatch()
+{
+    // There's no UI to show errors in, report everything on stderr instead:
+    delete wxLog::SetActiveTarget(new wxLogStderr);
+
+    // The operations need the main thread's event loop (e.g. for running
+    // gettext tools), so they run in background until done:
+    dispatch::async([]{ return RunBatch(gs_batch); })
+    .then_on_main([this](int exitCode)
+    {
+        gs_batchExitCode = exitCode;
+        wxLog::FlushActive();
+        ExitMainLoop();
+    });
+}
+
+int PoeditApp::OnRun()
+{
+    int exitCode = wxApp::OnRun();
+    return gs_batch.IsRequested() ? gs_batchExitCode : exitCode;
+}
+
 int PoeditApp::OnExit()
 {
 #ifndef __WXOSX__
@@ -528,8 +587,14 @@ int PoeditApp::OnExit()
 
 #ifdef HAVE_HTTP_CLIENT
     CloudAccountClient::CleanUp();
+    http_client::cleanup_shared_clients();
+    RemoteTM::CleanUp();
+    KeychainCache::CleanUp();
 #endif
 
+    CacheRegistry::StopMonitoring();
+    StallDetector::Stop();
+    tracing::stop();
     dispatch::cleanup();
 
     return wxApp::OnExit();
@@ -617,6 +682,16 @@ void PoeditApp::SetupLanguage()
 }
 
 #ifdef SUPPORTS_OTA_UPDATES
+
+namespace
+{
+
+// Updates of OTA translations are checked for this long after launch, so that
+// they don't compete with the startup (or slow proxies delay it):
+const int OTA_UPDATE_CHECK_DELAY_MS = 30 * 1000;
+
+} // anonymous namespace
+
 void PoeditApp::SetupOTALanguageUpdate(wxTranslations *trans, const Language& lang)
 {
     auto langMO = lang.Code();
@@ -631,32 +706,58 @@ void PoeditApp::SetupOTALanguageUpdate(wxTranslations *trans, const Language& la
     wxFileTranslationsLoader::AddCatalogLookupPathPrefix(dir);
     trans->AddCatalog("poedit-ota");
 
-    // ..and update them (but at most once a day):
+    // batch processing doesn't run long enough to get to the check:
+    if (gs_batch.IsRequested())
+        return;
+
+    // ..and update them (but at most once a day) in background, once the app
+    // is up and running; updates are only used after the next launch:
     auto lastCheck = Config::OTATranslationLastCheck();
     auto now = time(NULL);
     if (now < lastCheck + 24*60*60)
         return;
-    Config::OTATranslationLastCheck(now);
+
+    m_otaUpdateTimer.SetOwner(this);
+    Bind(wxEVT_TIMER, [=](wxTimerEvent&){ CheckForOTALanguageUpdate(langMO); }, m_otaUpdateTimer.GetId());
+    m_otaUpdateTimer.StartOnce(OTA_UPDATE_CHECK_DELAY_MS);
+}
+
+
+void PoeditApp::CheckForOTALanguageUpdate(const std::string& langMO)
+{
+    Config::OTATranslationLastCheck(time(NULL));
+
+    auto version = str::to_utf8(GetMajorAppVersion());
+    auto dir = GetCacheDir("Translations") + "/" + version;
 
     wxFileName mofile(dir + "/" + langMO + "/poedit-ota.mo");
     wxFileName::Mkdir(mofile.GetPath(), wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
 
+    // ask only for changes of the file we have, the stored values may be for
+    // a different language or version:
+    const std::string file = version + "/" + str::to_utf8(langMO);
     http_client::headers hdrs;
-    std::string etag;
-    if (mofile.FileExists())
-        etag = Config::OTATranslationEtag();
-    if (!etag.empty())
-        hdrs.emplace_back("If-None-Match", etag);
+    if (mofile.FileExists() && Config::OTATranslationFile() == file)
+    {
+        auto etag = Config::OTATranslationEtag();
+        if (!etag.empty())
+            hdrs.emplace_back("If-None-Match", etag);
+        auto lastModified = Config::OTATranslationLastModified();
+        if (!lastModified.empty())
+            hdrs.emplace_back("If-Modified-Since", lastModified);
+    }
 
-    http_client::download_from_anywhere("https://ota.poedit.net/i18n/" + version + "/" + str::to_utf8(langMO) + "/poedit-ota.mo.gz", hdrs)
-    .then_on_main([=](downloaded_file f)
+    // NB: if nothing changed, the server responds with 304 and this fails silently
+    http_client::download_from_anywhere("https://ota.poedit.net/i18n/" + file + "/poedit-ota.mo.gz", hdrs)
+    .then([=](downloaded_file f)
     {
+        // decompress in background, the catalog in use was already loaded into memory:
         TempOutputFileFor temp(mofile);
         std::ofstream output_file(temp.FileName().fn_str(), std::ios_base::binary);
         std::ifstream input_file(f.filename().GetFullPath().mb_str(), std::ios_base::binary);
 
         if (output_file.fail() || input_file.fail())
-            return;
+            BOOST_THROW_EXCEPTION(std::runtime_error("failed to store OTA translation"));
 
         boost::iostreams::filtering_istream input;
         input.push(boost::iostreams::gzip_decompressor());
@@ -667,10 +768,13 @@ void PoeditApp::SetupOTALanguageUpdate(wxTranslations *trans, const Language& la
         output_file.close();
 
         temp.Commit();
+        return f;
+    })
+    .then_on_main([=](downloaded_file f)
+    {
+        Config::OTATranslationFile(file);
         Config::OTATranslationEtag(f.etag());
-
-        // re-add the catalog to force reloading updated file
-        trans->AddCatalog("poedit-ota");
+        Config::OTATranslationLastModified(f.last_modified());
     })
     .catch_all([](dispatch::exception_ptr){});
 }
@@ -684,25 +788,29 @@ wxLayoutDirection PoeditApp::GetLayoutDirection() const
 
 wxString PoeditApp::GetCacheDir(const wxString& category)
 {
-    static wxString localBaseDir;
-
-    if (localBaseDir.empty())
+    // initialized only once, can be called from background threads
+    static const wxString localBaseDir = []
     {
-        localBaseDir = wxStandardPaths::Get().GetUserDir(wxStandardPaths::Dir_Cache);
+        wxString dir = wxStandardPaths::Get().GetUserDir(wxStandardPaths::Dir_Cache);
     #if defined(__WXOSX__)
-        localBaseDir += "/net.poedit.Poedit";
+        dir += "/net.poedit.Poedit";
     #elif defined(__WXMSW__)
-        localBaseDir += "\\Poedit\\Cache";
+        dir += "\\Poedit\\Cache";
     #else
-        localBaseDir += "/poedit";
+        dir += "/poedit";
     #endif
-    }
+        return dir;
+    }();
 
     return localBaseDir + wxFILE_SEP_PATH + category;
 }
 
 void PoeditApp::OpenNewFile()
 {
+    // macOS asks for a new file on launch, but there's no UI in batch mode:
+    if (gs_batch.IsRequested())
+        return;
+
 #ifdef __WXOSX__
     // this must be done here rather than in OnInit on macOS
     if (!gs_uriToHandle.empty())
@@ -717,7 +825,10 @@ void PoeditApp::OpenNewFile()
 
 int PoeditApp::OpenFiles(const wxArrayString& names, int lineno)
 {
+    TRACE_SPAN("startup", "OpenFiles");
+
     int opened = 0;
+    wxArrayString toLoad;
     for ( auto name: names )
     {
         // MO files cannot be opened directly in Poedit (yet), but they are
@@ -735,8 +846,31 @@ int PoeditApp::OpenFiles(const wxArrayString& names, int lineno)
             continue;
         }
 
-        if (PoeditFrame::Create(name, lineno))
+        // already open files are only brought to front:
+        if (names.size() == 1 || PoeditFrame::Find(name))
+        {
+            if (PoeditFrame::Create(name, lineno))
+                opened++;
+        }
+        else
+        {
+            toLoad.push_back(name);
+        }
+    }
+
+    // load the remaining files in parallel and open them in the same order:
+    if (toLoad.size() == 1)
+    {
+        if (PoeditFrame::Create(toLoad.front(), lineno))
+            opened++;
+    }
+    else if (!toLoad.empty())
+    {
+        for (auto& cat: PoeditFrame::PreOpenFilesWithErrorsUI(toLoad, nullptr))
         {
+            if (!cat)
+                continue;
+            PoeditFrame::Create(cat, lineno);
             opened++;
         }
     }
@@ -764,6 +898,14 @@ namespace
 const char *CL_KEEP_TEMP_FILES = "keep-temp-files";
 const char *CL_HANDLE_POEDIT_URI = "handle-poedit-uri";
 const char *CL_LINE = "line";
+const char *CL_TRACE = "trace";
+const char *CL_BATCH = "batch";
+const char *CL_IMPORT_TM = "import-tm";
+const char *CL_EXPORT_TM = "export-tm";
+const char *CL_DELETE_TM = "delete-tm";
+const char *CL_JOBS = "jobs";
+const char *CL_TIMING = "timing";
+const char *CL_STALL_THRESHOLD = "stall-threshold";
 }
 
 void PoeditApp::OnInitCmdLine(wxCmdLineParser& parser)
@@ -776,6 +918,24 @@ void PoeditApp::OnInitCmdLine(wxCmdLineParser& parser)
                      _("handle a poedit:// URI"), wxCMD_LINE_VAL_STRING);
     parser.AddLongOption(CL_LINE,
                      _("go to item at given line number"), wxCMD_LINE_VAL_NUMBER);
+    parser.AddLongOption(CL_TRACE,
+                     _("write performance trace to given file"), wxCMD_LINE_VAL_STRING);
+    parser.AddLongOption(CL_BATCH,
+                     _("run comma-separated operations (update, pretranslate, check, compile, save) on given files without UI"),
+                     wxCMD_LINE_VAL_STRING);
+    parser.AddLongOption(CL_IMPORT_TM,
+                     _("import TMX or translation file into translation memory without UI"), wxCMD_LINE_VAL_STRING);
+    parser.AddLongOption(CL_EXPORT_TM,
+                     _("export translation memory to TMX file without UI"), wxCMD_LINE_VAL_STRING);
+    parser.AddLongOption(CL_DELETE_TM,
+                     _("delete translation memory entries matching comma-separated criteria (srclang=, lang=, from=, to=, batch=) without UI"),
+                     wxCMD_LINE_VAL_STRING);
+    parser.AddLongOption(CL_JOBS,
+                     _("number of files to process in parallel in batch mode"), wxCMD_LINE_VAL_NUMBER);
+    parser.AddLongOption(CL_TIMING,
+                     _("write batch mode timings as JSON to given file"), wxCMD_LINE_VAL_STRING);
+    parser.AddLongOption(CL_STALL_THRESHOLD,
+                     _("log UI stalls longer than given number of milliseconds"), wxCMD_LINE_VAL_NUMBER);
     parser.AddParam("translation.po", wxCMD_LINE_VAL_STRING,
                     wxCMD_LINE_PARAM_OPTIONAL | wxCMD_LINE_PARAM_MULTIPLE);
 }
@@ -792,6 +952,58 @@ bool PoeditApp::OnCmdLineParsed(wxCmdLineParser& parser)
     if ( parser.Found(CL_KEEP_TEMP_FILES) )
         TempDirectory::KeepFiles();
 
+    wxString traceFile;
+    if (parser.Found(CL_TRACE, &traceFile))
+        tracing::start(traceFile);
+
+    long stallThreshold = 0;
+    if (parser.Found(CL_STALL_THRESHOLD, &stallThreshold) && stallThreshold > 0)
+    {
+        wxLog::AddTraceMask("poedit.stalls");
+        StallDetector::Start((unsigned)stallThreshold);
+    }
+
+    wxString batchOperations;
+    if (parser.Found(CL_BATCH, &batchOperations))
+    {
+        try
+        {
+            gs_batch.operations = BatchOptions::ParseOperations(batchOperations);
+        }
+        catch (...)
+        {
+            wxLogError("%s", DescribeCurrentException());
+            wxLog::FlushActive();
+            return false;
+        }
+    }
+    parser.Found(CL_IMPORT_TM, &gs_batch.importTM);
+    parser.Found(CL_EXPORT_TM, &gs_batch.exportTM);
+    parser.Found(CL_DELETE_TM, &gs_batch.deleteTM);
+    long jobs = 0;
+    if (parser.Found(CL_JOBS, &jobs))
+        gs_batch.jobs = (int)jobs;
+    parser.Found(CL_TIMING, &gs_batch.timingFile);
+
+    if (gs_batch.IsRequested())
+    {
+        // Batch processing runs independently of any Poedit window, don't
+        // hand the files over to another instance nor be one to hand over to.
+        // But if one is running, it has the TM open and it must be shared:
+#ifndef __WXOSX__
+        if (m_instanceChecker->IsAnotherRunning())
+            TMService::Connect(RemoteService());
+        m_instanceChecker.reset();
+#endif
+        for (size_t i = 0; i < parser.GetParamCount(); i++)
+        {
+            wxFileName fn(parser.GetParam(i));
+            fn.MakeAbsolute();
+            gs_batch.files.push_back(fn.GetFullPath());
+        }
+        return true;
+    }
+
 #ifndef __WXOSX__
     RemoteClient client(m_instanceChecker.get());
     switch (client.ConnectIfNeeded())
@@ -943,6 +1155,7 @@ BEGIN_EVENT_TABLE(PoeditApp, wxApp)
    EVT_MENU           (wxID_PREFERENCES,          PoeditApp::OnPreferences)
    EVT_MENU           (wxID_HELP,                 PoeditApp::OnHelp)
    EVT_MENU           (XRCID("menu_gettext_manual"), PoeditApp::OnGettextManual)
+   EVT_MENU           (XRCID("menu_memory_usage"), PoeditApp::OnMemoryUsage)
 #ifdef HAS_UPDATES_CHECK
    EVT_MENU           (XRCID("menu_check_for_updates"), PoeditApp::OnCheckForUpdates)
    EVT_UPDATE_UI      (XRCID("menu_check_for_updates"), PoeditApp::OnEnableCheckForUpdates)
@@ -1334,6 +1547,59 @@ void PoeditApp::OnGettextManual(wxCommandEvent&)
     OpenPoeditWeb("/help/gnu-gettext");
 }
 
+void PoeditApp::OnMemoryUsage(wxCommandEvent&)
+{
+    auto size = [](size_t bytes){ return wxFileName::GetHumanReadableSize(wxULongLong(bytes), "0", 1, wxSIZE_CONV_SI); };
+
+    wxString report;
+    {
+        wxBusyCursor bcur;
+        for (auto frame: PoeditFrame::GetInstances())
+        {
+            auto cat = frame->GetCatalog();
+            if (!cat)
+                continue;
+            auto usage = cat->GetMemoryUsage();
+            wxLogTrace("poedit.memory", "%s: items=%llu strings=%llu references=%llu document=%llu caches=%llu",
+                       cat->GetFileName(), (unsigned long long)usage.items, (unsigned long long)usage.strings,
+                       (unsigned long long)usage.references, (unsigned long long)usage.document, (unsigned long long)usage.caches);
+
+            report += wxFileName(cat->GetFileName()).GetFullName() + "\n";
+            report += wxString::Format(_("Total: %s"), size(usage.Total())) + "\n";
+            // TRANSLATORS: Breakdown of memory used by an open file
+            report += wxString::Format(_("Items: %s, texts: %s, references: %s, document: %s, caches: %s"),
+                                       size(usage.items), size(usage.strings), size(usage.references),
+                                       size(usage.document), size(usage.caches)) + "\n\n";
+            tracing::counter("catalog memory",
+                             {
+                                 {"items", usage.items},
+                                 {"strings", usage.strings},
+                                 {"references", usage.references},
+                                 {"document", usage.document},
+                                 {"caches", usage.caches}
+                             });
+        }
+
+        report += wxString::Format(_("Other caches: %s"), size(CacheRegistry::GetMemoryUsage())) + "\n";
+
+        try
+        {
+            report += wxString::Format(_("Translation memory caches: %s"), size(TranslationMemory::Get().GetCachesMemoryUsage())) + "\n";
+        }
+        catch (...)
+        {
+            // not available, nothing to report
+        }
+    }
+
+    if (auto peak = tracing::peak_memory_usage())
+        report += wxString::Format(_("Peak memory used by Poedit: %s"), size(peak)) + "\n";
+
+    wxMessageDialog dlg(nullptr, _("Memory used by open files"), _("Memory usage"), wxOK | wxICON_INFORMATION);
+    dlg.SetExtendedMessage(report);
+    dlg.ShowModal();
+}
+
 
 void PoeditApp::OpenPoeditWeb(const wxString& path)
 {
@@ -33,6 +33,7 @@
 #include <wx/string.h>
 #include <wx/intl.h>
 #include <wx/docview.h>
+#include <wx/timer.h>
 
 #include "prefsdlg.h"
 
@@ -56,6 +57,7 @@ class PoeditApp : public wxApp, public MenusManager
          */
         bool OnInit() override;
         void OnEventLoopEnter(wxEventLoopBase *loop) override;
+        int OnRun() override;
         int OnExit() override;
 
         wxLayoutDirection GetLayoutDirection() const override;
@@ -107,9 +109,13 @@ class PoeditApp : public wxApp, public MenusManager
     private:
         void HandleCustomURI(const wxString& uri);
 
+        /// Runs --batch processing, then terminates the app
+        void StartBatch();
+
         void SetupLanguage();
 #ifdef SUPPORTS_OTA_UPDATES
         void SetupOTALanguageUpdate(wxTranslations *trans, const Language& lang);
+        void CheckForOTALanguageUpdate(const std::string& langMO);
 #endif
 
         // App-global menu commands:
@@ -124,6 +130,7 @@ class PoeditApp : public wxApp, public MenusManager
         void OnPreferences(wxCommandEvent& event);
         void OnHelp(wxCommandEvent& event);
         void OnGettextManual(wxCommandEvent& event);
+        void OnMemoryUsage(wxCommandEvent& event);
 
         void OnQuit(wxCommandEvent& event);
 		void OnQueryEndSession(wxCloseEvent& event);
@@ -138,6 +145,10 @@ class PoeditApp : public wxApp, public MenusManager
         std::unique_ptr<PoeditPreferencesEditor> m_preferences;
         std::unique_ptr<wxLocale> m_locale;
 
+#ifdef SUPPORTS_OTA_UPDATES
+        wxTimer m_otaUpdateTimer;
+#endif
+
 #ifndef __WXOSX__
         class RemoteServer;
         class RemoteClient;
@@ -68,6 +68,7 @@
 #include "customcontrols.h"
 #include "edapp.h"
 #include "editing_area.h"
+#include "edit_journal.h"
 #include "hidpi.h"
 #include "propertiesdlg.h"
 #include "prefsdlg.h"
@@ -90,11 +91,19 @@
 #include "spellchecking.h"
 #include "static_ids.h"
 #include "str_helpers.h"
+#include "text_diff.h"
+#include "tracing.h"
 
 
 namespace
 {
 
+// How long to wait after the last edit before committing TM changes
+const int TM_IDLE_COMMIT_DELAY_MS = 30 * 1000;
+
+// How often to sync cloud-synced files in the background
+const int CLOUD_SYNC_INTERVAL_MS = 5 * 60 * 1000;
+
 /// Splitters with customized appearance to blend with EditingArea:
 class ThinSplitter : public wxSplitterWindow
 {
@@ -272,9 +281,7 @@ bool g_focusToText = false;
         if (!cat)
             return nullptr;
 
-        f = new PoeditFrame();
-        f->Show(true);
-        f->ReadCatalog(cat);
+        return Create(cat, lineno);
     }
 
     f->Show(true);
@@ -286,6 +293,14 @@ bool g_focusToText = false;
     return f;
 }
 
+/*static*/ PoeditFrame *PoeditFrame::Create(CatalogPtr catalog, int lineno)
+{
+    PoeditFrame *f = new PoeditFrame();
+    f->Show(true);
+    f->DoOpenFile(catalog, lineno);
+    return f;
+}
+
 /*static*/ PoeditFrame *PoeditFrame::CreateEmpty()
 {
     PoeditFrame *f = new PoeditFrame;
@@ -323,6 +338,10 @@ BEGIN_EVENT_TABLE(PoeditFrame, wxFrame)
    EVT_MENU           (XRCID("sort_group_by_context"), PoeditFrame::OnSortGroupByContext)
    EVT_MENU           (XRCID("sort_untrans_first"), PoeditFrame::OnSortUntranslatedFirst)
    EVT_MENU           (XRCID("sort_errors_first"), PoeditFrame::OnSortErrorsFirst)
+   EVT_MENU           (XRCID("filter_untranslated"), PoeditFrame::OnFilterByStatus)
+   EVT_MENU           (XRCID("filter_fuzzy"), PoeditFrame::OnFilterByStatus)
+   EVT_MENU           (XRCID("filter_errors"), PoeditFrame::OnFilterByStatus)
+   EVT_MENU           (XRCID("filter_reference_file"), PoeditFrame::OnFilterByReferenceFile)
    EVT_MENU           (XRCID("show_sidebar"),      PoeditFrame::OnShowHideSidebar)
    EVT_UPDATE_UI      (XRCID("show_sidebar"),      PoeditFrame::OnUpdateShowHideSidebar)
    EVT_MENU           (XRCID("show_statusbar"),    PoeditFrame::OnShowHideStatusbar)
@@ -350,6 +369,7 @@ BEGIN_EVENT_TABLE(PoeditFrame, wxFrame)
    EVT_MENU_RANGE     (WinID::ListContextReferencesStart, WinID::ListContextReferencesEnd, PoeditFrame::OnReference)
    EVT_COMMAND        (wxID_ANY, EVT_SUGGESTION_SELECTED, PoeditFrame::OnSuggestion)
    EVT_MENU           (XRCID("menu_pretranslate"), PoeditFrame::OnPreTranslateAll)
+   EVT_MENU           (XRCID("menu_analyze_tm"), PoeditFrame::OnAnalyzeTM)
    EVT_CLOSE          (PoeditFrame::OnCloseWindow)
    EVT_SIZE           (PoeditFrame::OnSize)
 
@@ -378,6 +398,7 @@ BEGIN_EVENT_TABLE(PoeditFrame, wxFrame)
    EVT_UPDATE_UI(wxID_SAVEAS,                 PoeditFrame::OnHasCatalogUpdate)
    EVT_UPDATE_UI(XRCID("menu_statistics"),    PoeditFrame::OnHasCatalogUpdate)
    EVT_UPDATE_UI(XRCID("menu_pretranslate"),  PoeditFrame::OnIsEditableUpdate)
+   EVT_UPDATE_UI(XRCID("menu_analyze_tm"),    PoeditFrame::OnIsEditableUpdate)
    EVT_UPDATE_UI(XRCID("menu_validate"),      PoeditFrame::OnIsEditableUpdate)
    EVT_UPDATE_UI(XRCID("menu_update_from_src"), PoeditFrame::OnUpdateFromSourcesUpdate)
  #ifdef HAVE_HTTP_CLIENT
@@ -426,7 +447,7 @@ public:
         }
 
         wxFileName f(files[0]);
-        if (!Catalog::CanLoadFile(f.GetExt()))
+        if (!Catalog::CanLoadFile(wxFileName(StripGzipExtension(files[0])).GetExt()))
         {
             wxLogError(_(L"File “%s” is not a translation file."),
                        f.GetFullPath().c_str());
@@ -464,7 +485,9 @@ PoeditFrame::PoeditFrame() :
     m_list(nullptr),
     m_modified(false),
     m_hasObsoleteItems(false),
-    m_setSashPositionsWhenMaximized(false)
+    m_setSashPositionsWhenMaximized(false),
+    m_isSavingInBackground(false),
+    m_closeAfterBackgroundSave(false)
 {
     m_list = nullptr;
     m_editingArea = nullptr;
@@ -472,6 +495,11 @@ PoeditFrame::PoeditFrame() :
     m_sidebarSplitter = nullptr;
     m_sidebar = nullptr;
 
+    m_tmCommitTimer.SetOwner(this);
+    Bind(wxEVT_TIMER, &PoeditFrame::OnTMCommitTimer, this, m_tmCommitTimer.GetId());
+    m_cloudSyncTimer.SetOwner(this);
+    Bind(wxEVT_TIMER, &PoeditFrame::OnCloudSyncTimer, this, m_cloudSyncTimer.GetId());
+
     wxConfigBase *cfg = wxConfig::Get();
 
     m_displayIDs = (bool)cfg->Read("display_lines", (long)false);
@@ -740,6 +768,9 @@ PoeditFrame::~PoeditFrame()
 {
     ms_instances.erase(this);
 
+    if (m_spellcheckCancellation)
+        m_spellcheckCancellation->cancel();
+
     // don't leave file references window as the only one open:
     if (ms_instances.empty() && FileViewer::GetIfExists())
         FileViewer::GetIfExists()->Close();
@@ -876,6 +907,90 @@ void PoeditFrame::InitSpellchecker()
 }
 
 
+void PoeditFrame::StartBackgroundSpellcheck()
+{
+    if (m_spellcheckCancellation)
+    {
+        m_spellcheckCancellation->cancel();
+        m_spellcheckCancellation.reset();
+    }
+
+    if (!IsSpellcheckingAvailable() || !wxConfig::Get()->ReadBool("enable_spellchecking", true))
+        return;
+
+    if (!m_catalog || !m_catalog->HasCapability(Catalog::Cap::Translations))
+        return;
+
+    auto checker = SpellChecker::Get(m_catalog->GetLanguage());
+    if (!checker)
+        return;
+
+    auto catalog = m_catalog;
+    auto cancellation = std::make_shared<dispatch::cancellation_token>();
+    m_spellcheckCancellation = cancellation;
+
+    CheckCatalogSpelling(*catalog, checker, cancellation)
+    .then_on_window(this, [=](std::vector<SpellingIssue> issues)
+    {
+        if (cancellation->is_cancelled() || catalog != m_catalog)
+            return;
+
+        int count = ApplySpellingIssues(issues);
+        wxLogTrace("poedit.spellchecking", "background spellcheck flagged %d items", count);
+        if (count && m_list)
+            m_list->RefreshAllItems();
+    })
+    .catch_all([](dispatch::exception_ptr e)
+    {
+        wxLogTrace("poedit.spellchecking", "background spellcheck failed: %s", DescribeException(e));
+    });
+}
+
+
+void PoeditFrame::StartBackgroundValidation()
+{
+    auto catalog = m_catalog;
+    wxWeakRef<PoeditFrame> self(this);
+
+    auto isCurrent = [=]{ return self && self->m_catalog == catalog; };
+
+    // the file was just loaded, it is identical to in-memory content and we can pass `fileWithSameContent`
+    catalog->ValidateInBackground(/*fileWithSameContent=*/catalog->GetFileName(),
+        [=](const CatalogItemArray& items)
+        {
+            if (!isCurrent())
+                return;
+
+            if (self->m_list)
+                self->m_list->RefreshAllItems();
+
+            auto current = self->GetCurrentItem();
+            if (current && std::find(items.begin(), items.end(), current) != items.end())
+            {
+                if (self->m_editingArea)
+                    self->m_editingArea->UpdateAuxiliaryInfo(current);
+                if (self->m_sidebar && !(self->m_list && self->m_list->HasMultipleSelection()))
+                    self->m_sidebar->SetSelectedItem(catalog, current);
+            }
+        },
+        [=](const Catalog::ValidationResults& results)
+        {
+            if (!isCurrent())
+                return;
+
+            wxLogTrace("poedit", "background validation done: %d errors, %d warnings", results.errors, results.warnings);
+
+            auto list = self->m_list;
+            if (list && list->sortOrder().errorsFirst)
+                list->Sort();
+
+            // validation resets all issues, including misspellings, so find them again:
+            self->StartBackgroundSpellcheck();
+            self->RefreshControls(Refresh_NoCatalogChanged);
+        });
+}
+
+
 void PoeditFrame::UpdateTextLanguage()
 {
     if (!m_catalog)
@@ -883,7 +998,8 @@ void PoeditFrame::UpdateTextLanguage()
 
     if (m_editingArea)
     {
-        InitSpellchecker();
+        // Loading spellchecker dictionaries is slow, don't delay showing the file:
+        CallAfter([=]{ InitSpellchecker(); StartBackgroundSpellcheck(); });
         m_editingArea->SetLanguage(m_catalog->GetLanguage());
     }
 
@@ -912,6 +1028,25 @@ void PoeditFrame::OpenFile(const wxString& filename, int lineno)
 
 // FIXME: This is ugly API and exists only to support InvokingWindowProxy hacks in edapp.cpp;
 //        Once that is cleaned up to always open in a new window even on Windows, remove all this
+namespace
+{
+
+// Must be called from a catch block
+void ShowOpenFileError(const wxString& filename, wxWindow *parent)
+{
+    wxMessageDialog dlg
+    (
+        parent,
+        wxString::Format(_(L"The file “%s” couldn’t be opened."), wxFileName(filename).GetFullName()),
+        _("Invalid file"),
+        wxOK | wxICON_ERROR
+    );
+    dlg.SetExtendedMessage(DescribeCurrentException());
+    dlg.ShowModal();
+}
+
+} // anonymous namespace
+
 CatalogPtr PoeditFrame::PreOpenFileWithErrorsUI(const wxString& filename, wxWindow *parent)
 {
     wxBusyCursor bcur;
@@ -922,20 +1057,56 @@ CatalogPtr PoeditFrame::PreOpenFileWithErrorsUI(const wxString& filename, wxWind
     }
     catch (...)
     {
-        wxMessageDialog dlg
-        (
-            parent,
-            wxString::Format(_(L"The file “%s” couldn’t be opened."), wxFileName(filename).GetFullName()),
-            _("Invalid file"),
-            wxOK | wxICON_ERROR
-        );
-        dlg.SetExtendedMessage(DescribeCurrentException());
-        dlg.ShowModal();
+        ShowOpenFileError(filename, parent);
         return nullptr;
     }
 }
 
 
+std::vector<CatalogPtr> PoeditFrame::PreOpenFilesWithErrorsUI(const wxArrayString& filenames, wxWindow *parent)
+{
+    const size_t count = filenames.size();
+    std::vector<CatalogPtr> catalogs(count);
+    std::vector<std::exception_ptr> errors(count);
+
+    // The window is modal, so it's OK to capture locals by reference:
+    wxWindowPtr<ProgressWindow> progress(new ProgressWindow(parent, _(L"Opening files…")));
+    progress->RunTaskModal([&]
+    {
+        TRACE_SPAN("ui", "PreOpenFiles");
+        Progress total((int)count);
+        dispatch::parallel_for(count, [&](size_t i)
+        {
+            try
+            {
+                catalogs[i] = Catalog::Create(filenames[i]);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+            total.increment();
+        });
+    });
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!errors[i])
+            continue;
+        try
+        {
+            std::rethrow_exception(errors[i]);
+        }
+        catch (...)
+        {
+            ShowOpenFileError(filenames[i], parent);
+        }
+    }
+
+    return catalogs;
+}
+
+
 void PoeditFrame::DoOpenFile(CatalogPtr cat, int lineno)
 {
     ReadCatalog(cat);
@@ -970,7 +1141,7 @@ void PoeditFrame::ReloadFileIfChanged()
                 if (retval == wxID_YES)
                 {
                     auto cat = PreOpenFileWithErrorsUI(m_catalog->GetFileName(), this);
-                    if (cat)
+                    if (cat && !ReadReloadedCatalogIncrementally(cat))
                         ReadCatalog(cat);
                 }
                 m_fileMonitor->StopRespondingToEvent();
@@ -982,7 +1153,7 @@ void PoeditFrame::ReloadFileIfChanged()
             // TODO: Don't display errors in this case and just silently ignore the file; load the file
             //       above before the prompt on background thread.
             auto cat = PreOpenFileWithErrorsUI(m_catalog->GetFileName(), this);
-            if (cat)
+            if (cat && !ReadReloadedCatalogIncrementally(cat))
                 ReadCatalog(cat);
             m_fileMonitor->StopRespondingToEvent();
         }
@@ -1037,6 +1208,8 @@ void PoeditFrame::DoIfCanDiscardCurrentDoc(const TFunctor1& completionHandler, c
         else if (retval == wxID_NO)
         {
             // call completion without saving the document
+            if (m_editJournal)
+                m_editJournal->Discard();
             completionHandler();
         }
         else if (retval == wxID_CANCEL)
@@ -1089,6 +1262,14 @@ wxWindowPtr<wxMessageDialog> PoeditFrame::CreateAskAboutSavingDialog()
 
 void PoeditFrame::OnCloseWindow(wxCloseEvent& event)
 {
+    if (event.CanVeto() && m_isSavingInBackground)
+    {
+        // Let the file be written first, the window is closed when it's done:
+        event.Veto();
+        m_closeAfterBackgroundSave = true;
+        return;
+    }
+
     if (event.CanVeto() && NeedsToAskIfCanDiscardCurrentDoc())
     {
 #ifdef __WXOSX__
@@ -1143,12 +1324,12 @@ void PoeditFrame::OnSave(wxCommandEvent& event)
                 dlg->ShowWindowModalThenDo([this,dlg](int retval)
                 {
                     if (retval == wxID_YES)
-                        WriteCatalog(GetFileName());
+                        WriteCatalogInBackground(GetFileName());
                 });
             }
             else
             {
-                WriteCatalog(GetFileName());
+                WriteCatalogInBackground(GetFileName());
             }
         }
     }
@@ -1212,7 +1393,7 @@ void PoeditFrame::DoSaveAs(const wxString& filename)
     if (filename.empty())
         return;
 
-    WriteCatalog(filename);
+    WriteCatalogInBackground(filename);
 }
 
 void PoeditFrame::OnSaveAs(wxCommandEvent&)
@@ -1306,6 +1487,14 @@ void PoeditFrame::ExportCatalogToHTML(const wxString& filename)
     wxWindowPtr<ProgressWindow> progress(new ProgressWindow(this, _("Exporting to HTML")));
     progress->RunTaskThenDo([=]()
     {
+        // very large files are hard to open in browsers, so split them:
+        const long pageSize = Config::HTMLExportPageSize();
+        if (pageSize > 0 && m_catalog->items().size() > (size_t)pageSize)
+        {
+            m_catalog->ExportToPaginatedHTML(filename, (size_t)pageSize);
+            return;
+        }
+
         TempOutputFileFor tempfile(filename);
         std::ofstream f;
         f.open(tempfile.FileName().fn_str());
@@ -1344,6 +1533,7 @@ void PoeditFrame::NewFromPOT(POCatalogPtr pot, Language language)
     m_catalog = catalog;
     m_pendingHumanEditedItem.reset();
     m_navigationHistory.clear();
+    m_editJournal.reset();
 
     m_fileExistsOnDisk = false;
     m_modified = true;
@@ -1414,6 +1604,7 @@ void PoeditFrame::NewFromScratch()
     m_catalog = catalog;
     m_pendingHumanEditedItem.reset();
     m_navigationHistory.clear();
+    m_editJournal.reset();
 
     m_fileExistsOnDisk = false;
     m_modified = true;
@@ -1629,17 +1820,13 @@ void PoeditFrame::UpdateCatalog(const wxString& pot_file)
         m_catalog = updated_catalog;
         m_modified = true;
 
+        // pre-translation from TM, if enabled, was already done as part of the update
         EnsureAppropriateContentView();
         NotifyCatalogChanged(m_catalog);
         RefreshControls();
 
-        if (Config::UseTM() && Config::MergeBehavior() == Merge_UseTM)
-        {
-            PreTranslateCatalogAuto(this, m_catalog, PreTranslateOptions(PreTranslate_OnlyGoodQuality), [=]
-            {
-                RefreshControls();
-            });
-        }
+        // updating typically makes many entries fuzzy, have their changes ready for browsing:
+        TextDiff::PrecomputeForOldMsgids(m_catalog);
 
         // locker gets released now and the list is redrawn
     });
@@ -1820,6 +2007,8 @@ void PoeditFrame::OnUpdateSmartUpdate(wxUpdateUIEvent& event)
 
 void PoeditFrame::OnValidate(wxCommandEvent&)
 {
+    TRACE_SPAN("ui", "Validate");
+
     try
     {
         wxBusyCursor bcur;
@@ -1841,6 +2030,8 @@ Catalog::ValidationResults PoeditFrame::ValidateCurrentFile()
         return {};
 
     auto results = m_catalog->Validate();
+    // validation resets all issues, including misspellings, so find them again:
+    StartBackgroundSpellcheck();
 
     if (m_list && m_list->sortOrder().errorsFirst)
         m_list->Sort();
@@ -1957,7 +2148,17 @@ void PoeditFrame::OnListSel(wxDataViewEvent& event)
 
     if (m_pendingHumanEditedItem)
     {
+        if (m_editJournal)
+            m_editJournal->Record(m_pendingHumanEditedItem);
         OnNewTranslationEntered(m_pendingHumanEditedItem);
+
+        // Move the edited item to its place in sorted list only after the user
+        // is done with it, and outside of selection change handling:
+        CallAfter([this, item = m_pendingHumanEditedItem]{
+            if (m_list)
+                m_list->UpdateSortForItem(item);
+        });
+
         m_pendingHumanEditedItem.reset();
     }
 
@@ -1976,7 +2177,9 @@ void PoeditFrame::OnListSel(wxDataViewEvent& event)
         if (multipleSel)
             m_sidebar->SetMultipleSelection();
         else
-            m_sidebar->SetSelectedItem(m_catalog, GetCurrentItem()); // may be nullptr
+            m_sidebar->SetSelectedItem(m_catalog, GetCurrentItem(), // may be nullptr
+                                       m_list ? m_list->GetItemsAfterCurrent(Sidebar::UPCOMING_ITEMS_COUNT)
+                                              : std::vector<CatalogItemPtr>());
     }
 
     if (hasTextFocus)
@@ -1984,7 +2187,11 @@ void PoeditFrame::OnListSel(wxDataViewEvent& event)
 
     auto references = FileViewer::GetIfExists();
     if (references)
-        references->ShowReferences(m_catalog, GetCurrentItem(), 0);
+    {
+        references->ShowReferences(m_catalog, GetCurrentItem(), 0,
+                                   m_list ? m_list->GetItemsAfterCurrent(FileViewer::PRELOAD_ITEMS_COUNT)
+                                          : std::vector<CatalogItemPtr>());
+    }
 }
 
 
@@ -2199,24 +2406,56 @@ void PoeditFrame::OnNewTranslationEntered(const CatalogItemPtr& item)
 
     if (Config::UseTM())
     {
-        auto srclang = m_catalog->GetSourceLanguage();
-        auto lang = m_catalog->GetLanguage();
-        dispatch::async([=](){
-            try
-            {
-                auto tm = TranslationMemory::Get().GetWriter();
-                tm->Insert(srclang, lang, item);
-                // Note: do *not* call tm->Commit() here, because Lucene commit is
-                // expensive. Instead, wait until the file is saved with committing
-                // the changes. This way TM updates are available immediately for use
-                // in further translations within the file, but per-item updates
-                // remain inexpensive.
-            }
-            catch (const Exception&)
-            {
-                // ignore failures here, they'll become apparent when saving the file
-            }
-        });
+        try
+        {
+            auto tm = TranslationMemory::Get().GetWriter();
+            tm->InsertLater(m_catalog->GetSourceLanguage(), m_catalog->GetLanguage(), item);
+            // Note: do *not* call tm->Commit() here, because Lucene commit is
+            // expensive. Instead, wait until the file is saved or the user stops
+            // editing for a while. This way TM updates are available soon for use
+            // in further translations within the file, but per-item updates
+            // remain inexpensive.
+            m_tmCommitTimer.StartOnce(TM_IDLE_COMMIT_DELAY_MS);
+        }
+        catch (const Exception&)
+        {
+            // ignore failures here, they'll become apparent when saving the file
+        }
+    }
+
+    if (Config::PropagateTranslations())
+        PropagateTranslation(item);
+}
+
+
+void PoeditFrame::PropagateTranslation(const CatalogItemPtr& item)
+{
+    // Items with the same source text differ in context, so the translation
+    // may not fit them; treat it the same as pre-translation from the TM:
+    const bool fuzzy = !Config::PretranslateSettings().exactNotFuzzy;
+
+    int count = 0;
+    for (auto& i: m_catalog->items())
+    {
+        if (i == item || i->IsTranslated())
+            continue;
+        if (i->HasPlural() != item->HasPlural() || i->GetString() != item->GetString())
+            continue;
+        if (item->HasPlural() && i->GetPluralString() != item->GetPluralString())
+            continue;
+
+        i->SetTranslations(item->GetTranslations());
+        i->SetFuzzy(fuzzy);
+        i->SetPreTranslated(true);
+        count++;
+    }
+
+    if (count)
+    {
+        wxLogTrace("poedit", "propagated translation to %d identical items", count);
+        if (m_list)
+            m_list->RefreshAllItems();
+        UpdateStatusBar();
     }
 }
 
@@ -2237,17 +2476,26 @@ void PoeditFrame::UpdateToTextCtrl(int flags)
 
 void PoeditFrame::ReadCatalog(const CatalogPtr& cat)
 {
+    TRACE_SPAN("ui", "ReadCatalog");
     wxASSERT( cat );
 
+    // Recover edits that weren't saved because Poedit quit unexpectedly, and
+    // start journaling new ones. A journal for an older version of the file
+    // (e.g. when reloading it after external changes) is ignored:
+    m_editJournal.reset();
+    std::vector<CatalogItemPtr> restoredEdits;
+    if (cat->HasCapability(Catalog::Cap::Translations) && !cat->GetFileName().empty())
+    {
+        restoredEdits = EditJournal::Replay(*cat);
+        m_editJournal.reset(new EditJournal(cat->GetFileName()));
+        for (auto& item: restoredEdits)
+            m_editJournal->Record(item);
+    }
+
     {
 #ifdef __WXMSW__
         wxWindowUpdateLocker no_updates(this);
 #endif
-        {
-            // the file was just loaded, it is identical to in-memory content and we can pass `fileWithSameContent`
-            cat->Validate(/*fileWithSameContent=*/cat->GetFileName());
-        }
-
         m_catalog = cat;
         m_fileMonitor->SetFile(m_catalog->GetFileName());
 
@@ -2267,13 +2515,16 @@ void PoeditFrame::ReadCatalog(const CatalogPtr& cat)
         NotifyCatalogChanged(m_catalog);
 
         m_fileExistsOnDisk = true;
-        m_modified = false;
+        m_modified = !restoredEdits.empty();
 
         UpdateEditingUIAfterChange();
         RefreshControls(Refresh_NoCatalogChanged /*done right above*/);
         UpdateTitle();
         UpdateTextLanguage();
 
+        // Don't make the user wait for QA checks and msgfmt before showing the file:
+        StartBackgroundValidation();
+
         NoteAsRecentFile();
 
         if (cat->HasCapability(Catalog::Cap::Translations))
@@ -2281,6 +2532,21 @@ void PoeditFrame::ReadCatalog(const CatalogPtr& cat)
 
         if (cat->UsesSymbolicIDsForSource())
             OfferSideloadingSourceText();
+
+        if (!restoredEdits.empty())
+        {
+            AttentionMessage msg
+                (
+                    "restored-unsaved-edits",
+                    AttentionMessage::Warning,
+                    wxString::Format(wxPLURAL("%d unsaved change from the previous session was restored.",
+                                              "%d unsaved changes from the previous session were restored.",
+                                              (int)restoredEdits.size()),
+                                     (int)restoredEdits.size())
+                );
+            msg.SetExplanation(_(L"Poedit quit before the file was saved. Save the file to keep the changes, or close it without saving to discard them."));
+            m_attentionBar->ShowMessage(msg);
+        }
     }
 
     // Can't do this with the window being frozen, because positioning the toolbar
@@ -2292,11 +2558,55 @@ void PoeditFrame::ReadCatalog(const CatalogPtr& cat)
     }
 
     UpdateCloudSyncUI(CanSyncWithCrowdin(m_catalog));
+
+    if (m_catalog->GetCloudSync() && CloudAccountClient::ExtractSyncMetadataIfAny(*m_catalog))
+        m_cloudSyncTimer.Start(CLOUD_SYNC_INTERVAL_MS);
+    else
+        m_cloudSyncTimer.Stop();
 #endif
 
     FixDuplicatesIfPresent();
 }
 
+bool PoeditFrame::ReadReloadedCatalogIncrementally(const CatalogPtr& cat)
+{
+    // Only PO items are self-contained and can be moved between catalogs;
+    // sideloaded source text would have to be reattached to new items too.
+    auto current = std::dynamic_pointer_cast<POCatalog>(m_catalog);
+    auto reloaded = std::dynamic_pointer_cast<POCatalog>(cat);
+    if (!current || !reloaded || current->HasSideloadedReferenceFile())
+        return false;
+
+    std::vector<int> changedItems;
+    if (!current->UpdateFromReloaded(*reloaded, changedItems))
+        return false;
+
+    wxLogTrace("poedit", "reloaded file incrementally, %d items changed", (int)changedItems.size());
+
+    // the file was just loaded, it is identical to in-memory content and we can pass `fileWithSameContent`
+    m_catalog->Validate(/*fileWithSameContent=*/m_catalog->GetFileName());
+    StartBackgroundSpellcheck();
+
+    m_fileExistsOnDisk = true;
+    m_modified = false;
+    m_pendingHumanEditedItem.reset();
+    if (m_editJournal)
+        m_editJournal->Discard();
+
+    // Items are all in the same place, so the list's sorting and selection
+    // remain valid and only the rows need to be redrawn (validation may
+    // have changed any of them, not just the changed items):
+    if (m_list)
+        m_list->RefreshAllItems();
+    if (m_sidebar && !(m_list && m_list->HasMultipleSelection()))
+        m_sidebar->SetSelectedItem(m_catalog, GetCurrentItem());
+
+    UpdateEditingUIAfterChange();
+    RefreshControls(Refresh_NoCatalogChanged);
+
+    return true;
+}
+
 void PoeditFrame::FixDuplicatesIfPresent()
 {
     wxASSERT_MSG( IsShown(), "this method may show UI error, which requires the window to be visible" );
@@ -2555,8 +2865,21 @@ void PoeditFrame::MarkAsModified()
 }
 
 
+void PoeditFrame::OnItemsModifiedInBulk(bool currentItemChanged)
+{
+    MarkAsModified();
+    UpdateStatusBar();
+
+    m_list->RefreshAllItems();
+    if (currentItemChanged)
+        UpdateToTextCtrl(EditingArea::UndoableEdit);
+}
+
+
 void PoeditFrame::RefreshControls(int flags)
 {
+    TRACE_SPAN("ui", "RefreshControls");
+
     if (!m_catalog)
         return;
 
@@ -2586,6 +2909,10 @@ void PoeditFrame::NotifyCatalogChanged(const CatalogPtr& cat)
     m_pendingHumanEditedItem.reset();
     m_navigationHistory.clear();
 
+    // have the index ready for filtering by source file:
+    if (cat)
+        cat->PrepareReferencesIndex();
+
     if (m_sidebar)
         m_sidebar->ResetCatalog();
     if (m_list)
@@ -2742,6 +3069,10 @@ void PoeditFrame::UpdateMenu()
     menubar->Enable(XRCID("sort_group_by_context"), nonEmpty);
     menubar->Enable(XRCID("sort_untrans_first"), editable);
     menubar->Enable(XRCID("sort_errors_first"), editable);
+    menubar->Enable(XRCID("filter_untranslated"), editable);
+    menubar->Enable(XRCID("filter_fuzzy"), editable);
+    menubar->Enable(XRCID("filter_errors"), editable);
+    menubar->Enable(XRCID("filter_reference_file"), nonEmpty);
 
     if (m_list)
         m_list->Enable(nonEmpty);
@@ -2770,6 +3101,112 @@ void PoeditFrame::UpdateCloudSyncUI(bool isCrowdin)
 }
 
 
+namespace
+{
+
+// Commits pending writes made in OnNewTranslationEntered() in the background
+dispatch::future<void> CommitTranslationMemory(const CatalogPtr& catalog)
+{
+    if (!Config::UseTM() || !catalog->HasCapability(Catalog::Cap::Translations))
+        return dispatch::future<void>();
+
+    return dispatch::async([=]{
+        try
+        {
+            auto tm = TranslationMemory::Get().GetWriter();
+            tm->Commit();
+        }
+        catch ( const Exception& e )
+        {
+            wxLogWarning(_("Failed to update translation memory: %s"), e.What());
+        }
+        catch ( ... )
+        {
+            wxLogWarning(_("Failed to update translation memory: %s"), "unknown error");
+        }
+    });
+}
+
+void UpdateTranslatorInHeader(const CatalogPtr& catalog)
+{
+    if (catalog->GetFileType() == Catalog::Type::PO)
+    {
+        Catalog::HeaderData& dt = catalog->Header();
+        dt.Translator = wxConfig::Get()->Read("translator_name", dt.Translator);
+        dt.TranslatorEmail = wxConfig::Get()->Read("translator_email", dt.TranslatorEmail);
+    }
+}
+
+} // anonymous namespace
+
+
+void PoeditFrame::OnTMCommitTimer(wxTimerEvent&)
+{
+    if (m_catalog)
+        CommitTranslationMemory(m_catalog);
+}
+
+
+void PoeditFrame::OnCloudSyncTimer(wxTimerEvent&)
+{
+#ifdef HAVE_HTTP_CLIENT
+    if (!m_catalog || !m_catalog->GetCloudSync() || m_isCloudSyncingInBackground || m_isSavingInBackground)
+        return;
+
+    auto meta = CloudAccountClient::ExtractSyncMetadataIfAny(*m_catalog);
+    if (!meta)
+        return;
+    auto account = &CloudAccountClient::GetFor(*meta);
+    if (!account->IsSignedIn())
+        return; // don't nag about signing in, syncing on save does that
+
+    m_isCloudSyncingInBackground = true;
+
+    auto catalog = m_catalog;
+    auto tmpdir = std::make_shared<TempDirectory>();
+    auto outfile = tmpdir->CreateFileName("remote." + wxFileName(catalog->GetFileName()).GetExt());
+
+    wxWeakRef<PoeditFrame> self(this);
+    auto reset = [self]
+    {
+        if (self)
+            self->m_isCloudSyncingInBackground = false;
+    };
+
+    account->DownloadCatalog(outfile.ToStdWstring(), meta)
+    .then_on_window(this, [=](CatalogPtr remote)
+    {
+        tmpdir->Clear();
+
+        // the file was closed or reloaded in the meantime:
+        if (catalog != m_catalog)
+            return dispatch::make_ready_future();
+
+        std::vector<CatalogItemPtr> updated;
+        int conflicts = 0;
+        if (CloudAccountClient::MergeRemoteChanges(*catalog, *remote, *meta, updated, conflicts))
+        {
+            wxLogTrace("poedit.cloud", "background sync: %d items updated, %d conflicting local edits kept", (int)updated.size(), conflicts);
+            if (!updated.empty())
+            {
+                auto current = GetCurrentItem();
+                OnItemsModifiedInBulk(std::find(updated.begin(), updated.end(), current) != updated.end());
+            }
+        }
+
+        // push local edits, including the conflicting ones:
+        return account->UploadChanges(catalog, meta);
+    })
+    .then_on_main(reset)
+    .catch_all([=](dispatch::exception_ptr e)
+    {
+        wxLogTrace("poedit.cloud", "background sync failed: %s", DescribeException(e));
+        reset();
+    });
+#endif // HAVE_HTTP_CLIENT
+}
+
+
 void PoeditFrame::WriteCatalog(const wxString& catalog)
 {
     WriteCatalog(catalog, [](bool){});
@@ -2778,41 +3215,24 @@ void PoeditFrame::WriteCatalog(const wxString& catalog)
 template<typename TFunctor>
 void PoeditFrame::WriteCatalog(const wxString& catalog, TFunctor completionHandler)
 {
+    TRACE_SPAN("ui", "WriteCatalog");
     wxBusyCursor bcur;
 
-    dispatch::future<void> tmUpdateThread;
-    if (Config::UseTM() && m_catalog->HasCapability(Catalog::Cap::Translations))
-    {
-        tmUpdateThread = dispatch::async([=]{
-            try
-            {
-                // Commit pending writes made in OnNewTranslationEntered():
-                auto tm = TranslationMemory::Get().GetWriter();
-                tm->Commit();
-            }
-            catch ( const Exception& e )
-            {
-                wxLogWarning(_("Failed to update translation memory: %s"), e.What());
-            }
-            catch ( ... )
-            {
-                wxLogWarning(_("Failed to update translation memory: %s"), "unknown error");
-            }
-        });
-    }
+    m_tmCommitTimer.Stop();
+    dispatch::future<void> tmUpdateThread = CommitTranslationMemory(m_catalog);
 
-    if (m_catalog->GetFileType() == Catalog::Type::PO)
-    {
-        Catalog::HeaderData& dt = m_catalog->Header();
-        dt.Translator = wxConfig::Get()->Read("translator_name", dt.Translator);
-        dt.TranslatorEmail = wxConfig::Get()->Read("translator_email", dt.TranslatorEmail);
-    }
+    UpdateTranslatorInHeader(m_catalog);
 
+    // unfinished background save, if any, is superseded by this one:
+    m_backgroundSaveGuard.reset();
     FileMonitor::WritingGuard guard(*m_fileMonitor);
 
     Catalog::ValidationResults validation_results;
     Catalog::CompilationStatus mo_compilation_status = Catalog::CompilationStatus::NotDone;
 
+    if (m_editJournal)
+        m_editJournal->BeginSave();
+
     bool was_ok = false;
     try
     {
@@ -2832,19 +3252,115 @@ void PoeditFrame::WriteCatalog(const wxString& catalog, TFunctor completionHandl
         dlg.ShowModal();
     }
 
+    if (tmUpdateThread.valid())
+        tmUpdateThread.wait();
+
+    if (m_editJournal)
+        m_editJournal->EndSave(was_ok, catalog);
+
     if (!was_ok)
     {
-        if (tmUpdateThread.valid())
-            tmUpdateThread.wait();
         completionHandler(false);
         return;
     }
 
-    m_catalog->SetFileName(catalog);
     m_modified = false;
+    OnCatalogWritten(catalog, validation_results, mo_compilation_status, completionHandler);
+}
+
+
+void PoeditFrame::WriteCatalogInBackground(const wxString& catalog)
+{
+    auto po = std::dynamic_pointer_cast<POCatalog>(m_catalog);
+    if (!po)
+    {
+        WriteCatalog(catalog);
+        return;
+    }
+
+    if (m_isSavingInBackground)
+    {
+        // save again, with changes made since, once the current save finishes:
+        m_queuedBackgroundSave = catalog;
+        return;
+    }
+
+    // TM is updated independently of writing the file, no need to wait for it:
+    m_tmCommitTimer.Stop();
+    CommitTranslationMemory(m_catalog);
+
+    UpdateTranslatorInHeader(m_catalog);
+
+    m_isSavingInBackground = true;
+    m_backgroundSaveGuard.reset(new FileMonitor::WritingGuard(*m_fileMonitor));
+
+    // Edits made while the file is being written aren't included in it
+    // and mark the document as modified again:
+    const bool wasModified = m_modified;
+    m_modified = false;
+    UpdateTitle();
+
+    if (m_editJournal)
+        m_editJournal->BeginSave();
+
+    wxWeakRef<PoeditFrame> self(this);
+    po->SaveInBackground(catalog, /*save_mo=*/true,
+                         [=](bool ok, const Catalog::ValidationResults& validation_results, Catalog::CompilationStatus mo_compilation_status)
+    {
+        if (!self)
+            return;
+
+        m_isSavingInBackground = false;
+
+        // the window may show another file by now:
+        if (po == m_catalog)
+        {
+            if (m_editJournal)
+                m_editJournal->EndSave(ok, catalog);
+
+            if (ok)
+            {
+                OnCatalogWritten(catalog, validation_results, mo_compilation_status, [](bool){});
+            }
+            else
+            {
+                m_modified = m_modified || wasModified;
+                UpdateTitle();
+            }
+        }
+
+        m_backgroundSaveGuard.reset();
+
+        if (m_closeAfterBackgroundSave)
+        {
+            m_closeAfterBackgroundSave = false;
+            m_queuedBackgroundSave.clear();
+            Close();
+        }
+        else if (!m_queuedBackgroundSave.empty())
+        {
+            const wxString fn = m_queuedBackgroundSave;
+            m_queuedBackgroundSave.clear();
+            WriteCatalogInBackground(fn);
+        }
+    });
+}
+
+
+template<typename TFunctor>
+void PoeditFrame::OnCatalogWritten(const wxString& catalog,
+                                   const Catalog::ValidationResults& validation_results,
+                                   Catalog::CompilationStatus mo_compilation_status,
+                                   TFunctor completionHandler)
+{
+    m_catalog->SetFileName(catalog);
     m_fileExistsOnDisk = true;
     m_fileMonitor->SetFile(m_catalog->GetFileName());
 
+    // files created in Poedit are journaled once they exist on disk:
+    if (!m_editJournal && m_catalog->HasCapability(Catalog::Cap::Translations))
+        m_editJournal.reset(new EditJournal(catalog));
+
     UpdateTitle();
 
     RefreshControls();
@@ -2859,9 +3375,6 @@ void PoeditFrame::WriteCatalog(const wxString& catalog, TFunctor completionHandl
         CloudSyncProgressWindow::RunSync(this, m_catalog->GetCloudSync(), m_catalog);
     }
 
-    if (tmUpdateThread.valid())
-        tmUpdateThread.wait();
-
     if (m_list && m_list->sortOrder().errorsFirst)
         m_list->Sort();
 
@@ -2935,8 +3448,25 @@ void PoeditFrame::OnRemoveSameAsSourceTranslations(wxCommandEvent&)
 {
     const wxString title =
         _("Remove same-as-source translations");
+
+    // find affected items first, so that the user knows what they are confirming:
+    int count;
+    {
+        wxBusyCursor bcur;
+        count = (int)m_catalog->FindSameAsSourceTranslations().size();
+    }
+
+    if (!count)
+    {
+        wxWindowPtr<wxMessageDialog> dlg(new wxMessageDialog(this, _("There are no translations identical to the source text."), title, wxOK | wxICON_INFORMATION));
+        dlg->ShowWindowModalThenDo([dlg](int){});
+        return;
+    }
+
     const wxString main =
-        _("Do you want to remove all translations that are identical to the source text?");
+        wxString::Format(wxPLURAL("Do you want to remove %d translation that is identical to the source text?",
+                                  "Do you want to remove %d translations that are identical to the source text?",
+                                  count), count);
     const wxString details = _("This action will delete any translations that match the source text exactly. This cannot be undone.");
 
     wxWindowPtr<wxMessageDialog> dlg(new wxMessageDialog(this, main, title, wxYES_NO | wxICON_QUESTION));
@@ -2959,10 +3489,14 @@ void PoeditFrame::OnRemoveSameAsSourceTranslations(wxCommandEvent&)
 
 void PoeditFrame::OnPurgeDeleted(wxCommandEvent& WXUNUSED(event))
 {
+    const int count = m_catalog->GetDeletedItemsCount();
+
     const wxString title =
         _("Purge deleted translations");
     const wxString main =
-        _("Do you want to remove all translations that are no longer used?");
+        wxString::Format(wxPLURAL("Do you want to remove %d translation that is no longer used?",
+                                  "Do you want to remove %d translations that are no longer used?",
+                                  count), count);
     const wxString details =
         _("If you continue with purging, all translations marked as deleted will be permanently removed. You will have to translate them again if they are added back in the future.");
 
@@ -2972,6 +3506,7 @@ void PoeditFrame::OnPurgeDeleted(wxCommandEvent& WXUNUSED(event))
 
     dlg->ShowWindowModalThenDo([this,dlg](int retcode){
         if (retcode == wxID_YES) {
+            wxBusyCursor bcur;
             m_catalog->RemoveDeletedItems();
             m_modified = true;
             UpdateTitle();
@@ -3015,6 +3550,12 @@ void PoeditFrame::OnPreTranslateAll(wxCommandEvent&)
 }
 
 
+void PoeditFrame::OnAnalyzeTM(wxCommandEvent&)
+{
+    AnalyzeTMLeverageWithUI(this, m_catalog);
+}
+
+
 wxMenu *PoeditFrame::CreatePopupMenu(int item)
 {
     if (!m_catalog) return NULL;
@@ -3236,6 +3777,44 @@ void PoeditFrame::OnSortErrorsFirst(wxCommandEvent& event)
 }
 
 
+void PoeditFrame::OnFilterByStatus(wxCommandEvent&)
+{
+    auto menubar = GetMenuBar();
+    int status = ItemsFilter::Status_Any;
+    if (menubar->IsChecked(XRCID("filter_untranslated")))
+        status |= ItemsFilter::Status_Untranslated;
+    if (menubar->IsChecked(XRCID("filter_fuzzy")))
+        status |= ItemsFilter::Status_Fuzzy;
+    if (menubar->IsChecked(XRCID("filter_errors")))
+        status |= ItemsFilter::Status_Errors;
+
+    m_list->filter().SetStatus(status);
+    m_list->ApplyFilter();
+}
+
+void PoeditFrame::OnFilterByReferenceFile(wxCommandEvent& event)
+{
+    wxString file;
+    if (event.IsChecked())
+    {
+        // use the file of the current item's first reference:
+        auto item = GetCurrentItem();
+        auto refs = item ? item->GetReferences() : wxArrayString();
+        if (refs.empty())
+        {
+            wxBell();
+            GetMenuBar()->Check(event.GetId(), false);
+            return;
+        }
+        int line;
+        CatalogReferencesIndex::ParseReference(refs[0], file, line);
+    }
+
+    m_list->filter().SetReferenceFile(file);
+    m_list->ApplyFilter();
+}
+
+
 void PoeditFrame::OnShowHideSidebar(wxCommandEvent&)
 {
     bool toShow = !m_sidebarSplitter->IsSplit();
@@ -3412,6 +3991,16 @@ int PoeditFrame::NavigateGetNextItem(const int start,
     if ( !count )
         return -1;
 
+    if ( predicate == Pred_UnfinishedItem && (step == 1 || step == -1) )
+    {
+        // use the list's bitmap of unfinished rows instead of examining the
+        // items one by one, most of them are typically finished
+        const int i = m_list->FindUnfinishedListIndex(start, step, wrap);
+        if ( i != -1 && out_item )
+            *out_item = m_list->ListIndexToCatalogItem(i);
+        return i;
+    }
+
     int i = start;
 
     for ( ;; )
@@ -31,6 +31,7 @@
 
 #include <wx/frame.h>
 #include <wx/process.h>
+#include <wx/timer.h>
 #include <wx/msgdlg.h>
 #include <wx/windowptr.h>
 
@@ -39,6 +40,7 @@ class WXDLLIMPEXP_FWD_CORE wxSplitterEvent;
 
 #include "catalog.h"
 #include "catalog_po.h"
+#include "concurrency.h"
 #include "gexecute.h"
 #include "edlistctrl.h"
 #include "edapp.h"
@@ -58,6 +60,7 @@ class FindFrame;
 class MainToolbar;
 class Sidebar;
 class EditingArea;
+class EditJournal;
 
 /** This class provides main editing frame. It handles user's input
     and provides frontend to catalog editing engine. Nothing fancy.
@@ -74,6 +77,9 @@ class PoeditFrame : public PoeditFrameBase
          */
         static PoeditFrame *Create(const wxString& catalog, int lineno = 0);
 
+        /// Creates and shows frame for already loaded @a catalog.
+        static PoeditFrame *Create(CatalogPtr catalog, int lineno = 0);
+
         /** Public constructor functions. Creates and shows frame
             without catalog or other content.
          */
@@ -85,6 +91,13 @@ class PoeditFrame : public PoeditFrameBase
 
         static CatalogPtr PreOpenFileWithErrorsUI(const wxString& filename, wxWindow *parent);
 
+        /**
+            Like PreOpenFileWithErrorsUI(), but loads all @a filenames in
+            parallel, showing their combined progress. Returned catalogs
+            are in the same order, with nullptr for files that failed to load.
+         */
+        static std::vector<CatalogPtr> PreOpenFilesWithErrorsUI(const wxArrayString& filenames, wxWindow *parent);
+
         // Opens given file in this frame, without asking user
         void DoOpenFile(CatalogPtr cat, int lineno = 0);
 
@@ -111,12 +124,19 @@ class PoeditFrame : public PoeditFrameBase
 
         /// Reads catalog, refreshes controls, takes ownership of catalog.
         void ReadCatalog(const CatalogPtr& cat);
+        /// Like ReadCatalog() for a reloaded version of the current file, but only
+        /// updates changed items if possible. Returns false if full reload is needed.
+        bool ReadReloadedCatalogIncrementally(const CatalogPtr& cat);
         /// Writes catalog.
         void WriteCatalog(const wxString& catalog);
 
         template<typename TFunctor>
         void WriteCatalog(const wxString& catalog, TFunctor completionHandler);
 
+        /// Writes catalog without blocking the UI, if possible. Further
+        /// edits can be made while the file is being written.
+        void WriteCatalogInBackground(const wxString& catalog);
+
         void FixDuplicatesIfPresent();
         void WarnAboutLanguageIssues();
         void SideloadSourceTextFromFile(const wxFileName& fn);
@@ -127,6 +147,11 @@ class PoeditFrame : public PoeditFrameBase
 
         void MarkAsModified();
 
+        /** Updates the UI after many items were modified at once, e.g. by
+            Replace All, and marks the catalog as modified.
+         */
+        void OnItemsModifiedInBulk(bool currentItemChanged);
+
         /** Updates catalog and sets m_modified flag. Updates from POT
             if \a pot_file is not empty and from sources otherwise.
          */
@@ -149,6 +174,7 @@ class PoeditFrame : public PoeditFrameBase
 
         wxString GetFileName() const
             { return m_catalog ? m_catalog->GetFileName() : wxString(); }
+        CatalogPtr GetCatalog() const { return m_catalog; }
         wxString GetFileNamePartOfTitle() const
             { return m_fileNamePartOfTitle; }
 
@@ -234,6 +260,10 @@ class PoeditFrame : public PoeditFrameBase
 
         // (Re)initializes spellchecker, if needed
         void InitSpellchecker();
+        // Checks spelling of all translations in the background, flagging misspellings as issues
+        void StartBackgroundSpellcheck();
+        // Validates the just loaded file in the background, showing issues as they are found
+        void StartBackgroundValidation();
 
         void RecordItemToNavigationHistory(const CatalogItemPtr& item);
 
@@ -308,6 +338,8 @@ private:
         void OnSortGroupByContext(wxCommandEvent&);
         void OnSortUntranslatedFirst(wxCommandEvent&);
         void OnSortErrorsFirst(wxCommandEvent&);
+        void OnFilterByStatus(wxCommandEvent&);
+        void OnFilterByReferenceFile(wxCommandEvent&);
 
         void OnShowHideSidebar(wxCommandEvent& event);
         void OnUpdateShowHideSidebar(wxUpdateUIEvent& event);
@@ -331,6 +363,7 @@ private:
 
         void OnSuggestion(wxCommandEvent& event);
         void OnPreTranslateAll(wxCommandEvent& event);
+        void OnAnalyzeTM(wxCommandEvent& event);
 
         void OnRemoveSameAsSourceTranslations(wxCommandEvent& event);
         void OnPurgeDeleted(wxCommandEvent& event);
@@ -345,6 +378,13 @@ private:
 
         Catalog::ValidationResults ValidateCurrentFile();
 
+        // Updates UI after the catalog was successfully written
+        template<typename TFunctor>
+        void OnCatalogWritten(const wxString& catalog,
+                              const Catalog::ValidationResults& validation_results,
+                              Catalog::CompilationStatus mo_compilation_status,
+                              TFunctor completionHandler);
+
         template<typename TFunctor>
         void ReportValidationErrors(Catalog::ValidationResults validation,
                                     Catalog::CompilationStatus mo_compilation_status,
@@ -354,6 +394,9 @@ private:
         void NoteAsRecentFile();
 
         void OnNewTranslationEntered(const CatalogItemPtr& item);
+        void PropagateTranslation(const CatalogItemPtr& item);
+        void OnTMCommitTimer(wxTimerEvent& event);
+        void OnCloudSyncTimer(wxTimerEvent& event);
 
         DECLARE_EVENT_TABLE()
 
@@ -382,6 +425,25 @@ private:
         bool m_hasObsoleteItems;
         bool m_displayIDs;
         bool m_setSashPositionsWhenMaximized;
+
+        // state of WriteCatalogInBackground():
+        bool m_isSavingInBackground;
+        bool m_closeAfterBackgroundSave;
+        wxString m_queuedBackgroundSave;
+        std::unique_ptr<FileMonitor::WritingGuard> m_backgroundSaveGuard;
+
+        // journal of edits not saved yet, for recovery after crashes
+        std::unique_ptr<EditJournal> m_editJournal;
+
+        // cancels running StartBackgroundSpellcheck() when it is restarted
+        dispatch::cancellation_token_ptr m_spellcheckCancellation;
+
+        // commits TM changes made while editing after a period of inactivity
+        wxTimer m_tmCommitTimer;
+
+        // periodically merges remote changes of cloud-synced files and pushes local ones
+        wxTimer m_cloudSyncTimer;
+        bool m_isCloudSyncingInBackground = false;
 };
 
 
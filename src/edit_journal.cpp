@@ -0,0 +1,364 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "edit_journal.h"
+
+#include "concurrency.h"
+#include "json.h"
+#include "str_helpers.h"
+#include "utility.h"
+
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+#include <wx/utils.h>
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+
+namespace
+{
+
+// Increment whenever the format of records changes; journals in other formats are ignored
+const int JOURNAL_FORMAT_VERSION = 1;
+
+wxString GetJournalsDir()
+{
+    // kept with other user data, not in the cache directory, because the
+    // journal may be the only copy of the user's work:
+    return GetUserDataDir() + wxFILE_SEP_PATH + "Journals";
+}
+
+std::wstring GetJournalFile(const wxString& filename)
+{
+    const auto path = str::to_utf8(MakeFileName(filename).GetFullPath());
+    const auto name = wxString::Format("%016llx.journal", (unsigned long long)HashFNV1a(path.data(), path.size()));
+    return (GetJournalsDir() + wxFILE_SEP_PATH + name).ToStdWstring();
+}
+
+// Identifies version of the catalog file that the journal's edits were made to
+json FileIdentity(const wxString& filename)
+{
+    wxFileName fn(filename);
+    auto mtime = fn.GetModificationTime();
+    auto size = fn.GetSize();
+    return
+    {
+        {"size", size == wxInvalidSize ? 0 : (uint64_t)size.GetValue()},
+        {"mtime", mtime.IsValid() ? (int64_t)mtime.GetValue().GetValue() : 0}
+    };
+}
+
+std::string ItemKey(const wxString& context, const wxString& source, const wxString& plural, const wxString& symbolicId)
+{
+    std::string key = str::to_utf8(context);
+    key += '\x04';
+    key += str::to_utf8(source);
+    key += '\0';
+    key += str::to_utf8(plural);
+    key += '\0';
+    key += str::to_utf8(symbolicId);
+    return key;
+}
+
+std::string ItemKey(const CatalogItem& item)
+{
+    return ItemKey(item.GetContext(), item.GetRawString(), item.GetRawPluralString(), item.GetRawSymbolicId());
+}
+
+wxString GetStringValue(const json& j, const char *key)
+{
+    return str::to_wx(get_value<std::string>(j, key, std::string()));
+}
+
+} // anonymous namespace
+
+
+/**
+    Shared state of the journal and the background task that writes it.
+
+    Writes are performed by at most one task at a time, in the order in which
+    they were queued, and the file is only accessed from that task.
+ */
+struct EditJournal::State : public std::enable_shared_from_this<EditJournal::State>
+{
+    struct Op
+    {
+        enum Kind { Append, Reset, Remove };
+        Kind kind;
+        std::wstring path;
+        std::string data;
+    };
+
+    void Enqueue(Op&& op)
+    {
+        bool start;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(std::move(op));
+            start = !writing;
+            writing = true;
+        }
+        if (start)
+            dispatch::async([self = shared_from_this()]{ self->Drain(); });
+    }
+
+    void WaitUntilIdle()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]{ return !writing; });
+    }
+
+private:
+    void Drain()
+    {
+        for (;;)
+        {
+            std::vector<Op> ops;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (pending.empty())
+                {
+                    writing = false;
+                    idle.notify_all();
+                    return;
+                }
+                ops.swap(pending);
+            }
+
+            wxLogNull null; // failures only cost durability, don't bother the user
+            for (auto& op: ops)
+                Perform(op);
+            if (file.IsOpened())
+                file.Flush();
+        }
+    }
+
+    void Perform(const Op& op)
+    {
+        if (file.IsOpened() && (op.kind != Op::Append || op.path != openPath))
+            file.Close();
+
+        const wxString path(op.path);
+        switch (op.kind)
+        {
+            case Op::Remove:
+                if (wxFileName::FileExists(path))
+                    wxRemoveFile(path);
+                return;
+
+            case Op::Reset:
+                wxFileName::Mkdir(wxFileName(path).GetPath(), wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
+                if (!file.Open(path, wxFile::write))
+                {
+                    wxLogTrace("poedit.journal", "failed to create journal %s", path);
+                    return;
+                }
+                openPath = op.path;
+                break;
+
+            case Op::Append:
+                if (!file.IsOpened())
+                {
+                    if (!file.Open(path, wxFile::write_append))
+                    {
+                        wxLogTrace("poedit.journal", "failed to open journal %s", path);
+                        return;
+                    }
+                    openPath = op.path;
+                }
+                break;
+        }
+
+        if (!file.Write(op.data.data(), op.data.size()))
+            wxLogTrace("poedit.journal", "failed to write to journal %s", path);
+    }
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::vector<Op> pending;
+    bool writing = false;
+
+    wxFile file;
+    std::wstring openPath;
+};
+
+
+EditJournal::EditJournal(const wxString& filename)
+    : m_state(std::make_shared<State>()),
+      m_filename(filename),
+      m_needsHeader(true),
+      m_saving(false)
+{
+    // edits in an existing journal were either replayed already or are stale:
+    m_state->Enqueue({State::Op::Remove, GetJournalFile(m_filename), {}});
+}
+
+
+EditJournal::~EditJournal()
+{
+    // don't let another journal for the same file race with pending writes:
+    m_state->WaitUntilIdle();
+}
+
+
+void EditJournal::Record(const CatalogItemPtr& item)
+{
+    if (m_saving)
+        m_editedDuringSave.push_back(item);
+
+    json record = {{"id", str::to_utf8(item->GetRawString())}};
+    if (!item->GetContext().empty())
+        record["ctx"] = str::to_utf8(item->GetContext());
+    if (item->HasPlural())
+        record["plural"] = str::to_utf8(item->GetRawPluralString());
+    auto symbolicId = item->GetRawSymbolicId();
+    if (!symbolicId.empty())
+        record["symid"] = str::to_utf8(symbolicId);
+
+    auto translations = json::array();
+    for (auto& t: item->GetTranslations())
+        translations.push_back(str::to_utf8(t));
+    record["trans"] = std::move(translations);
+    record["fuzzy"] = item->IsFuzzy();
+    record["pretranslated"] = item->IsPreTranslated();
+
+    // JSON output has newlines escaped, so every record is a single line and a
+    // record truncated by a crash can be recognized and ignored:
+    std::string data;
+    auto kind = State::Op::Append;
+    if (m_needsHeader)
+    {
+        json header = FileIdentity(m_filename);
+        header["journal"] = JOURNAL_FORMAT_VERSION;
+        data = header.dump() + '\n';
+        kind = State::Op::Reset;
+        m_needsHeader = false;
+    }
+    data += record.dump() + '\n';
+
+    m_state->Enqueue({kind, GetJournalFile(m_filename), std::move(data)});
+}
+
+
+void EditJournal::BeginSave()
+{
+    m_saving = true;
+    m_editedDuringSave.clear();
+}
+
+
+void EditJournal::EndSave(bool ok, const wxString& filename)
+{
+    m_saving = false;
+    auto edited = std::move(m_editedDuringSave);
+    m_editedDuringSave.clear();
+    if (!ok)
+        return;
+
+    Discard();
+    m_filename = filename;
+
+    std::unordered_set<CatalogItem*> seen;
+    for (auto& item: edited)
+    {
+        if (seen.insert(item.get()).second)
+            Record(item);
+    }
+}
+
+
+void EditJournal::Discard()
+{
+    m_state->Enqueue({State::Op::Remove, GetJournalFile(m_filename), {}});
+    m_needsHeader = true;
+}
+
+
+std::vector<CatalogItemPtr> EditJournal::Replay(Catalog& catalog)
+{
+    std::vector<CatalogItemPtr> restored;
+
+    const wxString path(GetJournalFile(catalog.GetFileName()));
+    if (!wxFileName::FileExists(path))
+        return restored;
+
+    std::ifstream f(path.fn_str(), std::ios::binary);
+    std::string line;
+    if (!std::getline(f, line))
+        return restored;
+
+    auto header = json::parse(line, nullptr, /*allow_exceptions=*/false);
+    const auto identity = FileIdentity(catalog.GetFileName());
+    if (header.is_discarded() || !header.is_object() ||
+        get_value<int>(header, "journal", 0) != JOURNAL_FORMAT_VERSION ||
+        get_value<uint64_t>(header, "size", 0) != identity["size"].get<uint64_t>() ||
+        get_value<int64_t>(header, "mtime", 0) != identity["mtime"].get<int64_t>())
+    {
+        wxLogTrace("poedit.journal", "ignoring journal for %s, the file changed since", catalog.GetFileName());
+        return restored;
+    }
+
+    std::unordered_map<std::string, CatalogItemPtr> items;
+    for (auto& item: catalog.items())
+        items.emplace(ItemKey(*item), item);
+
+    std::unordered_set<CatalogItem*> seen;
+    int ignored = 0;
+    while (std::getline(f, line))
+    {
+        auto record = json::parse(line, nullptr, /*allow_exceptions=*/false);
+        if (record.is_discarded() || !record.is_object())
+            break; // incomplete last record, written when the app crashed
+
+        auto i = items.find(ItemKey(GetStringValue(record, "ctx"), GetStringValue(record, "id"),
+                                    GetStringValue(record, "plural"), GetStringValue(record, "symid")));
+        auto trans = record.find("trans");
+        if (i == items.end() || trans == record.end() || !trans->is_array())
+        {
+            ignored++;
+            continue;
+        }
+
+        auto& item = i->second;
+        wxArrayString translations;
+        for (auto& t: *trans)
+            translations.push_back(t.is_string() ? str::to_wx(t.get<std::string>()) : wxString());
+        item->SetTranslations(translations);
+        item->SetFuzzy(get_value<bool>(record, "fuzzy", false));
+        item->SetPreTranslated(get_value<bool>(record, "pretranslated", false));
+        item->SetModified(true);
+
+        if (seen.insert(item.get()).second)
+            restored.push_back(item);
+    }
+
+    wxLogTrace("poedit.journal", "replayed %d edits from journal for %s (%d ignored)", (int)restored.size(), catalog.GetFileName(), ignored);
+    return restored;
+}
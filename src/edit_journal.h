@@ -0,0 +1,101 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_edit_journal_h
+#define Poedit_edit_journal_h
+
+#include "catalog.h"
+
+#include <wx/string.h>
+
+#include <memory>
+#include <vector>
+
+
+/**
+    Append-only on-disk journal of edits made to a catalog since it was saved.
+
+    Saving rewrites the entire file, which is slow for large catalogs. The
+    journal records every finished edit of an item as a small record appended
+    to a file in the background, so that work isn't lost if Poedit crashes
+    before the user saves. The journal is removed when the catalog is saved
+    or its changes discarded; if it still exists when the file is opened next
+    time, the edits weren't saved and are replayed with Replay().
+
+    Edits are identified by items' source text and context, not by position,
+    and a journal is only replayed if the file didn't change on disk since
+    the journal was started.
+ */
+class EditJournal
+{
+public:
+    /// Creates journal for catalog file @a filename, discarding any existing one.
+    explicit EditJournal(const wxString& filename);
+    ~EditJournal();
+
+    EditJournal(const EditJournal&) = delete;
+    EditJournal& operator=(const EditJournal&) = delete;
+
+    /// Appends current state of @a item's translation to the journal.
+    void Record(const CatalogItemPtr& item);
+
+    /**
+        Call before writing the catalog to disk.
+
+        Edits recorded while the file is being written may or may not be
+        included in it, so they are kept in the journal after EndSave().
+     */
+    void BeginSave();
+
+    /**
+        Call after writing the catalog finished.
+
+        If @a ok, the journal is reset to only contain edits made during the
+        save; @a filename is the (possibly new) name of the saved file.
+     */
+    void EndSave(bool ok, const wxString& filename);
+
+    /// Removes the journal, e.g. when unsaved changes are discarded.
+    void Discard();
+
+    /**
+        Applies edits from @a catalog's journal, if there's any.
+
+        Returns items that were modified. The journal is left on disk; the
+        caller is expected to create new EditJournal and Record() them again.
+     */
+    static std::vector<CatalogItemPtr> Replay(Catalog& catalog);
+
+private:
+    struct State;
+    std::shared_ptr<State> m_state;
+
+    wxString m_filename;
+    bool m_needsHeader;
+    bool m_saving;
+    std::vector<CatalogItemPtr> m_editedDuringSave;
+};
+
+#endif // Poedit_edit_journal_h
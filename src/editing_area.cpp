@@ -980,11 +980,11 @@ void EditingArea::UpdateToTextCtrl(CatalogItemPtr item, int flags)
                 p->SetSyntaxHighlighter(syntax);
         }
 
-        m_textOrig->SetPlainText(item->GetString());
+        m_textOrig->SetSourceText(*item, false);
 
         if (item->HasPlural())
         {
-            m_textOrigPlural->SetPlainText(item->GetPluralString());
+            m_textOrigPlural->SetSourceText(*item, true);
 
             unsigned formsCnt = (unsigned)m_textTransPlural.size();
             for (unsigned j = 0; j < formsCnt; j++)
@@ -98,6 +98,9 @@ public:
     /// Puts text from textctrls to catalog & listctrl.
     void UpdateFromTextCtrl();
 
+    /// Updates shown issue and other information about the item, but not its text.
+    void UpdateAuxiliaryInfo(CatalogItemPtr item);
+
     void DontAutoclearFuzzyStatus() { m_dontAutoclearFuzzyStatus = true; }
     bool ShouldNotAutoclearFuzzyStatus() { return m_dontAutoclearFuzzyStatus; }
 
@@ -117,7 +120,6 @@ public:
 private:
     void RecreatePluralTextCtrls(CatalogPtr catalog);
 
-    void UpdateAuxiliaryInfo(CatalogItemPtr item);
     void UpdateCharCounter(CatalogItemPtr item);
 
     void CreateEditControls(wxBoxSizer *sizer);
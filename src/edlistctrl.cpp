@@ -30,6 +30,8 @@
 #include "language.h"
 #include "cat_sorting.h"
 #include "colorscheme.h"
+#include "concurrency.h"
+#include "tracing.h"
 #include "unicode_helpers.h"
 #include "utility.h"
 
@@ -53,6 +55,10 @@
 
 #include <algorithm>
 
+#if defined(_MSC_VER) && defined(_WIN64)
+#include <intrin.h>
+#endif
+
 
 namespace
 {
@@ -76,9 +82,13 @@ public:
             list->SetSelectedCatalogItemIndexes(selection);
         if (focus != -1)
         {
+            // the item may be no longer shown if the list is filtered
             auto item = list->CatalogIndexToListItem(focus);
-            list->EnsureVisible(item);
-            list->SetCurrentItem(item);
+            if (item.IsOk())
+            {
+                list->EnsureVisible(item);
+                list->SetCurrentItem(item);
+            }
         }
     }
 
@@ -242,6 +252,95 @@ wxString TrimTextValue(const wxString& text, size_t maxChars)
         return s;
 }
 
+#ifdef __WXOSX__
+// Number of changed rows above which it's faster to reload all of them
+const size_t BULK_REFRESH_THRESHOLD = 100;
+#endif
+
+// Position of the lowest set bit of nonzero @a w
+inline int LowestSetBit(uint64_t w)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(w);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long pos;
+    _BitScanForward64(&pos, w);
+    return (int)pos;
+#else
+    int pos = 0;
+    while (!(w & 1))
+    {
+        w >>= 1;
+        pos++;
+    }
+    return pos;
+#endif
+}
+
+// Position of the highest set bit of nonzero @a w
+inline int HighestSetBit(uint64_t w)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(w);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long pos;
+    _BitScanReverse64(&pos, w);
+    return (int)pos;
+#else
+    int pos = 63;
+    while (!(w & (uint64_t(1) << 63)))
+    {
+        w <<= 1;
+        pos--;
+    }
+    return pos;
+#endif
+}
+
+// Returns the first set bit in range [from, to) of the bitmap, or -1
+int FindFirstSetBit(const std::vector<uint64_t>& bits, int from, int to)
+{
+    if (from >= to)
+        return -1;
+
+    int word = from / 64;
+    const int lastWord = (to - 1) / 64;
+    uint64_t w = bits[word] & (~uint64_t(0) << (from % 64));
+    for (;;)
+    {
+        if (w)
+        {
+            const int pos = word * 64 + LowestSetBit(w);
+            return pos < to ? pos : -1;
+        }
+        if (++word > lastWord)
+            return -1;
+        w = bits[word];
+    }
+}
+
+// Returns the last set bit in range [from, to) of the bitmap, or -1
+int FindLastSetBit(const std::vector<uint64_t>& bits, int from, int to)
+{
+    if (from >= to)
+        return -1;
+
+    int word = (to - 1) / 64;
+    const int firstWord = from / 64;
+    uint64_t w = bits[word] & (~uint64_t(0) >> (63 - (to - 1) % 64));
+    for (;;)
+    {
+        if (w)
+        {
+            const int pos = word * 64 + HighestSetBit(w);
+            return pos >= from ? pos : -1;
+        }
+        if (--word < firstWord)
+            return -1;
+        w = bits[word];
+    }
+}
+
 } // anonymous namespace
 
 
@@ -254,6 +353,12 @@ PoeditListCtrl::Model::Model(TextDirection appTextDir)
       m_appTextDir(appTextDir)
 {
     sortOrder = SortOrder::Default();
+    CacheRegistry::Register(this);
+}
+
+PoeditListCtrl::Model::~Model()
+{
+    CacheRegistry::Unregister(this);
 }
 
 
@@ -268,18 +373,24 @@ void PoeditListCtrl::Model::SetVisualMode(ColorScheme::Mode visualMode)
     m_iconComment = wxArtProvider::GetIcon("ItemCommentTemplate");
     m_iconError = wxArtProvider::GetIcon("StatusError");
     m_iconWarning = wxArtProvider::GetIcon("StatusWarning");
+
+    ClearRenderCache();
 }
 
 
 void PoeditListCtrl::Model::SetCatalog(CatalogPtr catalog)
 {
     m_catalog = catalog;
+    ClearRenderCache();
 
     if (!catalog)
     {
         Reset(0);
+        m_sortedItems.clear();
         m_mapListToCatalog.clear();
         m_mapCatalogToList.clear();
+        m_comparator.reset();
+        InvalidateUnfinishedRows();
         return;
     }
 
@@ -291,16 +402,97 @@ void PoeditListCtrl::Model::SetCatalog(CatalogPtr catalog)
     // sort catalog items, create indexes mapping
     CreateSortMap();
 
-    Reset(catalog->GetCount());
+    Reset((unsigned)m_mapListToCatalog.size());
 }
 
 
 void PoeditListCtrl::Model::UpdateSort()
 {
+    TRACE_SPAN("ui", "UpdateSort");
+
     if (!m_catalog)
         return;
     CreateSortMap();
-    Reset(m_catalog->GetCount());
+    Reset((unsigned)m_mapListToCatalog.size());
+}
+
+
+void PoeditListCtrl::Model::UpdateFilter()
+{
+    if (!m_catalog)
+        return;
+    CreateFilteredMap();
+    Reset((unsigned)m_mapListToCatalog.size());
+}
+
+
+void PoeditListCtrl::Model::UpdateSortForItem(int catalogIndex)
+{
+    if (!m_catalog)
+        return;
+
+    const int count = (int)m_sortedItems.size();
+    if (!m_comparator || count != (int)m_catalog->GetCount())
+    {
+        // the catalog changed in other ways too
+        UpdateSort();
+        return;
+    }
+    if (catalogIndex < 0 || catalogIndex >= count)
+        return;
+
+    m_comparator->UpdateItem(catalogIndex);
+
+    // Remove the item from the order and find its new position with binary
+    // search; the rest of the items are still sorted. Do it for both the full
+    // order and for shown rows:
+    auto& sorted = m_sortedItems;
+    sorted.erase(std::find(sorted.begin(), sorted.end(), catalogIndex));
+    sorted.insert(std::lower_bound(sorted.begin(), sorted.end(), catalogIndex, std::ref(*m_comparator)), catalogIndex);
+
+    auto& order = m_mapListToCatalog;
+    const int oldRow = m_mapCatalogToList[catalogIndex];
+    if (oldRow != -1)
+        order.erase(order.begin() + oldRow);
+
+    int newRow = -1;
+    if (!filter.IsActive() || filter.Matches(*(*m_catalog)[catalogIndex]))
+    {
+        auto pos = std::lower_bound(order.begin(), order.end(), catalogIndex, std::ref(*m_comparator));
+        newRow = int(pos - order.begin());
+        order.insert(pos, catalogIndex);
+    }
+
+    if (newRow == oldRow)
+    {
+        if (oldRow != -1)
+            RowChanged(oldRow);
+        return;
+    }
+
+    InvalidateUnfinishedRows();
+
+    // Update the inverse mapping for rows that moved; if the item was added
+    // or removed, all rows after it shifted:
+    m_mapCatalogToList[catalogIndex] = -1;
+    int first, last;
+    if (oldRow != -1 && newRow != -1)
+    {
+        first = std::min(oldRow, newRow);
+        last = std::max(oldRow, newRow);
+    }
+    else
+    {
+        first = (oldRow != -1) ? oldRow : newRow;
+        last = (int)order.size() - 1;
+    }
+    for (int row = first; row <= last; row++)
+        m_mapCatalogToList[order[row]] = row;
+
+    if (oldRow != -1)
+        RowDeleted(oldRow);
+    if (newRow != -1)
+        RowInserted(newRow);
 }
 
 
@@ -359,7 +551,7 @@ void PoeditListCtrl::Model::GetValueByRow(wxVariant& variant, unsigned row, unsi
     {
         case Col_ID:
         {
-            variant = wxString::Format("%d", d->GetId());
+            variant = GetRenderedRow(CatalogIndex(row), *d).id;
             break;
         }
 
@@ -387,58 +579,13 @@ void PoeditListCtrl::Model::GetValueByRow(wxVariant& variant, unsigned row, unsi
 
         case Col_Source:
         {
-            wxString orig;
-            const auto orig_str = TrimTextValue(d->GetString(), m_maxVisibleWidth);
-
-        #ifdef __WXMSW__
-            // Temporary workaround for https://github.com/vslavik/poedit/issues/343 and
-            // https://github.com/vslavik/poedit/issues/481 -- fall back to old style rendering:
-            if (m_appTextDir == TextDirection::RTL && m_sourceTextDir == TextDirection::LTR)
-            {
-                // non-markup rendering of source column:
-                if (d->HasContext())
-                    orig.Printf("[%s] %s", d->GetContext(), orig_str);
-                else
-                    orig = orig_str;
-            }
-            else
-        #endif
-            {
-                if (d->HasContext())
-                {
-                    // Work around a problem with GTK+'s coloring of markup that begins with colorizing <span>:
-                #ifdef __WXGTK__
-                    #define MARKUP(x) L"\u200B" L##x
-                #else
-                    #define MARKUP(x) x
-                #endif
-                    orig.Printf(MARKUP("<span bgcolor=\"%s\" color=\"%s\"> %s | </span> %s"),
-                        m_clrContextBg, m_clrContextFg,
-                        EscapeMarkup(d->GetContext()), EscapeMarkup(orig_str));
-                }
-                else
-                {
-                    orig = EscapeMarkup(orig_str);
-                }
-            }
-
-            // Add RTL Unicode mark to render bidi texts correctly
-            if (m_appTextDir != m_sourceTextDir)
-                variant = bidi::mark_direction(orig, m_sourceTextDir);
-            else
-                variant = orig;
+            variant = GetRenderedRow(CatalogIndex(row), *d).source;
             break;
         }
 
         case Col_Translation:
         {
-            const auto trans = TrimTextValue(d->GetTranslation(), m_maxVisibleWidth);
-
-            // Add RTL Unicode mark to render bidi texts correctly
-            if (m_appTextDir != m_transTextDir)
-                variant = bidi::mark_direction(trans, m_transTextDir);
-            else
-                variant = trans;
+            variant = GetRenderedRow(CatalogIndex(row), *d).translation;
             break;
         }
 
@@ -448,6 +595,116 @@ void PoeditListCtrl::Model::GetValueByRow(wxVariant& variant, unsigned row, unsi
     };
 }
 
+void PoeditListCtrl::Model::InvalidateRenderedRow(int catalogIndex)
+{
+    if (catalogIndex < 0 || m_renderCache.empty())
+        return;
+    m_renderCache[catalogIndex % RENDER_CACHE_SIZE].item = nullptr;
+}
+
+
+const PoeditListCtrl::Model::RenderedRow&
+PoeditListCtrl::Model::GetRenderedRow(int catalogIndex, const CatalogItem& item) const
+{
+    if (m_renderCache.empty())
+        m_renderCache.resize(RENDER_CACHE_SIZE);
+
+    auto& r = m_renderCache[catalogIndex % RENDER_CACHE_SIZE];
+    r.lastUse = CacheRegistry::Now();
+    if (r.item == &item && r.revision == item.GetRevision())
+        return r;
+
+    r.item = &item;
+    r.revision = item.GetRevision();
+
+    r.id = wxString::Format("%d", item.GetId());
+
+    {
+        wxString orig;
+        const auto orig_str = TrimTextValue(item.GetString(), m_maxVisibleWidth);
+
+    #ifdef __WXMSW__
+        // Temporary workaround for https://github.com/vslavik/poedit/issues/343 and
+        // https://github.com/vslavik/poedit/issues/481 -- fall back to old style rendering:
+        if (m_appTextDir == TextDirection::RTL && m_sourceTextDir == TextDirection::LTR)
+        {
+            // non-markup rendering of source column:
+            if (item.HasContext())
+                orig.Printf("[%s] %s", item.GetContext(), orig_str);
+            else
+                orig = orig_str;
+        }
+        else
+    #endif
+        {
+            if (item.HasContext())
+            {
+                // Work around a problem with GTK+'s coloring of markup that begins with colorizing <span>:
+            #ifdef __WXGTK__
+                #define MARKUP(x) L"\u200B" L##x
+            #else
+                #define MARKUP(x) x
+            #endif
+                orig.Printf(MARKUP("<span bgcolor=\"%s\" color=\"%s\"> %s | </span> %s"),
+                    m_clrContextBg, m_clrContextFg,
+                    EscapeMarkup(item.GetContext()), EscapeMarkup(orig_str));
+            }
+            else
+            {
+                orig = EscapeMarkup(orig_str);
+            }
+        }
+
+        // Add RTL Unicode mark to render bidi texts correctly
+        if (m_appTextDir != m_sourceTextDir)
+            r.source = bidi::mark_direction(orig, m_sourceTextDir);
+        else
+            r.source = orig;
+    }
+
+    {
+        const auto trans = TrimTextValue(item.GetTranslation(), m_maxVisibleWidth);
+
+        // Add RTL Unicode mark to render bidi texts correctly
+        if (m_appTextDir != m_transTextDir)
+            r.translation = bidi::mark_direction(trans, m_transTextDir);
+        else
+            r.translation = trans;
+    }
+
+    m_renderCacheMemory -= r.memory;
+    r.memory = sizeof(RenderedRow) + (r.id.length() + r.source.length() + r.translation.length()) * sizeof(wxChar);
+    m_renderCacheMemory += r.memory;
+
+    return r;
+}
+
+
+CacheRegistry::Timestamp PoeditListCtrl::Model::GetOldestUse() const
+{
+    auto oldest = CacheRegistry::NoEntries;
+    for (auto& r: m_renderCache)
+    {
+        if (r.memory)
+            oldest = std::min(oldest, r.lastUse);
+    }
+    return oldest;
+}
+
+
+void PoeditListCtrl::Model::EvictUsedUntil(CacheRegistry::Timestamp time)
+{
+    for (auto& r: m_renderCache)
+    {
+        if (r.memory && r.lastUse <= time)
+        {
+            m_renderCacheMemory -= r.memory;
+            r = RenderedRow();
+        }
+    }
+}
+
+
 bool PoeditListCtrl::Model::SetValueByRow(const wxVariant&, unsigned, unsigned)
 {
     wxFAIL_MSG("setting values in dataview not implemented");
@@ -499,27 +756,144 @@ void PoeditListCtrl::Model::CreateSortMap()
 
     int count = (int)m_catalog->GetCount();
 
-    m_mapListToCatalog.resize(count);
-    m_mapCatalogToList.resize(count);
-
     // First create identity mapping for the sort order.
+    m_sortedItems.resize(count);
     for ( int i = 0; i < count; i++ )
-        m_mapListToCatalog[i] = i;
+        m_sortedItems[i] = i;
 
-    // m_mapListToCatalog will hold our desired sort order. Sort it in place
-    // now, using the desired sort criteria.
-    CatalogItemsComparator comparator(*m_catalog, sortOrder);
-    std::sort
+    // m_sortedItems will hold our desired sort order. Sort it in place
+    // now, using the desired sort criteria. The comparator only reads
+    // precomputed data, so it can be used from multiple threads.
+    m_comparator.reset(new CatalogItemsComparator(*m_catalog, sortOrder));
+    dispatch::parallel_sort
     (
-        m_mapListToCatalog.begin(),
-        m_mapListToCatalog.end(),
-        std::ref(comparator)
+        m_sortedItems.begin(),
+        m_sortedItems.end(),
+        std::ref(*m_comparator)
     );
 
+    CreateFilteredMap();
+}
+
+
+void PoeditListCtrl::Model::CreateFilteredMap()
+{
+    const int count = (int)m_sortedItems.size();
+
+    m_mapCatalogToList.assign(count, -1);
+
+    if (!filter.IsActive())
+    {
+        m_mapListToCatalog = m_sortedItems;
+    }
+    else
+    {
+        // Evaluate the filter in parallel (text matching can be expensive),
+        // then pick matching items in sort order. Items' status is checked in
+        // the catalog's dense table first, so that items excluded by it aren't
+        // touched at all:
+        auto& items = m_catalog->items();
+        const auto status = m_catalog->GetItemsStatus();
+        const int chunkSize = 1024;
+        std::vector<char> matches(count);
+
+        // Items referenced from the file are looked up in the index, which
+        // is much faster than checking every item's references:
+        std::vector<char> referenced;
+        if (!filter.GetReferenceFile().empty())
+        {
+            referenced.resize(count);
+            auto index = m_catalog->GetReferencesIndex();
+            for (auto& o: index->GetOccurrences(filter.GetReferenceFile()))
+            {
+                if (o.item < count)
+                    referenced[o.item] = 1;
+            }
+        }
+
+        dispatch::parallel_for(size_t((count + chunkSize - 1) / chunkSize), [=,&items,&status,&matches,&referenced](size_t n)
+        {
+            const int end = std::min(int(n + 1) * chunkSize, count);
+            for (int i = int(n) * chunkSize; i < end; i++)
+            {
+                if (referenced.empty())
+                    matches[i] = filter.Matches(*items[i], status[i]);
+                else
+                    matches[i] = referenced[i] && filter.MatchesIgnoringReferenceFile(*items[i], status[i]);
+            }
+        });
+
+        m_mapListToCatalog.clear();
+        for (auto i: m_sortedItems)
+        {
+            if (matches[i])
+                m_mapListToCatalog.push_back(i);
+        }
+    }
+
     // Finally, construct m_mapCatalogToList to be the inverse mapping to
     // m_mapListToCatalog.
-    for ( int i = 0; i < count; i++ )
+    for ( int i = 0; i < (int)m_mapListToCatalog.size(); i++ )
         m_mapCatalogToList[m_mapListToCatalog[i]] = i;
+
+    InvalidateUnfinishedRows();
+}
+
+
+void PoeditListCtrl::Model::UpdateUnfinishedRows() const
+{
+    if (m_unfinishedRowsRevision && m_unfinishedRowsRevision == m_catalog->GetItemsStatusRevision())
+        return;
+
+    // Rebuild from the catalog's dense status table, which is cheap compared
+    // to examining items; this happens after edits and re-sorts, but not for
+    // navigation that doesn't change anything.
+    uint64_t revision;
+    const auto status = m_catalog->GetItemsStatus(&revision);
+    const int count = (int)m_mapListToCatalog.size();
+    const int statusCount = (int)status.size();
+
+    m_unfinishedRows.assign((count + 63) / 64, 0);
+    for (int row = 0; row < count; row++)
+    {
+        const int index = m_mapListToCatalog[row];
+        if (index >= statusCount)
+            continue;
+        const uint8_t flags = status[index];
+        if (!(flags & CatalogItem::Status_Translated) ||
+            (flags & (CatalogItem::Status_Fuzzy | CatalogItem::Status_Issue)))
+        {
+            m_unfinishedRows[row / 64] |= uint64_t(1) << (row % 64);
+        }
+    }
+
+    m_unfinishedRowsRevision = revision;
+}
+
+
+int PoeditListCtrl::Model::FindUnfinishedRow(int start, int step, bool wrap) const
+{
+    const int count = (int)m_mapListToCatalog.size();
+    if (!m_catalog || !count)
+        return -1;
+
+    UpdateUnfinishedRows();
+
+    start = std::min(std::max(start, -1), count);
+    int row;
+    if (step > 0)
+    {
+        row = FindFirstSetBit(m_unfinishedRows, start + 1, count);
+        if (row == -1 && wrap)
+            row = FindFirstSetBit(m_unfinishedRows, 0, start);
+    }
+    else
+    {
+        row = FindLastSetBit(m_unfinishedRows, 0, start);
+        if (row == -1 && wrap)
+            row = FindLastSetBit(m_unfinishedRows, start + 1, count);
+    }
+    return row;
 }
 
 
@@ -667,8 +1041,9 @@ void PoeditListCtrl::CreateColumns()
     m_colTrans = new wxDataViewColumn(_(L"Translation — %s"), transRenderer, Model::Col_Translation, wxCOL_WIDTH_DEFAULT, wxALIGN_LEFT, 0);
     AppendColumn(m_colTrans);
 
+    // the width is computed in FixIdColumnSize(), autosizing would measure all rows:
     auto idRenderer = new wxDataViewTextRenderer();
-    m_colID = new DataViewFixedColumn(_("ID"), idRenderer, Model::Col_ID, wxCOL_WIDTH_AUTOSIZE, wxALIGN_RIGHT);
+    m_colID = new DataViewFixedColumn(_("ID"), idRenderer, Model::Col_ID, PX(50), wxALIGN_RIGHT);
     AppendColumn(m_colID);
 
     // wxDVC insists on having an expander column, but we really don't want one:
@@ -691,6 +1066,14 @@ void PoeditListCtrl::CreateColumns()
     #endif
         sourceRenderer->SetHighlightedBgColor(ColorScheme::Get(Color::ItemContextBgHighlighted, this));
     });
+
+#ifdef __WXGTK__
+    // All rows are single-line and equally tall, so let GTK take the height
+    // from the first row instead of measuring every row's content, which is
+    // very slow with large lists. This requires all columns to have fixed
+    // widths, i.e. none of them can be autosized.
+    gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(GtkGetTreeView()), TRUE);
+#endif
 }
 
 void PoeditListCtrl::UpdateColumns()
@@ -756,27 +1139,32 @@ void PoeditListCtrl::UpdateColumns()
 
     m_colID->SetHidden(!m_displayIDs);
 
-    // determine best fitting width only once, then set it as fixed, because IDs are immutable
-    m_colID->SetWidth(wxCOL_WIDTH_AUTOSIZE);
+    // determine the width only once, then set it as fixed, because IDs are immutable
     FixIdColumnSize();
 
     SizeColumns();
 
 #ifdef __WXGTK__
     // wxGTK has delayed sizing computation, apparently
-    CallAfter([=]{
-        FixIdColumnSize();
-        SizeColumns();
-    });
+    CallAfter([=]{ SizeColumns(); });
 #endif
 }
 
 void PoeditListCtrl::FixIdColumnSize()
 {
-    int computed_colID_width = m_colID->GetWidth();
-    // The returned width may be 0 if it is not computed yet or if column is hidden - don't fix it yet in this case
-    if ( computed_colID_width > 0 )
-        m_colID->SetWidth(computed_colID_width);
+    // IDs are numbers and digits are equally wide in UI fonts, so the column
+    // only needs to fit the largest one's number of digits. Computing this is
+    // much cheaper than autosizing, which measures every row's text.
+    int maxId = 0;
+    for (auto& item: m_catalog->items())
+        maxId = std::max(maxId, item->GetId());
+
+    const size_t digits = std::max(size_t(2), wxString::Format("%d", maxId).length());
+    const int contentWidth = GetTextExtent(wxString('9', digits)).x;
+    const int titleWidth = GetTextExtent(m_colID->GetTitle()).x;
+
+    // add renderer's and header's padding:
+    m_colID->SetWidth(std::max(contentWidth + PX(10), titleWidth + PX(16)));
 }
 
 void PoeditListCtrl::SizeColumns()
@@ -835,7 +1223,7 @@ void PoeditListCtrl::CatalogChanged(const CatalogPtr& catalog)
 
     wxWindowUpdateLocker no_updates(this);
 
-    const int oldCount = m_model->GetCount();
+    const int oldCount = m_model->GetAllItemsCount();
     const int newCount = catalog ? catalog->GetCount() : 0;
     const bool isSameCatalog = (catalog == m_catalog);
     const bool sizeOrCatalogChanged = !isSameCatalog || (oldCount != newCount);
@@ -862,6 +1250,8 @@ void PoeditListCtrl::RefreshAllItems()
     // is reasonably fast except on macOS, where it is *extremely* inefficient and where
     // Cleared() messes up position. Fortunately, native reloadData is fast and equivalent
     // to reloading individual rows, so we can do just that.
+    m_model->ClearRenderCache();
+
 #ifdef __WXOSX__
     NSTableView *tableView = (NSTableView*)[((NSScrollView*)GetHandle()) documentView];
     [tableView reloadData];
@@ -876,6 +1266,20 @@ void PoeditListCtrl::RefreshAllItems()
 }
 
 
+void PoeditListCtrl::RefreshItems(const wxDataViewItemArray& items)
+{
+#ifdef __WXOSX__
+    // see RefreshAllItems() for why notifying about many rows is avoided on macOS
+    if (items.size() > BULK_REFRESH_THRESHOLD)
+    {
+        RefreshAllItems();
+        return;
+    }
+#endif
+    m_model->ItemsChanged(items);
+}
+
+
 void PoeditListCtrl::Sort()
 {
     if (!m_catalog)
@@ -886,6 +1290,31 @@ void PoeditListCtrl::Sort()
 }
 
 
+void PoeditListCtrl::ApplyFilter()
+{
+    if (!m_catalog)
+        return;
+
+    SelectionPreserver preserve(this);
+    m_model->UpdateFilter();
+}
+
+
+void PoeditListCtrl::UpdateSortForItem(const CatalogItemPtr& item)
+{
+    if (!m_catalog || !item || (!sortOrder().DependsOnTranslations() && !filter().IsActive()))
+        return;
+
+    auto& items = m_catalog->items();
+    auto i = std::find(items.begin(), items.end(), item);
+    if (i == items.end())
+        return;
+
+    SelectionPreserver preserve(this);
+    m_model->UpdateSortForItem(int(i - items.begin()));
+}
+
+
 void PoeditListCtrl::OnSize(wxSizeEvent& event)
 {
     wxWindowUpdateLocker lock(this);
@@ -30,11 +30,13 @@
 #include <wx/dataview.h>
 #include <wx/frame.h>
 
+#include <algorithm>
 #include <vector>
 
 class WXDLLIMPEXP_FWD_CORE wxListCtrl;
 class WXDLLIMPEXP_FWD_CORE wxListEvent;
 
+#include "cache_registry.h"
 #include "catalog.h"
 #include "cat_sorting.h"
 #include "colorscheme.h"
@@ -51,6 +53,18 @@ class PoeditListCtrl : public wxDataViewCtrl
         /// Re-sort the control according to user-specified criteria.
         void Sort();
 
+        /**
+            Moves @a item to its correct position in the current sort order
+            after it was edited, without re-sorting the whole list.
+         */
+        void UpdateSortForItem(const CatalogItemPtr& item);
+
+        /// Filter restricting which items are shown; call ApplyFilter() after changing it.
+        ItemsFilter& filter() { return m_model->filter; }
+
+        /// Updates shown items after filter() was changed.
+        void ApplyFilter();
+
         void SizeColumns();
 
         void SetDisplayLines(bool dl);
@@ -105,6 +119,19 @@ class PoeditListCtrl : public wxDataViewCtrl
             return index != -1 ? m_model->Item(index) : nullptr;
         }
 
+        /**
+            Returns list index of the nearest unfinished (untranslated, fuzzy
+            or having issues) item in the direction of @a step from @a start,
+            or -1 if there's none.
+
+            If @a wrap is true, the search continues from the other end of the
+            list and stops when it gets back to @a start.
+         */
+        int FindUnfinishedListIndex(int start, int step, bool wrap) const
+        {
+            return m_model->FindUnfinishedRow(start, step, wrap);
+        }
+
         CatalogItemPtr GetCurrentCatalogItem()
         {
             return ListItemToCatalogItem(GetCurrentItem());
@@ -136,21 +163,33 @@ class PoeditListCtrl : public wxDataViewCtrl
         {
             wxDataViewItemArray sel;
             for (auto i: selection)
-                sel.push_back(CatalogIndexToListItem(i));
+            {
+                auto item = CatalogIndexToListItem(i);
+                if (item.IsOk())
+                    sel.push_back(item);
+            }
             SetSelections(sel);
         }
 
         // Perform given function for all selected items. The function takes
         // reference to the item as its argument. Also refresh the items touched,
-        // on the assumption that the operation modifies them.
+        // on the assumption that the operation modifies them. The items are
+        // modified as a single batch (see Catalog::ItemsBatch) and refreshed
+        // at once afterwards.
         template<typename T>
         void ForSelectedCatalogItemsDo(T func)
         {
             wxDataViewItemArray sel;
             GetSelections(sel);
+
+            CatalogItemArray items;
+            items.reserve(sel.size());
             for (auto item: sel)
-                func(*ListItemToCatalogItem(item));
-            m_model->ItemsChanged(sel);
+                items.push_back(ListItemToCatalogItem(item));
+
+            m_model->m_catalog->ModifyItems(items, [&func](CatalogItem& item){ func(item); return true; });
+
+            RefreshItems(sel);
         }
 
         void SelectOnly(const wxDataViewItem& item)
@@ -199,8 +238,13 @@ class PoeditListCtrl : public wxDataViewCtrl
 
         void RefreshAllItems();
 
+        /// Refreshes given rows, efficiently even if there are many of them
+        void RefreshItems(const wxDataViewItemArray& items);
+
         void RefreshItem(const wxDataViewItem& item)
         {
+            if (item.IsOk())
+                m_model->InvalidateRenderedRow(m_model->CatalogIndex(m_model->GetRow(item)));
             m_model->ItemChanged(item);
         }
 
@@ -214,6 +258,19 @@ class PoeditListCtrl : public wxDataViewCtrl
             return m_model->GetCount();
         }
 
+        /// Returns up to @a count items following the current one, in display order
+        std::vector<CatalogItemPtr> GetItemsAfterCurrent(int count)
+        {
+            std::vector<CatalogItemPtr> items;
+            const int current = ListItemToListIndex(GetCurrentItem());
+            if (current == -1)
+                return items;
+            const int last = std::min(current + count, GetItemCount() - 1);
+            for (int i = current + 1; i <= last; i++)
+                items.push_back(ListIndexToCatalogItem(i));
+            return items;
+        }
+
         void SetCustomFont(wxFont font);
 
         // Order used for sorting
@@ -225,7 +282,7 @@ class PoeditListCtrl : public wxDataViewCtrl
 
     private:
         /// Model for the translation data
-        class Model : public wxDataViewVirtualListModel
+        class Model : public wxDataViewVirtualListModel, public CacheRegistry::Cache
         {
         public:
             enum Column
@@ -238,6 +295,7 @@ class PoeditListCtrl : public wxDataViewCtrl
             };
 
             Model(TextDirection appTextDir);
+            ~Model();
             virtual ~Model() {}
 
             /// Configure items colors & fonts; must be called after ctor.
@@ -245,6 +303,8 @@ class PoeditListCtrl : public wxDataViewCtrl
 
             void SetCatalog(CatalogPtr catalog);
             void UpdateSort();
+            void UpdateSortForItem(int catalogIndex);
+            void UpdateFilter();
 
             unsigned int GetColumnCount() const override { return Col_Max; }
             wxString GetColumnType( unsigned int col ) const override;
@@ -291,28 +351,86 @@ class PoeditListCtrl : public wxDataViewCtrl
                 return -1;
             }
 
+            /// See PoeditListCtrl::FindUnfinishedListIndex()
+            int FindUnfinishedRow(int start, int step, bool wrap) const;
+
             void CreateSortMap();
+            void CreateFilteredMap();
+
+            /// Number of all items, including those excluded by the filter
+            int GetAllItemsCount() const { return (int)m_sortedItems.size(); }
 
             void Freeze() { m_frozen = true; }
             void Thaw() { m_frozen = false; }
 
-            void SetMaxVisibleWidth(int chars) { m_maxVisibleWidth = chars; }
+            void SetMaxVisibleWidth(int chars)
+            {
+                if (chars != m_maxVisibleWidth)
+                {
+                    m_maxVisibleWidth = chars;
+                    ClearRenderCache();
+                }
+            }
+
+            /// Forget cached rendering of given catalog item's row
+            void InvalidateRenderedRow(int catalogIndex);
+            /// Forget all cached rendering, e.g. after visual changes
+            void ClearRenderCache() { m_renderCache.clear(); m_renderCacheMemory = 0; }
+
+            // CacheRegistry::Cache implementation for the render cache:
+            size_t GetMemoryUsage() const override { return m_renderCacheMemory; }
+            CacheRegistry::Timestamp GetOldestUse() const override;
+            void EvictUsedUntil(CacheRegistry::Timestamp time) override;
 
         public:
             CatalogPtr m_catalog;
             SortOrder sortOrder;
+            ItemsFilter filter;
 
         private:
             bool m_frozen;
             int m_maxVisibleWidth;
+            // all items in sort order
+            std::vector<int> m_sortedItems;
+            // shown rows, i.e. m_sortedItems without items excluded by the filter;
+            // the inverse mapping is -1 for excluded items
             std::vector<int> m_mapListToCatalog;
             std::vector<int> m_mapCatalogToList;
+            // comparator used to create the sort map, kept for incremental updates
+            std::unique_ptr<CatalogItemsComparator> m_comparator;
+
+            // bitmap of unfinished items' rows, in list order; built lazily
+            // from the catalog's status table and valid for its revision
+            // (0 if rows changed since)
+            mutable std::vector<uint64_t> m_unfinishedRows;
+            mutable uint64_t m_unfinishedRowsRevision = 0;
+            void UpdateUnfinishedRows() const;
+            void InvalidateUnfinishedRows() { m_unfinishedRowsRevision = 0; }
 
             TextDirection m_sourceTextDir, m_transTextDir, m_appTextDir;
 
             wxColour m_clrID, m_clrInvalid, m_clrFuzzy;
             wxString m_clrContextFg, m_clrContextBg;
             wxIcon m_iconComment, m_iconError, m_iconWarning;
+
+            /// Cached rendered texts of a row, valid for given item's revision
+            struct RenderedRow
+            {
+                const CatalogItem *item = nullptr;
+                unsigned revision = 0;
+                wxString id, source, translation;
+                size_t memory = 0;
+                CacheRegistry::Timestamp lastUse = 0;
+            };
+
+            /// Returns rendering of the item at given catalog index, from cache if possible
+            const RenderedRow& GetRenderedRow(int catalogIndex, const CatalogItem& item) const;
+
+            // Direct-mapped cache of recently rendered rows, indexed by catalog index
+            // modulo its size; bounded, because only visible rows are ever needed
+            static const size_t RENDER_CACHE_SIZE = 1024;
+            mutable std::vector<RenderedRow> m_renderCache;
+            mutable size_t m_renderCacheMemory = 0;
         };
 
 
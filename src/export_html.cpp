@@ -25,58 +25,173 @@
  */
 
 #include "catalog.h"
+#include "errors.h"
 #include "utility.h"
 #include "str_helpers.h"
 
 #include <wx/intl.h>
+#include <wx/filename.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#if wxUSE_GUI
+    #include "concurrency.h"
+    #define HAVE_PARALLEL_PROCESSING
+#endif
 
 namespace
 {
 
-inline std::string fmt_trans(const wxString& s)
+// Text to be written escaped by HTMLWriter
+struct Escaped
 {
-    wxString out = EscapeMarkup(s);
-    out.Replace("\n", "\n<br>");
-    return str::to_utf8(out);
-}
+    explicit Escaped(const wxString& s) : text(s) {}
+    const wxString& text;
+};
+
+// Buffered output of UTF-8 HTML to a stream, avoiding temporary wxStrings.
+class HTMLWriter
+{
+public:
+    explicit HTMLWriter(std::ostream *f = nullptr) : m_f(f) {}
+    ~HTMLWriter() { Flush(); }
+
+    HTMLWriter& operator<<(const char *s) { m_buf += s; return MaybeFlush(); }
+    HTMLWriter& operator<<(const std::string& s) { m_buf += s; return MaybeFlush(); }
+    HTMLWriter& operator<<(int n) { m_buf += std::to_string(n); return MaybeFlush(); }
+    HTMLWriter& operator<<(size_t n) { m_buf += std::to_string(n); return MaybeFlush(); }
+    HTMLWriter& operator<<(double n)
+    {
+        // not snprintf(), it would use locale's decimal separator:
+        std::ostringstream s;
+        s << n;
+        m_buf += s.str();
+        return MaybeFlush();
+    }
+
+    /// Writes @a s as is, i.e. it must be valid markup already
+    HTMLWriter& operator<<(const wxString& s)
+    {
+        str::append_utf8(m_buf, s.wx_str(), s.length());
+        return MaybeFlush();
+    }
+
+    /// Writes escaped text, with newlines converted to line breaks
+    HTMLWriter& operator<<(const Escaped& e)
+    {
+        auto& s = e.text;
+        const wchar_t *p = s.wx_str();
+        const wchar_t *end = p + s.length();
+        const wchar_t *run = p;
+        for (; p != end; ++p)
+        {
+            const char *replacement;
+            switch (*p)
+            {
+                case '&':  replacement = "&amp;";   break;
+                case '<':  replacement = "&lt;";    break;
+                case '>':  replacement = "&gt;";    break;
+                case '\n': replacement = "\n<br>";  break;
+                default:   continue;
+            }
+            str::append_utf8(m_buf, run, p - run);
+            m_buf += replacement;
+            run = p + 1;
+        }
+        str::append_utf8(m_buf, run, end - run);
+        return MaybeFlush();
+    }
+
+    /// Takes the content w/o writing it to the stream
+    std::string Take() { return std::move(m_buf); }
+
+    void Flush()
+    {
+        if (m_f && !m_buf.empty())
+        {
+            m_f->write(m_buf.data(), m_buf.size());
+            m_buf.clear();
+        }
+    }
+
+private:
+    HTMLWriter& MaybeFlush()
+    {
+        if (m_buf.size() >= FLUSH_SIZE)
+            Flush();
+        return *this;
+    }
+
+    static const size_t FLUSH_SIZE = 64 * 1024;
+
+    std::ostream *m_f;
+    std::string m_buf;
+};
+
+
+// Values shared by all rows of the translations table
+struct TableSettings
+{
+    bool translated;
+    std::string lang_src, lang_tra;
+};
+
+// Items are formatted in parallel in chunks of this size:
+const size_t ROWS_CHUNK_SIZE = 1000;
+
 
 template<typename T1, typename T2>
-inline void TableRow(std::ostream& f, const T1& col1, const T2& col2)
+inline void TableRow(HTMLWriter& f, const T1& col1, const T2& col2)
 {
     f << "<tr>"
-      << "<td>" << str::to_utf8(col1) << "</td>"
-      << "<td>" << str::to_utf8(col2) << "</td>"
+      << "<td>" << wxString(col1) << "</td>"
+      << "<td>" << wxString(col2) << "</td>"
       << "</tr>\n";
 }
 
 extern const char *CSS_STYLE;
 
-} // anonymous namespace
 
-void Catalog::ExportToHTML(std::ostream& f)
+void WriteHead(HTMLWriter& f, const wxString& title)
 {
-    const bool translated = HasCapability(Catalog::Cap::Translations);
-    const auto lang = translated ? GetLanguage() : Language();
-    const auto srclang = GetSourceLanguage();
-
     f << "<!DOCTYPE html>\n"
          "<html>\n"
          "<head>\n"
-         "  <title>" << str::to_utf8(m_header.Project) << "</title>\n"
+         "  <title>" << title << "</title>\n"
          "  <meta http-equiv='Content-Type' content='text/html; charset=utf-8'>\n"
          "  <style>\n" << CSS_STYLE << "\n"
          "  </style>\n"
          "</head>\n"
          "<body>\n"
          "<div class='container'>\n";
+}
+
+void WriteFoot(HTMLWriter& f)
+{
+    f << "</div>\n"
+         "</body>\n"
+         "</html>\n";
+}
+
+
+void WriteSummary(HTMLWriter& f, Catalog& cat, const TableSettings& settings)
+{
+    const bool translated = settings.translated;
+    auto& header = cat.Header();
 
     // Metadata section:
 
     f << "<table class='metadata'>\n";
-    if (!m_header.Project.empty())
-        TableRow(f, _("Project:"), m_header.Project);
-    if (translated && lang.IsValid())
-        TableRow(f, _("Language:"), lang.DisplayName());
+    if (!header.Project.empty())
+        TableRow(f, _("Project:"), header.Project);
+    if (translated && cat.GetLanguage().IsValid())
+        TableRow(f, _("Language:"), cat.GetLanguage().DisplayName());
     f << "</table>\n";
 
 
@@ -87,7 +202,7 @@ void Catalog::ExportToHTML(std::ostream& f)
         int fuzzy = 0;
         int untranslated = 0;
         int unfinished = 0;
-        GetStatistics(&all, &fuzzy, nullptr, &untranslated, &unfinished);
+        cat.GetStatistics(&all, &fuzzy, nullptr, &untranslated, &unfinished);
         int percent = (all == 0 ) ? 0 : (100 * (all - unfinished) / all);
 
         f << "<div class='stats'>\n"
@@ -100,39 +215,145 @@ void Catalog::ExportToHTML(std::ostream& f)
           f << "    <div class='percent-untrans' style='width: " << 100.0 * untranslated / all << "%'>&nbsp;</div>\n";
         f << "  </div>\n"
           << "  <div class='legend'>";
-        f << str::to_utf8(wxString::Format(_("Translated: %d of %d (%d %%)"), all - unfinished, all, percent));
+        if (cat.IsPartiallyLoaded())
+            f << wxString::Format(_("Translated: about %d of %d (%d %%)"), all - unfinished, all, percent);
+        else
+            f << wxString::Format(_("Translated: %d of %d (%d %%)"), all - unfinished, all, percent);
         if (unfinished > 0)
-            f << str::to_utf8(L"  •  ") << str::to_utf8(wxString::Format(_("Remaining: %d"), unfinished));
+            f << wxString(L"  •  ") << wxString::Format(_("Remaining: %d"), unfinished);
         f << "  </div>\n"
           << "</div>\n";
     }
     else
     {
-        int all = (int)items().size();
+        int all = cat.IsPartiallyLoaded() ? 0 : (int)cat.items().size();
+        if (cat.IsPartiallyLoaded())
+            cat.GetStatistics(&all, nullptr, nullptr, nullptr, nullptr);
         f << "<div class='stats'>\n"
           << "  <div class='graph'>\n"
           << "    <div class='percent-untrans' style='width: 100%'>&nbsp;</div>\n"
           << "  </div>\n"
           << "  <div class='legend'>"
-          << str::to_utf8(wxString::Format(wxPLURAL("%d entry", "%d entries", all), all))
+          << wxString::Format(wxPLURAL("%d entry", "%d entries", all), all)
           << "  </div>\n"
           << "</div>\n";
     }
 
-    // Translations:
+    if (cat.IsPartiallyLoaded())
+    {
+        f << "<p class='partial'>"
+          << Escaped(_("This file is large, only its beginning is shown. Statistics are estimated."))
+          << "</p>\n";
+    }
+}
+
 
-    std::string lang_src, lang_tra;
+TableSettings GetTableSettings(Catalog& cat)
+{
+    TableSettings settings;
+    settings.translated = cat.HasCapability(Catalog::Cap::Translations);
+
+    const auto lang = settings.translated ? cat.GetLanguage() : Language();
+    const auto srclang = cat.GetSourceLanguage();
     if (srclang.IsValid())
-        lang_src = " lang='" + srclang.LanguageTag() + "'";
+        settings.lang_src = " lang='" + srclang.LanguageTag() + "'";
     if (lang.IsValid())
     {
-        lang_tra = " lang='" + lang.LanguageTag() + "'";
+        settings.lang_tra = " lang='" + lang.LanguageTag() + "'";
         if (lang.IsRTL())
-            lang_tra += " dir='rtl'";
+            settings.lang_tra += " dir='rtl'";
+    }
+    return settings;
+}
+
+
+void WriteItemRow(HTMLWriter& f, const CatalogItem& item, const TableSettings& settings)
+{
+    bool hasComments = item.HasComment() || item.HasExtractedComments();
+
+    f << "<tr class='i";
+    if (!item.IsTranslated())
+        f << " untrans";
+    if (item.IsFuzzy())
+        f << " fuzzy";
+    if (hasComments)
+        f << " with-comments";
+    f << "'>\n";
+
+    // Source string:
+    f << "<td class='src' " << settings.lang_src << ">\n";
+    if (item.HasSymbolicId())
+        f << " <div class='id'>" << Escaped(item.GetSymbolicId()) << "</div>";
+    if (item.HasContext())
+        f << " <span class='msgctxt'>" << Escaped(item.GetContext()) << "</span>";
+    if (item.HasPlural())
+    {
+        f << "<ol class='plurals'>\n"
+          << "  <li>" << Escaped(item.GetString()) << "</li>\n"
+          << "  <li>" << Escaped(item.GetPluralString()) << "</li>\n"
+          << "</ol>\n";
+    }
+    else
+    {
+        f << Escaped(item.GetString());
+    }
+    f << "</td>\n";
+
+    // Translation:
+    if (settings.translated)
+    {
+        f << "<td class='tra' " << settings.lang_tra << ">\n";
+        if (item.HasPlural())
+        {
+            if (item.IsTranslated())
+            {
+                f << "<ol class='plurals'>\n";
+                for (auto& t: item.GetTranslations())
+                    f << "  <li>" << Escaped(t) << "</li>\n";
+                f << "</ol>\n";
+            }
+        }
+        else if (item.GetNumberOfTranslations() > 0)
+        {
+            f << Escaped(item.GetTranslations()[0]);
+        }
+        f << "</td>\n";
     }
 
+    // Notes, if present:
+    if (hasComments)
+    {
+        f << "</tr>\n"
+          << "<tr class='comments'>\n"
+          << "  <td colspan='" << (settings.translated ? 2 : 1) << "'><div>";
+        if (item.HasExtractedComments())
+        {
+            f << "<p>\n";
+            for (auto& n: item.GetExtractedComments())
+                f << Escaped(n) << "<br>\n";
+            f << "</p>\n";
+        }
+        if (item.HasComment())
+        {
+            f << "<p>\n"
+              << Escaped(item.GetComment())
+              << "</p>\n";
+        }
+        f << "</div></td>\n";
+    }
+
+    f << "</tr>\n";
+}
+
+
+// Writes the translations table with items [begin, end) of the catalog
+void WriteTranslations(HTMLWriter& f, Catalog& cat, const TableSettings& settings, size_t begin, size_t end)
+{
+    const auto srclang = cat.GetSourceLanguage();
+    const auto lang = settings.translated ? cat.GetLanguage() : Language();
+
     wxString thead_src;
-    if (UsesSymbolicIDsForSource())
+    if (cat.UsesSymbolicIDsForSource())
     {
         thead_src = _("Source text ID");
     }
@@ -148,98 +369,154 @@ void Catalog::ExportToHTML(std::ostream& f)
     f << "<table class='translations'>\n"
          "  <thead>\n"
          "    <tr>\n"
-         "      <th>" << str::to_utf8(thead_src) << "</th>\n";
-    if (translated)
+         "      <th>" << thead_src << "</th>\n";
+    if (settings.translated)
     {
-        f << "      <th>" << str::to_utf8(thead_tra) << "</th>\n";
+        f << "      <th>" << thead_tra << "</th>\n";
     }
     f << "    </tr>\n"
          "  </thead>\n"
          "  <tbody>\n";
 
-    for (auto& item: items())
+    auto& items = cat.items();
+
+#ifdef HAVE_PARALLEL_PROCESSING
+    // Format chunks of rows in parallel, but only a limited number of them
+    // at a time, so that the whole output doesn't have to be kept in memory:
+    const size_t chunksInBatch = 4 * std::max(1u, std::thread::hardware_concurrency());
+    for (size_t batch = begin; batch < end; batch += chunksInBatch * ROWS_CHUNK_SIZE)
     {
-        bool hasComments = item->HasComment() || item->HasExtractedComments();
-
-        std::string klass("i");
-        if (!item->IsTranslated())
-            klass += " untrans";
-        if (item->IsFuzzy())
-            klass += " fuzzy";
-        if (hasComments)
-            klass += " with-comments";
-        f << "<tr class='" << klass << "'>\n";
-
-        // Source string:
-        f << "<td class='src' " << lang_src << ">\n";
-        if (item->HasSymbolicId())
-            f << " <div class='id'>" << fmt_trans(item->GetSymbolicId()) << "</div>";
-        if (item->HasContext())
-            f << " <span class='msgctxt'>" << fmt_trans(item->GetContext()) << "</span>";
-        if (item->HasPlural())
+        const size_t batchEnd = std::min(end, batch + chunksInBatch * ROWS_CHUNK_SIZE);
+        const size_t chunks = (batchEnd - batch + ROWS_CHUNK_SIZE - 1) / ROWS_CHUNK_SIZE;
+        auto rows = dispatch::parallel_transform(chunks, [&](size_t n)
         {
-            f << "<ol class='plurals'>\n"
-              << "  <li>" << fmt_trans(item->GetString()) << "</li>\n"
-              << "  <li>" << fmt_trans(item->GetPluralString()) << "</li>\n"
-              << "</ol>\n";
+            HTMLWriter out;
+            const size_t chunkEnd = std::min(batchEnd, batch + (n + 1) * ROWS_CHUNK_SIZE);
+            for (size_t i = batch + n * ROWS_CHUNK_SIZE; i < chunkEnd; i++)
+                WriteItemRow(out, *items[i], settings);
+            return out.Take();
+        });
+        for (auto& r: rows)
+            f << r;
+    }
+#else
+    for (size_t i = begin; i < end; i++)
+        WriteItemRow(f, *items[i], settings);
+#endif
+
+    f << "</tbody>\n"
+         "</table>\n";
+}
+
+
+// Percent-encodes file name for use in a relative URL
+std::string FileNameToURL(const wxString& name)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string url;
+    for (unsigned char c: str::to_utf8(name))
+    {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+        {
+            url += c;
         }
         else
         {
-            f << fmt_trans(item->GetString());
+            url += '%';
+            url += hex[c >> 4];
+            url += hex[c & 0xF];
         }
-        f << "</td>\n";
+    }
+    return url;
+}
 
-        // Translation:
-        if (translated)
-        {
-            f << "<td class='tra' " << lang_tra << ">\n";
-            if (item->HasPlural())
-            {
-                if (item->IsTranslated())
-                {
-                    f << "<ol class='plurals'>\n";
-                    for (auto t: item->GetTranslations())
-                        f << "  <li>" << fmt_trans(t) << "</li>\n";
-                    f << "</ol>\n";
-                }
-            }
-            else
-            {
-                f << fmt_trans(item->GetTranslation());
-            }
-            f << "</td>\n";
-        }
+// Writes navigation links of paginated export
+void WritePageNavigation(HTMLWriter& f, const wxString& indexName, const std::vector<wxString>& pages, size_t page)
+{
+    f << "<p class='nav'>";
+    if (page > 0)
+        f << "<a href='" << FileNameToURL(pages[page - 1]) << "'>&larr;</a> ";
+    f << "<a href='" << FileNameToURL(indexName) << "'>";
+    f << Escaped(wxString::Format(_("Page %d of %d"), int(page + 1), int(pages.size()))) << "</a>";
+    if (page + 1 < pages.size())
+        f << " <a href='" << FileNameToURL(pages[page + 1]) << "'>&rarr;</a>";
+    f << "</p>\n";
+}
+
+void WriteFile(const wxString& filename, const std::function<void(HTMLWriter&)>& write)
+{
+    TempOutputFileFor tempfile(filename);
+    {
+        std::ofstream out;
+        out.open(tempfile.FileName().fn_str(), std::ios::binary);
+        HTMLWriter f(&out);
+        write(f);
+        f.Flush();
+        out.close();
+        if (!out)
+            BOOST_THROW_EXCEPTION(Exception(wxString::Format(_(L"Couldn’t save file %s."), filename)));
+    }
+    if (!tempfile.Commit())
+        BOOST_THROW_EXCEPTION(Exception(wxString::Format(_(L"Couldn’t save file %s."), filename)));
+}
+
+} // anonymous namespace
+
+void Catalog::ExportToHTML(std::ostream& output)
+{
+    const auto settings = GetTableSettings(*this);
+
+    HTMLWriter f(&output);
+    WriteHead(f, m_header.Project);
+    WriteSummary(f, *this, settings);
+    WriteTranslations(f, *this, settings, 0, m_items.size());
+    WriteFoot(f);
+}
+
+void Catalog::ExportToPaginatedHTML(const wxString& filename, size_t itemsPerPage)
+{
+    wxCHECK_RET( itemsPerPage > 0, "invalid page size" );
 
-        // Notes, if present:
-        if (hasComments)
+    const auto settings = GetTableSettings(*this);
+    const size_t count = m_items.size();
+
+    wxFileName index(filename);
+    std::vector<wxString> pages;
+    for (size_t n = 0; n * itemsPerPage < count || n == 0; n++)
+        pages.push_back(wxString::Format("%s-%d.html", index.GetName(), int(n + 1)));
+
+    // The named file is only an index with summary and links to the pages:
+    WriteFile(filename, [&](HTMLWriter& f)
+    {
+        WriteHead(f, m_header.Project);
+        WriteSummary(f, *this, settings);
+        f << "<table class='metadata pages'>\n";
+        for (size_t n = 0; n < pages.size(); n++)
         {
-            f << "</tr>\n"
-              << "<tr class='comments'>\n"
-              << "  <td colspan='" << (translated ? 2 : 1) << "'><div>";
-            if (item->HasExtractedComments())
-            {
-                f << "<p>\n";
-                for (auto& n: item->GetExtractedComments())
-                    f << fmt_trans(n) << "<br>\n";
-                f << "</p>\n";
-            }
-            if (item->HasComment())
-            {
-                f << "<p>\n"
-                  << fmt_trans(item->GetComment())
-                  << "</p>\n";
-            }
-            f << "</div></td>\n";
+            const size_t first = n * itemsPerPage;
+            const size_t last = std::min(count, first + itemsPerPage);
+            f << "<tr><td><a href='" << FileNameToURL(pages[n]) << "'>";
+            f << Escaped(wxString::Format(_("Page %d"), int(n + 1))) << "</a></td><td>";
+            f << Escaped(wxString::Format(_(L"Entries %d–%d"), int(std::min(count, first + 1)), int(last))) << "</td></tr>\n";
         }
+        f << "</table>\n";
+        WriteFoot(f);
+    });
 
-        f << "</tr>\n";
+    for (size_t n = 0; n < pages.size(); n++)
+    {
+        wxFileName pageFile(index);
+        pageFile.SetFullName(pages[n]);
+        WriteFile(pageFile.GetFullPath(), [&](HTMLWriter& f)
+        {
+            const size_t first = n * itemsPerPage;
+            WriteHead(f, m_header.Project);
+            WritePageNavigation(f, index.GetFullName(), pages, n);
+            WriteTranslations(f, *this, settings, first, std::min(count, first + itemsPerPage));
+            WritePageNavigation(f, index.GetFullName(), pages, n);
+            WriteFoot(f);
+        });
     }
-
-    f << "</tbody>\n"
-         "</table>\n"
-         "</div>\n"
-         "</body>\n"
-         "</html>\n";
 }
 
 
@@ -323,6 +600,10 @@ table.metadata td {
   padding-top: 12px;
   text-align: center;
 }
+.partial {
+  font-size: smaller;
+  text-align: center;
+}
 
 /* Translations */
 table.translations {
@@ -351,6 +632,10 @@ tr.comments div {
 tr.comments div p:last-child { margin-bottom: 0; }
 tr.comments td { padding-top: 0; }
 
+/* Pages of paginated export */
+.nav { margin: 10px 0; text-align: center; }
+table.pages td { padding-top: 2px; padding-bottom: 2px; }
+
 .id {
   font-size: smaller;
 }
@@ -371,6 +656,7 @@ body { background-color: #fff; color: #333; }
 .percent-fuzzy   { background-color: rgb(255, 149, 0); height: 10px; }
 .percent-untrans { background-color: #F1F1F1; height: 10px; }
 .legend          { color: #aaa; }
+.partial         { color: #aaa; }
 .id              { color: #aaa; }
 tr.comments div  { color: #aaa; }
 .fuzzy .tra      { color: rgb(230, 134, 0); }
@@ -382,6 +668,7 @@ tr.comments div  { color: #aaa; }
     body             { background-color: rgb(45, 42, 41); color: #eee; }
     .percent-untrans { background-color: rgba(255, 255, 255, 0.3); }
     .legend          { color: rgba(255, 255, 255, 0.6); }
+    .partial         { color: rgba(255, 255, 255, 0.6); }
     .id              { color: rgba(255, 255, 255, 0.6); }
     tr.comments div  { color: rgba(255, 255, 255, 0.6); }
     .fuzzy .tra      { color: rgb(253, 178, 72); }
@@ -27,13 +27,22 @@
 
 #include "extractor_legacy.h"
 
+#include "catalog_po.h"
+#include "errors.h"
 #include "gexecute.h"
+#include "tracing.h"
+
+#if wxUSE_GUI
+    #include "concurrency.h"
+    #define HAVE_PARALLEL_PROCESSING
+#endif
 
 #include <wx/dir.h>
 #include <wx/filename.h>
-#include <wx/textfile.h>
+#include <wx/thread.h>
 
 #include <algorithm>
+#include <exception>
 
 namespace
 {
@@ -93,22 +102,24 @@ inline bool IsVCSDir(const wxString& d)
 }
 
 
-int FindInDir(const wxString& basepath, const wxString& dirname, const PathsToMatch& excludedPaths,
-              Extractor::FilesList& output)
-{
-    if (dirname.empty())
-        return 0;
+/**
+    Lists content of a single directory @a dirname.
 
+    Found files are appended to @a files; subdirectories that should be
+    searched too are appended to @a subdirs.
+ */
+void ScanDir(const wxString& basepath, const wxString& dirname, const PathsToMatch& excludedPaths,
+             Extractor::FilesList& files, std::vector<wxString>& subdirs)
+{
     wxDir dir(basepath + dirname);
 
     CheckReadPermissions(basepath, dirname);
 
     if (!dir.IsOpened())
-        return 0;
+        return;
 
     bool cont;
     wxString iter;
-    int found = 0;
     
     cont = dir.GetFirst(&iter, wxEmptyString, wxDIR_FILES);
     while (cont)
@@ -127,8 +138,7 @@ int FindInDir(const wxString& basepath, const wxString& dirname, const PathsToMa
         
         CheckReadPermissions(basepath, fullpath);
         wxLogTrace("poedit.extractor", "  - %s", fullpath);
-        output.push_back(fullpath);
-        found++;
+        files.push_back(fullpath);
     }
 
     cont = dir.GetFirst(&iter, wxEmptyString, wxDIR_DIRS);
@@ -141,14 +151,71 @@ int FindInDir(const wxString& basepath, const wxString& dirname, const PathsToMa
         if (IsVCSDir(filename))
             continue;
 
+        // excluded directories are pruned early, without descending into them
         if (excludedPaths.MatchesFile(fullpath))
             continue;
 
         CheckReadPermissions(basepath, fullpath);
-        found += FindInDir(basepath, fullpath, excludedPaths, output);
+        subdirs.push_back(fullpath);
     }
+}
+
+
+int FindInDir(const wxString& basepath, const wxString& dirname, const PathsToMatch& excludedPaths,
+              Extractor::FilesList& output)
+{
+    if (dirname.empty())
+        return 0;
+
+    const size_t initialCount = output.size();
 
-    return found;
+    // Walk the tree breadth-first, scanning all directories at the same depth
+    // concurrently; this helps a lot with slow (e.g. network) filesystems:
+    std::vector<wxString> level { dirname };
+    while (!level.empty())
+    {
+        std::vector<Extractor::FilesList> files(level.size());
+        std::vector<std::vector<wxString>> subdirs(level.size());
+
+#ifdef HAVE_PARALLEL_PROCESSING
+        if (level.size() > 1)
+        {
+            std::vector<std::exception_ptr> errors(level.size());
+            dispatch::parallel_for(level.size(), [&](size_t i)
+            {
+                try
+                {
+                    ScanDir(basepath, level[i], excludedPaths, files[i], subdirs[i]);
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception();
+                }
+            });
+
+            for (auto& e: errors)
+            {
+                if (e)
+                    std::rethrow_exception(e);
+            }
+        }
+        else
+#endif
+        {
+            for (size_t i = 0; i < level.size(); i++)
+                ScanDir(basepath, level[i], excludedPaths, files[i], subdirs[i]);
+        }
+
+        std::vector<wxString> next;
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            output.insert(output.end(), files[i].begin(), files[i].end());
+            next.insert(next.end(), subdirs[i].begin(), subdirs[i].end());
+        }
+        level.swap(next);
+    }
+
+    return int(output.size() - initialCount);
 }
 
 } // anonymous namespace
@@ -207,21 +274,26 @@ ExtractionOutput Extractor::ExtractWithAll(TempDirectory& tmpdir,
                                            const SourceCodeSpec& sourceSpec,
                                            const std::vector<wxString>& files_)
 {
+    TRACE_SPAN("extraction", "ExtractWithAll");
     auto files = files_;
     wxLogTrace("poedit.extractor", "extracting from %d files", (int)files.size());
 
-    std::vector<ExtractionOutput> partials;
+    // Assign files to extractors first; this is cheap and the resulting sets
+    // are disjoint, so the (slow) extraction itself can run concurrently:
+    struct Job
+    {
+        std::shared_ptr<Extractor> extractor;
+        FilesList files;
+    };
+    std::vector<Job> jobs;
 
     for (auto ex: CreateAllExtractors(sourceSpec))
     {
-        const auto ex_files = ex->FilterFiles(files);
+        auto ex_files = ex->FilterFiles(files);
         if (ex_files.empty())
             continue;
 
         wxLogTrace("poedit.extractor", " .. using extractor '%s' for %d files", ex->GetId(), (int)ex_files.size());
-        auto sub = ex->Extract(tmpdir, sourceSpec, ex_files);
-        if (sub)
-            partials.push_back(sub);
 
         if (files.size() > ex_files.size())
         {
@@ -236,10 +308,56 @@ ExtractionOutput Extractor::ExtractWithAll(TempDirectory& tmpdir,
         else
         {
             files.clear();
+        }
+
+        jobs.push_back({ex, std::move(ex_files)});
+
+        if (files.empty())
             break; // no more work to do
+    }
+
+    std::vector<ExtractionOutput> results(jobs.size());
+    std::vector<std::exception_ptr> errors(jobs.size());
+
+    auto runJob = [&](size_t i)
+    {
+        try
+        {
+            results[i] = jobs[i].extractor->Extract(tmpdir, sourceSpec, jobs[i].files);
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    };
+
+#ifdef HAVE_PARALLEL_PROCESSING
+    // Subprocesses are launched from the main thread on behalf of background
+    // ones, so waiting for them there would deadlock:
+    if (jobs.size() > 1 && !wxThread::IsMain())
+    {
+        dispatch::parallel_for(jobs.size(), runJob);
+    }
+    else
+#endif
+    {
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            runJob(i);
+            if (errors[i])
+                break;
         }
     }
 
+    std::vector<ExtractionOutput> partials;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        if (errors[i])
+            std::rethrow_exception(errors[i]);
+        if (results[i])
+            partials.push_back(results[i]);
+    }
+
     wxLogTrace("poedit.extractor", "extraction finished with %d unrecognized files and %d sub-POTs", (int)files.size(), (int)partials.size());
 
     if (partials.empty())
@@ -253,7 +371,7 @@ ExtractionOutput Extractor::ExtractWithAll(TempDirectory& tmpdir,
     else
     {
         wxLogTrace("poedit.extractor", "merging %d subPOTs", (int)partials.size());
-        return ConcatPartials(tmpdir, partials);
+        return ConcatPartials(partials);
     }
 }
 
@@ -319,7 +437,15 @@ void Extractor::RegisterWildcard(const wxString& wildcard)
 }
 
 
-ExtractionOutput Extractor::ConcatPartials(TempDirectory& tmpdir, const std::vector<ExtractionOutput>& partials)
+POCatalogPtr ExtractionOutput::LoadCatalog() const
+{
+    if (catalog)
+        return catalog;
+    return POCatalog::Create(pot_file, Catalog::CreationFlag_IgnoreHeader);
+}
+
+
+ExtractionOutput Extractor::ConcatPartials(const std::vector<ExtractionOutput>& partials)
 {
     if (partials.empty())
     {
@@ -331,42 +457,42 @@ ExtractionOutput Extractor::ConcatPartials(TempDirectory& tmpdir, const std::vec
     }
 
     ExtractionOutput result;
-    result.pot_file = tmpdir.CreateFileName("concatenated.pot");
-
-    wxTextFile filelist;
-    filelist.Create(tmpdir.CreateFileName("gettext_filelist.txt"));
     for (auto& p: partials)
+        result.errors += p.errors;
+
+    std::vector<POCatalogPtr> catalogs(partials.size());
+    std::vector<std::exception_ptr> errors(partials.size());
+
+    auto load = [&](size_t i)
     {
-        auto fn = p.pot_file;
-#ifdef __WXMSW__
-        // Gettext tools can't handle Unicode filenames well (due to using
-        // char* arguments), so work around this by using the short names.
-        if (!fn.IsAscii())
+        try
         {
-            fn = CliSafeFileName(fn);
-            fn.Replace("\\", "/");
+            catalogs[i] = partials[i].LoadCatalog();
         }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    };
+
+#ifdef HAVE_PARALLEL_PROCESSING
+    dispatch::parallel_for(partials.size(), load);
+#else
+    for (size_t i = 0; i < partials.size(); i++)
+        load(i);
 #endif
-        filelist.AddLine(fn);
-        result.errors += p.errors;
-    }
-    filelist.Write(wxTextFileType_Unix, wxConvFile);
-
-    GettextRunner gt;
-    auto output = gt.run_sync("msgcat",
-                              "--force-po",
-                              // avoid corrupted content of duplicate "" headers
-                              // FIXME: merge headers intelligently, e.g. pick latest POT-Creation-Date
-                              "--use-first",
-                              "-o", result.pot_file,
-                              "--files-from", filelist.GetName());
-    if (output.failed())
+
+    for (auto& e: errors)
     {
-        wxLogError("msgcat: %s", output.std_err);
-        wxLogError(_("Failed to merge gettext catalogs."));
-        BOOST_THROW_EXCEPTION(ExtractionException(ExtractionError::Unspecified));
+        if (e)
+        {
+            wxLogError("%s", DescribeException(e));
+            wxLogError(_("Failed to merge gettext catalogs."));
+            BOOST_THROW_EXCEPTION(ExtractionException(ExtractionError::Unspecified));
+        }
     }
 
+    result.catalog = POCatalog::Concatenate(catalogs);
     return result;
 }
 
@@ -379,6 +505,7 @@ Extractor::ExtractorsList Extractor::CreateAllExtractors(const SourceCodeSpec& s
     CreateAllLegacyExtractors(all, sources);
 
     // Standard builtin extractors follow
+    CreateNativeExtractors(all, sources);
     CreateGettextExtractors(all, sources);
 
     std::stable_sort(all.begin(), all.end(), [](const auto& a, const auto& b)
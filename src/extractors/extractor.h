@@ -37,6 +37,9 @@
 #include "gexecute.h"
 #include "utility.h"
 
+class POCatalog;
+typedef std::shared_ptr<POCatalog> POCatalogPtr;
+
 
 /// Specification of the source code to search.
 struct SourceCodeSpec
@@ -75,13 +78,19 @@ public:
 /// Complete result of running an extraction task.
 struct ExtractionOutput
 {
-    /// POT file containing extracted strings.
+    /// POT file containing extracted strings; empty if @a catalog is set instead.
     wxString pot_file;
 
     /// Errors/warnings that occurred during extraction.
     ParsedGettextErrors errors;
 
-    explicit operator bool() const { return !pot_file.empty(); }
+    /// Already loaded extracted strings, if they were merged in memory.
+    POCatalogPtr catalog;
+
+    explicit operator bool() const { return !pot_file.empty() || catalog; }
+
+    /// Returns the extracted strings, loading them from @a pot_file if needed.
+    POCatalogPtr LoadCatalog() const;
 };
 
 
@@ -179,8 +188,8 @@ protected:
     /// Check if file is supported based on its extension
     bool HasKnownExtension(const wxString& file) const;
 
-    /// Concatenates partial outputs using msgcat
-    static ExtractionOutput ConcatPartials(TempDirectory& tmpdir, const std::vector<ExtractionOutput>& partials);
+    /// Concatenates partial outputs in memory (like msgcat would)
+    static ExtractionOutput ConcatPartials(const std::vector<ExtractionOutput>& partials);
 
 private:
     Priority m_priority;
@@ -191,6 +200,7 @@ protected:
     // private factories:
     static void CreateAllLegacyExtractors(ExtractorsList& into, const SourceCodeSpec& sources);
     static void CreateGettextExtractors(ExtractorsList& into, const SourceCodeSpec& sources);
+    static void CreateNativeExtractors(ExtractorsList& into, const SourceCodeSpec& sources);
 };
 
 #endif // Poedit_extractor_h
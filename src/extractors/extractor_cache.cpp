@@ -0,0 +1,145 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "extractor_cache.h"
+
+#include "edapp.h"
+#include "str_helpers.h"
+#include "utility.h"
+
+#include <wx/dir.h>
+#include <wx/filefn.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+
+#include <cstring>
+#include <ctime>
+
+
+namespace
+{
+
+// Increment to invalidate all existing entries, e.g. when output's postprocessing changes
+const char *CACHE_FORMAT_VERSION = "1";
+
+// Entries not used for this long are removed by Prune()
+const time_t MAX_UNUSED_AGE = 30 * 24 * 60 * 60;
+
+inline uint64_t HashString(const std::string& s, uint64_t hash)
+{
+    // include terminating NUL to separate consecutive strings
+    return HashFNV1a(s.c_str(), s.size() + 1, hash);
+}
+
+} // anonymous namespace
+
+
+ExtractionCache& ExtractionCache::Get()
+{
+    static ExtractionCache instance(PoeditApp::GetCacheDir("Extraction"));
+    return instance;
+}
+
+
+ExtractionCache::Key ExtractionCache::ComputeKey(const wxString& basepath, const Extractor::FilesList& files, const wxString& settings)
+{
+    uint64_t hash = HashFNV1a(CACHE_FORMAT_VERSION, strlen(CACHE_FORMAT_VERSION) + 1);
+    hash = HashString(str::to_utf8(settings), hash);
+    hash = HashString(str::to_utf8(basepath), hash);
+
+    for (auto& fn: files)
+    {
+        hash = HashString(str::to_utf8(fn), hash);
+
+        int64_t meta[2] = { -1, -1 };
+        wxStructStat st;
+        if (wxStat(basepath + fn, &st) == 0)
+        {
+            meta[0] = (int64_t)st.st_size;
+            meta[1] = (int64_t)st.st_mtime;
+        }
+        hash = HashFNV1a(meta, sizeof(meta), hash);
+    }
+
+    return wxString::Format("%016llx%08x", (unsigned long long)hash, (unsigned)files.size()).ToStdString();
+}
+
+
+wxString ExtractionCache::GetCacheFile(const Key& key) const
+{
+    return m_dir + wxFILE_SEP_PATH + key + ".pot";
+}
+
+
+wxString ExtractionCache::Lookup(const Key& key) const
+{
+    const auto filename = GetCacheFile(key);
+    if (!wxFileName::FileExists(filename))
+        return wxString();
+
+    // mark the entry as recently used for Prune()
+    wxFileName(filename).Touch();
+
+    wxLogTrace("poedit.extractor", " .. reusing cached %s", filename);
+    return filename;
+}
+
+
+void ExtractionCache::Store(const Key& key, const wxString& potFile) const
+{
+    // failing to write the cache is not an error worth reporting
+    wxLogNull null;
+
+    if (!wxFileName::DirExists(m_dir) && !wxFileName::Mkdir(m_dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+        return;
+
+    TempOutputFileFor tempfile(GetCacheFile(key));
+    if (wxCopyFile(potFile, tempfile.FileName()))
+        tempfile.Commit();
+}
+
+
+void ExtractionCache::Prune() const
+{
+    wxLogNull null;
+
+    wxDir dir(m_dir);
+    if (!dir.IsOpened())
+        return;
+
+    const time_t cutoff = time(NULL) - MAX_UNUSED_AGE;
+
+    wxArrayString obsolete;
+    wxString name;
+    for (bool cont = dir.GetFirst(&name, "*.pot", wxDIR_FILES); cont; cont = dir.GetNext(&name))
+    {
+        auto path = m_dir + wxFILE_SEP_PATH + name;
+        if (wxFileModificationTime(path) < cutoff)
+            obsolete.push_back(path);
+    }
+
+    for (auto& path: obsolete)
+        wxRemoveFile(path);
+}
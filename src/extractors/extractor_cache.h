@@ -0,0 +1,81 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_extractor_cache_h
+#define Poedit_extractor_cache_h
+
+#include "extractor.h"
+
+#include <wx/string.h>
+
+#include <string>
+
+
+/**
+    On-disk cache of partial POT files extracted from source files.
+
+    Extraction is done in chunks of files and each chunk's output is stored
+    separately. It is reused as long as none of the chunk's files changed (as
+    determined by their size and modification time) and the extraction
+    settings are the same.
+
+    All methods are safe to call from multiple threads concurrently.
+ */
+class ExtractionCache
+{
+public:
+    /// Identification of chunk's content and extraction settings
+    typedef std::string Key;
+
+    /// Return singleton instance of the cache.
+    static ExtractionCache& Get();
+
+    /**
+        Computes key for the chunk consisting of @a files.
+
+        @param basepath Base directory that @a files are relative to.
+        @param settings Description of everything else that affects the output,
+                        e.g. the extractor's command line.
+     */
+    static Key ComputeKey(const wxString& basepath, const Extractor::FilesList& files, const wxString& settings);
+
+    /// Returns cached POT file for @a key or empty string if there's none.
+    wxString Lookup(const Key& key) const;
+
+    /// Stores a copy of @a potFile in the cache under @a key.
+    void Store(const Key& key, const wxString& potFile) const;
+
+    /// Removes entries that weren't used for a long time.
+    void Prune() const;
+
+private:
+    ExtractionCache(const wxString& dir) : m_dir(dir) {}
+
+    wxString GetCacheFile(const Key& key) const;
+
+    wxString m_dir;
+};
+
+#endif // Poedit_extractor_cache_h
@@ -25,9 +25,20 @@
 
 #include "extractor.h"
 
+#include "extractor_cache.h"
 #include "gexecute.h"
+#include "str_helpers.h"
+#include "tracing.h"
+
+#if wxUSE_GUI
+    #include "concurrency.h"
+    #define HAVE_PARALLEL_PROCESSING
+#endif
 
 #include <wx/textfile.h>
+#include <wx/thread.h>
+
+#include <exception>
 
 namespace
 {
@@ -90,6 +101,36 @@ const char * const GETTEXT_EXTENSIONS[] = {
 };
 
 
+// Average and maximum number of files in a chunk extracted by single xgettext process
+const unsigned CHUNK_AVG_FILES = 256;
+const size_t CHUNK_MAX_FILES = 1024;
+
+/**
+    Splits @a files into chunks that are extracted and cached separately.
+
+    Chunk boundaries are determined by files' names rather than their positions,
+    so that adding or removing a file only affects the chunk it belongs to and
+    doesn't invalidate cached output of the others. The chunks are contiguous
+    ranges of @a files, so that concatenating their outputs preserves the order
+    of messages and references.
+ */
+std::vector<Extractor::FilesList> SplitIntoChunks(const Extractor::FilesList& files)
+{
+    std::vector<Extractor::FilesList> chunks(1);
+    for (auto& fn: files)
+    {
+        auto& last = chunks.back();
+        if (!last.empty())
+        {
+            const auto utf8 = str::to_utf8(fn);
+            if (HashFNV1a(utf8.data(), utf8.size()) % CHUNK_AVG_FILES == 0 || last.size() >= CHUNK_MAX_FILES)
+                chunks.emplace_back();
+        }
+        chunks.back().push_back(fn);
+    }
+    return chunks;
+}
+
 } // anonymous namespace
 
 
@@ -100,10 +141,117 @@ public:
     ExtractionOutput Extract(TempDirectory& tmpdir,
                              const SourceCodeSpec& sourceSpec,
                              const std::vector<wxString>& files) const override
+    {
+        const auto options = GetOptions(sourceSpec);
+        const auto settings = wxString::Format("%s %u %s", GetId(), (unsigned)get_gettext_version(), options);
+        const auto chunks = SplitIntoChunks(files);
+
+        auto& cache = ExtractionCache::Get();
+
+        std::vector<ExtractionOutput> partials(chunks.size());
+        std::vector<std::exception_ptr> errors(chunks.size());
+
+        auto extractChunk = [&](size_t i)
+        {
+            try
+            {
+                const auto key = ExtractionCache::ComputeKey(sourceSpec.BasePath, chunks[i], settings);
+                auto cached = cache.Lookup(key);
+                if (!cached.empty())
+                {
+                    partials[i].pot_file = cached;
+                    return;
+                }
+
+                partials[i] = RunXgettext(tmpdir, sourceSpec.BasePath, chunks[i], options);
+                cache.Store(key, partials[i].pot_file);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        };
+
+#ifdef HAVE_PARALLEL_PROCESSING
+        // xgettext is single-threaded, so run several processes concurrently;
+        // they are launched from the main thread on behalf of background
+        // ones, so this can't be done when called on the main one
+        if (chunks.size() > 1 && !wxThread::IsMain())
+        {
+            wxLogTrace("poedit.extractor", " .. extracting %d files in %d chunks", (int)files.size(), (int)chunks.size());
+            dispatch::parallel_for(chunks.size(), extractChunk);
+        }
+        else
+#endif
+        {
+            for (size_t i = 0; i < chunks.size(); i++)
+            {
+                extractChunk(i);
+                if (errors[i])
+                    break;
+            }
+        }
+
+        for (auto& e: errors)
+        {
+            if (e)
+                std::rethrow_exception(e);
+        }
+
+        cache.Prune();
+
+        return ConcatPartials(partials);
+    }
+
+protected:
+    /// Returns xgettext options that don't depend on the files being extracted
+    wxString GetOptions(const SourceCodeSpec& sourceSpec) const
     {
         using subprocess::quote_arg;
 
-        auto basepath = sourceSpec.BasePath;
+        wxString options = wxString::Format("--from-code=%s", quote_arg(!sourceSpec.Charset.empty() ? sourceSpec.Charset : "UTF-8"));
+
+        if (check_gettext_version(0, 24, 1))
+        {
+            // This avoids the implied slowness of determining files' mtimes from git. Cached output
+            // is invalidated based on mtimes from the filesystem, which Poedit computes itself.
+            options += " --no-git";
+        }
+
+        auto additional = GetAdditionalFlags();
+        if (!additional.empty())
+            options += " " + additional;
+
+        for (auto& kw: sourceSpec.Keywords)
+        {
+            options += wxString::Format(" -k%s", quote_arg(kw));
+        }
+
+        wxString extraFlags;
+        try
+        {
+            extraFlags = sourceSpec.XHeaders.at("X-Poedit-Flags-xgettext");
+        }
+        catch (std::out_of_range&) {}
+
+        if (!extraFlags.Contains("--add-comments"))
+            options += " --add-comments=TRANSLATORS:";
+
+        if (!extraFlags.empty())
+            options += " " + extraFlags;
+
+        return options;
+    }
+
+    /// Runs single xgettext process over all of @a files
+    ExtractionOutput RunXgettext(TempDirectory& tmpdir,
+                                 wxString basepath,
+                                 const std::vector<wxString>& files,
+                                 const wxString& options) const
+    {
+        TRACE_SPAN("extraction", "xgettext");
+        using subprocess::quote_arg;
+
 #ifdef __WXMSW__
         basepath = CliSafeFileName(basepath);
         basepath.Replace("\\", "/");
@@ -131,11 +279,10 @@ public:
         wxString cmdline;
         cmdline.Printf
         (
-            "xgettext --force-po -o %s --directory=%s --files-from=%s --from-code=%s",
+            "xgettext --force-po -o %s --directory=%s --files-from=%s",
             quote_arg(outfile),
             quote_arg(basepath),
-            quote_arg(filelist.GetName()),
-            quote_arg(!sourceSpec.Charset.empty() ? sourceSpec.Charset : "UTF-8")
+            quote_arg(filelist.GetName())
         );
 
         if (check_gettext_version(0, 25))
@@ -144,34 +291,7 @@ public:
             cmdline += wxString::Format(" --generated=%s", quote_arg(filelist.GetName()));
         }
 
-        if (check_gettext_version(0, 24, 1))
-        {
-            // FIXME: This is temporary, to avoid the implied slowness. Should be amended with
-            //        calculating mtimes in parallel in Poedit itself.
-            cmdline += " --no-git";
-        }
-
-        auto additional = GetAdditionalFlags();
-        if (!additional.empty())
-            cmdline += " " + additional;
-
-        for (auto& kw: sourceSpec.Keywords)
-        {
-            cmdline += wxString::Format(" -k%s", quote_arg(kw));
-        }
-
-        wxString extraFlags;
-        try
-        {
-            extraFlags = sourceSpec.XHeaders.at("X-Poedit-Flags-xgettext");
-        }
-        catch (std::out_of_range&) {}
-
-        if (!extraFlags.Contains("--add-comments"))
-            cmdline += " --add-comments=TRANSLATORS:";
-
-        if (!extraFlags.empty())
-            cmdline += " " + extraFlags;
+        cmdline += " " + options;
 
         GettextRunner runner;
         auto output = runner.run_command_sync(cmdline);
@@ -185,8 +305,7 @@ public:
 
         return {outfile, err};
     }
-    
-protected:
+
     virtual wxString GetAdditionalFlags() const = 0;
 };
 
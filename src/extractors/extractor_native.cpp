@@ -0,0 +1,89 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "extractor_native.h"
+
+#if wxUSE_GUI
+    #include "concurrency.h"
+    #define HAVE_PARALLEL_PROCESSING
+#endif
+
+#include <exception>
+#include <iterator>
+
+
+ExtractionOutput NativeExtractor::Extract(TempDirectory& /*tmpdir*/,
+                                          const SourceCodeSpec& sourceSpec,
+                                          const std::vector<wxString>& files) const
+{
+    std::vector<std::vector<ExtractedMessage>> messages(files.size());
+    std::vector<ParsedGettextErrors> problems(files.size());
+    std::vector<std::exception_ptr> errors(files.size());
+
+    auto extractFile = [&](size_t i)
+    {
+        try
+        {
+            ExtractFromFile(sourceSpec, files[i], messages[i], problems[i]);
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    };
+
+#ifdef HAVE_PARALLEL_PROCESSING
+    dispatch::parallel_for(files.size(), extractFile);
+#else
+    for (size_t i = 0; i < files.size(); i++)
+        extractFile(i);
+#endif
+
+    for (auto& e: errors)
+    {
+        if (e)
+            std::rethrow_exception(e);
+    }
+
+    ExtractionOutput output;
+
+    // keep the order of files, like xgettext does:
+    std::vector<ExtractedMessage> all;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        output.errors += problems[i];
+        std::move(messages[i].begin(), messages[i].end(), std::back_inserter(all));
+    }
+
+    output.catalog = POCatalog::CreateFromExtracted(all);
+    return output;
+}
+
+
+void Extractor::CreateNativeExtractors(Extractor::ExtractorsList& /*into*/, const SourceCodeSpec& /*sources*/)
+{
+    // Builtin in-process extractors (instances of NativeExtractor subclasses)
+    // are registered here; there are none yet.
+}
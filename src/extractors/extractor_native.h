@@ -0,0 +1,68 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_extractor_native_h
+#define Poedit_extractor_native_h
+
+#include "extractor.h"
+
+#include "catalog_po.h"
+
+#include <vector>
+
+
+/**
+    Base class for extractors implemented in Poedit itself, i.e. in-process,
+    rather than by running an external program.
+
+    Derived classes only implement ExtractFromFile(). Files are processed
+    concurrently and the extracted strings go directly into an in-memory
+    catalog, without any temporary files.
+ */
+class NativeExtractor : public Extractor
+{
+public:
+    ExtractionOutput Extract(TempDirectory& tmpdir,
+                             const SourceCodeSpec& sourceSpec,
+                             const std::vector<wxString>& files) const final;
+
+protected:
+    /**
+        Extracts strings from @a file, appending them to @a messages.
+
+        @a file is relative to sourceSpec.BasePath. This is called for
+        different files from multiple threads concurrently and must be
+        thread-safe.
+
+        Problems with the file's content can be reported in @a errors; throw
+        ExtractionException if extraction fails altogether.
+     */
+    virtual void ExtractFromFile(const SourceCodeSpec& sourceSpec,
+                                 const wxString& file,
+                                 std::vector<ExtractedMessage>& messages,
+                                 ParsedGettextErrors& errors) const = 0;
+};
+
+#endif // Poedit_extractor_native_h
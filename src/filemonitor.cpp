@@ -27,11 +27,16 @@
 
 #include "edframe.h"
 #include "str_helpers.h"
+#include "utility.h"
 
+#include <wx/file.h>
 #include <wx/fswatcher.h>
+#include <wx/timer.h>
 
 #include <algorithm>
+#include <map>
 #include <memory>
+#include <set>
 #include <vector>
 
 
@@ -124,8 +129,13 @@ public:
         return ms_instance;
     }
 
+    // Directories are reference-counted, because several open files may be
+    // in the same one and they all share a single watch:
     void Add(const wxFileName& dir)
     {
+        if (m_refs[dir.GetPath()]++ > 0)
+            return;
+
         if (m_watcher)
         {
             m_watcher->Add(dir, MONITORING_FLASG);
@@ -139,6 +149,11 @@ public:
 
     void Remove(const wxFileName& dir)
     {
+        auto ref = m_refs.find(dir.GetPath());
+        if (ref == m_refs.end() || --ref->second > 0)
+            return;
+        m_refs.erase(ref);
+
         if (m_watcher)
         {
             m_watcher->Remove(dir);
@@ -165,7 +180,7 @@ public:
         });
 
         for (auto& dir : m_pending)
-            Add(dir);
+            m_watcher->Add(dir, MONITORING_FLASG);
         m_pending.clear();
     }
 
@@ -175,6 +190,7 @@ private:
     FSWatcher() {}
 
     std::vector<wxFileName> m_pending;
+    std::map<wxString, int> m_refs;
     std::unique_ptr<wxFileSystemWatcher> m_watcher;
 
     static std::shared_ptr<FSWatcher> ms_instance;
@@ -212,6 +228,76 @@ private:
 #endif // !__WXOSX__
 
 
+namespace
+{
+
+// How long must a file be left alone after a change before reloading it:
+const int SETTLE_DELAY_MS = 500;
+
+// Collects change notifications until the files settle
+class ChangesCoalescer : public wxTimer
+{
+public:
+    static ChangesCoalescer& Get()
+    {
+        if (!ms_instance)
+            ms_instance.reset(new ChangesCoalescer);
+        return *ms_instance;
+    }
+
+    static void CleanUp() { ms_instance.reset(); }
+
+    void Add(const wxString& path)
+    {
+        m_changed.insert(path);
+        // restart the countdown, the file may still be being written:
+        StartOnce(SETTLE_DELAY_MS);
+    }
+
+    void Notify() override
+    {
+        auto changed = std::move(m_changed);
+        m_changed.clear();
+        for (auto& path: changed)
+        {
+            auto window = PoeditFrame::Find(path);
+            if (window)
+                window->ReloadFileIfChanged();
+        }
+    }
+
+private:
+    std::set<wxString> m_changed;
+
+    static std::unique_ptr<ChangesCoalescer> ms_instance;
+};
+
+std::unique_ptr<ChangesCoalescer> ChangesCoalescer::ms_instance;
+
+
+uint64_t HashFileContent(const wxString& path)
+{
+    wxFile file;
+    if (!file.Open(path))
+        return 0;
+
+    uint64_t hash = HashFNV1a(nullptr, 0);
+    std::vector<char> buffer(64 * 1024);
+    for (;;)
+    {
+        auto read = file.Read(buffer.data(), buffer.size());
+        if (read == wxInvalidOffset)
+            return 0;
+        if (read == 0)
+            break;
+        hash = HashFNV1a(buffer.data(), (size_t)read, hash);
+    }
+    return hash;
+}
+
+} // anonymous namespace
+
+
 void FileMonitor::EventLoopStarted()
 {
 #ifndef __WXOSX__
@@ -223,6 +309,7 @@ void FileMonitor::EventLoopStarted()
 
 void FileMonitor::CleanUp()
 {
+    ChangesCoalescer::CleanUp();
 #ifndef __WXOSX__
     FSWatcher::CleanUp();
 #endif
@@ -241,32 +328,81 @@ FileMonitor::~FileMonitor()
 void FileMonitor::SetFile(wxFileName file)
 {
     // unmonitor first (needed even if the filename didn't change)
-    if (file == m_file)
+    if (file != m_file)
     {
-        m_loadTime = m_file.GetModificationTime();
-        return;
-    }
+        Reset();
 
-    Reset();
+        m_file = file;
+        if (!m_file.IsOk())
+            return;
 
-    m_file = file;
-    if (!m_file.IsOk())
-        return;
+        m_impl = std::make_unique<Impl>(m_file);
+    }
 
-    m_impl = std::make_unique<Impl>(m_file);
     m_loadTime = m_file.GetModificationTime();
+    m_loadSize = m_file.GetSize();
+    m_loadHash = 0;
+
+    // Remember the content to recognize touches that don't modify it. This
+    // is only needed after the file changes, so don't delay loading with it:
+    auto path = m_file.GetFullPath();
+    auto loadTime = m_loadTime;
+    m_loadHashComputation = dispatch::async([=]
+    {
+        auto hash = HashFileContent(path);
+        // don't use the hash if changed already, it wouldn't be of the loaded content:
+        if (wxFileName(path).GetModificationTime() != loadTime)
+            return uint64_t(0);
+        return hash;
+    });
 }
 
 void FileMonitor::Reset()
 {
     m_impl.reset();
     m_file.Clear();
+    m_loadHashComputation = dispatch::future<uint64_t>();
+    m_loadHash = 0;
+}
+
+bool FileMonitor::WasModifiedOnDisk()
+{
+    if (!m_file.IsOk())
+        return false;
+    if (!m_file.FileExists())
+        return false;
+
+    const auto modTime = m_file.GetModificationTime();
+    if (m_loadTime == modTime)
+        return false;
+
+    if (m_file.GetSize() != m_loadSize)
+        return true;
+
+    if (m_loadHashComputation.valid())
+    {
+        try
+        {
+            m_loadHash = m_loadHashComputation.get();
+        }
+        catch (...)
+        {
+            m_loadHash = 0;
+        }
+        m_loadHashComputation = dispatch::future<uint64_t>();
+    }
+
+    if (m_loadHash == 0 || HashFileContent(m_file.GetFullPath()) != m_loadHash)
+        return true;
+
+    // only touched, treat the current state as the loaded one:
+    wxLogTrace("poedit.monitor", "file %s touched, but content didn't change", m_file.GetFullPath());
+    m_loadTime = modTime;
+    return false;
 }
 
 void FileMonitor::NotifyFileChanged(const wxString& path)
 {
-    auto window = PoeditFrame::Find(path);
-    if (window)
-        window->ReloadFileIfChanged();
+    ChangesCoalescer::Get().Add(path);
 }
 
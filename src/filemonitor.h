@@ -28,6 +28,7 @@
 #define Poedit_filemonitor_h
 
 #include "edapp.h"
+#include "concurrency.h"
 
 #include <wx/filename.h>
 
@@ -42,14 +43,14 @@ public:
 
     void SetFile(wxFileName file);
 
-    bool WasModifiedOnDisk() const
-    {
-        if (!m_file.IsOk())
-            return false;
-        if (!m_file.FileExists())
-            return false;
-        return m_loadTime != m_file.GetModificationTime();
-    }
+    /**
+        Returns true if the file's content differs from when it was loaded
+        or saved.
+
+        Only touching the file, without changing its content, doesn't count
+        as modification.
+     */
+    bool WasModifiedOnDisk();
 
     // if true is returned, _must_ call StopRespondingToEvent() afterwards
     bool ShouldRespondToFileChange()
@@ -91,6 +92,14 @@ public:
 
     // the following is public only for the needs of filemonitor.cpp implementations:
     class Impl;
+
+    /**
+        Notifies the window with @a path open about its change.
+
+        Notifications are coalesced and only delivered after the file is
+        left alone for a while, so that a file written in several steps
+        is only reloaded once.
+     */
     static void NotifyFileChanged(const wxString& path);
 
 private:
@@ -101,6 +110,10 @@ private:
     wxString m_monitoredPath;
     wxFileName m_file, m_dir;
     wxDateTime m_loadTime;
+    wxULongLong m_loadSize;
+    // hash of content as loaded, computed in the background; 0 if unknown
+    dispatch::future<uint64_t> m_loadHashComputation;
+    uint64_t m_loadHash = 0;
 
     std::unique_ptr<Impl> m_impl;
 };
@@ -48,8 +48,15 @@
 #include <wx/msw/webview_ie.h>
 #endif
 
+#include <algorithm>
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <unordered_map>
 
+#include "cache_registry.h"
+#include "concurrency.h"
 #include "customcontrols.h"
 #include "hidpi.h"
 #include "utility.h"
@@ -64,7 +71,22 @@ const int FRAME_STYLE = wxDEFAULT_FRAME_STYLE | wxFRAME_TOOL_WINDOW;
 const int FRAME_STYLE = wxDEFAULT_FRAME_STYLE;
 #endif
 
-wxString FileToHTMLMarkup(const wxTextFile& file, const wxString& ext, size_t lineno);
+// Number of lines shown before and after the referenced line initially:
+const size_t CONTEXT_LINES = 500;
+// Number of lines added when the user asks for more context:
+const size_t EXPAND_LINES = 2000;
+// Lines longer than this (e.g. in minified JavaScript) are shown truncated:
+const size_t MAX_LINE_LENGTH = 2000;
+
+// Maximum number of files kept in memory and of rendered windows per file:
+const size_t MAX_CACHED_FILES = 16;
+const size_t MAX_CACHED_WINDOWS = 4;
+
+// Pseudo-URLs used for links expanding the rendered window:
+const char *EXPAND_ABOVE_URL = "poedit-fileviewer:expand-above";
+const char *EXPAND_BELOW_URL = "poedit-fileviewer:expand-below";
+
+wxString FileToHTMLMarkup(const wxTextFile& file, const wxString& ext, size_t lineno, size_t from, size_t to);
 
 extern const char *HTML_POEDIT_CSS;
 extern const char *SVG_ICON;
@@ -82,6 +104,119 @@ struct FileViewer::TempFile
 #endif
 
 
+/// Loaded content of a source file, valid for as long as the file isn't modified
+struct FileViewer::SourceFile
+{
+    wxString path;
+    wxString ext;
+    wxDateTime modified;
+    wxULongLong size;
+    wxTextFile file;
+
+    // approximate memory used by the file's content and last use, for CacheRegistry
+    size_t memory = 0;
+    CacheRegistry::Timestamp lastUse = 0;
+
+    // Already rendered windows, keyed by (line, from, to). Only accessed from
+    // the main thread.
+    std::map<std::tuple<size_t, size_t, size_t>, wxString> rendered;
+};
+
+
+/// Thread-safe cache of loaded source files, with least recently used eviction
+class FileViewer::SourceFilesCache : public CacheRegistry::Cache
+{
+public:
+    static SourceFilesCache& Get()
+    {
+        static SourceFilesCache instance;
+        return instance;
+    }
+
+    SourceFilesCache() { CacheRegistry::Register(this); }
+    ~SourceFilesCache() { CacheRegistry::Unregister(this); }
+
+    size_t GetMemoryUsage() const override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t size = 0;
+        for (auto& f: m_files)
+            size += f->memory;
+        return size;
+    }
+
+    CacheRegistry::Timestamp GetOldestUse() const override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_files.empty() ? CacheRegistry::NoEntries : m_files.back()->lastUse;
+    }
+
+    void EvictUsedUntil(CacheRegistry::Timestamp time) override
+    {
+        // files still shown in the viewer are kept alive by it
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_files.empty() && m_files.back()->lastUse <= time)
+            m_files.pop_back();
+    }
+
+    /// Returns loaded content of @a filename, loading it if necessary; nullptr on failure
+    std::shared_ptr<SourceFile> Load(const wxFileName& filename)
+    {
+        const wxString path = filename.GetFullPath();
+        const wxDateTime modified = filename.GetModificationTime();
+        const wxULongLong size = filename.GetSize();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto i = m_files.begin(); i != m_files.end(); ++i)
+            {
+                if ((*i)->path != path)
+                    continue;
+                if ((*i)->modified == modified && (*i)->size == size)
+                {
+                    auto found = *i;
+                    m_files.erase(i);
+                    m_files.push_front(found);
+                    found->lastUse = CacheRegistry::Now();
+                    return found;
+                }
+                m_files.erase(i);
+                break;
+            }
+        }
+
+        // load outside of the lock, this may take a while for huge files:
+        auto src = std::make_shared<SourceFile>();
+        src->path = path;
+        src->ext = filename.GetExt();
+        src->modified = modified;
+        src->size = size;
+        {
+            wxLogNull null;
+            if (!filename.IsFileReadable() || !src->file.Open(path))
+                return nullptr;
+        }
+        src->memory = sizeof(SourceFile);
+        for (size_t i = 0; i < src->file.GetLineCount(); i++)
+            src->memory += sizeof(wxString) + (src->file[i].length() + 1) * sizeof(wxChar);
+        src->lastUse = CacheRegistry::Now();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_files.push_front(src);
+            if (m_files.size() > MAX_CACHED_FILES)
+                m_files.pop_back();
+        }
+        CacheRegistry::NotifyGrown();
+        return src;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::list<std::shared_ptr<SourceFile>> m_files;
+};
+
+
 FileViewer *FileViewer::ms_instance = nullptr;
 
 FileViewer *FileViewer::GetAndActivate()
@@ -97,7 +232,8 @@ FileViewer *FileViewer::GetAndActivate()
 
 FileViewer::FileViewer(wxWindow*)
         // TRANSLATORS: Meaning occurrences of the string in source code
-        : wxFrame(nullptr, wxID_ANY, _("Code Occurrences"), wxDefaultPosition, wxDefaultSize, FRAME_STYLE)
+        : wxFrame(nullptr, wxID_ANY, _("Code Occurrences"), wxDefaultPosition, wxDefaultSize, FRAME_STYLE),
+          m_line(0), m_windowFrom(0), m_windowTo(0)
 {
     SetName("fileviewer");
 
@@ -166,6 +302,7 @@ FileViewer::FileViewer(wxWindow*)
 
     m_file->Bind(wxEVT_CHOICE, &FileViewer::OnChoice, this);
     m_openInEditor->Bind(wxEVT_BUTTON, &FileViewer::OnEditFile, this);
+    m_content->Bind(wxEVT_WEBVIEW_NAVIGATING, &FileViewer::OnNavigating, this);
 
 #ifdef __WXOSX__
     wxAcceleratorEntry entries[] = {
@@ -186,7 +323,7 @@ FileViewer::~FileViewer()
 }
 
 
-wxFileName FileViewer::GetFilename(wxString ref) const
+wxFileName FileViewer::GetFilename(const wxString& basePath_, wxString ref)
 {
     if ( ref.length() >= 3 &&
          ref[1] == _T(':') &&
@@ -206,7 +343,7 @@ wxFileName FileViewer::GetFilename(wxString ref) const
     if ( filename.IsRelative() )
     {
         wxFileName relative(filename);
-        wxString basePath(m_basePath);
+        wxString basePath(basePath_);
 
         // Sometimes, the path in source reference is not relative to the PO
         // file's location, but is relative to e.g. the root directory. See
@@ -241,7 +378,8 @@ wxFileName FileViewer::GetFilename(wxString ref) const
 }
 
 
-void FileViewer::ShowReferences(CatalogPtr catalog, CatalogItemPtr item, int defaultReference)
+void FileViewer::ShowReferences(CatalogPtr catalog, CatalogItemPtr item, int defaultReference,
+                                const std::vector<CatalogItemPtr>& upcomingItems)
 {
     m_basePath = catalog->GetSourcesBasePath();
     if (m_basePath.empty())
@@ -275,11 +413,41 @@ void FileViewer::ShowReferences(CatalogPtr catalog, CatalogItemPtr item, int def
 
         SelectReference(m_references[defaultReference]);
     }
+
+    PreloadReferences(upcomingItems);
+}
+
+void FileViewer::PreloadReferences(const std::vector<CatalogItemPtr>& items)
+{
+    std::vector<wxString> refs;
+    for (auto& i: items)
+    {
+        if (!i)
+            continue;
+        auto itemRefs = i->GetReferences();
+        if (!itemRefs.empty())
+            refs.push_back(itemRefs[0]);
+    }
+    if (refs.empty())
+        return;
+
+    auto basePath = m_basePath;
+    dispatch::async([basePath, refs]
+    {
+        for (auto& r: refs)
+        {
+            auto filename = GetFilename(basePath, r);
+            if (filename.IsOk())
+                SourceFilesCache::Get().Load(filename);
+        }
+    });
 }
 
 void FileViewer::SelectReference(const wxString& ref)
 {
-    const wxFileName filename = GetFilename(ref);
+    m_source.reset();
+
+    const wxFileName filename = GetFilename(m_basePath, ref);
     if (!filename.IsOk())
     {
         ShowError(SVG_ICON, _("Source code not found"),
@@ -290,15 +458,11 @@ void FileViewer::SelectReference(const wxString& ref)
         return;
     }
 
-    const wxString fullpath = filename.GetFullPath();
-
-    wxTextFile file;
-    wxString data;
-
-    if ( !filename.IsFileReadable() || !file.Open(fullpath) )
+    auto source = SourceFilesCache::Get().Load(filename);
+    if (!source)
     {
         ShowError(SVG_ICON, _("File cannot be opened"),
-                  wxString::Format(_(L"Poedit was unable to open the “%s” file."), fullpath));
+                  wxString::Format(_(L"Poedit was unable to open the “%s” file."), filename.GetFullPath()));
         m_openInEditor->Disable();
         return;
     }
@@ -313,8 +477,32 @@ void FileViewer::SelectReference(const wxString& ref)
     if (!linenumStr.ToLong(&linenum))
         linenum = 0;
 
-    auto markup = FileToHTMLMarkup(file, filename.GetExt(), (size_t)linenum);
-    ShowHTMLContent(markup);
+    const size_t count = source->file.GetLineCount();
+    const size_t line = (linenum > 0 && (size_t)linenum <= count) ? (size_t)linenum : 0;
+
+    m_source = source;
+    m_line = line;
+    m_windowFrom = (line > CONTEXT_LINES) ? line - 1 - CONTEXT_LINES : 0;
+    m_windowTo = std::min(count, (line ? line : 1) + CONTEXT_LINES);
+    ShowSourceWindow();
+}
+
+
+void FileViewer::ShowSourceWindow()
+{
+    auto& rendered = m_source->rendered;
+    auto key = std::make_tuple(m_line, m_windowFrom, m_windowTo);
+
+    auto i = rendered.find(key);
+    if (i == rendered.end())
+    {
+        if (rendered.size() >= MAX_CACHED_WINDOWS)
+            rendered.clear();
+        auto markup = FileToHTMLMarkup(m_source->file, m_source->ext, m_line, m_windowFrom, m_windowTo);
+        i = rendered.emplace(key, markup).first;
+    }
+
+    ShowHTMLContent(i->second);
 }
 
 
@@ -400,11 +588,30 @@ void FileViewer::OnChoice(wxCommandEvent &event)
 
 void FileViewer::OnEditFile(wxCommandEvent&)
 {
-    wxFileName filename = GetFilename(bidi::strip_control_chars(m_file->GetStringSelection()));
+    wxFileName filename = GetFilename(m_basePath, bidi::strip_control_chars(m_file->GetStringSelection()));
     if (filename.IsOk())
         wxLaunchDefaultApplication(filename.GetFullPath());
 }
 
+void FileViewer::OnNavigating(wxWebViewEvent &event)
+{
+    const wxString url = event.GetURL();
+    const bool above = (url == EXPAND_ABOVE_URL);
+    if (!above && url != EXPAND_BELOW_URL)
+        return; // let the content itself load
+
+    event.Veto();
+    if (!m_source)
+        return;
+
+    if (above)
+        m_windowFrom = (m_windowFrom > EXPAND_LINES) ? m_windowFrom - EXPAND_LINES : 0;
+    else
+        m_windowTo = std::min(m_source->file.GetLineCount(), m_windowTo + EXPAND_LINES);
+
+    ShowSourceWindow();
+}
+
 
 namespace
 {
@@ -426,12 +633,28 @@ inline void OutputBlock(wxString& html, const wxTextFile& file, size_t lfrom, si
 {
     for (size_t i = lfrom; i < lto; i++)
     {
-        html += EscapeMarkup(file[i]);
+        auto& line = file[i];
+        if (line.length() > MAX_LINE_LENGTH)
+        {
+            html += EscapeMarkup(line.substr(0, MAX_LINE_LENGTH));
+            html += L"…";
+        }
+        else
+        {
+            html += EscapeMarkup(line);
+        }
         html += '\n';
     }
 }
 
-wxString FileToHTMLMarkup(const wxTextFile& file, const wxString& ext, size_t lineno)
+inline void OutputExpandLink(wxString& html, const char *url, size_t lines)
+{
+    html += wxString::Format("<p class=\"expand\"><a href=\"%s\">%s</a></p>",
+                             url,
+                             EscapeMarkup(wxString::Format(wxPLURAL("Show %d more line", "Show %d more lines", (int)lines), (int)lines)));
+}
+
+wxString FileToHTMLMarkup(const wxTextFile& file, const wxString& ext, size_t lineno, size_t from, size_t to)
 {
     wxString html = wxString::Format(
         R"(<!DOCTYPE html>
@@ -445,31 +668,39 @@ wxString FileToHTMLMarkup(const wxTextFile& file, const wxString& ext, size_t li
         )",
         HTML_POEDIT_CSS);
 
-    html += wxString::Format("<pre class=\"line-numbers\">"
+    const size_t count = file.GetLineCount();
+    to = std::min(to, count);
+    from = std::min(from, to);
+
+    if (from > 0)
+        OutputExpandLink(html, EXPAND_ABOVE_URL, std::min(from, EXPAND_LINES));
+
+    // line numbers are counted from the start of the window:
+    html += wxString::Format("<pre class=\"line-numbers\" style=\"counter-reset: linenumber %d\">"
                                  "<code>"
                                      "<code class=\"language-%s\">",
+                             (int)from,
                              FilenameToLanguage(ext.Lower().utf8_string()));
 
-    const size_t count = file.GetLineCount();
-    if (lineno && lineno <= count)
+    if (lineno > from && lineno <= to)
     {
-        OutputBlock(html, file, 0, lineno-1);
+        OutputBlock(html, file, from, lineno-1);
         html += "<mark>";
         OutputBlock(html, file, lineno-1, lineno);
         html += "</mark>";
-        OutputBlock(html, file, lineno, count);
+        OutputBlock(html, file, lineno, to);
     }
     else
     {
-        OutputBlock(html, file, 0, count);
+        OutputBlock(html, file, from, to);
     }
 
     // add line numbers:
     html += "</code>"
             "<span aria-hidden=\"true\" class=\"line-numbers-rows\">";
-    for (size_t i = 0; i < count; i++)
+    for (size_t i = from; i < to; i++)
     {
-        if (i == lineno-1)
+        if (i + 1 == lineno)
             html += "<span id=\"mark\"><span id=\"msie_anchor\"></span></span>";
         else
             html += "<span></span>";
@@ -477,6 +708,9 @@ wxString FileToHTMLMarkup(const wxTextFile& file, const wxString& ext, size_t li
 
     html += "</span></code></pre>";
 
+    if (to < count)
+        OutputExpandLink(html, EXPAND_BELOW_URL, std::min(count - to, EXPAND_LINES));
+
     if (lineno)
     {
         // Alternative implementation that doesn't need msie_anchor, but doesn't work on MSIE, is to do:
@@ -786,6 +1020,14 @@ mark {
     }
 }
 
+/* Links for showing more of the file: */
+
+p.expand {
+    margin: 0.5em 0;
+    text-align: center;
+    font-size: 90%;
+}
+
 #msie_anchor {
     display: block;
     visibility: hidden;
@@ -31,17 +31,24 @@
 #include <wx/frame.h>
 
 #include <memory>
+#include <vector>
 
 class WXDLLIMPEXP_FWD_CORE wxButton;
 class WXDLLIMPEXP_FWD_CORE wxChoice;
 class WXDLLIMPEXP_FWD_CORE wxStaticText;
 class WXDLLIMPEXP_FWD_CORE wxFileName;
 class WXDLLIMPEXP_FWD_CORE wxWebView;
+class WXDLLIMPEXP_FWD_CORE wxWebViewEvent;
 class WXDLLIMPEXP_FWD_CORE wxSizer;
 
 
 /** This class implements frame that shows part of file
-    surrounding specified line (40 lines in both directions).
+    surrounding specified line.
+
+    Only a window of lines around the referenced line is rendered, so that
+    huge (typically generated) source files don't take long to show; the user
+    can expand it on demand. Loaded files are cached for as long as they don't
+    change on disk.
  */
 class FileViewer : public wxFrame
 {
@@ -53,13 +60,28 @@ public:
     static FileViewer *GetAndActivate();
     static FileViewer *GetIfExists() { return ms_instance; }
 
-    /// Shows given reference, i.e. loads the file
-    void ShowReferences(CatalogPtr catalog, CatalogItemPtr item, int defaultReference = 0);
+    /// How many of the following items' references to preload
+    static const int PRELOAD_ITEMS_COUNT = 5;
+
+    /**
+        Shows given reference, i.e. loads the file.
+
+        Files referenced by @a upcomingItems (typically the ones after @a item
+        in the list) are loaded in the background, so that showing them later
+        is fast.
+     */
+    void ShowReferences(CatalogPtr catalog, CatalogItemPtr item, int defaultReference = 0,
+                        const std::vector<CatalogItemPtr>& upcomingItems = {});
 
 private:
-    wxFileName GetFilename(wxString ref) const;
+    struct SourceFile;
+    class SourceFilesCache;
+
+    static wxFileName GetFilename(const wxString& basePath, wxString ref);
 
     void SelectReference(const wxString& ref);
+    void PreloadReferences(const std::vector<CatalogItemPtr>& items);
+    void ShowSourceWindow();
     void ShowHTMLContent(const wxString& markup);
     void ShowError(const char *icon, const wxString& msg, const wxString& description = "", const wxString& references = "");
 
@@ -67,6 +89,11 @@ private:
     wxString m_basePath;
     wxArrayString m_references;
 
+    // currently shown file and the range of its lines [from, to) rendered:
+    std::shared_ptr<SourceFile> m_source;
+    size_t m_line;
+    size_t m_windowFrom, m_windowTo;
+
     wxChoice *m_file;
     wxStaticText *m_description;
     wxButton *m_openInEditor;
@@ -75,6 +102,7 @@ private:
 
     void OnChoice(wxCommandEvent &event);
     void OnEditFile(wxCommandEvent &event);
+    void OnNavigating(wxWebViewEvent &event);
 
     static FileViewer *ms_instance;
 
@@ -29,10 +29,13 @@
 #include <wx/collpane.h>
 #include <wx/config.h>
 #include <wx/button.h>
+#include <wx/dataview.h>
 #include <wx/sizer.h>
 #include <wx/stattext.h>
 #include <wx/textctrl.h>
 #include <wx/checkbox.h>
+#include <wx/log.h>
+#include <wx/wupdlock.h>
 
 #ifdef __WXOSX__
 #include <AppKit/AppKit.h>
@@ -43,12 +46,14 @@
 #include <gdk/gdkkeysyms.h>
 #endif
 
-#include <regex>
+#include <algorithm>
+#include <iterator>
 
 #include "catalog.h"
 #include "text_control.h"
 #include "edframe.h"
 #include "editing_area.h"
+#include "errors.h"
 #include "edlistctrl.h"
 #include "findframe.h"
 #include "hidpi.h"
@@ -68,12 +73,66 @@ enum
     Mode_Replace
 };
 
+// Fields reported by "Find all", in the order of FindFrame::m_findAllCounts
+enum FoundField
+{
+    FoundField_Source      = 1 << 0,
+    FoundField_Translation = 1 << 1,
+    FoundField_Comments    = 1 << 2,
+    FoundField_Context     = 1 << 3
+};
+
+const int FOUND_FIELDS_COUNT = 4;
+
+// Number of items matched by a single "Find all" task
+const size_t FIND_ALL_CHUNK_SIZE = 256;
+
+// Number of items processed by a single Replace All task
+const size_t REPLACE_ALL_CHUNK_SIZE = 256;
+
 const int FRAME_STYLE = (wxDEFAULT_FRAME_STYLE | wxFRAME_TOOL_WINDOW | wxTAB_TRAVERSAL | wxFRAME_FLOAT_ON_PARENT)
                         & ~(wxRESIZE_BORDER | wxMAXIMIZE_BOX);
 
 } // anonymous namespace
 
 
+/**
+    Replacements done by Replace All.
+
+    All replacements are computed first, in parallel, and then applied to the
+    catalog in one go, so that the UI only needs to be updated once. The
+    operation can be reverted as a whole as long as none of the affected items
+    was modified since.
+ */
+class ReplaceAllTransaction
+{
+public:
+    ReplaceAllTransaction(const Catalog& catalog,
+                          const wxString& search, const wxString& replacement, bool wholeWords);
+
+    bool IsEmpty() const { return m_changes.empty(); }
+
+    /// Does the operation change this item?
+    bool Affects(const CatalogItemPtr& item) const;
+
+    void Apply();
+
+    bool CanRevert() const;
+    void Revert();
+
+private:
+    struct Change
+    {
+        CatalogItemPtr item;
+        wxArrayString oldTranslations, newTranslations;
+        bool wasModified = false;
+        unsigned revision = 0; // item's revision after Apply()
+    };
+
+    std::vector<Change> m_changes;
+};
+
+
 wxString FindFrame::ms_text;
 
 FindFrame::FindFrame(PoeditFrame *owner,
@@ -85,7 +144,8 @@ FindFrame::FindFrame(PoeditFrame *owner,
           m_listCtrl(list),
           m_editingArea(editingArea),
           m_catalog(c),
-          m_position(-1)
+          m_position(-1),
+          m_findAllCounts{}
 {
     auto panel = new wxPanel(this, wxID_ANY);
     wxBoxSizer *panelsizer = new wxBoxSizer(wxVERTICAL);
@@ -122,6 +182,9 @@ FindFrame::FindFrame(PoeditFrame *owner,
     m_ignoreCase = new wxCheckBox(collPane, wxID_ANY, _("Ignore case"));
     m_wrapAround = new wxCheckBox(collPane, wxID_ANY, _("Wrap around"));
     m_wholeWords = new wxCheckBox(collPane, wxID_ANY, _("Whole words only"));
+    m_useRegex = new wxCheckBox(collPane, wxID_ANY, _("Regular expressions"));
+    // TRANSLATORS: Find option for finding also texts with small differences (typos etc.)
+    m_approximate = new wxCheckBox(collPane, wxID_ANY, _("Approximate matches"));
     m_findInOrig = new wxCheckBox(collPane, wxID_ANY, _("Find in source texts"));
     m_findInTrans = new wxCheckBox(collPane, wxID_ANY, _("Find in translations"));
     m_findInComments = new wxCheckBox(collPane, wxID_ANY, _("Find in comments"));
@@ -134,9 +197,11 @@ FindFrame::FindFrame(PoeditFrame *owner,
     optionsL->Add(m_ignoreCase, wxSizerFlags().Expand());
     optionsL->Add(m_wrapAround, wxSizerFlags().Expand().Border(wxTOP, PX(2)));
     optionsL->Add(m_wholeWords, wxSizerFlags().Expand().Border(wxTOP, PX(2)));
+    optionsL->Add(m_useRegex, wxSizerFlags().Expand().Border(wxTOP, PX(2)));
     optionsR->Add(m_findInOrig, wxSizerFlags().Expand().Border(wxTOP, PX(2)));
     optionsR->Add(m_findInTrans, wxSizerFlags().Expand().Border(wxTOP, PX(2)));
     optionsR->Add(m_findInComments, wxSizerFlags().Expand().Border(wxTOP, PX(2)));
+    optionsR->Add(m_approximate, wxSizerFlags().Expand().Border(wxTOP, PX(2)));
 
 #ifdef __WXMSW__
     sizer->Add(options, wxSizerFlags().Expand().PXBorderAll());
@@ -146,6 +211,9 @@ FindFrame::FindFrame(PoeditFrame *owner,
 #endif
 
     m_btnClose = new wxButton(panel, wxID_CLOSE, _("Close"));
+    m_btnFindAll = new wxButton(panel, wxID_ANY, MSW_OR_OTHER(_("Find &all"), _("Find &All")));
+    // TRANSLATORS: Button in Find window that reverts the last "Replace All" operation
+    m_btnUndoReplaceAll = new wxButton(panel, wxID_ANY, _("&Undo"));
     m_btnReplaceAll = new wxButton(panel, wxID_ANY, MSW_OR_OTHER(_("Replace &all"), _("Replace &All")));
     m_btnReplace = new wxButton(panel, wxID_ANY, _("&Replace"));
     m_btnPrev = new wxButton(panel, wxID_ANY, _("< &Previous"));
@@ -156,11 +224,25 @@ FindFrame::FindFrame(PoeditFrame *owner,
     sizer->Add(buttons, wxSizerFlags().Expand().PXBorderAll());
     buttons->Add(m_btnClose, wxSizerFlags().PXBorder(wxRIGHT));
     buttons->AddStretchSpacer();
+    buttons->Add(m_btnFindAll, wxSizerFlags().PXBorder(wxRIGHT));
+    buttons->Add(m_btnUndoReplaceAll, wxSizerFlags().PXBorder(wxRIGHT));
     buttons->Add(m_btnReplaceAll, wxSizerFlags().PXBorder(wxRIGHT));
     buttons->Add(m_btnReplace, wxSizerFlags().PXBorder(wxRIGHT));
     buttons->Add(m_btnPrev, wxSizerFlags().PXBorder(wxRIGHT));
     buttons->Add(m_btnNext, wxSizerFlags());
 
+    m_findAllSummary = new wxStaticText(panel, wxID_ANY, "");
+    m_findAllResults = new wxDataViewListCtrl(panel, wxID_ANY, wxDefaultPosition, wxSize(-1, PX(200)),
+                                              wxDV_SINGLE | wxDV_ROW_LINES);
+    m_findAllResults->AppendTextColumn(_("Source text"), wxDATAVIEW_CELL_INERT, PX(200));
+    m_findAllResults->AppendTextColumn(_("Translation"), wxDATAVIEW_CELL_INERT, PX(200));
+    // TRANSLATORS: Column header in "Find all" results, lists parts of the entry (source, translation, comments) that matched
+    m_findAllResults->AppendTextColumn(_("Found in"), wxDATAVIEW_CELL_INERT, wxCOL_WIDTH_AUTOSIZE);
+    sizer->Add(m_findAllSummary, wxSizerFlags().Expand().PXBorderAll());
+    sizer->Add(m_findAllResults, wxSizerFlags(1).Expand().PXBorderAll());
+    sizer->Hide(m_findAllSummary);
+    sizer->Hide(m_findAllResults);
+
     panel->SetSizer(panelsizer);
     auto topsizer = new wxBoxSizer(wxHORIZONTAL);
     topsizer->Add(panel, wxSizerFlags(1).Expand());
@@ -182,6 +264,8 @@ FindFrame::FindFrame(PoeditFrame *owner,
     m_ignoreCase->SetValue(!wxConfig::Get()->ReadBool("find_case_sensitive", false));
     m_wrapAround->SetValue(wxConfig::Get()->ReadBool("find_wrap_around", true));
     m_wholeWords->SetValue(wxConfig::Get()->ReadBool("whole_words", false));
+    m_useRegex->SetValue(wxConfig::Get()->ReadBool("find_regex", false));
+    m_approximate->SetValue(!m_useRegex->GetValue() && wxConfig::Get()->ReadBool("find_approximate", false));
 
     wxAcceleratorEntry entries[] = {
 #ifndef __WXGTK__
@@ -225,8 +309,14 @@ FindFrame::FindFrame(PoeditFrame *owner,
     OnModeChanged();
     m_mode->Bind(wxEVT_CHOICE, [=](wxCommandEvent&){ OnModeChanged(); });
 
+    m_btnFindAll->Bind(wxEVT_BUTTON, &FindFrame::OnFindAll, this);
+    m_btnFindAll->Bind(wxEVT_UPDATE_UI, [=](wxUpdateUIEvent& e){ e.Enable(!ms_text.empty()); });
+    m_findAllResults->Bind(wxEVT_DATAVIEW_SELECTION_CHANGED, [=](wxDataViewEvent&){ OnFindAllSelected(); });
+
     m_btnReplace->Bind(wxEVT_BUTTON, &FindFrame::OnReplace, this);
     m_btnReplaceAll->Bind(wxEVT_BUTTON, &FindFrame::OnReplaceAll, this);
+    m_btnUndoReplaceAll->Bind(wxEVT_BUTTON, &FindFrame::OnUndoReplaceAll, this);
+    m_btnUndoReplaceAll->Bind(wxEVT_UPDATE_UI, [=](wxUpdateUIEvent& e){ e.Enable(m_lastReplaceAll && m_lastReplaceAll->CanRevert()); });
     m_btnReplace->Bind(wxEVT_UPDATE_UI, [=](wxUpdateUIEvent& e){ e.Enable((bool)m_lastItem); });
     m_btnReplaceAll->Bind(wxEVT_UPDATE_UI, [=](wxUpdateUIEvent& e){ e.Enable(!ms_text.empty()); });
 
@@ -242,16 +332,35 @@ FindFrame::FindFrame(PoeditFrame *owner,
 
 FindFrame::~FindFrame()
 {
+    CancelFindAll();
     SaveWindowState(this, WinState_Pos);
 }
 
 
 void FindFrame::Reset(const CatalogPtr& c)
 {
+    CancelFindAll();
+
+    if (c != m_catalog)
+        m_lastReplaceAll.reset();
+
     m_catalog = c;
+    m_index.reset(c ? new CatalogSearchIndex(c) : nullptr);
     m_position = -1;
     m_lastItem.reset();
 
+    // previous results refer to another catalog or search options
+    m_findAllMatches.clear();
+    m_findAllResults->DeleteAllItems();
+    auto sizer = m_findAllResults->GetContainingSizer();
+    if (sizer->IsShown(m_findAllResults))
+    {
+        sizer->Hide(m_findAllSummary);
+        sizer->Hide(m_findAllResults);
+        Layout();
+        GetSizer()->SetSizeHints(this);
+    }
+
     UpdateButtons();
 }
 
@@ -306,6 +415,8 @@ void FindFrame::OnModeChanged()
     }
     SetTitle(title);
 
+    m_btnFindAll->Show(!isReplace);
+    m_btnUndoReplaceAll->Show(isReplace);
     m_btnReplace->Show(isReplace);
     m_btnReplaceAll->Show(isReplace);
     m_replaceField->GetContainingSizer()->Show(m_replaceField, isReplace);
@@ -314,6 +425,8 @@ void FindFrame::OnModeChanged()
     m_findInTrans->Enable(!isReplace);
     m_findInComments->Enable(!isReplace);
     m_ignoreCase->Enable(!isReplace);
+    m_useRegex->Enable(!isReplace);
+    m_approximate->Enable(!isReplace);
 
     Layout();
     GetSizer()->SetSizeHints(this);
@@ -328,8 +441,14 @@ void FindFrame::OnTextChange(wxCommandEvent& e)
 }
 
 
-void FindFrame::OnCheckbox(wxCommandEvent&)
+void FindFrame::OnCheckbox(wxCommandEvent& e)
 {
+    // the two search modes are mutually exclusive:
+    if (e.GetEventObject() == m_useRegex && m_useRegex->GetValue())
+        m_approximate->SetValue(false);
+    else if (e.GetEventObject() == m_approximate && m_approximate->GetValue())
+        m_useRegex->SetValue(false);
+
     Reset(m_catalog);
     wxConfig::Get()->Write("find_in_orig", m_findInOrig->GetValue());
     wxConfig::Get()->Write("find_in_trans", m_findInTrans->GetValue());
@@ -337,6 +456,8 @@ void FindFrame::OnCheckbox(wxCommandEvent&)
     wxConfig::Get()->Write("find_case_sensitive", !m_ignoreCase->GetValue());
     wxConfig::Get()->Write("find_wrap_around", m_wrapAround->GetValue());
     wxConfig::Get()->Write("whole_words", m_wholeWords->GetValue());
+    wxConfig::Get()->Write("find_regex", m_useRegex->GetValue());
+    wxConfig::Get()->Write("find_approximate", m_approximate->GetValue());
 }
 
 
@@ -371,6 +492,16 @@ void FindFrame::FindNext()
 namespace
 {
 
+template<typename S>
+bool IsWholeWordAt(const S& str, size_t index, size_t len)
+{
+    if (index > 0 && !SEPARATORS.Contains(str[index-1]))
+        return false;
+    if (index+len < str.Length() && !SEPARATORS.Contains(str[index+len]))
+        return false;
+    return true;
+}
+
 template<typename S, typename F>
 bool FindTextInStringAndDo(S& str, const wxString& text, bool wholeWords, F&& handler)
 {
@@ -384,19 +515,10 @@ bool FindTextInStringAndDo(S& str, const wxString& text, bool wholeWords, F&& ha
         if (index == wxString::npos)
             break;
 
-        if (wholeWords)
+        if (wholeWords && !IsWholeWordAt(str, index, textLen))
         {
-            bool result = true;
-            if (index >0)
-                result = result && SEPARATORS.Contains(str[index-1]);
-            if (index+textLen < str.Length())
-                result = result && SEPARATORS.Contains(str[index+textLen]);
-
-            if (!result)
-            {
-                start = index + textLen;
-                continue;
-            }
+            start = index + textLen;
+            continue;
         }
 
         found = true;
@@ -406,38 +528,80 @@ bool FindTextInStringAndDo(S& str, const wxString& text, bool wholeWords, F&& ha
     return found;
 }
 
-bool IsTextInString(wxString str, const wxString& text,
-                    bool ignoreCase, bool wholeWords, bool ignoreAmp, bool ignoreUnderscore)
+template<typename F>
+bool FindPatternInStringAndDo(const wxString& str, const SearchPattern& pattern, bool wholeWords, F&& handler)
 {
-    if (str.empty())
-        return false;
+    bool found = false;
+    size_t start = 0;
+    while (start != wxString::npos)
+    {
+        auto match = pattern.Find(str, start);
+        if (!match)
+            break;
 
-    if (ignoreCase)
-        str = unicode::fold_case(str);
+        if (wholeWords && !IsWholeWordAt(str, match.pos, match.length))
+        {
+            // unlike with plain text, a shorter or longer match may start at the next character
+            start = match.pos + 1;
+            continue;
+        }
 
-    if (ignoreAmp && str.find(_T('&')) != wxString::npos)
-    {
-        static std::wregex re(L"&(\\w)");
-        str = std::regex_replace(str::to_wstring(str), re, L"$1");
+        found = true;
+        start = handler(str, match.pos, match.length);
     }
 
-    if (ignoreUnderscore && str.find(_T('_')) != wxString::npos)
+    return found;
+}
+
+// Adapter for searching in ASCII text with FindTextInStringAndDo() without
+// making a case-folded copy of it. Searched for text must be folded ASCII.
+class AsciiCaseInsensitiveString
+{
+public:
+    // uses wx_str() of ASCII strings directly, even if they are stored as UTF-8
+    explicit AsciiCaseInsensitiveString(const wxString& str) : m_data(str.wx_str()), m_length(str.length()) {}
+
+    size_t find(const wxString& text, size_t start) const
     {
-        static std::wregex re(L"_(\\w)");
-        str = std::regex_replace(str::to_wstring(str), re, L"$1");
+        return unicode::ascii_find_nocase(m_data, m_length, text.wx_str(), text.length(), start);
     }
 
-    return FindTextInStringAndDo(str, text, wholeWords,
-                                 [=](const wxString&,size_t,size_t){ return wxString::npos;/*just 1 hit*/ });
+    wxUniChar operator[](size_t i) const { return wxUniChar((wchar_t)m_data[i]); }
+    size_t Length() const { return m_length; }
+
+private:
+    const wxStringCharType *m_data;
+    size_t m_length;
+};
+
+// What is searched for, in the form used for matching against CatalogSearchIndex
+struct SearchQuery
+{
+    wxString text; // case-folded if ignoring case
+    std::shared_ptr<const SearchPattern> pattern; // null when searching for plain text
+    bool wholeWords = false;
+    bool inTrans = false, inSource = false, inComments = false;
+};
+
+// Note: @a str must be already normalized by CatalogSearchIndex
+bool IsTextInString(const wxString& str, const SearchQuery& q)
+{
+    if (str.empty())
+        return false;
+
+    auto justOneHit = [=](const wxString&,size_t,size_t){ return wxString::npos; };
+    if (q.pattern)
+        return FindPatternInStringAndDo(str, *q.pattern, q.wholeWords, justOneHit);
+    else
+        return FindTextInStringAndDo(str, q.text, q.wholeWords, justOneHit);
 }
 
-size_t IsTextInStrings(const wxArrayString& strs, const wxString& text,
-                     bool ignoreCase, bool wholeWords, bool ignoreAmp, bool ignoreUnderscore)
+size_t IsTextInStrings(const std::vector<wxString>& strs, const SearchQuery& q)
 {
     // loop through all strings and search for the substring in them
-    for (size_t i = 0; i < strs.GetCount(); i++)
+    for (size_t i = 0; i < strs.size(); i++)
     {
-        if (IsTextInString(strs[i], text, ignoreCase, wholeWords, ignoreAmp, ignoreUnderscore))
+        if (IsTextInString(strs[i], q))
             return i;
     }
 
@@ -464,8 +628,166 @@ enum FoundState
     Found_InExtractedComments
 };
 
+// Returns combination of FoundField values for fields of @a e that match
+int MatchFields(const CatalogSearchIndex::Entry& e, const SearchQuery& q)
+{
+    int fields = 0;
+    if (q.inSource)
+    {
+        if (IsTextInString(e.string, q) || IsTextInString(e.pluralString, q))
+            fields |= FoundField_Source;
+        if (IsTextInString(e.context, q) || IsTextInString(e.symbolicId, q))
+            fields |= FoundField_Context;
+    }
+    if (q.inTrans)
+    {
+        if (IsTextInStrings(e.translations, q) != (size_t)-1)
+            fields |= FoundField_Translation;
+    }
+    if (q.inComments)
+    {
+        if (IsTextInString(e.comment, q) || IsTextInStrings(e.extractedComments, q) != (size_t)-1)
+            fields |= FoundField_Comments;
+    }
+    return fields;
+}
+
+wxString FoundFieldsDescription(int fields)
+{
+    wxString desc;
+    auto add = [&desc](const wxString& s)
+    {
+        if (!desc.empty())
+            desc += ", ";
+        desc += s;
+    };
+    if (fields & FoundField_Source)
+        add(_("source"));
+    if (fields & FoundField_Translation)
+        add(_("translation"));
+    if (fields & FoundField_Comments)
+        add(_("comments"));
+    if (fields & FoundField_Context)
+        add(_("context"));
+    return desc;
+}
+
 } // anonymous space
 
+
+ReplaceAllTransaction::ReplaceAllTransaction(const Catalog& catalog,
+                                             const wxString& search, const wxString& replacement, bool wholeWords)
+{
+    // Items are only modified on the main thread, which waits for (and
+    // participates in) the work here, so they can be safely read from
+    // the worker threads:
+    auto& items = catalog.items();
+    const size_t count = items.size();
+    const size_t chunks = (count + REPLACE_ALL_CHUNK_SIZE - 1) / REPLACE_ALL_CHUNK_SIZE;
+
+    std::vector<std::vector<Change>> results(chunks);
+    dispatch::parallel_for(chunks, [&](size_t n)
+    {
+        const size_t end = std::min((n + 1) * REPLACE_ALL_CHUNK_SIZE, count);
+        for (size_t i = n * REPLACE_ALL_CHUNK_SIZE; i < end; i++)
+        {
+            auto& item = items[i];
+            auto translations = item->GetTranslations();
+
+            bool replaced = false;
+            for (auto& t: translations)
+            {
+                if (ReplaceTextInString(t, search, wholeWords, replacement))
+                    replaced = true;
+            }
+
+            if (replaced)
+            {
+                Change c;
+                c.item = item;
+                c.oldTranslations = item->GetTranslations();
+                c.newTranslations = std::move(translations);
+                results[n].push_back(std::move(c));
+            }
+        }
+    });
+
+    for (auto& r: results)
+        std::move(r.begin(), r.end(), std::back_inserter(m_changes));
+}
+
+
+bool ReplaceAllTransaction::Affects(const CatalogItemPtr& item) const
+{
+    return std::any_of(m_changes.begin(), m_changes.end(),
+                       [&item](const Change& c){ return c.item == item; });
+}
+
+
+void ReplaceAllTransaction::Apply()
+{
+    for (auto& c: m_changes)
+    {
+        c.wasModified = c.item->IsModified();
+        c.item->SetTranslations(c.newTranslations);
+        c.item->SetModified(true);
+        c.revision = c.item->GetRevision();
+    }
+}
+
+
+bool ReplaceAllTransaction::CanRevert() const
+{
+    return !m_changes.empty() &&
+           std::all_of(m_changes.begin(), m_changes.end(),
+                       [](const Change& c){ return c.item->GetRevision() == c.revision; });
+}
+
+
+void ReplaceAllTransaction::Revert()
+{
+    wxASSERT( CanRevert() );
+
+    for (auto& c: m_changes)
+    {
+        c.item->SetTranslations(c.oldTranslations);
+        c.item->SetModified(c.wasModified);
+    }
+}
+
+
+bool FindFrame::PreparePattern(bool ignoreCase)
+{
+    // regular expressions and approximate matching are only used for finding, not replacing:
+    const bool find = m_mode->GetSelection() == Mode_Find;
+    const bool regex = find && m_useRegex->GetValue();
+    const bool approximate = find && m_approximate->GetValue();
+    if (!regex && !approximate)
+    {
+        m_pattern.reset();
+        return true;
+    }
+
+    const auto syntax = regex ? SearchPattern::Syntax::RegularExpression : SearchPattern::Syntax::Approximate;
+    if (m_pattern &&
+        m_pattern->GetSyntax() == syntax && m_pattern->GetPattern() == ms_text && m_pattern->IgnoresCase() == ignoreCase)
+    {
+        return true; // already compiled
+    }
+
+    try
+    {
+        m_pattern = std::make_shared<SearchPattern>(syntax, ms_text, ignoreCase);
+        return true;
+    }
+    catch (const Exception& e)
+    {
+        m_pattern.reset();
+        wxLogError("%s", e.What());
+        return false;
+    }
+}
+
 bool FindFrame::DoFind(int dir)
 {
     wxASSERT( dir == +1 || dir == -1 );
@@ -495,6 +817,20 @@ bool FindFrame::DoFind(int dir)
     const bool ignoreAmp = (mode == Mode_Find) && (text.Find(_T('&')) == wxNOT_FOUND);
     const bool ignoreUnderscore = (mode == Mode_Find) && (text.Find(_T('_')) == wxNOT_FOUND);
 
+    CatalogSearchIndex::Options searchOptions;
+    searchOptions.ignoreCase = ignoreCase;
+    searchOptions.ignoreAmp = ignoreAmp;
+    searchOptions.ignoreUnderscore = ignoreUnderscore;
+    m_index->Prepare(searchOptions);
+
+    if (!PreparePattern(ignoreCase))
+        return false;
+
+    SearchQuery query;
+    query.text = text;
+    query.pattern = m_pattern;
+    query.wholeWords = wholeWords;
+
     const int posOrig = std::max(0, std::min(m_position, cnt-1));
     m_position = posOrig + dir;
 
@@ -515,11 +851,13 @@ bool FindFrame::DoFind(int dir)
                 break;
         }
 
-        auto dt = lastItem = (*m_catalog)[m_listCtrl->ListIndexToCatalog(m_position)];
+        const int catalogIndex = m_listCtrl->ListIndexToCatalog(m_position);
+        lastItem = (*m_catalog)[catalogIndex];
+        auto& dt = m_index->Get(catalogIndex);
 
         if (inTrans)
         {
-            trans = IsTextInStrings(dt->GetTranslations(), text, ignoreCase, wholeWords, ignoreAmp, ignoreUnderscore);
+            trans = IsTextInStrings(dt.translations, query);
             if (trans != (size_t)-1)
             {
                 found = Found_InTrans;
@@ -528,22 +866,22 @@ bool FindFrame::DoFind(int dir)
         }
         if (inSource)
         {
-            if (IsTextInString(dt->GetString(), text, ignoreCase, wholeWords, ignoreAmp, ignoreUnderscore))
+            if (IsTextInString(dt.string, query))
             {
                 found = Found_InOrig;
                 break;
             }
-            if (dt->HasPlural() && IsTextInString(dt->GetPluralString(), text, ignoreCase, wholeWords, ignoreAmp, ignoreUnderscore))
+            if (IsTextInString(dt.pluralString, query))
             {
                 found = Found_InOrigPlural;
                 break;
             }
-            if (IsTextInString(dt->GetContext(), text, ignoreCase, wholeWords, ignoreAmp, ignoreUnderscore))
+            if (IsTextInString(dt.context, query))
             {
                 found = Found_InMetadata;
                 break;
             }
-            if (IsTextInString(dt->GetSymbolicId(), text, ignoreCase, wholeWords, ignoreAmp, ignoreUnderscore))
+            if (IsTextInString(dt.symbolicId, query))
             {
                 found = Found_InMetadata;
                 break;
@@ -551,12 +889,12 @@ bool FindFrame::DoFind(int dir)
         }
         if (inComments)
         {
-            if (IsTextInString(dt->GetComment(), text, ignoreCase, wholeWords, false, false))
+            if (IsTextInString(dt.comment, query))
             {
                 found = Found_InComments;
                 break;
             }
-            if (IsTextInStrings(dt->GetExtractedComments(), text, ignoreCase, wholeWords, false, false) != (size_t)-1)
+            if (IsTextInStrings(dt.extractedComments, query) != (size_t)-1)
             {
                 found = Found_InExtractedComments;
                 break;
@@ -602,17 +940,28 @@ bool FindFrame::DoFind(int dir)
 
         if (txt)
         {
-            auto textc = ignoreCase ? unicode::fold_case(txt->GetValue()) : txt->GetValue();
+            auto showIndicator = [=](auto&&, size_t pos, size_t len)
+            {
+                txt->ShowFindIndicator((int)pos, (int)len);
+                return wxString::npos;
+            };
 
-            FindTextInStringAndDo
-            (
-                textc, text, wholeWords,
-                [=](const wxString&,size_t pos, size_t len)
-                {
-                    txt->ShowFindIndicator((int)pos, (int)len);
-                    return wxString::npos;
-                }
-            );
+            const wxString value = txt->GetValue();
+            if (m_pattern)
+            {
+                auto textc = ignoreCase ? unicode::fold_case(value) : value;
+                FindPatternInStringAndDo(textc, *m_pattern, wholeWords, showIndicator);
+            }
+            else if (ignoreCase && unicode::is_ascii(value) && unicode::is_ascii(text))
+            {
+                AsciiCaseInsensitiveString textc(value);
+                FindTextInStringAndDo(textc, text, wholeWords, showIndicator);
+            }
+            else
+            {
+                auto textc = ignoreCase ? unicode::fold_case(value) : value;
+                FindTextInStringAndDo(textc, text, wholeWords, showIndicator);
+            }
         }
 
         return true;
@@ -622,6 +971,172 @@ bool FindFrame::DoFind(int dir)
     return false;
 }
 
+void FindFrame::OnFindAll(wxCommandEvent&)
+{
+    CancelFindAll();
+
+    if (!m_listCtrl || !m_catalog || ms_text.empty())
+        return;
+
+    const bool ignoreCase = m_ignoreCase->GetValue();
+
+    if (!PreparePattern(ignoreCase))
+        return;
+
+    SearchQuery query;
+    query.text = ignoreCase ? unicode::fold_case(ms_text) : ms_text;
+    query.pattern = m_pattern;
+    query.wholeWords = m_wholeWords->GetValue();
+    query.inTrans = m_findInTrans->GetValue() && (m_catalog->HasCapability(Catalog::Cap::Translations));
+    query.inSource = m_findInOrig->GetValue();
+    query.inComments = m_findInComments->GetValue();
+
+    // same mnemonics heuristics as in DoFind():
+    CatalogSearchIndex::Options searchOptions;
+    searchOptions.ignoreCase = ignoreCase;
+    searchOptions.ignoreAmp = query.text.Find(_T('&')) == wxNOT_FOUND;
+    searchOptions.ignoreUnderscore = query.text.Find(_T('_')) == wxNOT_FOUND;
+    m_index->Prepare(searchOptions);
+    auto snapshot = m_index->TakeSnapshot();
+
+    m_findAllMatches.clear();
+    m_findAllResults->DeleteAllItems();
+    std::fill(std::begin(m_findAllCounts), std::end(m_findAllCounts), 0);
+
+    auto sizer = m_findAllResults->GetContainingSizer();
+    if (!sizer->IsShown(m_findAllResults))
+    {
+        sizer->Show(m_findAllSummary);
+        sizer->Show(m_findAllResults);
+        Layout();
+        GetSizer()->SetSizeHints(this);
+    }
+    UpdateFindAllSummary(/*finished=*/false);
+
+    auto cancellation = std::make_shared<dispatch::cancellation_token>();
+    m_findAllCancellation = cancellation;
+
+    // Matches are delivered to the main thread one chunk at a time, so that
+    // the results show up while the rest of the catalog is still searched.
+    // Note that this is only ever accessed from on_main() callbacks after
+    // checking cancellation, which happens before the window is destroyed.
+    dispatch::async([=]
+    {
+        const size_t count = snapshot->size();
+        const size_t chunks = (count + FIND_ALL_CHUNK_SIZE - 1) / FIND_ALL_CHUNK_SIZE;
+        dispatch::parallel_for(chunks, [&](size_t n)
+        {
+            if (cancellation->is_cancelled())
+                return;
+
+            std::vector<FindAllMatch> matches;
+            const size_t end = std::min((n + 1) * FIND_ALL_CHUNK_SIZE, count);
+            for (size_t i = n * FIND_ALL_CHUNK_SIZE; i < end; i++)
+            {
+                auto& e = *(*snapshot)[i];
+                const int fields = MatchFields(e, query);
+                if (fields)
+                    matches.push_back({i, e.GetItem(), fields});
+            }
+
+            if (!matches.empty())
+            {
+                dispatch::on_main([=]
+                {
+                    if (!cancellation->is_cancelled())
+                        OnFindAllMatches(matches);
+                });
+            }
+        });
+    })
+    .then_on_main([=]
+    {
+        if (!cancellation->is_cancelled())
+            OnFindAllFinished();
+    });
+}
+
+void FindFrame::CancelFindAll()
+{
+    if (m_findAllCancellation)
+    {
+        m_findAllCancellation->cancel();
+        m_findAllCancellation.reset();
+    }
+}
+
+void FindFrame::OnFindAllMatches(const std::vector<FindAllMatch>& matches)
+{
+    wxWindowUpdateLocker lock(m_findAllResults);
+
+    // chunks complete in arbitrary order, keep the results in catalog order:
+    for (auto& m: matches)
+    {
+        auto pos = std::lower_bound(m_findAllMatches.begin(), m_findAllMatches.end(), m.index,
+                                    [](const FindAllMatch& a, size_t index){ return a.index < index; });
+        const unsigned row = unsigned(pos - m_findAllMatches.begin());
+        m_findAllMatches.insert(pos, m);
+
+        for (int f = 0; f < FOUND_FIELDS_COUNT; f++)
+        {
+            if (m.fields & (1 << f))
+                m_findAllCounts[f]++;
+        }
+
+        wxVector<wxVariant> values;
+        values.push_back(m.item->GetString().BeforeFirst('\n'));
+        values.push_back(m.item->GetTranslation().BeforeFirst('\n'));
+        values.push_back(FoundFieldsDescription(m.fields));
+        m_findAllResults->InsertItem(row, values);
+    }
+
+    UpdateFindAllSummary(/*finished=*/false);
+}
+
+void FindFrame::OnFindAllFinished()
+{
+    m_findAllCancellation.reset();
+    UpdateFindAllSummary(/*finished=*/true);
+}
+
+void FindFrame::UpdateFindAllSummary(bool finished)
+{
+    const int total = (int)m_findAllMatches.size();
+
+    wxString text;
+    if (finished)
+        text = wxString::Format(wxPLURAL("%d matching entry", "%d matching entries", total), total);
+    else
+        text = wxString::Format(_(L"%d matching entries so far…"), total);
+
+    if (total)
+    {
+        text += L" — ";
+        // TRANSLATORS: Per-field counts of "Find all" results, appended to e.g. "10 matching entries"
+        text += wxString::Format(_("source: %d, translation: %d, comments: %d, context: %d"),
+                                 m_findAllCounts[0], m_findAllCounts[1], m_findAllCounts[2], m_findAllCounts[3]);
+    }
+
+    m_findAllSummary->SetLabel(text);
+}
+
+void FindFrame::OnFindAllSelected()
+{
+    const int row = m_findAllResults->GetSelectedRow();
+    if (row == wxNOT_FOUND || row >= (int)m_findAllMatches.size() || !m_listCtrl)
+        return;
+
+    auto& item = m_findAllMatches[row].item;
+    auto listItem = m_listCtrl->CatalogItemToListItem(item);
+    if (!listItem.IsOk())
+        return; // filtered out of the list
+
+    m_listCtrl->EnsureVisible(listItem);
+    m_listCtrl->SelectAndFocus(listItem);
+    m_position = m_listCtrl->GetCurrentItemListIndex();
+    m_lastItem = item;
+}
+
 bool FindFrame::DoReplaceInItem(CatalogItemPtr item)
 {
     bool wholeWords = m_wholeWords->GetValue();
@@ -661,16 +1176,32 @@ void FindFrame::OnReplace(wxCommandEvent&)
 
 void FindFrame::OnReplaceAll(wxCommandEvent&)
 {
-    bool replaced = false;
-    for (auto& item: m_catalog->items())
-    {
-        if (DoReplaceInItem(item))
-            replaced = true;
-    }
+    auto search = m_searchField->GetValue();
+    if (!m_catalog || search.empty())
+        return;
 
-    if (replaced)
-    {
-        // FIXME: Only refresh affected items
-        m_listCtrl->RefreshAllItems();
-    }
+    wxBusyCursor bcur;
+
+    std::unique_ptr<ReplaceAllTransaction> replaceAll(
+        new ReplaceAllTransaction(*m_catalog, search, m_replaceField->GetValue(), m_wholeWords->GetValue()));
+    if (replaceAll->IsEmpty())
+        return;
+
+    replaceAll->Apply();
+    m_owner->OnItemsModifiedInBulk(replaceAll->Affects(m_owner->GetCurrentItem()));
+
+    m_lastReplaceAll = std::move(replaceAll);
+}
+
+void FindFrame::OnUndoReplaceAll(wxCommandEvent&)
+{
+    if (!m_lastReplaceAll || !m_lastReplaceAll->CanRevert())
+        return;
+
+    wxBusyCursor bcur;
+
+    m_lastReplaceAll->Revert();
+    m_owner->OnItemsModifiedInBulk(m_lastReplaceAll->Affects(m_owner->GetCurrentItem()));
+
+    m_lastReplaceAll.reset();
 }
@@ -26,19 +26,28 @@
 #ifndef _FINDFRAME_H_
 #define _FINDFRAME_H_
 
+#include "concurrency.h"
 #include "edlistctrl.h"
+#include "search_index.h"
+#include "search_pattern.h"
 
 #include <wx/frame.h>
 #include <wx/weakref.h>
 
+#include <memory>
+#include <vector>
+
 class WXDLLIMPEXP_FWD_CORE wxButton;
 class WXDLLIMPEXP_FWD_CORE wxCheckBox;
 class WXDLLIMPEXP_FWD_CORE wxChoice;
+class WXDLLIMPEXP_FWD_CORE wxStaticText;
 class WXDLLIMPEXP_FWD_CORE wxTextCtrl;
+class WXDLLIMPEXP_FWD_CORE wxDataViewListCtrl;
 
 class Catalog;
 class EditingArea;
 class PoeditFrame;
+class ReplaceAllTransaction;
 
 /** FindFrame is small dialog frame that contains controls for searching
     in content of EditorFrame's wxListCtrl object and associated Catalog
@@ -85,21 +94,50 @@ class FindFrame : public wxFrame
         void OnCheckbox(wxCommandEvent &event);
         void OnReplace(wxCommandEvent &event);
         void OnReplaceAll(wxCommandEvent &event);
+        void OnUndoReplaceAll(wxCommandEvent &event);
+        bool PreparePattern(bool ignoreCase);
         bool DoFind(int dir);
         bool DoReplaceInItem(CatalogItemPtr item);
 
+        // "Find all" support: matching runs in background tasks on a snapshot
+        // of the search index and results are streamed in as they come
+        struct FindAllMatch
+        {
+            size_t index;
+            CatalogItemPtr item;
+            int fields;
+        };
+        void OnFindAll(wxCommandEvent &event);
+        void CancelFindAll();
+        void OnFindAllMatches(const std::vector<FindAllMatch>& matches);
+        void OnFindAllFinished();
+        void OnFindAllSelected();
+        void UpdateFindAllSummary(bool finished);
+
         PoeditFrame *m_owner;
         wxChoice *m_mode;
         wxTextCtrl *m_searchField, *m_replaceField;
-        wxCheckBox *m_ignoreCase, *m_wrapAround, *m_wholeWords,
+        wxCheckBox *m_ignoreCase, *m_wrapAround, *m_wholeWords, *m_useRegex, *m_approximate,
                    *m_findInOrig, *m_findInTrans, *m_findInComments;
 
         wxWeakRef<PoeditListCtrl> m_listCtrl;
         wxWeakRef<EditingArea> m_editingArea;
         CatalogPtr m_catalog;
+        std::unique_ptr<CatalogSearchIndex> m_index;
+        // compiled regex or approximate pattern, if used by current search
+        std::shared_ptr<const SearchPattern> m_pattern;
         int m_position;
         CatalogItemPtr m_lastItem;
-        wxButton *m_btnClose, *m_btnReplaceAll, *m_btnReplace, *m_btnPrev, *m_btnNext;
+        wxButton *m_btnClose, *m_btnFindAll, *m_btnUndoReplaceAll, *m_btnReplaceAll, *m_btnReplace, *m_btnPrev, *m_btnNext;
+
+        // last Replace All operation, kept so that it can be reverted
+        std::unique_ptr<ReplaceAllTransaction> m_lastReplaceAll;
+
+        wxStaticText *m_findAllSummary;
+        wxDataViewListCtrl *m_findAllResults;
+        std::vector<FindAllMatch> m_findAllMatches;
+        int m_findAllCounts[4];
+        dispatch::cancellation_token_ptr m_findAllCancellation;
 
         // NB: this is static so that last search term is remembered
         static wxString ms_text;
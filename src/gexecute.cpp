@@ -35,6 +35,8 @@
 #include <wx/translation.h>
 #include <wx/filename.h>
 
+#include <map>
+#include <mutex>
 #include <regex>
 #include <boost/algorithm/string.hpp>
 
@@ -53,27 +55,43 @@ namespace
 // Determine gettext version, return it in the form of XXXYYYZZZ number for version x.y.z
 uint32_t gettext_version()
 {
-    static uint32_t s_version = 0;
-    if (!s_version)
+    // Versions are remembered for the lifetime of the app, separately for
+    // every binary location, so that the tools are only probed once. This may
+    // be called from multiple threads concurrently; at worst, the version is
+    // detected twice. The lock is not held while running the probe, because
+    // that may need the main thread to launch the process.
+    static std::mutex s_mutex;
+    static std::map<wxString, uint32_t> s_versions;
+
+    const wxString binary = GetGettextBinaryPath("msgcat");
     {
-        // set old enough fallback version
-        s_version = GETTEXT_VERSION_NUM(0, 18, 0);
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto cached = s_versions.find(binary);
+        if (cached != s_versions.end())
+            return cached->second;
+    }
+
+    // set old enough fallback version
+    uint32_t version = GETTEXT_VERSION_NUM(0, 18, 0);
 
-        auto p = GettextRunner().run_sync("msgcat", "--version");
-        if (p.exit_code == 0 && !p.std_out.empty())
+    auto p = GettextRunner().run_sync("msgcat", "--version");
+    if (p.exit_code == 0 && !p.std_out.empty())
+    {
+        static const std::regex RE_VERSION(R"( (([0-9]+)\.([0-9]+)(\.([0-9]+))?)\s)");
+        std::smatch m;
+        if (std::regex_search(p.std_out, m, RE_VERSION))
         {
-            std::smatch m;
-            if (std::regex_search(p.std_out, m, std::regex(R"( (([0-9]+)\.([0-9]+)(\.([0-9]+))?)\s)")))
-            {
-                const int x = std::stoi(m.str(2));
-                const int y = std::stoi(m.str(3));
-                const int z = m[5].matched ? std::stoi(m.str(5)) : 0;
-                s_version = GETTEXT_VERSION_NUM(x, y, z);
-                wxLogTrace("poedit", "detected GNU gettext version %d.%d.%d (%06d)", x, y, z, (int)s_version);
-            }
+            const int x = std::stoi(m.str(2));
+            const int y = std::stoi(m.str(3));
+            const int z = m[5].matched ? std::stoi(m.str(5)) : 0;
+            version = GETTEXT_VERSION_NUM(x, y, z);
+            wxLogTrace("poedit", "detected GNU gettext version %d.%d.%d (%06d)", x, y, z, (int)version);
         }
     }
-    return s_version;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_versions[binary] = version;
+    return version;
 }
 
 
@@ -144,6 +162,12 @@ bool check_gettext_version(int major, int minor, int patch)
 }
 
 
+uint32_t get_gettext_version()
+{
+    return gettext_version();
+}
+
+
 wxString ParsedGettextErrors::Item::pretty_print() const
 {
     wxString prefix;
@@ -30,6 +30,7 @@
 
 #include <wx/string.h>
 
+#include <cstdint>
 #include <vector>
 
 
@@ -91,6 +92,9 @@ inline wxString GetGettextBinaryPath(const wxString& program) { return program;
 /// Checks if installed gettext tools are recent enough.
 extern bool check_gettext_version(int major, int minor, int patch = 0);
 
+/// Returns version of installed gettext tools as XXYYZZ number (e.g. 2501 for 0.25.1).
+extern uint32_t get_gettext_version();
+
 /**
     Extract gettext-formatted errors from stderr output.
 
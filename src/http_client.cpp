@@ -25,11 +25,19 @@
 
 #include "http_client.h"
 
+#include "errors.h"
 #include "utility.h"
 #include "str_helpers.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iomanip>
+#include <mutex>
+#include <random>
 #include <sstream>
+#include <thread>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/uuid/uuid.hpp>
@@ -37,24 +45,33 @@
 #include <boost/uuid/uuid_generators.hpp>
 
 #include <wx/filename.h>
+#include <wx/log.h>
+#include <wx/translation.h>
 #include <wx/uri.h>
 
+#ifdef __WXMSW__
+    #include <objbase.h>
+#endif
+
 
 class downloaded_file::impl
 {
 public:
-    impl(std::string filename, const std::string& etag)
+    impl(std::string filename, const std::string& etag, const std::string& last_modified)
     {
         // filter out invalid characters in filenames
         std::replace_if(filename.begin(), filename.end(), boost::is_any_of("\\/:\"<>|?*"), '_');
         m_fn = m_tmpdir.CreateFileName(!filename.empty() ? str::to_wx(filename) : "data");
         m_etag = etag;
+        m_lastModified = last_modified;
     }
 
     wxFileName filename() const { return m_fn; }
 
     std::string etag() const { return m_etag; }
 
+    std::string last_modified() const { return m_lastModified; }
+
     void move_to(const wxFileName& target)
     {
         TempOutputFileFor::ReplaceFile(m_fn.GetFullPath(), target.GetFullPath());
@@ -64,11 +81,14 @@ private:
     TempDirectory m_tmpdir;
     wxFileName m_fn;
     std::string m_etag;
+    std::string m_lastModified;
 };
 
-downloaded_file::downloaded_file(const std::string& filename, const std::string& etag) : m_impl(new impl(filename, etag)) {}
+downloaded_file::downloaded_file(const std::string& filename, const std::string& etag, const std::string& last_modified)
+    : m_impl(new impl(filename, etag, last_modified)) {}
 wxFileName downloaded_file::filename() const { return m_impl->filename(); }
 std::string downloaded_file::etag() const { return m_impl->etag(); }
+std::string downloaded_file::last_modified() const { return m_impl->last_modified(); }
 void downloaded_file::move_to(const wxFileName& target) { return m_impl->move_to(target); }
 downloaded_file::~downloaded_file() {}
 
@@ -125,30 +145,86 @@ json_data::json_data(const json& data)
 }
 
 
+namespace
+{
+
+// Clients used by download_from_anywhere(), one per host, so that their
+// connections are kept alive and reused by subsequent downloads
+std::mutex gs_sharedClientsMutex;
+std::map<std::string, std::shared_ptr<http_client>> gs_sharedClients;
+
+} // anonymous namespace
+
+
 dispatch::future<downloaded_file> http_client::download_from_anywhere(const std::string& url, const headers& hdrs)
 {
     // http_client requires that all requests are relative to the provided prefix
     // (this is a C++REST SDK limitation enforced on some platforms), so we need
-    // to determine the URL's prefix, create a transient http_client for it and
-    // use it to perform the request.
+    // to determine the URL's prefix and use a client for it to perform the request.
 
     wxURI uri(url);
     const std::string prefix = str::to_utf8(uri.GetScheme() + "://" + uri.GetServer());
 
-    auto transient = std::make_shared<http_client>(prefix);
-    return transient->download(url, hdrs)
-           .then([transient](downloaded_file file)
+    std::shared_ptr<http_client> client;
+    {
+        std::lock_guard<std::mutex> lock(gs_sharedClientsMutex);
+        auto& c = gs_sharedClients[prefix];
+        if (!c)
+            c = std::make_shared<http_client>(prefix);
+        client = c;
+    }
+
+    return client->download(url, hdrs)
+           .then([client](downloaded_file file)
            {
-               // The entire purpose of this otherwise-useless closure is to
-               // capture the `transient` http_client instance and ensure it won't
-               // be destroyed too early.
-               //
-               // It will only be released at this point.
+               // keep the client alive until the download finishes, even if
+               // cleanup_shared_clients() was called in the meantime
                return file;
            });
 }
 
 
+void http_client::cleanup_shared_clients()
+{
+    std::lock_guard<std::mutex> lock(gs_sharedClientsMutex);
+    gs_sharedClients.clear();
+}
+
+
+dispatch::future<std::vector<json>> http_client::get_batch(const std::vector<std::string>& urls, const headers& hdrs)
+{
+    if (urls.empty())
+        return dispatch::make_ready_future(std::vector<json>());
+
+    auto results = std::make_shared<std::vector<json>>(urls.size());
+    auto remaining = std::make_shared<std::atomic<size_t>>(urls.size());
+    auto failed = std::make_shared<std::atomic<bool>>(false);
+    auto promise = std::make_shared<dispatch::promise<std::vector<json>>>();
+
+    for (size_t i = 0; i < urls.size(); i++)
+    {
+        get(urls[i], hdrs).then([=](dispatch::future<json> f)
+        {
+            try
+            {
+                (*results)[i] = f.get();
+            }
+            catch (...)
+            {
+                // report only the first error
+                if (!failed->exchange(true))
+                    dispatch::set_current_exception(promise);
+            }
+
+            if (--(*remaining) == 0 && !*failed)
+                promise->set_value(std::move(*results));
+        });
+    }
+
+    return promise->get_future();
+}
+
+
 std::string http_client::url_encode(const std::string& s, int flags)
 {
     std::ostringstream escaped;
@@ -185,3 +261,287 @@ std::string http_client::url_encode(const std::wstring& s, int flags)
 {
     return url_encode(str::to_utf8(s), flags);
 }
+
+
+namespace
+{
+
+typedef std::chrono::steady_clock scheduler_clock;
+
+// how often to check if the host became reachable again:
+const auto REACHABILITY_POLL_INTERVAL = std::chrono::seconds(5);
+// how long may interactive operations wait for the host to become reachable:
+const auto INTERACTIVE_OFFLINE_TIMEOUT = std::chrono::seconds(10);
+// retries of failed operations:
+const int MAX_RETRIES = 5;
+const auto RETRY_INITIAL_DELAY = std::chrono::milliseconds(1000);
+const auto RETRY_MAX_DELAY = std::chrono::milliseconds(60000);
+
+bool is_transient_error(dispatch::exception_ptr e)
+{
+    try
+    {
+        boost::rethrow_exception(e);
+    }
+    catch (const http_response_error& err)
+    {
+        const int status = err.status_code();
+        return status == 429/*Too Many Requests*/ || status >= 500;
+    }
+    catch (...)
+    {
+        // network errors, timeouts etc.
+        return true;
+    }
+}
+
+} // anonymous namespace
+
+
+class http_scheduler::impl : public std::enable_shared_from_this<http_scheduler::impl>
+{
+public:
+    impl(const std::string& url, int max_bulk_ops)
+        : m_url(url), m_maxBulkOps(std::max(1, max_bulk_ops)), m_random(std::random_device()())
+    {
+    }
+
+    void start()
+    {
+        std::weak_ptr<impl> weakSelf = shared_from_this();
+        m_worker = std::thread([weakSelf]{
+            if (auto self = weakSelf.lock())
+                self->worker();
+        });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            m_cv.notify_all();
+        }
+        if (m_worker.joinable())
+            m_worker.join();
+    }
+
+    dispatch::future<void> schedule(priority prio, std::function<dispatch::future<void>()>&& func)
+    {
+        auto op = std::make_shared<operation>();
+        op->prio = prio;
+        op->func = std::move(func);
+        op->queued = scheduler_clock::now();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(op);
+        m_cv.notify_all();
+        return op->promise.get_future();
+    }
+
+private:
+    struct operation
+    {
+        priority prio;
+        std::function<dispatch::future<void>()> func;
+        dispatch::promise<void> promise;
+        int attempt = 0;
+        scheduler_clock::time_point queued;
+        scheduler_clock::time_point not_before;
+    };
+    typedef std::shared_ptr<operation> operation_ptr;
+
+    void worker()
+    {
+#ifdef __WXMSW__
+        // http_reachability uses COM on Windows
+        CoInitializeEx(NULL, COINIT_MULTITHREADED);
+#endif
+        {
+            http_reachability reachability(m_url);
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_stopping)
+            {
+                if (m_queue.empty())
+                {
+                    m_cv.wait(lock);
+                    continue;
+                }
+
+                lock.unlock();
+                const bool online = reachability.is_reachable();
+                lock.lock();
+
+                const auto now = scheduler_clock::now();
+                auto wakeup = now + REACHABILITY_POLL_INTERVAL;
+
+                std::vector<operation_ptr> to_start, to_fail;
+                if (online)
+                {
+                    // interactive operations first, in order of scheduling:
+                    for (auto prio: {priority::interactive, priority::bulk})
+                    {
+                        for (auto i = m_queue.begin(); i != m_queue.end(); )
+                        {
+                            auto op = *i;
+                            if (op->prio != prio)
+                            {
+                                ++i;
+                            }
+                            else if (op->not_before > now)
+                            {
+                                wakeup = std::min(wakeup, op->not_before);
+                                ++i;
+                            }
+                            else if (prio == priority::bulk && m_runningBulkOps >= m_maxBulkOps)
+                            {
+                                break;
+                            }
+                            else
+                            {
+                                if (prio == priority::bulk)
+                                    m_runningBulkOps++;
+                                to_start.push_back(op);
+                                i = m_queue.erase(i);
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    for (auto i = m_queue.begin(); i != m_queue.end(); )
+                    {
+                        if ((*i)->prio == priority::interactive && now - (*i)->queued >= INTERACTIVE_OFFLINE_TIMEOUT)
+                        {
+                            to_fail.push_back(*i);
+                            i = m_queue.erase(i);
+                        }
+                        else
+                        {
+                            ++i;
+                        }
+                    }
+                }
+
+                if (!to_start.empty() || !to_fail.empty())
+                {
+                    lock.unlock();
+                    for (auto& op: to_fail)
+                        fail_offline(op);
+                    for (auto& op: to_start)
+                        run(op);
+                    lock.lock();
+                    continue;
+                }
+
+                m_cv.wait_until(lock, wakeup);
+            }
+        }
+#ifdef __WXMSW__
+        CoUninitialize();
+#endif
+    }
+
+    void run(operation_ptr op)
+    {
+        std::weak_ptr<impl> weakSelf = shared_from_this();
+        auto f = [&]() -> dispatch::future<void>
+        {
+            try
+            {
+                return op->func();
+            }
+            catch (...)
+            {
+                return dispatch::make_exceptional_future_from_current<void>();
+            }
+        }();
+
+        f.then([weakSelf, op]
+        {
+            if (auto self = weakSelf.lock())
+                self->finished(op);
+            op->promise.set_value();
+        })
+        .catch_all([weakSelf, op](dispatch::exception_ptr e)
+        {
+            auto self = weakSelf.lock();
+            if (self)
+                self->finished(op);
+            if (self && is_transient_error(e) && op->attempt < MAX_RETRIES)
+                self->retry(op);
+            else
+                op->promise.set_exception(e);
+        });
+    }
+
+    void finished(const operation_ptr& op)
+    {
+        if (op->prio != priority::bulk)
+            return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_runningBulkOps--;
+        m_cv.notify_all();
+    }
+
+    void retry(const operation_ptr& op)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // exponentially growing delay, randomized so that clients don't retry in lockstep
+        auto limit = std::min(RETRY_MAX_DELAY, RETRY_INITIAL_DELAY * (1 << op->attempt));
+        std::uniform_int_distribution<long long> jitter(limit.count() / 2, limit.count());
+        const auto delay = std::chrono::milliseconds(jitter(m_random));
+
+        op->attempt++;
+        op->queued = scheduler_clock::now();
+        op->not_before = op->queued + delay;
+        wxLogTrace("poedit.http", "Operation failed, retry %d in %d ms", op->attempt, (int)delay.count());
+
+        m_queue.push_back(op);
+        m_cv.notify_all();
+    }
+
+    void fail_offline(const operation_ptr& op)
+    {
+        wxLogTrace("poedit.http", "Host %s unreachable, giving up", m_url);
+        try
+        {
+            BOOST_THROW_EXCEPTION(Exception(_("No internet connection.")));
+        }
+        catch (...)
+        {
+            dispatch::set_current_exception(op->promise);
+        }
+    }
+
+    const std::string m_url;
+    const int m_maxBulkOps;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_worker;
+    bool m_stopping = false;
+
+    std::deque<operation_ptr> m_queue;
+    int m_runningBulkOps = 0;
+    std::mt19937 m_random;
+};
+
+
+http_scheduler::http_scheduler(const std::string& url, int max_bulk_ops)
+    : m_impl(std::make_shared<impl>(url, max_bulk_ops))
+{
+    m_impl->start();
+}
+
+http_scheduler::~http_scheduler()
+{
+    m_impl->stop();
+}
+
+dispatch::future<void> http_scheduler::schedule(priority prio, std::function<dispatch::future<void>()>&& op)
+{
+    return m_impl->schedule(prio, std::move(op));
+}
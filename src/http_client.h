@@ -34,9 +34,12 @@
 #include <wx/filename.h>
 
 #include <exception>
+#include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 class http_client;
 
@@ -54,7 +57,7 @@ class http_client;
 class downloaded_file
 {
 public:
-    downloaded_file(const std::string& filename = "", const std::string& etag = "");
+    downloaded_file(const std::string& filename = "", const std::string& etag = "", const std::string& last_modified = "");
     ~downloaded_file();
 
     /// Return location of the temporary file
@@ -63,6 +66,9 @@ public:
     /// Return downloaded file's ETag if present or empty string otherwise
     std::string etag() const;
 
+    /// Return downloaded file's Last-Modified header if present or empty string otherwise
+    std::string last_modified() const;
+
     /// Move the file to a different location
     void move_to(const wxFileName& target);
 
@@ -87,21 +93,37 @@ public:
 
     /// Returns generated body of the request.
     virtual std::string body() const = 0;
+
+    /**
+        Returns the body in a form that can be sent without copying it.
+
+        The default implementation wraps body(); subclasses that already
+        keep the whole body in memory override it to share it instead.
+     */
+    virtual std::shared_ptr<const std::string> shared_body() const
+    {
+        return std::make_shared<const std::string>(body());
+    }
 };
 
 /// Stores unspecified binary data
 class octet_stream_data : public http_body_data
 {
 public:
-    octet_stream_data(const std::string& body) : m_body(body) {};
+    octet_stream_data(const std::string& body) : m_body(std::make_shared<const std::string>(body)) {};
+    /// Takes ownership of @a body without copying it
+    octet_stream_data(std::string&& body) : m_body(std::make_shared<const std::string>(std::move(body))) {};
 
     /// Content-Type header to use with the data.
     std::string content_type() const override { return "application/octet-stream"; };
 
     /// Returns generated body of the request.
-    std::string body() const override { return m_body; };
+    std::string body() const override { return *m_body; };
+
+    std::shared_ptr<const std::string> shared_body() const override { return m_body; }
+
 private:
-    std::string m_body;
+    std::shared_ptr<const std::string> m_body;
 };
 
 /// Stores POSTed data (RFC 1867)
@@ -200,15 +222,26 @@ public:
     /// Sets Authorization header to be used in all requests
     void set_authorization(const std::string& auth);
 
+    /// Number of requests each client runs concurrently by default
+    static constexpr int default_max_concurrent_requests = 6;
+
+    /**
+        Sets maximum number of requests to run concurrently.
+
+        Further requests are queued until some of the running ones finish.
+        Should be called before issuing any requests.
+     */
+    void set_max_concurrent_requests(int count);
+
     /// Perform a GET request at the given URL
     dispatch::future<json> get(const std::string& url, const headers& hdrs = headers());
 
     /**
         Perform a GET request and store the body in a file.
 
-        This method supports ETag handling. If the headers include If-None-Match value
-        and the server returns 304 Not Modified, downloaded_file is not returned and
-        an exception is thrown instead.
+        This method supports conditional requests. If the headers include If-None-Match
+        or If-Modified-Since value and the server returns 304 Not Modified,
+        downloaded_file is not returned and an exception is thrown instead.
      */
     dispatch::future<downloaded_file> download(const std::string& url, const headers& hdrs = headers());
 
@@ -219,11 +252,23 @@ public:
      */
     static dispatch::future<downloaded_file> download_from_anywhere(const std::string& url, const headers& hdrs = headers());
 
+    /// Releases clients kept by download_from_anywhere(); must be called on app shutdown.
+    static void cleanup_shared_clients();
+
     /**
         Perform a POST request with multipart/form-data formatted @a params.
      */
     dispatch::future<json> post(const std::string& url, const http_body_data& data, const headers& hdrs = headers());
 
+    /**
+        Perform several GET requests at once.
+
+        The requests run concurrently, up to the limit set with
+        set_max_concurrent_requests(). Responses are returned in the same
+        order as @a urls; the future fails if any of the requests fails.
+     */
+    dispatch::future<std::vector<json>> get_batch(const std::vector<std::string>& urls, const headers& hdrs = headers());
+
 
     // Helper for encoding text as URL-encoded UTF-8
 
@@ -275,6 +320,67 @@ private:
     std::unique_ptr<impl> m_impl;
 };
 
+
+/**
+    Schedules operations with a cloud service with respect to reachability.
+
+    Operations are queued while the host isn't reachable and started when
+    it becomes reachable again. Operations that fail with a transient error
+    (network failure, rate limiting or server error) are retried with
+    exponential backoff with jitter. Queued interactive operations always
+    start before bulk ones, of which only a few run at once.
+
+    Errors raised by the operation are considered transient unless they
+    are http_response_error with other status than 429 or 5xx, so the
+    operation should only do the network request and leave processing
+    of the response to a continuation.
+ */
+class http_scheduler
+{
+public:
+    enum class priority
+    {
+        /// Operations the user is waiting for, e.g. fetching user info
+        interactive,
+        /// Long-running operations, e.g. syncing many files
+        bulk
+    };
+
+    /**
+        Creates the scheduler.
+
+        @param url             URL of the service, used to check reachability.
+        @param max_bulk_ops    How many bulk operations may run at once.
+     */
+    http_scheduler(const std::string& url, int max_bulk_ops = 2);
+    ~http_scheduler();
+
+    /**
+        Schedules asynchronous operation @a op for execution.
+
+        Interactive operations fail (instead of waiting) if the host remains
+        unreachable for too long, bulk ones wait for as long as needed.
+
+        @return Future with the result of the last attempt at running @a op.
+     */
+    dispatch::future<void> schedule(priority prio, std::function<dispatch::future<void>()>&& op);
+
+    template<typename T>
+    dispatch::future<T> schedule(priority prio, std::function<dispatch::future<T>()>&& op)
+    {
+        auto result = std::make_shared<std::optional<T>>();
+        return schedule(prio, [result, op{std::move(op)}]
+                              {
+                                  return op().then([result](T r){ *result = std::move(r); });
+                              })
+               .then([result]{ return std::move(**result); });
+    }
+
+private:
+    class impl;
+    std::shared_ptr<impl> m_impl;
+};
+
 #endif // HAVE_HTTP_CLIENT
 
 #endif // Poedit_http_client_h
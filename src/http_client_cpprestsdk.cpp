@@ -27,7 +27,9 @@
 
 #include "version.h"
 #include "str_helpers.h"
+#include "tracing.h"
 
+#include <algorithm>
 #include <cstdlib>
 
 #include <boost/algorithm/string/predicate.hpp>
@@ -44,7 +46,10 @@
 #include <cpprest/http_client.h>
 #include <cpprest/http_msg.h>
 #include <cpprest/filestream.h>
+#include <cpprest/rawptrstream.h>
 
+#include <deque>
+#include <mutex>
 #include <regex>
 
 
@@ -120,6 +125,75 @@ public:
     }
 };
 
+
+/**
+    Limits the number of concurrently running requests, queuing the rest.
+
+    A request's slot is released once its response headers arrive; the body
+    is then read using the same (kept-alive) connection.
+ */
+class request_limiter
+{
+public:
+    explicit request_limiter(int limit) : m_limit(limit), m_running(0) {}
+
+    void set_limit(int limit)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_limit = std::max(1, limit);
+    }
+
+    pplx::task<http::http_response> request(http::client::http_client& client, http::http_request req)
+    {
+        pplx::task_completion_event<void> slot;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_running < m_limit)
+            {
+                m_running++;
+                slot.set();
+            }
+            else
+            {
+                m_waiting.push_back(slot);
+            }
+        }
+
+        return pplx::create_task(slot)
+        .then([&client, req]
+        {
+            return client.request(req);
+        })
+        .then([this](pplx::task<http::http_response> response)
+        {
+            release();
+            return response;
+        });
+    }
+
+private:
+    void release()
+    {
+        pplx::task_completion_event<void> next;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_waiting.empty() || m_running > m_limit)
+            {
+                m_running--;
+                return;
+            }
+            next = m_waiting.front();
+            m_waiting.pop_front();
+        }
+        // the slot is passed on to the next request
+        next.set();
+    }
+
+    std::mutex m_mutex;
+    int m_limit, m_running;
+    std::deque<pplx::task_completion_event<void>> m_waiting;
+};
+
 } // anonymous namespace
 
 
@@ -128,7 +202,8 @@ class http_client::impl
 public:
     impl(http_client& owner, const std::string& url_prefix, int flags)
         : m_owner(owner),
-          m_native(sanitize_url(url_prefix, flags), get_client_config())
+          m_native(sanitize_url(url_prefix, flags), get_client_config()),
+          m_limiter(default_max_concurrent_requests)
     {
         #define make_wide_str(x) make_wide_str_(x)
         #define make_wide_str_(x) L ## x
@@ -153,12 +228,17 @@ public:
         m_auth = std::wstring(auth.begin(), auth.end());
     }
 
+    void set_max_concurrent_requests(int count)
+    {
+        m_limiter.set_limit(count);
+    }
+
     dispatch::future<::json> get(const std::string& url, const headers& hdrs)
     {
         auto req = build_request(http::methods::GET, url, hdrs);
 
         return
-        m_native.request(req)
+        m_limiter.request(m_native, req)
         .then([=](http::http_response response)
         {
             handle_error(response);
@@ -173,7 +253,7 @@ public:
         auto req = build_request(http::methods::GET, url, hdrs);
 
         return
-        m_native.request(req)
+        m_limiter.request(m_native, req)
         .then([=](http::http_response response)
         {
             handle_error(response);
@@ -183,7 +263,12 @@ public:
             if (i_etag != response.headers().end())
 				etag = str::to_utf8(i_etag->second);
 
-            downloaded_file file(extract_attachment_filename(req, response), etag);
+            std::string last_modified;
+            auto i_last_modified = response.headers().find(http::header_names::last_modified);
+            if (i_last_modified != response.headers().end())
+                last_modified = str::to_utf8(i_last_modified->second);
+
+            downloaded_file file(extract_attachment_filename(req, response), etag, last_modified);
 
             return
             fstream::open_ostream(to_string_t(file.filename().GetFullPath()))
@@ -207,13 +292,15 @@ public:
     {
         auto req = build_request(http::methods::POST, url, hdrs);
 
-        auto body = data.body();
-        req.set_body(body, data.content_type());
-        req.headers().set_content_length(body.size());
+        // send the data directly from memory instead of copying it into the
+        // request; it must be kept alive until the request completes:
+        auto body = data.shared_body();
+        auto stream = concurrency::streams::rawptr_stream<uint8_t>::open_istream(reinterpret_cast<const uint8_t*>(body->data()), body->size());
+        req.set_body(stream, body->size(), to_string_t(data.content_type()));
 
         return
-        m_native.request(req)
-        .then([=](http::http_response response)
+        m_limiter.request(m_native, req)
+        .then([this, body](http::http_response response)
         {
             handle_error(response);
             return ::json::parse(response.extract_utf8string().get());
@@ -328,6 +415,7 @@ private:
 
     http_client& m_owner;
     http::client::http_client m_native;
+    request_limiter m_limiter;
     std::wstring m_userAgent;
     std::wstring m_auth;
 };
@@ -355,19 +443,24 @@ void http_client::set_authorization(const std::string& auth)
     m_impl->set_authorization(auth);
 }
 
+void http_client::set_max_concurrent_requests(int count)
+{
+    m_impl->set_max_concurrent_requests(count);
+}
+
 dispatch::future<::json> http_client::get(const std::string& url, const headers& hdrs)
 {
-    return m_impl->get(url, hdrs);
+    return tracing::trace_future("http", "GET", m_impl->get(url, hdrs));
 }
 
 dispatch::future<downloaded_file> http_client::download(const std::string& url, const headers& hdrs)
 {
-    return m_impl->download(url, hdrs);
+    return tracing::trace_future("http", "download", m_impl->download(url, hdrs));
 }
 
 dispatch::future<::json> http_client::post(const std::string& url, const http_body_data& data, const headers& hdrs)
 {
-    return m_impl->post(url, data, hdrs);
+    return tracing::trace_future("http", "POST", m_impl->post(url, data, hdrs));
 }
 
 
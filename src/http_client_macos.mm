@@ -26,8 +26,11 @@
 #include "http_client.h"
 
 #include "str_helpers.h"
+#include "tracing.h"
 #include "version.h"
 
+#include <algorithm>
+
 
 class http_client::impl
 {
@@ -50,6 +53,8 @@ public:
             @"User-Agent": user_agent,
             @"Accept": @"application/json"
         };
+        // NSURLSession reuses connections and uses HTTP/2 if available on its own:
+        config.HTTPMaximumConnectionsPerHost = default_max_concurrent_requests;
 
         NSString *str = str::to_NS(url_prefix);
 
@@ -67,6 +72,16 @@ public:
         m_authHeader = auth.empty() ? nil : str::to_NS(auth);
     }
 
+    void set_max_concurrent_requests(int count)
+    {
+        auto config = m_session.configuration;
+        config.HTTPMaximumConnectionsPerHost = std::max(1, count);
+
+        auto old = m_session;
+        m_session = [NSURLSession sessionWithConfiguration:config];
+        [old finishTasksAndInvalidate];
+    }
+
     dispatch::future<json> get(const std::string& url, const headers& hdrs)
     {
         auto promise = std::make_shared<dispatch::promise<json>>();
@@ -103,8 +118,10 @@ public:
                     return;
 
                 NSString *etag = response.allHeaderFields[@"ETag"];
+                NSString *lastModified = response.allHeaderFields[@"Last-Modified"];
                 downloaded_file file(str::to_utf8([response suggestedFilename]),
-                                     etag ? str::to_utf8(etag) : std::string());
+                                     etag ? str::to_utf8(etag) : std::string(),
+                                     lastModified ? str::to_utf8(lastModified) : std::string());
                 NSString *outputPath = str::to_NS(file.filename().GetFullPath());
 
                 NSError *err = nil;
@@ -130,10 +147,14 @@ public:
         auto promise = std::make_shared<dispatch::promise<json>>();
 
         auto request = build_request(@"POST", url, hdrs);
-        auto body = body_data.body();
+        auto body = body_data.shared_body();
         [request setValue:str::to_NS(body_data.content_type()) forHTTPHeaderField:@"Content-Type"];
-        [request setValue:[NSString stringWithFormat:@"%lu", body.size()] forHTTPHeaderField:@"Content-Length"];
-        [request setHTTPBody:[NSData dataWithBytes:body.data() length:body.size()]];
+        [request setValue:[NSString stringWithFormat:@"%lu", body->size()] forHTTPHeaderField:@"Content-Length"];
+        // wrap the data without copying, the deallocator keeps it alive:
+        NSData *httpBody = [[NSData alloc] initWithBytesNoCopy:(void*)body->data()
+                                                        length:body->size()
+                                                   deallocator:^(void*, NSUInteger){ (void)body; }];
+        [request setHTTPBody:httpBody];
 
         auto task = [m_session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
             try
@@ -241,19 +262,24 @@ void http_client::set_authorization(const std::string& auth)
     m_impl->set_authorization(auth);
 }
 
+void http_client::set_max_concurrent_requests(int count)
+{
+    m_impl->set_max_concurrent_requests(count);
+}
+
 dispatch::future<json> http_client::get(const std::string& url, const headers& hdrs)
 {
-    return m_impl->get(url, hdrs);
+    return tracing::trace_future("http", "GET", m_impl->get(url, hdrs));
 }
 
 dispatch::future<downloaded_file> http_client::download(const std::string& url, const headers& hdrs)
 {
-    return m_impl->download(url, hdrs);
+    return tracing::trace_future("http", "download", m_impl->download(url, hdrs));
 }
 
 dispatch::future<json> http_client::post(const std::string& url, const http_body_data& data, const headers& hdrs)
 {
-    return m_impl->post(url, data, hdrs);
+    return tracing::trace_future("http", "POST", m_impl->post(url, data, hdrs));
 }
 
 
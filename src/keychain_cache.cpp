@@ -0,0 +1,183 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "keychain_cache.h"
+
+#include "keychain/keytar.h"
+
+#include <wx/log.h>
+
+
+KeychainCache *KeychainCache::ms_instance = nullptr;
+
+KeychainCache& KeychainCache::Get()
+{
+    static std::once_flag initializationFlag;
+    std::call_once(initializationFlag, []{
+        ms_instance = new KeychainCache;
+    });
+    return *ms_instance;
+}
+
+
+void KeychainCache::CleanUp()
+{
+    if (ms_instance)
+    {
+        ms_instance->Flush();
+        delete ms_instance;
+        ms_instance = nullptr;
+    }
+}
+
+
+void KeychainCache::Preload(const std::string& service, const std::string& user)
+{
+    const Key key(service, user);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& entry = m_entries[key];
+    if (!entry.loaded && !entry.loading)
+        StartLoading(key, entry);
+}
+
+
+dispatch::future<std::string> KeychainCache::GetPassword(const std::string& service, const std::string& user)
+{
+    const Key key(service, user);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& entry = m_entries[key];
+    if (entry.loaded)
+        return dispatch::make_ready_future(std::string(entry.value));
+
+    auto waiter = std::make_shared<dispatch::promise<std::string>>();
+    entry.waiters.push_back(waiter);
+    if (!entry.loading)
+        StartLoading(key, entry);
+    return waiter->get_future();
+}
+
+
+void KeychainCache::SetPassword(const std::string& service, const std::string& user, const std::string& password)
+{
+    const Key key(service, user);
+
+    std::vector<std::shared_ptr<dispatch::promise<std::string>>> waiters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& entry = m_entries[key];
+
+        // the new value supersedes whatever is being read from the keychain:
+        entry.value = password;
+        entry.loaded = true;
+        waiters.swap(entry.waiters);
+
+        if (entry.writing)
+            entry.dirty = true; // written again once the current write finishes
+        else
+            StartWriting(key, entry);
+    }
+
+    for (auto& w: waiters)
+        w->set_value(password);
+}
+
+
+void KeychainCache::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_writesDone.wait(lock, [=]{ return m_pendingWrites == 0; });
+}
+
+
+void KeychainCache::StartLoading(const Key& key, Entry& entry)
+{
+    entry.loading = true;
+    dispatch::async([=]{ DoLoad(key); });
+}
+
+
+void KeychainCache::StartWriting(const Key& key, Entry& entry)
+{
+    entry.writing = true;
+    m_pendingWrites++;
+    dispatch::async([=]{ DoWrite(key); });
+}
+
+
+void KeychainCache::DoLoad(Key key)
+{
+    std::string value;
+    if (!keytar::GetPassword(key.first, key.second, &value))
+        value.clear();
+
+    std::vector<std::shared_ptr<dispatch::promise<std::string>>> waiters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& entry = m_entries[key];
+        entry.loading = false;
+        if (entry.loaded)
+            return; // changed with SetPassword() in the meantime, waiters were notified then
+
+        entry.value = value;
+        entry.loaded = true;
+        waiters.swap(entry.waiters);
+    }
+
+    for (auto& w: waiters)
+        w->set_value(value);
+}
+
+
+void KeychainCache::DoWrite(Key key)
+{
+    for (;;)
+    {
+        std::string value;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto& entry = m_entries[key];
+            value = entry.value;
+            entry.dirty = false;
+        }
+
+        bool ok = value.empty()
+                  ? keytar::DeletePassword(key.first, key.second)
+                  : keytar::AddPassword(key.first, key.second, value);
+        if (!ok)
+            wxLogTrace("poedit", "Failed to update keychain item for %s", key.first.c_str());
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& entry = m_entries[key];
+        if (!entry.dirty)
+        {
+            entry.writing = false;
+            m_pendingWrites--;
+            m_writesDone.notify_all();
+            return;
+        }
+    }
+}
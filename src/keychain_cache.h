@@ -0,0 +1,104 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_keychain_cache_h
+#define Poedit_keychain_cache_h
+
+#include "concurrency.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/**
+    Asynchronous access to passwords stored in the OS keychain, with in-memory cache.
+
+    Keychain access can take hundreds of milliseconds (and on macOS, even show
+    UI), so it is always done on a background thread. Values are cached after
+    the first read and changes update the cache immediately. Writing them to
+    the keychain is coalesced: if a value changes several times while being
+    written, only the latest one is written afterwards.
+ */
+class KeychainCache
+{
+public:
+    /// Return singleton instance of the cache.
+    static KeychainCache& Get();
+
+    /// Writes any pending changes and destroys the singleton; call on app shutdown.
+    static void CleanUp();
+
+    /// Starts reading the password in the background, so that it's cached when needed.
+    void Preload(const std::string& service, const std::string& user = "");
+
+    /// Asynchronously reads the password; empty string if not stored.
+    dispatch::future<std::string> GetPassword(const std::string& service, const std::string& user = "");
+
+    /**
+        Changes the stored password, empty @a password deletes it.
+
+        Returns immediately, the keychain is updated in the background.
+     */
+    void SetPassword(const std::string& service, const std::string& user, const std::string& password);
+
+    /// Convenience for SetPassword() with empty password.
+    void DeletePassword(const std::string& service, const std::string& user = "")
+        { SetPassword(service, user, std::string()); }
+
+    /// Waits until all pending changes are written to the keychain.
+    void Flush();
+
+private:
+    KeychainCache() {}
+
+    struct Entry
+    {
+        bool loaded = false, loading = false;
+        bool writing = false, dirty = false;
+        std::string value;
+        std::vector<std::shared_ptr<dispatch::promise<std::string>>> waiters;
+    };
+
+    typedef std::pair<std::string, std::string> Key;
+
+    // both must be called with m_mutex held:
+    void StartLoading(const Key& key, Entry& entry);
+    void StartWriting(const Key& key, Entry& entry);
+
+    void DoLoad(Key key);
+    void DoWrite(Key key);
+
+    std::mutex m_mutex;
+    std::condition_variable m_writesDone;
+    size_t m_pendingWrites = 0;
+    std::map<Key, Entry> m_entries;
+
+    static KeychainCache *ms_instance;
+};
+
+#endif // Poedit_keychain_cache_h
@@ -32,10 +32,10 @@
 #include <cctype>
 #include <algorithm>
 #include <unordered_map>
-#include <mutex>
 #include <memory>
 #include <regex>
 #include <set>
+#include <shared_mutex>
 
 #include <boost/algorithm/string.hpp>
 
@@ -123,6 +123,42 @@ bool IsValidRegion(const std::string& s)
     return false;
 }
 
+// Thread-safe cache of slow lookups: only a handful of distinct languages
+// are typically used, so repeatedly parsing them (e.g. for every unit in TMX
+// import or every TM search result) or getting their display names (e.g. in
+// lists of files) becomes a hash lookup.
+template<typename Key, typename Value>
+class LookupCache
+{
+public:
+    template<typename F>
+    Value Get(const Key& key, F&& compute)
+    {
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            auto i = m_cache.find(key);
+            if (i != m_cache.end())
+                return i->second;
+        }
+
+        Value value = compute();
+
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        // protect against unbounded growth with garbage input:
+        if (m_cache.size() >= MAX_SIZE)
+            m_cache.clear();
+        m_cache.emplace(key, value);
+        return value;
+    }
+
+private:
+    static const size_t MAX_SIZE = 1000;
+
+    std::shared_mutex m_mutex;
+    std::unordered_map<Key, Value> m_cache;
+};
+
+
 // Get locale display name or at least language
 template<typename T>
 auto GetDisplayNameOrLanguage(const char *locale, const char *displayLocale)
@@ -306,6 +342,7 @@ inline bool DoIsRTL(const Language& lang)
 void Language::Init(const std::string& code)
 {
     m_code = code;
+    m_wcode.assign(code.begin(), code.end());
 
     if (IsValid())
     {
@@ -397,6 +434,14 @@ Language Language::TryParse(const std::wstring& s)
     if (s.empty())
         return Language(); // invalid
 
+    // NB: human-readable names depend on UI language, but that doesn't change at runtime
+    static LookupCache<std::wstring, Language> cache;
+    return cache.Get(s, [&]{ return DoTryParse(s); });
+}
+
+
+Language Language::DoTryParse(const std::wstring& s)
+{
     if (IsValidCode(s))
         return Language(s);
 
@@ -415,7 +460,7 @@ Language Language::TryParse(const std::wstring& s)
     }
 
     // If not, perhaps it's a human-readable name (perhaps coming from the language control)?
-    auto names = GetDisplayNamesData();
+    auto& names = GetDisplayNamesData();
     auto folded = unicode::fold_case_to_type<std::u16string>(s);
     auto i = names.names.find(folded);
     if (i != names.names.end())
@@ -457,6 +502,13 @@ Language Language::FromLanguageTag(const std::string& tag)
     if (tag.empty())
         return Language(); // invalid
 
+    static LookupCache<std::string, Language> cache;
+    return cache.Get(tag, [&]{ return DoFromLanguageTag(tag); });
+}
+
+
+Language Language::DoFromLanguageTag(const std::string& tag)
+{
     char locale[ULOC_FULLNAME_CAPACITY];
     UErrorCode status = U_ZERO_ERROR;
     auto len = uloc_forLanguageTag(tag.c_str(), locale, 512, NULL, &status);
@@ -510,6 +562,7 @@ Language Language::FromLanguageTag(const std::string& tag)
 
     if (!variant.empty())
         lang.m_code += "@" + variant;
+    lang.m_wcode.assign(lang.m_code.begin(), lang.m_code.end());
 
     lang.m_direction = DoIsRTL(lang) ? TextDirection::RTL : TextDirection::LTR;
 
@@ -576,20 +629,26 @@ unsigned Language::nplurals() const
 
 wxString Language::DisplayName() const
 {
-    return GetDisplayNameOrLanguage<wxString>(m_icuLocale.c_str(), nullptr);
+    static LookupCache<std::string, std::wstring> cache;
+    return cache.Get(m_icuLocale, [=]{ return GetDisplayNameOrLanguage<std::wstring>(m_icuLocale.c_str(), nullptr); });
 }
 
 wxString Language::LanguageDisplayName() const
 {
-    UErrorCode err = U_ZERO_ERROR;
-    UChar buf[512] = {0};
-    uloc_getDisplayLanguage(m_icuLocale.c_str(), nullptr, buf, std::size(buf), &err);
-    return str::to_wx(buf);
+    static LookupCache<std::string, std::wstring> cache;
+    return cache.Get(m_icuLocale, [=]
+    {
+        UErrorCode err = U_ZERO_ERROR;
+        UChar buf[512] = {0};
+        uloc_getDisplayLanguage(m_icuLocale.c_str(), nullptr, buf, std::size(buf), &err);
+        return str::to_wstring(buf);
+    });
 }
 
 wxString Language::DisplayNameInItself() const
 {
-    auto name = GetDisplayNameOrLanguage<wxString>(m_icuLocale.c_str(), m_icuLocale.c_str());
+    static LookupCache<std::string, std::wstring> cache;
+    wxString name = cache.Get(m_icuLocale, [=]{ return GetDisplayNameOrLanguage<std::wstring>(m_icuLocale.c_str(), m_icuLocale.c_str()); });
     if (!name.empty())
         return name;
 
@@ -622,6 +681,13 @@ const std::vector<std::wstring>& Language::AllFormattedNames()
 }
 
 
+void Language::PreloadNames()
+{
+    // The data are built the first time they are needed and callers wait for it:
+    GetDisplayNamesData();
+}
+
+
 Language Language::TryGuessFromFilename(const wxString& filename, wxString *wildcard)
 {
     if (wildcard)
@@ -815,11 +881,9 @@ std::shared_ptr<PluralFormsCalculator> PluralFormsExpr::calc() const
     if (!m_expr.empty())
     {
         // There's typically only a few expressions used at runtime. Cache them to
-        // avoid unnecessary re-creation.
-        static std::unordered_map<std::string, std::shared_ptr<PluralFormsCalculator>> cache;
-        static std::mutex cacheMutex;
-
-        std::lock_guard<std::mutex> lock(cacheMutex);
+        // avoid unnecessary re-creation. The cache is per-thread so that no locking
+        // is needed; creating the calculator again in another thread is cheap.
+        static thread_local std::unordered_map<std::string, std::shared_ptr<PluralFormsCalculator>> cache;
 
         auto it = cache.find(m_expr);
         if (it != cache.end())
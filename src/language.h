@@ -53,7 +53,7 @@ public:
     explicit operator bool() const { return IsValid(); }
 
     const std::string& Code() const { return m_code; }
-    std::wstring WCode() const { return std::wstring(m_code.begin(), m_code.end()); }
+    const std::wstring& WCode() const { return m_wcode; }
 
     /// Returns language part (cs)
     std::string Lang() const;
@@ -97,6 +97,15 @@ public:
      */
     static const std::vector<std::wstring>& AllFormattedNames();
 
+    /**
+        Builds the (slow to construct) lists of language names used by
+        AllFormattedNames() and TryParse().
+
+        Meant to be called on a background thread ahead of time, so that
+        UI code doesn't have to wait for the lists later.
+     */
+    static void PreloadNames();
+
     /**
         Return appropriate plural form for this language.
 
@@ -202,8 +211,13 @@ private:
     Language(const std::wstring& code) { Init(std::string(code.begin(), code.end())); }
     void Init(const std::string& code);
 
+    // uncached implementations of TryParse() and FromLanguageTag()
+    static Language DoTryParse(const std::wstring& s);
+    static Language DoFromLanguageTag(const std::string& tag);
+
 private:
     std::string m_code;
+    std::wstring m_wcode;
     std::string m_tag;
     std::string m_icuLocale;
     TextDirection m_direction;
@@ -30,7 +30,7 @@
 #include "configuration.h"
 #include "errors.h"
 #include "http_client.h"
-#include "keychain/keytar.h"
+#include "keychain_cache.h"
 #include "str_helpers.h"
 
 #include <chrono>
@@ -275,7 +275,7 @@ dispatch::future<LocalazyClient::ProjectInfo> LocalazyClient::ExchangeTemporaryT
 
                std::lock_guard<std::mutex> guard(m_mutex);
                m_metadata->add(projectId, project, user);
-               m_tokens->add(projectId, token);
+               Tokens(guard).add(projectId, token);
                SaveMetadataAndTokens(guard);
 
                return prjInfo;
@@ -289,10 +289,23 @@ void LocalazyClient::InitMetadataAndTokens()
 
     m_metadata.reset(new metadata(Config::LocalazyMetadata()));
 
+    // Tokens are only needed if there are any projects, read them from the
+    // keychain in the background so that they're ready when first used:
+    if (m_metadata->is_valid())
+        KeychainCache::Get().Preload("Localazy");
+}
+
+
+LocalazyClient::project_tokens& LocalazyClient::Tokens(std::lock_guard<std::mutex>& /*acquiredLock - just to make sure caller holds it*/) const
+{
+    if (m_tokens)
+        return *m_tokens;
+
     // Our tokens stored in keychain have the form of <version>:<token>, so not
-    // only do we have to check for token's existence but also that its version is current:
-    std::string encoded_tokens;
-    if (keytar::GetPassword("Localazy", "", &encoded_tokens) && encoded_tokens.substr(0, 2) == "1:")
+    // only do we have to check for token's existence but also that its version is current.
+    // This only waits if preloading in InitMetadataAndTokens() didn't finish yet.
+    std::string encoded_tokens = KeychainCache::Get().GetPassword("Localazy").get();
+    if (encoded_tokens.substr(0, 2) == "1:")
     {
         encoded_tokens = encoded_tokens.substr(2);
     }
@@ -303,25 +316,24 @@ void LocalazyClient::InitMetadataAndTokens()
     }
 
     m_tokens.reset(new project_tokens(encoded_tokens));
+    return *m_tokens;
 }
 
 
-void LocalazyClient::SaveMetadataAndTokens(std::lock_guard<std::mutex>& /*acquiredLock - just to make sure caller holds it*/)
+void LocalazyClient::SaveMetadataAndTokens(std::lock_guard<std::mutex>& acquiredLock)
 {
     Config::LocalazyMetadata(m_metadata->to_string());
 
-    auto encoded_tokens = m_tokens->to_string();
-    if (encoded_tokens.empty())
-        keytar::DeletePassword("Localazy", "");
-    else
-        keytar::AddPassword("Localazy", "", "1:" + encoded_tokens);
+    // written to the keychain in the background:
+    auto encoded_tokens = Tokens(acquiredLock).to_string();
+    KeychainCache::Get().SetPassword("Localazy", "", encoded_tokens.empty() ? std::string() : "1:" + encoded_tokens);
 }
 
 
 std::string LocalazyClient::GetAuthorization(const std::string& project_id) const
 {
     std::lock_guard<std::mutex> guard(m_mutex);
-    return "Bearer " + m_tokens->get(project_id);
+    return "Bearer " + Tokens(guard).get(project_id);
 }
 
 
@@ -447,7 +459,7 @@ dispatch::future<void> LocalazyClient::DownloadFile(const std::wstring& output_f
 }
 
 
-dispatch::future<void> LocalazyClient::UploadFile(const std::string& file_buffer, std::shared_ptr<FileSyncMetadata> meta_)
+dispatch::future<void> LocalazyClient::UploadFile(std::string file_buffer, std::shared_ptr<FileSyncMetadata> meta_)
 {
     class upload_json_data : public octet_stream_data
     {
@@ -461,7 +473,7 @@ dispatch::future<void> LocalazyClient::UploadFile(const std::string& file_buffer
     std::string prefix("/projects/" + meta->projectId + "/exchange");
     http_client::headers headers {{"Authorization", GetAuthorization(meta->projectId)}};
 
-    return m_api->post(prefix + "/import", upload_json_data(file_buffer), headers)
+    return m_api->post(prefix + "/import", upload_json_data(std::move(file_buffer)), headers)
         .then([this,prefix,headers] (json r) {
             auto ok = r.at("result").get<bool>();
             if (!ok)
@@ -490,7 +502,7 @@ dispatch::future<void> LocalazyClient::UploadFile(const std::string& file_buffer
 bool LocalazyClient::IsSignedIn() const
 {
     std::lock_guard<std::mutex> guard(m_mutex);
-    return m_tokens->is_valid() && m_metadata->is_valid();
+    return m_metadata->is_valid() && Tokens(guard).is_valid();
 }
 
 
@@ -499,7 +511,7 @@ void LocalazyClient::SignOut()
     std::lock_guard<std::mutex> guard(m_mutex);
 
     m_metadata->clear();
-    m_tokens->clear();
+    m_tokens.reset(new project_tokens(std::string()));
     SaveMetadataAndTokens(guard);
 }
 
@@ -97,7 +97,7 @@ public:
 
     dispatch::future<void> DownloadFile(const std::wstring& output_file, std::shared_ptr<FileSyncMetadata> meta) override;
 
-    dispatch::future<void> UploadFile(const std::string& file_buffer, std::shared_ptr<FileSyncMetadata> meta) override;
+    dispatch::future<void> UploadFile(std::string file_buffer, std::shared_ptr<FileSyncMetadata> meta) override;
 
 private:
     /**
@@ -127,8 +127,10 @@ private:
     void InitMetadataAndTokens();
     // can only be called if m_mutex is held:
     void SaveMetadataAndTokens(std::lock_guard<std::mutex>& acquiredLock);
+    // can only be called if m_mutex is held; loads tokens from keychain on first use:
+    project_tokens& Tokens(std::lock_guard<std::mutex>& acquiredLock) const;
 
-    std::unique_ptr<project_tokens> m_tokens;
+    mutable std::unique_ptr<project_tokens> m_tokens;
     std::unique_ptr<metadata> m_metadata;
     mutable std::mutex m_mutex; // guards m_tokens and m_metadata
 
@@ -48,21 +48,35 @@
 #include <wx/iconbndl.h>
 #include <wx/windowptr.h>
 #include <wx/sizer.h>
+#include <wx/filename.h>
 
 #include "catalog.h"
+#include "catalog_cache.h"
 #include "cat_update.h"
+#include "concurrency.h"
+#include "configuration.h"
 #include "edapp.h"
 #include "edframe.h"
 #include "hidpi.h"
 #include "menus.h"
 #include "layout_helpers.h"
+#include "pretranslate.h"
 #include "progress_ui.h"
+#include "str_helpers.h"
 #include "utility.h"
 
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <unordered_map>
+
 
 namespace
 {
 
+// Maximum number of catalogs pre-translated together by "Pre-translate all"
+const size_t PRETRANSLATE_PROJECT_GROUP_SIZE = 16;
+
 class PseudoToolbarButton : public wxButton
 {
 public:
@@ -72,6 +86,8 @@ public:
         (void)label;
         if (bitmap == "poedit-update")
             bitmap = "UpdateTemplate";
+        else if (bitmap == "poedit-pretranslate")
+            bitmap = "PreTranslateTemplate";
         else if (bitmap == "stats")
             bitmap = "StatsTemplate";
         wxButton::Create(parent, wxID_ANY, "", wxDefaultPosition, wxSize(35, 28), wxBU_EXACTFIT);
@@ -191,6 +207,9 @@ ManagerFrame::ManagerFrame() :
     auto btn_update = new PseudoToolbarButton(m_details, "poedit-update", _("Update all"));
     btn_update->SetToolTip(_("Update all catalogs in the project"));
     topbar->Add(btn_update, wxSizerFlags().Border(wxLEFT, PX(5)));
+    auto btn_pretranslate = new PseudoToolbarButton(m_details, "poedit-pretranslate", _("Pre-translate all"));
+    btn_pretranslate->SetToolTip(_("Pre-translate all catalogs in the project"));
+    topbar->Add(btn_pretranslate, wxSizerFlags().Border(wxLEFT, PX(5)));
 
     m_listCat = new wxListCtrl(m_details, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxBORDER_NONE | wxLC_REPORT | wxLC_SINGLE_SEL);
 #ifdef __WXOSX__
@@ -216,6 +235,7 @@ ManagerFrame::ManagerFrame() :
 #ifdef __WXMSW__
         SetBackgroundColour(col);
         btn_update->SetBackgroundColour(col);
+        btn_pretranslate->SetBackgroundColour(col);
 #endif
     });
 
@@ -238,6 +258,7 @@ ManagerFrame::ManagerFrame() :
     btn_delete->Bind(wxEVT_UPDATE_UI, [=](wxUpdateUIEvent& e) { e.Enable(m_listPrj->GetSelection() != wxNOT_FOUND); });
     btn_edit->Bind(wxEVT_BUTTON, &ManagerFrame::OnEditProject, this);
     btn_update->Bind(wxEVT_BUTTON, &ManagerFrame::OnUpdateProject, this);
+    btn_pretranslate->Bind(wxEVT_BUTTON, &ManagerFrame::OnPreTranslateProject, this);
 }
 
 
@@ -287,60 +308,38 @@ void ManagerFrame::UpdateListPrj(int select)
 }
 
 
-static void AddCatalogToList(wxListCtrl *list, int i, int id, const wxString& file)
+// returns false if the catalog couldn't be loaded, with error description in @a info
+static bool GetCatalogInfo(const wxString& file, CatalogCache::Info& info)
 {
-    wxConfigBase *cfg = wxConfig::Get();
-    int all = 0, fuzzy = 0, untranslated = 0, badtokens = 0;
-    wxString lastmodified;
-    time_t modtime;
-    wxString key;
-    wxString file2(file);
-    file2.Replace("/", "_");
-    file2.Replace("\\", "_");
-    // FIXME: move cache to cache file and out of *config* file!
-    key.Printf("Manager/project_%i/FilesCache/%s/", id, file2.c_str());
-
-    modtime = cfg->Read(key + "timestamp", (long)0);
+    // suppress error messages, we don't care about specifics of the error
+    // FIXME: *do* indicate error somehow
+    wxLogNull nullLog;
 
-    if (modtime == wxFileModificationTime(file))
+    // FIXME: don't re-load the catalog if it's already loaded in the
+    //        editor, reuse loaded instance
+    try
     {
-        all = (int)cfg->Read(key + "all", (long)0);
-        fuzzy = (int)cfg->Read(key + "fuzzy", (long)0);
-        badtokens = (int)cfg->Read(key + "badtokens", (long)0);
-        untranslated = (int)cfg->Read(key + "untranslated", (long)0);
-        lastmodified = cfg->Read(key + "lastmodified", "?");
+        info = CatalogCache::Get().GetInfo(file);
+        return true;
     }
-    else
+    catch (...)
     {
-        // suppress error messages, we don't care about specifics of the error
-        // FIXME: *do* indicate error somehow
-        wxLogNull nullLog;
-
-        // FIXME: don't re-load the catalog if it's already loaded in the
-        //        editor, reuse loaded instance
-        try
-        {
-            auto cat = Catalog::Create(file);
-            if (cat)
-            {
-                cat->GetStatistics(&all, &fuzzy, &badtokens, &untranslated, NULL);
-                modtime = wxFileModificationTime(file);
-                lastmodified = cat->Header().RevisionDate;
-                cfg->Write(key + "timestamp", (long)modtime);
-                cfg->Write(key + "all", (long)all);
-                cfg->Write(key + "fuzzy", (long)fuzzy);
-                cfg->Write(key + "badtokens", (long)badtokens);
-                cfg->Write(key + "untranslated", (long)untranslated);
-                cfg->Write(key + "lastmodified", lastmodified);
-            }
-        }
-        catch (...)
-        {
-            // FIXME: Nicer way of showing errors, this is hacky
-            lastmodified = L"⚠️ " + DescribeCurrentException();
-            badtokens = 1;
-        }
+        // FIXME: Nicer way of showing errors, this is hacky
+        info = CatalogCache::Info();
+        info.revisionDate = L"⚠️ " + DescribeCurrentException();
+        info.badtokens = 1;
+        return false;
     }
+}
+
+
+static void SetCatalogInfoInList(wxListCtrl *list, int i, const CatalogCache::Info& info)
+{
+    const int all = info.all;
+    const int fuzzy = info.fuzzy;
+    const int badtokens = info.badtokens;
+    const int untranslated = info.untranslated;
+    const wxString& lastmodified = info.revisionDate;
 
     int icon;
     if (fuzzy+untranslated+badtokens == 0) icon = 2;
@@ -348,9 +347,7 @@ static void AddCatalogToList(wxListCtrl *list, int i, int id, const wxString& fi
     else icon = 1;
 
     wxString tmp;
-    // FIXME: don't put full filename there, remove common prefix (of all
-    //        directories in project's settings)
-    list->InsertItem(i, file, icon);
+    list->SetItemImage(i, icon);
     tmp.Printf("%i", all);
     list->SetItem(i, 1, tmp);
     tmp.Printf("%i", untranslated);
@@ -359,32 +356,226 @@ static void AddCatalogToList(wxListCtrl *list, int i, int id, const wxString& fi
     list->SetItem(i, 3, tmp);
     tmp.Printf("%i", badtokens);
     list->SetItem(i, 4, tmp);
-    list->SetItem(i, 5, lastmodified);
+    tmp.Printf("%i", info.sourceWords);
+    list->SetItem(i, 5, tmp);
+    tmp.Printf("%i", info.unfinishedWords);
+    list->SetItem(i, 6, tmp);
+    list->SetItem(i, 7, lastmodified);
 }
 
-void ManagerFrame::UpdateListCat(int id)
+namespace
 {
-    wxBusyCursor bcur;
 
-    if (id == -1) id = m_curPrj;
+// Increment whenever the index's layout or meaning of its data changes
+const uint32_t PROJECT_INDEX_VERSION = 1;
 
-    m_details->Show();
-    m_projectName->SetLabel(m_listPrj->GetStringSelection());
-    m_details->Layout();
+const char PROJECT_INDEX_MAGIC[8] = { 'P', 'o', 'e', 'd', 'P', 'r', 'j', '\0' };
 
-    wxConfigBase *cfg = wxConfig::Get();
-    wxString key;
-    key.Printf("Manager/project_%i/", id);
+// The index file starts with the header, followed by UTF-8 project's dirs,
+// array of records and the strings they refer to. Like CatalogCache's, it is
+// local to the machine, so native byte order and layout can be used.
+struct IndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint32_t dirsLength;
+    uint32_t stringsLength;
+};
 
-    wxString dirs = cfg->Read(key + "Dirs", wxEmptyString);
-    wxStringTokenizer tkn(dirs, wxPATH_SEP);
+struct IndexRecord
+{
+    enum { Flag_HasKey = 1 };
+
+    uint64_t pathHash;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t contentHash;
+    uint32_t flags;
+    // path, revision date and language, stored consecutively in strings:
+    uint32_t stringsOffset;
+    uint32_t pathLength, revisionDateLength, languageLength;
+    int32_t all, fuzzy, badtokens, untranslated, unfinished;
+    int32_t sourceWords, unfinishedWords;
+};
 
-    m_catalogs.Clear();
-    while (tkn.HasMoreTokens())
-        wxDir::GetAllFiles(tkn.GetNextToken(), &m_catalogs,
-                           "*.po", wxDIR_FILES | wxDIR_DIRS);
+uint64_t HashPath(const std::string& path)
+{
+    return HashFNV1a(path.data(), path.size());
+}
+
+// Last known catalogs of a project and their summaries, for showing them
+// immediately when the project is opened again
+struct ProjectIndex
+{
+    wxArrayString files;
+    std::vector<CatalogCache::Info> infos;
+    // version of the file that infos are valid for, unset if it couldn't be loaded
+    std::vector<std::optional<CatalogCache::Key>> keys;
+
+    // returns index of @a file or -1
+    int Find(const std::string& file) const
+    {
+        auto i = m_lookup.find(HashPath(file));
+        if (i == m_lookup.end() || str::to_utf8(files[i->second]) != file)
+            return -1;
+        return (int)i->second;
+    }
 
-    m_catalogs.Sort();
+    void Add(const wxString& file, const CatalogCache::Info& info, const std::optional<CatalogCache::Key>& key, uint64_t pathHash)
+    {
+        m_lookup.emplace(pathHash, files.size());
+        files.push_back(file);
+        infos.push_back(info);
+        keys.push_back(key);
+    }
+
+private:
+    std::unordered_map<uint64_t, size_t> m_lookup;
+};
+
+wxString GetProjectIndexFile(const wxString& dirs, const char *ext = "bin")
+{
+    const auto key = str::to_utf8(dirs);
+    return PoeditApp::GetCacheDir("Projects") + wxFILE_SEP_PATH +
+           wxString::Format("%016llx.%s", (unsigned long long)HashFNV1a(key.data(), key.size()), ext);
+}
+
+bool ReadProjectIndex(const wxString& dirs, ProjectIndex& index)
+{
+    const auto filename = GetProjectIndexFile(dirs);
+    if (!wxFileName::FileExists(filename))
+        return false;
+
+    MappedFile data(filename);
+    if (!data.IsOk() || data.size() < sizeof(IndexHeader))
+        return false;
+
+    IndexHeader h;
+    memcpy(&h, data.data(), sizeof(h));
+    if (memcmp(h.magic, PROJECT_INDEX_MAGIC, sizeof(PROJECT_INDEX_MAGIC)) != 0 || h.version != PROJECT_INDEX_VERSION)
+        return false;
+    if (data.size() != sizeof(IndexHeader) + h.dirsLength + (size_t)h.count * sizeof(IndexRecord) + h.stringsLength)
+        return false;
+
+    const char *ptr = data.data() + sizeof(IndexHeader);
+    if (std::string(ptr, h.dirsLength) != str::to_utf8(dirs))
+        return false;
+    ptr += h.dirsLength;
+
+    const char *strings = ptr + (size_t)h.count * sizeof(IndexRecord);
+    for (uint32_t n = 0; n < h.count; n++, ptr += sizeof(IndexRecord))
+    {
+        IndexRecord r;
+        memcpy(&r, ptr, sizeof(r));
+        if ((uint64_t)r.stringsOffset + r.pathLength + r.revisionDateLength + r.languageLength > h.stringsLength)
+            return false;
+
+        const char *s = strings + r.stringsOffset;
+        CatalogCache::Info info;
+        info.all = r.all;
+        info.fuzzy = r.fuzzy;
+        info.badtokens = r.badtokens;
+        info.untranslated = r.untranslated;
+        info.unfinished = r.unfinished;
+        info.sourceWords = r.sourceWords;
+        info.unfinishedWords = r.unfinishedWords;
+        info.revisionDate = str::to_wx(std::string(s + r.pathLength, r.revisionDateLength));
+        info.language.assign(s + r.pathLength + r.revisionDateLength, r.languageLength);
+
+        std::optional<CatalogCache::Key> key;
+        if (r.flags & IndexRecord::Flag_HasKey)
+        {
+            key.emplace();
+            key->size = r.size;
+            key->mtime = r.mtime;
+            key->contentHash = r.contentHash;
+        }
+
+        index.Add(str::to_wx(std::string(s, r.pathLength)), info, key, r.pathHash);
+    }
+    return true;
+}
+
+void WriteProjectIndex(const wxString& dirs, const ProjectIndex& index)
+{
+    // failing to write the index is not an error worth reporting
+    wxLogNull null;
+
+    auto dir = PoeditApp::GetCacheDir("Projects");
+    if (!wxFileName::DirExists(dir) && !wxFileName::Mkdir(dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+        return;
+
+    const auto dirsUtf8 = str::to_utf8(dirs);
+
+    std::vector<IndexRecord> records(index.files.size());
+    std::string strings;
+    for (size_t n = 0; n < index.files.size(); n++)
+    {
+        auto& info = index.infos[n];
+        const auto path = str::to_utf8(index.files[n]);
+        const auto revisionDate = str::to_utf8(info.revisionDate);
+
+        IndexRecord& r = records[n];
+        memset(&r, 0, sizeof(r));
+        r.pathHash = HashPath(path);
+        if (auto& key = index.keys[n])
+        {
+            r.flags |= IndexRecord::Flag_HasKey;
+            r.size = key->size;
+            r.mtime = key->mtime;
+            r.contentHash = key->contentHash;
+        }
+        r.stringsOffset = (uint32_t)strings.size();
+        r.pathLength = (uint32_t)path.size();
+        r.revisionDateLength = (uint32_t)revisionDate.size();
+        r.languageLength = (uint32_t)info.language.size();
+        r.all = info.all;
+        r.fuzzy = info.fuzzy;
+        r.badtokens = info.badtokens;
+        r.untranslated = info.untranslated;
+        r.unfinished = info.unfinished;
+        r.sourceWords = info.sourceWords;
+        r.unfinishedWords = info.unfinishedWords;
+
+        strings += path;
+        strings += revisionDate;
+        strings += info.language;
+    }
+
+    IndexHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PROJECT_INDEX_MAGIC, sizeof(PROJECT_INDEX_MAGIC));
+    h.version = PROJECT_INDEX_VERSION;
+    h.count = (uint32_t)records.size();
+    h.dirsLength = (uint32_t)dirsUtf8.size();
+    h.stringsLength = (uint32_t)strings.size();
+
+    const auto filename = GetProjectIndexFile(dirs);
+    TempOutputFileFor tempfile(filename);
+    {
+        std::ofstream f(tempfile.FileName().fn_str(), std::ios::binary);
+        f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        f.write(dirsUtf8.data(), dirsUtf8.size());
+        f.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(IndexRecord));
+        f.write(strings.data(), strings.size());
+        if (!f)
+            return;
+    }
+    tempfile.Commit();
+
+    // remove index written by older versions, if any:
+    const auto oldFilename = GetProjectIndexFile(dirs, "json");
+    if (wxFileName::FileExists(oldFilename))
+        wxRemoveFile(oldFilename);
+}
+
+} // anonymous namespace
+
+
+void ManagerFrame::SetCatalogsInList(const wxArrayString& files)
+{
+    m_catalogs = files;
 
     m_listCat->Freeze();
 
@@ -394,23 +585,113 @@ void ManagerFrame::UpdateListCat(int id)
     m_listCat->InsertColumn(2, _("Untrans"));
     m_listCat->InsertColumn(3, wxGETTEXT_IN_CONTEXT("column/row header", "Needs Work"));
     m_listCat->InsertColumn(4, _("Errors"));
-    m_listCat->InsertColumn(5, _("Last modified"));
+    m_listCat->InsertColumn(5, _("Words"));
+    m_listCat->InsertColumn(6, _("Words Left"));
+    m_listCat->InsertColumn(7, _("Last modified"));
 
-    // FIXME: this is time-consuming, it should be done in parallel on
-    //        multi-core/SMP systems
+    // FIXME: don't put full filename there, remove common prefix (of all
+    //        directories in project's settings)
     for (int i = 0; i < (int)m_catalogs.GetCount(); i++)
-        AddCatalogToList(m_listCat, i, id, m_catalogs[i]);
+        m_listCat->InsertItem(i, m_catalogs[i], -1);
 
     m_listCat->SetColumnWidth(0, wxLIST_AUTOSIZE);
-    m_listCat->SetColumnWidth(1, wxLIST_AUTOSIZE_USEHEADER);
-    m_listCat->SetColumnWidth(2, wxLIST_AUTOSIZE_USEHEADER);
-    m_listCat->SetColumnWidth(3, wxLIST_AUTOSIZE_USEHEADER);
-    m_listCat->SetColumnWidth(4, wxLIST_AUTOSIZE_USEHEADER);
-    m_listCat->SetColumnWidth(5, wxLIST_AUTOSIZE);
+    for (int col = 1; col <= 7; col++)
+        m_listCat->SetColumnWidth(col, wxLIST_AUTOSIZE_USEHEADER);
 
     m_listCat->Thaw();
 }
 
+void ManagerFrame::SetCatalogInfosInList(const std::vector<CatalogCache::Info>& infos)
+{
+    m_listCat->Freeze();
+    for (int i = 0; i < (int)infos.size(); i++)
+        SetCatalogInfoInList(m_listCat, i, infos[i]);
+    for (int col = 1; col <= 6; col++)
+        m_listCat->SetColumnWidth(col, wxLIST_AUTOSIZE_USEHEADER);
+    m_listCat->SetColumnWidth(7, wxLIST_AUTOSIZE);
+    m_listCat->Thaw();
+}
+
+void ManagerFrame::UpdateListCat(int id)
+{
+    if (id == -1) id = m_curPrj;
+
+    m_details->Show();
+    m_projectName->SetLabel(m_listPrj->GetStringSelection());
+    m_details->Layout();
+
+    wxConfigBase *cfg = wxConfig::Get();
+    wxString key;
+    key.Printf("Manager/project_%i/", id);
+
+    const wxString dirs = cfg->Read(key + "Dirs", wxEmptyString);
+
+    // Show the state from the last time right away, scanning directories and
+    // loading catalogs may take a long time for large projects:
+    ProjectIndex last;
+    if (ReadProjectIndex(dirs, last))
+    {
+        SetCatalogsInList(last.files);
+        SetCatalogInfosInList(last.infos);
+    }
+    else
+    {
+        last = ProjectIndex(); // may be partially read
+        SetCatalogsInList(wxArrayString());
+    }
+
+    // Then refresh it in the background. Catalogs that didn't change since
+    // they were last seen are taken from the index, others from CatalogCache
+    // or loaded again:
+    const int generation = ++m_listCatGeneration;
+    dispatch::async([dirs, last{std::move(last)}]
+    {
+        wxArrayString files;
+        wxStringTokenizer tkn(dirs, wxPATH_SEP);
+        while (tkn.HasMoreTokens())
+            wxDir::GetAllFiles(tkn.GetNextToken(), &files,
+                               "*.po", wxDIR_FILES | wxDIR_DIRS);
+        files.Sort();
+
+        std::vector<CatalogCache::Info> infos(files.GetCount());
+        std::vector<std::optional<CatalogCache::Key>> keys(files.GetCount());
+        dispatch::parallel_for(infos.size(), [&](size_t i)
+        {
+            CatalogCache::Key key;
+            const bool hasKey = CatalogCache::ComputeKey(files[i], key);
+            if (hasKey)
+            {
+                int n = last.Find(str::to_utf8(files[i]));
+                if (n != -1 && last.keys[n] && *last.keys[n] == key)
+                {
+                    infos[i] = last.infos[n];
+                    keys[i] = key;
+                    return;
+                }
+            }
+
+            if (GetCatalogInfo(files[i], infos[i]) && hasKey)
+                keys[i] = key;
+        });
+
+        ProjectIndex index;
+        for (size_t i = 0; i < infos.size(); i++)
+            index.Add(files[i], infos[i], keys[i], HashPath(str::to_utf8(files[i])));
+
+        WriteProjectIndex(dirs, index);
+        return index;
+    })
+    .then_on_window(this, [=](ProjectIndex index)
+    {
+        if (generation != m_listCatGeneration)
+            return;
+
+        if (index.files != m_catalogs)
+            SetCatalogsInList(index.files);
+        SetCatalogInfosInList(index.infos);
+    });
+}
+
 
 class ProjectDlg : public StandardDialog
 {
@@ -504,6 +785,7 @@ void ManagerFrame::DeleteProject(int id)
 
     if (id == m_curPrj)
     {
+        m_listCatGeneration++;
         m_listCat->ClearAll();
         m_curPrj = -1;
     }
@@ -607,25 +889,160 @@ void ManagerFrame::OnUpdateProject(wxCommandEvent&)
         wxWindowPtr<ProgressWindow> progress(new ProgressWindow(this, _("Updating project catalogs"), cancellation));
         progress->RunTaskThenDo([=]()
         {
-            Progress progress((int)m_catalogs.GetCount());
-
-            for (size_t i = 0; i < m_catalogs.GetCount(); i++)
+            const wxArrayString files(m_catalogs);
+            Progress progress((int)files.GetCount());
+
+            // Every catalog is loaded, updated, saved (which compiles the MO
+            // file too) and released by a single worker, so that only as many
+            // catalogs as there are workers are kept in memory at a time:
+            std::vector<std::exception_ptr> errors(files.GetCount());
+            auto updateCatalog = [&](size_t i)
             {
                 if (cancellation->is_cancelled())
                     return;
 
-                wxString f = m_catalogs[i];
+                const wxString& f = files[i];
+
+                Progress subtask(1, progress, 1);
+                subtask.message(wxFileName(f).GetFullName());
+
+                try
+                {
+                    auto cat = POCatalog::Create(f);
+                    if (auto merged = PerformUpdateFromSourcesSimple(cat))
+                    {
+                        Catalog::ValidationResults validation_results;
+                        Catalog::CompilationStatus mo_status;
+                        if (merged.updated_catalog->Save(f, true, validation_results, mo_status))
+                            CatalogCache::Get().Update(f, *merged.updated_catalog);
+                    }
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception();
+                }
+            };
+
+            // Catalogs in a project usually share source code, so update the
+            // first one alone to populate the extraction cache for the rest:
+            if (!files.empty())
+                updateCatalog(0);
+            if (files.GetCount() > 1)
+                dispatch::parallel_for(files.GetCount() - 1, [&](size_t i){ updateCatalog(i + 1); });
+
+            for (auto& e: errors)
+            {
+                if (e)
+                    std::rethrow_exception(e);
+            }
+        },
+        [=]()
+        {
+            UpdateListCat();
+        });
+    });
+}
+
+
+void ManagerFrame::OnPreTranslateProject(wxCommandEvent&)
+{
+    int sel = m_listPrj->GetSelection();
+    if (sel == -1) return;
+
+    wxWindowPtr<wxMessageDialog> dlg(new wxMessageDialog(this, _("Pre-translate all catalogs in this project?"), MSW_OR_OTHER(_("Confirmation"), ""), wxYES_NO | wxICON_QUESTION));
+    dlg->SetExtendedMessage(_("Fills in translations of untranslated strings in all files in the project from the translation memory, using the same settings as the last pre-translation."));
+    dlg->ShowWindowModalThenDo([this,dlg](int retval)
+    {
+         if (retval != wxID_YES)
+            return;
+
+        PretranslateSettings settings = Config::PretranslateSettings();
+        PreTranslateOptions options;
+        if (settings.onlyExact)
+            options.flags |= PreTranslate_OnlyExact;
+        if (settings.exactNotFuzzy)
+            options.flags |= PreTranslate_ExactNotFuzzy;
+
+        auto cancellation = std::make_shared<dispatch::cancellation_token>();
+        wxWindowPtr<ProgressWindow> progress(new ProgressWindow(this, _(L"Pre-translating…"), cancellation));
+        progress->RunTaskThenDo([=]() -> BackgroundTaskResult
+        {
+            const wxArrayString files(m_catalogs);
+            const size_t groupsCount = (files.size() + PRETRANSLATE_PROJECT_GROUP_SIZE - 1) / PRETRANSLATE_PROJECT_GROUP_SIZE;
+            Progress progress((int)groupsCount);
+
+            // All languages are pre-translated together, so that every string
+            // is looked up only once, but in groups of files, so that only a
+            // bounded number of catalogs is kept in memory at a time:
+            std::vector<std::exception_ptr> errors(files.size());
+            int total = 0;
+            for (size_t first = 0; first < files.size(); first += PRETRANSLATE_PROJECT_GROUP_SIZE)
+            {
+                if (cancellation->is_cancelled())
+                    break;
 
                 Progress subtask(1, progress, 1);
+                const size_t count = std::min(files.size() - first, PRETRANSLATE_PROJECT_GROUP_SIZE);
 
-                auto cat = POCatalog::Create(f);
-                if (auto merged = PerformUpdateFromSourcesSimple(cat))
+                std::vector<CatalogPtr> catalogs(count);
+                dispatch::parallel_for(count, [&](size_t i)
+                {
+                    try
+                    {
+                        catalogs[i] = POCatalog::Create(files[first + i]);
+                    }
+                    catch (...)
+                    {
+                        errors[first + i] = std::current_exception();
+                    }
+                });
+
+                std::vector<CatalogPtr> loaded;
+                std::vector<size_t> loadedIndexes;
+                for (size_t i = 0; i < count; i++)
                 {
-                    Catalog::ValidationResults validation_results;
-                    Catalog::CompilationStatus mo_status;
-                    merged.updated_catalog->Save(f, false, validation_results, mo_status);
+                    if (catalogs[i])
+                    {
+                        loaded.push_back(catalogs[i]);
+                        loadedIndexes.push_back(first + i);
+                    }
                 }
-             }
+
+                auto matched = PreTranslateCatalogsSimple(loaded, options, cancellation);
+
+                dispatch::parallel_for(loaded.size(), [&](size_t i)
+                {
+                    if (!matched[i])
+                        return;
+                    const wxString& f = files[loadedIndexes[i]];
+                    try
+                    {
+                        Catalog::ValidationResults validation_results;
+                        Catalog::CompilationStatus mo_status;
+                        if (loaded[i]->Save(f, true, validation_results, mo_status))
+                            CatalogCache::Get().Update(f, *loaded[i]);
+                    }
+                    catch (...)
+                    {
+                        errors[loadedIndexes[i]] = std::current_exception();
+                    }
+                });
+
+                for (auto m: matched)
+                    total += m;
+            }
+
+            for (auto& e: errors)
+            {
+                if (e)
+                    std::rethrow_exception(e);
+            }
+
+            if (!total)
+                return BackgroundTaskResult(_("No entries could be pre-translated."));
+            return BackgroundTaskResult(wxString::Format(wxPLURAL("%d entry was pre-translated.",
+                                                                  "%d entries were pre-translated.",
+                                                                  total), total));
         },
         [=]()
         {
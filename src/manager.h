@@ -31,6 +31,10 @@
 #include <wx/stattext.h>
 #include <wx/string.h>
 
+#include <vector>
+
+#include "catalog_cache.h"
+
 class WXDLLIMPEXP_FWD_CORE wxListBox;
 
 class Catalog;
@@ -79,11 +83,16 @@ class ManagerFrame : public ManagerFrameBase
         void UpdateListPrj(int select = 0);
         /// Updates catalogs list for given project
         void UpdateListCat(int id = -1);
+        /// Puts @a files into the catalogs list, without any details yet
+        void SetCatalogsInList(const wxArrayString& files);
+        /// Shows details of catalogs in the list, in the same order
+        void SetCatalogInfosInList(const std::vector<CatalogCache::Info>& infos);
         
         void OnNewProject(wxCommandEvent& event);
         void OnEditProject(wxCommandEvent& event);
         void OnDeleteProject(wxCommandEvent& event);
         void OnUpdateProject(wxCommandEvent& event);
+        void OnPreTranslateProject(wxCommandEvent& event);
         void OnSelectProject(wxCommandEvent& event);
         void OnOpenCatalog(wxListEvent& event);
 
@@ -92,6 +101,8 @@ class ManagerFrame : public ManagerFrameBase
         wxListBox  *m_listPrj;
         wxStaticText *m_projectName;
         wxArrayString m_catalogs;
+        // incremented with every UpdateListCat(), to ignore outdated background results
+        int m_listCatGeneration = 0;
         int m_curPrj;
 
         static ManagerFrame *ms_instance;
@@ -0,0 +1,434 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "msgfmt_checks.h"
+
+#include "syntaxhighlighter.h"
+
+#include <wx/intl.h>
+
+#include <algorithm>
+#include <cwchar>
+#include <map>
+
+
+namespace
+{
+
+/**
+    Format directives of a string, as msgfmt interprets them.
+
+    Arguments are identified either by their number (1-based, unnamed
+    arguments are numbered in order of use) or by name (python-format's
+    mapping keys). Types are opaque strings that must match.
+ */
+struct FormatSpec
+{
+    bool valid = true;
+    std::map<unsigned, std::wstring> numbered;
+    std::map<std::wstring, std::wstring> named;
+
+    // for c-format: whether explicit argument numbers (%1$s) are used
+    int usesNumbers = -1;
+    unsigned nextArg = 1;
+
+    void AddNumbered(unsigned n, const std::wstring& type)
+    {
+        auto r = numbered.emplace(n, type);
+        if (!r.second && r.first->second != type)
+            valid = false;  // used in incompatible ways
+    }
+
+    void AddNamed(const std::wstring& name, const std::wstring& type)
+    {
+        auto r = named.emplace(name, type);
+        if (!r.second && r.first->second != type)
+            valid = false;
+    }
+
+    void Finish()
+    {
+        // python can't mix mapping and tuple arguments
+        if (!numbered.empty() && !named.empty())
+            valid = false;
+
+        // all arguments must be used, i.e. numbers must not have gaps
+        if (!numbered.empty() && numbered.rbegin()->first != numbered.size())
+            valid = false;
+    }
+};
+
+
+const std::wstring ANY_TYPE = L"*";
+
+inline bool is_digit(wchar_t c) { return c >= '0' && c <= '9'; }
+
+size_t SkipDigits(const std::wstring& d, size_t i)
+{
+    while (i < d.length() && is_digit(d[i]))
+        i++;
+    return i;
+}
+
+
+// Adds c-format directive, as matched by the scanner, to the spec
+void AddCDirective(FormatSpec& spec, const std::wstring& d)
+{
+    if (d == L"%%")
+        return;
+
+    size_t i = 1;
+    unsigned number = 0;
+    size_t j = SkipDigits(d, i);
+    if (j > i && j < d.length() && d[j] == '$')
+    {
+        number = (unsigned)std::wcstoul(d.c_str() + i, nullptr, 10);
+        i = j + 1;
+        if (number == 0)
+            spec.valid = false;
+    }
+
+    // either all directives use argument numbers or none does:
+    const int usesNumbers = number ? 1 : 0;
+    if (spec.usesNumbers != -1 && spec.usesNumbers != usesNumbers)
+        spec.valid = false;
+    spec.usesNumbers = usesNumbers;
+
+    auto addStarArg = [&]
+    {
+        // "*m$" form of width/precision isn't supported by the scanner, so
+        // this is mixing of numbered and unnumbered arguments:
+        if (number)
+            spec.valid = false;
+        else
+            spec.AddNumbered(spec.nextArg++, L"int");
+    };
+
+    while (i < d.length() && std::wcschr(L"-+ #0", d[i]))
+        i++;
+    if (i < d.length() && d[i] == '*')
+    {
+        addStarArg();
+        i++;
+    }
+    else
+    {
+        i = SkipDigits(d, i);
+    }
+    if (i < d.length() && d[i] == '.')
+    {
+        i++;
+        if (i < d.length() && d[i] == '*')
+        {
+            addStarArg();
+            i++;
+        }
+        else
+        {
+            i = SkipDigits(d, i);
+        }
+    }
+
+    std::wstring type;
+    if (i < d.length() && d[i] == '<')
+    {
+        // <PRId64> etc. from <inttypes.h>; only signedness and size matter
+        auto macro = d.substr(i + 1, d.length() - i - 2);
+        if (macro.length() > 3 && macro.starts_with(L"PRI"))
+            type = (std::wcschr(L"di", macro[3]) ? L"i" : L"u") + macro.substr(4);
+        else
+            type = macro;
+    }
+    else
+    {
+        size_t conv = d.length() - 1;
+        auto size = d.substr(i, conv - i);
+        switch (d[conv])
+        {
+            case 'd': case 'i':
+                type = L"i"; break;
+            case 'o': case 'u': case 'x': case 'X':
+                type = L"u"; break;
+            case 'f': case 'F': case 'e': case 'E': case 'a': case 'A': case 'g': case 'G':
+                type = L"f"; break;
+            default:
+                type = d[conv]; break;
+        }
+        type = size + type;
+    }
+
+    spec.AddNumbered(number ? number : spec.nextArg++, type);
+}
+
+
+// Adds python-format directive, as matched by the scanner, to the spec
+void AddPythonDirective(FormatSpec& spec, const std::wstring& d)
+{
+    if (d[0] == '{')
+        return;  // python-brace format is separate from python-format
+
+    size_t i = 1;
+    std::wstring name;
+    if (d[i] == '(')
+    {
+        auto close = d.find(')', i);
+        name = d.substr(i + 1, close - i - 1);
+        i = close + 1;
+    }
+
+    if (i < d.length() && std::wcschr(L"-+ #0", d[i]))
+        i++;
+    for (int part = 0; part < 2; part++)
+    {
+        if (part == 1)
+        {
+            if (i >= d.length() || d[i] != '.')
+                break;
+            i++;
+        }
+        if (i < d.length() && d[i] == '*')
+        {
+            // '*' consumes an unnamed argument, which can't be used with names
+            if (!name.empty())
+                spec.valid = false;
+            spec.AddNumbered(spec.nextArg++, L"i");
+            i++;
+        }
+        else
+        {
+            i = SkipDigits(d, i);
+        }
+    }
+
+    const wchar_t conv = d.back();
+    if (conv == '%')
+        return;
+
+    std::wstring type;
+    if (std::wcschr(L"diouxX", conv))
+        type = L"i";
+    else if (std::wcschr(L"eEfFgG", conv))
+        type = L"f";
+    else if (conv == 'c')
+        type = L"c";
+    else
+        type = ANY_TYPE;  // %s, %r, %a accept anything
+
+    if (name.empty())
+        spec.AddNumbered(spec.nextArg++, type);
+    else
+        spec.AddNamed(name, type);
+}
+
+
+FormatSpec ParseFormat(const std::string& fmt, const wxString& str)
+{
+    FormatSpec spec;
+    auto syntax = SyntaxHighlighter::ForFormat(fmt);
+    if (!syntax)
+        return spec;
+
+    const std::wstring text(str.ToStdWstring());
+    const bool python = (fmt == "python");
+
+    // every '%' must be part of a directive, otherwise the string is invalid
+    size_t covered = 0;
+    syntax->Highlight(text, [&](int a, int b, SyntaxHighlighter::TextKind kind)
+    {
+        if (kind != SyntaxHighlighter::Placeholder)
+            return;
+        if (text.find('%', covered) < (size_t)a)
+            spec.valid = false;
+        covered = std::max(covered, (size_t)b);
+
+        auto d = text.substr(a, b - a);
+        if (python)
+            AddPythonDirective(spec, d);
+        else
+            AddCDirective(spec, d);
+    });
+    if (text.find('%', covered) != std::wstring::npos)
+        spec.valid = false;
+
+    spec.Finish();
+    return spec;
+}
+
+
+template<typename Key, typename Describe>
+wxString CompareArgs(const std::map<Key, std::wstring>& source, const std::map<Key, std::wstring>& translation,
+                     bool strict, Describe describe)
+{
+    for (auto& t: translation)
+    {
+        auto s = source.find(t.first);
+        if (s == source.end())
+        {
+            // TRANSLATORS: %s is format string argument, e.g. "2" or “name”
+            return wxString::Format(_(L"The translation uses format argument %s that isn’t in the source text."), describe(t.first));
+        }
+
+        const bool sameType = s->second == t.second ||
+                              (!strict && (s->second == ANY_TYPE || t.second == ANY_TYPE));
+        if (!sameType)
+        {
+            // TRANSLATORS: %s is format string argument, e.g. "2" or “name”
+            return wxString::Format(_(L"Format argument %s is used differently in the translation than in the source text."), describe(t.first));
+        }
+    }
+
+    if (strict)
+    {
+        for (auto& s: source)
+        {
+            if (translation.find(s.first) == translation.end())
+            {
+                // TRANSLATORS: %s is format string argument, e.g. "2" or “name”
+                return wxString::Format(_(L"Format argument %s is missing from the translation."), describe(s.first));
+            }
+        }
+    }
+
+    return wxString();
+}
+
+} // anonymous namespace
+
+
+MsgfmtChecker::MsgfmtChecker(const PluralFormsExpr& plurals) : m_nplurals(0)
+{
+    if (!plurals)
+        return;
+
+    m_nplurals = plurals.nplurals();
+
+    // Like msgfmt, check plural forms used for only a few values of n
+    // leniently, because e.g. "One file" for n=1 needn't use the argument:
+    std::vector<unsigned> uses(m_nplurals, 0);
+    for (int n = 0; n <= 1000; n++)
+    {
+        unsigned form = plurals.evaluate_for_n(n);
+        if (form < m_nplurals)
+            uses[form]++;
+    }
+    for (auto u: uses)
+        m_oftenUsedForm.push_back(u >= 5);
+}
+
+
+bool MsgfmtChecker::IsFormatSupported(const std::string& fmt)
+{
+    return fmt == "c" || fmt == "python";
+}
+
+
+wxString MsgfmtChecker::Check(const CatalogItemSnapshot& item) const
+{
+    // msgfmt only checks entries that it compiles into MO files:
+    auto& translations = item.GetTranslations();
+    if (item.IsFuzzy() || translations.empty() || translations[0].empty())
+        return wxString();
+
+    const bool plural = item.HasPlural();
+    if (plural && m_nplurals && translations.size() != m_nplurals)
+    {
+        return wxString::Format(_("The entry has %u plural forms, but the Plural-Forms header declares %u."),
+                                (unsigned)translations.size(), m_nplurals);
+    }
+
+    auto& source = item.GetString();
+    if (!source.empty())
+    {
+        const bool startsWithNewline = source[0] == '\n';
+        const bool endsWithNewline = source.Last() == '\n';
+
+        if (plural && !item.GetPluralString().empty())
+        {
+            auto& sourcePlural = item.GetPluralString();
+            if ((sourcePlural[0] == '\n') != startsWithNewline)
+                return _(L"The source text and its plural form don’t both start with a newline.");
+            if ((sourcePlural.Last() == '\n') != endsWithNewline)
+                return _(L"The source text and its plural form don’t both end with a newline.");
+        }
+
+        for (auto& t: translations)
+        {
+            if ((!t.empty() && t[0] == '\n') != startsWithNewline)
+                return _(L"The source text and the translation don’t both start with a newline.");
+            if ((!t.empty() && t.Last() == '\n') != endsWithNewline)
+                return _(L"The source text and the translation don’t both end with a newline.");
+        }
+    }
+
+    auto fmt = item.GetFormatFlag();
+    if (!IsFormatSupported(fmt))
+        return wxString();
+
+    for (size_t i = 0; i < translations.size(); i++)
+    {
+        // msgfmt checks all plural forms against msgid_plural, strictly
+        // unless only msgstr[0] is present or the form is rarely used:
+        bool strict = !plural || translations.size() < 2 || (i < m_oftenUsedForm.size() && m_oftenUsedForm[i]);
+        auto error = CheckFormat(fmt, plural ? item.GetPluralString() : source, translations[i], strict);
+        if (!error.empty())
+            return error;
+    }
+
+    return wxString();
+}
+
+
+wxString MsgfmtChecker::CheckFormat(const std::string& fmt, const wxString& source, const wxString& translation, bool strict) const
+{
+    auto sourceSpec = ParseFormat(fmt, source);
+    // invalid msgid is not something the translator could fix
+    if (!sourceSpec.valid)
+        return wxString();
+
+    auto spec = ParseFormat(fmt, translation);
+    if (!spec.valid)
+    {
+        // TRANSLATORS: %s is programming language name, e.g. "C" or "Python"
+        return wxString::Format(_(L"The translation isn’t a valid %s format string."), fmt == "c" ? "C" : "Python");
+    }
+
+    if (!sourceSpec.named.empty() && !spec.numbered.empty())
+        return _("The translation uses unnamed format arguments, but the source text uses named ones.");
+    if (!sourceSpec.numbered.empty() && !spec.named.empty())
+        return _("The translation uses named format arguments, but the source text uses unnamed ones.");
+
+    // python's unnamed arguments form a tuple, so their count must always match
+    if (fmt == "python" && sourceSpec.numbered.size() != spec.numbered.size())
+        return _("The translation uses a different number of format arguments than the source text.");
+
+    auto error = CompareArgs(sourceSpec.numbered, spec.numbered, strict,
+                             [](unsigned n){ return wxString::Format("%u", n); });
+    if (error.empty())
+    {
+        error = CompareArgs(sourceSpec.named, spec.named, strict,
+                            [](const std::wstring& name){ return L"“" + wxString(name) + L"”"; });
+    }
+    return error;
+}
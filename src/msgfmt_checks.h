@@ -0,0 +1,65 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_msgfmt_checks_h
+#define Poedit_msgfmt_checks_h
+
+#include "catalog.h"
+
+#include <string>
+#include <vector>
+
+
+/**
+    Native implementation of the per-entry checks done by "msgfmt -c".
+
+    Checks c-format and python-format strings in translations against the
+    source text with the same rules msgfmt uses, consistency of leading and
+    trailing newlines and the number of plural forms. Other formats are
+    not checked, POCatalog still runs msgfmt for files that use them.
+
+    Checks only depend on the item and plural forms, have no mutable state
+    and can be used concurrently from multiple threads.
+ */
+class MsgfmtChecker
+{
+public:
+    explicit MsgfmtChecker(const PluralFormsExpr& plurals);
+
+    /// Returns true if @a fmt (as in "c" for c-format) format strings are checked
+    static bool IsFormatSupported(const std::string& fmt);
+
+    /// Checks the item, returns error message or empty string if there's no problem.
+    wxString Check(const CatalogItemSnapshot& item) const;
+
+private:
+    wxString CheckFormat(const std::string& fmt, const wxString& source, const wxString& translation, bool strict) const;
+
+    unsigned m_nplurals;
+    // whether plural form is used for many values of n and must be checked strictly
+    std::vector<bool> m_oftenUsedForm;
+};
+
+#endif // Poedit_msgfmt_checks_h
@@ -240,15 +240,101 @@ void PluralFormsCalculator::init(PluralFormsToken::Number nplurals,
 {
     m_nplurals = nplurals;
     m_plural.reset(plural);
+
+    m_code.clear();
+    m_table.clear();
+    if (plural == NULL)
+        return;
+
+    // fall back to walking the tree if the expression is too deeply nested
+    if (!compile(plural, 1))
+        m_code.clear();
+
+    m_table.resize(TABLE_SIZE);
+    for (int n = 0; n < TABLE_SIZE; n++)
+        m_table[n] = evaluateUncached(n);
 }
 
-int PluralFormsCalculator::evaluate(int n) const
+bool PluralFormsCalculator::compile(const PluralFormsNode *node, int depth)
+{
+    // operands are pushed on the stack in order, so the i-th one needs one more slot
+    int arity = 0;
+    switch (node->token().type())
+    {
+        case PluralFormsToken::T_NUMBER:
+        case PluralFormsToken::T_N:
+            break;
+        case PluralFormsToken::T_QUESTION:
+            arity = 3;
+            break;
+        default:
+            arity = 2;
+            break;
+    }
+
+    if (depth + arity > MAX_STACK_DEPTH)
+        return false;
+    for (int i = 0; i < arity; i++)
+    {
+        if (!compile(node->node(i), depth + i))
+            return false;
+    }
+
+    m_code.push_back({node->token().type(), node->token().type() == PluralFormsToken::T_NUMBER ? node->token().number() : 0});
+    return true;
+}
+
+PluralFormsToken::Number PluralFormsCalculator::execute(PluralFormsToken::Number n) const
+{
+    typedef PluralFormsToken::Number Number;
+    Number stack[MAX_STACK_DEPTH];
+    Number *top = stack; // points past the topmost value
+
+    for (auto& i: m_code)
+    {
+        switch (i.op)
+        {
+            case PluralFormsToken::T_NUMBER:
+                *top++ = i.value;
+                continue;
+            case PluralFormsToken::T_N:
+                *top++ = n;
+                continue;
+            case PluralFormsToken::T_QUESTION:
+                top -= 2;
+                top[-1] = top[-1] ? top[0] : top[1];
+                continue;
+            default:
+                break;
+        }
+
+        const Number b = *--top;
+        Number& a = top[-1];
+        switch (i.op)
+        {
+            case PluralFormsToken::T_EQUAL:            a = a == b; break;
+            case PluralFormsToken::T_NOT_EQUAL:        a = a != b; break;
+            case PluralFormsToken::T_GREATER:          a = a > b;  break;
+            case PluralFormsToken::T_GREATER_OR_EQUAL: a = a >= b; break;
+            case PluralFormsToken::T_LESS:             a = a < b;  break;
+            case PluralFormsToken::T_LESS_OR_EQUAL:    a = a <= b; break;
+            case PluralFormsToken::T_REMINDER:         a = b != 0 ? a % b : 0; break;
+            case PluralFormsToken::T_LOGICAL_AND:      a = a && b; break;
+            case PluralFormsToken::T_LOGICAL_OR:       a = a || b; break;
+            default:                                   a = 0; break;
+        }
+    }
+
+    return stack[0];
+}
+
+int PluralFormsCalculator::evaluateUncached(int n) const
 {
     if (m_plural.get() == 0)
     {
         return 0;
     }
-    PluralFormsToken::Number number = m_plural->evaluate(n);
+    PluralFormsToken::Number number = m_code.empty() ? m_plural->evaluate(n) : execute(n);
     if (number < 0 || number > m_nplurals)
     {
         return 0;
@@ -256,6 +342,13 @@ int PluralFormsCalculator::evaluate(int n) const
     return number;
 }
 
+int PluralFormsCalculator::evaluate(int n) const
+{
+    if (n >= 0 && n < (int)m_table.size())
+        return m_table[n];
+    return evaluateUncached(n);
+}
+
 
 class PluralFormsParser
 {
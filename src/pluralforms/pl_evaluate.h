@@ -13,6 +13,7 @@
 #include <wx/string.h>
 
 #include <memory>
+#include <vector>
 
 // ----------------------------------------------------------------------------
 // Plural forms parser
@@ -145,7 +146,26 @@ public:
     void  init(PluralFormsToken::Number nplurals, PluralFormsNode* plural);
     wxString getString() const;
 
+    // results for n in [0, TABLE_SIZE) are precomputed
+    static const int TABLE_SIZE = 1002;
+
 private:
+    // The parsed tree is compiled into flat postfix code evaluated on a small
+    // stack. All operands are always evaluated (plural expressions have no side
+    // effects), so there are no jumps in the code.
+    struct Instruction
+    {
+        PluralFormsToken::Type op;
+        PluralFormsToken::Number value; // for T_NUMBER
+    };
+    static const int MAX_STACK_DEPTH = 64;
+
+    bool compile(const PluralFormsNode *node, int depth);
+    PluralFormsToken::Number execute(PluralFormsToken::Number n) const;
+    int evaluateUncached(int n) const;
+
     PluralFormsToken::Number m_nplurals;
     PluralFormsNodePtr m_plural;
+    std::vector<Instruction> m_code;
+    std::vector<int> m_table;
 };
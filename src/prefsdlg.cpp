@@ -27,6 +27,7 @@
 
 #include <fstream>
 #include <memory>
+#include <mutex>
 
 #include <wx/editlbox.h>
 #include <wx/textctrl.h>
@@ -409,6 +410,12 @@ public:
         sizer->AddSpacer(PX(3));
         sizer->Add(learnMore, wxSizerFlags().Border(wxLEFT, UnderCheckboxIndent()));
 
+        m_propagate = new wxCheckBox(this, wxID_ANY, _("Reuse new translations in identical strings"));
+        sizer->AddSpacer(PX(10));
+        sizer->Add(m_propagate, wxSizerFlags().Expand());
+        sizer->Add(new ExplanationLabel(this, _("When you translate a string, other untranslated entries with the same text in the file are filled in too and marked as needing review.")),
+                   wxSizerFlags().Expand().Border(wxLEFT, UnderCheckboxIndent()));
+
 #ifdef __WXOSX__
         m_stats->SetWindowVariant(wxWINDOW_VARIANT_SMALL);
         manage->SetWindowVariant(wxWINDOW_VARIANT_SMALL);
@@ -427,6 +434,7 @@ public:
         {
             m_mergeUse->Bind(wxEVT_CHECKBOX, [=](wxCommandEvent&){ TransferDataFromWindow(); });
             m_mergeBehavior->Bind(wxEVT_CHOICE, [=](wxCommandEvent&){ TransferDataFromWindow(); });
+            m_propagate->Bind(wxEVT_CHECKBOX, [=](wxCommandEvent&){ TransferDataFromWindow(); });
             // Some settings directly affect the UI, so need a more expensive handler:
             m_useTM->Bind(wxEVT_CHECKBOX, &TMPageWindow::TransferDataFromWindowAndUpdateUI, this);
         }
@@ -438,6 +446,7 @@ public:
         auto merge = Config::MergeBehavior();
         m_mergeUse->SetValue(merge != Merge_None);
         m_mergeBehavior->SetSelection(merge == Merge_UseTM ? 1 : 0);
+        m_propagate->SetValue(Config::PropagateTranslations());
     }
 
     void SaveValues(wxConfigBase&) override
@@ -451,6 +460,7 @@ public:
         {
             Config::MergeBehavior(Merge_None);
         }
+        Config::PropagateTranslations(m_propagate->GetValue());
     }
 
 private:
@@ -485,6 +495,9 @@ private:
         static wxWindowIDRef idLearn = NewControlId();
         static wxWindowIDRef idImportTMX = NewControlId();
         static wxWindowIDRef idExportTMX = NewControlId();
+        static wxWindowIDRef idUndoImport = NewControlId();
+        static wxWindowIDRef idOptimize = NewControlId();
+        static wxWindowIDRef idStats = NewControlId();
         static wxWindowIDRef idReset = NewControlId();
 
         wxMenu menu;
@@ -495,18 +508,29 @@ private:
         menu.AppendSeparator();
         auto itemImport = menu.Append(idImportTMX, MSW_OR_OTHER(_(L"Import from TMX…"), _(L"Import From TMX…")));
         auto itemExport = menu.Append(idExportTMX, MSW_OR_OTHER(_(L"Export to TMX…"), _(L"Export To TMX…")));
+        auto itemUndoImport = menu.Append(idUndoImport, MSW_OR_OTHER(_(L"Undo last TMX import…"), _(L"Undo Last TMX Import…")));
+        itemUndoImport->Enable(!m_lastImportBatches.empty());
         menu.AppendSeparator();
+        // TRANSLATORS: This is a menu item that compacts the translation memory database to make it faster.
+        auto itemOptimize = menu.Append(idOptimize, _("Optimize"));
+        auto itemStats = menu.Append(idStats, MSW_OR_OTHER(_(L"Show statistics…"), _(L"Show Statistics…")));
         // TRANSLATORS: This is a button that deletes everything in the translation memory (i.e. clears/resets it).
         auto itemReset = menu.Append(idReset, _("Reset"));
         
         SetMacMenuIcon(itemLearn, "document.on.document");
         SetMacMenuIcon(itemImport, "arrow.down.document");
         SetMacMenuIcon(itemExport, "arrow.up.document");
+        SetMacMenuIcon(itemUndoImport, "arrow.uturn.backward");
+        SetMacMenuIcon(itemOptimize, "gauge.with.dots.needle.bottom.50percent");
+        SetMacMenuIcon(itemStats, "chart.bar");
         SetMacMenuIcon(itemReset, "trash");
 
         menu.Bind(wxEVT_MENU, &TMPageWindow::OnImportIntoTM, this, idLearn);
         menu.Bind(wxEVT_MENU, &TMPageWindow::OnImportTMX, this, idImportTMX);
         menu.Bind(wxEVT_MENU, &TMPageWindow::OnExportTMX, this, idExportTMX);
+        menu.Bind(wxEVT_MENU, &TMPageWindow::OnUndoImportTMX, this, idUndoImport);
+        menu.Bind(wxEVT_MENU, &TMPageWindow::OnOptimizeTM, this, idOptimize);
+        menu.Bind(wxEVT_MENU, &TMPageWindow::OnShowTMStats, this, idStats);
         menu.Bind(wxEVT_MENU, &TMPageWindow::OnResetTM, this, idReset);
 
         auto win = dynamic_cast<wxButton*>(e.GetEventObject());
@@ -569,17 +593,71 @@ private:
 
             wxArrayString paths;
             dlg->GetPaths(paths);
+
+            // remember imported batches, so that the import can be undone:
+            auto batches = std::make_shared<std::vector<std::string>>();
+            auto batchesMutex = std::make_shared<std::mutex>();
+
             DoImportIntoTM(paths, [=](const wxString& p)
             {
                 std::ifstream f;
                 f.open(p.fn_str());
-                int count = TMX::ImportFromFile(f, TranslationMemory::Get());
+                std::string batch;
+                int count = TMX::ImportFromFile(f, TranslationMemory::Get(), &batch);
                 f.close();
+                if (!batch.empty())
+                {
+                    std::lock_guard<std::mutex> lock(*batchesMutex);
+                    batches->push_back(batch);
+                }
                 return count;
             });
+
+            std::lock_guard<std::mutex> lock(*batchesMutex);
+            if (!batches->empty())
+                m_lastImportBatches = *batches;
         }
     }
 
+    void OnUndoImportTMX(wxCommandEvent&)
+    {
+        if (m_lastImportBatches.empty())
+            return;
+
+        auto title = _("Undo TMX import");
+        auto main = _("Are you sure you want to remove the last imported translations?");
+        auto details = _(L"All translations from the last imported TMX files will be deleted from the translation memory, including those that were already stored in it before the import. You can’t undo this operation.");
+
+        wxWindowPtr<wxMessageDialog> dlg(new wxMessageDialog(this, main, title, wxYES_NO | wxNO_DEFAULT | wxICON_WARNING));
+        dlg->SetExtendedMessage(details);
+        dlg->SetYesNoLabels(_("Remove"), _("Cancel"));
+
+        dlg->ShowWindowModalThenDo([this,dlg](int retcode){
+            if (retcode != wxID_YES)
+                return;
+
+            auto batches = m_lastImportBatches;
+            wxWindowPtr<ProgressWindow> progress(new ProgressWindow(this, _(L"Removing translations…")));
+            progress->SetErrorMessage(_("Removing imported translations failed."));
+            progress->RunTaskModal([=]() -> BackgroundTaskResult
+            {
+                size_t count = 0;
+                for (auto& b: batches)
+                    count += TranslationMemory::Get().RollbackImport(b);
+
+                return wxString::Format
+                       (
+                           // TRANSLATORS: %s is a (formatted) number here
+                           wxPLURAL("%s translation was removed.", "%s translations were removed.", (long)count),
+                           wxNumberFormatter::ToString((long)count)
+                       );
+            });
+
+            m_lastImportBatches.clear();
+            UpdateStats();
+        });
+    }
+
     template<typename T>
     void DoImportIntoTM(const wxArrayString& paths, T&& doImportFile)
     {
@@ -633,7 +711,8 @@ private:
             MACOS_OR_OTHER("", _(L"Export as…")),
             "",
             "",
-            MaskForType("*.tmx", _("TMX Files")),
+            MaskForType("*.tmx", _("TMX Files")) + "|" +
+            MaskForType("*.tmx.gz", _("Compressed TMX Files")),
             wxFD_SAVE | wxFD_OVERWRITE_PROMPT)
         );
 
@@ -651,9 +730,11 @@ private:
             {
                 TempOutputFileFor tempfile(p);
 
+                const bool compressed = p.Lower().EndsWith(".gz");
+
                 std::ofstream f;
-                f.open(tempfile.FileName().fn_str());
-                TMX::ExportToFile(TranslationMemory::Get(), f);
+                f.open(tempfile.FileName().fn_str(), compressed ? std::ios_base::binary : std::ios_base::out);
+                TMX::ExportToFile(TranslationMemory::Get(), f, compressed);
                 f.close();
 
                 if ( !tempfile.Commit() )
@@ -662,6 +743,68 @@ private:
         }
     }
 
+    void OnOptimizeTM(wxCommandEvent&)
+    {
+        wxWindowPtr<ProgressWindow> progress(new ProgressWindow(this, _(L"Optimizing translation memory…")));
+        progress->SetErrorMessage(_("Optimizing translation memory failed."));
+        progress->RunTaskModal([=]()
+        {
+            TranslationMemory::Get().Optimize();
+        });
+
+        UpdateStats();
+    }
+
+    void OnShowTMStats(wxCommandEvent&)
+    {
+        TranslationMemory::DetailedStats stats;
+        try
+        {
+            wxBusyCursor bcur;
+            stats = TranslationMemory::Get().GetDetailedStats();
+        }
+        catch (...)
+        {
+            wxLogError("%s", DescribeCurrentException());
+            return;
+        }
+
+        wxString report;
+        report += wxString::Format(_("Stored translations: %s"), wxNumberFormatter::ToString(stats.numDocs)) + "\n";
+        report += wxString::Format(_("Deleted, not yet optimized away: %s"), wxNumberFormatter::ToString(stats.deletedDocs)) + "\n";
+        report += wxString::Format(_("Database size on disk: %s"), wxFileName::GetHumanReadableSize(stats.fileSize, "--", 1, wxSIZE_CONV_SI)) + "\n";
+        report += wxString::Format(_("Indexes: %d, segments: %d"), stats.indexes, stats.segments) + "\n";
+
+        if (!stats.docsPerLanguagePair.empty())
+        {
+            report += "\n";
+            for (auto& i: stats.docsPerLanguagePair)
+                report += wxString::Format("%s: %s\n", wxString::FromUTF8(i.first), wxNumberFormatter::ToString(i.second));
+        }
+
+        report += "\n";
+        for (auto& i: stats.latency)
+        {
+            auto& l = i.second;
+            if (!l.count)
+                continue;
+            // TRANSLATORS: Timing statistics of TM operations, e.g. "Search (120×): median 1.2 ms, 90% 4.5 ms, max 20.0 ms"
+            report += wxString::Format(_(L"%s (%d×): median %.1f ms, 90%% %.1f ms, 99%% %.1f ms, max %.1f ms"),
+                                       i.first, (int)l.count, l.median, l.p90, l.p99, l.max) + "\n";
+            typedef TranslationMemory::LatencyStats LatencyStats;
+            wxString histogram;
+            for (size_t b = 0; b < LatencyStats::HISTOGRAM_BUCKETS - 1; b++)
+                histogram += wxString::Format(L"  ≤%g ms: %d", LatencyStats::HISTOGRAM_BOUNDS[b], (int)l.histogram[b]);
+            histogram += wxString::Format(L"  >%g ms: %d", LatencyStats::HISTOGRAM_BOUNDS[LatencyStats::HISTOGRAM_BUCKETS - 2],
+                                          (int)l.histogram[LatencyStats::HISTOGRAM_BUCKETS - 1]);
+            report += histogram + "\n";
+        }
+
+        wxWindowPtr<wxMessageDialog> dlg(new wxMessageDialog(this, _("Translation memory statistics"), _("Translation memory"), wxOK | wxICON_INFORMATION));
+        dlg->SetExtendedMessage(report);
+        dlg->ShowWindowModalThenDo([dlg](int){});
+    }
+
     void OnResetTM(wxCommandEvent&)
     {
         auto title = _("Reset translation memory");
@@ -689,7 +832,10 @@ private:
     wxCheckBox *m_useTM;
     wxCheckBox *m_mergeUse;
     wxChoice *m_mergeBehavior;
+    wxCheckBox *m_propagate;
     wxStaticText *m_stats;
+    // import batches (see TranslationMemory::ImportData()) of the last TMX import done here
+    std::vector<std::string> m_lastImportBatches;
 };
 
 class TMPage : public wxPreferencesPage
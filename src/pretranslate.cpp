@@ -25,6 +25,7 @@
 
 #include "pretranslate.h"
 
+#include "concurrency.h"
 #include "configuration.h"
 #include "customcontrols.h"
 #include "hidpi.h"
@@ -38,11 +39,22 @@
 #include <wx/checkbox.h>
 #include <wx/dialog.h>
 #include <wx/intl.h>
+#include <wx/log.h>
 #include <wx/msgdlg.h>
 #include <wx/numformatter.h>
 #include <wx/sizer.h>
 #include <wx/windowptr.h>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
 
 namespace
 {
@@ -57,6 +69,213 @@ enum class ResType
 
 inline bool translated(ResType r) { return r >= ResType::Fuzzy; }
 
+// Number of strings looked up in the TM together, as one unit of work
+const size_t PRETRANSLATE_BATCH_SIZE = 32;
+
+// Maximum number of remembered strings without TM matches, per language pair
+const size_t NO_MATCHES_CACHE_LIMIT = 1000000;
+
+
+inline std::string LanguagePairKey(const Language& srclang, const Language& lang)
+{
+    return srclang.Code() + "|" + lang.Code();
+}
+
+
+/*
+    Remembers source strings that had no matches in the TM at all, so that
+    repeated pre-translation (e.g. after every update from sources) doesn't
+    look them up again. This is only valid while the TM's content doesn't
+    change, so the cache is discarded whenever its revision differs.
+
+    Only hashes of the strings are kept; a collision would merely result in
+    a string not being pre-translated.
+ */
+class NoMatchesCache
+{
+public:
+    static NoMatchesCache& Get()
+    {
+        static NoMatchesCache s_instance;
+        return s_instance;
+    }
+
+    /// Returns indexes of @a sources that may have matches in TM at @a revision
+    std::vector<size_t> FilterKnown(const Language& srclang, const Language& lang,
+                                    const std::vector<std::wstring>& sources, unsigned revision)
+    {
+        std::vector<size_t> out;
+        out.reserve(sources.size());
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Validate(revision);
+        auto known = m_misses.find(LanguagePairKey(srclang, lang));
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            if (known == m_misses.end() || known->second.count(Hash(sources[i])) == 0)
+                out.push_back(i);
+        }
+        return out;
+    }
+
+    /// Records strings that had no matches in TM at @a revision
+    void Add(const Language& srclang, const Language& lang,
+             const std::vector<const std::wstring*>& misses, unsigned revision)
+    {
+        if (misses.empty())
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Validate(revision);
+        if (revision != m_revision)
+            return; // TM changed during the lookup, results may be stale
+
+        auto& known = m_misses[LanguagePairKey(srclang, lang)];
+        if (known.size() + misses.size() > NO_MATCHES_CACHE_LIMIT)
+            known.clear();
+        for (auto s: misses)
+            known.insert(Hash(*s));
+    }
+
+private:
+    NoMatchesCache() : m_revision(TranslationMemory::Get().GetRevision()) {}
+
+    void Validate(unsigned revision)
+    {
+        if (revision == m_revision)
+            return;
+        // only move forward, a lookup started before the change must not reset newer data:
+        if ((int)(revision - m_revision) > 0)
+        {
+            m_misses.clear();
+            m_revision = revision;
+        }
+    }
+
+    static size_t Hash(const std::wstring& s) { return std::hash<std::wstring>()(s); }
+
+    std::mutex m_mutex;
+    unsigned m_revision;
+    std::unordered_map<std::string, std::unordered_set<size_t>> m_misses;
+};
+
+
+/*
+    Matches found by the most recent TM leverage analysis, which is usually
+    followed by pre-translating the same strings. They are handed over to the
+    pre-translation (and forgotten) instead of searching the TM again. Strings
+    without matches are remembered by NoMatchesCache.
+
+    As with NoMatchesCache, the results are only valid for the TM revision
+    they were obtained at.
+ */
+class AnalysisResultsCache
+{
+public:
+    static AnalysisResultsCache& Get()
+    {
+        static AnalysisResultsCache s_instance;
+        return s_instance;
+    }
+
+    /// Replaces any previous content with (non-empty) @a results for @a sources
+    void Store(const Language& srclang, const Language& lang,
+               const std::vector<std::wstring>& sources, std::vector<SuggestionsList>&& results,
+               unsigned revision)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.clear();
+        m_key = LanguagePairKey(srclang, lang);
+        m_revision = revision;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            if (!results[i].empty())
+                m_results.emplace(sources[i], std::move(results[i]));
+        }
+    }
+
+    /**
+        Moves stored results for sources[i] for i in @a needed into results[i]
+        and removes such indexes from @a needed.
+     */
+    void Take(const Language& srclang, const Language& lang,
+              const std::vector<std::wstring>& sources, unsigned revision,
+              std::vector<size_t>& needed, std::vector<SuggestionsList>& results)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_results.empty())
+            return;
+        if (revision != m_revision)
+        {
+            m_results.clear();
+            return;
+        }
+        if (m_key != LanguagePairKey(srclang, lang))
+            return;
+
+        auto out = needed.begin();
+        for (auto i: needed)
+        {
+            auto found = m_results.find(sources[i]);
+            if (found != m_results.end())
+            {
+                results[i] = std::move(found->second);
+                m_results.erase(found);
+            }
+            else
+            {
+                *out++ = i;
+            }
+        }
+        needed.erase(out, needed.end());
+    }
+
+private:
+    std::mutex m_mutex;
+    std::string m_key;
+    unsigned m_revision = 0;
+    std::unordered_map<std::wstring, SuggestionsList> m_results;
+};
+
+
+// Looks up @a sources in the TM, skipping strings known to have no matches
+std::vector<SuggestionsList> SearchTM(const Language& srclang, const Language& lang,
+                                      const std::vector<std::wstring>& sources)
+{
+    TranslationMemory& tm = TranslationMemory::Get();
+    auto& cache = NoMatchesCache::Get();
+    const unsigned revision = tm.GetRevision();
+
+    std::vector<SuggestionsList> results(sources.size());
+
+    auto needed = cache.FilterKnown(srclang, lang, sources, revision);
+    AnalysisResultsCache::Get().Take(srclang, lang, sources, revision, needed, results);
+    if (needed.empty())
+        return results;
+
+    std::vector<std::wstring> query;
+    query.reserve(needed.size());
+    for (auto i: needed)
+        query.push_back(sources[i]);
+
+    auto found = tm.Search(srclang, lang, query);
+
+    std::vector<const std::wstring*> misses;
+    for (size_t i = 0; i < needed.size(); i++)
+    {
+        if (found[i].empty())
+            misses.push_back(&sources[needed[i]]);
+        else
+            results[needed[i]] = std::move(found[i]);
+    }
+    cache.Add(srclang, lang, misses, revision);
+
+    wxLogTrace("poedit.tm", "pre-translation: looked up %d of %d strings, %d without matches",
+               (int)needed.size(), (int)sources.size(), (int)misses.size());
+
+    return results;
+}
+
 
 struct Stats
 {
@@ -81,6 +300,316 @@ struct Stats
 };
 
 
+// Applies fetched suggestions to a catalog item's translation at @a index:
+ResType ApplySuggestions(const CatalogItemPtr& dt, unsigned index, const SuggestionsList& results, int flags)
+{
+    if (results.empty())
+        return ResType::None;
+    auto& res = results.front();
+    if ((flags & PreTranslate_OnlyExact) && !res.IsExactMatch())
+        return ResType::Rejected;
+
+    if ((flags & PreTranslate_OnlyGoodQuality) && res.score < 0.80)
+        return ResType::None;
+
+    dt->SetTranslation(res.text, index);
+    dt->SetPreTranslated(true);
+
+    bool isFuzzy = true;
+    if (res.IsExactMatch() && (flags & PreTranslate_ExactNotFuzzy))
+    {
+        if (results.size() > 1 && results[1].IsExactMatch())
+        {
+            // more than one exact match is ambiguous, so keep it flagged for review
+        }
+        else
+        {
+            isFuzzy = false;
+        }
+    }
+    dt->SetFuzzy(isFuzzy);
+
+    return res.IsExactMatch() ? ResType::Exact : ResType::Fuzzy;
+}
+
+
+// Looks up @a sources in the TM, in batches processed concurrently. Stops
+// early (leaving the remaining results empty) if cancelled.
+std::vector<SuggestionsList> SearchInBatches(const Language& srclang, const Language& lang,
+                                             const std::vector<std::wstring>& sources,
+                                             const dispatch::cancellation_token_ptr& cancellation_token)
+{
+    std::vector<SuggestionsList> results(sources.size());
+    const size_t batches_count = (sources.size() + PRETRANSLATE_BATCH_SIZE - 1) / PRETRANSLATE_BATCH_SIZE;
+    std::vector<std::exception_ptr> errors(batches_count);
+
+    dispatch::parallel_for(batches_count, [&](size_t n)
+    {
+        if (cancellation_token->is_cancelled())
+            return;
+        try
+        {
+            const size_t first = n * PRETRANSLATE_BATCH_SIZE;
+            const size_t last = std::min(sources.size(), first + PRETRANSLATE_BATCH_SIZE);
+            auto found = SearchTM(srclang, lang, std::vector<std::wstring>(sources.begin() + first, sources.begin() + last));
+            std::move(found.begin(), found.end(), results.begin() + first);
+        }
+        catch (...)
+        {
+            errors[n] = std::current_exception();
+        }
+    }, dispatch::priority::bulk);
+
+    for (auto& e: errors)
+    {
+        if (e)
+            std::rethrow_exception(e);
+    }
+
+    return results;
+}
+
+
+// Looks up translations of plural source texts into plural forms of @a lang
+// after the first one, for languages with more than 2 forms, which are stored
+// separately for each form (see TranslationMemory::SearchPluralForm()). The
+// forms are looked up concurrently. Returns results[form - 1][i] for
+// pluralSources[i].
+std::vector<std::vector<SuggestionsList>> SearchPluralForms(const Language& srclang, const Language& lang,
+                                                            const std::vector<std::wstring>& pluralSources)
+{
+    const unsigned nplurals = lang.nplurals();
+    if (nplurals <= 2 || pluralSources.empty())
+        return {};
+
+    std::vector<std::vector<SuggestionsList>> results(nplurals - 1);
+    std::vector<std::exception_ptr> errors(nplurals - 1);
+
+    dispatch::parallel_for(nplurals - 1, [&](size_t n)
+    {
+        try
+        {
+            results[n] = TranslationMemory::Get().SearchPluralForm(srclang, lang, pluralSources, unsigned(n + 1));
+        }
+        catch (...)
+        {
+            errors[n] = std::current_exception();
+        }
+    }, dispatch::priority::bulk);
+
+    for (auto& e: errors)
+    {
+        if (e)
+            std::rethrow_exception(e);
+    }
+
+    return results;
+}
+
+// Applies results of SearchPluralForms() for pluralSources[i] to @a dt
+void ApplyPluralForms(const CatalogItemPtr& dt, const std::vector<std::vector<SuggestionsList>>& results, size_t i, int flags)
+{
+    for (size_t form = 1; form <= results.size(); form++)
+        ApplySuggestions(dt, unsigned(form), results[form - 1][i], flags);
+}
+
+
+TMLeverageReport::Band LeverageBand(const SuggestionsList& results)
+{
+    if (results.empty())
+        return TMLeverageReport::Band_NoMatch;
+
+    auto& best = results.front();
+    if (best.IsExactMatch())
+        return TMLeverageReport::Band_Exact;
+    else if (best.score >= 0.95)
+        return TMLeverageReport::Band_95to99;
+    else if (best.score >= 0.85)
+        return TMLeverageReport::Band_85to94;
+    else if (best.score >= 0.75)
+        return TMLeverageReport::Band_75to84;
+    else
+        return TMLeverageReport::Band_NoMatch;
+}
+
+
+// Item to be translated from a source string, in the catalog for langs[lang]
+struct MultiTarget
+{
+    size_t lang;
+    CatalogItemPtr item;
+};
+
+// Looks up @a sources in all languages needed by their @a targets at once and
+// applies the results to the targets' plural form @a form. Calls
+// onTranslated(target) for every target item that was translated.
+template<typename OnTranslated>
+void LookupAndApplyToAll(const Language& srclang, const std::vector<Language>& langs,
+                         const std::vector<std::wstring>& sources,
+                         const std::vector<std::vector<MultiTarget>>& targets,
+                         unsigned form, int flags, OnTranslated&& onTranslated)
+{
+    // only look up languages that need any of the strings:
+    std::vector<int> slot(langs.size(), -1);
+    std::vector<Language> needed;
+    for (auto& tt: targets)
+    {
+        for (auto& t: tt)
+        {
+            if (slot[t.lang] == -1)
+            {
+                slot[t.lang] = (int)needed.size();
+                needed.push_back(langs[t.lang]);
+            }
+        }
+    }
+    if (needed.empty())
+        return;
+
+    auto results = TranslationMemory::Get().Search(srclang, needed, sources);
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        for (auto& t: targets[i])
+        {
+            auto rt = ApplySuggestions(t.item, form, results[slot[t.lang]][i], flags);
+            if (translated(rt))
+                onTranslated(t);
+        }
+    }
+}
+
+// Pre-translates catalogs that all have the same source language, see PreTranslateCatalogsSimple()
+std::vector<int> PreTranslateCatalogsWithSameSource(const std::vector<CatalogPtr>& catalogs,
+                                                    int flags,
+                                                    dispatch::cancellation_token_ptr cancellation)
+{
+    const auto srclang = catalogs.front()->GetSourceLanguage();
+    std::vector<Language> langs;
+    for (auto& c: catalogs)
+        langs.push_back(c->GetLanguage());
+
+    // Distinct source strings that aren't translated in some of the catalogs,
+    // and where in them they need translating:
+    std::vector<std::wstring> sources;
+    std::vector<std::vector<MultiTarget>> targets;
+    {
+        std::unordered_map<std::wstring, size_t> seen;
+        for (size_t l = 0; l < catalogs.size(); l++)
+        {
+            for (auto& dt: catalogs[l]->items())
+            {
+                if (dt->IsTranslated() && !dt->IsFuzzy())
+                    continue;
+                auto found = seen.emplace(str::to_wstring(dt->GetString()), sources.size());
+                if (found.second)
+                {
+                    sources.push_back(found.first->first);
+                    targets.emplace_back();
+                }
+                targets[found.first->second].push_back({l, dt});
+            }
+        }
+    }
+
+    std::vector<int> matched(catalogs.size(), 0);
+    std::mutex matchedMutex;
+
+    // Looks up and processes distinct strings [first,last) in one batch:
+    auto process_batch = [&](size_t first, size_t last)
+    {
+        std::vector<int> batchMatched(catalogs.size(), 0);
+        std::vector<std::wstring> pluralSources;
+        std::vector<std::vector<MultiTarget>> pluralTargets;
+        std::unordered_map<std::wstring, size_t> pluralSeen;
+        // items of languages with more than 2 plural forms, for each catalog:
+        std::map<size_t, std::vector<CatalogItemPtr>> manyPlurals;
+
+        LookupAndApplyToAll(srclang, langs,
+                            std::vector<std::wstring>(sources.begin() + first, sources.begin() + last),
+                            std::vector<std::vector<MultiTarget>>(targets.begin() + first, targets.begin() + last),
+                            0, flags,
+                            [&](const MultiTarget& t)
+                            {
+                                batchMatched[t.lang]++;
+                                if (!t.item->HasPlural())
+                                    return;
+                                if (langs[t.lang].nplurals() > 2)
+                                {
+                                    manyPlurals[t.lang].push_back(t.item);
+                                }
+                                else if (langs[t.lang].nplurals() == 2)
+                                {
+                                    auto found = pluralSeen.emplace(str::to_wstring(t.item->GetPluralString()), pluralSources.size());
+                                    if (found.second)
+                                    {
+                                        pluralSources.push_back(found.first->first);
+                                        pluralTargets.emplace_back();
+                                    }
+                                    pluralTargets[found.first->second].push_back(t);
+                                }
+                            });
+
+        if (!pluralSources.empty())
+            LookupAndApplyToAll(srclang, langs, pluralSources, pluralTargets, 1, flags, [](const MultiTarget&){});
+
+        for (auto& mp: manyPlurals)
+        {
+            std::vector<std::wstring> pluralTexts;
+            for (auto& dt: mp.second)
+                pluralTexts.push_back(str::to_wstring(dt->GetPluralString()));
+            auto results = SearchPluralForms(srclang, langs[mp.first], pluralTexts);
+            for (size_t i = 0; i < mp.second.size(); i++)
+                ApplyPluralForms(mp.second[i], results, i, flags);
+        }
+
+        std::lock_guard<std::mutex> lock(matchedMutex);
+        for (size_t l = 0; l < matched.size(); l++)
+            matched[l] += batchMatched[l];
+    };
+
+    // Batches are processed in rounds of a few per core, so that there's
+    // progress to report and only results of the current round are in memory:
+    const size_t batches_count = (sources.size() + PRETRANSLATE_BATCH_SIZE - 1) / PRETRANSLATE_BATCH_SIZE;
+    const size_t round_size = 4 * std::max(1u, std::thread::hardware_concurrency());
+
+    Progress progress((int)batches_count);
+    progress.message(_(L"Pre-translating from translation memory…"));
+
+    for (size_t round = 0; round < batches_count; round += round_size)
+    {
+        if (cancellation->is_cancelled())
+            break;
+
+        const size_t count = std::min(round_size, batches_count - round);
+        std::vector<std::exception_ptr> errors(count);
+        dispatch::parallel_for(count, [&](size_t n)
+        {
+            if (cancellation->is_cancelled())
+                return;
+            try
+            {
+                const size_t first = (round + n) * PRETRANSLATE_BATCH_SIZE;
+                process_batch(first, std::min(sources.size(), first + PRETRANSLATE_BATCH_SIZE));
+            }
+            catch (...)
+            {
+                errors[n] = std::current_exception();
+            }
+        }, dispatch::priority::bulk);
+
+        for (auto& e: errors)
+        {
+            if (e)
+                std::rethrow_exception(e);
+        }
+
+        progress.increment((int)count);
+    }
+
+    return matched;
+}
+
+
 template<typename T>
 Stats PreTranslateCatalogImpl(CatalogPtr catalog, const T& range, PreTranslateOptions options, dispatch::cancellation_token_ptr cancellation_token)
 {
@@ -90,7 +619,6 @@ Stats PreTranslateCatalogImpl(CatalogPtr catalog, const T& range, PreTranslateOp
     if (!Config::UseTM())
         return {};
 
-    TranslationMemory& tm = TranslationMemory::Get();
     auto srclang = catalog->GetSourceLanguage();
     auto lang = catalog->GetLanguage();
     const auto flags = options.flags;
@@ -98,89 +626,157 @@ Stats PreTranslateCatalogImpl(CatalogPtr catalog, const T& range, PreTranslateOp
     Progress top_progress(1);
     top_progress.message(_(L"Preparing strings…"));
 
-    // Function to apply fetched suggestions to a catalog item:
-    auto process_results = [=](CatalogItemPtr dt, unsigned index, const SuggestionsList& results) -> ResType
+    Stats stats;
+
+    // Items with the same source text (e.g. in different contexts) get the
+    // same results, so group them and look up each distinct text only once:
+    auto groups = std::make_shared<std::vector<std::vector<CatalogItemPtr>>>();
     {
-        if (results.empty())
-            return ResType::None;
-        auto& res = results.front();
-        if ((flags & PreTranslate_OnlyExact) && !res.IsExactMatch())
-            return ResType::Rejected;
+        std::unordered_map<std::wstring, size_t> seen;
+        for (auto dt: range)
+        {
+            if (dt->IsTranslated() && !dt->IsFuzzy())
+                continue;
+            stats.input_strings_count++;
+
+            auto key = str::to_wstring(dt->GetString());
+            if (dt->HasPlural())
+            {
+                key += L'\0'; // can't be part of a PO string, so keys can't clash
+                key += str::to_wstring(dt->GetPluralString());
+            }
+            auto found = seen.emplace(std::move(key), groups->size());
+            if (found.second)
+                groups->emplace_back();
+            (*groups)[found.first->second].push_back(dt);
+        }
+    }
+
+    // Catalog's bookkeeping of changes is done once for all items at the end,
+    // instead of by workers contending for it after every change:
+    CatalogItemArray batch_items;
+    batch_items.reserve(stats.input_strings_count);
+    for (auto& group: *groups)
+        batch_items.insert(batch_items.end(), group.begin(), group.end());
+    Catalog::ItemsBatch changes_batch(*catalog, batch_items);
+
+    // Looks up and processes groups [first,last) in the TM, in one batch:
+    auto process_batch = [=](size_t first, size_t last) -> std::vector<ResType>
+    {
+        std::vector<ResType> out(last - first, ResType::None);
+        if (cancellation_token->is_cancelled())
+            return out;
 
-        if ((flags & PreTranslate_OnlyGoodQuality) && res.score < 0.80)
-            return ResType::None;
+        std::vector<std::wstring> sources;
+        sources.reserve(last - first);
+        for (size_t i = first; i < last; i++)
+            sources.push_back(str::to_wstring((*groups)[i].front()->GetString()));
 
-        dt->SetTranslation(res.text, index);
-        dt->SetPreTranslated(true);
+        auto results = SearchTM(srclang, lang, sources);
 
-        bool isFuzzy = true;
-        if (res.IsExactMatch() && (flags & PreTranslate_ExactNotFuzzy))
+        std::vector<size_t> plurals;
+        std::vector<std::wstring> plural_sources;
+        for (size_t i = first; i < last; i++)
         {
-            if (results.size() > 1 && results[1].IsExactMatch())
+            auto& group = (*groups)[i];
+            ResType rt = ResType::None;
+            for (auto& dt: group)
+                rt = ApplySuggestions(dt, 0, results[i - first], flags);
+            out[i - first] = rt;
+
+            // plural forms are looked up only if the singular was found
+            if (translated(rt) && group.front()->HasPlural() && lang.nplurals() >= 2)
             {
-                // more than one exact match is ambiguous, so keep it flagged for review
+                plurals.push_back(i);
+                plural_sources.push_back(str::to_wstring(group.front()->GetPluralString()));
             }
-            else
+        }
+
+        if (!plurals.empty() && lang.nplurals() == 2)
+        {
+            // English-like plurals are ordinary translations of the plural text:
+            auto results_plural = SearchTM(srclang, lang, plural_sources);
+            for (size_t i = 0; i < plurals.size(); i++)
+            {
+                for (auto& dt: (*groups)[plurals[i]])
+                    ApplySuggestions(dt, 1, results_plural[i], flags);
+            }
+        }
+        else if (!plurals.empty())
+        {
+            auto results_forms = SearchPluralForms(srclang, lang, plural_sources);
+            for (size_t i = 0; i < plurals.size(); i++)
             {
-                isFuzzy = false;
+                for (auto& dt: (*groups)[plurals[i]])
+                    ApplyPluralForms(dt, results_forms, i, flags);
             }
         }
-        dt->SetFuzzy(isFuzzy);
 
-        return res.IsExactMatch() ? ResType::Exact : ResType::Fuzzy;
+        return out;
     };
 
-    Stats stats;
-
-    std::vector<dispatch::future<ResType>> operations;
-    for (auto dt: range)
-    {
-        if (dt->IsTranslated() && !dt->IsFuzzy())
-            continue;
+    // Batches are processed by at most as many workers as there are cores,
+    // each taking the next unprocessed batch when done with the previous one:
+    const size_t batches_count = (groups->size() + PRETRANSLATE_BATCH_SIZE - 1) / PRETRANSLATE_BATCH_SIZE;
+    auto batches = std::make_shared<std::vector<dispatch::promise<std::vector<ResType>>>>(batches_count);
+    auto next_batch = std::make_shared<std::atomic<size_t>>(0);
 
-        stats.input_strings_count++;
+    std::vector<dispatch::future<std::vector<ResType>>> operations;
+    operations.reserve(batches_count);
+    for (auto& b: *batches)
+        operations.push_back(b.get_future());
 
-        operations.push_back(dispatch::async([=,&tm]() -> ResType
+    // Cancelling stops the workers before the next batch (unstarted workers
+    // don't run at all); the remaining results are not waited for then:
+    dispatch::task_group workers(cancellation_token);
+    auto worker = [=]
+    {
+        for (;;)
         {
             if (cancellation_token->is_cancelled())
-                return {};
+                return;
 
-            auto results = tm.Search(srclang, lang, str::to_wstring(dt->GetString()));
-            auto rt = process_results(dt, 0, results);
+            const size_t n = (*next_batch)++;
+            if (n >= batches_count)
+                return;
 
-            if (translated(rt) && dt->HasPlural())
+            auto& promise = (*batches)[n];
+            try
             {
-                switch (lang.nplurals())
-                {
-                    case 2:  // "simple" English-like plurals
-                    {
-                        auto results_plural = tm.Search(srclang, lang, str::to_wstring(dt->GetPluralString()));
-                        process_results(dt, 1, results_plural);
-                    }
-                    case 1:  // nothing else to do
-                    default: // not supported
-                        break;
-                }
+                const size_t first = n * PRETRANSLATE_BATCH_SIZE;
+                promise.set_value(process_batch(first, std::min(groups->size(), first + PRETRANSLATE_BATCH_SIZE)));
+            }
+            catch (...)
+            {
+                dispatch::set_current_exception(promise);
             }
+        }
+    };
 
-            return rt;
-        }));
-    }
+    const size_t workers_count = std::min(size_t(std::max(1u, std::thread::hardware_concurrency())), batches_count);
+    for (size_t i = 0; i < workers_count; i++)
+        workers.async(worker, dispatch::priority::bulk);
 
-    Progress progress((int)operations.size());
+    Progress progress(stats.input_strings_count);
     progress.message(_(L"Pre-translating from translation memory…"));
 
+    size_t group_index = 0;
     for (auto& op: operations)
     {
         if (cancellation_token->is_cancelled())
             break;
 
-        auto rt = op.get();
-        stats.add(rt);
-        if (translated(rt))
-            progress.message(wxString::Format(wxPLURAL("Pre-translated %u string", "Pre-translated %u strings", stats.matched), stats.matched));
+        for (auto rt: op.get())
+        {
+            // the result applies to all items in the group:
+            const int count = (int)(*groups)[group_index++].size();
+            for (int i = 0; i < count; i++)
+                stats.add(rt);
+            if (translated(rt))
+                progress.message(wxString::Format(wxPLURAL("Pre-translated %u string", "Pre-translated %u strings", stats.matched), stats.matched));
 
-        progress.increment();
+            progress.increment(count);
+        }
     }
 
     return stats;
@@ -248,7 +844,219 @@ void PreTranslateCatalogAuto(wxWindow *window, CatalogPtr catalog, const PreTran
 }
 
 
-void PreTranslateWithUI(wxWindow *window, PoeditListCtrl *list, CatalogPtr catalog, std::function<void()> onChangesMade)
+int PreTranslateCatalogSimple(CatalogPtr catalog, const PreTranslateOptions& options)
+{
+    auto cancellation = std::make_shared<dispatch::cancellation_token>();
+    return PreTranslateCatalogImpl(catalog, catalog->items(), options, cancellation).matched;
+}
+
+
+std::vector<int> PreTranslateCatalogsSimple(const std::vector<CatalogPtr>& catalogs,
+                                            const PreTranslateOptions& options,
+                                            dispatch::cancellation_token_ptr cancellation)
+{
+    std::vector<int> matched(catalogs.size(), 0);
+    if (!Config::UseTM())
+        return matched;
+
+    // Strings can only be shared by catalogs with the same source language:
+    std::map<std::string, std::vector<size_t>> groups;
+    for (size_t i = 0; i < catalogs.size(); i++)
+    {
+        auto& c = catalogs[i];
+        if (c->UsesSymbolicIDsForSource() || !c->GetSourceLanguage().IsValid() || !c->GetLanguage().IsValid())
+            continue;
+        groups[c->GetSourceLanguage().Code()].push_back(i);
+    }
+
+    Progress progress((int)groups.size());
+    for (auto& g: groups)
+    {
+        if (cancellation->is_cancelled())
+            break;
+
+        Progress subtask(1, progress, 1);
+        std::vector<CatalogPtr> group;
+        for (auto i: g.second)
+            group.push_back(catalogs[i]);
+
+        auto groupMatched = PreTranslateCatalogsWithSameSource(group, options.flags, cancellation);
+        for (size_t i = 0; i < g.second.size(); i++)
+            matched[g.second[i]] = groupMatched[i];
+    }
+
+    return matched;
+}
+
+
+struct PreTranslationPrefetch::Data
+{
+    Language srclang, lang;
+    std::vector<std::wstring> sources;
+    std::vector<SuggestionsList> results;
+};
+
+
+dispatch::future<void> PreTranslationPrefetch::StartLookups(std::shared_ptr<Data> data,
+                                                            CatalogPtr catalog, CatalogPtr reference,
+                                                            dispatch::cancellation_token_ptr cancellation)
+{
+    if (!Config::UseTM())
+        return dispatch::make_ready_future();
+
+    data->srclang = catalog->GetSourceLanguage();
+    data->lang = catalog->GetLanguage();
+
+    // Strings that are already translated will be reused by merging, everything
+    // else from the reference is a candidate for pre-translation:
+    std::set<std::pair<wxString, wxString>> translated;
+    for (auto& i: catalog->items())
+    {
+        if (i->IsTranslated() && !i->IsFuzzy())
+            translated.emplace(i->GetContext(), i->GetRawString());
+    }
+
+    std::unordered_set<std::wstring> seen;
+    auto add = [&](const wxString& s)
+    {
+        auto ws = str::to_wstring(s);
+        if (seen.insert(ws).second)
+            data->sources.push_back(std::move(ws));
+    };
+
+    for (auto& i: reference->items())
+    {
+        if (translated.find({i->GetContext(), i->GetRawString()}) != translated.end())
+            continue;
+        add(i->GetString());
+        // plurals of other languages are stored per form and looked up when applying
+        if (i->HasPlural() && data->lang.nplurals() == 2)
+            add(i->GetPluralString());
+    }
+
+    return dispatch::async([data, cancellation]
+    {
+        data->results = SearchInBatches(data->srclang, data->lang, data->sources, cancellation);
+    });
+}
+
+
+PreTranslationPrefetch::PreTranslationPrefetch(CatalogPtr catalog, CatalogPtr reference,
+                                               const PreTranslateOptions& options,
+                                               dispatch::cancellation_token_ptr cancellation)
+    : m_data(std::make_shared<Data>()),
+      m_options(options),
+      m_cancellation(cancellation),
+      m_lookups(StartLookups(m_data, catalog, reference, cancellation))
+{
+}
+
+
+int PreTranslationPrefetch::ApplyTo(CatalogPtr catalog)
+{
+    if (!Config::UseTM())
+        return 0;
+
+    Progress progress(1);
+    progress.message(_(L"Pre-translating from translation memory…"));
+
+    try
+    {
+        m_lookups.get();
+    }
+    catch (...)
+    {
+        // lookups will be retried below
+        m_data->results.clear();
+    }
+
+    std::unordered_map<std::wstring, const SuggestionsList*> prefetched;
+    for (size_t i = 0; i < m_data->results.size(); i++)
+        prefetched.emplace(m_data->sources[i], &m_data->results[i]);
+
+    // Items may differ from what was anticipated (e.g. because of fuzzy matching when
+    // merging), so look up anything that wasn't prefetched now:
+    auto lookup = [&](const std::vector<CatalogItemPtr>& items, bool plural) -> std::vector<SuggestionsList>
+    {
+        std::vector<SuggestionsList> out(items.size());
+        std::vector<std::wstring> missing;
+        std::vector<size_t> missingIndexes;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            auto src = str::to_wstring(plural ? items[i]->GetPluralString() : items[i]->GetString());
+            auto p = prefetched.find(src);
+            if (p != prefetched.end())
+            {
+                out[i] = *p->second;
+            }
+            else
+            {
+                missing.push_back(std::move(src));
+                missingIndexes.push_back(i);
+            }
+        }
+
+        if (!missing.empty())
+        {
+            auto found = SearchInBatches(m_data->srclang, m_data->lang, missing, m_cancellation);
+            for (size_t i = 0; i < missingIndexes.size(); i++)
+                out[missingIndexes[i]] = std::move(found[i]);
+        }
+        return out;
+    };
+
+    std::vector<CatalogItemPtr> items;
+    for (auto& dt: catalog->items())
+    {
+        if (dt->IsTranslated() && !dt->IsFuzzy())
+            continue;
+        items.push_back(dt);
+    }
+
+    const auto flags = m_options.flags;
+    const auto results = lookup(items, false);
+
+    int matched = 0;
+    std::vector<CatalogItemPtr> plurals;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if (m_cancellation->is_cancelled())
+            break;
+
+        auto rt = ApplySuggestions(items[i], 0, results[i], flags);
+        if (translated(rt))
+        {
+            matched++;
+            if (items[i]->HasPlural() && m_data->lang.nplurals() >= 2)
+                plurals.push_back(items[i]);
+        }
+    }
+
+    if (m_data->lang.nplurals() == 2)
+    {
+        const auto results_plural = lookup(plurals, true);
+        for (size_t i = 0; i < plurals.size(); i++)
+            ApplySuggestions(plurals[i], 1, results_plural[i], flags);
+    }
+    else if (!plurals.empty())
+    {
+        std::vector<std::wstring> pluralSources;
+        for (auto& dt: plurals)
+            pluralSources.push_back(str::to_wstring(dt->GetPluralString()));
+        const auto results_forms = SearchPluralForms(m_data->srclang, m_data->lang, pluralSources);
+        for (size_t i = 0; i < plurals.size(); i++)
+            ApplyPluralForms(plurals[i], results_forms, i, flags);
+    }
+
+    return matched;
+}
+
+
+namespace
+{
+
+// Checks if @a catalog can be pre-translated, shows error message if it can't
+bool CheckCanPreTranslate(wxWindow *window, CatalogPtr catalog)
 {
     if (catalog->UsesSymbolicIDsForSource())
     {
@@ -263,7 +1071,7 @@ void PreTranslateWithUI(wxWindow *window, PoeditListCtrl *list, CatalogPtr catal
         );
         resultsDlg->SetExtendedMessage(_(L"Pre-translation requires that source text is available. It doesn’t work if only IDs without the actual text are used."));
         resultsDlg->ShowWindowModalThenDo([resultsDlg](int){});
-        return;
+        return false;
     }
     else if (!catalog->GetSourceLanguage().IsValid())
     {
@@ -278,9 +1086,136 @@ void PreTranslateWithUI(wxWindow *window, PoeditListCtrl *list, CatalogPtr catal
         );
         resultsDlg->SetExtendedMessage(_(L"Pre-translation requires that source text’s language is known. Poedit couldn’t detect it in this file."));
         resultsDlg->ShowWindowModalThenDo([resultsDlg](int){});
-        return;
+        return false;
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
+
+TMLeverageReport::Counts TMLeverageReport::Total() const
+{
+    Counts total;
+    for (auto& b: bands)
+    {
+        total.strings += b.strings;
+        total.sourceWords += b.sourceWords;
+    }
+    return total;
+}
+
+
+TMLeverageReport AnalyzeTMLeverage(CatalogSnapshotPtr snapshot, dispatch::cancellation_token_ptr cancellation)
+{
+    const auto srclang = snapshot->GetSourceLanguage();
+    const auto lang = snapshot->GetLanguage();
+
+    Progress progress(1);
+    progress.message(_(L"Looking up strings in translation memory…"));
+
+    // Distinct source strings that need translating, and items using them:
+    std::vector<std::wstring> sources;
+    std::vector<std::vector<const CatalogItemSnapshot*>> groups;
+    {
+        std::unordered_map<std::wstring, size_t> seen;
+        for (auto& item: snapshot->items())
+        {
+            if (item->IsTranslated() && !item->IsFuzzy())
+                continue;
+            auto found = seen.emplace(str::to_wstring(item->GetString()), sources.size());
+            if (found.second)
+            {
+                sources.push_back(found.first->first);
+                groups.emplace_back();
+            }
+            groups[found.first->second].push_back(item.get());
+        }
     }
 
+    std::vector<SuggestionsList> results(sources.size());
+    const unsigned revision = TranslationMemory::Get().GetRevision();
+    if (Config::UseTM())
+        results = SearchInBatches(srclang, lang, sources, cancellation);
+    if (cancellation->is_cancelled())
+        return {};
+
+    // Word counts are cached in the snapshots, but computing them isn't
+    // cheap the first time, so do it in parallel too:
+    std::vector<TMLeverageReport::Counts> groupCounts(groups.size());
+    dispatch::parallel_for(groups.size(), [&](size_t i)
+    {
+        for (auto item: groups[i])
+        {
+            groupCounts[i].strings++;
+            groupCounts[i].sourceWords += item->GetTextCounts(srclang, lang).sourceWords;
+        }
+    }, dispatch::priority::bulk);
+
+    TMLeverageReport report;
+    for (size_t i = 0; i < groups.size(); i++)
+    {
+        auto& band = report.bands[LeverageBand(results[i])];
+        band.strings += groupCounts[i].strings;
+        band.sourceWords += groupCounts[i].sourceWords;
+    }
+
+    AnalysisResultsCache::Get().Store(srclang, lang, sources, std::move(results), revision);
+
+    return report;
+}
+
+
+void AnalyzeTMLeverageWithUI(wxWindow *window, CatalogPtr catalog)
+{
+    if (!CheckCanPreTranslate(window, catalog))
+        return;
+
+    auto snapshot = catalog->TakeSnapshot();
+    auto cancellation = std::make_shared<dispatch::cancellation_token>();
+    wxWindowPtr<ProgressWindow> progress(new ProgressWindow(window, _(L"Analyzing TM matches…"), cancellation));
+    progress->RunTaskThenDo([=]()
+    {
+        auto report = AnalyzeTMLeverage(snapshot, cancellation);
+        auto total = report.Total();
+
+        BackgroundTaskResult bg;
+        if (total.strings == 0)
+        {
+            bg.summary = _("All strings are already translated.");
+            return bg;
+        }
+
+        bg.summary = wxString::Format(wxPLURAL("%u string (%u words) needs translation.",
+                                               "%u strings (%u words) need translation.",
+                                               total.strings), total.strings, total.sourceWords);
+
+        auto row = [&](const wxString& label, const TMLeverageReport::Counts& c)
+        {
+            // TRANSLATORS: Number of strings with their word count in a table, e.g. "15 strings, 140 words"
+            auto value = wxString::Format(_("%s strings, %s words"),
+                                          wxNumberFormatter::ToString((long)c.strings),
+                                          wxNumberFormatter::ToString((long)c.sourceWords));
+            bg.details.emplace_back(label, value);
+        };
+        row(_("Exact matches (100%)"), report.bands[TMLeverageReport::Band_Exact]);
+        row(_(L"Matches 95–99%"), report.bands[TMLeverageReport::Band_95to99]);
+        row(_(L"Matches 85–94%"), report.bands[TMLeverageReport::Band_85to94]);
+        row(_(L"Matches 75–84%"), report.bands[TMLeverageReport::Band_75to84]);
+        row(_("No match"), report.bands[TMLeverageReport::Band_NoMatch]);
+
+        return bg;
+    },
+    [progress](bool){});
+}
+
+
+void PreTranslateWithUI(wxWindow *window, PoeditListCtrl *list, CatalogPtr catalog, std::function<void()> onChangesMade)
+{
+    if (!CheckCanPreTranslate(window, catalog))
+        return;
+
     wxWindowPtr<wxDialog> dlg(new wxDialog(window, wxID_ANY, _("Pre-translate"), wxDefaultPosition, wxSize(PX(440), -1)));
     auto topsizer = new wxBoxSizer(wxVERTICAL);
     auto sizer = new wxBoxSizer(wxVERTICAL);
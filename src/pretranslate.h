@@ -27,11 +27,13 @@
 #define Poedit_pretranslate_h
 
 #include "catalog.h"
+#include "concurrency.h"
 #include "edlistctrl.h"
 
 #include <wx/window.h>
 
 #include <functional>
+#include <vector>
 
 
 /// Flags for pre-translation functions
@@ -63,6 +65,108 @@ void PreTranslateCatalogAuto(wxWindow *window,
                              const PreTranslateOptions& options,
                              std::function<void()> onChangesMade);
 
+/**
+    Pre-translate all items in the catalog without any UI.
+
+    This is meant to be called from a background thread, e.g. as a part of
+    batch processing. Returns number of pre-translated (i.e. changed) items.
+ */
+int PreTranslateCatalogSimple(CatalogPtr catalog, const PreTranslateOptions& options);
+
+/**
+    Pre-translate several catalogs with the same source text, e.g. all
+    languages of a project, without any UI.
+
+    Unlike calling PreTranslateCatalogSimple() for each of them, every distinct
+    source string is looked up only once for all of the catalogs' languages.
+    Catalogs without known source language or with symbolic IDs are skipped.
+
+    This is meant to be called from a background thread. Returns numbers of
+    pre-translated items, in the same order as @a catalogs.
+ */
+std::vector<int> PreTranslateCatalogsSimple(const std::vector<CatalogPtr>& catalogs,
+                                            const PreTranslateOptions& options,
+                                            dispatch::cancellation_token_ptr cancellation);
+
+/**
+    Pre-translation that looks up strings in the TM ahead of time, while the
+    catalog is still being updated from @a reference.
+
+    Construct the object before merging the reference into the catalog, so
+    that the lookups run concurrently with merging, then call ApplyTo() with
+    the merged catalog. This doesn't provide any UI, it is meant to be used
+    as a part of another background task.
+ */
+class PreTranslationPrefetch
+{
+public:
+    /// Starts looking up strings from @a reference that aren't translated in @a catalog yet.
+    PreTranslationPrefetch(CatalogPtr catalog, CatalogPtr reference,
+                           const PreTranslateOptions& options,
+                           dispatch::cancellation_token_ptr cancellation);
+
+    /// Pre-translates @a catalog using the looked up strings; returns number of pre-translated items.
+    int ApplyTo(CatalogPtr catalog);
+
+private:
+    struct Data;
+
+    static dispatch::future<void> StartLookups(std::shared_ptr<Data> data,
+                                               CatalogPtr catalog, CatalogPtr reference,
+                                               dispatch::cancellation_token_ptr cancellation);
+
+    std::shared_ptr<Data> m_data;
+    PreTranslateOptions m_options;
+    dispatch::cancellation_token_ptr m_cancellation;
+    dispatch::future<void> m_lookups;
+};
+
+/**
+    Breakdown of strings that need translating (i.e. untranslated or fuzzy
+    ones) by quality of their best TM match, with their word counts. This is
+    useful for estimating how much work remains after pre-translation.
+ */
+struct TMLeverageReport
+{
+    /// Ranges of the best match's score
+    enum Band
+    {
+        Band_Exact,     ///< 100%
+        Band_95to99,
+        Band_85to94,
+        Band_75to84,
+        Band_NoMatch,   ///< no match or worse than 75%
+        Band_Count
+    };
+
+    struct Counts
+    {
+        unsigned strings = 0;
+        unsigned sourceWords = 0;
+    };
+
+    Counts bands[Band_Count];
+
+    /// All strings that need translating
+    Counts Total() const;
+};
+
+/**
+    Looks up strings from @a snapshot that need translating in the TM and
+    reports how well they are matched, without modifying the catalog.
+
+    Like pre-translation, repeated source strings are only looked up once and
+    the lookups run in parallel. Results are kept until the next analysis or
+    a change to the TM, so that pre-translating the catalog afterwards doesn't
+    query the TM again.
+
+    This is meant to be called from a background thread.
+ */
+TMLeverageReport AnalyzeTMLeverage(CatalogSnapshotPtr snapshot, dispatch::cancellation_token_ptr cancellation);
+
+/// Runs AnalyzeTMLeverage() on @a catalog with progress UI and shows the report.
+void AnalyzeTMLeverageWithUI(wxWindow *window, CatalogPtr catalog);
+
 /**
     Show UI for choosing pre-translation choices, then proceed with
     pre-translation unless cancelled (in which case false is returned).
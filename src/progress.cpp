@@ -26,8 +26,9 @@
 #include "progress.h"
 
 #include <atomic>
+#include <chrono>
+#include <cmath>
 #include <mutex>
-#include <set>
 
 
 class Progress::impl
@@ -35,12 +36,19 @@ class Progress::impl
 public:
     static constexpr double MIN_REPORTED_STEP = 0.01;
 
+    // Minimum interval between reports to the observer (i.e. at most ~30 UI updates per second)
+    static constexpr int64_t MIN_REPORTED_INTERVAL_NS = 33 * 1000 * 1000;
+
+    // Fixed-point precision of children's contributions to the completed count
+    static constexpr int64_t UNIT = 1 << 16;
+
     impl(const impl&) = delete;
     impl(int totalCount, std::weak_ptr<impl> parent, int parentCountTaken)
         : m_parent(parent),
           m_observer(nullptr),
-          m_totalCount(totalCount), m_parentCountTaken(parentCountTaken), m_completedCount(0),
-          m_dirty(true), m_completedFraction(0), m_lastReportedFraction(-1)
+          m_totalCount(totalCount), m_parentCountTaken(parentCountTaken),
+          m_completedCount(0), m_childrenUnits(0), m_contributedUnits(0),
+          m_lastReportedFraction(-1), m_lastReportTime(0)
     {
     }
 
@@ -49,12 +57,20 @@ public:
 
     }
 
-    void set_observer(ProgressObserver *observer) { m_observer = observer; }
+    void set_observer(ProgressObserver *observer)
+    {
+        std::lock_guard<std::mutex> lock(m_observerMutex);
+        m_observer.store(observer, std::memory_order_release);
+    }
 
     void message(const wxString& text)
     {
-        if (m_observer)
-            m_observer->update_message(text);
+        if (m_observer.load(std::memory_order_acquire))
+        {
+            std::lock_guard<std::mutex> lock(m_observerMutex);
+            if (auto observer = m_observer.load(std::memory_order_relaxed))
+                observer->update_message(text);
+        }
 
         if (auto p = parent())
             p->message(text);
@@ -62,30 +78,20 @@ public:
 
     void increment(int count)
     {
-        m_completedCount += count;
+        m_completedCount.fetch_add(count, std::memory_order_relaxed);
         notify_changed();
     }
 
     void set(int count)
     {
-        m_completedCount = count;
+        m_completedCount.store(count, std::memory_order_relaxed);
         notify_changed();
     }
 
-    void add_child(std::shared_ptr<impl> c)
+    /// Called when the child is finished, i.e. it contributes parentCountTaken in full
+    void finish_as_child()
     {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_children.insert(c);
-    }
-
-    void remove_child(std::shared_ptr<impl> c)
-    {
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            m_children.erase(c);
-            m_completedCount += c->m_parentCountTaken;
-        }
-        notify_changed();
+        contribute_to_parent(m_parentCountTaken * UNIT);
     }
 
     std::shared_ptr<impl> parent() const { return m_parent.lock(); }
@@ -93,53 +99,93 @@ public:
 protected:
     void notify_changed()
     {
-        m_dirty = true;
-        if (auto p = parent())
-            p->notify_changed();
+        // Children don't need to be enumerated: every change is pushed to the
+        // parent as the difference against what was contributed previously.
+        if (m_parentCountTaken > 0 && !m_parent.expired())
+            contribute_to_parent(std::llround(m_parentCountTaken * UNIT * completed_fraction()));
 
-        if (m_observer)
+        if (m_observer.load(std::memory_order_acquire))
+            report_to_observer();
+    }
+
+    void contribute_to_parent(int64_t units)
+    {
+        // Concurrent updates may compute the fraction in different order than
+        // they get here, so only ever increase the contribution, lest the
+        // progress would go back temporarily:
+        int64_t previous = m_contributedUnits.load(std::memory_order_relaxed);
+        do
+        {
+            if (units <= previous)
+                return;
+        }
+        while (!m_contributedUnits.compare_exchange_weak(previous, units, std::memory_order_acq_rel));
+
+        const int64_t delta = units - previous;
+
+        if (auto p = parent())
         {
-            const double completed = completed_fraction();
-            std::lock_guard<std::mutex> lock(m_mutex);
-            if (completed == 1.0 || completed - m_lastReportedFraction >= MIN_REPORTED_STEP)
-            {
-                m_lastReportedFraction = completed;
-                m_observer->update_progress(completed);
-            }
+            p->m_childrenUnits.fetch_add(delta, std::memory_order_relaxed);
+            p->notify_changed();
         }
     }
 
-    double completed_fraction()
+    void report_to_observer()
     {
-        // Note that the completed fraction may be inaccurate by the time the
-        // calculation ends if an update happens in parallels. We're assuming
-        // that's rare and just recalculate then in a loop.
-        while (m_dirty)
-        {
-            m_dirty = false;
+        const double completed = completed_fraction();
+        const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now().time_since_epoch()).count();
 
-            std::lock_guard<std::mutex> lock(m_mutex);
-            double completed = m_completedCount;
-            for (auto c: m_children)
-                completed += c->m_parentCountTaken * c->completed_fraction();
-            m_completedFraction = std::min(completed / m_totalCount, 1.0);
+        // Coalesce frequent updates, always report completion:
+        if (completed != 1.0)
+        {
+            if (completed - m_lastReportedFraction.load(std::memory_order_relaxed) < MIN_REPORTED_STEP)
+                return;
+            if (now - m_lastReportTime.load(std::memory_order_relaxed) < MIN_REPORTED_INTERVAL_NS)
+                return;
         }
 
-        return m_completedFraction;
+        // Only one thread reports at a time, the others' updates are coalesced
+        // into it, except for completion that must not be lost:
+        std::unique_lock<std::mutex> lock(m_observerMutex, std::defer_lock);
+        if (completed == 1.0)
+            lock.lock();
+        else if (!lock.try_lock())
+            return;
+
+        auto observer = m_observer.load(std::memory_order_relaxed);
+        if (!observer || completed == m_lastReportedFraction.load(std::memory_order_relaxed))
+            return;
+
+        m_lastReportedFraction.store(completed, std::memory_order_relaxed);
+        m_lastReportTime.store(now, std::memory_order_relaxed);
+        observer->update_progress(completed);
+    }
+
+    double completed_fraction() const
+    {
+        if (m_totalCount <= 0)
+            return 0.0;
+
+        const double completed = m_completedCount.load(std::memory_order_relaxed) +
+                                 double(m_childrenUnits.load(std::memory_order_relaxed)) / UNIT;
+        return std::min(completed / m_totalCount, 1.0);
     }
 
 private:
     std::weak_ptr<impl> m_parent;
-    std::set<std::shared_ptr<impl>> m_children;
-    ProgressObserver *m_observer;
+    std::atomic<ProgressObserver*> m_observer;
+    std::mutex m_observerMutex;
 
-    int m_totalCount, m_parentCountTaken;
+    const int m_totalCount, m_parentCountTaken;
     std::atomic_int m_completedCount;
-    std::atomic_bool m_dirty;
-    std::atomic<double> m_completedFraction;
-    double m_lastReportedFraction;
+    // Sum of children's contributions, in UNITs of m_completedCount
+    std::atomic<int64_t> m_childrenUnits;
+    // What this progress contributed to its parent's m_childrenUnits so far
+    std::atomic<int64_t> m_contributedUnits;
 
-    std::mutex m_mutex;
+    std::atomic<double> m_lastReportedFraction;
+    std::atomic<int64_t> m_lastReportTime;
 };
 
 
@@ -158,8 +204,6 @@ Progress::Progress(int totalCount, Progress& parent, int parentCountTaken)
 void Progress::init(impl *implObj)
 {
     m_impl.reset(implObj);
-    if (auto p = m_impl->parent())
-        p->add_child(m_impl);
 
     m_previousImplicitParent = ms_threadImplicitParent;
     ms_threadImplicitParent = m_impl;
@@ -168,8 +212,7 @@ void Progress::init(impl *implObj)
 Progress::~Progress()
 {
     ms_threadImplicitParent = m_previousImplicitParent;
-    if (auto p = m_impl->parent())
-        p->remove_child(m_impl);
+    m_impl->finish_as_child();
 
     // If any observer was set through this object, remove it because it is not reference counted:
     m_impl->set_observer(nullptr);
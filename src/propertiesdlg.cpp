@@ -44,6 +44,7 @@
 #include <wx/menu.h>
 #include <wx/nativewin.h>
 #include <wx/notebook.h>
+#include <wx/numformatter.h>
 #include <wx/windowptr.h>
 
 #include <algorithm>
@@ -53,6 +54,7 @@
 #include "propertiesdlg.h"
 
 #include "catalog_po.h"
+#include "catalog_stats.h"
 #include "colorscheme.h"
 #include "customcontrols.h"
 #include "hidpi.h"
@@ -686,6 +688,10 @@ PropertiesDialog::PropertiesDialog(wxWindow *parent, CatalogPtr cat, bool fileEx
     auto page_keywords = wxXmlResource::Get()->LoadPanel(notebook, "page_keywords");
     notebook->AddPage(page_keywords, MSW_OR_OTHER(_("Sources keywords"), _("Sources Keywords")));
 
+    auto page_stats = new wxPanel(notebook, wxID_ANY);
+    notebook->AddPage(page_stats, _("Statistics"));
+    CreateStatisticsPage(page_stats, cat);
+
     m_gettextSettings.reset(new GettextSettings);
 
     m_team = XRCCTRL(*this, "team", wxTextCtrl);
@@ -810,6 +816,52 @@ PropertiesDialog::~PropertiesDialog()
 }
 
 
+void PropertiesDialog::CreateStatisticsPage(wxWindow *page, const CatalogPtr& cat)
+{
+    const int COLUMNS = 5;
+    const int ROWS = 4;
+
+    auto sizer = new wxBoxSizer(wxVERTICAL);
+    page->SetSizer(sizer);
+
+    auto grid = new wxFlexGridSizer(COLUMNS, wxSize(PX(20), PX(6)));
+    sizer->Add(grid, wxSizerFlags().Border(wxALL, PX(12)));
+
+    auto addLabel = [=](const wxString& text, wxAlignment align)
+    {
+        auto label = new wxStaticText(page, wxID_ANY, text);
+        grid->Add(label, wxSizerFlags().Align(align));
+        return label;
+    };
+
+    addLabel("", wxALIGN_LEFT);
+    for (auto header: { _("Strings"), _("Source words"), _("Source characters"), _("Translation words") })
+        addLabel(header, wxALIGN_RIGHT)->SetFont(page->GetFont().Bold());
+
+    // values are filled in when computed in the background, which can take a while for large files:
+    auto cells = std::make_shared<std::vector<wxStaticText*>>();
+    for (auto row: { _("Translated"), wxGETTEXT_IN_CONTEXT("column/row header", "Needs Work"), _("Untranslated"), _("Total") })
+    {
+        addLabel(row, wxALIGN_LEFT);
+        for (int i = 1; i < COLUMNS; i++)
+            cells->push_back(addLabel(L"…", wxALIGN_RIGHT));
+    }
+
+    CatalogStatistics::ComputeAsync(cat->TakeSnapshot())
+    .then_on_window(this, [=](CatalogStatistics stats)
+    {
+        const CatalogStatistics::Counts rows[ROWS] = { stats.translated, stats.fuzzy, stats.untranslated, stats.Total() };
+        for (int r = 0; r < ROWS; r++)
+        {
+            const unsigned values[] = { rows[r].strings, rows[r].sourceWords, rows[r].sourceChars, rows[r].translationWords };
+            for (int i = 0; i < COLUMNS - 1; i++)
+                (*cells)[r * (COLUMNS - 1) + i]->SetLabel(wxNumberFormatter::ToString((long)values[i]));
+        }
+        page->Layout();
+    });
+}
+
+
 namespace
 {
 
@@ -58,6 +58,7 @@ class PropertiesDialog : public StandardDialog
             
     private:
         void DisableSourcesControls();
+        void CreateStatisticsPage(wxWindow *page, const CatalogPtr& cat);
 
         void OnLanguageChanged(wxCommandEvent& event);
         void OnLanguageValueChanged();
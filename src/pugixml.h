@@ -27,6 +27,7 @@
 #define Poedit_pugixml_h
 
 #include "str_helpers.h"
+#include "utility.h"
 
 #ifdef HAVE_PUGIXML
     #include <pugixml.hpp>
@@ -130,6 +131,71 @@ inline void set_node_text(xml_node node, const std::string& text)
 }
 
 
+/**
+    Estimates memory used by the DOM of @a doc, in bytes.
+
+    pugixml's internal structures aren't public, so their sizes are only
+    approximated; names and values of nodes and attributes are counted
+    exactly. Goes through the entire document.
+ */
+inline size_t estimate_memory_usage(const xml_document& doc)
+{
+    const size_t NODE_SIZE = 8 * sizeof(void*);
+    const size_t ATTRIBUTE_SIZE = 5 * sizeof(void*);
+
+    size_t size = 0;
+    auto addString = [&size](const char_t *s){ if (*s) size += (std::char_traits<char_t>::length(s) + 1) * sizeof(char_t); };
+
+    for (xml_node n = doc.first_child(); n; )
+    {
+        size += NODE_SIZE;
+        addString(n.name());
+        addString(n.value());
+        for (auto a: n.attributes())
+        {
+            size += ATTRIBUTE_SIZE;
+            addString(a.name());
+            addString(a.value());
+        }
+
+        // depth-first traversal without recursion:
+        if (n.first_child())
+        {
+            n = n.first_child();
+        }
+        else
+        {
+            while (n && !n.next_sibling())
+                n = n.parent();
+            if (n)
+                n = n.next_sibling();
+        }
+    }
+    return size;
+}
+
+
+/**
+    Loads XML file like xml_document::load_file(), but also handles files
+    stored gzip-compressed, which are decompressed in memory first.
+ */
+inline xml_parse_result load_file_decompressing(xml_document& doc, const wxString& filename,
+                                                unsigned options = PUGI_PARSE_FLAGS)
+{
+    if (!IsGzipFileName(filename))
+        return doc.load_file(filename.fn_str(), options);
+
+    MappedFile file(filename);
+    if (!file.IsOk())
+    {
+        xml_parse_result result;
+        result.status = status_file_not_found;
+        return result;
+    }
+    return doc.load_buffer(file.data(), file.size(), options);
+}
+
+
 } // namespace pugi
 
 #endif // Poedit_pugixml_h
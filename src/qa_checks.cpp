@@ -25,9 +25,12 @@
 
 #include "qa_checks.h"
 
+#include "concurrency.h"
+#include "progress.h"
 #include "syntaxhighlighter.h"
+#include "tracing.h"
 
-#include <regex>
+#include <functional>
 #include <set>
 #include <unicode/uchar.h>
 #include <wx/translation.h>
@@ -55,8 +58,6 @@ namespace QA
     const char *GetCheckId() const override { return GetId(); }
 
 
-std::wregex RE_POSITIONAL_FORMAT(LR"(^%[0-9]\$(.*))", std::regex_constants::ECMAScript | std::regex_constants::optimize);
-
 class Placeholders : public QACheck
 {
 public:
@@ -64,43 +65,51 @@ public:
 
     Placeholders(Language /*lang*/) {}
 
-    bool CheckItem(CatalogItemPtr item) override
+    IssuePtr CheckItem(const CatalogItemSnapshot& item, const StringPairs& /*strings*/) override
     {
         // this check is expensive, so make sure to run it on fully translated items only
-        if (!item->IsTranslated())
-            return false;
-
-        auto syntax = SyntaxHighlighter::ForItem(*item, SyntaxHighlighter::Placeholder, SyntaxHighlighter::EnforceFormatTag);
+        if (!item.IsTranslated())
+            return nullptr;
+
+        // The highlighter only depends on the source text and format flags,
+        // which aren't changed by editing, so it's safe to get it for the
+        // original item even if the check runs on a background thread:
+        auto original = item.GetItem();
+        if (!original)
+            return nullptr;
+        auto syntax = SyntaxHighlighter::ForItem(*original, SyntaxHighlighter::Placeholder, SyntaxHighlighter::EnforceFormatTag);
         if (!syntax)
-            return false;
+            return nullptr;
 
+        // source text's highlighting is cached in the item, so only the
+        // translations are scanned again after every edit:
         PlaceholdersSet phSource;
-        ExtractPlaceholders(phSource, syntax, item->GetString());
+        ExtractSourcePlaceholders(phSource, syntax, *original, SyntaxHighlighter::SourceSingular, item.GetString());
 
-        if (item->HasPlural())
+        if (item.HasPlural())
         {
-            ExtractPlaceholders(phSource, syntax, item->GetPluralString());
+            ExtractSourcePlaceholders(phSource, syntax, *original, SyntaxHighlighter::SourcePlural, item.GetPluralString());
             int index = 0;
-            for (auto& t: item->GetTranslations())
+            for (auto& t: item.GetTranslations())
             {
-                if (CheckPlaceholders(phSource, syntax, item, t, index++))
-                    return true;
+                if (auto issue = CheckPlaceholders(phSource, syntax, t, index++))
+                    return issue;
             }
-            return false;
+            return nullptr;
         }
         else
         {
-            return CheckPlaceholders(phSource, syntax, item, item->GetTranslation());
+            return CheckPlaceholders(phSource, syntax, item.GetTranslation());
         }
 
-        return false;
+        return nullptr;
     }
 
 private:
     // TODO: use std::string_view (C++17)
     typedef std::set<std::wstring> PlaceholdersSet;
 
-    bool CheckPlaceholders(const PlaceholdersSet& phSource, SyntaxHighlighterPtr syntax, CatalogItemPtr item, const wxString& str, int pluralIndex = -1)
+    IssuePtr CheckPlaceholders(const PlaceholdersSet& phSource, SyntaxHighlighterPtr syntax, const wxString& str, int pluralIndex = -1)
     {
         PlaceholdersSet phTrans;
         ExtractPlaceholders(phTrans, syntax, str);
@@ -114,9 +123,7 @@ private:
                 // "%d items" as "One item" for n=1
                 if (pluralIndex != 0)
                 {
-                    item->SetIssue(CatalogItem::Issue::Warning,
-                                   wxString::Format(_(L"Placeholder “%s” is missing from translation."), ph));
-                    return true;
+                    return Warning(wxString::Format(_(L"Placeholder “%s” is missing from translation."), ph));
                 }
             }
         }
@@ -126,37 +133,53 @@ private:
         {
             if (phSource.find(ph) == phSource.end())
             {
-                item->SetIssue(CatalogItem::Issue::Warning,
-                               wxString::Format(_(L"Superfluous placeholder “%s” that isn’t in source text."), ph));
-                return true;
+                return Warning(wxString::Format(_(L"Superfluous placeholder “%s” that isn’t in source text."), ph));
             }
         }
 
-        return false;
+        return nullptr;
+    }
+
+    // Matches ^%[0-9]\$(.*)
+    static bool IsPositionalFormat(const std::wstring& x)
+    {
+        return x.length() >= 3 && x[0] == '%' && x[1] >= '0' && x[1] <= '9' && x[2] == '$' &&
+               x.find_first_of(L"\n\r\u2028\u2029", 3) == std::wstring::npos;
+    }
+
+    static void AddPlaceholder(PlaceholdersSet& ph, const std::wstring& text, int a, int b, SyntaxHighlighter::TextKind kind)
+    {
+        if (kind != SyntaxHighlighter::Placeholder)
+            return;
+
+        auto x = text.substr(a, b - a);
+        if (x == L"%%")
+            return;
+
+        // filter out reordering of positional arguments by tracking them as unordered;
+        // e.g. %1$s is translated into %s
+        if (IsPositionalFormat(x))
+        {
+            x.erase(1, 2);
+        }
+
+        ph.insert(x);
     }
 
     void ExtractPlaceholders(PlaceholdersSet& ph, SyntaxHighlighterPtr syntax, const wxString& str)
     {
         const std::wstring text(str.ToStdWstring());
-        syntax->Highlight(text, [&text, &ph, syntax](int a, int b, SyntaxHighlighter::TextKind kind){
-            if (kind != SyntaxHighlighter::Placeholder)
-                return;
-
-            auto x = text.substr(a, b - a);
-            if (x == L"%%")
-                return;
-
-            // filter out reordering of positional arguments by tracking them as unordered;
-            // e.g. %1$s is translated into %s
-            std::wsmatch m;
-            if (std::regex_match(x, m, RE_POSITIONAL_FORMAT))
-            {
-                x = std::wstring(L"%") + std::wstring(m[1]);
-            }
-
-            ph.insert(x);
+        syntax->Highlight(text, [&text, &ph](int a, int b, SyntaxHighlighter::TextKind kind){
+            AddPlaceholder(ph, text, a, b, kind);
         });
     }
+
+    void ExtractSourcePlaceholders(PlaceholdersSet& ph, SyntaxHighlighterPtr syntax, const CatalogItem& original, int variant, const wxString& str)
+    {
+        const std::wstring text(str.ToStdWstring());
+        for (auto& s: *syntax->HighlightSource(original, variant, text))
+            AddPlaceholder(ph, text, s.from, s.to, s.kind);
+    }
 };
 
 
@@ -167,14 +190,14 @@ public:
 
     NotAllPlurals(Language /*lang*/) {}
 
-    bool CheckItem(CatalogItemPtr item) override
+    IssuePtr CheckItem(const CatalogItemSnapshot& item, const StringPairs& /*strings*/) override
     {
-        if (!item->HasPlural())
-            return false;
+        if (!item.HasPlural())
+            return nullptr;
 
         bool foundTranslated = false;
         bool foundEmpty = false;
-        for (auto& s: item->GetTranslations())
+        for (auto& s: item.GetTranslations())
         {
             if (s.empty())
                 foundEmpty = true;
@@ -184,11 +207,10 @@ public:
 
         if (foundEmpty && foundTranslated)
         {
-            item->SetIssue(CatalogItem::Issue::Warning, _("Not all plural forms are translated."));
-            return true;
+            return Warning(_("Not all plural forms are translated."));
         }
 
-        return false;
+        return nullptr;
     }
 };
 
@@ -203,30 +225,28 @@ public:
         m_shouldCheck = (m_lang != "zh" && m_lang != "ja" && m_lang != "ka");
     }
 
-    bool CheckString(CatalogItemPtr item, const wxString& source, const wxString& translation) override
+    IssuePtr CheckString(const CatalogItemSnapshot& /*item*/, const StringPair& s) override
     {
-        if (!m_shouldCheck || source.length() < 2)
-            return false;
+        if (!m_shouldCheck || s.source.length() < 2)
+            return nullptr;
 
         // Detect that the source string is a sentence: should have 1st letter uppercase and 2nd lowercase,
         // as checking just the 1st letter would lead to false positives (consider e.g. "MSP430 built-in"):
-        if (u_isupper(source[0]) && u_islower(source[1]) && u_islower(translation[0]))
+        if (s.sourceFirst.is(CharInfo::Upper) && s.sourceSecond.is(CharInfo::Lower) && s.translationFirst.is(CharInfo::Lower))
         {
-            item->SetIssue(CatalogItem::Issue::Warning, _("The translation should start as a sentence."));
-            return true;
+            return Warning(_("The translation should start as a sentence."));
         }
 
-        if (u_islower(source[0]) && u_isupper(translation[0]))
+        if (s.sourceFirst.is(CharInfo::Lower) && s.translationFirst.is(CharInfo::Upper))
         {
             if (m_lang != "de")
             {
-                item->SetIssue(CatalogItem::Issue::Warning, _("The translation should start with a lowercase character."));
-                return true;
+                return Warning(_("The translation should start with a lowercase character."));
             }
             // else: German nouns start uppercased, this would cause too many false positives
         }
 
-        return false;
+        return nullptr;
     }
 
 private:
@@ -248,45 +268,44 @@ public:
         m_checkSpaceInTranslation = (l != "zh" && l != "ja");
     }
 
-    bool CheckString(CatalogItemPtr item, const wxString& source, const wxString& translation) override
+    IssuePtr CheckString(const CatalogItemSnapshot& /*item*/, const StringPair& s) override
     {
-        if (m_checkSpaceInTranslation && u_isspace(source[0]) && !u_isspace(translation[0]))
+        const bool sourceStartsWithSpace = s.sourceFirst.is(CharInfo::Space);
+        const bool translationStartsWithSpace = s.translationFirst.is(CharInfo::Space);
+        const bool sourceEndsWithSpace = s.sourceLast.is(CharInfo::Space);
+        const bool translationEndsWithSpace = s.translationLast.is(CharInfo::Space);
+
+        if (m_checkSpaceInTranslation && sourceStartsWithSpace && !translationStartsWithSpace)
         {
-            item->SetIssue(CatalogItem::Issue::Warning, _(L"The translation doesn’t start with a space."));
-            return true;
+            return Warning(_(L"The translation doesn’t start with a space."));
         }
 
-        if (!u_isspace(source[0]) && u_isspace(translation[0]))
+        if (!sourceStartsWithSpace && translationStartsWithSpace)
         {
-            item->SetIssue(CatalogItem::Issue::Warning, _(L"The translation starts with a space, but the source text doesn’t."));
-            return true;
+            return Warning(_(L"The translation starts with a space, but the source text doesn’t."));
         }
 
-        if (source.Last() == '\n' && translation.Last() != '\n')
+        if (s.sourceLast.c == '\n' && s.translationLast.c != '\n')
         {
-            item->SetIssue(CatalogItem::Issue::Warning, _(L"The translation is missing a newline at the end."));
-            return true;
+            return Warning(_(L"The translation is missing a newline at the end."));
         }
 
-        if (source.Last() != '\n' && translation.Last() == '\n')
+        if (s.sourceLast.c != '\n' && s.translationLast.c == '\n')
         {
-            item->SetIssue(CatalogItem::Issue::Warning, _(L"The translation ends with a newline, but the source text doesn’t."));
-            return true;
+            return Warning(_(L"The translation ends with a newline, but the source text doesn’t."));
         }
 
-        if (m_checkSpaceInTranslation && u_isspace(source.Last()) && !u_isspace(translation.Last()))
+        if (m_checkSpaceInTranslation && sourceEndsWithSpace && !translationEndsWithSpace)
         {
-            item->SetIssue(CatalogItem::Issue::Warning, _(L"The translation is missing a space at the end."));
-            return true;
+            return Warning(_(L"The translation is missing a space at the end."));
         }
 
-        if (!u_isspace(source.Last()) && u_isspace(translation.Last()))
+        if (!sourceEndsWithSpace && translationEndsWithSpace)
         {
-            item->SetIssue(CatalogItem::Issue::Warning, _(L"The translation ends with a space, but the source text doesn’t."));
-            return true;
+            return Warning(_(L"The translation ends with a space, but the source text doesn’t."));
         }
 
-        return false;
+        return nullptr;
     }
 
 private:
@@ -303,7 +322,7 @@ public:
     {
     }
 
-    bool CheckString(CatalogItemPtr item, const wxString& source_, const wxString& translation) override
+    IssuePtr CheckString(const CatalogItemSnapshot& /*item*/, const StringPair& s) override
     {
         if (m_lang == "th" || m_lang == "lo" || m_lang == "km" || m_lang == "my")
         {
@@ -313,31 +332,41 @@ public:
             // It's better to skip them than to spam the user with bogus warnings
             // on _everything_.
             // See https://www.ccjk.com/punctuation-rule-for-bahasa-vietnamese-and-thai/
-            return false;
+            return nullptr;
         }
 
-        auto source(source_);
+        const wxString& translation = s.translation;
+        wxString trimmedSource;
+        const wxString *sourcePtr = &s.source;
+        CharInfo sourceLast = s.sourceLast;
         if (m_lang == "zh" || m_lang == "ja")
         {
             // Space is used sparingly in these languages andd e.g. not present after sentence-ending
             // period, so strip it from the source if present and check punctuation w/o it.
-            if (u_isspace(source.Last()) && !u_isspace(translation.Last()))
-                source.Trim(/*fromRight:*/true);
+            if (s.sourceLast.is(CharInfo::Space) && !s.translationLast.is(CharInfo::Space))
+            {
+                trimmedSource = s.source;
+                trimmedSource.Trim(/*fromRight:*/true);
+                if (trimmedSource.empty())
+                    return nullptr;
+                sourcePtr = &trimmedSource;
+                sourceLast = CharInfo(trimmedSource.Last());
+            }
         }
+        const wxString& source = *sourcePtr;
 
-        const UChar32 s_last = source.Last();
-        const UChar32 t_last = translation.Last();
-        const bool s_punct = IsPunctuation(s_last);
-        const bool t_punct = IsPunctuation(t_last);
+        const UChar32 s_last = sourceLast.c;
+        const UChar32 t_last = s.translationLast.c;
+        const bool s_punct = sourceLast.is(CharInfo::Punctuation);
+        const bool t_punct = s.translationLast.is(CharInfo::Punctuation);
 
-        if (u_getIntPropertyValue(s_last, UCHAR_BIDI_PAIRED_BRACKET_TYPE) == U_BPT_CLOSE ||
-            u_getIntPropertyValue(t_last, UCHAR_BIDI_PAIRED_BRACKET_TYPE) == U_BPT_CLOSE)
+        if (sourceLast.is(CharInfo::CloseBracket) || s.translationLast.is(CharInfo::CloseBracket))
         {
             // too many reordering related false positives for brackets
             // e.g. "your {site} account" -> "váš účet na {site}"
             if ((wchar_t)u_getBidiPairedBracket(s_last) != (wchar_t)source[0])
             {
-                return false;
+                return nullptr;
             }
             else
             {
@@ -345,25 +374,23 @@ public:
                 if (source.find_first_of((wchar_t)s_last, 1) != source.size() - 1)
                 {
                     // it's more complicated, possibly something like "your {foo} on {bar}"
-                    return false;
+                    return nullptr;
                 }
             }
         }
 
-        if (u_hasBinaryProperty(s_last, UCHAR_QUOTATION_MARK) || (!s_punct && u_hasBinaryProperty(t_last, UCHAR_QUOTATION_MARK)))
+        if (sourceLast.is(CharInfo::Quote) || (!s_punct && s.translationLast.is(CharInfo::Quote)))
         {
             // quoted fragments can move around, e.g., so ignore quotes in reporting:
             //      >> Invalid value for ‘{fieldName}’​ field
             //      >> Valor inválido para el campo ‘{fieldName}’
             // TODO: count quote characters to check if used correctly in translation; don't check position
-            return false;
+            return nullptr;
         }
 
         if (s_punct && !t_punct)
         {
-            item->SetIssue(CatalogItem::Issue::Warning,
-                           wxString::Format(_(L"The translation should end with “%s”."), wxString(wxUniChar(s_last))));
-            return true;
+            return Warning(wxString::Format(_(L"The translation should end with “%s”."), wxString(wxUniChar(s_last))));
         }
         else if (!s_punct && t_punct)
         {
@@ -373,9 +400,7 @@ public:
             }
             else
             {
-                item->SetIssue(CatalogItem::Issue::Warning,
-                               wxString::Format(_(L"The translation should not end with “%s”."), wxString(wxUniChar(t_last))));
-                return true;
+                return Warning(wxString::Format(_(L"The translation should not end with “%s”."), wxString(wxUniChar(t_last))));
             }
         }
         else if (s_punct && t_punct && s_last != t_last)
@@ -384,7 +409,7 @@ public:
             {
                 // as a special case, allow translating ... (3 dots) as … (ellipsis)
             }
-            else if (u_hasBinaryProperty(s_last, UCHAR_QUOTATION_MARK) && u_hasBinaryProperty(t_last, UCHAR_QUOTATION_MARK))
+            else if (sourceLast.is(CharInfo::Quote) && s.translationLast.is(CharInfo::Quote))
             {
                 // don't check for correct quotes for now, accept any quotations marks as equal
             }
@@ -394,25 +419,15 @@ public:
             }
             else
             {
-                item->SetIssue(CatalogItem::Issue::Warning,
-                               wxString::Format(_(L"The translation ends with “%s”, but the source text ends with “%s”."),
+                return Warning(wxString::Format(_(L"The translation ends with “%s”, but the source text ends with “%s”."),
                                                 wxString(wxUniChar(t_last)), wxString(wxUniChar(s_last))));
-                return true;
             }
         }
 
-        return false;
+        return nullptr;
     }
 
 private:
-    bool IsPunctuation(UChar32 c) const
-    {
-        return u_hasBinaryProperty(c, UCHAR_TERMINAL_PUNCTUATION) ||
-               u_hasBinaryProperty(c, UCHAR_QUOTATION_MARK) ||
-               c == L'…' ||  // somehow U+2026 ellipsis is not terminal punctuation
-               c == L'⋯';    // ...or Chinese U+22EF
-    }
-
     bool IsEquivalent(UChar32 src, UChar32 trans) const
     {
         if (src == trans)
@@ -514,30 +529,90 @@ private:
 // QACheck support code
 // -------------------------------------------------------------
 
-bool QACheck::CheckItem(CatalogItemPtr item)
+namespace
 {
-    if (!item->GetTranslation().empty() && CheckString(item, item->GetString(), item->GetTranslation()))
-        return true;
 
-    if (item->HasPlural())
+// Classification of ASCII characters, so that ICU doesn't have to be
+// consulted for the vast majority of strings' ends:
+struct ASCIIClassTable
+{
+    uint8_t flags[128];
+
+    ASCIIClassTable()
+    {
+        for (UChar32 c = 0; c < 128; c++)
+            flags[c] = ClassifyWithICU(c);
+    }
+
+    static uint8_t ClassifyWithICU(UChar32 c)
     {
-        unsigned count = item->GetNumberOfTranslations();
-        for (unsigned i = 1; i < count; i++)
+        typedef QACheck::CharInfo CI;
+        uint8_t f = 0;
+        if (u_isspace(c))
+            f |= CI::Space;
+        if (u_isupper(c))
+            f |= CI::Upper;
+        if (u_islower(c))
+            f |= CI::Lower;
+        const bool quote = u_hasBinaryProperty(c, UCHAR_QUOTATION_MARK);
+        if (quote)
+            f |= CI::Quote;
+        if (quote ||
+            u_hasBinaryProperty(c, UCHAR_TERMINAL_PUNCTUATION) ||
+            c == L'…' ||  // somehow U+2026 ellipsis is not terminal punctuation
+            c == L'⋯')    // ...or Chinese U+22EF
         {
-            auto t = item->GetTranslation(i);
-            if (!t.empty() && CheckString(item, item->GetPluralString(), t))
-                return true;
+            f |= CI::Punctuation;
         }
+        if (u_getIntPropertyValue(c, UCHAR_BIDI_PAIRED_BRACKET_TYPE) == U_BPT_CLOSE)
+            f |= CI::CloseBracket;
+        return f;
     }
+};
+
+} // anonymous namespace
+
+
+QACheck::CharInfo::CharInfo(UChar32 c_) : c(c_)
+{
+    static const ASCIIClassTable s_ascii;
+    flags = (c >= 0 && c < 128) ? s_ascii.flags[c] : ASCIIClassTable::ClassifyWithICU(c);
+}
 
-    return false;
+
+QACheck::StringPair::StringPair(const wxString& source_, const wxString& translation_)
+    : source(source_), translation(translation_)
+{
+    if (!source.empty())
+    {
+        sourceFirst = CharInfo(source[0]);
+        sourceLast = CharInfo(source.Last());
+        if (source.length() >= 2)
+            sourceSecond = CharInfo(source[1]);
+    }
+    if (!translation.empty())
+    {
+        translationFirst = CharInfo(translation[0]);
+        translationLast = CharInfo(translation.Last());
+    }
 }
 
 
-bool QACheck::CheckString(CatalogItemPtr /*item*/, const wxString& /*source*/, const wxString& /*translation*/)
+QACheck::IssuePtr QACheck::CheckItem(const CatalogItemSnapshot& item, const StringPairs& strings)
+{
+    for (auto& s: strings)
+    {
+        if (auto issue = CheckString(item, s))
+            return issue;
+    }
+    return nullptr;
+}
+
+
+QACheck::IssuePtr QACheck::CheckString(const CatalogItemSnapshot& /*item*/, const StringPair& /*s*/)
 {
     wxFAIL_MSG("not implemented - must override CheckString OR CheckItem");
-    return false;
+    return nullptr;
 }
 
 
@@ -556,7 +631,11 @@ QAChecker::~QAChecker()
 
 std::shared_ptr<QAChecker> QAChecker::GetFor(Catalog& catalog)
 {
-    auto lang = catalog.GetLanguage();
+    return GetFor(catalog.GetLanguage());
+}
+
+std::shared_ptr<QAChecker> QAChecker::GetFor(const Language& lang)
+{
     auto c = std::make_shared<QAChecker>();
 
     #define qa_instantiate(klass) c->AddCheck<klass>(lang);
@@ -577,33 +656,85 @@ std::vector<std::pair<std::string, wxString>> QAChecker::GetMetadata()
 
 
 
+namespace
+{
+
+// Catalogs with fewer items are checked on the calling thread only
+const size_t MIN_PARALLEL_CHECK_ITEMS = 1000;
+
+// Number of items checked by a single task
+const size_t CHECK_CHUNK_SIZE = 256;
+
+} // anonymous namespace
+
+
 int QAChecker::Check(Catalog& catalog)
 {
-    int issues = 0;
+    return Check(catalog.items());
+}
+
 
-    for (auto& i: catalog.items())
-        issues += Check(i);
+int QAChecker::Check(const CatalogItemArray& items)
+{
+    TRACE_SPAN("qa", "Check");
+    const size_t count = items.size();
+    Progress progress((int)count);
+
+    if (count < MIN_PARALLEL_CHECK_ITEMS)
+    {
+        int issues = 0;
+        for (auto& i: items)
+        {
+            issues += Check(i);
+            progress.increment();
+        }
+        return issues;
+    }
 
-    return issues;
+    // The checks don't have any mutable state and each item is only checked
+    // (and its issue set) by one task, so items can be safely partitioned:
+    dispatch::parallel_options options;
+    options.chunk_size = CHECK_CHUNK_SIZE;
+    options.progress = &progress;
+    return dispatch::parallel_reduce(count, 0,
+                                     [&](size_t i){ return Check(items[i]); },
+                                     std::plus<int>(),
+                                     options);
 }
 
 
 int QAChecker::Check(CatalogItemPtr item)
 {
-    int issues = 0;
+    auto issue = Check(*item->GetSnapshot());
+    if (!issue)
+        return 0;
 
-    for (auto& c: m_checks)
+    item->SetIssue(issue);
+    return 1;
+}
+
+
+QACheck::IssuePtr QAChecker::Check(const CatalogItemSnapshot& item) const
+{
+    if (item.GetString().empty() || (item.HasPlural() && item.GetPluralString().empty()))
+        return nullptr;
+
+    // Classify the strings once, all checks then share it:
+    QACheck::StringPairs strings;
+    auto& translations = item.GetTranslations();
+    strings.reserve(translations.size());
+    for (size_t i = 0; i < translations.size(); i++)
     {
-        if (item->GetString().empty() || (item->HasPlural() && item->GetPluralString().empty()))
-            continue;
+        if (!translations[i].empty())
+            strings.emplace_back(i == 0 ? item.GetString() : item.GetPluralString(), translations[i]);
+    }
 
-        if (c->CheckItem(item))
-        {
-            issues++;
-            // we only record single issue, so there's no point in continuing with other checks:
-            break;
-        }
+    for (auto& c: m_checks)
+    {
+        // we only record single issue, so there's no point in continuing with other checks:
+        if (auto issue = c->CheckItem(item, strings))
+            return issue;
     }
 
-    return issues;
+    return nullptr;
 }
@@ -28,14 +28,61 @@
 
 #include "catalog.h"
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+#include <unicode/umachine.h>
+
 
 /// Interface for implementing quality checks
 class QACheck
 {
 public:
+    /// Character with its pre-computed classification
+    struct CharInfo
+    {
+        enum Flags : uint8_t
+        {
+            Space        = 0x01,
+            Upper        = 0x02,
+            Lower        = 0x04,
+            Punctuation  = 0x08, ///< terminal punctuation, quotation marks or ellipsis
+            Quote        = 0x10,
+            CloseBracket = 0x20
+        };
+
+        CharInfo() {}
+        explicit CharInfo(UChar32 c);
+
+        bool is(Flags f) const { return (flags & f) != 0; }
+
+        UChar32 c = 0;
+        uint8_t flags = 0;
+    };
+
+    /**
+        Source and translation to check, with their ends already classified.
+
+        Most checks only look at the first and last characters of the strings;
+        classifying them once and sharing the result between checks avoids
+        repeated ICU property lookups.
+     */
+    struct StringPair
+    {
+        StringPair(const wxString& source_, const wxString& translation_);
+
+        const wxString& source;
+        const wxString& translation;
+        CharInfo sourceFirst, sourceSecond, sourceLast;
+        CharInfo translationFirst, translationLast;
+    };
+
+    /// All non-empty translations of an item, paired with corresponding source strings
+    typedef std::vector<StringPair> StringPairs;
+
+    typedef std::shared_ptr<CatalogItem::Issue> IssuePtr;
+
     virtual ~QACheck() {}
 
     // Informal protocol for metadata:
@@ -47,13 +94,21 @@ public:
     // it doesn't have to implement all of them.
 
     /**
-        Checks given item for issues, possibly calling CatalogItem::SetIssue()
-        to flag it as broken. Returns true if an issue was found, false otherwise.
+        Checks given item for issues. Returns the issue found, or nullptr
+        if there's none.
+
+        The item is a snapshot, so checks may run on any thread regardless
+        of changes made to the catalog in the meantime. @a strings are
+        the item's strings, prepared once for all checks.
      */
-    virtual bool CheckItem(CatalogItemPtr item);
+    virtual IssuePtr CheckItem(const CatalogItemSnapshot& item, const StringPairs& strings);
 
     /// A more convenient API, checking only strings
-    virtual bool CheckString(CatalogItemPtr item, const wxString& source, const wxString& translation);
+    virtual IssuePtr CheckString(const CatalogItemSnapshot& item, const StringPair& s);
+
+protected:
+    static IssuePtr Warning(const wxString& message)
+        { return std::make_shared<CatalogItem::Issue>(CatalogItem::Issue::Warning, message); }
 };
 
 
@@ -63,6 +118,7 @@ class QAChecker
 public:
     /// Returns checker suitable for given file
     static std::shared_ptr<QAChecker> GetFor(Catalog& catalog);
+    static std::shared_ptr<QAChecker> GetFor(const Language& lang);
 
     /// Returns metadata for the available checkers, as (id,description) pairs
     static std::vector<std::pair<std::string, wxString>> GetMetadata();
@@ -70,9 +126,16 @@ public:
     /// Checks all items. Returns # of issues found.
     int Check(Catalog& catalog);
 
+    /// Checks given subset of catalog's items. Returns # of issues found.
+    int Check(const CatalogItemArray& items);
+
     /// Check a single item. Returns # of issues found.
     int Check(CatalogItemPtr item);
 
+    /// Checks item's snapshot without modifying it, returns the issue found, if any.
+    /// Thread-safe, can be used from background threads.
+    QACheck::IssuePtr Check(const CatalogItemSnapshot& item) const;
+
     // Low-level creation and setup:
 
     QAChecker();
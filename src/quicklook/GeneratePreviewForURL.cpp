@@ -61,7 +61,7 @@ CFDataRef CreateHTMLDataForURL(CFURLRef url, CFStringRef contentTypeUTI)
 
     try
     {
-        auto cat = Catalog::Create(path.AsString());
+        auto cat = Catalog::Create(path.AsString(), Catalog::CreationFlag_Preview);
 
         std::ostringstream s;
         cat->ExportToHTML(s);
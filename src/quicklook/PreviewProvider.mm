@@ -74,7 +74,8 @@ void cleanup_extension()
 
 NSData *create_html_preview(const wxString& filename)
 {
-    auto cat = Catalog::Create(filename);
+    // only the beginning of large files is loaded, so that previews appear quickly:
+    auto cat = Catalog::Create(filename, Catalog::CreationFlag_Preview);
 
     std::ostringstream s;
     cat->ExportToHTML(s);
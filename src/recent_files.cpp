@@ -25,9 +25,12 @@
 
 #include "recent_files.h"
 
+#include "catalog_cache.h"
 #include "colorscheme.h"
+#include "concurrency.h"
 #include "edapp.h"
 #include "hidpi.h"
+#include "language.h"
 #include "str_helpers.h"
 #include "unicode_helpers.h"
 #include "utility.h"
@@ -575,6 +578,8 @@ void RecentFiles::MacTransferMenuTo(wxMenuBar *bar)
 struct RecentFilesCtrl::data
 {
     std::vector<wxFileName> files;
+    // incremented on every refresh, so that outdated details are discarded:
+    int generation = 0;
 #ifndef __WXOSX__
     file_icons_ptr icons_cache;
 #endif
@@ -629,6 +634,75 @@ void RecentFilesCtrl::RefreshContent()
 
         AppendFormattedItem(icon, f.GetFullName(), pretty_print_path(f));
     }
+
+    LoadDetails();
+}
+
+void RecentFilesCtrl::LoadDetails()
+{
+    struct Details
+    {
+        bool exists = false;
+        bool loaded = false;
+        CatalogCache::Info info;
+    };
+
+    // Files may be on slow network drives and loading statistics of files
+    // that aren't cached may take a while, so never do it on the UI thread:
+    const int generation = ++m_data->generation;
+    auto files = m_data->files;
+    dispatch::async([files]
+    {
+        std::vector<Details> details(files.size());
+        dispatch::parallel_for(files.size(), [&](size_t i)
+        {
+            wxLogNull null;
+            auto& d = details[i];
+            d.exists = files[i].FileExists();
+            if (!d.exists)
+                return;
+            try
+            {
+                d.info = CatalogCache::Get().GetInfo(files[i].GetFullPath());
+                d.loaded = true;
+            }
+            catch (...)
+            {
+                // not worth showing, it will be reported if the user opens the file
+            }
+        });
+        return details;
+    })
+    .then_on_window(this, [=](std::vector<Details> details)
+    {
+        if (generation != m_data->generation)
+            return;
+
+        for (size_t i = 0; i < details.size(); i++)
+        {
+            auto& f = m_data->files[i];
+            auto& d = details[i];
+
+            wxString description = pretty_print_path(f);
+            if (!d.exists)
+            {
+                description += L"  •  ";
+                description += _("File not found");
+            }
+            else if (d.loaded && !d.info.language.empty())
+            {
+                const int all = d.info.all;
+                const int percent = (all == 0) ? 0 : (100 * (all - d.info.unfinished) / all);
+                description += L"  •  ";
+                description += Language::FromLanguageTag(d.info.language).DisplayName();
+                description += L"  •  ";
+                // TRANSLATORS: Completion of translation in the list of recent files
+                description += wxString::Format(_("%d%% translated"), percent);
+            }
+
+            UpdateFormattedItem((unsigned)i, f.GetFullName(), description);
+        }
+    });
 }
 
 void RecentFilesCtrl::OnActivate(wxDataViewEvent& event)
@@ -87,6 +87,9 @@ private:
     void RefreshContent();
     void OnActivate(wxDataViewEvent& event);
 
+    /// Fills in details of the files loaded in the background
+    void LoadDetails();
+
     struct data;
     std::unique_ptr<data> m_data;
 };
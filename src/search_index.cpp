@@ -0,0 +1,202 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "search_index.h"
+
+#include "concurrency.h"
+#include "unicode_helpers.h"
+
+#include <unicode/uchar.h>
+
+#include <algorithm>
+
+
+namespace
+{
+
+// Remove mnemonic character @a mnemonic if followed by a word character,
+// i.e. the equivalent of replacing "&(\w)" with "$1"
+void StripMnemonic(wxString& str, wchar_t mnemonic)
+{
+    if (str.find(mnemonic) == wxString::npos)
+        return;
+
+    wxString out;
+    out.reserve(str.length());
+    for (auto i = str.begin(); i != str.end(); ++i)
+    {
+        const wchar_t c = *i;
+        if (c == mnemonic)
+        {
+            auto next = i + 1;
+            if (next != str.end())
+            {
+                const wchar_t n = *next;
+                if (n == '_' || u_isalnum(n))
+                {
+                    out += n;
+                    i = next;
+                    continue;
+                }
+            }
+        }
+        out += c;
+    }
+    str.swap(out);
+}
+
+void StripMnemonics(wxString& str, const CatalogSearchIndex::Options& options)
+{
+    if (options.ignoreAmp)
+        StripMnemonic(str, '&');
+    if (options.ignoreUnderscore)
+        StripMnemonic(str, '_');
+}
+
+// Number of items indexed by a single task when building the entire index
+const size_t INDEX_CHUNK_SIZE = 512;
+
+} // anonymous namespace
+
+
+wxString CatalogSearchIndex::Normalize(const wxString& text, const Options& options)
+{
+    if (text.empty())
+        return text;
+
+    wxString str(text);
+    if (options.ignoreCase)
+    {
+        // ASCII-only texts, the most common case, don't need ICU's help:
+        if (unicode::is_ascii(str))
+            unicode::ascii_fold_case_inplace(str);
+        else
+            str = unicode::fold_case(str);
+    }
+    StripMnemonics(str, options);
+    return str;
+}
+
+
+CatalogSearchIndex::EntryPtr CatalogSearchIndex::CreateEntry(const CatalogItemPtr& item) const
+{
+    auto ptr = std::make_shared<Entry>();
+    auto& e = *ptr;
+
+    if (m_options.ignoreCase)
+    {
+        // Case folding is the expensive part, so use the item's cached folded
+        // texts (shared with e.g. the list filter) and only strip mnemonics:
+        auto folded = item->GetFoldedTexts();
+        auto strip = [=](wxString str)
+        {
+            StripMnemonics(str, m_options);
+            return str;
+        };
+
+        for (auto& t: folded->translations)
+            e.translations.push_back(strip(t));
+
+        e.string = strip(folded->string);
+        e.pluralString = strip(folded->pluralString);
+        e.context = strip(folded->context);
+        e.symbolicId = strip(folded->symbolicId);
+
+        e.comment = folded->comment;
+        e.extractedComments.assign(folded->extractedComments.begin(), folded->extractedComments.end());
+    }
+    else
+    {
+        for (auto& t: item->GetTranslations())
+            e.translations.push_back(Normalize(t, m_options));
+
+        e.string = Normalize(item->GetString(), m_options);
+        e.pluralString = item->HasPlural() ? Normalize(item->GetPluralString(), m_options) : wxString();
+        e.context = Normalize(item->GetContext(), m_options);
+        e.symbolicId = Normalize(item->GetSymbolicId(), m_options);
+
+        e.comment = item->GetComment();
+        for (auto& c: item->GetExtractedComments())
+            e.extractedComments.push_back(c);
+    }
+
+    e.item = item;
+    e.revision = item->GetRevision();
+
+    return ptr;
+}
+
+
+void CatalogSearchIndex::Prepare(const Options& options)
+{
+    auto& items = m_catalog->items();
+    if (m_prepared && options == m_options && m_entries.size() == items.size())
+        return;
+
+    m_options = options;
+    m_entries.clear();
+    m_entries.resize(items.size());
+
+    // Each entry is written by exactly one task and items aren't modified
+    // while this runs (the main thread is the only one modifying them and
+    // it participates in the work here):
+    const size_t count = items.size();
+    const size_t chunks = (count + INDEX_CHUNK_SIZE - 1) / INDEX_CHUNK_SIZE;
+    dispatch::parallel_for(chunks, [&](size_t n)
+    {
+        const size_t end = std::min((n + 1) * INDEX_CHUNK_SIZE, count);
+        for (size_t i = n * INDEX_CHUNK_SIZE; i < end; i++)
+            m_entries[i] = CreateEntry(items[i]);
+    });
+
+    m_prepared = true;
+}
+
+
+const CatalogSearchIndex::Entry& CatalogSearchIndex::Get(size_t n)
+{
+    wxASSERT( m_prepared );
+
+    auto& items = m_catalog->items();
+    if (m_entries.size() != items.size())
+        m_entries.resize(items.size());
+
+    auto& e = m_entries[n];
+    auto& item = items[n];
+    if (!e || e->item != item || e->revision != item->GetRevision())
+        e = CreateEntry(item);
+
+    return *e;
+}
+
+
+std::shared_ptr<const CatalogSearchIndex::Snapshot> CatalogSearchIndex::TakeSnapshot()
+{
+    const size_t count = m_catalog->items().size();
+    for (size_t i = 0; i < count; i++)
+        Get(i);
+
+    return std::make_shared<Snapshot>(m_entries);
+}
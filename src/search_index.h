@@ -0,0 +1,117 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_search_index_h
+#define Poedit_search_index_h
+
+#include "catalog.h"
+
+#include <memory>
+#include <vector>
+
+
+/**
+    Catalog's texts prepared for searching.
+
+    Searching needs to compare case-folded text with mnemonics (&, _) removed,
+    which is too expensive to do for every item each time the user searches.
+    The index keeps the normalized texts of all items, builds them in parallel
+    on first use and updates individual entries when their items change.
+
+    The index is only ever accessed from the main thread, the same thread
+    that modifies the items. Entries are immutable once created, though, so
+    a snapshot of them may be searched by background tasks.
+ */
+class CatalogSearchIndex
+{
+public:
+    /// How are texts normalized for searching
+    struct Options
+    {
+        bool ignoreCase = false;
+        bool ignoreAmp = false;
+        bool ignoreUnderscore = false;
+
+        bool operator==(const Options& o) const
+            { return ignoreCase == o.ignoreCase && ignoreAmp == o.ignoreAmp && ignoreUnderscore == o.ignoreUnderscore; }
+        bool operator!=(const Options& o) const { return !(*this == o); }
+    };
+
+    /// Normalized texts of a single item
+    struct Entry
+    {
+        std::vector<wxString> translations;
+        wxString string, pluralString, context, symbolicId;
+
+        // mnemonics are never ignored in comments:
+        wxString comment;
+        std::vector<wxString> extractedComments;
+
+        /// The item this entry was created from
+        const CatalogItemPtr& GetItem() const { return item; }
+
+    private:
+        friend class CatalogSearchIndex;
+        CatalogItemPtr item;
+        unsigned revision = 0;
+    };
+
+    typedef std::shared_ptr<const Entry> EntryPtr;
+    typedef std::vector<EntryPtr> Snapshot;
+
+    explicit CatalogSearchIndex(const CatalogPtr& catalog) : m_catalog(catalog), m_prepared(false) {}
+
+    /**
+        Makes the index use given normalization options.
+
+        Rebuilds all entries, in parallel, if the index wasn't used yet or was
+        built with different options. Does nothing otherwise.
+     */
+    void Prepare(const Options& options);
+
+    /// Returns entry for n-th item in the catalog, updating it if the item changed.
+    const Entry& Get(size_t n);
+
+    /**
+        Returns up-to-date entries of all items, safe to use from other threads.
+
+        Must be called after Prepare(). Subsequent changes to the items are
+        not reflected in the returned snapshot.
+     */
+    std::shared_ptr<const Snapshot> TakeSnapshot();
+
+    /// Normalize text according to given options.
+    static wxString Normalize(const wxString& text, const Options& options);
+
+private:
+    EntryPtr CreateEntry(const CatalogItemPtr& item) const;
+
+    CatalogPtr m_catalog;
+    Options m_options;
+    bool m_prepared;
+    Snapshot m_entries;
+};
+
+#endif // Poedit_search_index_h
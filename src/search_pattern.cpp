@@ -0,0 +1,887 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "search_pattern.h"
+
+#include "errors.h"
+
+#include <wx/intl.h>
+
+#include <unicode/uchar.h>
+
+#include <algorithm>
+#include <limits>
+
+
+namespace
+{
+
+// Limits on compiled regexes, to keep both memory use and matching time sane
+const size_t MAX_PROGRAM_SIZE = 10000;
+const int MAX_REPEAT_COUNT = 1000;
+
+const int REPEAT_INFINITE = -1;
+
+inline bool IsWordChar(wchar_t c)
+{
+    return c == '_' || u_isalnum(c);
+}
+
+inline wchar_t FoldChar(wchar_t c)
+{
+    return (wchar_t)u_foldCase(c, U_FOLD_CASE_DEFAULT);
+}
+
+[[noreturn]] void ThrowInvalid(const wxString& reason)
+{
+    BOOST_THROW_EXCEPTION(Exception(wxString::Format(_("Invalid regular expression: %s"), reason)));
+}
+
+
+// Character class, either [...] or one of the \d, \w etc. shorthands
+struct CharClass
+{
+    enum Property
+    {
+        Digit,
+        Word,
+        Space
+    };
+
+    struct PropertyItem
+    {
+        Property property;
+        bool negated;
+    };
+
+    bool negated = false;
+    std::vector<std::pair<wchar_t, wchar_t>> ranges;
+    std::vector<PropertyItem> properties;
+
+    bool Contains(wchar_t c) const
+    {
+        for (auto& r: ranges)
+        {
+            if (c >= r.first && c <= r.second)
+                return true;
+        }
+        for (auto& p: properties)
+        {
+            bool has = false;
+            switch (p.property)
+            {
+                case Digit: has = u_isdigit(c); break;
+                case Word:  has = IsWordChar(c); break;
+                case Space: has = u_isspace(c); break;
+            }
+            if (has != p.negated)
+                return true;
+        }
+        return false;
+    }
+
+    bool Matches(wchar_t c, bool ignoreCase) const
+    {
+        // case-folded text is (mostly) lowercase, so check uppercase too to
+        // make e.g. [A-Z] work as expected:
+        bool in = Contains(c) || (ignoreCase && Contains((wchar_t)u_toupper(c)));
+        return in != negated;
+    }
+};
+
+
+// Parsed regular expression
+struct Node
+{
+    enum Type
+    {
+        Empty,
+        Char,
+        Any,
+        Class,
+        LineStart,
+        LineEnd,
+        WordBoundary,
+        NotWordBoundary,
+        Concat,
+        Alternation,
+        Repeat
+    };
+
+    explicit Node(Type t) : type(t) {}
+
+    Type type;
+    wchar_t c = 0;
+    size_t cls = 0;
+    int min = 0, max = 0;
+    bool greedy = true;
+    std::vector<std::unique_ptr<Node>> children;
+};
+
+typedef std::unique_ptr<Node> NodePtr;
+
+
+class Parser
+{
+public:
+    Parser(const wchar_t *pattern, size_t length, bool ignoreCase, std::vector<CharClass>& classes)
+        : m_p(pattern), m_end(pattern + length), m_ignoreCase(ignoreCase), m_classes(classes) {}
+
+    NodePtr Parse()
+    {
+        auto n = ParseAlternation();
+        if (m_p != m_end)
+        {
+            wxASSERT( *m_p == ')' );
+            ThrowInvalid(_("unmatched closing parenthesis"));
+        }
+        return n;
+    }
+
+private:
+    NodePtr ParseAlternation()
+    {
+        auto first = ParseConcat();
+        if (m_p == m_end || *m_p != '|')
+            return first;
+
+        auto alt = std::make_unique<Node>(Node::Alternation);
+        alt->children.push_back(std::move(first));
+        while (m_p != m_end && *m_p == '|')
+        {
+            m_p++;
+            alt->children.push_back(ParseConcat());
+        }
+        return alt;
+    }
+
+    NodePtr ParseConcat()
+    {
+        auto concat = std::make_unique<Node>(Node::Concat);
+        while (m_p != m_end && *m_p != '|' && *m_p != ')')
+            concat->children.push_back(ParseRepeat());
+
+        if (concat->children.empty())
+            return std::make_unique<Node>(Node::Empty);
+        if (concat->children.size() == 1)
+            return std::move(concat->children.front());
+        return concat;
+    }
+
+    NodePtr ParseRepeat()
+    {
+        auto atom = ParseAtom();
+
+        int min, max;
+        if (!ParseQuantifier(min, max))
+            return atom;
+
+        switch (atom->type)
+        {
+            case Node::LineStart:
+            case Node::LineEnd:
+            case Node::WordBoundary:
+            case Node::NotWordBoundary:
+                ThrowInvalid(_("nothing to repeat"));
+            default:
+                break;
+        }
+
+        auto rep = std::make_unique<Node>(Node::Repeat);
+        rep->min = min;
+        rep->max = max;
+        if (m_p != m_end && *m_p == '?')
+        {
+            rep->greedy = false;
+            m_p++;
+        }
+        rep->children.push_back(std::move(atom));
+        return rep;
+    }
+
+    bool ParseQuantifier(int& min, int& max)
+    {
+        if (m_p == m_end)
+            return false;
+
+        switch (*m_p)
+        {
+            case '*': min = 0; max = REPEAT_INFINITE; m_p++; return true;
+            case '+': min = 1; max = REPEAT_INFINITE; m_p++; return true;
+            case '?': min = 0; max = 1;               m_p++; return true;
+            case '{': break;
+            default:  return false;
+        }
+
+        // {n}, {n,} or {n,m}; anything else is taken literally, as in ECMAScript
+        auto p = m_p + 1;
+        if (!ParseNumber(p, min))
+            return false;
+        max = min;
+        if (p != m_end && *p == ',')
+        {
+            p++;
+            if (p != m_end && *p == '}')
+                max = REPEAT_INFINITE;
+            else if (!ParseNumber(p, max))
+                return false;
+        }
+        if (p == m_end || *p != '}')
+            return false;
+
+        if (max != REPEAT_INFINITE && max < min)
+            ThrowInvalid(_("invalid repetition count"));
+        if (min > MAX_REPEAT_COUNT || max > MAX_REPEAT_COUNT)
+            ThrowInvalid(_("repetition count is too large"));
+
+        m_p = p + 1;
+        return true;
+    }
+
+    bool ParseNumber(const wchar_t*& p, int& value)
+    {
+        if (p == m_end || *p < '0' || *p > '9')
+            return false;
+        value = 0;
+        while (p != m_end && *p >= '0' && *p <= '9')
+        {
+            value = std::min(value * 10 + (*p - '0'), MAX_REPEAT_COUNT + 1);
+            p++;
+        }
+        return true;
+    }
+
+    NodePtr ParseAtom()
+    {
+        const wchar_t c = *m_p++;
+        switch (c)
+        {
+            case '(':
+            {
+                if (m_end - m_p >= 2 && m_p[0] == '?' && m_p[1] == ':')
+                    m_p += 2;
+                else if (m_p != m_end && *m_p == '?')
+                    ThrowInvalid(_("unsupported group type"));
+
+                auto n = ParseAlternation();
+                if (m_p == m_end)
+                    ThrowInvalid(_("missing closing parenthesis"));
+                m_p++;
+                return n;
+            }
+
+            case '[':
+                return MakeClass(ParseClass());
+
+            case '.':
+                return std::make_unique<Node>(Node::Any);
+            case '^':
+                return std::make_unique<Node>(Node::LineStart);
+            case '$':
+                return std::make_unique<Node>(Node::LineEnd);
+
+            case '*':
+            case '+':
+            case '?':
+                ThrowInvalid(_("nothing to repeat"));
+
+            case '\\':
+            {
+                if (m_p == m_end)
+                    ThrowInvalid(_("trailing backslash"));
+                const wchar_t e = *m_p;
+                switch (e)
+                {
+                    case 'b': m_p++; return std::make_unique<Node>(Node::WordBoundary);
+                    case 'B': m_p++; return std::make_unique<Node>(Node::NotWordBoundary);
+                    default:
+                        break;
+                }
+                CharClass cls;
+                if (ParseClassEscape(cls))
+                    return MakeClass(std::move(cls));
+                return MakeChar(ParseCharEscape());
+            }
+
+            default:
+                return MakeChar(c);
+        }
+    }
+
+    NodePtr MakeChar(wchar_t c)
+    {
+        auto n = std::make_unique<Node>(Node::Char);
+        n->c = m_ignoreCase ? FoldChar(c) : c;
+        return n;
+    }
+
+    NodePtr MakeClass(CharClass&& cls)
+    {
+        auto n = std::make_unique<Node>(Node::Class);
+        n->cls = m_classes.size();
+        m_classes.push_back(std::move(cls));
+        return n;
+    }
+
+    // parses \d, \w etc.; m_p points after the backslash
+    bool ParseClassEscape(CharClass& cls)
+    {
+        CharClass::PropertyItem item;
+        switch (*m_p)
+        {
+            case 'd': item = {CharClass::Digit, false}; break;
+            case 'D': item = {CharClass::Digit, true};  break;
+            case 'w': item = {CharClass::Word,  false}; break;
+            case 'W': item = {CharClass::Word,  true};  break;
+            case 's': item = {CharClass::Space, false}; break;
+            case 'S': item = {CharClass::Space, true};  break;
+            default:
+                return false;
+        }
+        m_p++;
+        cls.properties.push_back(item);
+        return true;
+    }
+
+    // parses escaped character; m_p points after the backslash
+    wchar_t ParseCharEscape()
+    {
+        const wchar_t e = *m_p++;
+        switch (e)
+        {
+            case 'n': return '\n';
+            case 'r': return '\r';
+            case 't': return '\t';
+            case 'f': return '\f';
+            case 'v': return '\v';
+            case '0': return '\0';
+            case 'x': return ParseHex(2);
+            case 'u': return ParseHex(4);
+            default:
+                break;
+        }
+
+        if (e >= '1' && e <= '9')
+            ThrowInvalid(_("backreferences are not supported"));
+        if (IsWordChar(e))
+            ThrowInvalid(wxString::Format(_("unknown escape sequence \\%s"), wxString(e)));
+        return e; // escaped punctuation
+    }
+
+    wchar_t ParseHex(int digits)
+    {
+        unsigned value = 0;
+        for (int i = 0; i < digits; i++)
+        {
+            const wchar_t d = m_p != m_end ? (*m_p | 0x20) : 0;
+            if (d >= '0' && d <= '9')
+                value = value * 16 + (d - '0');
+            else if (d >= 'a' && d <= 'f')
+                value = value * 16 + (d - 'a' + 10);
+            else
+                ThrowInvalid(_("invalid hexadecimal escape sequence"));
+            m_p++;
+        }
+        return (wchar_t)value;
+    }
+
+    // parses [...]; m_p points after the opening bracket
+    CharClass ParseClass()
+    {
+        CharClass cls;
+        if (m_p != m_end && *m_p == '^')
+        {
+            cls.negated = true;
+            m_p++;
+        }
+
+        bool first = true;
+        for (;;)
+        {
+            if (m_p == m_end)
+                ThrowInvalid(_("missing closing bracket"));
+            if (*m_p == ']' && !first)
+            {
+                m_p++;
+                break;
+            }
+            first = false;
+
+            wchar_t from;
+            if (!ParseClassChar(cls, from))
+                continue; // was \d or similar
+
+            wchar_t to = from;
+            if (m_end - m_p >= 2 && m_p[0] == '-' && m_p[1] != ']')
+            {
+                m_p++;
+                if (!ParseClassChar(cls, to))
+                    ThrowInvalid(_("invalid character range"));
+                if (to < from)
+                    ThrowInvalid(_("invalid character range"));
+            }
+
+            if (m_ignoreCase)
+            {
+                // text is case-folded, so make the class match folded characters too
+                if (from == to)
+                    cls.ranges.emplace_back(FoldChar(from), FoldChar(from));
+            }
+            cls.ranges.emplace_back(from, to);
+        }
+
+        return cls;
+    }
+
+    bool ParseClassChar(CharClass& cls, wchar_t& c)
+    {
+        if (m_p == m_end)
+            ThrowInvalid(_("missing closing bracket"));
+        c = *m_p++;
+        if (c != '\\')
+            return true;
+
+        if (m_p == m_end)
+            ThrowInvalid(_("trailing backslash"));
+        if (ParseClassEscape(cls))
+            return false;
+        if (*m_p == 'b')
+        {
+            m_p++;
+            c = '\b';
+            return true;
+        }
+        c = ParseCharEscape();
+        return true;
+    }
+
+    const wchar_t *m_p, *m_end;
+    bool m_ignoreCase;
+    std::vector<CharClass>& m_classes;
+};
+
+} // anonymous namespace
+
+
+struct SearchPattern::Program
+{
+    enum Op
+    {
+        Char,
+        Any,
+        Class,
+        Split,      // continue at x, with lower priority at y
+        Jmp,
+        LineStart,
+        LineEnd,
+        WordBoundary,
+        NotWordBoundary,
+        Match
+    };
+
+    struct Inst
+    {
+        Op op;
+        wchar_t c;
+        size_t x, y;
+    };
+
+    std::vector<Inst> code;
+    std::vector<CharClass> classes;
+    bool ignoreCase = false;
+
+    void Compile(const Node& n)
+    {
+        switch (n.type)
+        {
+            case Node::Empty:
+                break;
+            case Node::Char:
+                Emit(Char, n.c);
+                break;
+            case Node::Any:
+                Emit(Any);
+                break;
+            case Node::Class:
+                Emit(Class, 0, n.cls);
+                break;
+            case Node::LineStart:
+                Emit(LineStart);
+                break;
+            case Node::LineEnd:
+                Emit(LineEnd);
+                break;
+            case Node::WordBoundary:
+                Emit(WordBoundary);
+                break;
+            case Node::NotWordBoundary:
+                Emit(NotWordBoundary);
+                break;
+
+            case Node::Concat:
+                for (auto& c: n.children)
+                    Compile(*c);
+                break;
+
+            case Node::Alternation:
+            {
+                std::vector<size_t> jumps;
+                for (size_t i = 0; i < n.children.size(); i++)
+                {
+                    const bool last = (i == n.children.size() - 1);
+                    size_t split = 0;
+                    if (!last)
+                        split = Emit(Split);
+                    Compile(*n.children[i]);
+                    if (!last)
+                    {
+                        jumps.push_back(Emit(Jmp));
+                        code[split].x = split + 1;
+                        code[split].y = code.size();
+                    }
+                }
+                for (auto j: jumps)
+                    code[j].x = code.size();
+                break;
+            }
+
+            case Node::Repeat:
+            {
+                auto& child = *n.children.front();
+                for (int i = 0; i < n.min; i++)
+                    Compile(child);
+
+                if (n.max == REPEAT_INFINITE)
+                {
+                    const size_t split = Emit(Split);
+                    Compile(child);
+                    Emit(Jmp, 0, split);
+                    SetSplit(split, split + 1, code.size(), n.greedy);
+                }
+                else
+                {
+                    std::vector<size_t> splits;
+                    for (int i = n.min; i < n.max; i++)
+                    {
+                        splits.push_back(Emit(Split));
+                        Compile(child);
+                    }
+                    for (auto s: splits)
+                        SetSplit(s, s + 1, code.size(), n.greedy);
+                }
+                break;
+            }
+        }
+    }
+
+    size_t Emit(Op op, wchar_t c = 0, size_t x = 0)
+    {
+        if (code.size() >= MAX_PROGRAM_SIZE)
+            ThrowInvalid(_("the expression is too complex"));
+        code.push_back({op, c, x, 0});
+        return code.size() - 1;
+    }
+
+    void SetSplit(size_t split, size_t preferred, size_t other, bool greedy)
+    {
+        code[split].x = greedy ? preferred : other;
+        code[split].y = greedy ? other : preferred;
+    }
+
+
+    // Pike VM: all possible threads of execution advance in lockstep, one
+    // character at a time. A list of threads is ordered by priority, so that
+    // the first thread to match is the one a backtracking matcher would find.
+    struct Thread
+    {
+        size_t pc;
+        size_t start;
+    };
+
+    struct ThreadList
+    {
+        explicit ThreadList(size_t size) : seen(size, 0) {}
+
+        std::vector<Thread> threads;
+        std::vector<unsigned> seen;
+        unsigned generation = 1;
+
+        void clear()
+        {
+            threads.clear();
+            generation++;
+        }
+    };
+
+    bool CheckAssertion(Op op, const wchar_t *text, size_t length, size_t pos) const
+    {
+        switch (op)
+        {
+            case LineStart:
+                return pos == 0 || text[pos - 1] == '\n';
+            case LineEnd:
+                return pos == length || text[pos] == '\n';
+            case WordBoundary:
+            case NotWordBoundary:
+            {
+                const bool before = pos > 0 && IsWordChar(text[pos - 1]);
+                const bool after = pos < length && IsWordChar(text[pos]);
+                return (before != after) == (op == WordBoundary);
+            }
+            default:
+                wxFAIL_MSG("not an assertion");
+                return false;
+        }
+    }
+
+    // follows empty transitions from @a pc and adds the resulting threads
+    void AddThread(ThreadList& list, std::vector<size_t>& stack, size_t pc, size_t start,
+                   const wchar_t *text, size_t length, size_t pos) const
+    {
+        stack.clear();
+        stack.push_back(pc);
+        while (!stack.empty())
+        {
+            pc = stack.back();
+            stack.pop_back();
+
+            if (list.seen[pc] == list.generation)
+                continue;
+            list.seen[pc] = list.generation;
+
+            auto& inst = code[pc];
+            switch (inst.op)
+            {
+                case Jmp:
+                    stack.push_back(inst.x);
+                    break;
+                case Split:
+                    stack.push_back(inst.y);
+                    stack.push_back(inst.x);
+                    break;
+                case LineStart:
+                case LineEnd:
+                case WordBoundary:
+                case NotWordBoundary:
+                    if (CheckAssertion(inst.op, text, length, pos))
+                        stack.push_back(pc + 1);
+                    break;
+                default:
+                    list.threads.push_back({pc, start});
+                    break;
+            }
+        }
+    }
+
+    SearchPattern::Match Run(const wchar_t *text, size_t length, size_t start) const
+    {
+        ThreadList current(code.size()), next(code.size());
+        std::vector<size_t> stack;
+
+        SearchPattern::Match match;
+        for (size_t pos = start; ; pos++)
+        {
+            // start new attempt at this position, with the lowest priority
+            if (!match)
+                AddThread(current, stack, 0, pos, text, length, pos);
+            else if (current.threads.empty())
+                break; // nothing could produce a better match
+
+            const wchar_t c = pos < length ? text[pos] : 0;
+            for (auto& t: current.threads)
+            {
+                auto& inst = code[t.pc];
+                bool advance = false;
+                switch (inst.op)
+                {
+                    case Char:
+                        advance = pos < length && c == inst.c;
+                        break;
+                    case Any:
+                        advance = pos < length && c != '\n';
+                        break;
+                    case Class:
+                        advance = pos < length && classes[inst.x].Matches(c, ignoreCase);
+                        break;
+                    case Match:
+                        match.pos = t.start;
+                        match.length = pos - t.start;
+                        break;
+                    default:
+                        break;
+                }
+
+                if (inst.op == Match)
+                    break; // lower priority threads can't win anymore
+                if (advance)
+                    AddThread(next, stack, t.pc + 1, t.start, text, length, pos + 1);
+            }
+
+            if (pos >= length)
+                break;
+
+            std::swap(current, next);
+            next.clear();
+        }
+
+        return match;
+    }
+};
+
+
+SearchPattern::SearchPattern(Syntax syntax, const wxString& pattern, bool ignoreCase)
+    : m_syntax(syntax), m_pattern(pattern), m_ignoreCase(ignoreCase)
+{
+    const std::wstring p = pattern.ToStdWstring();
+
+    switch (syntax)
+    {
+        case Syntax::RegularExpression:
+        {
+            m_program.reset(new Program);
+            m_program->ignoreCase = ignoreCase;
+            Parser parser(p.data(), p.length(), ignoreCase, m_program->classes);
+            auto tree = parser.Parse();
+            m_program->Compile(*tree);
+            m_program->Emit(Program::Match);
+            break;
+        }
+
+        case Syntax::Approximate:
+        {
+            m_approxText = p;
+            if (ignoreCase)
+            {
+                for (auto& c: m_approxText)
+                    c = FoldChar(c);
+            }
+            m_maxDistance = MaxEditDistance(m_approxText.length());
+            break;
+        }
+    }
+}
+
+
+SearchPattern::~SearchPattern()
+{
+}
+
+
+size_t SearchPattern::MaxEditDistance(size_t patternLength)
+{
+    // short words would match almost anything with even a single typo
+    return std::min(patternLength / 4, size_t(3));
+}
+
+
+SearchPattern::Match SearchPattern::Find(const wxString& text, size_t start) const
+{
+    const auto buf = text.wc_str();
+    const wchar_t *data = buf;
+    const size_t length = text.length();
+
+    if (start > length)
+        return Match();
+
+    switch (m_syntax)
+    {
+        case Syntax::RegularExpression:
+            return m_program->Run(data, length, start);
+        case Syntax::Approximate:
+            return FindApproximate(data, length, start);
+    }
+
+    return Match();
+}
+
+
+SearchPattern::Match SearchPattern::FindApproximate(const wchar_t *text, size_t length, size_t start) const
+{
+    // Sellers' algorithm: edit distance DP where a match may start anywhere
+    // in the text. Besides the cost, each cell tracks where its match started.
+    const size_t m = m_approxText.length();
+    if (m == 0)
+        return Match();
+
+    std::vector<size_t> cost(m + 1), from(m + 1), newCost(m + 1), newFrom(m + 1);
+    for (size_t i = 0; i <= m; i++)
+    {
+        cost[i] = i;
+        from[i] = start;
+    }
+
+    Match best;
+    size_t bestCost = std::numeric_limits<size_t>::max();
+
+    for (size_t j = start; j < length; j++)
+    {
+        const wchar_t c = text[j];
+        newCost[0] = 0;
+        newFrom[0] = j + 1;
+
+        for (size_t i = 1; i <= m; i++)
+        {
+            // substitution (or match)
+            size_t bestC = cost[i - 1] + (m_approxText[i - 1] == c ? 0 : 1);
+            size_t bestF = from[i - 1];
+            // text character inserted
+            if (cost[i] + 1 < bestC)
+            {
+                bestC = cost[i] + 1;
+                bestF = from[i];
+            }
+            // pattern character deleted
+            if (newCost[i - 1] + 1 < bestC)
+            {
+                bestC = newCost[i - 1] + 1;
+                bestF = newFrom[i - 1];
+            }
+            newCost[i] = bestC;
+            newFrom[i] = bestF;
+        }
+
+        std::swap(cost, newCost);
+        std::swap(from, newFrom);
+
+        if (best)
+        {
+            // extend the match found while it keeps getting better
+            if (cost[m] >= bestCost)
+                break;
+        }
+        else if (cost[m] > m_maxDistance)
+        {
+            continue;
+        }
+
+        bestCost = cost[m];
+        best.pos = from[m];
+        best.length = j + 1 - from[m];
+        if (bestCost == 0)
+            break;
+    }
+
+    return best;
+}
@@ -0,0 +1,109 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_search_pattern_h
+#define Poedit_search_pattern_h
+
+#include <wx/string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/**
+    Compiled non-literal search pattern: regular expression or approximate text.
+
+    Regular expressions are matched by simulating their NFA (the "Pike VM"),
+    so that matching time is always linear in the length of the text and
+    there's no exponential backtracking, regardless of the pattern. The
+    supported syntax is the common subset of Perl/ECMAScript regexes without
+    backreferences and lookaround: . [] [^] \d \w \s \D \W \S \b \B ^ $,
+    groups (including (?:...)), | and greedy or lazy * + ? {n,m}. ^ and $
+    match at line boundaries.
+
+    Approximate patterns match text that differs from the pattern by at most
+    MaxEditDistance() insertions, deletions or substitutions of characters.
+
+    Instances are immutable and may be used from several threads at once.
+ */
+class SearchPattern
+{
+public:
+    enum class Syntax
+    {
+        RegularExpression,
+        Approximate
+    };
+
+    struct Match
+    {
+        size_t pos = wxString::npos;
+        size_t length = 0;
+
+        explicit operator bool() const { return pos != wxString::npos; }
+    };
+
+    /**
+        Compiles the pattern.
+
+        If @a ignoreCase is set, the pattern only matches case-folded text
+        (see unicode::fold_case()), but matches it case-insensitively.
+
+        Throws Exception if the pattern is invalid.
+     */
+    SearchPattern(Syntax syntax, const wxString& pattern, bool ignoreCase);
+    ~SearchPattern();
+
+    SearchPattern(const SearchPattern&) = delete;
+    SearchPattern& operator=(const SearchPattern&) = delete;
+
+    Syntax GetSyntax() const { return m_syntax; }
+    const wxString& GetPattern() const { return m_pattern; }
+    bool IgnoresCase() const { return m_ignoreCase; }
+
+    /// Finds the first match that starts at or after @a start.
+    Match Find(const wxString& text, size_t start = 0) const;
+
+    /// Number of edits allowed by approximate pattern of given length.
+    static size_t MaxEditDistance(size_t patternLength);
+
+private:
+    Match FindApproximate(const wchar_t *text, size_t length, size_t start) const;
+
+    Syntax m_syntax;
+    wxString m_pattern;
+    bool m_ignoreCase;
+
+    // compiled regular expression
+    struct Program;
+    std::unique_ptr<Program> m_program;
+
+    // folded pattern for approximate matching
+    std::wstring m_approxText;
+    size_t m_maxDistance = 0;
+};
+
+#endif // Poedit_search_pattern_h
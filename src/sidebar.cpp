@@ -35,9 +35,11 @@
 #include "hidpi.h"
 #include "menus.h"
 #include "static_ids.h"
+#include "text_diff.h"
 #include "utility.h"
 #include "unicode_helpers.h"
 
+#include "tm/remote_tm.h"
 #include "tm/suggestions.h"
 #include "tm/transmem.h"
 
@@ -55,6 +57,26 @@
 #include <algorithm>
 
 
+namespace
+{
+
+// Bounds of the delay before querying suggestions when the user moves through
+// the list quickly; the actual delay adapts to how quickly they move, in ms:
+const long long MIN_SUGGESTIONS_DELAY = 100;
+const long long MAX_SUGGESTIONS_DELAY = 300;
+
+// Selection changes further apart than this aren't considered quick navigation:
+const long long NAVIGATION_INTERVAL_LIMIT = 1000;
+
+// How many of the first unfinished items to warm up the TM with after opening a file:
+const size_t WARMUP_ITEMS_COUNT = 20;
+
+// How long can a TM search take before its slower, fuzzy passes are skipped:
+const std::chrono::milliseconds SUGGESTIONS_TIME_BUDGET(500);
+
+} // anonymous namespace
+
+
 class SidebarSeparator : public wxWindow
 {
 public:
@@ -149,11 +171,68 @@ public:
 
     void Update(const CatalogItemPtr& item) override
     {
+        m_item = item;
+
+        // prepare diffs of the items likely to be shown next too:
+        auto srclang = m_parent->GetCurrentSourceLanguage();
+        for (auto& upcoming: m_parent->GetUpcomingItems())
+        {
+            if (upcoming->HasOldMsgid())
+                TextDiff::ComputeForOldMsgid(upcoming, srclang);
+        }
+
+        if (auto diff = TextDiff::GetCachedForOldMsgid(*item))
+        {
+            ShowDiff(*diff);
+            return;
+        }
+
+        // show just the old text until the diff is ready:
         m_text->SetAndWrapLabel(item->GetOldMsgid());
+
+        std::weak_ptr<SidebarBlock> weakSelf = shared_from_this();
+        TextDiff::ComputeForOldMsgid(item, srclang)
+        .then_on_main([weakSelf,item](TextDiffPtr diff)
+        {
+            auto self = std::static_pointer_cast<OldMsgidSidebarBlock>(weakSelf.lock());
+            if (!self || self->m_item != item || !diff)
+                return;
+            self->ShowDiff(*diff);
+            self->m_parent->Layout();
+        });
     }
 
 private:
+    void ShowDiff(const TextDiff& diff)
+    {
+        auto deleted = ColorScheme::Get(Color::DiffDeletedBg, m_text).GetAsString(wxC2S_HTML_SYNTAX);
+        auto inserted = ColorScheme::Get(Color::DiffInsertedBg, m_text).GetAsString(wxC2S_HTML_SYNTAX);
+
+        wxString text;
+        std::vector<AutoWrappingText::Highlight> highlights;
+        for (auto& s: diff.GetSegments())
+        {
+            switch (s.kind)
+            {
+                case TextDiff::Kind::Equal:
+                    break;
+                case TextDiff::Kind::Deleted:
+                    highlights.push_back({text.length(), text.length() + s.text.length(),
+                                          "<span bgcolor='" + deleted + "'><s>", "</s></span>"});
+                    break;
+                case TextDiff::Kind::Inserted:
+                    highlights.push_back({text.length(), text.length() + s.text.length(),
+                                          "<span bgcolor='" + inserted + "'>", "</span>"});
+                    break;
+            }
+            text += s.text;
+        }
+
+        m_text->SetAndWrapLabel(text, highlights);
+    }
+
     SelectableAutoWrappingText *m_text;
+    CatalogItemPtr m_item;
 };
 
 
@@ -346,7 +425,20 @@ public:
 
     void SetValue(int index, const Suggestion& s, Language lang, const wxString& icon, const wxString& tooltip)
     {
+        // Widgets are reused and suggestions arrive from several providers, so
+        // most of the time, many of them are already showing the same thing
+        // and re-wrapping and relayouting them would be wasted work:
+        const bool unchanged = m_hasValue && index == m_index && lang == m_lang &&
+                               s.text == m_value.text && s.score == m_value.score &&
+                               icon == m_iconName && tooltip == m_tooltip;
         m_value = s;
+        if (unchanged)
+            return;
+
+        m_hasValue = true;
+        m_index = index;
+        m_lang = lang;
+        m_tooltip = tooltip;
 
         int percent = int(100 * s.score);
         auto percentStr = wxString::Format("%d%%", percent);
@@ -367,7 +459,11 @@ public:
             m_info->SetLabel(percentStr);
         }
 
-        m_icon->SetBitmapName(icon);
+        if (icon != m_iconName)
+        {
+            m_icon->SetBitmapName(icon);
+            m_iconName = icon;
+        }
 
         if (m_isPerfect)
             m_isPerfect->GetContainingSizer()->Show(m_isPerfect, percent == 100);
@@ -523,6 +619,11 @@ private:
     Sidebar *m_sidebar;
     SuggestionsSidebarBlock *m_parentBlock;
     Suggestion m_value;
+    // what SetValue() was last called with, besides m_value:
+    bool m_hasValue = false;
+    int m_index = -1;
+    Language m_lang;
+    wxString m_iconName, m_tooltip;
     bool m_isHighlighted;
     StaticBitmap *m_icon;
     AutoWrappingText *m_text;
@@ -548,7 +649,8 @@ SuggestionsSidebarBlock::SuggestionsSidebarBlock(Sidebar *parent, wxMenu *menu)
       m_suggestionsSeparator(nullptr),
       m_pendingQueries(0),
       m_latestQueryId(0),
-      m_lastUpdateTime(0)
+      m_lastUpdateTime(0),
+      m_navigationInterval(NAVIGATION_INTERVAL_LIMIT)
 {
     m_provider.reset(new SuggestionsProvider);
 }
@@ -665,7 +767,15 @@ void SuggestionsSidebarBlock::UpdateSuggestions(const SuggestionsList& hits)
     for (auto& h: hits)
     {
         // empty entries screw up menus (treated as stock items), don't use them:
-        if (!h.text.empty())
+        if (h.text.empty())
+            continue;
+
+        // final results of a query include its earlier partial results:
+        auto existing = std::find_if(m_suggestions.begin(), m_suggestions.end(),
+                                     [&h](const Suggestion& s){ return s.source == h.source && s.text == h.text; });
+        if (existing != m_suggestions.end())
+            *existing = h;
+        else
             m_suggestions.push_back(h);
     }
 
@@ -734,6 +844,7 @@ void SuggestionsSidebarBlock::BuildSuggestionsMenu(int count)
 
         m_suggestionsMenuItems.push_back(item);
         menu->Append(item);
+        m_suggestionsMenuAttached++;
 
         m_suggestionsMenu->Bind(wxEVT_MENU, [this,i,menu](wxCommandEvent&){
             if (i >= (int)m_suggestions.size())
@@ -744,11 +855,44 @@ void SuggestionsSidebarBlock::BuildSuggestionsMenu(int count)
             menu->GetWindow()->ProcessWindowEvent(event);
         }, item->GetId());
     }
+
+    menu->Bind(wxEVT_MENU_OPEN, [this](wxMenuEvent& e){
+        e.Skip();
+        if (e.GetMenu() == m_suggestionsMenu)
+            RefreshSuggestionsMenu();
+    });
 }
 
 void SuggestionsSidebarBlock::UpdateSuggestionsMenu()
 {
-    ClearSuggestionsMenu();
+    auto m = m_suggestionsMenu;
+    if (!m)
+        return;
+
+    // Labels are only needed when the user looks at the menu, so updating
+    // them is deferred until then, but the items must be present for their
+    // shortcuts to work. Superfluous items are harmless (they do nothing if
+    // there's no corresponding suggestion) and are removed when the menu is
+    // shown, so that navigating between items doesn't churn the menu:
+    const size_t count = std::min(m_suggestions.size(), (size_t)SUGGESTIONS_MENU_ENTRIES);
+    while (m_suggestionsMenuAttached < count)
+        m->Append(m_suggestionsMenuItems[m_suggestionsMenuAttached++]);
+
+    m_suggestionsMenuOutdated = true;
+}
+
+void SuggestionsSidebarBlock::RefreshSuggestionsMenu()
+{
+    auto m = m_suggestionsMenu;
+    if (!m || !m_suggestionsMenuOutdated)
+        return;
+    m_suggestionsMenuOutdated = false;
+
+    const size_t count = std::min(m_suggestions.size(), (size_t)SUGGESTIONS_MENU_ENTRIES);
+    while (m_suggestionsMenuAttached > count)
+        m->Remove(m_suggestionsMenuItems[--m_suggestionsMenuAttached]);
+    while (m_suggestionsMenuAttached < count)
+        m->Append(m_suggestionsMenuItems[m_suggestionsMenuAttached++]);
 
     bool isRTL = m_parent->GetCurrentLanguage().IsRTL();
     wxString formatMask;
@@ -770,8 +914,6 @@ void SuggestionsSidebarBlock::UpdateSuggestionsMenu()
             text = text.substr(0, 100) + L"…";
 
         auto item = m_suggestionsMenuItems[index];
-        m_suggestionsMenu->Append(item);
-
         auto label = wxControl::EscapeMnemonics(wxString::Format(formatMask, text, index+1));
         item->SetItemLabel(label);
         item->SetBitmap(wxArtProvider::GetBitmap(GetIconForSuggestion(s)));
@@ -792,6 +934,8 @@ void SuggestionsSidebarBlock::ClearSuggestionsMenu()
         if (std::find(m_suggestionsMenuItems.begin(), m_suggestionsMenuItems.end(), i) != m_suggestionsMenuItems.end())
             m->Remove(i);
     }
+    m_suggestionsMenuAttached = 0;
+    m_suggestionsMenuOutdated = true;
 }
 
 
@@ -846,22 +990,39 @@ bool SuggestionsSidebarBlock::ShouldShowForItem(const CatalogItemPtr&) const
 
 void SuggestionsSidebarBlock::Update(const CatalogItemPtr& item)
 {
-    ClearMessage();
-    ClearSuggestions();
-
-    UpdateSuggestionsForItem(item);
-}
-
-void SuggestionsSidebarBlock::UpdateSuggestionsForItem(CatalogItemPtr item)
-{
-    if (!item)
-        return;
-
     long long now = wxGetUTCTimeMillis().GetValue();
     long long delta = now - m_lastUpdateTime;
     m_lastUpdateTime = now;
 
-    if (delta < 100)
+    m_navigationInterval = (3 * m_navigationInterval + std::min(delta, NAVIGATION_INTERVAL_LIMIT)) / 4;
+
+    auto catalog = m_parent->GetCatalog();
+    if (catalog && catalog != m_warmUpCatalog.lock())
+    {
+        m_warmUpCatalog = catalog;
+        m_warmUpItem = item;
+        WarmUpForCatalog(catalog);
+    }
+    else if (m_warmUpItem && item != m_warmUpItem)
+    {
+        m_provider->CancelWarmUp();
+        m_warmUpItem.reset();
+    }
+
+    // Whatever is still running for the previous selection is no longer of any
+    // interest: discard results that arrive later and don't even start queries
+    // that are still waiting for a thread.
+    ++m_latestQueryId;
+    if (m_queryCancellation)
+    {
+        m_queryCancellation->cancel();
+        m_queryCancellation.reset();
+    }
+
+    ClearMessage();
+    ClearSuggestions();
+
+    if (item && delta < GetSuggestionsDelay())
     {
         // User is probably holding arrow down and going through the list as crazy
         // and not really caring for the suggestions. Throttle them a bit and call
@@ -869,10 +1030,25 @@ void SuggestionsSidebarBlock::UpdateSuggestionsForItem(CatalogItemPtr item)
         // times, only continuing through to show suggestions after the dust settled
         // and the user didn't change the selection for a few milliseconds.
         if (!m_suggestionsTimer.IsRunning())
-            m_suggestionsTimer.StartOnce(110);
+            m_suggestionsTimer.StartOnce(int(GetSuggestionsDelay()));
         return;
     }
 
+    UpdateSuggestionsForItem(item);
+}
+
+long long SuggestionsSidebarBlock::GetSuggestionsDelay() const
+{
+    // wait a bit longer than the typical time between selection changes (e.g.
+    // key repeat rate), so that a query isn't started for every item passed
+    return std::clamp(m_navigationInterval * 3 / 2, MIN_SUGGESTIONS_DELAY, MAX_SUGGESTIONS_DELAY);
+}
+
+void SuggestionsSidebarBlock::UpdateSuggestionsForItem(CatalogItemPtr item)
+{
+    if (!item)
+        return;
+
     m_pendingQueries = 0;
 
     // FIXME: Get catalog info from `item` once present there
@@ -896,10 +1072,20 @@ void SuggestionsSidebarBlock::UpdateSuggestionsForItem(CatalogItemPtr item)
     }
 
     QueryAllProviders(item);
+    PrefetchForUpcomingItems();
 }
 
 void SuggestionsSidebarBlock::OnDelayedShowSuggestionsForItem(wxTimerEvent&)
 {
+    // the selection may have changed again since the timer was started:
+    long long elapsed = wxGetUTCTimeMillis().GetValue() - m_lastUpdateTime;
+    long long delay = GetSuggestionsDelay();
+    if (elapsed < delay)
+    {
+        m_suggestionsTimer.StartOnce(int(delay - elapsed));
+        return;
+    }
+
     UpdateSuggestionsForItem(m_parent->GetSelectedItem());
 }
 
@@ -907,12 +1093,65 @@ void SuggestionsSidebarBlock::QueryAllProviders(const CatalogItemPtr& item)
 {
     auto thisQueryId = ++m_latestQueryId;
 
+    if (m_queryCancellation)
+        m_queryCancellation->cancel();
+    m_queryCancellation = std::make_shared<dispatch::cancellation_token>();
+
     // At this point, we know we're not interested in any older results, but some might have
     // arrived asynchronously in between ClearSuggestions() call and now. So make sure there
     // are no old suggestions present right after increasing the query ID:
     m_suggestions.clear();
 
     QueryProvider(TranslationMemory::Get(), item, thisQueryId);
+#ifdef HAVE_HTTP_CLIENT
+    if (RemoteTM::IsEnabled())
+        QueryProvider(RemoteTM::Get(), item, thisQueryId);
+#endif
+}
+
+void SuggestionsSidebarBlock::PrefetchForUpcomingItems()
+{
+    // Translators often go through the list linearly, so have suggestions
+    // for the next few items ready by the time they get to them. This also
+    // cancels any still running prefetching for a previous selection.
+    auto srclang = m_parent->GetCurrentSourceLanguage();
+    auto lang = m_parent->GetCurrentLanguage();
+
+    std::vector<SuggestionQuery> queries;
+    for (auto& item: m_parent->GetUpcomingItems())
+    {
+        if (item)
+            queries.push_back({srclang, lang, item->GetString().ToStdWstring()});
+    }
+
+#ifdef HAVE_HTTP_CLIENT
+    if (RemoteTM::IsEnabled())
+        m_provider->Prefetch(RemoteTM::Get(), std::vector<SuggestionQuery>(queries));
+#endif
+    m_provider->Prefetch(TranslationMemory::Get(), std::move(queries));
+}
+
+void SuggestionsSidebarBlock::WarmUpForCatalog(const CatalogPtr& catalog)
+{
+    // The first queries after opening a file are slow, because TM's data
+    // aren't in memory yet. Run queries for the items the translator is most
+    // likely to go to first in the background, which loads them and fills
+    // the suggestions cache too. (Items following the selected one are
+    // already handled by PrefetchForUpcomingItems().)
+    auto srclang = m_parent->GetCurrentSourceLanguage();
+    auto lang = m_parent->GetCurrentLanguage();
+
+    std::vector<SuggestionQuery> queries;
+    for (auto& item: catalog->items())
+    {
+        if (queries.size() >= WARMUP_ITEMS_COUNT)
+            break;
+        if (!item->IsTranslated() || item->IsFuzzy())
+            queries.push_back({srclang, lang, item->GetString().ToStdWstring()});
+    }
+
+    // only the local TM benefits from this, there's no point in loading remote servers
+    m_provider->WarmUp(TranslationMemory::Get(), std::move(queries));
 }
 
 void SuggestionsSidebarBlock::QueryProvider(SuggestionsBackend& backend, const CatalogItemPtr& item, uint64_t queryId)
@@ -929,8 +1168,20 @@ void SuggestionsSidebarBlock::QueryProvider(SuggestionsBackend& backend, const C
         m_parent->GetCurrentLanguage(),
         item->GetString().ToStdWstring()
     };
+    query.timeBudget = SUGGESTIONS_TIME_BUDGET;
+    query.onPartialResults = [weakSelf,queryId](const SuggestionsList& hits)
+    {
+        dispatch::on_main([weakSelf,queryId,hits]
+        {
+            auto self = weakSelf.lock();
+            // maybe this call is already out of date:
+            if (!self || self->m_latestQueryId != queryId)
+                return;
+            self->UpdateSuggestions(hits);
+        });
+    };
 
-    m_provider->SuggestTranslation(backend, std::move(query))
+    m_provider->SuggestTranslation(backend, std::move(query), m_queryCancellation)
     .then_on_main([weakSelf,queryId](SuggestionsList hits)
     {
         auto self = weakSelf.lock();
@@ -1015,10 +1266,12 @@ Sidebar::~Sidebar()
 }
 
 
-void Sidebar::SetSelectedItem(const CatalogPtr& catalog, const CatalogItemPtr& item)
+void Sidebar::SetSelectedItem(const CatalogPtr& catalog, const CatalogItemPtr& item,
+                              const std::vector<CatalogItemPtr>& upcomingItems)
 {
     m_catalog = catalog;
     m_selectedItem = item;
+    m_upcomingItems = upcomingItems;
     RefreshContent();
 }
 
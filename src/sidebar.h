@@ -132,13 +132,18 @@ protected:
     virtual void BuildSuggestionsMenu(int count = SUGGESTIONS_MENU_ENTRIES);
     virtual void UpdateSuggestionsMenu();
     virtual void ClearSuggestionsMenu();
+    /// Updates menu items' labels, done lazily when the menu is opened
+    virtual void RefreshSuggestionsMenu();
 
     virtual void QueryAllProviders(const CatalogItemPtr& item);
     void QueryProvider(SuggestionsBackend& backend, const CatalogItemPtr& item, uint64_t queryId);
+    virtual void PrefetchForUpcomingItems();
+    virtual void WarmUpForCatalog(const CatalogPtr& catalog);
 
     // Handle showing of suggestions
     void UpdateSuggestionsForItem(CatalogItemPtr item);
     void OnDelayedShowSuggestionsForItem(wxTimerEvent& e);
+    long long GetSuggestionsDelay() const;
 
 protected:
     std::unique_ptr<SuggestionsProvider> m_provider;
@@ -161,11 +166,25 @@ protected:
     std::vector<SuggestionWidget*> m_suggestionsWidgets;
     wxWindow *m_suggestionsSeparator;
     std::vector<wxMenuItem*> m_suggestionsMenuItems;
+    // how many of m_suggestionsMenuItems are in the menu (always the first ones)
+    size_t m_suggestionsMenuAttached = 0;
+    // whether the menu's content needs RefreshSuggestionsMenu()
+    bool m_suggestionsMenuOutdated = false;
     int m_pendingQueries;
+    // generation of the selection; results of queries for older ones are ignored
     uint64_t m_latestQueryId;
+    // cancels queries for the previous selection that didn't start yet
+    dispatch::cancellation_token_ptr m_queryCancellation;
+
+    // catalog the TM was warmed up for and the item selected at the time;
+    // the warm-up is cancelled when the selection changes
+    std::weak_ptr<Catalog> m_warmUpCatalog;
+    CatalogItemPtr m_warmUpItem;
 
     // delayed showing of suggestions:
     long long m_lastUpdateTime;
+    // moving average of time between selection changes, in ms
+    long long m_navigationInterval;
     wxTimer m_suggestionsTimer;
 
     friend class SuggestionWidget;
@@ -182,14 +201,26 @@ public:
     Sidebar(wxWindow *parent, wxMenu *suggestionsMenu);
     ~Sidebar();
 
-    /// Update selected item, if there's a single one. May be nullptr.
-    void SetSelectedItem(const CatalogPtr& catalog, const CatalogItemPtr& item);
+    /// How many upcoming items should be passed to SetSelectedItem()
+    static const int UPCOMING_ITEMS_COUNT = 5;
+
+    /**
+        Update selected item, if there's a single one. May be nullptr.
+
+        @a upcomingItems are the items likely to be selected next, typically
+        the ones following @a item in the list. Suggestions for them are
+        fetched in the background ahead of time.
+     */
+    void SetSelectedItem(const CatalogPtr& catalog, const CatalogItemPtr& item,
+                         const std::vector<CatalogItemPtr>& upcomingItems = {});
 
     /// Tell the sidebar there's multiple selection.
     void SetMultipleSelection();
 
     /// Returns currently selected item
     CatalogItemPtr GetSelectedItem() const { return m_selectedItem; }
+    /// Returns items likely to be selected after the current one
+    const std::vector<CatalogItemPtr>& GetUpcomingItems() const { return m_upcomingItems; }
     Language GetCurrentSourceLanguage() const;
     Language GetCurrentLanguage() const;
     CatalogPtr GetCatalog() const { return m_catalog; }
@@ -218,6 +249,7 @@ private:
 private:
     CatalogPtr m_catalog;
     CatalogItemPtr m_selectedItem;
+    std::vector<CatalogItemPtr> m_upcomingItems;
 
     std::vector<std::shared_ptr<SidebarBlock>> m_blocks;
 
@@ -27,6 +27,11 @@
 
 #include "str_helpers.h"
 #include "text_control.h"
+#include "unicode_helpers.h"
+
+#include <map>
+
+#include <unicode/uchar.h>
 
 #ifdef __WXGTK__
     #include <gtk/gtk.h>
@@ -38,11 +43,17 @@
 #ifdef __WXMSW__
     #include <wx/msw/wrapwin.h>
     #include <Richedit.h>
+    #include <objbase.h>
+    #include <spellcheck.h>
     #ifndef IMF_SPELLCHECKING
         #define IMF_SPELLCHECKING 0x0800
     #endif
 #endif
 
+#ifdef HAVE_ENCHANT
+    #include <enchant.h>
+#endif
+
 #include "edapp.h"
 
 
@@ -132,3 +143,338 @@ void ShowSpellcheckerHelp()
 #endif
 }
 #endif // !__WXMSW__
+
+
+// ----------------------------------------------------------------------
+// SpellChecker
+// ----------------------------------------------------------------------
+
+namespace
+{
+
+#if defined(__WXOSX__)
+
+class PlatformSpellChecker : public SpellChecker
+{
+public:
+    static std::shared_ptr<SpellChecker> Create(const Language& lang)
+    {
+        @autoreleasepool
+        {
+            NSArray *available = [[NSSpellChecker sharedSpellChecker] availableLanguages];
+            for (auto& code: {lang.Code(), lang.Lang()})
+            {
+                NSString *nscode = str::to_NS(code);
+                if ([available containsObject:nscode])
+                    return std::shared_ptr<SpellChecker>(new PlatformSpellChecker(lang, code));
+            }
+            return nullptr;
+        }
+    }
+
+protected:
+    PlatformSpellChecker(const Language& lang, const std::string& code) : SpellChecker(lang), m_code(code) {}
+
+    bool DoCheckWord(const std::wstring& word) override
+    {
+        @autoreleasepool
+        {
+            NSRange r = [[NSSpellChecker sharedSpellChecker] checkSpellingOfString:str::to_NS(word)
+                                                                        startingAt:0
+                                                                          language:str::to_NS(m_code)
+                                                                              wrap:NO
+                                                            inSpellDocumentWithTag:0
+                                                                         wordCount:nullptr];
+            return r.location == NSNotFound;
+        }
+    }
+
+private:
+    std::string m_code;
+};
+
+#elif defined(__WXMSW__)
+
+// Spellchecking is done on background threads, which must be in the MTA
+// for the spellchecker's COM objects to be usable from all of them.
+void EnsureCOMInitialized()
+{
+    struct COMInit
+    {
+        COMInit() { m_ok = SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED)); }
+        ~COMInit() { if (m_ok) CoUninitialize(); }
+        bool m_ok;
+    };
+    static thread_local COMInit s_init;
+}
+
+class PlatformSpellChecker : public SpellChecker
+{
+public:
+    static std::shared_ptr<SpellChecker> Create(const Language& lang)
+    {
+        EnsureCOMInitialized();
+
+        ISpellCheckerFactory *factory = nullptr;
+        if (FAILED(CoCreateInstance(__uuidof(SpellCheckerFactory), nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))))
+            return nullptr;
+
+        std::shared_ptr<SpellChecker> result;
+        for (auto& code: {lang.LanguageTag(), lang.Lang()})
+        {
+            auto tag = str::to_wstring(code);
+            BOOL supported = FALSE;
+            if (FAILED(factory->IsSupported(tag.c_str(), &supported)) || !supported)
+                continue;
+            ISpellChecker *checker = nullptr;
+            if (SUCCEEDED(factory->CreateSpellChecker(tag.c_str(), &checker)))
+            {
+                result.reset(new PlatformSpellChecker(lang, checker));
+                break;
+            }
+        }
+
+        factory->Release();
+        return result;
+    }
+
+    ~PlatformSpellChecker()
+    {
+        m_checker->Release();
+    }
+
+protected:
+    PlatformSpellChecker(const Language& lang, ISpellChecker *checker) : SpellChecker(lang), m_checker(checker) {}
+
+    bool DoCheckWord(const std::wstring& word) override
+    {
+        EnsureCOMInitialized();
+
+        IEnumSpellingError *errors = nullptr;
+        if (FAILED(m_checker->Check(word.c_str(), &errors)))
+            return true;
+
+        ISpellingError *error = nullptr;
+        bool correct = errors->Next(&error) != S_OK;
+        if (error)
+            error->Release();
+        errors->Release();
+        return correct;
+    }
+
+private:
+    ISpellChecker *m_checker;
+};
+
+#elif defined(HAVE_ENCHANT)
+
+class PlatformSpellChecker : public SpellChecker
+{
+public:
+    static std::shared_ptr<SpellChecker> Create(const Language& lang)
+    {
+        EnchantBroker *broker = enchant_broker_init();
+        if (!broker)
+            return nullptr;
+
+        for (auto& code: {lang.Code(), lang.Lang()})
+        {
+            EnchantDict *dict = enchant_broker_request_dict(broker, code.c_str());
+            if (dict)
+                return std::shared_ptr<SpellChecker>(new PlatformSpellChecker(lang, broker, dict));
+        }
+
+        enchant_broker_free(broker);
+        return nullptr;
+    }
+
+    ~PlatformSpellChecker()
+    {
+        enchant_broker_free_dict(m_broker, m_dict);
+        enchant_broker_free(m_broker);
+    }
+
+protected:
+    PlatformSpellChecker(const Language& lang, EnchantBroker *broker, EnchantDict *dict)
+        : SpellChecker(lang), m_broker(broker), m_dict(dict) {}
+
+    bool DoCheckWord(const std::wstring& word) override
+    {
+        auto utf8 = str::to_utf8(word);
+        return enchant_dict_check(m_dict, utf8.c_str(), utf8.length()) == 0;
+    }
+
+private:
+    EnchantBroker *m_broker;
+    EnchantDict *m_dict;
+};
+
+#else
+
+class PlatformSpellChecker
+{
+public:
+    static std::shared_ptr<SpellChecker> Create(const Language&) { return nullptr; }
+};
+
+#endif
+
+
+bool IsWordWorthChecking(const std::wstring& word)
+{
+    if (word.length() < 2)
+        return false;
+
+    bool first = true;
+    for (auto c: word)
+    {
+        // words with digits are usually identifiers, and uppercase after the first
+        // letter indicates acronyms or CamelCase names, which dictionaries don't know
+        if (u_isdigit(c) || (!first && u_isupper(c)))
+            return false;
+        first = false;
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+
+std::shared_ptr<SpellChecker> SpellChecker::Get(const Language& lang)
+{
+    static std::mutex s_mutex;
+    static std::map<std::string, std::shared_ptr<SpellChecker>> s_checkers;
+
+    if (!lang.IsValid() || !IsSpellcheckingAvailable())
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto i = s_checkers.find(lang.Code());
+    if (i != s_checkers.end())
+        return i->second;
+
+    // nullptr is cached too, so that missing dictionaries aren't searched for repeatedly
+    auto checker = PlatformSpellChecker::Create(lang);
+    s_checkers.emplace(lang.Code(), checker);
+    return checker;
+}
+
+
+bool SpellChecker::IsCorrect(const std::wstring& word)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(m_cacheMutex);
+        auto i = m_cache.find(word);
+        if (i != m_cache.end())
+            return i->second;
+    }
+
+    bool correct;
+    {
+        std::lock_guard<std::mutex> lock(m_checkMutex);
+        correct = DoCheckWord(word);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_cacheMutex);
+    m_cache.emplace(word, correct);
+    return correct;
+}
+
+
+std::vector<std::wstring> SpellChecker::FindMisspelledWords(const wxString& text, const wxString& source)
+{
+    std::vector<std::wstring> misspelled;
+
+    auto utext = str::to_icu(text);
+    BreakIterator bi(UBRK_WORD, m_lang);
+    bi.set_text(utext.data());
+
+    const std::wstring wsource = str::to_wstring(source);
+
+    int32_t start = bi.begin();
+    for (int32_t end = bi.next(); end != bi.end(); start = end, end = bi.next())
+    {
+        auto status = bi.rule();
+        if (status < UBRK_WORD_LETTER || status >= UBRK_WORD_LETTER_LIMIT)
+            continue;
+
+        auto word = str::to_wx(utext.data() + start, end - start).ToStdWstring();
+        if (!IsWordWorthChecking(word))
+            continue;
+        if (wsource.find(word) != std::wstring::npos)
+            continue;
+
+        if (!IsCorrect(word))
+            misspelled.push_back(word);
+    }
+
+    return misspelled;
+}
+
+
+dispatch::future<std::vector<SpellingIssue>> CheckCatalogSpelling(Catalog& catalog,
+                                                                  std::shared_ptr<SpellChecker> checker,
+                                                                  dispatch::cancellation_token_ptr cancellation)
+{
+    struct Input
+    {
+        CatalogItemPtr item;
+        wxString source, translation;
+    };
+
+    // items may be modified on the main thread while checking, so take a snapshot:
+    auto input = std::make_shared<std::vector<Input>>();
+    input->reserve(catalog.items().size());
+    for (auto& item: catalog.items())
+    {
+        if (!item->IsTranslated() || item->HasIssue())
+            continue;
+        // check only the first form of plurals, other forms are usually very similar
+        input->push_back({item, item->GetString(), item->GetTranslation()});
+    }
+
+    return dispatch::async(dispatch::priority::bulk, [=]
+    {
+        std::vector<std::vector<std::wstring>> words(input->size());
+
+        dispatch::parallel_options options;
+        options.prio = dispatch::priority::bulk;
+        options.cancellation = cancellation;
+        dispatch::parallel_for_chunked(input->size(), [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+                words[i] = checker->FindMisspelledWords((*input)[i].translation, (*input)[i].source);
+        }, options);
+
+        std::vector<SpellingIssue> issues;
+        for (size_t i = 0; i < input->size(); i++)
+        {
+            if (!words[i].empty())
+                issues.push_back({(*input)[i].item, std::move((*input)[i].translation), std::move(words[i])});
+        }
+        return issues;
+    });
+}
+
+
+int ApplySpellingIssues(const std::vector<SpellingIssue>& issues)
+{
+    int count = 0;
+    for (auto& i: issues)
+    {
+        if (i.item->HasIssue() || i.item->GetTranslation() != i.translation)
+            continue;
+
+        wxString words;
+        for (auto& w: i.words)
+        {
+            if (!words.empty())
+                words += L", ";
+            words += L"“" + wxString(w) + L"”";
+        }
+        // TRANSLATORS: %s is a comma-separated list of words
+        i.item->SetIssue(CatalogItem::Issue::Warning, wxString::Format(_("Possible misspelling: %s"), words));
+        count++;
+    }
+    return count;
+}
@@ -32,8 +32,17 @@
     #include <wx/platinfo.h>
 #endif
 
+#include "catalog.h"
+#include "concurrency.h"
 #include "language.h"
 
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 class CustomizedTextCtrl;
 
 
@@ -64,4 +73,74 @@ bool InitTextCtrlSpellchecker(CustomizedTextCtrl *text, bool enable, const Langu
 void ShowSpellcheckerHelp();
 #endif
 
+
+/**
+    Spellchecker for checking texts outside of text controls, e.g. whole files.
+
+    Uses the platform's spellchecker (Enchant on Linux). Thread-safe; results
+    for individual words are cached, because the same words occur over and
+    over in a file.
+ */
+class SpellChecker
+{
+public:
+    /// Returns spellchecker for @a lang, nullptr if there's no dictionary for it.
+    static std::shared_ptr<SpellChecker> Get(const Language& lang);
+
+    virtual ~SpellChecker() {}
+
+    /**
+        Returns misspelled words in @a text, in order of appearance.
+
+        Words that also occur in @a source (e.g. names or placeholders left
+        untranslated) and words with digits or uppercase letters other than
+        the first are ignored, because they are rarely actual words.
+     */
+    std::vector<std::wstring> FindMisspelledWords(const wxString& text, const wxString& source);
+
+protected:
+    SpellChecker(const Language& lang) : m_lang(lang) {}
+
+    /// Checks @a word; called with m_checkMutex locked, because platform spellcheckers aren't thread-safe
+    virtual bool DoCheckWord(const std::wstring& word) = 0;
+
+    const Language m_lang;
+
+private:
+    bool IsCorrect(const std::wstring& word);
+
+    std::mutex m_checkMutex;
+    std::shared_mutex m_cacheMutex;
+    std::unordered_map<std::wstring, bool> m_cache;
+};
+
+
+/// Misspellings found in a translation by CheckCatalogSpelling()
+struct SpellingIssue
+{
+    CatalogItemPtr item;
+    /// The checked translation, to tell if the item was edited in the meantime
+    wxString translation;
+    std::vector<std::wstring> words;
+};
+
+/**
+    Checks spelling of all translations in @a catalog in the background.
+
+    Must be called on the main thread; translations are copied before
+    checking them in parallel, so the catalog can be edited in the meantime.
+    Use ApplySpellingIssues() to report the results.
+ */
+dispatch::future<std::vector<SpellingIssue>> CheckCatalogSpelling(Catalog& catalog,
+                                                                  std::shared_ptr<SpellChecker> checker,
+                                                                  dispatch::cancellation_token_ptr cancellation);
+
+/**
+    Flags items with misspellings as having a QA issue (warning).
+
+    Items that already have other issues or were edited since checking are
+    skipped. Must be called on the main thread. Returns number of flagged items.
+ */
+int ApplySpellingIssues(const std::vector<SpellingIssue>& issues);
+
 #endif // Poedit_spellchecking_h
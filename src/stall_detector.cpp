@@ -0,0 +1,210 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "stall_detector.h"
+
+#include "tracing.h"
+
+#include <wx/app.h>
+#include <wx/log.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+
+// How often is the main thread checked:
+const int SAMPLING_INTERVAL_MS = 20;
+
+// Describes the spans active on the main thread, innermost last:
+std::string DescribeActiveSpans()
+{
+    std::string out;
+    for (auto name: tracing::active_spans())
+    {
+        if (!out.empty())
+            out += " > ";
+        out += name;
+    }
+    return out.empty() ? std::string("(no span)") : out;
+}
+
+} // anonymous namespace
+
+
+class StallDetector::Impl : public std::enable_shared_from_this<StallDetector::Impl>
+{
+public:
+    explicit Impl(unsigned thresholdMs) : m_threshold(int64_t(thresholdMs) * 1000) {}
+
+    void Start()
+    {
+        tracing::track_active_spans(true);
+        m_thread = std::thread([self = shared_from_this()]{ self->Run(); });
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+        tracing::track_active_spans(false);
+
+        LogSummary();
+    }
+
+private:
+    struct Totals
+    {
+        int count = 0;
+        int64_t total = 0, longest = 0;
+    };
+
+    // background thread's loop:
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stop)
+        {
+            m_cv.wait_for(lock, std::chrono::milliseconds(SAMPLING_INTERVAL_MS));
+            if (m_stop)
+                break;
+
+            const int64_t now = tracing::span::now();
+            if (m_pendingSince < 0)
+            {
+                // post a new heartbeat once the previous one was handled:
+                m_pendingSince = now;
+                m_samples.clear();
+                std::weak_ptr<Impl> weak = shared_from_this();
+                wxTheApp->CallAfter([weak, now]
+                {
+                    if (auto self = weak.lock())
+                        self->OnHeartbeat(now);
+                });
+            }
+            else if (now - m_pendingSince > m_threshold)
+            {
+                m_samples[DescribeActiveSpans()]++;
+            }
+        }
+    }
+
+    // called on the main thread when it gets to handling the heartbeat posted at @a posted:
+    void OnHeartbeat(int64_t posted)
+    {
+        const int64_t duration = tracing::span::now() - posted;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingSince = -1;
+        if (duration <= m_threshold)
+            return;
+
+        // attribute the stall to the spans seen most often while it lasted:
+        std::string culprit = "(unknown)";
+        int culpritSamples = 0;
+        for (auto& s: m_samples)
+        {
+            if (s.second > culpritSamples)
+            {
+                culprit = s.first;
+                culpritSamples = s.second;
+            }
+        }
+
+        auto& totals = m_totals[culprit];
+        totals.count++;
+        totals.total += duration;
+        totals.longest = std::max(totals.longest, duration);
+
+        tracing::event("ui", "stall", posted, duration);
+        wxLogTrace("poedit.stalls", "UI stalled for %d ms in %s", int(duration / 1000), culprit);
+    }
+
+    void LogSummary()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_totals.empty())
+        {
+            wxLogTrace("poedit.stalls", "no UI stalls longer than %d ms", int(m_threshold / 1000));
+            return;
+        }
+
+        // worst offenders first:
+        std::vector<std::pair<std::string, Totals>> sorted(m_totals.begin(), m_totals.end());
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b){ return a.second.total > b.second.total; });
+
+        wxLogTrace("poedit.stalls", "UI stalls longer than %d ms:", int(m_threshold / 1000));
+        for (auto& s: sorted)
+        {
+            wxLogTrace("poedit.stalls", "  %s: %d stalls, %d ms total, %d ms longest",
+                       s.first, s.second.count, int(s.second.total / 1000), int(s.second.longest / 1000));
+        }
+    }
+
+    const int64_t m_threshold;  // in microseconds
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stop = false;
+
+    // when was the currently pending heartbeat posted, -1 if none:
+    int64_t m_pendingSince = -1;
+    // how many times were various spans seen active during the current stall:
+    std::map<std::string, int> m_samples;
+    std::map<std::string, Totals> m_totals;
+};
+
+
+std::shared_ptr<StallDetector::Impl> StallDetector::ms_instance;
+
+void StallDetector::Start(unsigned thresholdMs)
+{
+    if (ms_instance)
+        return;
+    ms_instance = std::make_shared<Impl>(thresholdMs);
+    ms_instance->Start();
+}
+
+
+void StallDetector::Stop()
+{
+    if (!ms_instance)
+        return;
+    ms_instance->Stop();
+    ms_instance.reset();
+}
@@ -0,0 +1,60 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_stall_detector_h
+#define Poedit_stall_detector_h
+
+#include <memory>
+
+
+/**
+    Watchdog that detects when the main thread doesn't handle events for too
+    long, i.e. when the UI freezes.
+
+    A background thread regularly posts an event to the main thread and
+    measures how long it takes until it is handled. While the main thread is
+    busy, the thread samples which TRACE_SPAN()s are active on it (see
+    tracing::active_spans()), so that each stall can be attributed to the
+    work that caused it.
+
+    Stalls are logged under the "poedit.stalls" trace mask and, if tracing,
+    recorded in the trace as well. A summary grouped by spans is logged when
+    the detector is stopped.
+ */
+class StallDetector
+{
+public:
+    /// Starts detecting stalls longer than @a thresholdMs milliseconds
+    static void Start(unsigned thresholdMs);
+
+    /// Stops detecting and logs the summary (if started)
+    static void Stop();
+
+private:
+    class Impl;
+    static std::shared_ptr<Impl> ms_instance;
+};
+
+#endif // Poedit_stall_detector_h
@@ -26,8 +26,12 @@
 #ifndef Poedit_str_helpers_h
 #define Poedit_str_helpers_h
 
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include <boost/locale/encoding_utf.hpp>
 
@@ -41,6 +45,7 @@
 
     #include <unicode/utypes.h>
     #include <unicode/ustring.h>
+    #include <unicode/utf16.h>
 #endif // __cplusplus
 
 
@@ -56,10 +61,202 @@
         - to_wstring(...)
         - to_utf8(...)
         - to_NSString()
+
+    Variants taking an additional buffer argument write into it instead of
+    returning a new string, so that its memory can be reused when converting
+    many strings in a loop. They return a pointer or view of the result, which
+    is only valid until the buffer is modified. If no conversion is needed,
+    the input is returned directly, without copying into the buffer.
  */
 namespace str
 {
 
+// Fast UTF-8 validation and transcoding:
+//
+// Translation files are mostly ASCII, so these functions process ASCII runs
+// 8 bytes at a time and only decode multibyte sequences individually.
+
+namespace detail
+{
+
+/// Returns length of the ASCII-only prefix of @a s
+inline size_t ascii_prefix_length(const char *s, size_t len)
+{
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t chunk;
+        memcpy(&chunk, s + i, 8);
+        if (chunk & 0x8080808080808080ULL)
+            break;
+    }
+    while (i < len && static_cast<unsigned char>(s[i]) < 0x80)
+        i++;
+    return i;
+}
+
+} // namespace detail
+
+/// Checks if @a s is valid UTF-8 (without overlong encodings or surrogates)
+inline bool is_valid_utf8(const char *s, size_t len)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(s);
+    const unsigned char *end = p + len;
+    for (;;)
+    {
+        p += detail::ascii_prefix_length(reinterpret_cast<const char*>(p), end - p);
+        if (p == end)
+            return true;
+
+        const unsigned char c = *p;
+        size_t extra;
+        uint32_t cp;
+        if ((c & 0xE0) == 0xC0)
+        {
+            extra = 1;
+            cp = c & 0x1F;
+        }
+        else if ((c & 0xF0) == 0xE0)
+        {
+            extra = 2;
+            cp = c & 0x0F;
+        }
+        else if ((c & 0xF8) == 0xF0)
+        {
+            extra = 3;
+            cp = c & 0x07;
+        }
+        else
+        {
+            return false;
+        }
+
+        if ((size_t)(end - p) <= extra)
+            return false;
+        for (size_t i = 1; i <= extra; i++)
+        {
+            if ((p[i] & 0xC0) != 0x80)
+                return false;
+            cp = (cp << 6) | (p[i] & 0x3F);
+        }
+
+        // reject overlong encodings, surrogates and out-of-range values:
+        static const uint32_t min_value[] = { 0, 0x80, 0x800, 0x10000 };
+        if (cp < min_value[extra] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+            return false;
+
+        p += extra + 1;
+    }
+}
+
+inline bool is_valid_utf8(std::string_view s)
+{
+    return is_valid_utf8(s.data(), s.length());
+}
+
+/// Converts UTF-8 text that was already validated with is_valid_utf8()
+inline wxString from_valid_utf8(const char *s, size_t len)
+{
+    wxString out;
+    if (!len)
+        return out;
+    {
+        // UTF-8 never needs fewer bytes than wchar_t units for the same text
+        wxStringBufferLength buf(out, len);
+        wchar_t *const start = buf;
+        wchar_t *dst = start;
+
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(s);
+        const unsigned char *end = p + len;
+        for (;;)
+        {
+            const size_t ascii = detail::ascii_prefix_length(reinterpret_cast<const char*>(p), end - p);
+            for (size_t i = 0; i < ascii; i++)
+                *dst++ = p[i];
+            p += ascii;
+            if (p == end)
+                break;
+
+            uint32_t cp;
+            const unsigned char c = *p;
+            const size_t seqlen = c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+            if ((size_t)(end - p) < seqlen)
+            {
+                // don't read past the end even if the input was truncated
+                *dst++ = 0xFFFD;
+                break;
+            }
+            switch (seqlen)
+            {
+                case 2:
+                    cp = ((c & 0x1F) << 6) | (p[1] & 0x3F);
+                    break;
+                case 3:
+                    cp = ((c & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+                    break;
+                default:
+                    cp = ((c & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+                    break;
+            }
+            p += seqlen;
+
+#if SIZEOF_WCHAR_T == 2
+            if (cp >= 0x10000)
+            {
+                cp -= 0x10000;
+                *dst++ = static_cast<wchar_t>(0xD800 + (cp >> 10));
+                *dst++ = static_cast<wchar_t>(0xDC00 + (cp & 0x3FF));
+                continue;
+            }
+#endif
+            *dst++ = static_cast<wchar_t>(cp);
+        }
+
+        buf.SetLength(dst - start);
+    }
+    return out;
+}
+
+/// Appends UTF-8 encoding of wide string @a s to @a out; invalid characters are replaced with U+FFFD
+inline void append_utf8(std::string& out, const wchar_t *s, size_t len)
+{
+    out.reserve(out.size() + len);
+    const wchar_t *end = s + len;
+    while (s != end)
+    {
+        uint32_t cp = static_cast<uint32_t>(*s++);
+        if (cp < 0x80)
+        {
+            out.push_back(static_cast<char>(cp));
+            continue;
+        }
+
+#if SIZEOF_WCHAR_T == 2
+        if (cp >= 0xD800 && cp <= 0xDBFF && s != end && *s >= 0xDC00 && *s <= 0xDFFF)
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (static_cast<uint32_t>(*s++) - 0xDC00);
+#endif
+        if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+            cp = 0xFFFD;
+
+        if (cp < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        }
+        else if (cp < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        }
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
 inline std::string to_utf8(const std::wstring& str)
 {
     return boost::locale::conv::utf_to_utf<char>(str);
@@ -92,7 +289,9 @@ inline std::wstring to_wstring(const unsigned char *utf8str)
 
 inline std::string to_utf8(const wxString& str)
 {
-    return str.utf8_string();
+    std::string out;
+    append_utf8(out, str.wx_str(), str.length());
+    return out;
 }
 
 #if wxUSE_STD_STRING && wxUSE_UNICODE_WCHAR && wxUSE_STL_BASED_WXSTRING
@@ -105,19 +304,27 @@ inline wstring_conv_t to_wstring(const wxString& str)
     return str.ToStdWstring();
 }
 
+/// Converts UTF-8 string, returns empty string if it isn't valid UTF-8
+inline wxString to_wx(const char *utf8, size_t len)
+{
+    if (!is_valid_utf8(utf8, len))
+        return wxString();
+    return from_valid_utf8(utf8, len);
+}
+
 inline wxString to_wx(const char *utf8)
 {
-    return wxString::FromUTF8(utf8);
+    return utf8 ? to_wx(utf8, strlen(utf8)) : wxString();
 }
 
 inline wxString to_wx(const unsigned char *utf8)
 {
-    return wxString::FromUTF8((const char*)utf8);
+    return to_wx(reinterpret_cast<const char*>(utf8));
 }
 
 inline wxString to_wx(const std::string& utf8)
 {
-    return wxString::FromUTF8(utf8.c_str());
+    return to_wx(utf8.data(), utf8.length());
 }
 
 inline wxString to_wx(const std::wstring& str)
@@ -376,6 +583,123 @@ inline std::string to_utf8(const UChar *str)
 }
 
 
+// Conversions into reusable buffers:
+
+namespace detail
+{
+
+template<typename TOut, typename TIn>
+inline void utf_to_utf(const TIn *str, size_t len, std::basic_string<TOut>& buffer)
+{
+    namespace utf = boost::locale::utf;
+
+    buffer.clear();
+    auto out = std::back_inserter(buffer);
+    const TIn *end = str + len;
+    while (str != end)
+    {
+        utf::code_point c = utf::utf_traits<TIn>::decode(str, end);
+        // skip invalid input, same as boost::locale::conv::utf_to_utf() does
+        if (c == utf::illegal || c == utf::incomplete)
+            continue;
+        utf::utf_traits<TOut>::encode(c, out);
+    }
+}
+
+} // namespace detail
+
+inline std::string_view to_utf8(const wchar_t *str, size_t len, std::string& buffer)
+{
+    buffer.clear();
+    append_utf8(buffer, str, len);
+    return buffer;
+}
+
+inline std::string_view to_utf8(const std::wstring& str, std::string& buffer)
+{
+    return to_utf8(str.c_str(), str.length(), buffer);
+}
+
+inline std::string_view to_utf8(const wxString& str, std::string& buffer)
+{
+    return to_utf8(str.wx_str(), str.length(), buffer);
+}
+
+inline std::wstring_view to_wstring(std::string_view utf8str, std::wstring& buffer)
+{
+    detail::utf_to_utf(utf8str.data(), utf8str.length(), buffer);
+    return buffer;
+}
+
+/// Returns view of wxString's wide characters, without copying them
+inline std::wstring_view to_wstring_view(const wxString& str)
+{
+    return std::wstring_view(str.wx_str(), str.length());
+}
+
+/// Reusable buffer for to_icu() conversions
+typedef std::vector<UChar> UCharScratchBuffer;
+
+/// Returns NUL-terminated UChar* string, valid for the lifetime of both @a str and @a buffer
+inline const UChar *to_icu(const wchar_t *str, size_t len, UCharScratchBuffer& buffer)
+{
+#if SIZEOF_WCHAR_T == 2
+    (void)len;
+    (void)buffer;
+    return reinterpret_cast<const UChar*>(str);
+#else
+    buffer.clear();
+    buffer.reserve(len + 1);
+    for (const wchar_t *end = str + len; str != end; ++str)
+    {
+        UChar32 c = static_cast<UChar32>(*str);
+        if (c <= 0xFFFF)
+        {
+            buffer.push_back(static_cast<UChar>(c));
+        }
+        else if (c <= 0x10FFFF)
+        {
+            buffer.push_back(U16_LEAD(c));
+            buffer.push_back(U16_TRAIL(c));
+        }
+        else
+        {
+            buffer.push_back(0xFFFD);
+        }
+    }
+    buffer.push_back(0);
+    return buffer.data();
+#endif
+}
+
+inline const UChar *to_icu(const wxString& str, UCharScratchBuffer& buffer)
+{
+    return to_icu(str.wx_str(), str.length(), buffer);
+}
+
+inline const UChar *to_icu(const std::wstring& str, UCharScratchBuffer& buffer)
+{
+    return to_icu(str.c_str(), str.length(), buffer);
+}
+
+/// Converts @a count UChars into @a out, reusing its memory
+inline void to_wx(const UChar *str, size_t count, wxString& out)
+{
+#if SIZEOF_WCHAR_T == 2
+    out.assign(reinterpret_cast<const wchar_t*>(str), count);
+#else
+    out.clear();
+    out.reserve(count);
+    for (size_t i = 0; i < count;)
+    {
+        UChar32 c;
+        U16_NEXT(str, i, count, c);
+        out.append(1, static_cast<wchar_t>(c));
+    }
+#endif
+}
+
+
 // Template-friendly API:
 
 namespace detail
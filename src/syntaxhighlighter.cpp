@@ -29,7 +29,11 @@
 #include "str_helpers.h"
 
 #include <unicode/uchar.h>
-#include <regex>
+
+#include <algorithm>
+#include <cwchar>
+#include <map>
+#include <mutex>
 
 namespace
 {
@@ -128,6 +132,7 @@ class CompositeSyntaxHighlighter : public SyntaxHighlighter
 {
 public:
     void Add(std::shared_ptr<SyntaxHighlighter> h) { m_sub.push_back(h); }
+    bool empty() const { return m_sub.empty(); }
 
     void Highlight(const std::wstring& s, const CallbackType& highlight) override
     {
@@ -141,272 +146,885 @@ private:
 
 
 
-/// Match regular expressions for highlighting
-class RegexSyntaxHighlighter : public SyntaxHighlighter
+// Character classes used by the scanners below. They correspond to what
+// ECMAScript regular expressions use for \d, \w and \s:
+
+inline bool is_digit(wchar_t c) { return c >= '0' && c <= '9'; }
+inline bool is_ascii_alnum(wchar_t c) { return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+inline bool is_word(wchar_t c) { return c == '_' || (c && u_isalnum(c)); }
+inline bool is_space(wchar_t c) { return c && u_isspace(c); }
+inline bool is_line_terminator(wchar_t c) { return c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029; }
+inline bool is_one_of(wchar_t c, const wchar_t *chars) { return c && wcschr(chars, c) != nullptr; }
+
+
+/**
+    Base class for hand-written scanners of placeholders and markup.
+
+    Each scanner recognizes exactly the same syntax as the regular expression
+    documented next to it used to, but does so without backtracking and in
+    a single pass over the text.
+
+    Derived classes must provide a TRIGGERS string with characters that can
+    start a match and Match(pos) that returns the length of the match at
+    position @a pos (which is always one of the trigger characters), or 0.
+ */
+class PlaceholderScanner
 {
 public:
-    static const std::wregex::flag_type flags = std::regex_constants::ECMAScript | std::regex_constants::optimize;
+    explicit PlaceholderScanner(const std::wstring& s) : m_s(s), m_len(s.length()) {}
 
-    RegexSyntaxHighlighter(const wchar_t *regex, TextKind kind) : m_re(regex, flags), m_kind(kind) {}
-    RegexSyntaxHighlighter(const std::wregex& regex, TextKind kind) : m_re(regex), m_kind(kind) {}
+protected:
+    /// Character at given position or 0 past the end
+    wchar_t at(size_t i) const { return i < m_len ? m_s[i] : 0; }
 
-    void Highlight(const std::wstring& s, const CallbackType& highlight) override
+    size_t skip_digits(size_t i) const
     {
-        try
-        {
-            std::wsregex_iterator next(s.begin(), s.end(), m_re);
-            std::wsregex_iterator end;
-            while (next != end)
-            {
-                auto match = *next++;
-                if (match.empty())
-                    continue;
-                int pos = static_cast<int>(match.position());
-                highlight(pos, pos + static_cast<int>(match.length()), m_kind);
-            }
-        }
-        catch (std::regex_error& e)
+        while (is_digit(at(i)))
+            i++;
+        return i;
+    }
+
+    size_t skip_chars(size_t i, const wchar_t *chars, size_t maxCount = std::wstring::npos) const
+    {
+        for (size_t count = 0; count < maxCount && is_one_of(at(i), chars); count++)
+            i++;
+        return i;
+    }
+
+    // (\d+\$)?
+    size_t skip_positional(size_t i) const
+    {
+        size_t j = skip_digits(i);
+        return (j > i && at(j) == '$') ? j + 1 : i;
+    }
+
+    // (\d+|\*)?
+    size_t skip_width(size_t i) const
+    {
+        return (at(i) == '*') ? i + 1 : skip_digits(i);
+    }
+
+    // (\.(\d+|\*))?
+    size_t skip_precision(size_t i) const
+    {
+        if (at(i) != '.')
+            return i;
+        if (at(i + 1) == '*')
+            return i + 2;
+        size_t j = skip_digits(i + 1);
+        return (j > i + 1) ? j : i;
+    }
+
+    size_t match_if(size_t pos, size_t i, const wchar_t *conversions) const
+    {
+        return is_one_of(at(i), conversions) ? i + 1 - pos : 0;
+    }
+
+    // c-format per http://en.cppreference.com/w/cpp/io/c/fprintf,
+    //              http://pubs.opengroup.org/onlinepubs/9699919799/functions/fprintf.html
+    // %(\d+\$)?[-+ #0]{0,5}(\d+|\*)?(\.(\d+|\*))?((hh|ll|[hljztL])?[%csdioxXufFeEaAgGnp]|<[A-Za-z0-9]+>)
+    //
+    // The <PRId64>-like form is only allowed if @a angled is true.
+    size_t match_c_like(size_t pos, bool angled) const
+    {
+        size_t i = skip_positional(pos + 1);
+        i = skip_chars(i, L"-+ #0", 5);
+        i = skip_width(i);
+        i = skip_precision(i);
+
+        size_t conv = i;
+        if ((at(i) == 'h' && at(i + 1) == 'h') || (at(i) == 'l' && at(i + 1) == 'l'))
+            conv = i + 2;
+        else if (is_one_of(at(i), L"hljztL"))
+            conv = i + 1;
+        if (is_one_of(at(conv), L"%csdioxXufFeEaAgGnp"))
+            return conv + 1 - pos;
+
+        if (angled && at(i) == '<')
         {
-            switch (e.code())
-            {
-                case std::regex_constants::error_complexity:
-                case std::regex_constants::error_stack:
-                    // MSVC version of std::regex in particular can fail to match
-                    // e.g. HTML regex with backreferences on insanely large strings;
-                    // in that case, don't highlight instead of failing outright.
-                    return;
-                default:
-                    throw;
-            }
+            size_t j = i + 1;
+            while (is_ascii_alnum(at(j)))
+                j++;
+            if (j > i + 1 && at(j) == '>')
+                return j + 1 - pos;
         }
+
+        return 0;
     }
 
-private:
-    std::wregex m_re;
-    TextKind m_kind;
+    // Python and Perl-libintl braces format
+    // \{[\w.-:,]+\}
+    //
+    // Note that ".-:" is a range and includes '/' and digits, but not '-'.
+    size_t match_braces(size_t pos) const
+    {
+        size_t j = pos + 1;
+        while (is_word(at(j)) || is_one_of(at(j), L"./:,"))
+            j++;
+        return (j > pos + 1 && at(j) == '}') ? j + 1 - pos : 0;
+    }
+
+protected:
+    const std::wstring& m_s;
+    const size_t m_len;
 };
 
 
-std::wregex REOBJ_HTML_MARKUP(LR"((<\/?[a-zA-Z0-9:-]+(\s+[-:\w]+(=([-:\w+]|"[^"]*"|'[^']*'))?)*\s*\/?>)|(&[^ ;]+;))",
-                              RegexSyntaxHighlighter::flags);
+struct CFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%";
+    using PlaceholderScanner::PlaceholderScanner;
 
-// variables expansion for various template languages
-std::wregex REOBJ_COMMON_PLACEHOLDERS(
-                //
-                //           |             |
-                LR"(%[\w.-]+%|%?\{[\w.-]+\}|\{\{[\w.-]+\}\})",
-                //      |    |      |      |        |
-                //      |           |               |
-                //      |           |               +----------------------- {{var}}
-                //      |           |
-                //      |           +--------------------------------------- %{var} (Ruby) and {var}
-                //      |
-                //      +--------------------------------------------------- %var% (Twig)
-                //
-                RegexSyntaxHighlighter::flags);
-const wchar_t* COMMON_PLACEHOLDERS_TRIGGER_CHARS = L"{%";
+    size_t Match(size_t pos) const { return match_c_like(pos, /*angled=*/true); }
+};
+
+
+// %@ or c-format
+struct ObjCFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos) const
+    {
+        if (at(pos + 1) == '@')
+            return 2;
+        return match_c_like(pos, /*angled=*/true);
+    }
+};
+
+
+// ruby-format per https://ruby-doc.org/core-2.7.1/Kernel.html#method-i-sprintf
+// %(\d+\$)?[-+ #0]{0,5}(\d+|\*)?(\.(\d+|\*))?(hh|ll|[hljztL])?[%csdioxXufFeEaAgGnp]
+struct RubyFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos) const { return match_c_like(pos, /*angled=*/false); }
+};
 
-// WebExtension-like $foo$ placeholders
-std::wregex REOBJ_DOLLAR_PLACEHOLDERS(LR"(\$[A-Za-z0-9_]+\$)", RegexSyntaxHighlighter::flags);
 
 // php-format per http://php.net/manual/en/function.sprintf.php plus positionals
-const wchar_t* RE_PHP_FORMAT = LR"(%(\d+\$)?[-+]{0,2}([ 0]|'.)?-?\d*(\..?\d+)?[%bcdeEfFgGosuxX])";
+// %(\d+\$)?[-+]{0,2}([ 0]|'.)?-?\d*(\..?\d+)?[%bcdeEfFgGosuxX]
+struct PHPFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%";
+    using PlaceholderScanner::PlaceholderScanner;
 
-// c-format per http://en.cppreference.com/w/cpp/io/c/fprintf,
-//              http://pubs.opengroup.org/onlinepubs/9699919799/functions/fprintf.html
-#define RE_C_FORMAT_BASE LR"(%(\d+\$)?[-+ #0]{0,5}(\d+|\*)?(\.(\d+|\*))?((hh|ll|[hljztL])?[%csdioxXufFeEaAgGnp]|<[A-Za-z0-9]+>))"
-const wchar_t* RE_C_FORMAT = RE_C_FORMAT_BASE;
-const wchar_t* RE_OBJC_FORMAT =  L"%@|" RE_C_FORMAT_BASE;
-const wchar_t* RE_CXX20_OR_RUST_FORMAT = LR"((\{\{)|(\}\})|(\{[^}]*\}))";
+    size_t Match(size_t pos) const
+    {
+        size_t i = skip_positional(pos + 1);
+        i = skip_chars(i, L"-+", 2);
+
+        if (at(i) == ' ' || at(i) == '0')
+            i++;
+        else if (at(i) == '\'' && i + 1 < m_len && !is_line_terminator(m_s[i + 1]))
+            i += 2;
+
+        if (at(i) == '-')
+            i++;
+        i = skip_digits(i);
+
+        if (at(i) == '.')
+        {
+            if (is_digit(at(i + 1)))
+                i = skip_digits(i + 1);
+            else if (i + 1 < m_len && !is_line_terminator(m_s[i + 1]) && is_digit(at(i + 2)))
+                i = skip_digits(i + 2);
+        }
+
+        return match_if(pos, i, L"%bcdeEfFgGosuxX");
+    }
+};
+
+
+// C++20 and Rust format strings
+// (\{\{)|(\}\})|(\{[^}]*\})
+struct CxxOrRustFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"{}";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos)
+    {
+        if (at(pos) == '}')
+            return (at(pos + 1) == '}') ? 2 : 0;
+
+        if (at(pos + 1) == '{')
+            return 2;
+
+        // remember the closing brace, so that runs of unclosed braces aren't rescanned:
+        if (m_nextClose != std::wstring::npos && m_nextClose <= pos)
+            m_nextClose = m_s.find('}', pos + 1);
+        return (m_nextClose != std::wstring::npos) ? m_nextClose + 1 - pos : 0;
+    }
+
+private:
+    size_t m_nextClose = 0;
+};
 
-// Python and Perl-libintl braces format (also covered by common placeholders above)
-#define RE_BRACES LR"(\{[\w.-:,]+\})"
 
 // python-format old style https://docs.python.org/2/library/stdtypes.html#string-formatting
 //               new style https://docs.python.org/3/library/string.html#format-string-syntax
-const wchar_t* RE_PYTHON_FORMAT = LR"((%(\(\w+\))?[-+ #0]?(\d+|\*)?(\.(\d+|\*))?[hlL]?[diouxXeEfFgGcrs%]))" // old style
-                                  "|"
-                                  RE_BRACES; // new style
+// (%(\(\w+\))?[-+ #0]?(\d+|\*)?(\.(\d+|\*))?[hlL]?[diouxXeEfFgGcrs%]) or braces
+struct PythonFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%{";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos) const
+    {
+        if (at(pos) == '{')
+            return match_braces(pos);
+
+        size_t i = pos + 1;
+        if (at(i) == '(')
+        {
+            size_t j = i + 1;
+            while (is_word(at(j)))
+                j++;
+            if (j > i + 1 && at(j) == ')')
+                i = j + 1;
+        }
+
+        if (is_one_of(at(i), L"-+ #0"))
+            i++;
+        i = skip_width(i);
+        i = skip_precision(i);
+        if (is_one_of(at(i), L"hlL"))
+            i++;
+
+        return match_if(pos, i, L"diouxXeEfFgGcrs%");
+    }
+};
+
+
+struct BracesFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"{";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos) const { return match_braces(pos); }
+};
 
-// ruby-format per https://ruby-doc.org/core-2.7.1/Kernel.html#method-i-sprintf
-const wchar_t* RE_RUBY_FORMAT = LR"(%(\d+\$)?[-+ #0]{0,5}(\d+|\*)?(\.(\d+|\*))?(hh|ll|[hljztL])?[%csdioxXufFeEaAgGnp])";
 
 // Qt and KDE formats
-const wchar_t* RE_QT_FORMAT = LR"(%L?(\d\d?|n))";
+// %L?(\d\d?|n)
+struct QtFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos) const
+    {
+        size_t i = pos + 1;
+        if (at(i) == 'L')
+            i++;
+        if (is_digit(at(i)))
+            return (is_digit(at(i + 1)) ? i + 2 : i + 1) - pos;
+        return match_if(pos, i, L"n");
+    }
+};
+
 
 // Lua
-const wchar_t* RE_LUA_FORMAT = LR"(%[- 0]*\d*(\.\d+)?[sqdiouXxAaEefGgc])";
+// %[- 0]*\d*(\.\d+)?[sqdiouXxAaEefGgc]
+struct LuaFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos) const
+    {
+        size_t i = skip_chars(pos + 1, L"- 0");
+        i = skip_digits(i);
+        if (at(i) == '.' && is_digit(at(i + 1)))
+            i = skip_digits(i + 1);
+
+        return match_if(pos, i, L"sqdiouXxAaEefGgc");
+    }
+};
+
 
 // Pascal per https://www.freepascal.org/docs-html/rtl/sysutils/format.html
-const wchar_t* RE_PASCAL_FORMAT = LR"(%(\*:|\d*:)?-?(\*|\d+)?(\.\*|\.\d+)?[dDuUxXeEfFgGnNmMsSpP])";
+// %(\*:|\d*:)?-?(\*|\d+)?(\.\*|\.\d+)?[dDuUxXeEfFgGnNmMsSpP]
+struct PascalFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos) const
+    {
+        size_t i = pos + 1;
+        if (at(i) == '*' && at(i + 1) == ':')
+        {
+            i += 2;
+        }
+        else
+        {
+            size_t j = skip_digits(i);
+            if (at(j) == ':')
+                i = j + 1;
+        }
+
+        if (at(i) == '-')
+            i++;
+        i = skip_width(i);
+        i = skip_precision(i);
+
+        return match_if(pos, i, L"dDuUxXeEfFgGnNmMsSpP");
+    }
+};
+
 
 // JavaScript format per https://www.gnu.org/software/gettext/manual/html_node/javascript_002dformat.html
-const wchar_t* RE_JAVASCRIPT_FORMAT = LR"(%[%csbdioOxXfj])";
+// %[%csbdioOxXfj]
+struct JavaScriptFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos) const { return match_if(pos, pos + 1, L"%csbdioOxXfj"); }
+};
+
 
 // Go format per https://pkg.go.dev/fmt
-const wchar_t* RE_GO_FORMAT = LR"(%[-+ #0]*(\d+|\*)?(\.(\d+|\*))?[vdoOxXbcqsptTeEfFgG%])";
+// %[-+ #0]*(\d+|\*)?(\.(\d+|\*))?[vdoOxXbcqsptTeEfFgG%]
+struct GoFormatScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%";
+    using PlaceholderScanner::PlaceholderScanner;
 
-// D format per https://dlang.org/library/std/format.html
-const wchar_t* RE_D_FORMAT = LR"(%(\d+\$)?[-+ #0=]*(\d+|\*)?(\.(\d+|\*))?([sdxXobfFeEgGaAc%]|\([^%]*(%[^%|)]*(%\|[^%)]*)?)%\)))";
+    size_t Match(size_t pos) const
+    {
+        size_t i = skip_chars(pos + 1, L"-+ #0");
+        i = skip_width(i);
+        i = skip_precision(i);
 
-} // anonymous namespace
+        return match_if(pos, i, L"vdoOxXbcqsptTeEfFgG%");
+    }
+};
 
 
-SyntaxHighlighterPtr SyntaxHighlighter::ForItem(const CatalogItem& item, int kindsMask, int flags)
+// D format per https://dlang.org/library/std/format.html
+// %(\d+\$)?[-+ #0=]*(\d+|\*)?(\.(\d+|\*))?([sdxXobfFeEgGaAc%]|\([^%]*(%[^%|)]*(%\|[^%)]*)?)%\))
+struct DFormatScanner : public PlaceholderScanner
 {
-    auto fmt = item.GetFormatFlag();
-    if (fmt.empty())
-        fmt = item.GetInternalFormatFlag();
+    static constexpr const wchar_t *TRIGGERS = L"%";
+    using PlaceholderScanner::PlaceholderScanner;
 
-    bool needsHTML = (kindsMask & Markup);
-    if (needsHTML)
+    size_t Match(size_t pos) const
     {
-        needsHTML = false;
+        size_t i = skip_positional(pos + 1);
+        i = skip_chars(i, L"-+ #0=");
+        i = skip_width(i);
+        i = skip_precision(i);
+
+        if (is_one_of(at(i), L"sdxXobfFeEgGaAc%"))
+            return i + 1 - pos;
+
+        // compound specifier %( ... %| separator %)
+        if (at(i) != '(')
+            return 0;
 
-        str::wstring_conv_t str1 = str::to_wstring(item.GetString());
-        if (str1.find(L"<") != std::wstring::npos && std::regex_search(str1, REOBJ_HTML_MARKUP))
+        size_t j = m_s.find('%', i + 1);
+        if (j == std::wstring::npos)
+            return 0;
+        j++;
+        while (j < m_len && !is_one_of(m_s[j], L"%|)"))
+            j++;
+        if (at(j) == '%' && at(j + 1) == '|')
         {
-            needsHTML = true;
+            j += 2;
+            while (j < m_len && m_s[j] != '%' && m_s[j] != ')')
+                j++;
         }
-        else if (item.HasPlural())
+
+        return (at(j) == '%' && at(j + 1) == ')') ? j + 2 - pos : 0;
+    }
+};
+
+
+// WebExtension-like $foo$ placeholders
+// \$[A-Za-z0-9_]+\$
+struct DollarPlaceholdersScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"$";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos) const
+    {
+        size_t j = pos + 1;
+        while (is_ascii_alnum(at(j)) || at(j) == '_')
+            j++;
+        return (j > pos + 1 && at(j) == '$') ? j + 1 - pos : 0;
+    }
+};
+
+
+// variables expansion for various template languages
+// %[\w.-]+%|%?\{[\w.-]+\}|\{\{[\w.-]+\}\}
+//
+//   %var% (Twig)
+//   %{var} (Ruby) and {var}
+//   {{var}}
+struct CommonPlaceholdersScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"%{";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos) const
+    {
+        const wchar_t close = (at(pos) == '%') ? '%' : '}';
+
+        // %var% or {var}
+        size_t j = skip_name(pos + 1);
+        if (j > pos + 1 && at(j) == close)
+            return j + 1 - pos;
+
+        // %{var} or {{var}}
+        if (at(pos + 1) == '{')
         {
-            str::wstring_conv_t strp = str::to_wstring(item.GetString());
-            if (strp.find(L"<") != std::wstring::npos && std::regex_search(strp, REOBJ_HTML_MARKUP))
+            j = skip_name(pos + 2);
+            if (j > pos + 2 && at(j) == '}')
             {
-                needsHTML = true;
+                if (close == '%')
+                    return j + 1 - pos;
+                else if (at(j + 1) == '}')
+                    return j + 2 - pos;
             }
         }
+
+        return 0;
     }
-    bool needsGenericPlaceholders = (kindsMask & Placeholder);
-    if (needsGenericPlaceholders)
+
+private:
+    size_t skip_name(size_t i) const
     {
-        if ((flags & EnforceFormatTag) && !fmt.empty())
+        while (is_word(at(i)) || at(i) == '.' || at(i) == '-')
+            i++;
+        return i;
+    }
+};
+
+
+// HTML/XML tags and entities
+// (<\/?[a-zA-Z0-9:-]+(\s+[-:\w]+(=([-:\w+]|"[^"]*"|'[^']*'))?)*\s*\/?>)|(&[^ ;]+;)
+struct HTMLMarkupScanner : public PlaceholderScanner
+{
+    static constexpr const wchar_t *TRIGGERS = L"<&";
+    using PlaceholderScanner::PlaceholderScanner;
+
+    size_t Match(size_t pos)
+    {
+        return (at(pos) == '&') ? MatchEntity(pos) : MatchTag(pos);
+    }
+
+private:
+    size_t MatchEntity(size_t pos)
+    {
+        // all entity starts within the same run share its end, don't rescan it:
+        if (m_entityRunEnd <= pos)
         {
-            // only use generic placeholders if no explicit format was provided, see https://github.com/vslavik/poedit/issues/777
-            needsGenericPlaceholders = false;
+            m_entityRunEnd = m_s.find_first_of(L" ;", pos + 1);
+            if (m_entityRunEnd == std::wstring::npos)
+                m_entityRunEnd = m_len;
         }
-        else
+        return (m_entityRunEnd > pos + 1 && at(m_entityRunEnd) == ';') ? m_entityRunEnd + 1 - pos : 0;
+    }
+
+    size_t MatchTag(size_t pos) const
+    {
+        size_t i = pos + 1;
+        if (at(i) == '/')
+            i++;
+
+        size_t j = i;
+        while (is_ascii_alnum(at(j)) || at(j) == ':' || at(j) == '-')
+            j++;
+        if (j == i)
+            return 0;
+        i = j;
+
+        // attributes:
+        for (;;)
         {
-            needsGenericPlaceholders = false;
+            j = i;
+            while (is_space(at(j)))
+                j++;
+            if (j == i)
+                break;
 
-            str::wstring_conv_t str1 = str::to_wstring(item.GetString());
-            if (str1.find_first_of(COMMON_PLACEHOLDERS_TRIGGER_CHARS) != std::wstring::npos && std::regex_search(str1, REOBJ_COMMON_PLACEHOLDERS))
-            {
-				needsGenericPlaceholders = true;
-			}
-            else if (item.HasPlural())
+            size_t k = j;
+            while (is_word(at(k)) || at(k) == '-' || at(k) == ':')
+                k++;
+            if (k == j)
+                break;
+
+            if (at(k) == '=')
             {
-                str::wstring_conv_t strp = str::to_wstring(item.GetString());
-                if (strp.find_first_of(COMMON_PLACEHOLDERS_TRIGGER_CHARS) != std::wstring::npos && std::regex_search(strp, REOBJ_COMMON_PLACEHOLDERS))
+                const wchar_t v = at(k + 1);
+                if (v == '"' || v == '\'')
+                {
+                    size_t q = m_s.find(v, k + 2);
+                    if (q != std::wstring::npos)
+                        k = q + 1;
+                }
+                else if (is_word(v) || is_one_of(v, L"-:+"))
                 {
-                    needsGenericPlaceholders = true;
+                    k += 2;
                 }
             }
+
+            i = k;
         }
+
+        while (is_space(at(i)))
+            i++;
+        if (at(i) == '/')
+            i++;
+
+        return (at(i) == '>') ? i + 1 - pos : 0;
     }
 
-    static auto basic = std::make_shared<BasicSyntaxHighlighter>();
-    if (!needsHTML && !needsGenericPlaceholders && fmt.empty())
+    size_t m_entityRunEnd = 0;
+};
+
+
+/// Highlight matches of a PlaceholderScanner-derived Scanner
+template<typename Scanner>
+class ScannerSyntaxHighlighter : public SyntaxHighlighter
+{
+public:
+    explicit ScannerSyntaxHighlighter(TextKind kind) : m_kind(kind) {}
+
+    void Highlight(const std::wstring& s, const CallbackType& highlight) override
     {
-        if (kindsMask & (LeadingWhitespace | Escape))
-            return basic;
-        else
-            return nullptr;
+        Scan(s, [&](size_t pos, size_t len)
+        {
+            highlight(int(pos), int(pos + len), m_kind);
+            return true;
+        });
+    }
+
+    /// Returns true if the text contains at least one match
+    static bool Matches(const std::wstring& s)
+    {
+        bool found = false;
+        Scan(s, [&found](size_t, size_t)
+        {
+            found = true;
+            return false;
+        });
+        return found;
+    }
+
+private:
+    template<typename F>
+    static void Scan(const std::wstring& s, F&& onMatch)
+    {
+        Scanner scanner(s);
+        size_t pos = s.find_first_of(Scanner::TRIGGERS);
+        while (pos != std::wstring::npos)
+        {
+            const size_t len = scanner.Match(pos);
+            if (len && !onMatch(pos, len))
+                return;
+            pos = s.find_first_of(Scanner::TRIGGERS, pos + std::max(len, size_t(1)));
+        }
     }
 
+    TextKind m_kind;
+};
+
+template<typename Scanner>
+inline std::shared_ptr<SyntaxHighlighter> MakeScannerHighlighter(SyntaxHighlighter::TextKind kind = SyntaxHighlighter::Placeholder)
+{
+    return std::make_shared<ScannerSyntaxHighlighter<Scanner>>(kind);
+}
+
+
+// Features of item's source text, cached in CatalogItem::m_syntaxFeatures
+enum SourceTextFeatures
+{
+    Feature_MarkupChecked       = 0x01,
+    Feature_Markup              = 0x02,
+    Feature_PlaceholdersChecked = 0x04,
+    Feature_Placeholders        = 0x08,
+    Feature_HighlightsCached    = 0x10
+};
+
+// guards all items' CatalogItem::m_sourceHighlights
+std::mutex gs_sourceHighlightsMutex;
+
+SyntaxHighlighterPtr GetBasicHighlighter()
+{
+    static auto basic = std::make_shared<BasicSyntaxHighlighter>();
+    return basic;
+}
+
+template<typename Scanner>
+bool SourceTextMatches(const CatalogItem& item)
+{
+    if (ScannerSyntaxHighlighter<Scanner>::Matches(str::to_wstring(item.GetString())))
+        return true;
+    return item.HasPlural() && ScannerSyntaxHighlighter<Scanner>::Matches(str::to_wstring(item.GetPluralString()));
+}
+
+SyntaxHighlighterPtr CreateHighlighter(const std::string& fmt, bool needsHTML, bool needsGenericPlaceholders, int kindsMask)
+{
     auto all = std::make_shared<CompositeSyntaxHighlighter>();
 
     // HTML goes first, has lowest priority than special-purpose stuff like format strings:
     if (needsHTML)
     {
-        static auto html = std::make_shared<RegexSyntaxHighlighter>(REOBJ_HTML_MARKUP, TextKind::Markup);
+        static auto html = MakeScannerHighlighter<HTMLMarkupScanner>(SyntaxHighlighter::Markup);
         all->Add(html);
     }
 
     if (needsGenericPlaceholders)
     {
         // If no format specified, heuristically apply highlighting of common variable markers
-        static auto placeholders = std::make_shared<RegexSyntaxHighlighter>(REOBJ_COMMON_PLACEHOLDERS, TextKind::Placeholder);
+        static auto placeholders = MakeScannerHighlighter<CommonPlaceholdersScanner>();
         all->Add(placeholders);
     }
 
-    if (!fmt.empty() && (kindsMask & Placeholder))
+    if (!fmt.empty() && (kindsMask & SyntaxHighlighter::Placeholder))
     {
         if (fmt == "php")
         {
-            static auto php_format = std::make_shared<RegexSyntaxHighlighter>(RE_PHP_FORMAT, TextKind::Placeholder);
+            static auto php_format = MakeScannerHighlighter<PHPFormatScanner>();
             all->Add(php_format);
         }
         else if (fmt == "c")
         {
-            static auto c_format = std::make_shared<RegexSyntaxHighlighter>(RE_C_FORMAT, TextKind::Placeholder);
+            static auto c_format = MakeScannerHighlighter<CFormatScanner>();
             all->Add(c_format);
         }
         else if (fmt == "c++" || fmt == "rust")
         {
-            static auto cxx_rust_format = std::make_shared<RegexSyntaxHighlighter>(RE_CXX20_OR_RUST_FORMAT, TextKind::Placeholder);
+            static auto cxx_rust_format = MakeScannerHighlighter<CxxOrRustFormatScanner>();
             all->Add(cxx_rust_format);
         }
         else if (fmt == "python")
         {
-            static auto python_format = std::make_shared<RegexSyntaxHighlighter>(RE_PYTHON_FORMAT, TextKind::Placeholder);
+            static auto python_format = MakeScannerHighlighter<PythonFormatScanner>();
             all->Add(python_format);
         }
         else if (fmt == "ruby")
         {
-            static auto ruby_format = std::make_shared<RegexSyntaxHighlighter>(RE_RUBY_FORMAT, TextKind::Placeholder);
+            static auto ruby_format = MakeScannerHighlighter<RubyFormatScanner>();
             all->Add(ruby_format);
         }
         else if (fmt == "objc")
         {
-            static auto objc_format = std::make_shared<RegexSyntaxHighlighter>(RE_OBJC_FORMAT, TextKind::Placeholder);
+            static auto objc_format = MakeScannerHighlighter<ObjCFormatScanner>();
             all->Add(objc_format);
         }
         else if (fmt == "qt" || fmt == "qt-plural" || fmt == "kde" || fmt == "kde-kuit")
         {
-            static auto qt_format = std::make_shared<RegexSyntaxHighlighter>(RE_QT_FORMAT, TextKind::Placeholder);
+            static auto qt_format = MakeScannerHighlighter<QtFormatScanner>();
             all->Add(qt_format);
         }
         else if (fmt == "lua")
         {
-            static auto lua_format = std::make_shared<RegexSyntaxHighlighter>(RE_LUA_FORMAT, TextKind::Placeholder);
+            static auto lua_format = MakeScannerHighlighter<LuaFormatScanner>();
             all->Add(lua_format);
         }
         else if (fmt == "csharp" || fmt == "perl-brace" || fmt == "python-brace")
         {
-            static auto brace_format = std::make_shared<RegexSyntaxHighlighter>(RE_BRACES, TextKind::Placeholder);
+            static auto brace_format = MakeScannerHighlighter<BracesFormatScanner>();
             all->Add(brace_format);
         }
         else if (fmt == "object-pascal")
         {
-            static auto pascal_format = std::make_shared<RegexSyntaxHighlighter>(RE_PASCAL_FORMAT, TextKind::Placeholder);
+            static auto pascal_format = MakeScannerHighlighter<PascalFormatScanner>();
             all->Add(pascal_format);
         }
         else if (fmt == "javascript")
         {
-            static auto javascript_format = std::make_shared<RegexSyntaxHighlighter>(RE_JAVASCRIPT_FORMAT, TextKind::Placeholder);
+            static auto javascript_format = MakeScannerHighlighter<JavaScriptFormatScanner>();
             all->Add(javascript_format);
         }
         else if (fmt == "go")
         {
-            static auto go_format = std::make_shared<RegexSyntaxHighlighter>(RE_GO_FORMAT, TextKind::Placeholder);
+            static auto go_format = MakeScannerHighlighter<GoFormatScanner>();
             all->Add(go_format);
         }
         else if (fmt == "d")
         {
-            static auto d_format = std::make_shared<RegexSyntaxHighlighter>(RE_D_FORMAT, TextKind::Placeholder);
+            static auto d_format = MakeScannerHighlighter<DFormatScanner>();
             all->Add(d_format);
         }
         else if (fmt == "ph-dollars")
         {
-            static auto dollars_format = std::make_shared<RegexSyntaxHighlighter>(REOBJ_DOLLAR_PLACEHOLDERS, TextKind::Placeholder);
+            static auto dollars_format = MakeScannerHighlighter<DollarPlaceholdersScanner>();
             all->Add(dollars_format);
         }
     }
 
     // basic highlighting has highest priority, so should come last in the order:
-    if (kindsMask & (LeadingWhitespace | Escape))
-        all->Add(basic);
+    if (kindsMask & (SyntaxHighlighter::LeadingWhitespace | SyntaxHighlighter::Escape))
+        all->Add(GetBasicHighlighter());
 
     return all;
 }
+
+} // anonymous namespace
+
+
+struct SourceHighlightsCache
+{
+    struct Entry
+    {
+        // highlighters are shared and never destroyed, so can be compared by address
+        const SyntaxHighlighter *syntax;
+        int variant;
+        SyntaxHighlighter::SpansPtr spans;
+    };
+    std::vector<Entry> entries;
+};
+
+
+SyntaxHighlighter::SpansPtr SyntaxHighlighter::HighlightSource(const CatalogItem& item, int variant, const std::wstring& text)
+{
+    {
+        std::lock_guard<std::mutex> lock(gs_sourceHighlightsMutex);
+        auto& cache = item.m_sourceHighlights;
+        if (cache && (item.m_syntaxFeatures.load(std::memory_order_relaxed) & Feature_HighlightsCached))
+        {
+            for (auto& e: cache->entries)
+            {
+                if (e.syntax == this && e.variant == variant)
+                    return e.spans;
+            }
+        }
+    }
+
+    // highlight outside of the lock, this is the expensive part:
+    auto spans = std::make_shared<Spans>();
+    Highlight(text, [&spans](int a, int b, TextKind kind){
+        spans->push_back({a, b, kind});
+    });
+    spans->shrink_to_fit();
+
+    std::lock_guard<std::mutex> lock(gs_sourceHighlightsMutex);
+    auto& cache = item.m_sourceHighlights;
+    if (!cache)
+        cache = std::make_shared<SourceHighlightsCache>();
+    if (!(item.m_syntaxFeatures.fetch_or(Feature_HighlightsCached, std::memory_order_relaxed) & Feature_HighlightsCached))
+    {
+        cache->entries.clear();  // source text changed since it was filled
+    }
+    else
+    {
+        // another thread may have been faster:
+        for (auto& e: cache->entries)
+        {
+            if (e.syntax == this && e.variant == variant)
+                return e.spans;
+        }
+    }
+    cache->entries.push_back({this, variant, spans});
+    return spans;
+}
+
+
+size_t SyntaxHighlighter::GetSourceHighlightsMemoryUsage(const CatalogItem& item)
+{
+    std::lock_guard<std::mutex> lock(gs_sourceHighlightsMutex);
+    auto& cache = item.m_sourceHighlights;
+    if (!cache)
+        return 0;
+    size_t size = sizeof(SourceHighlightsCache) + cache->entries.capacity() * sizeof(SourceHighlightsCache::Entry);
+    for (auto& e: cache->entries)
+        size += sizeof(Spans) + e.spans->capacity() * sizeof(Span);
+    return size;
+}
+
+
+SyntaxHighlighterPtr SyntaxHighlighter::ForItem(const CatalogItem& item, int kindsMask, int flags)
+{
+    auto fmt = item.GetFormatFlag();
+    if (fmt.empty())
+        fmt = item.GetInternalFormatFlag();
+
+    // Looking for markup or placeholders in the source text is relatively
+    // expensive, so it is only done once and remembered in the item:
+    auto hasFeature = [&item](unsigned checked, unsigned present, bool (*detect)(const CatalogItem&))
+    {
+        unsigned features = item.m_syntaxFeatures.load(std::memory_order_relaxed);
+        if (!(features & checked))
+        {
+            features = checked | (detect(item) ? present : 0);
+            item.m_syntaxFeatures.fetch_or(features, std::memory_order_relaxed);
+        }
+        return (features & present) != 0;
+    };
+
+    bool needsHTML = (kindsMask & Markup) &&
+                     hasFeature(Feature_MarkupChecked, Feature_Markup, SourceTextMatches<HTMLMarkupScanner>);
+
+    bool needsGenericPlaceholders = (kindsMask & Placeholder);
+    if (needsGenericPlaceholders)
+    {
+        if ((flags & EnforceFormatTag) && !fmt.empty())
+        {
+            // only use generic placeholders if no explicit format was provided, see https://github.com/vslavik/poedit/issues/777
+            needsGenericPlaceholders = false;
+        }
+        else
+        {
+            needsGenericPlaceholders = hasFeature(Feature_PlaceholdersChecked, Feature_Placeholders,
+                                                  SourceTextMatches<CommonPlaceholdersScanner>);
+        }
+    }
+
+    if (!needsHTML && !needsGenericPlaceholders && fmt.empty())
+    {
+        if (kindsMask & (LeadingWhitespace | Escape))
+            return GetBasicHighlighter();
+        else
+            return nullptr;
+    }
+
+    // Highlighters are stateless, so one instance can be shared by all items
+    // with the same needs:
+    if (!(kindsMask & Placeholder))
+        fmt.clear();
+    const int key = (needsHTML ? 1 : 0) |
+                    (needsGenericPlaceholders ? 2 : 0) |
+                    (kindsMask & (Placeholder | LeadingWhitespace | Escape)) << 2;
+
+    static std::mutex s_cacheMutex;
+    static std::map<std::pair<std::string, int>, SyntaxHighlighterPtr> s_cache;
+
+    std::lock_guard<std::mutex> lock(s_cacheMutex);
+    auto& cached = s_cache[std::make_pair(fmt, key)];
+    if (!cached)
+        cached = CreateHighlighter(fmt, needsHTML, needsGenericPlaceholders, kindsMask);
+    return cached;
+}
+
+
+SyntaxHighlighterPtr SyntaxHighlighter::ForFormat(const std::string& fmt)
+{
+    if (fmt.empty())
+        return nullptr;
+
+    static std::mutex s_cacheMutex;
+    static std::map<std::string, SyntaxHighlighterPtr> s_cache;
+
+    std::lock_guard<std::mutex> lock(s_cacheMutex);
+    auto i = s_cache.find(fmt);
+    if (i != s_cache.end())
+        return i->second;
+
+    auto h = std::static_pointer_cast<CompositeSyntaxHighlighter>(CreateHighlighter(fmt, false, false, Placeholder));
+    SyntaxHighlighterPtr result;
+    if (!h->empty())
+        result = h;
+    s_cache[fmt] = result;
+    return result;
+}
@@ -29,6 +29,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 class CatalogItem;
 
@@ -61,8 +62,26 @@ public:
         EnforceFormatTag   = 0x0001
     };
 
+    // Variants of item's source text for HighlightSource()
+    enum SourceVariant
+    {
+        SourceSingular     = 0x0000,
+        SourcePlural       = 0x0001,
+        // or-ed with the above for text as displayed, i.e. escaped, in the editor
+        SourceDisplayed    = 0x0002
+    };
+
     typedef std::function<void(int,int,TextKind)> CallbackType;
 
+    /// Highlighted range of text
+    struct Span
+    {
+        int from, to;
+        TextKind kind;
+    };
+    typedef std::vector<Span> Spans;
+    typedef std::shared_ptr<const Spans> SpansPtr;
+
     /**
         Perform highlighting in given text.
         
@@ -72,6 +91,22 @@ public:
      */
     virtual void Highlight(const std::wstring& s, const CallbackType& highlight) = 0;
 
+    /**
+        Highlight item's source text, reusing the result of previous calls.
+
+        Source text doesn't change while editing, so its highlighting is
+        cached in @a item and shared e.g. by QA checks and the editor. The
+        cache is discarded when the source text changes.
+
+        @param item    Item whose source text is highlighted
+        @param variant Which source text @a text is, SourceVariant combination
+        @param text    The text to highlight, if not cached yet
+     */
+    SpansPtr HighlightSource(const CatalogItem& item, int variant, const std::wstring& text);
+
+    /// Returns memory used by HighlightSource()'s cache in @a item
+    static size_t GetSourceHighlightsMemoryUsage(const CatalogItem& item);
+
     /**
         Return highlighter suitable for given translation item.
 
@@ -80,6 +115,12 @@ public:
         @param flags     Optional flags modifying behavior, e.g. EnforceFormatTag
      */
     static SyntaxHighlighterPtr ForItem(const CatalogItem& item, int kindsMask = 0xffff, int flags = 0);
+
+    /**
+        Return highlighter of placeholders in given format (e.g. "c" for c-format)
+        and nothing else, or nullptr if the format isn't known.
+     */
+    static SyntaxHighlighterPtr ForFormat(const std::string& fmt);
 };
 
 #endif // Poedit_syntaxhighlighter_h
@@ -28,6 +28,11 @@
 #include <wx/clipbrd.h>
 #include <wx/wupdlock.h>
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <tuple>
+
 #ifdef __WXOSX__
   #import <AppKit/NSTextView.h>
   #import <Foundation/NSUndoManager.h>
@@ -54,6 +59,7 @@
   _COM_SMARTPTR_TYPEDEF(ITextFont, __uuidof(ITextFont));
 #endif
 
+#include "catalog.h"
 #include "colorscheme.h"
 #include "spellchecking.h"
 #include "str_helpers.h"
@@ -63,6 +69,10 @@
 namespace
 {
 
+// Texts longer than this are highlighted with a delay after the user stops typing
+const size_t LONG_TEXT_LENGTH = 10000;
+const int LONG_TEXT_HIGHLIGHT_DELAY_MS = 150;
+
 #ifdef __WXOSX__
 
 inline NSTextView *TextView(const wxTextCtrl *ctrl)
@@ -612,9 +622,16 @@ AnyTranslatableTextCtrl::AnyTranslatableTextCtrl(wxWindow *parent, wxWindowID wi
 
     Bind(wxEVT_TEXT, [=](wxCommandEvent& e){
         e.Skip();
-        HighlightText();
+        // don't re-highlight long texts on every keystroke when typing fast:
+        if (m_highlightedText.length() > LONG_TEXT_LENGTH)
+            m_highlightTimer.StartOnce(LONG_TEXT_HIGHLIGHT_DELAY_MS);
+        else
+            HighlightChangedText();
     });
 
+    m_highlightTimer.SetOwner(this);
+    Bind(wxEVT_TIMER, [=](wxTimerEvent&){ HighlightChangedText(); }, m_highlightTimer.GetId());
+
     m_language = Language::English();
 }
 
@@ -859,7 +876,7 @@ void AnyTranslatableTextCtrl::UpdateRTLStyle()
 }
 #endif // !__WXMSW__
 
-void AnyTranslatableTextCtrl::HighlightText()
+std::wstring AnyTranslatableTextCtrl::GetTextForHighlighting() const
 {
 #ifdef __WXOSX__
     // See the comment in DoGetValueForRange() for why GetValue() returns subtly
@@ -884,22 +901,49 @@ void AnyTranslatableTextCtrl::HighlightText()
         std::u16string utf16 = boost::locale::conv::utf_to_utf<char16_t>([traw UTF8String]);
         text = std::wstring(utf16.begin(), utf16.end());
     }
+    return text;
+#else
+    return GetValue().ToStdWstring();
+#endif
+}
 
-    NSRange fullRange = NSMakeRange(0, text.length());
-    NSLayoutManager *layout = [TextView(this) layoutManager];
-    [layout removeTemporaryAttribute:NSForegroundColorAttributeName forCharacterRange:fullRange];
-    [layout removeTemporaryAttribute:NSBackgroundColorAttributeName forCharacterRange:fullRange];
-
+std::vector<AnyTranslatableTextCtrl::HighlightSpan> AnyTranslatableTextCtrl::FindHighlights(const std::wstring& text) const
+{
+    std::vector<HighlightSpan> spans;
     if (m_syntax)
     {
-        m_syntax->Highlight(text, [=](int a, int b, SyntaxHighlighter::TextKind kind){
-            [layout addTemporaryAttributes:m_attrs->For(kind) forCharacterRange:NSMakeRange(a, b-a)];
+        m_syntax->Highlight(text, [&spans](int a, int b, SyntaxHighlighter::TextKind kind){
+            spans.push_back({a, b, kind});
         });
     }
+    return spans;
+}
 
-#else // !__WXOSX__
+void AnyTranslatableTextCtrl::ApplyHighlights(int from, int to, const std::vector<HighlightSpan>& spans)
+{
+    // Resets [from,to) range to default style and applies the part of spans inside it, in order
+    auto forEachSpan = [=,&spans](const std::function<void(int,int,SyntaxHighlighter::TextKind)>& apply)
+    {
+        for (auto& s: spans)
+        {
+            const int a = std::max(s.from, from);
+            const int b = std::min(s.to, to);
+            if (a < b)
+                apply(a, b, s.kind);
+        }
+    };
+
+#ifdef __WXOSX__
+    NSRange range = NSMakeRange(from, to - from);
+    NSLayoutManager *layout = [TextView(this) layoutManager];
+    [layout removeTemporaryAttribute:NSForegroundColorAttributeName forCharacterRange:range];
+    [layout removeTemporaryAttribute:NSBackgroundColorAttributeName forCharacterRange:range];
+
+    forEachSpan([=](int a, int b, SyntaxHighlighter::TextKind kind){
+        [layout addTemporaryAttributes:m_attrs->For(kind) forCharacterRange:NSMakeRange(a, b-a)];
+    });
 
-    auto text = GetValue().ToStdWstring();
+#else // !__WXOSX__
 
     wxEventBlocker block(this, wxEVT_TEXT);
 
@@ -914,28 +958,110 @@ void AnyTranslatableTextCtrl::HighlightText()
     {
         // If possible, use TOM interface to apply temporary styles, which is much
         // more efficient. Unfortunately, it's not possible to do with read-only controls.
-        SetTOMTmpStyle(doc, 0, text.length(), deflt);
+        SetTOMTmpStyle(doc, from, to, deflt);
 
-        if (m_syntax)
-        {
-            m_syntax->Highlight(text, [=](int a, int b, SyntaxHighlighter::TextKind kind){
-                SetTOMTmpStyle(doc, a, b, m_attrs->For(kind));
-            });
-        }
+        forEachSpan([=](int a, int b, SyntaxHighlighter::TextKind kind){
+            SetTOMTmpStyle(doc, a, b, m_attrs->For(kind));
+        });
     }
     else
   #endif // __WXMSW___
     {
-        SetStyle(0, text.length(), deflt);
+        SetStyle(from, to, deflt);
+
+        forEachSpan([=](int a, int b, SyntaxHighlighter::TextKind kind){
+            SetStyle(a, b, m_attrs->For(kind));
+        });
+    }
+#endif // __WXOSX__/!__WXOSX__
+}
+
+void AnyTranslatableTextCtrl::HighlightText()
+{
+    m_highlightTimer.Stop();
+
+    m_highlightedText = GetTextForHighlighting();
+    m_highlights = FindHighlights(m_highlightedText);
+    m_hasHighlights = true;
+
+    ApplyHighlights(0, (int)m_highlightedText.length(), m_highlights);
+}
+
+void AnyTranslatableTextCtrl::HighlightChangedText()
+{
+    m_highlightTimer.Stop();
+
+    if (!m_hasHighlights)
+    {
+        HighlightText();
+        return;
+    }
 
-        if (m_syntax)
+    auto text = GetTextForHighlighting();
+    const auto& oldText = m_highlightedText;
+
+    // The edited part of the text is what remains after stripping common prefix and suffix:
+    const size_t common = std::min(oldText.length(), text.length());
+    size_t prefix = 0;
+    while (prefix < common && oldText[prefix] == text[prefix])
+        prefix++;
+    size_t suffix = 0;
+    while (suffix < common - prefix && oldText[oldText.length() - 1 - suffix] == text[text.length() - 1 - suffix])
+        suffix++;
+
+    const int editFrom = int(prefix);
+    const int editTo = int(text.length() - suffix);
+    const int oldEditTo = int(oldText.length() - suffix);
+    const int delta = editTo - oldEditTo;
+
+    auto spans = FindHighlights(text);
+
+    // Move previously applied highlights to where their text is now; those
+    // that were in the edited part don't exist anymore:
+    std::vector<HighlightSpan> previous;
+    previous.reserve(m_highlights.size());
+    for (auto s: m_highlights)
+    {
+        if (s.to <= editFrom)
         {
-            m_syntax->Highlight(text, [=](int a, int b, SyntaxHighlighter::TextKind kind){
-                SetStyle(a, b, m_attrs->For(kind));
-            });
+            previous.push_back(s);
+        }
+        else if (s.from >= oldEditTo)
+        {
+            s.from += delta;
+            s.to += delta;
+            previous.push_back(s);
         }
     }
-#endif // __WXOSX__/!__WXOSX__
+
+    // Only the edited text and highlights that differ from what's already
+    // applied need to be restyled:
+    auto order = [](const HighlightSpan& a, const HighlightSpan& b)
+    {
+        return std::tie(a.from, a.to, a.kind) < std::tie(b.from, b.to, b.kind);
+    };
+    auto current = spans;
+    std::sort(current.begin(), current.end(), order);
+    std::sort(previous.begin(), previous.end(), order);
+
+    std::vector<HighlightSpan> changed;
+    std::set_symmetric_difference(previous.begin(), previous.end(),
+                                  current.begin(), current.end(),
+                                  std::back_inserter(changed), order);
+
+    int dirtyFrom = editFrom;
+    int dirtyTo = editTo;
+    for (auto& s: changed)
+    {
+        dirtyFrom = std::min(dirtyFrom, s.from);
+        dirtyTo = std::max(dirtyTo, s.to);
+    }
+
+    if (dirtyFrom < dirtyTo)
+        ApplyHighlights(dirtyFrom, dirtyTo, spans);
+
+    m_highlightedText = std::move(text);
+    m_highlights = std::move(spans);
 }
 
 
@@ -946,6 +1072,25 @@ SourceTextCtrl::SourceTextCtrl(wxWindow *parent, wxWindowID winid)
     SetLanguage(Language::English());
 }
 
+void SourceTextCtrl::SetSourceText(const CatalogItem& item, bool plural)
+{
+    // The displayed text is always derived from the source text the same way,
+    // so its highlighting can be cached in the item too:
+    m_settingItem = &item;
+    m_settingVariant = (plural ? SyntaxHighlighter::SourcePlural : SyntaxHighlighter::SourceSingular) |
+                       SyntaxHighlighter::SourceDisplayed;
+    SetPlainText(plural ? item.GetPluralString() : item.GetString());
+    m_settingItem = nullptr;
+}
+
+std::vector<SourceTextCtrl::HighlightSpan> SourceTextCtrl::FindHighlights(const std::wstring& text) const
+{
+    if (m_settingItem && m_syntax)
+        return *m_syntax->HighlightSource(*m_settingItem, m_settingVariant, text);
+    else
+        return AnyTranslatableTextCtrl::FindHighlights(text);
+}
+
 
 TranslationTextCtrl::TranslationTextCtrl(wxWindow *parent, wxWindowID winid)
     : AnyTranslatableTextCtrl(parent, winid, wxNO_BORDER),
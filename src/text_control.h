@@ -27,7 +27,9 @@
 #define Poedit_text_control_h
 
 #include <wx/textctrl.h>
+#include <wx/timer.h>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "language.h"
@@ -111,7 +113,7 @@ public:
     ~AnyTranslatableTextCtrl();
 
     void SetLanguage(const Language& lang);
-    void SetSyntaxHighlighter(SyntaxHighlighterPtr syntax) { m_syntax = syntax; }
+    void SetSyntaxHighlighter(SyntaxHighlighterPtr syntax) { m_syntax = syntax; m_hasHighlights = false; }
 
     // Set and get control's text as plain/raw text, with no escaping or formatting.
     // This is the "true" representation, with e.g newlines included. The version
@@ -135,12 +137,28 @@ protected:
 #endif // __WXMSW__
 
 protected:
+    typedef SyntaxHighlighter::Span HighlightSpan;
+
+    /// Re-highlight the entire text
     void HighlightText();
 
+    /// Update highlighting after the text was edited, only restyling the changed parts
+    void HighlightChangedText();
+
+    std::wstring GetTextForHighlighting() const;
+    virtual std::vector<HighlightSpan> FindHighlights(const std::wstring& text) const;
+    void ApplyHighlights(int from, int to, const std::vector<HighlightSpan>& spans);
+
     class Attributes;
     SyntaxHighlighterPtr m_syntax;
     std::unique_ptr<Attributes> m_attrs;
     Language m_language;
+
+    // Text and highlights as of the last highlighting pass:
+    std::wstring m_highlightedText;
+    std::vector<HighlightSpan> m_highlights;
+    bool m_hasHighlights = false;
+    wxTimer m_highlightTimer;
 };
 
 
@@ -150,6 +168,17 @@ public:
     SourceTextCtrl(wxWindow *parent, wxWindowID winid);
 
     bool AcceptsFocus() const override { return false; }
+
+    /// Shows item's singular or plural source text, reusing its cached highlighting
+    void SetSourceText(const CatalogItem& item, bool plural);
+
+protected:
+    std::vector<HighlightSpan> FindHighlights(const std::wstring& text) const override;
+
+private:
+    // item whose text is being set by SetSourceText()
+    const CatalogItem *m_settingItem = nullptr;
+    int m_settingVariant = 0;
 };
 
 
@@ -0,0 +1,383 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "text_diff.h"
+
+#include "str_helpers.h"
+#include "tracing.h"
+#include "unicode_helpers.h"
+
+#include <algorithm>
+#include <mutex>
+
+
+namespace
+{
+
+// Edit distance (in tokens) beyond which the texts are considered entirely
+// different and the search is abandoned; it is O(D^2) in memory and not
+// useful to the user for very different texts anyway:
+const int MAX_EDIT_DISTANCE = 500;
+
+// guards all items' CatalogItem::m_oldMsgidDiff
+std::mutex gs_oldMsgidDiffMutex;
+
+
+std::vector<wxString> Tokenize(const wxString& text, unicode::BreakIterator& bi)
+{
+    std::vector<wxString> tokens;
+    if (text.empty())
+        return tokens;
+
+    auto utext = str::to_icu(text);
+    bi.set_text(utext);
+    int32_t start = bi.begin();
+    for (int32_t pos = bi.next(); pos != bi.end(); pos = bi.next())
+    {
+        tokens.push_back(str::to_wx(utext + start, pos - start));
+        start = pos;
+    }
+    return tokens;
+}
+
+
+/**
+    Finds the shortest edit script of a[begin,endA) -> b[begin,endB) using
+    Myers' algorithm and appends its operations to ops in order.
+
+    Returns false if the edit distance exceeds MAX_EDIT_DISTANCE.
+ */
+bool ShortestEditScript(const std::vector<wxString>& a, const std::vector<wxString>& b,
+                        size_t offset, int n, int m,
+                        std::vector<std::pair<TextDiff::Kind, size_t>>& ops)
+{
+    auto A = [&](int i) -> const wxString& { return a[offset + i]; };
+    auto B = [&](int i) -> const wxString& { return b[offset + i]; };
+
+    // trace[d][k + d] is the furthest x reached on diagonal k with d edits
+    std::vector<std::vector<int>> trace;
+    const int maxD = std::min(n + m, MAX_EDIT_DISTANCE);
+
+    int found = -1;
+    for (int d = 0; d <= maxD && found < 0; d++)
+    {
+        std::vector<int> v(2 * d + 1);
+        for (int k = -d; k <= d; k += 2)
+        {
+            int x;
+            if (d == 0)
+                x = 0;
+            else if (k == -d || (k != d && trace[d-1][k-1 + d-1] < trace[d-1][k+1 + d-1]))
+                x = trace[d-1][k+1 + d-1];      // insertion, moving down
+            else
+                x = trace[d-1][k-1 + d-1] + 1;  // deletion, moving right
+            int y = x - k;
+            while (x < n && y < m && A(x) == B(y))
+            {
+                x++;
+                y++;
+            }
+            v[k + d] = x;
+            if (x >= n && y >= m)
+                found = d;
+        }
+        trace.push_back(std::move(v));
+    }
+
+    if (found < 0)
+        return false;
+
+    // walk back from the end, collecting operations in reverse order:
+    std::vector<std::pair<TextDiff::Kind, size_t>> reversed;
+    int x = n, y = m;
+    for (int d = found; d > 0; d--)
+    {
+        const int k = x - y;
+        const auto& prev = trace[d-1];
+        const bool down = (k == -d || (k != d && prev[k-1 + d-1] < prev[k+1 + d-1]));
+        const int prevK = down ? k + 1 : k - 1;
+        const int prevX = prev[prevK + d-1];
+        const int prevY = prevX - prevK;
+
+        while (x > prevX && y > prevY)
+        {
+            x--; y--;
+            reversed.emplace_back(TextDiff::Kind::Equal, offset + x);
+        }
+        if (down)
+            reversed.emplace_back(TextDiff::Kind::Inserted, offset + --y);
+        else
+            reversed.emplace_back(TextDiff::Kind::Deleted, offset + --x);
+    }
+    while (x > 0)
+    {
+        x--;
+        reversed.emplace_back(TextDiff::Kind::Equal, offset + x);
+    }
+
+    ops.insert(ops.end(), reversed.rbegin(), reversed.rend());
+    return true;
+}
+
+
+bool IsWhitespace(const wxString& s)
+{
+    for (auto c: s)
+    {
+        if (!wxIsspace(c))
+            return false;
+    }
+    return true;
+}
+
+
+wxString GetOldSourceText(const CatalogItem& item)
+{
+    return item.GetOldMsgid();
+}
+
+wxString GetCurrentSourceText(const CatalogItem& item)
+{
+    // same form as GetOldMsgid() uses for msgid_plural:
+    if (item.HasPlural())
+        return item.GetString() + "\n" + item.GetPluralString();
+    return item.GetString();
+}
+
+} // anonymous namespace
+
+
+TextDiffPtr TextDiff::Compute(const wxString& oldText, const wxString& newText, const Language& lang)
+{
+    unicode::BreakIterator bi(UBRK_WORD, lang);
+    auto a = Tokenize(oldText, bi);
+    auto b = Tokenize(newText, bi);
+
+    // common prefix and suffix are typically most of the text, handle them
+    // outside of the quadratic part:
+    size_t prefix = 0;
+    while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix])
+        prefix++;
+    size_t suffix = 0;
+    while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+           a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix])
+    {
+        suffix++;
+    }
+
+    std::vector<std::pair<Kind, size_t>> ops;
+    for (size_t i = 0; i < prefix; i++)
+        ops.emplace_back(Kind::Equal, i);
+
+    const int n = int(a.size() - prefix - suffix);
+    const int m = int(b.size() - prefix - suffix);
+    if (!ShortestEditScript(a, b, prefix, n, m, ops))
+    {
+        // too different, just replace everything:
+        for (int i = 0; i < n; i++)
+            ops.emplace_back(Kind::Deleted, prefix + i);
+        for (int i = 0; i < m; i++)
+            ops.emplace_back(Kind::Inserted, prefix + i);
+    }
+
+    for (size_t i = 0; i < suffix; i++)
+        ops.emplace_back(Kind::Equal, a.size() - suffix + i);
+
+    // Build segments, grouping deletions and insertions of every run of
+    // changes together. Whitespace between two changed words is included in
+    // the run too, so that a replaced phrase reads as one change rather than
+    // as a sequence of changed words:
+    auto diff = std::make_shared<TextDiff>();
+    auto& segments = diff->m_segments;
+    wxString deleted, inserted;
+
+    auto append = [&segments](Kind kind, const wxString& text)
+    {
+        if (text.empty())
+            return;
+        if (!segments.empty() && segments.back().kind == kind)
+            segments.back().text += text;
+        else
+            segments.push_back({kind, text});
+    };
+    auto flush = [&]
+    {
+        append(Kind::Deleted, deleted);
+        append(Kind::Inserted, inserted);
+        deleted.clear();
+        inserted.clear();
+    };
+
+    for (size_t i = 0; i < ops.size(); i++)
+    {
+        auto& op = ops[i];
+        switch (op.first)
+        {
+            case Kind::Deleted:
+                deleted += a[op.second];
+                break;
+            case Kind::Inserted:
+                inserted += b[op.second];
+                break;
+            case Kind::Equal:
+            {
+                auto& token = a[op.second];
+                const bool inRun = !deleted.empty() || !inserted.empty();
+                if (inRun && i + 1 < ops.size() && ops[i + 1].first != Kind::Equal && IsWhitespace(token))
+                {
+                    deleted += token;
+                    inserted += token;
+                }
+                else
+                {
+                    flush();
+                    append(Kind::Equal, token);
+                }
+                break;
+            }
+        }
+    }
+    flush();
+
+    return diff;
+}
+
+
+void TextDiff::StoreForOldMsgid(const CatalogItem& item, const TextDiffPtr& diff)
+{
+    // the item may have changed in the meantime, but that's harmless,
+    // cached diffs are verified when used:
+    std::lock_guard<std::mutex> lock(gs_oldMsgidDiffMutex);
+    item.m_oldMsgidDiff = diff;
+}
+
+
+bool TextDiff::Matches(const wxString& oldText, const wxString& newText) const
+{
+    size_t oldPos = 0, newPos = 0;
+    for (auto& s: m_segments)
+    {
+        const size_t len = s.text.length();
+        if (s.kind != Kind::Inserted)
+        {
+            if (oldText.compare(oldPos, len, s.text) != 0)
+                return false;
+            oldPos += len;
+        }
+        if (s.kind != Kind::Deleted)
+        {
+            if (newText.compare(newPos, len, s.text) != 0)
+                return false;
+            newPos += len;
+        }
+    }
+    return oldPos == oldText.length() && newPos == newText.length();
+}
+
+
+TextDiffPtr TextDiff::GetCachedForOldMsgid(const CatalogItem& item)
+{
+    TextDiffPtr diff;
+    {
+        std::lock_guard<std::mutex> lock(gs_oldMsgidDiffMutex);
+        diff = item.m_oldMsgidDiff;
+    }
+    if (!diff || !item.HasOldMsgid())
+        return nullptr;
+
+    if (!diff->Matches(GetOldSourceText(item), GetCurrentSourceText(item)))
+        return nullptr;
+    return diff;
+}
+
+
+dispatch::future<TextDiffPtr> TextDiff::ComputeForOldMsgid(const CatalogItemPtr& item, const Language& srclang)
+{
+    if (!item->HasOldMsgid())
+        return dispatch::make_ready_future(TextDiffPtr());
+
+    if (auto cached = GetCachedForOldMsgid(*item))
+        return dispatch::make_ready_future(std::move(cached));
+
+    // the item may only be accessed on the main thread, so take the texts now:
+    return dispatch::async(dispatch::priority::interactive,
+                           [item, srclang, oldText = GetOldSourceText(*item), newText = GetCurrentSourceText(*item)]
+    {
+        auto diff = Compute(oldText, newText, srclang);
+        StoreForOldMsgid(*item, diff);
+        return diff;
+    });
+}
+
+
+dispatch::future<void> TextDiff::PrecomputeForOldMsgids(const CatalogPtr& catalog)
+{
+    struct Work
+    {
+        CatalogItemPtr item;
+        wxString oldText, newText;
+    };
+
+    // only fuzzy items can have old source text; this is cheaper to check:
+    auto work = std::make_shared<std::vector<Work>>();
+    for (auto& item: catalog->items())
+    {
+        if (!item->IsFuzzy() || !item->HasOldMsgid())
+            continue;
+        if (GetCachedForOldMsgid(*item))
+            continue;
+        work->push_back({item, GetOldSourceText(*item), GetCurrentSourceText(*item)});
+    }
+
+    if (work->empty())
+        return dispatch::make_ready_future();
+
+    wxLogTrace("poedit.diff", "precomputing %d old source text diffs", (int)work->size());
+
+    return dispatch::async(dispatch::priority::bulk, [work, srclang = catalog->GetSourceLanguage()]
+    {
+        TRACE_SPAN("diff", "PrecomputeForOldMsgids");
+
+        dispatch::parallel_options options;
+        options.prio = dispatch::priority::bulk;
+        dispatch::parallel_for_each(*work, [&srclang](const Work& w)
+        {
+            StoreForOldMsgid(*w.item, Compute(w.oldText, w.newText, srclang));
+        }, options);
+    });
+}
+
+
+size_t TextDiff::GetMemoryUsage(const CatalogItem& item)
+{
+    std::lock_guard<std::mutex> lock(gs_oldMsgidDiffMutex);
+    auto& diff = item.m_oldMsgidDiff;
+    if (!diff)
+        return 0;
+    size_t size = sizeof(TextDiff) + diff->m_segments.capacity() * sizeof(Segment);
+    for (auto& s: diff->m_segments)
+        size += CatalogMemoryUsage::Of(s.text);
+    return size;
+}
@@ -0,0 +1,112 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_text_diff_h
+#define Poedit_text_diff_h
+
+#include "catalog.h"
+#include "concurrency.h"
+
+#include <memory>
+#include <vector>
+
+class TextDiff;
+typedef std::shared_ptr<const TextDiff> TextDiffPtr;
+
+
+/**
+    Word-level difference between two texts.
+
+    Texts are split into words, whitespace and punctuation using ICU word
+    breaking rules and the shortest edit script transforming the old sequence
+    into the new one is found using Myers' O(ND) algorithm.
+ */
+class TextDiff
+{
+public:
+    enum class Kind
+    {
+        Equal,
+        Deleted,
+        Inserted
+    };
+
+    struct Segment
+    {
+        Kind kind;
+        wxString text;
+    };
+
+    /// Computes the difference of @a oldText and @a newText in language @a lang
+    static TextDiffPtr Compute(const wxString& oldText, const wxString& newText, const Language& lang);
+
+    /**
+        Segments of the difference, in order.
+
+        Concatenating Equal and Deleted segments gives the old text, Equal and
+        Inserted ones the new text. Deleted segments precede Inserted ones
+        in every run of changes.
+     */
+    const std::vector<Segment>& GetSegments() const { return m_segments; }
+
+    /// Is this the difference of @a oldText and @a newText?
+    bool Matches(const wxString& oldText, const wxString& newText) const;
+
+    /**
+        Returns difference of item's previous source text (see
+        CatalogItem::GetOldMsgid()) and the current one, if already computed.
+
+        The diffs are cached in the items; nullptr is returned if there's none
+        for the item's current texts. Must be called on the main thread.
+     */
+    static TextDiffPtr GetCachedForOldMsgid(const CatalogItem& item);
+
+    /**
+        Computes item's old source text diff in background, unless cached.
+
+        Must be called on the main thread. The future is set to nullptr if the
+        item has no old source text.
+     */
+    static dispatch::future<TextDiffPtr> ComputeForOldMsgid(const CatalogItemPtr& item, const Language& srclang);
+
+    /**
+        Computes diffs of all fuzzy items' old source texts in background.
+
+        Used after updating the catalog, when there may be many of them, so
+        that they are shown instantly when browsing the items. Must be called
+        on the main thread.
+     */
+    static dispatch::future<void> PrecomputeForOldMsgids(const CatalogPtr& catalog);
+
+    /// Returns memory used by the item's cached diff
+    static size_t GetMemoryUsage(const CatalogItem& item);
+
+private:
+    static void StoreForOldMsgid(const CatalogItem& item, const TextDiffPtr& diff);
+
+    std::vector<Segment> m_segments;
+};
+
+#endif // Poedit_text_diff_h
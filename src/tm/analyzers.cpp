@@ -0,0 +1,338 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "analyzers.h"
+
+#include "str_helpers.h"
+#include "unicode_helpers.h"
+
+#include <unicode/uscript.h>
+
+#include <LowerCaseFilter.h>
+#include <OffsetAttribute.h>
+#include <PerFieldAnalyzerWrapper.h>
+#include <Reader.h>
+#include <StandardAnalyzer.h>
+#include <TermAttribute.h>
+#include <Tokenizer.h>
+
+#include <vector>
+
+using namespace Lucene;
+
+namespace
+{
+
+const int TEXT_ANALYSIS_COUNT = 3;
+
+// Identifiers of TextAnalysis values stored in documents. Change them if the
+// tokenization changes, so that existing documents are reindexed.
+const wchar_t *TEXT_ANALYSIS_IDS[TEXT_ANALYSIS_COUNT] = { L"std", L"cjk1", L"wb1" };
+
+
+// Is the character bigram-indexed with TextAnalysis::CJKBigrams?
+bool IsCJK(UChar32 c)
+{
+    // script extensions are checked too, for e.g. the prolonged sound mark:
+    return uscript_hasScript(c, USCRIPT_HAN) ||
+           uscript_hasScript(c, USCRIPT_HIRAGANA) ||
+           uscript_hasScript(c, USCRIPT_KATAKANA) ||
+           uscript_hasScript(c, USCRIPT_HANGUL);
+}
+
+
+/**
+    Tokenizer implementing the non-standard TextAnalysis variants.
+
+    Words are found with ICU's word break iterator. With CJKBigrams, adjacent
+    words in CJK scripts are further split into overlapping bigrams of their
+    characters, so that the tokens don't depend on ICU's dictionaries and
+    partial matches can be found. TM texts are short, so the whole input is
+    tokenized at once.
+ */
+class WordsTokenizer : public Tokenizer
+{
+public:
+    WordsTokenizer(TextAnalysis analysis, const ReaderPtr& input)
+        : Tokenizer(input), m_analysis(analysis), m_tokenized(false), m_next(0)
+    {
+        m_termAttr = addAttribute<TermAttribute>();
+        m_offsetAttr = addAttribute<OffsetAttribute>();
+    }
+
+    LUCENE_CLASS(WordsTokenizer);
+
+    bool incrementToken() override
+    {
+        if (!m_tokenized)
+            Tokenize();
+        if (m_next >= m_tokens.size())
+            return false;
+
+        clearAttributes();
+        auto& t = m_tokens[m_next++];
+        m_termAttr->setTermBuffer(m_text.substr(t.first, t.second - t.first));
+        m_offsetAttr->setOffset(correctOffset(t.first), correctOffset(t.second));
+        return true;
+    }
+
+    void end() override
+    {
+        const int32_t finalOffset = correctOffset((int32_t)m_text.length());
+        m_offsetAttr->setOffset(finalOffset, finalOffset);
+    }
+
+    void reset() override
+    {
+        TokenStream::reset();
+        m_next = 0;
+    }
+
+    void reset(const ReaderPtr& input) override
+    {
+        Tokenizer::reset(input);
+        m_tokenized = false;
+        m_next = 0;
+    }
+
+private:
+    void Tokenize();
+
+    // Adds token [start,end) given as UTF-16 indexes
+    void AddToken(int32_t start, int32_t end)
+    {
+        m_tokens.emplace_back(TextOffset(start), TextOffset(end));
+    }
+
+    // Translates UTF-16 index into index into m_text
+    int32_t TextOffset(int32_t i) const
+    {
+        return m_offsets.empty() ? i : m_offsets[i];
+    }
+
+    TextAnalysis m_analysis;
+    TermAttributePtr m_termAttr;
+    OffsetAttributePtr m_offsetAttr;
+
+    std::wstring m_text;
+    str::UCharScratchBuffer m_buffer;
+    // m_text indexes of UTF-16 code units, only used if wchar_t isn't UTF-16:
+    std::vector<int32_t> m_offsets;
+
+    bool m_tokenized;
+    std::vector<std::pair<int32_t, int32_t>> m_tokens;
+    size_t m_next;
+};
+
+
+void WordsTokenizer::Tokenize()
+{
+    m_tokenized = true;
+    m_tokens.clear();
+    m_next = 0;
+
+    m_text.clear();
+    wchar_t buf[1024];
+    int32_t read;
+    while ((read = input->read(buf, 0, (int32_t)WXSIZEOF(buf))) > 0)
+        m_text.append(buf, read);
+
+    auto utext = str::to_icu(m_text, m_buffer);
+    int32_t ulength = (int32_t)m_text.length();
+    m_offsets.clear();
+#if SIZEOF_WCHAR_T != 2
+    for (size_t i = 0; i < m_text.length(); i++)
+    {
+        m_offsets.push_back((int32_t)i);
+        const UChar32 c = (UChar32)m_text[i];
+        if (c > 0xFFFF && c <= 0x10FFFF) // encoded as surrogate pair
+            m_offsets.push_back((int32_t)i);
+    }
+    ulength = (int32_t)m_offsets.size();
+    m_offsets.push_back((int32_t)m_text.length());
+#endif
+
+    // UTF-16 indexes of characters of the current run of CJK words:
+    std::vector<int32_t> run;
+    auto flushRun = [&]
+    {
+        if (run.size() == 2)
+            AddToken(run[0], run[1]); // single character
+        for (size_t i = 0; i + 2 < run.size(); i++)
+            AddToken(run[i], run[i + 2]);
+        run.clear();
+    };
+
+    unicode::BreakIterator bi(UBRK_WORD, Language());
+    bi.set_text(utext);
+    int32_t start = bi.begin();
+    for (int32_t end = bi.next(); end != bi.end(); start = end, end = bi.next())
+    {
+        // UBRK_WORD_NONE is for spaces and punctuation, anything else is some kind of word
+        const int32_t status = bi.rule();
+        if (status >= UBRK_WORD_NONE && status < UBRK_WORD_NONE_LIMIT)
+        {
+            flushRun();
+            continue;
+        }
+
+        UChar32 c;
+        int32_t i = start;
+        U16_NEXT(utext, i, ulength, c);
+        if (m_analysis == TextAnalysis::CJKBigrams && IsCJK(c))
+        {
+            if (run.empty())
+                run.push_back(start);
+            for (i = start; i < end;)
+            {
+                U16_FWD_1(utext, i, end);
+                run.push_back(i);
+            }
+        }
+        else
+        {
+            flushRun();
+            AddToken(start, end);
+        }
+    }
+    flushRun();
+}
+
+
+class WordsAnalyzer : public Analyzer
+{
+public:
+    explicit WordsAnalyzer(TextAnalysis analysis) : m_analysis(analysis) {}
+
+    LUCENE_CLASS(WordsAnalyzer);
+
+    TokenStreamPtr tokenStream(const String& /*fieldName*/, const ReaderPtr& reader) override
+    {
+        return newLucene<LowerCaseFilter>(newLucene<WordsTokenizer>(m_analysis, reader));
+    }
+
+    TokenStreamPtr reusableTokenStream(const String& /*fieldName*/, const ReaderPtr& reader) override
+    {
+        auto streams = boost::dynamic_pointer_cast<SavedStreams>(getPreviousTokenStream());
+        if (!streams)
+        {
+            streams = newLucene<SavedStreams>();
+            streams->tokenizer = newLucene<WordsTokenizer>(m_analysis, reader);
+            streams->filtered = newLucene<LowerCaseFilter>(streams->tokenizer);
+            setPreviousTokenStream(streams);
+        }
+        else
+        {
+            streams->tokenizer->reset(reader);
+        }
+        return streams->filtered;
+    }
+
+private:
+    class SavedStreams : public LuceneObject
+    {
+    public:
+        LUCENE_CLASS(SavedStreams);
+
+        boost::shared_ptr<WordsTokenizer> tokenizer;
+        TokenStreamPtr filtered;
+    };
+
+    TextAnalysis m_analysis;
+};
+
+
+// All combinations of source and translation analyzers, created on first use
+// and intentionally never destroyed, as they may be used during shutdown.
+struct TMAnalyzers
+{
+    TMAnalyzers()
+    {
+        AnalyzerPtr base[TEXT_ANALYSIS_COUNT] =
+        {
+            newLucene<StandardAnalyzer>(LuceneVersion::LUCENE_CURRENT),
+            newLucene<WordsAnalyzer>(TextAnalysis::CJKBigrams),
+            newLucene<WordsAnalyzer>(TextAnalysis::WordBreak)
+        };
+
+        for (int src = 0; src < TEXT_ANALYSIS_COUNT; src++)
+        {
+            for (int trans = 0; trans < TEXT_ANALYSIS_COUNT; trans++)
+            {
+                if (src == trans)
+                {
+                    pairs[src][trans] = base[src];
+                }
+                else
+                {
+                    auto wrapper = newLucene<PerFieldAnalyzerWrapper>(base[src]);
+                    wrapper->addAnalyzer(L"transtext", base[trans]);
+                    pairs[src][trans] = wrapper;
+                }
+            }
+        }
+    }
+
+    static TMAnalyzers& Get()
+    {
+        static TMAnalyzers *s_instance = new TMAnalyzers;
+        return *s_instance;
+    }
+
+    AnalyzerPtr pairs[TEXT_ANALYSIS_COUNT][TEXT_ANALYSIS_COUNT];
+};
+
+} // anonymous namespace
+
+
+TextAnalysis GetTextAnalysis(const Language& lang)
+{
+    const auto code = lang.Lang();
+    if (code == "zh" || code == "ja" || code == "ko")
+        return TextAnalysis::CJKBigrams;
+    if (code == "th" || code == "lo" || code == "km" || code == "my")
+        return TextAnalysis::WordBreak;
+    return TextAnalysis::Standard;
+}
+
+
+AnalyzerPtr GetTMAnalyzer(const Language& srclang, const Language& lang)
+{
+    return TMAnalyzers::Get().pairs[(int)GetTextAnalysis(srclang)][(int)GetTextAnalysis(lang)];
+}
+
+
+std::wstring GetTMAnalysisId(const Language& srclang, const Language& lang)
+{
+    const auto src = GetTextAnalysis(srclang);
+    const auto trans = GetTextAnalysis(lang);
+    if (src == TextAnalysis::Standard && trans == TextAnalysis::Standard)
+        return std::wstring();
+
+    std::wstring id(TEXT_ANALYSIS_IDS[(int)src]);
+    id += L'/';
+    id += TEXT_ANALYSIS_IDS[(int)trans];
+    return id;
+}
@@ -0,0 +1,76 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_tm_analyzers_h
+#define Poedit_tm_analyzers_h
+
+#include "language.h"
+
+#include <Lucene.h>
+
+#include <string>
+
+
+/**
+    How are texts in a language split into tokens for indexing in the TM.
+
+    Lucene's standard analyzer only works well for languages that separate
+    words with spaces. It indexes each Chinese or Japanese character as a
+    separate token, so fuzzy searches match huge numbers of unrelated
+    documents, and it can't split Thai texts into words at all.
+ */
+enum class TextAnalysis
+{
+    /// Lucene's StandardAnalyzer, for most languages
+    Standard,
+    /// Overlapping bigrams of Han, kana and Hangul characters (Chinese, Japanese, Korean)
+    CJKBigrams,
+    /// Words found with ICU word breaking rules (Thai, Lao, Khmer, Burmese)
+    WordBreak
+};
+
+/// Returns analysis used for texts in @a lang
+TextAnalysis GetTextAnalysis(const Language& lang);
+
+/**
+    Returns analyzer for TM documents in given languages.
+
+    The "transtext" field is analyzed as text in @a lang, all other fields
+    (i.e. "source") as text in @a srclang. The same analyzer must be used for
+    both indexing documents and querying them. Returned analyzers are shared
+    and can be used from multiple threads.
+ */
+Lucene::AnalyzerPtr GetTMAnalyzer(const Language& srclang, const Language& lang);
+
+/**
+    Returns identifier of the analysis of TM documents in given languages.
+
+    It is stored with documents that don't use TextAnalysis::Standard only,
+    so that documents indexed differently (e.g. by older versions) can be
+    found and reindexed. Returns empty string for standard analysis.
+ */
+std::wstring GetTMAnalysisId(const Language& srclang, const Language& lang);
+
+#endif // Poedit_tm_analyzers_h
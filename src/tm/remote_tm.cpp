@@ -0,0 +1,636 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "remote_tm.h"
+
+#ifdef HAVE_HTTP_CLIENT
+
+#include "configuration.h"
+#include "edapp.h"
+#include "errors.h"
+#include "http_client.h"
+#include "json.h"
+#include "keychain_cache.h"
+#include "str_helpers.h"
+#include "utility.h"
+
+#include <wx/filename.h>
+#include <wx/log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+
+namespace
+{
+
+typedef std::chrono::steady_clock clock_type;
+
+// how long to wait for more queries before sending them together:
+const auto COALESCING_DELAY = std::chrono::milliseconds(50);
+// time after which queries are answered with no suggestions:
+const auto INTERACTIVE_DEADLINE = std::chrono::milliseconds(1500);
+const auto BATCH_DEADLINE = std::chrono::seconds(15);
+// don't bother the server again for a while after a failed request:
+const auto OFFLINE_RETRY_DELAY = std::chrono::seconds(60);
+const size_t MAX_TEXTS_PER_REQUEST = 50;
+
+const int CACHE_VERSION = 1;
+const size_t MAX_CACHE_ENTRIES = 20000;
+const time_t CACHE_EXPIRATION = 30 * 24 * 3600;
+const auto CACHE_SAVE_DELAY = std::chrono::seconds(30);
+
+const char *KEYCHAIN_SERVICE = "RemoteTM";
+
+uint64_t HashQuery(const SuggestionQuery& q)
+{
+    // include the terminators so that different splits of the same text differ:
+    auto srclang = q.srclang.LanguageTag();
+    auto lang = q.lang.LanguageTag();
+    auto source = str::to_utf8(q.source);
+    auto hash = HashFNV1a(srclang.c_str(), srclang.size() + 1);
+    hash = HashFNV1a(lang.c_str(), lang.size() + 1, hash);
+    return HashFNV1a(source.c_str(), source.size(), hash);
+}
+
+} // anonymous namespace
+
+
+class RemoteTM::impl : public std::enable_shared_from_this<RemoteTM::impl>
+{
+public:
+    impl(const std::string& url)
+        : m_url(url),
+          m_cacheFile(PoeditApp::GetCacheDir("RemoteTM") + "/suggestions.json")
+    {
+    }
+
+    void Start()
+    {
+        std::weak_ptr<impl> weakSelf = shared_from_this();
+        KeychainCache::Get().GetPassword(KEYCHAIN_SERVICE)
+            .then([weakSelf](dispatch::future<std::string> token)
+            {
+                auto self = weakSelf.lock();
+                if (!self)
+                    return;
+                std::string auth;
+                try
+                {
+                    auth = token.get();
+                }
+                catch (...)
+                {
+                    wxLogTrace("poedit.remote_tm", "Failed to read access token: %s", DescribeCurrentException());
+                }
+                std::lock_guard<std::mutex> lock(self->m_mutex);
+                self->m_client.reset(new http_client(self->m_url));
+                if (!auth.empty())
+                    self->m_client->set_authorization("Bearer " + auth);
+                self->m_cv.notify_all();
+            });
+
+        m_worker = std::thread([weakSelf]{
+            if (auto self = weakSelf.lock())
+                self->Worker();
+        });
+    }
+
+    void Stop()
+    {
+        Fulfillments abandoned;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            m_cv.notify_all();
+            for (auto& p: m_pending)
+            {
+                for (auto& w: p.second->waiters)
+                    abandoned.emplace_back(w.promise, SuggestionsList());
+            }
+            m_pending.clear();
+            m_unsent.clear();
+        }
+        Fulfill(abandoned);
+        if (m_worker.joinable())
+            m_worker.join();
+        SaveCache();
+    }
+
+    dispatch::future<SuggestionsList> Query(const SuggestionQuery& q, clock_type::duration timeout)
+    {
+        const auto key = HashQuery(q);
+        const auto now = clock_type::now();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto cached = m_cache.find(key);
+        if (cached != m_cache.end() && cached->second.time + CACHE_EXPIRATION > time(NULL))
+            return dispatch::make_ready_future(SuggestionsList(cached->second.suggestions));
+
+        if (m_stopping || now < m_offlineUntil)
+            return dispatch::make_ready_future(SuggestionsList());
+
+        auto& pending = m_pending[key];
+        if (!pending)
+        {
+            pending = std::make_shared<Pending>();
+            pending->query = q;
+            if (m_unsent.empty())
+                m_firstUnsent = now;
+            m_unsent.push_back(key);
+        }
+
+        Waiter waiter;
+        waiter.promise = std::make_shared<dispatch::promise<SuggestionsList>>();
+        waiter.deadline = now + timeout;
+        pending->waiters.push_back(waiter);
+
+        m_cv.notify_all();
+        return waiter.promise->get_future();
+    }
+
+    dispatch::future<std::vector<SuggestionsList>> QueryBatch(const std::vector<SuggestionQuery>& queries)
+    {
+        struct Results
+        {
+            std::mutex mutex;
+            std::vector<SuggestionsList> lists;
+            size_t remaining;
+            dispatch::promise<std::vector<SuggestionsList>> promise;
+        };
+
+        if (queries.empty())
+            return dispatch::make_ready_future(std::vector<SuggestionsList>());
+
+        auto results = std::make_shared<Results>();
+        results->lists.resize(queries.size());
+        results->remaining = queries.size();
+        auto future = results->promise.get_future();
+
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            // queries never fail, they finish with no suggestions instead
+            Query(queries[i], BATCH_DEADLINE)
+                .then([results, i](SuggestionsList hits)
+                {
+                    std::lock_guard<std::mutex> lock(results->mutex);
+                    results->lists[i] = std::move(hits);
+                    if (--results->remaining == 0)
+                        results->promise.set_value(std::move(results->lists));
+                });
+        }
+
+        return future;
+    }
+
+    void Delete(const std::string& id)
+    {
+        // the server doesn't support deleting, but at least don't offer it again
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& entry: m_cache)
+        {
+            auto& s = entry.second.suggestions;
+            auto removed = std::remove_if(s.begin(), s.end(), [&](const Suggestion& x){ return x.id == id; });
+            if (removed != s.end())
+            {
+                s.erase(removed, s.end());
+                ScheduleCacheSave();
+            }
+        }
+        m_revision++;
+    }
+
+    unsigned GetRevision() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_revision;
+    }
+
+private:
+    struct Waiter
+    {
+        std::shared_ptr<dispatch::promise<SuggestionsList>> promise;
+        clock_type::time_point deadline;
+    };
+
+    struct Pending
+    {
+        SuggestionQuery query;
+        std::vector<Waiter> waiters;
+        bool sent = false;
+    };
+
+    struct CacheEntry
+    {
+        time_t time;
+        SuggestionsList suggestions;
+    };
+
+    typedef std::vector<std::pair<std::shared_ptr<dispatch::promise<SuggestionsList>>, SuggestionsList>> Fulfillments;
+
+    void Worker()
+    {
+        LoadCache();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping)
+        {
+            const auto now = clock_type::now();
+            auto wakeup = now + CACHE_SAVE_DELAY;
+
+            Fulfillments expired;
+            for (auto i = m_pending.begin(); i != m_pending.end(); )
+            {
+                auto& waiters = i->second->waiters;
+                for (auto w = waiters.begin(); w != waiters.end(); )
+                {
+                    if (w->deadline <= now)
+                    {
+                        expired.emplace_back(w->promise, SuggestionsList());
+                        w = waiters.erase(w);
+                    }
+                    else
+                    {
+                        wakeup = std::min(wakeup, w->deadline);
+                        ++w;
+                    }
+                }
+                // keep sent queries around, their results will still be cached
+                if (waiters.empty() && !i->second->sent)
+                    i = m_pending.erase(i);
+                else
+                    ++i;
+            }
+
+            m_unsent.erase(std::remove_if(m_unsent.begin(), m_unsent.end(),
+                                          [this](uint64_t key){ return m_pending.find(key) == m_pending.end(); }),
+                           m_unsent.end());
+
+            if (!m_unsent.empty() && m_client)
+            {
+                if (now >= m_firstUnsent + COALESCING_DELAY)
+                    SendUnsent();
+                else
+                    wakeup = std::min(wakeup, m_firstUnsent + COALESCING_DELAY);
+            }
+
+            if (m_cacheDirty && now >= m_cacheSaveTime)
+            {
+                lock.unlock();
+                SaveCache();
+                lock.lock();
+            }
+
+            if (!expired.empty())
+            {
+                lock.unlock();
+                Fulfill(expired);
+                lock.lock();
+                continue;
+            }
+
+            m_cv.wait_until(lock, wakeup);
+        }
+    }
+
+    // must be called with m_mutex locked
+    void SendUnsent()
+    {
+        // the server expects one language pair per request:
+        std::map<std::pair<std::string, std::string>, std::vector<uint64_t>> batches;
+        for (auto key: m_unsent)
+        {
+            auto& pending = m_pending[key];
+            pending->sent = true;
+            batches[{pending->query.srclang.LanguageTag(), pending->query.lang.LanguageTag()}].push_back(key);
+        }
+        m_unsent.clear();
+
+        for (auto& b: batches)
+        {
+            auto& keys = b.second;
+            for (size_t start = 0; start < keys.size(); start += MAX_TEXTS_PER_REQUEST)
+            {
+                std::vector<uint64_t> chunk(keys.begin() + start,
+                                            keys.begin() + std::min(keys.size(), start + MAX_TEXTS_PER_REQUEST));
+                SendRequest(b.first.first, b.first.second, chunk);
+            }
+        }
+    }
+
+    // must be called with m_mutex locked
+    void SendRequest(const std::string& srclang, const std::string& lang, const std::vector<uint64_t>& keys)
+    {
+        json texts = json::array();
+        for (auto key: keys)
+            texts.push_back(str::to_utf8(m_pending[key]->query.source));
+
+        wxLogTrace("poedit.remote_tm", "Querying %d texts (%s -> %s)", (int)keys.size(), srclang, lang);
+
+        std::weak_ptr<impl> weakSelf = shared_from_this();
+        m_client->post("suggestions", json_data({{"source_lang", srclang}, {"target_lang", lang}, {"texts", texts}}))
+            .then([weakSelf, keys](dispatch::future<json> response)
+            {
+                auto self = weakSelf.lock();
+                if (!self)
+                    return;
+                try
+                {
+                    self->OnResponse(keys, response.get());
+                }
+                catch (...)
+                {
+                    self->OnFailure(keys, DescribeCurrentException());
+                }
+            });
+    }
+
+    void OnResponse(const std::vector<uint64_t>& keys, const json& response)
+    {
+        auto& results = response.at("results");
+        if (results.size() != keys.size())
+            BOOST_THROW_EXCEPTION(Exception("Unexpected number of results from remote TM"));
+
+        Fulfillments done;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const auto now = time(NULL);
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                SuggestionsList hits;
+                for (auto& r: results[i])
+                {
+                    Suggestion s(str::to_wstring(r.at("text").get<std::string>()),
+                                 std::min(1.0, std::max(0.0, get_value(r, "score", 0.0))),
+                                 0,
+                                 Suggestion::Source::RemoteTM);
+                    s.id = get_value(r, "id", "");
+                    hits.push_back(s);
+                }
+                std::stable_sort(hits.begin(), hits.end());
+
+                auto pending = m_pending.find(keys[i]);
+                if (pending != m_pending.end())
+                {
+                    for (auto& w: pending->second->waiters)
+                        done.emplace_back(w.promise, hits);
+                    m_pending.erase(pending);
+                }
+                m_cache[keys[i]] = CacheEntry{now, std::move(hits)};
+            }
+            ScheduleCacheSave();
+        }
+        Fulfill(done);
+    }
+
+    void OnFailure(const std::vector<uint64_t>& keys, const wxString& error)
+    {
+        wxLogTrace("poedit.remote_tm", "Remote TM query failed, working offline: %s", error);
+
+        Fulfillments done;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_offlineUntil = clock_type::now() + OFFLINE_RETRY_DELAY;
+            for (auto key: keys)
+            {
+                auto pending = m_pending.find(key);
+                if (pending == m_pending.end())
+                    continue;
+                for (auto& w: pending->second->waiters)
+                    done.emplace_back(w.promise, SuggestionsList());
+                m_pending.erase(pending);
+            }
+        }
+        Fulfill(done);
+    }
+
+    static void Fulfill(Fulfillments& items)
+    {
+        for (auto& i: items)
+            i.first->set_value(std::move(i.second));
+        items.clear();
+    }
+
+    // must be called with m_mutex locked
+    void ScheduleCacheSave()
+    {
+        if (!m_cacheDirty)
+        {
+            m_cacheDirty = true;
+            m_cacheSaveTime = clock_type::now() + CACHE_SAVE_DELAY;
+        }
+    }
+
+    void LoadCache()
+    {
+        std::unordered_map<uint64_t, CacheEntry> cache;
+        try
+        {
+            if (!wxFileName::FileExists(m_cacheFile))
+                return;
+
+            std::ifstream f(m_cacheFile.fn_str());
+            auto data = json::parse(f);
+            // results from a different server would be misleading:
+            if (get_value(data, "version", 0) != CACHE_VERSION || get_value(data, "url", "") != m_url)
+                return;
+
+            const auto expired = time(NULL) - CACHE_EXPIRATION;
+            for (auto& e: data.at("entries"))
+            {
+                CacheEntry entry;
+                entry.time = e.at(1).get<time_t>();
+                if (entry.time < expired)
+                    continue;
+                for (auto& s: e.at(2))
+                {
+                    Suggestion hit(str::to_wstring(s.at(0).get<std::string>()), s.at(1).get<double>(), 0, Suggestion::Source::RemoteTM);
+                    hit.id = s.at(2).get<std::string>();
+                    entry.suggestions.push_back(hit);
+                }
+                cache.emplace(e.at(0).get<uint64_t>(), std::move(entry));
+            }
+        }
+        catch (...)
+        {
+            // corrupted cache only means the texts will be queried again
+            wxLogTrace("poedit.remote_tm", "Failed to load cache: %s", DescribeCurrentException());
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // keep results that arrived in the meantime:
+        for (auto& e: cache)
+            m_cache.insert(std::move(e));
+        m_revision++;
+    }
+
+    void SaveCache()
+    {
+        json data;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_cacheDirty)
+                return;
+            m_cacheDirty = false;
+
+            if (m_cache.size() > MAX_CACHE_ENTRIES)
+            {
+                std::vector<time_t> times;
+                times.reserve(m_cache.size());
+                for (auto& e: m_cache)
+                    times.push_back(e.second.time);
+                auto nth = times.begin() + (m_cache.size() - MAX_CACHE_ENTRIES);
+                std::nth_element(times.begin(), nth, times.end());
+                const auto oldest = *nth;
+                for (auto i = m_cache.begin(); i != m_cache.end(); )
+                {
+                    if (i->second.time < oldest)
+                        i = m_cache.erase(i);
+                    else
+                        ++i;
+                }
+            }
+
+            json entries = json::array();
+            for (auto& e: m_cache)
+            {
+                json hits = json::array();
+                for (auto& s: e.second.suggestions)
+                    hits.push_back({str::to_utf8(s.text), s.score, s.id});
+                entries.push_back({e.first, e.second.time, hits});
+            }
+            data = {{"version", CACHE_VERSION}, {"url", m_url}, {"entries", entries}};
+        }
+
+        try
+        {
+            TempOutputFileFor temp(m_cacheFile);
+            {
+                std::ofstream f(temp.FileName().fn_str());
+                f << data.dump();
+            }
+            temp.Commit();
+        }
+        catch (...)
+        {
+            wxLogTrace("poedit.remote_tm", "Failed to save cache: %s", DescribeCurrentException());
+        }
+    }
+
+private:
+    const std::string m_url;
+    const wxString m_cacheFile;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_worker;
+    bool m_stopping = false;
+
+    std::unique_ptr<http_client> m_client;
+    std::unordered_map<uint64_t, std::shared_ptr<Pending>> m_pending;
+    std::vector<uint64_t> m_unsent;
+    clock_type::time_point m_firstUnsent;
+    clock_type::time_point m_offlineUntil;
+
+    std::unordered_map<uint64_t, CacheEntry> m_cache;
+    bool m_cacheDirty = false;
+    clock_type::time_point m_cacheSaveTime;
+    unsigned m_revision = 0;
+};
+
+
+RemoteTM *RemoteTM::ms_instance = nullptr;
+
+RemoteTM& RemoteTM::Get()
+{
+    static std::once_flag initializationFlag;
+    std::call_once(initializationFlag, []{
+        ms_instance = new RemoteTM;
+    });
+    return *ms_instance;
+}
+
+
+void RemoteTM::CleanUp()
+{
+    if (ms_instance)
+    {
+        delete ms_instance;
+        ms_instance = nullptr;
+    }
+}
+
+
+bool RemoteTM::IsEnabled()
+{
+    return !Config::RemoteTMURL().empty();
+}
+
+
+RemoteTM::RemoteTM() : m_impl(std::make_shared<impl>(Config::RemoteTMURL()))
+{
+    m_impl->Start();
+}
+
+
+RemoteTM::~RemoteTM()
+{
+    m_impl->Stop();
+}
+
+
+dispatch::future<SuggestionsList> RemoteTM::SuggestTranslation(const SuggestionQuery&& q)
+{
+    return m_impl->Query(q, INTERACTIVE_DEADLINE);
+}
+
+
+dispatch::future<std::vector<SuggestionsList>> RemoteTM::SuggestTranslations(const std::vector<SuggestionQuery>& queries)
+{
+    return m_impl->QueryBatch(queries);
+}
+
+
+void RemoteTM::Delete(const std::string& id)
+{
+    m_impl->Delete(id);
+}
+
+
+unsigned RemoteTM::GetRevision() const
+{
+    return m_impl->GetRevision();
+}
+
+#endif // HAVE_HTTP_CLIENT
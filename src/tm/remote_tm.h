@@ -0,0 +1,86 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_remote_tm_h
+#define Poedit_remote_tm_h
+
+#ifdef HAVE_HTTP_CLIENT
+
+#include "suggestions.h"
+
+#include <memory>
+
+
+/**
+    Suggestions from a remote translation memory or machine translation server.
+
+    The server is configured with Config::RemoteTMURL() (and optionally an
+    access token stored in the keychain under the "RemoteTM" service) and
+    is expected to implement a simple batch API:
+
+        POST <url>/suggestions
+        {"source_lang": "en", "target_lang": "cs", "texts": ["...", ...]}
+
+    responding with one list of suggestions per text, in the same order:
+
+        {"results": [[{"text": "...", "score": 0.9, "id": "..."}, ...], ...]}
+
+    Queries made in quick succession, e.g. while the user moves through
+    the list or when prefetching, are coalesced into a single request, and
+    identical queries share one request. Each query has a deadline: if the
+    server doesn't answer in time, the query finishes with no suggestions
+    instead of holding up the UI. Results are cached on disk, so that
+    previously seen texts have suggestions when working offline.
+ */
+class RemoteTM : public SuggestionsBackend
+{
+public:
+    /// Return singleton instance of the remote TM.
+    static RemoteTM& Get();
+
+    /// Saves the cache and destroys the singleton; call on app shutdown.
+    static void CleanUp();
+
+    /// Is the remote TM configured for use?
+    static bool IsEnabled();
+
+    dispatch::future<SuggestionsList> SuggestTranslation(const SuggestionQuery&& q) override;
+    dispatch::future<std::vector<SuggestionsList>> SuggestTranslations(const std::vector<SuggestionQuery>& queries) override;
+    void Delete(const std::string& id) override;
+    unsigned GetRevision() const override;
+
+private:
+    RemoteTM();
+    ~RemoteTM();
+
+    class impl;
+    std::shared_ptr<impl> m_impl;
+
+    static RemoteTM *ms_instance;
+};
+
+#endif // HAVE_HTTP_CLIENT
+
+#endif // Poedit_remote_tm_h
@@ -0,0 +1,173 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "similarity.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cwctype>
+#include <unordered_map>
+#include <vector>
+
+
+namespace
+{
+
+// Weight of character-level similarity in TextSimilarity(), the rest is word-level
+const double CHARS_WEIGHT = 0.7;
+
+
+/**
+    Bit-parallel Levenshtein distance of two sequences.
+
+    @a pattern should be the shorter of the two; it is encoded into bit
+    vectors, 64 elements per word, and @a text is then processed one element
+    at a time, updating all the words.
+ */
+template<typename T>
+size_t bit_parallel_distance(const std::vector<T>& pattern, const std::vector<T>& text)
+{
+    const size_t m = pattern.size();
+    if (m == 0)
+        return text.size();
+    if (text.empty())
+        return m;
+
+    const size_t words = (m + 63) / 64;
+
+    // For each distinct element, bitmask of its positions in the pattern:
+    std::unordered_map<T, size_t> rows;
+    std::vector<uint64_t> peq;
+    for (size_t i = 0; i < m; i++)
+    {
+        auto r = rows.emplace(pattern[i], rows.size());
+        if (r.second)
+            peq.resize(peq.size() + words, 0);
+        peq[r.first->second * words + i / 64] |= uint64_t(1) << (i % 64);
+    }
+    const std::vector<uint64_t> noMatch(words, 0);
+
+    std::vector<uint64_t> VP(words, ~uint64_t(0)), VN(words, 0);
+    const uint64_t last = uint64_t(1) << ((m - 1) % 64);
+    size_t dist = m;
+
+    for (auto& c: text)
+    {
+        auto row = rows.find(c);
+        const uint64_t *PM = (row != rows.end()) ? &peq[row->second * words] : noMatch.data();
+
+        uint64_t HPcarry = 1, HNcarry = 0;
+        for (size_t w = 0; w < words; w++)
+        {
+            const uint64_t vp = VP[w];
+            const uint64_t vn = VN[w];
+            const uint64_t X = PM[w] | HNcarry;
+            const uint64_t D0 = (((X & vp) + vp) ^ vp) | X | vn;
+            uint64_t HP = vn | ~(D0 | vp);
+            uint64_t HN = D0 & vp;
+
+            const uint64_t HPcarryIn = HPcarry, HNcarryIn = HNcarry;
+            if (w < words - 1)
+            {
+                HPcarry = HP >> 63;
+                HNcarry = HN >> 63;
+            }
+            else
+            {
+                if (HP & last)
+                    dist++;
+                if (HN & last)
+                    dist--;
+            }
+
+            HP = (HP << 1) | HPcarryIn;
+            HN = (HN << 1) | HNcarryIn;
+            VP[w] = HN | ~(D0 | HP);
+            VN[w] = HP & D0;
+        }
+    }
+
+    return dist;
+}
+
+
+template<typename T>
+size_t sequences_distance(const std::vector<T>& a, const std::vector<T>& b)
+{
+    return a.size() <= b.size() ? bit_parallel_distance(a, b) : bit_parallel_distance(b, a);
+}
+
+
+// Splits text into lowercase words, represented as small integers
+void tokenize(const std::wstring& text, std::unordered_map<std::wstring, uint32_t>& ids, std::vector<uint32_t>& out)
+{
+    std::wstring word;
+    auto flush = [&]
+    {
+        if (word.empty())
+            return;
+        auto r = ids.emplace(word, (uint32_t)ids.size());
+        out.push_back(r.first->second);
+        word.clear();
+    };
+
+    for (auto c: text)
+    {
+        if (std::iswalnum(c))
+            word += (wchar_t)std::towlower(c);
+        else
+            flush();
+    }
+    flush();
+}
+
+} // anonymous namespace
+
+
+size_t EditDistance(const std::wstring& a, const std::wstring& b)
+{
+    return sequences_distance(std::vector<wchar_t>(a.begin(), a.end()),
+                              std::vector<wchar_t>(b.begin(), b.end()));
+}
+
+
+double TextSimilarity(const std::wstring& a, const std::wstring& b)
+{
+    if (a == b)
+        return 1.0;
+
+    const double charsSim = 1.0 - double(EditDistance(a, b)) / std::max(a.size(), b.size());
+
+    std::unordered_map<std::wstring, uint32_t> ids;
+    std::vector<uint32_t> wordsA, wordsB;
+    tokenize(a, ids, wordsA);
+    tokenize(b, ids, wordsB);
+
+    double wordsSim = charsSim;
+    if (!wordsA.empty() || !wordsB.empty())
+        wordsSim = 1.0 - double(sequences_distance(wordsA, wordsB)) / std::max(wordsA.size(), wordsB.size());
+
+    return CHARS_WEIGHT * charsSim + (1.0 - CHARS_WEIGHT) * wordsSim;
+}
@@ -0,0 +1,51 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_similarity_h
+#define Poedit_similarity_h
+
+#include <string>
+
+
+/**
+    Computes Levenshtein edit distance of two strings.
+
+    Uses Myers' bit-parallel algorithm (in Hyyrö's multi-word formulation),
+    which processes 64 characters of the shorter string at once, so it is
+    fast even for long strings.
+ */
+size_t EditDistance(const std::wstring& a, const std::wstring& b);
+
+/**
+    Returns similarity of two texts, in the range [0, 1].
+
+    1 means the texts are identical, anything else is strictly less than 1.
+    The value combines character-level and word-level edit distances, so
+    that both small typo-like changes and reordered or changed words are
+    accounted for.
+ */
+double TextSimilarity(const std::wstring& a, const std::wstring& b);
+
+#endif // Poedit_similarity_h
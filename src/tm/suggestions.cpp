@@ -25,29 +25,267 @@
 
 #include "suggestions.h"
 
+#include "cache_registry.h"
 #include "concurrency.h"
+#include "remote_tm.h"
 #include "transmem.h"
 
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+
+namespace
+{
+
+// Number of recent queries remembered by each SuggestionsProvider
+const size_t SUGGESTIONS_CACHE_SIZE = 200;
+
+/**
+    Bounded LRU cache of recent queries' results.
+
+    Navigating back and forth in the list repeats the same queries over and
+    over; the cache lets them be answered without asking the backend again.
+    Entries are valid only as long as the backend's revision doesn't change.
+
+    Accessed from both the main thread and worker threads, hence the lock.
+ */
+class SuggestionsCache : public CacheRegistry::Cache
+{
+public:
+    typedef std::tuple<SuggestionsBackend*, std::string, std::string, std::wstring> Key;
+
+    SuggestionsCache() { CacheRegistry::Register(this); }
+    ~SuggestionsCache() { CacheRegistry::Unregister(this); }
+
+    bool Get(const Key& key, unsigned revision, SuggestionsList& hits)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto i = m_index.find(key);
+        if (i == m_index.end())
+            return false;
+        if (i->second->revision != revision)
+        {
+            Erase(i);
+            return false;
+        }
+        // move to front as the most recently used entry:
+        m_entries.splice(m_entries.begin(), m_entries, i->second);
+        i->second->lastUse = CacheRegistry::Now();
+        hits = i->second->hits;
+        return true;
+    }
+
+    void Put(const Key& key, unsigned revision, const SuggestionsList& hits)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto i = m_index.find(key);
+            if (i != m_index.end())
+                Erase(i);
+
+            m_entries.push_front(Entry{key, revision, hits, EstimateSize(key, hits), CacheRegistry::Now()});
+            m_index.emplace(key, m_entries.begin());
+            m_size += m_entries.front().size;
+
+            if (m_entries.size() > SUGGESTIONS_CACHE_SIZE)
+                Erase(m_index.find(m_entries.back().key));
+        }
+        CacheRegistry::NotifyGrown();
+    }
+
+    size_t GetMemoryUsage() const override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_size;
+    }
+
+    CacheRegistry::Timestamp GetOldestUse() const override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.empty() ? CacheRegistry::NoEntries : m_entries.back().lastUse;
+    }
+
+    void EvictUsedUntil(CacheRegistry::Timestamp time) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_entries.empty() && m_entries.back().lastUse <= time)
+            Erase(m_index.find(m_entries.back().key));
+    }
+
+private:
+    struct Entry
+    {
+        Key key;
+        unsigned revision;
+        SuggestionsList hits;
+        size_t size;
+        CacheRegistry::Timestamp lastUse;
+    };
+
+    typedef std::map<Key, std::list<Entry>::iterator> Index;
+
+    void Erase(Index::iterator i)
+    {
+        m_size -= i->second->size;
+        m_entries.erase(i->second);
+        m_index.erase(i);
+    }
+
+    static size_t EstimateSize(const Key& key, const SuggestionsList& hits)
+    {
+        // the key is stored twice, in the entry and in the index:
+        size_t size = sizeof(Entry) + sizeof(Index::value_type) + 4 * sizeof(void*);
+        size += 2 * (std::get<1>(key).capacity() + std::get<2>(key).capacity() + std::get<3>(key).capacity() * sizeof(wchar_t));
+        for (auto& h: hits)
+            size += sizeof(Suggestion) + h.text.capacity() * sizeof(wchar_t) + h.id.capacity();
+        return size;
+    }
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries;
+    Index m_index;
+    size_t m_size = 0;
+};
+
+} // anonymous namespace
+
 
 class SuggestionsProviderImpl
 {
 public:
-    SuggestionsProviderImpl() {}
+    SuggestionsProviderImpl() : m_cache(std::make_shared<SuggestionsCache>()) {}
+
+    ~SuggestionsProviderImpl()
+    {
+        for (auto& t: m_prefetchTokens)
+        {
+            if (t.second)
+                t.second->cancel();
+        }
+        CancelWarmUp();
+    }
 
-    dispatch::future<SuggestionsList> SuggestTranslation(SuggestionsBackend& backend, const SuggestionQuery&& q)
+    dispatch::future<SuggestionsList> SuggestTranslation(SuggestionsBackend& backend, const SuggestionQuery&& q,
+                                                         dispatch::cancellation_token_ptr cancellation)
     {
+        // don't bother asking the backend if the language or query is invalid:
+        if (!IsValidQuery(q))
+        {
+            return dispatch::make_ready_future(SuggestionsList());
+        }
+
+        // Note that the revision must be obtained before querying the backend,
+        // so that results of a query racing with a change are not kept:
+        const unsigned revision = backend.GetRevision();
+        auto key = MakeKey(backend, q);
+
+        SuggestionsList hits;
+        if (m_cache->Get(key, revision, hits))
+            return dispatch::make_ready_future(std::move(hits));
+
         auto bck = &backend;
-        return dispatch::async([=]{
-            // don't bother asking the backend if the language or query is invalid:
-            if (!q.srclang.IsValid() || !q.lang.IsValid() || q.srclang == q.lang || q.source.empty())
-            {
+        auto cache = m_cache;
+        return dispatch::async(dispatch::priority::interactive, [=]{
+            // the query may have waited for a free thread for a while:
+            if (cancellation && cancellation->is_cancelled())
                 return dispatch::make_ready_future(SuggestionsList());
-            }
 
             // query the backend:
-            return bck->SuggestTranslation(std::move(q));
+            const auto budget = q.timeBudget;
+            const auto started = std::chrono::steady_clock::now();
+            return bck->SuggestTranslation(std::move(q))
+                   .then([=](SuggestionsList results)
+                   {
+                       // results may be incomplete if the search ran out of time:
+                       if (budget.count() == 0 || std::chrono::steady_clock::now() - started < budget)
+                           cache->Put(key, revision, results);
+                       return results;
+                   });
         });
     }
+
+    void Prefetch(SuggestionsBackend& backend, std::vector<SuggestionQuery>&& queries)
+    {
+        DoPrefetch(m_prefetchTokens[&backend], backend, std::move(queries));
+    }
+
+    void WarmUp(SuggestionsBackend& backend, std::vector<SuggestionQuery>&& queries)
+    {
+        DoPrefetch(m_warmUpTokens[&backend], backend, std::move(queries));
+    }
+
+    void CancelWarmUp()
+    {
+        for (auto& t: m_warmUpTokens)
+        {
+            if (t.second)
+                t.second->cancel();
+        }
+        m_warmUpTokens.clear();
+    }
+
+private:
+    void DoPrefetch(dispatch::cancellation_token_ptr& previous, SuggestionsBackend& backend, std::vector<SuggestionQuery>&& queries)
+    {
+        if (previous)
+            previous->cancel();
+        previous.reset();
+
+        if (queries.empty())
+            return;
+
+        auto token = std::make_shared<dispatch::cancellation_token>();
+        previous = token;
+
+        auto bck = &backend;
+        auto cache = m_cache;
+        // The queries are ran as a single low-priority batch in one task, so that
+        // prefetching doesn't compete with real queries for background threads:
+        dispatch::async(dispatch::priority::bulk, [bck, cache, token, queries = std::move(queries)]
+        {
+            if (token->is_cancelled())
+                return;
+
+            const unsigned revision = bck->GetRevision();
+            std::vector<SuggestionQuery> needed;
+            for (auto& q: queries)
+            {
+                SuggestionsList hits;
+                if (IsValidQuery(q) && !cache->Get(MakeKey(*bck, q), revision, hits))
+                    needed.push_back(q);
+            }
+            if (needed.empty())
+                return;
+
+            try
+            {
+                auto results = bck->SuggestTranslations(needed).get();
+                for (size_t i = 0; i < needed.size() && i < results.size(); i++)
+                    cache->Put(MakeKey(*bck, needed[i]), revision, results[i]);
+            }
+            catch (...)
+            {
+                // errors are reported when the query is done for real
+            }
+        });
+    }
+
+    static bool IsValidQuery(const SuggestionQuery& q)
+    {
+        return q.srclang.IsValid() && q.lang.IsValid() && q.srclang != q.lang && !q.source.empty();
+    }
+
+    static SuggestionsCache::Key MakeKey(SuggestionsBackend& backend, const SuggestionQuery& q)
+    {
+        return SuggestionsCache::Key(&backend, q.srclang.Code(), q.lang.Code(), q.source);
+    }
+
+    std::shared_ptr<SuggestionsCache> m_cache;
+    // prefetching from different backends runs independently:
+    std::map<SuggestionsBackend*, dispatch::cancellation_token_ptr> m_prefetchTokens;
+    std::map<SuggestionsBackend*, dispatch::cancellation_token_ptr> m_warmUpTokens;
 };
 
 
@@ -60,9 +298,43 @@ SuggestionsProvider::~SuggestionsProvider()
 {
 }
 
-dispatch::future<SuggestionsList> SuggestionsProvider::SuggestTranslation(SuggestionsBackend& backend, const SuggestionQuery&& q)
+dispatch::future<SuggestionsList> SuggestionsProvider::SuggestTranslation(SuggestionsBackend& backend, const SuggestionQuery&& q,
+                                                                          dispatch::cancellation_token_ptr cancellation)
+{
+    return m_impl->SuggestTranslation(backend, std::move(q), cancellation);
+}
+
+void SuggestionsProvider::Prefetch(SuggestionsBackend& backend, std::vector<SuggestionQuery>&& queries)
+{
+    m_impl->Prefetch(backend, std::move(queries));
+}
+
+void SuggestionsProvider::WarmUp(SuggestionsBackend& backend, std::vector<SuggestionQuery>&& queries)
+{
+    m_impl->WarmUp(backend, std::move(queries));
+}
+
+void SuggestionsProvider::CancelWarmUp()
+{
+    m_impl->CancelWarmUp();
+}
+
+
+dispatch::future<std::vector<SuggestionsList>> SuggestionsBackend::SuggestTranslations(const std::vector<SuggestionQuery>& queries)
 {
-    return m_impl->SuggestTranslation(backend, std::move(q));
+    auto futures = std::make_shared<std::vector<dispatch::future<SuggestionsList>>>();
+    futures->reserve(queries.size());
+    for (auto& q: queries)
+        futures->push_back(SuggestTranslation(SuggestionQuery(q)));
+
+    return dispatch::async([futures]
+    {
+        std::vector<SuggestionsList> results;
+        results.reserve(futures->size());
+        for (auto& f: *futures)
+            results.push_back(f.get());
+        return results;
+    });
 }
 
 void SuggestionsProvider::Delete(const Suggestion& s)
@@ -75,5 +347,10 @@ void SuggestionsProvider::Delete(const Suggestion& s)
         case Suggestion::Source::LocalTM:
             TranslationMemory::Get().Delete(s.id);
             break;
+        case Suggestion::Source::RemoteTM:
+#ifdef HAVE_HTTP_CLIENT
+            RemoteTM::Get().Delete(s.id);
+#endif
+            break;
     }
 }
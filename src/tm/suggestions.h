@@ -27,6 +27,8 @@
 #define Poedit_suggestions_h
 
 #include <cmath>
+#include <chrono>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <string>
@@ -38,6 +40,9 @@
 class SuggestionsBackend;
 class SuggestionsProviderImpl;
 
+struct Suggestion;
+typedef std::vector<Suggestion> SuggestionsList;
+
 /// A query for suggestions
 struct SuggestionQuery
 {
@@ -47,6 +52,24 @@ struct SuggestionQuery
     Language lang;
     /// Source text.
     std::wstring source;
+
+    /**
+        Time budget of the search, zero if unlimited.
+
+        Backends that support it return the best results found within the
+        time, skipping slower search passes (e.g. fuzzy search) once it's
+        exceeded. Results of such searches aren't cached.
+     */
+    std::chrono::milliseconds timeBudget{0};
+
+    /**
+        Optional callback for progressive results.
+
+        Backends that search in several passes may call it, from any thread,
+        with results of the faster passes before running the slower ones.
+        The final results, returned as usual, include these.
+     */
+    std::function<void(const SuggestionsList&)> onPartialResults;
 };
 
 
@@ -56,7 +79,8 @@ struct Suggestion
     /// Possible types of suggestion sources
     enum class Source
     {
-        LocalTM
+        LocalTM,
+        RemoteTM
     };
 
     /// Ctor
@@ -95,8 +119,6 @@ inline bool operator<(const Suggestion& a, const Suggestion& b)
         return a.score > b.score;
 }
 
-typedef std::vector<Suggestion> SuggestionsList;
-
 /**
     Provides suggestions for translations.
 
@@ -119,13 +141,46 @@ public:
         This function asynchronously calls either @a onSuccess or @a onError
         callback, exactly once, from a worked thread.
 
+        Results of recent queries are cached, so the returned future may be
+        already fulfilled when revisiting the same text.
+
         If no suggestions are found, @a onSuccess is called with an empty
         list as its argument.
 
-        @param backend    Suggestions backend to use, e.g. TranslationMemory::Get().
-        @param q          Source text and its metadata.
+        @param backend      Suggestions backend to use, e.g. TranslationMemory::Get().
+        @param q            Source text and its metadata.
+        @param cancellation If cancelled before the backend is queried, it
+                            isn't queried at all and an empty list is
+                            returned. Use for queries that may become
+                            irrelevant before they run.
      */
-    dispatch::future<SuggestionsList> SuggestTranslation(SuggestionsBackend& backend, const SuggestionQuery&& q);
+    dispatch::future<SuggestionsList> SuggestTranslation(SuggestionsBackend& backend, const SuggestionQuery&& q,
+                                                         dispatch::cancellation_token_ptr cancellation = nullptr);
+
+    /**
+        Speculatively run queries that are likely to be needed soon.
+
+        The queries are run in the background as a single batch (see
+        SuggestionsBackend::SuggestTranslations()) and their results are only
+        put into the cache used by SuggestTranslation(). Calling Prefetch()
+        again for the same backend cancels its previous prefetching, if it
+        didn't start yet.
+     */
+    void Prefetch(SuggestionsBackend& backend, std::vector<SuggestionQuery>&& queries);
+
+    /**
+        Warm up backend's caches (and the OS' ones for its data) with queries
+        likely to be needed after opening a file.
+
+        Works like Prefetch(), but independently of it, so that prefetching
+        for the selected item doesn't cancel the warm-up. Use CancelWarmUp()
+        when the queries become irrelevant, e.g. when the user navigates
+        elsewhere.
+     */
+    void WarmUp(SuggestionsBackend& backend, std::vector<SuggestionQuery>&& queries);
+
+    /// Cancels warming up started by WarmUp(), if it didn't start yet
+    void CancelWarmUp();
 
     /// Mark a suggestion as good. Called when a suggestion is used.
     static void Delete(const Suggestion& s);
@@ -168,8 +223,28 @@ public:
      */
     virtual dispatch::future<SuggestionsList> SuggestTranslation(const SuggestionQuery&& q) = 0;
 
+    /**
+        Query for suggested translations of several texts at once.
+
+        The default implementation simply calls SuggestTranslation() for
+        each query. Backends should override it if they can answer many
+        queries more efficiently together, e.g. in a single network round
+        trip.
+
+        @return Lists of suggestions, one for each query, in the same order.
+     */
+    virtual dispatch::future<std::vector<SuggestionsList>> SuggestTranslations(const std::vector<SuggestionQuery>& queries);
+
     /// Delete suggestion with given ID from the database
     virtual void Delete(const std::string& id) = 0;
+
+    /**
+        Returns a number that changes whenever the backend's data change.
+
+        SuggestionsProvider uses it to tell when its cached results of
+        previous queries can no longer be used.
+     */
+    virtual unsigned GetRevision() const = 0;
 };
 
 #endif // Poedit_suggestions_h
@@ -0,0 +1,381 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "tm_service.h"
+
+#ifdef HAVE_TM_SERVICE
+
+#include "errors.h"
+#include "json.h"
+#include "str_helpers.h"
+#include "tracing.h"
+#include "transmem.h"
+
+#include <wx/log.h>
+#include <wx/thread.h>
+
+#include <algorithm>
+
+
+namespace
+{
+
+// item name used for exchanging requests and responses
+const char *IPC_ITEM = "request";
+
+// maximum number of strings searched for in one request; requests are
+// handled on the main thread of the hosting instance, so they must be quick:
+const size_t SEARCH_BATCH_SIZE = 100;
+// maximum number of entries stored in one request:
+const size_t UPDATE_BATCH_SIZE = 1000;
+
+
+json suggestions_to_json(const SuggestionsList& list)
+{
+    json out = json::array();
+    for (auto& s: list)
+        out.push_back({{"text", s.text}, {"score", s.score}, {"local_score", s.localScore}, {"id", s.id}});
+    return out;
+}
+
+SuggestionsList suggestions_from_json(const json& data)
+{
+    SuggestionsList list;
+    list.reserve(data.size());
+    for (auto& j: data)
+    {
+        Suggestion s(j.at("text").get<std::wstring>(),
+                     j.at("score").get<double>(),
+                     j.at("local_score").get<int>());
+        s.id = get_value(j, "id", std::string());
+        list.push_back(std::move(s));
+    }
+    return list;
+}
+
+json handle_search(const json& request)
+{
+    auto& tm = TranslationMemory::Get();
+
+    auto srclang = Language::TryParse(request.at("srclang").get<std::string>());
+    std::vector<Language> langs;
+    for (auto& l: request.at("langs"))
+        langs.push_back(Language::TryParse(l.get<std::string>()));
+    auto sources = request.at("sources").get<std::vector<std::wstring>>();
+
+    std::vector<std::vector<SuggestionsList>> results;
+    if (!request.at("exact_only").get<bool>())
+    {
+        // full search, same as SuggestTranslation() does for every string:
+        std::vector<SuggestionQuery> queries;
+        queries.reserve(langs.size() * sources.size());
+        for (auto& lang: langs)
+            for (auto& source: sources)
+                queries.push_back(SuggestionQuery{srclang, lang, source});
+
+        auto hits = tm.SuggestTranslations(queries).get();
+        auto i = hits.begin();
+        for (size_t l = 0; l < langs.size(); l++, i += sources.size())
+            results.emplace_back(std::make_move_iterator(i), std::make_move_iterator(i + sources.size()));
+    }
+    else if (langs.size() == 1)
+    {
+        results.push_back(tm.Search(srclang, langs.front(), sources));
+    }
+    else
+    {
+        results = tm.Search(srclang, langs, sources);
+    }
+
+    json out = json::array();
+    for (auto& forLang: results)
+    {
+        json lists = json::array();
+        for (auto& r: forLang)
+            lists.push_back(suggestions_to_json(r));
+        out.push_back(std::move(lists));
+    }
+    return {{"results", std::move(out)}};
+}
+
+json handle_update(const json& request)
+{
+    auto writer = TranslationMemory::Get().GetWriter();
+    for (auto& e: request.at("entries"))
+    {
+        writer->Insert(Language::TryParse(e.at("srclang").get<std::string>()),
+                       Language::TryParse(e.at("lang").get<std::string>()),
+                       e.at("source").get<std::wstring>(),
+                       e.at("trans").get<std::wstring>(),
+                       (time_t)e.at("created").get<int64_t>());
+    }
+    for (auto& id: request.at("deleted"))
+        writer->Delete(id.get<std::string>());
+    writer->Commit();
+    return json::object();
+}
+
+json handle_request(const json& request)
+{
+    auto op = request.at("op").get<std::string>();
+    wxLogTrace("poedit.tm", "TM service request: %s", op);
+
+    if (op == "search")
+        return handle_search(request);
+    if (op == "update")
+        return handle_update(request);
+    if (op == "revision")
+        return {{"revision", TranslationMemory::Get().GetRevision()}};
+
+    BOOST_THROW_EXCEPTION(Exception(wxString::Format("Unknown TM service request \"%s\".", op)));
+}
+
+json parse_response(const std::string& response)
+{
+    auto data = json::parse(response);
+    auto error = data.find("error");
+    if (error != data.end())
+        BOOST_THROW_EXCEPTION(Exception(str::to_wx(error->get<std::string>())));
+    return data;
+}
+
+
+// The request is sent with Poke() and its response retrieved with Request():
+// unlike data, item names can't be arbitrarily long with DDE.
+class ServerConnection : public wxConnection
+{
+public:
+    bool OnPoke(const wxString& topic, const wxString& item,
+                const void *data, size_t size, wxIPCFormat) override
+    {
+        if (topic != TMService::IPC_TOPIC || item != IPC_ITEM)
+            return false;
+
+        TRACE_SPAN("tm", "ServiceRequest");
+        json response;
+        try
+        {
+            auto text = static_cast<const char*>(data);
+            response = handle_request(json::parse(text, text + size));
+        }
+        catch (...)
+        {
+            response = {{"error", DescribeCurrentException().utf8_string()}};
+        }
+        m_response = response.dump();
+        return true;
+    }
+
+    const void *OnRequest(const wxString& topic, const wxString& item,
+                          size_t *size, wxIPCFormat) override
+    {
+        if (topic != TMService::IPC_TOPIC || item != IPC_ITEM)
+            return nullptr;
+        *size = m_response.size();
+        return m_response.data();
+    }
+
+private:
+    // must remain valid after OnRequest() returns
+    std::string m_response;
+};
+
+} // anonymous namespace
+
+
+namespace TMService
+{
+
+const char *IPC_TOPIC = "tm";
+
+wxConnectionBase *CreateServerConnection()
+{
+    return new ServerConnection;
+}
+
+bool Connect(const wxString& service)
+{
+    auto client = TMServiceClient::Connect(service);
+    if (!client)
+        return false;
+    TranslationMemory::Get().UseService(client);
+    return true;
+}
+
+} // namespace TMService
+
+
+std::shared_ptr<TMServiceClient> TMServiceClient::Connect(const wxString& service)
+{
+    auto client = std::make_shared<TMServiceClient>();
+    client->m_conn.reset(client->m_client.MakeConnection("localhost", service, TMService::IPC_TOPIC));
+    if (!client->m_conn)
+    {
+        wxLogTrace("poedit.tm", "failed to connect to TM service at %s", service);
+        return nullptr;
+    }
+    wxLogTrace("poedit.tm", "using TM service at %s", service);
+    return client;
+}
+
+TMServiceClient::~TMServiceClient()
+{
+    if (m_conn)
+        m_conn->Disconnect();
+}
+
+std::string TMServiceClient::Request(const std::string& request)
+{
+    // DDE conversations are bound to the thread that started them and socket
+    // connections aren't thread-safe, so always communicate from the main
+    // thread; callers are typically worker threads, e.g. in batch mode.
+    if (!wxThread::IsMain())
+        return dispatch::on_main([=]{ return Enqueue(request); }).get();
+    return Enqueue(request).get();
+}
+
+dispatch::future<std::string> TMServiceClient::Enqueue(const std::string& request)
+{
+    // The event loop may run while waiting for a response, dispatching other
+    // requests from worker threads. Exchanges can't be interleaved, so those
+    // are only queued and processed by the outer call when it's done.
+    dispatch::promise<std::string> promise;
+    auto future = promise.get_future();
+    m_queue.emplace_back(request, std::move(promise));
+    if (m_busy)
+        return future;
+
+    m_busy = true;
+    while (!m_queue.empty())
+    {
+        auto r = std::move(m_queue.front());
+        m_queue.pop_front();
+        try
+        {
+            r.second.set_value(DoRequest(r.first));
+        }
+        catch (...)
+        {
+            dispatch::set_current_exception(r.second);
+        }
+    }
+    m_busy = false;
+
+    return future;
+}
+
+std::string TMServiceClient::DoRequest(const std::string& request)
+{
+    TRACE_SPAN("tm", "ServiceClientRequest");
+    size_t size = 0;
+    const void *response = nullptr;
+    if (m_conn->Poke(IPC_ITEM, request.data(), request.size(), wxIPC_PRIVATE))
+        response = m_conn->Request(IPC_ITEM, &size, wxIPC_PRIVATE);
+    if (!response)
+        BOOST_THROW_EXCEPTION(Exception(_("Failed to communicate with Poedit process.")));
+    return std::string(static_cast<const char*>(response), size);
+}
+
+std::vector<std::vector<SuggestionsList>> TMServiceClient::Search(const Language& srclang,
+                                                                  const std::vector<Language>& langs,
+                                                                  const std::vector<std::wstring>& sources,
+                                                                  bool exactOnly)
+{
+    json jlangs = json::array();
+    for (auto& l: langs)
+        jlangs.push_back(l.Code());
+
+    std::vector<std::vector<SuggestionsList>> results(langs.size());
+    for (auto& r: results)
+        r.reserve(sources.size());
+
+    for (size_t start = 0; start < sources.size(); start += SEARCH_BATCH_SIZE)
+    {
+        const size_t end = std::min(sources.size(), start + SEARCH_BATCH_SIZE);
+        json request = {
+            {"op", "search"},
+            {"srclang", srclang.Code()},
+            {"langs", jlangs},
+            {"sources", std::vector<std::wstring>(sources.begin() + start, sources.begin() + end)},
+            {"exact_only", exactOnly}
+        };
+
+        auto response = parse_response(Request(request.dump()));
+        auto& lists = response.at("results");
+        if (lists.size() != langs.size())
+            BOOST_THROW_EXCEPTION(Exception("Invalid TM service response."));
+        for (size_t l = 0; l < langs.size(); l++)
+        {
+            for (auto& r: lists[l])
+                results[l].push_back(suggestions_from_json(r));
+        }
+    }
+
+    for (auto& r: results)
+    {
+        if (r.size() != sources.size())
+            BOOST_THROW_EXCEPTION(Exception("Invalid TM service response."));
+    }
+    return results;
+}
+
+void TMServiceClient::Update(const std::vector<Entry>& entries, const std::vector<std::string>& deleted)
+{
+    // deletions are sent together with the first batch of entries:
+    size_t start = 0;
+    do
+    {
+        const size_t end = std::min(entries.size(), start + UPDATE_BATCH_SIZE);
+        json jentries = json::array();
+        for (size_t i = start; i < end; i++)
+        {
+            auto& e = entries[i];
+            jentries.push_back({
+                {"srclang", e.srclang.Code()},
+                {"lang", e.lang.Code()},
+                {"source", e.source},
+                {"trans", e.trans},
+                {"created", (int64_t)e.creationTime}
+            });
+        }
+
+        json request = {
+            {"op", "update"},
+            {"entries", std::move(jentries)},
+            {"deleted", start == 0 ? deleted : std::vector<std::string>()}
+        };
+        parse_response(Request(request.dump()));
+        start = end;
+    }
+    while (start < entries.size());
+}
+
+unsigned TMServiceClient::GetRevision()
+{
+    auto response = parse_response(Request(json({{"op", "revision"}}).dump()));
+    return response.at("revision").get<unsigned>();
+}
+
+#endif // HAVE_TM_SERVICE
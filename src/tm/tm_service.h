@@ -0,0 +1,128 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_tm_service_h
+#define Poedit_tm_service_h
+
+#include "suggestions.h"
+
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef __WXOSX__
+    #define HAVE_TM_SERVICE
+#endif
+
+#ifdef HAVE_TM_SERVICE
+
+#include <wx/ipc.h>
+
+
+/**
+    Sharing of the translation memory between Poedit processes.
+
+    The TM database can only be written to by one process at a time. The
+    running (GUI) instance of Poedit therefore hosts it for other processes,
+    e.g. batch jobs started while it is open, which use it over the same IPC
+    channel that forwards command line arguments to the running instance
+    instead of opening the database themselves.
+
+    Requests are batched, so that e.g. pre-translating a file takes a few
+    round trips instead of one per string. They are handled on the hosting
+    process' main thread, so their size is limited to keep it responsive.
+
+    Not available on macOS, where only one instance of Poedit runs.
+ */
+namespace TMService
+{
+
+/// IPC topic used for TM requests
+extern const char *IPC_TOPIC;
+
+/// Creates server side connection handling the TM requests
+wxConnectionBase *CreateServerConnection();
+
+/**
+    Connects to the TM hosted by another instance running at @a service
+    and makes TranslationMemory use it instead of the database.
+
+    Must be called on the main thread before the TM is used for the first
+    time. Returns false if the connection couldn't be established.
+ */
+bool Connect(const wxString& service);
+
+} // namespace TMService
+
+
+/// Client side of the TM service, used by TranslationMemory
+class TMServiceClient
+{
+public:
+    /// Entry to store in the TM
+    struct Entry
+    {
+        Language srclang, lang;
+        std::wstring source, trans;
+        time_t creationTime;
+    };
+
+    /// Connects to the service, returns nullptr on failure
+    static std::shared_ptr<TMServiceClient> Connect(const wxString& service);
+
+    TMServiceClient() {}
+    ~TMServiceClient();
+
+    /// Equivalent of TranslationMemory::Search(), results[l][i] is for @a langs[l] and @a sources[i]
+    std::vector<std::vector<SuggestionsList>> Search(const Language& srclang,
+                                                     const std::vector<Language>& langs,
+                                                     const std::vector<std::wstring>& sources,
+                                                     bool exactOnly);
+
+    /// Stores @a entries, deletes @a deleted documents and commits the changes
+    void Update(const std::vector<Entry>& entries, const std::vector<std::string>& deleted);
+
+    /// Revision of the hosted TM
+    unsigned GetRevision();
+
+private:
+    // Sends JSON request and returns the JSON response; throws on error
+    std::string Request(const std::string& request);
+    // Main thread only: queues the request and processes the queue if idle
+    dispatch::future<std::string> Enqueue(const std::string& request);
+    std::string DoRequest(const std::string& request);
+
+    wxClient m_client;
+    std::unique_ptr<wxConnectionBase> m_conn;
+
+    bool m_busy = false;
+    std::deque<std::pair<std::string, dispatch::promise<std::string>>> m_queue;
+};
+
+#endif // HAVE_TM_SERVICE
+
+#endif // Poedit_tm_service_h
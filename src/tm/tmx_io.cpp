@@ -27,15 +27,28 @@
 
 #include <wx/time.h>
 #include <time.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <thread>
+#include <vector>
 #ifdef _WIN32
     #define timegm _mkgmtime
 #endif
 
 #include <wx/translation.h>
 
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+
+#include "concurrency.h"
 #include "errors.h"
 #include "progress.h"
 #include "pugixml.h"
+#include "tracing.h"
 #include "version.h"
 
 using namespace pugi;
@@ -73,10 +86,143 @@ std::wstring extract_seg(xml_node node)
     return pugi::as_wide(text);
 }
 
-} // anonymous namespace
+
+// Default values for <tu> elements, from TMX's <header>
+struct TUDefaults
+{
+    std::string srclang;
+    std::string date;
+
+    void Load(xml_node header)
+    {
+        srclang = header.attribute("srclang").value();
+        if (srclang == "*all*")
+            srclang.clear();
+        date = extract_date(header);
+    }
+};
+
+
+// Translation unit decoded from TMX, ready to be added to the TM
+struct TMXUnit
+{
+    Language srclang, lang;
+    std::wstring source, trans;
+    time_t creationTime;
+};
+
+
+/**
+    Decodes <tu> elements into TMXUnit values.
+
+    Language codes and dates are typically repeated over and over in a TMX
+    file, so their parsed values are memoized. Not thread-safe, use one
+    instance per thread.
+ */
+class TUDecoder
+{
+public:
+    explicit TUDecoder(const TUDefaults& defaults) : m_defaults(defaults), m_lastTime(0) {}
+
+    void Decode(xml_node tu, std::vector<TMXUnit>& out)
+    {
+        auto tuDate = extract_date(tu, m_defaults.date);
+        std::string tuSrclang = tu.attribute("srclang").value();
+        if (tuSrclang.empty())
+            tuSrclang = m_defaults.srclang;
+
+        std::wstring source;
+        for (auto tuv: tu.children("tuv"))
+        {
+            if (extract_lang(tuv) == tuSrclang)
+            {
+                source = extract_seg(tuv);
+                break;
+            }
+        }
+        if (source.empty())
+            return;
+
+        for (auto tuv: tu.children("tuv"))
+        {
+            auto tuvLang = extract_lang(tuv);
+            if (tuvLang == tuSrclang)
+                continue;
+
+            auto srclang = GetLanguage(tuSrclang);
+            auto lang = GetLanguage(tuvLang);
+            if (!srclang.IsValid() || !lang.IsValid())
+                continue;
+
+            auto trans = extract_seg(tuv);
+            if (trans.empty())
+                continue;
+
+            auto tuvDate = extract_date(tu, tuDate);
+            out.push_back({srclang, lang, source, trans, ParseDate(tuvDate)});
+        }
+    }
+
+private:
+    Language GetLanguage(const std::string& code)
+    {
+        auto i = m_languages.find(code);
+        if (i == m_languages.end())
+            i = m_languages.emplace(code, Language::TryParse(code)).first;
+        return i->second;
+    }
+
+    time_t ParseDate(const std::string& date)
+    {
+        if (date.empty())
+            return 0;
+        if (date == m_lastDate)
+            return m_lastTime;
+
+        time_t creationTime = 0;
+        struct tm t {};
+        std::istringstream s(date.c_str());
+        s >> std::get_time(&t, "%Y%m%dT%H%M%SZ"); // YYYYMMDDThhmmssZ
+        if (!s.fail())
+            creationTime = timegm(&t);
+
+        m_lastDate = date;
+        m_lastTime = creationTime;
+        return creationTime;
+    }
+
+    const TUDefaults& m_defaults;
+    std::map<std::string, Language> m_languages;
+    std::string m_lastDate;
+    time_t m_lastTime;
+};
+
+
+// Parses a batch of <tu> elements produced by TMXStreamReader
+std::vector<TMXUnit> DecodeBatch(const std::string& xml, xml_encoding encoding, const TUDefaults& defaults)
+{
+    xml_document doc;
+    auto result = doc.load_buffer(xml.data(), xml.size(), parse_default, encoding);
+    if (!result)
+        BOOST_THROW_EXCEPTION(std::runtime_error(result.description()));
+
+    std::vector<TMXUnit> units;
+    TUDecoder decoder(defaults);
+    for (auto tu: doc.child("body").children("tu"))
+        decoder.Decode(tu, units);
+    return units;
+}
+
+
+void InsertUnits(const std::vector<TMXUnit>& units, TranslationMemory::IOInterface& writer)
+{
+    for (auto& u: units)
+        writer.Insert(u.srclang, u.lang, u.source, u.trans, u.creationTime);
+}
 
 
-int TMX::ImportFromFile(std::istream& file, TranslationMemory& tm)
+// Imports TMX file by loading it into memory as a whole
+int ImportFromDOM(std::istream& file, TranslationMemory& tm, std::string *importBatch)
 {
     xml_document doc;
     auto result = doc.load(file);
@@ -87,96 +233,444 @@ int TMX::ImportFromFile(std::istream& file, TranslationMemory& tm)
     if (!root)
         BOOST_THROW_EXCEPTION(Exception(_("The TMX file is malformed.")));
 
-    std::string defaultSrclang;
-    std::string defaultDate;
+    TUDefaults defaults;
     auto header = root.child("header");
     if (header)
-    {
-        defaultSrclang = header.attribute("srclang").value();
-        if (defaultSrclang == "*all*")
-            defaultSrclang.clear();
-        defaultDate = extract_date(header);
-    }
+        defaults.Load(header);
 
     int counter = 0;
     auto body = root.child("body");
     if (!body)
         BOOST_THROW_EXCEPTION(Exception(_("The TMX file is malformed.")));
 
-    tm.ImportData([=,&counter,&body](auto& writer)
+    auto batch = tm.ImportData([=,&counter,&body](auto& writer)
     {
         auto tu_children = body.children("tu");
         Progress progress((int)std::distance(tu_children.begin(), tu_children.end()));
 
+        TUDecoder decoder(defaults);
+        std::vector<TMXUnit> units;
         for (auto tu: tu_children)
         {
             progress.increment();
+            units.clear();
+            decoder.Decode(tu, units);
+            InsertUnits(units, writer);
+            counter += (int)units.size();
+        }
+    });
+
+    if (importBatch)
+        *importBatch = batch;
+    return counter;
+}
 
-            auto tuDate = extract_date(tu, defaultDate);
-            std::string tuSrclang = tu.attribute("srclang").value();
-            if (tuSrclang.empty())
-                tuSrclang = defaultSrclang;
 
-            std::wstring source;
-            for (auto tuv: tu.children("tuv"))
+// Granularity of progress reporting when importing
+const int PROGRESS_STEPS = 1000;
+
+// How many <tu> elements to parse at once when importing
+const size_t IMPORT_BATCH_UNITS = 1000;
+
+/**
+    Pull-style reader of TMX files that doesn't load the entire file into memory.
+
+    The input is only scanned for boundaries of <tu> elements, which are then
+    parsed in batches, so memory use is bounded by the batch size, not by the
+    file's size. Only ASCII-compatible encodings (UTF-8, Latin-1) can be scanned
+    this way, check IsSupportedEncoding().
+ */
+class TMXStreamReader
+{
+public:
+    TMXStreamReader(std::istream& file, uint64_t fileSize)
+        : m_file(file), m_fileSize(fileSize), m_encoding(encoding_utf8), m_supported(true),
+          m_pos(0), m_consumed(0), m_eof(false), m_done(false)
+    {
+        DetectEncoding();
+    }
+
+    bool IsSupportedEncoding() const { return m_supported; }
+    xml_encoding Encoding() const { return m_encoding; }
+
+    /// Fraction of the file processed so far, if its size is known
+    double Fraction() const
+    {
+        if (!m_fileSize)
+            return 0.0;
+        return std::min(1.0, double(m_consumed + m_pos) / m_fileSize);
+    }
+
+    /// Reads everything up to the start of <body>, extracting defaults from <header>
+    void ReadHeader(TUDefaults& defaults)
+    {
+        size_t root = Find("<tmx", m_pos);
+        if (root == std::string::npos)
+            ThrowMalformed();
+        m_pos = FindTagEnd(root) + 1;
+
+        for (;;)
+        {
+            Compact();
+            size_t pos = Find("<", m_pos);
+            if (pos == std::string::npos)
+                ThrowMalformed();
+
+            if (StartsWith(pos, "<!--"))
             {
-                if (extract_lang(tuv) == tuSrclang)
-                {
-                    source = extract_seg(tuv);
-                    break;
-                }
+                m_pos = SkipPast("-->", pos);
             }
-            if (source.empty())
-                continue;
+            else if (StartsWithTag(pos, "<header"))
+            {
+                size_t end = FindTagEnd(pos);
+                std::string tag = m_buf.substr(pos, end + 1 - pos);
+                const bool empty = m_buf[end - 1] == '/';
+                if (!empty)
+                    tag.insert(tag.size() - 1, "/");
 
-            for (auto tuv: tu.children("tuv"))
+                xml_document doc;
+                if (doc.load_buffer(tag.data(), tag.size(), parse_default, m_encoding))
+                    defaults.Load(doc.child("header"));
+
+                m_pos = empty ? end + 1 : SkipPast("</header>", end);
+            }
+            else if (StartsWithTag(pos, "<body"))
+            {
+                size_t end = FindTagEnd(pos);
+                if (m_buf[end - 1] == '/')
+                    m_done = true; // empty <body/>
+                m_pos = end + 1;
+                return;
+            }
+            else
             {
-                auto tuvLang = extract_lang(tuv);
-                if (tuvLang == tuSrclang)
-                    continue;
+                m_pos = FindTagEnd(pos) + 1;
+            }
+        }
+    }
 
-                auto srclang = Language::TryParse(tuSrclang);
-                auto lang = Language::TryParse(tuvLang);
-                if (!srclang.IsValid() || !lang.IsValid())
-                    continue;
+    /**
+        Reads up to @a maxUnits next <tu> elements into @a xml, wrapped in <body>.
 
-                auto trans = extract_seg(tuv);
-                if (trans.empty())
-                    continue;
+        Returns the number of elements read, 0 at the end of the body.
+     */
+    size_t ReadBatch(std::string& xml, size_t maxUnits)
+    {
+        xml = "<body>";
+        size_t count = 0;
+        while (!m_done && count < maxUnits)
+        {
+            Compact();
+            size_t pos = Find("<", m_pos);
+            if (pos == std::string::npos)
+            {
+                m_done = true; // truncated file, but import what we have
+                break;
+            }
 
-                time_t creationTime = 0;
-                auto tuvDate = extract_date(tu, tuDate);
-                if (!tuvDate.empty())
-                {
-                    struct tm t {};
-                    std::istringstream s(tuvDate.c_str());
-                    s >> std::get_time(&t, "%Y%m%dT%H%M%SZ"); // YYYYMMDDThhmmssZ
-                    if (!s.fail())
-                        creationTime = timegm(&t);
-                }
+            if (StartsWith(pos, "<!--"))
+            {
+                m_pos = SkipPast("-->", pos);
+            }
+            else if (StartsWithTag(pos, "</body"))
+            {
+                m_pos = FindTagEnd(pos) + 1;
+                m_done = true;
+            }
+            else if (StartsWithTag(pos, "<tu"))
+            {
+                size_t end = FindElementEnd(pos, "</tu");
+                xml.append(m_buf, pos, end - pos);
+                m_pos = end;
+                count++;
+            }
+            else
+            {
+                // unexpected markup, descend into it:
+                m_pos = FindTagEnd(pos) + 1;
+            }
+        }
+        xml += "</body>";
+        return count;
+    }
+
+private:
+    static const size_t CHUNK_SIZE = 1024 * 1024;
+
+    [[noreturn]] static void ThrowMalformed()
+    {
+        BOOST_THROW_EXCEPTION(Exception(_("The TMX file is malformed.")));
+    }
+
+    void DetectEncoding()
+    {
+        Fill();
+        if (StartsWith(0, "\xEF\xBB\xBF"))
+        {
+            m_pos = 3; // UTF-8 BOM
+            return;
+        }
+        if (m_buf.size() >= 2 && (m_buf[0] == '\0' || m_buf[1] == '\0' ||
+                                  StartsWith(0, "\xFF\xFE") || StartsWith(0, "\xFE\xFF")))
+        {
+            m_supported = false; // UTF-16 or UTF-32
+            return;
+        }
+
+        if (!StartsWith(0, "<?xml"))
+            return;
+        size_t declEnd = Find("?>", 0);
+        if (declEnd == std::string::npos)
+            return;
+        std::string decl = m_buf.substr(0, declEnd);
+        size_t enc = decl.find("encoding");
+        if (enc == std::string::npos)
+            return;
+        size_t q1 = decl.find_first_of("\"'", enc);
+        if (q1 == std::string::npos)
+            return;
+        size_t q2 = decl.find(decl[q1], q1 + 1);
+        if (q2 == std::string::npos)
+            return;
+
+        std::string name = decl.substr(q1 + 1, q2 - q1 - 1);
+        std::transform(name.begin(), name.end(), name.begin(), [](char c){ return (char)std::tolower((unsigned char)c); });
+        if (name == "utf-8" || name == "utf8" || name == "us-ascii" || name == "ascii")
+            m_encoding = encoding_utf8;
+        else if (name == "iso-8859-1" || name == "latin1" || name == "latin-1")
+            m_encoding = encoding_latin1;
+        else
+            m_supported = false;
+    }
+
+    // Reads next chunk of the file, returns false at EOF
+    bool Fill()
+    {
+        if (m_eof)
+            return false;
+        size_t oldSize = m_buf.size();
+        m_buf.resize(oldSize + CHUNK_SIZE);
+        m_file.read(&m_buf[oldSize], CHUNK_SIZE);
+        size_t got = (size_t)m_file.gcount();
+        m_buf.resize(oldSize + got);
+        if (got == 0)
+            m_eof = true;
+        return got > 0;
+    }
+
+    // Discards already processed data; invalidates positions other than m_pos
+    void Compact()
+    {
+        if (m_pos < CHUNK_SIZE)
+            return;
+        m_buf.erase(0, m_pos);
+        m_consumed += m_pos;
+        m_pos = 0;
+    }
 
-                writer.Insert(srclang, lang, source, trans, creationTime);
-                counter++;
+    bool StartsWith(size_t pos, const char *str)
+    {
+        size_t len = strlen(str);
+        while (m_buf.size() < pos + len)
+        {
+            if (!Fill())
+                return false;
+        }
+        return m_buf.compare(pos, len, str) == 0;
+    }
+
+    // Like StartsWith(), but checks that it is the whole tag name
+    bool StartsWithTag(size_t pos, const char *tag)
+    {
+        if (!StartsWith(pos, tag))
+            return false;
+        size_t after = pos + strlen(tag);
+        if (m_buf.size() <= after && !Fill())
+            return false;
+        char c = m_buf[after];
+        return c == '>' || c == '/' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    size_t Find(const char *str, size_t from)
+    {
+        size_t len = strlen(str);
+        for (;;)
+        {
+            size_t pos = m_buf.find(str, from);
+            if (pos != std::string::npos)
+                return pos;
+            if (m_buf.size() >= len)
+                from = std::max(from, m_buf.size() - len + 1);
+            if (!Fill())
+                return std::string::npos;
+        }
+    }
+
+    // Returns position right after the next occurrence of @a str
+    size_t SkipPast(const char *str, size_t from)
+    {
+        size_t pos = Find(str, from);
+        if (pos == std::string::npos)
+            ThrowMalformed();
+        return pos + strlen(str);
+    }
+
+    // Returns position of '>' that ends the tag starting at @a pos
+    size_t FindTagEnd(size_t pos)
+    {
+        char quote = 0;
+        for (size_t i = pos + 1;; i++)
+        {
+            if (i >= m_buf.size() && !Fill())
+                ThrowMalformed();
+            char c = m_buf[i];
+            if (quote)
+            {
+                if (c == quote)
+                    quote = 0;
+            }
+            else if (c == '"' || c == '\'')
+            {
+                quote = c;
+            }
+            else if (c == '>')
+            {
+                return i;
             }
         }
+    }
+
+    // Returns position after the end of element starting at @a pos
+    size_t FindElementEnd(size_t pos, const char *closingTag)
+    {
+        size_t tagEnd = FindTagEnd(pos);
+        if (m_buf[tagEnd - 1] == '/')
+            return tagEnd + 1;
+
+        size_t cur = tagEnd + 1;
+        for (;;)
+        {
+            size_t p = Find("<", cur);
+            if (p == std::string::npos)
+                ThrowMalformed();
+
+            if (StartsWith(p, "<!--"))
+                cur = SkipPast("-->", p);
+            else if (StartsWith(p, "<![CDATA["))
+                cur = SkipPast("]]>", p);
+            else if (StartsWithTag(p, closingTag))
+                return FindTagEnd(p) + 1;
+            else
+                cur = p + 1;
+        }
+    }
+
+    std::istream& m_file;
+    uint64_t m_fileSize;
+    xml_encoding m_encoding;
+    bool m_supported;
+
+    std::string m_buf;
+    size_t m_pos;
+    uint64_t m_consumed;
+    bool m_eof, m_done;
+};
+
+} // anonymous namespace
+
+
+int TMX::ImportFromFile(std::istream& file, TranslationMemory& tm, std::string *importBatch)
+{
+    TRACE_SPAN("tm", "ImportTMX");
+
+    // Get the file's size for reporting progress, if possible:
+    file.seekg(0, std::ios::end);
+    auto size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (!file)
+    {
+        file.clear();
+        size = -1;
+    }
+
+    TMXStreamReader reader(file, size > 0 ? (uint64_t)size : 0);
+    if (!reader.IsSupportedEncoding())
+    {
+        // This is uncommon, most TMX files are in UTF-8; a 16bit encoding
+        // can't be scanned for tags bytewise, so parse it as a whole:
+        file.clear();
+        file.seekg(0, std::ios::beg);
+        return ImportFromDOM(file, tm, importBatch);
+    }
+
+    TUDefaults defaults;
+    reader.ReadHeader(defaults);
+
+    // The import is pipelined: this thread reads batches of <tu> elements
+    // from the file, they are parsed and decoded in parallel on background
+    // threads and then, in their original order, written into the TM on this
+    // thread again. The number of batches in flight is limited to keep memory
+    // use bounded.
+    const size_t maxInFlight = 2 * std::max(1u, std::thread::hardware_concurrency());
+
+    int counter = 0;
+    auto batch = tm.ImportData([&](auto& writer)
+    {
+        Progress progress(PROGRESS_STEPS);
+
+        std::deque<dispatch::future<std::vector<TMXUnit>>> inFlight;
+        auto write_next = [&]
+        {
+            auto units = inFlight.front().get();
+            inFlight.pop_front();
+            InsertUnits(units, writer);
+            counter += (int)units.size();
+            progress.set(int(reader.Fraction() * PROGRESS_STEPS));
+        };
+
+        for (;;)
+        {
+            std::string batch;
+            if (reader.ReadBatch(batch, IMPORT_BATCH_UNITS) == 0)
+                break;
+
+            inFlight.push_back(dispatch::async([batch = std::move(batch), encoding = reader.Encoding(), defaults]
+            {
+                return DecodeBatch(batch, encoding, defaults);
+            }));
+
+            if (inFlight.size() >= maxInFlight)
+                write_next();
+        }
+
+        while (!inFlight.empty())
+            write_next();
     });
 
+    if (importBatch)
+        *importBatch = batch;
     return counter;
 }
 
 
 
 
-void TMX::ExportToFile(TranslationMemory& tm, std::ostream& file)
+void TMX::ExportToFile(TranslationMemory& tm, std::ostream& file, bool gzipCompressed,
+                       const TranslationMemory::EntriesFilter *filter)
 {
+    // Entries are written out one by one as they are read from the TM, so
+    // that memory use is constant regardless of the TM's size. Each <tu> is
+    // still serialized with pugixml to get correct escaping and formatting
+    // consistent with the rest of the document.
     class Exporter : public TranslationMemory::IOInterface
     {
     public:
-        Exporter()
+        Exporter(std::ostream& out) : m_out(out) {}
+
+        void WriteStart()
         {
-            auto root = m_doc.append_child("tmx");
-            root.append_attribute("version") = "1.4";
-            auto header = root.append_child("header");
+            xml_document doc;
+            auto header = doc.append_child("header");
             header.append_attribute("creationtool") = "Poedit";
             header.append_attribute("creationtoolversion") = POEDIT_VERSION;
             header.append_attribute("datatype") = "PlainText";
@@ -184,7 +678,17 @@ void TMX::ExportToFile(TranslationMemory& tm, std::ostream& file)
             header.append_attribute("adminlang") = "en";
             header.append_attribute("srclang") = "en"; // reasonable default for gettext
             header.append_attribute("o-tmf") = "PoeditTM";
-            m_body = root.append_child("body");
+
+            m_out << "<?xml version=\"1.0\"?>\n"
+                  << "<tmx version=\"1.4\">\n";
+            header.print(m_out, "\t", format_default, encoding_utf8, /*depth=*/1);
+            m_out << "\t<body>\n";
+        }
+
+        void WriteEnd()
+        {
+            m_out << "\t</body>\n"
+                  << "</tmx>\n";
         }
 
         void Insert(const Language& srclang,
@@ -193,7 +697,8 @@ void TMX::ExportToFile(TranslationMemory& tm, std::ostream& file)
                     const std::wstring& trans,
                     time_t creationTime) override
         {
-            auto tu = m_body.append_child("tu");
+            xml_document doc;
+            auto tu = doc.append_child("tu");
             auto srctag = srclang.LanguageTag();
             if (srctag != "en")
                 tu.append_attribute("srclang") = srctag.c_str();
@@ -217,19 +722,35 @@ void TMX::ExportToFile(TranslationMemory& tm, std::ostream& file)
                 tuv.append_attribute("xml:lang") = lang.LanguageTag().c_str();
                 tuv.append_child("seg").text() = pugi::as_utf8(trans).c_str();
             }
-        }
 
-        void Save(std::ostream& f)
-        {
-            m_doc.save(f);
+            tu.print(m_out, "\t", format_default, encoding_utf8, /*depth=*/2);
         }
 
     private:
-        xml_document m_doc;
-        xml_node m_body;
+        std::ostream& m_out;
     };
 
-    Exporter e;
-    tm.ExportData(e);
-    e.Save(file);
+    auto do_export = [&tm, filter](std::ostream& out)
+    {
+        Exporter e(out);
+        e.WriteStart();
+        if (filter)
+            tm.ExportEntries(*filter, e);
+        else
+            tm.ExportData(e);
+        e.WriteEnd();
+    };
+
+    if (gzipCompressed)
+    {
+        boost::iostreams::filtering_ostream out;
+        out.push(boost::iostreams::gzip_compressor());
+        out.push(file);
+        do_export(out);
+        out.reset(); // flushes the compressor and writes gzip trailer
+    }
+    else
+    {
+        do_export(file);
+    }
 }
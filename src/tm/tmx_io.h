@@ -35,9 +35,23 @@
 namespace TMX
 {
 
-int ImportFromFile(std::istream& file, TranslationMemory& tm);
+/**
+    Imports TMX @a file into the TM, returns the number of imported entries.
 
-void ExportToFile(TranslationMemory& tm, std::ostream& file);
+    If @a importBatch is not null, it is set to the ID of the import, see
+    TranslationMemory::ImportData().
+ */
+int ImportFromFile(std::istream& file, TranslationMemory& tm, std::string *importBatch = nullptr);
+
+/**
+    Exports entire content of the TM into @a file, or only entries matching
+    @a filter if it isn't null.
+
+    The output is streamed as the TM is read, so memory use doesn't depend
+    on the TM's size. If @a gzipCompressed is true, it is compressed with gzip.
+ */
+void ExportToFile(TranslationMemory& tm, std::ostream& file, bool gzipCompressed = false,
+                  const TranslationMemory::EntriesFilter *filter = nullptr);
 
 } // namespace TMX
 
@@ -25,41 +25,66 @@
 
 #include "transmem.h"
 
+#include "analyzers.h"
 #include "catalog.h"
+#include "concurrency.h"
+#include "configuration.h"
 #include "errors.h"
 #include "progress.h"
+#include "similarity.h"
+#include "tm_service.h"
 #include "str_helpers.h"
+#include "tracing.h"
 #include "utility.h"
 
-#include <wx/stdpaths.h>
 #include <wx/utils.h>
 #include <wx/dir.h>
 #include <wx/filename.h>
+#include <wx/log.h>
 #include <wx/translation.h>
 
 #include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <map>
 #include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <boost/algorithm/string/find.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/uuid/name_generator.hpp>
+#include <boost/uuid/random_generator.hpp>
 #include <boost/uuid/string_generator.hpp>
+#include <boost/functional/hash.hpp>
 
 #include <Lucene.h>
 #include <LuceneException.h>
 #include <MMapDirectory.h>
+#include <ConcurrentMergeScheduler.h>
 #include <SerialMergeScheduler.h>
 #include <SimpleFSDirectory.h>
-#include <StandardAnalyzer.h>
 #include <IndexWriter.h>
 #include <IndexSearcher.h>
 #include <IndexReader.h>
 #include <Document.h>
 #include <Field.h>
 #include <DateField.h>
+#include <FieldCache.h>
 #include <PrefixQuery.h>
+#include <RAMDirectory.h>
+#include <ReaderUtil.h>
 #include <StringUtils.h>
+#include <TermDocs.h>
+#include <TermEnum.h>
 #include <TermQuery.h>
 #include <BooleanQuery.h>
 #include <PhraseQuery.h>
@@ -97,6 +122,10 @@ namespace
     }
 
 
+// Incremented on every change of the TM's content, see GetRevision()
+static std::atomic<unsigned> gs_revision(0);
+
+
 // Manages IndexReader and Searcher instances in multi-threaded environment.
 // Curiously, Lucene uses shared_ptr-based refcounting *and* explicit one as
 // well, with a crucial part not well protected.
@@ -106,21 +135,45 @@ namespace
 // class, see
 // http://blog.mikemccandless.com/2011/09/lucenes-searchermanager-simplifies.html
 // http://blog.mikemccandless.com/2011/11/near-real-time-readers-with-lucenes.html
-class SearcherManager
+//
+// Searches never wait for the reader to be reopened: they use the most
+// recently published reader and searcher, which are replaced atomically by
+// a background task triggered after changes are committed.
+class SearcherManager : public std::enable_shared_from_this<SearcherManager>
 {
 public:
     SearcherManager(IndexWriterPtr writer)
     {
-        m_reader = writer->getReader();
-        m_searcher = newLucene<IndexSearcher>(m_reader);
+        m_current = std::make_shared<Snapshot>(writer->getReader());
     }
 
-    ~SearcherManager()
+    ~SearcherManager() {}
+
+private:
+    // Published reader and searcher. The Lucene reference to the reader is
+    // released when the last user of the snapshot goes away.
+    struct Snapshot
     {
-        m_searcher.reset();
-        m_reader->decRef();
-    }
+        Snapshot(IndexReaderPtr r) : reader(r), searcher(newLucene<IndexSearcher>(r)) {}
+
+        ~Snapshot()
+        {
+            searcher.reset();
+            try
+            {
+                reader->decRef();
+            }
+            catch (LuceneException&)
+            {
+                // the index may be already closed
+            }
+        }
+
+        IndexReaderPtr   reader;
+        IndexSearcherPtr searcher;
+    };
 
+public:
     // Safe, properly ref-counting (in Lucene way, not just shared_ptr) holder.
     template<typename T>
     class SafeRef
@@ -128,8 +181,7 @@ public:
     public:
         typedef boost::shared_ptr<T> TPtr;
 
-        SafeRef(SafeRef&& other) : m_mng(other.m_mng) { std::swap(m_ptr, other.m_ptr); }
-        ~SafeRef() { if (m_ptr) m_mng.DecRef(m_ptr); }
+        SafeRef(SafeRef&& other) : m_snapshot(std::move(other.m_snapshot)), m_ptr(std::move(other.m_ptr)) {}
 
         TPtr ptr() { return m_ptr; }
         T* operator->() const { return m_ptr.get(); }
@@ -139,58 +191,459 @@ public:
 
     private:
         friend class SearcherManager;
-        explicit SafeRef(SearcherManager& m, TPtr ptr) : m_mng(m), m_ptr(ptr) {}
+        explicit SafeRef(std::shared_ptr<Snapshot> snapshot, TPtr ptr) : m_snapshot(snapshot), m_ptr(ptr) {}
 
-        SearcherManager& m_mng;
+        std::shared_ptr<Snapshot> m_snapshot;
         boost::shared_ptr<T> m_ptr;
     };
 
     SafeRef<IndexReader> Reader()
     {
-        std::lock_guard<std::mutex> guard(m_mutex);
-        ReloadReaderIfNeeded();
-        m_reader->incRef();
-        return SafeRef<IndexReader>(*this, m_reader);
+        auto snapshot = std::atomic_load(&m_current);
+        return SafeRef<IndexReader>(snapshot, snapshot->reader);
     }
 
     SafeRef<IndexSearcher> Searcher()
+    {
+        auto snapshot = std::atomic_load(&m_current);
+        return SafeRef<IndexSearcher>(snapshot, snapshot->searcher);
+    }
+
+    /**
+        Like Reader(), but reopens the reader first if the index changed.
+
+        Reader() returns the last published snapshot, which may not include
+        recently committed documents yet. Use this for decisions that must
+        take all of them into account, e.g. deduplication or counting.
+     */
+    SafeRef<IndexReader> CurrentReader()
+    {
+        Refresh();
+        return Reader();
+    }
+
+    /**
+        Reopens the reader in a background thread, if the index changed.
+
+        Searches keep using the current reader until the new one is ready.
+        Requests made while a refresh is pending are coalesced into it.
+     */
+    void RefreshInBackground()
+    {
+        if (m_refreshPending.exchange(true))
+            return;
+
+        std::weak_ptr<SearcherManager> weakSelf = shared_from_this();
+        dispatch::async([weakSelf]
+        {
+            auto self = weakSelf.lock();
+            if (self)
+                self->Refresh();
+        });
+    }
+
+    /// Reopens the reader synchronously, if the index changed.
+    void Refresh()
+    {
+        // Clear the flag first, so that changes committed while reopening
+        // schedule another refresh:
+        m_refreshPending = false;
+
+        std::lock_guard<std::mutex> guard(m_refreshMutex);
+        try
+        {
+            auto current = std::atomic_load(&m_current);
+            if (current->reader->isCurrent())
+                return; // nothing to do
+
+            std::atomic_store(&m_current, std::make_shared<Snapshot>(current->reader->reopen()));
+
+            // cached search results may be outdated now:
+            gs_revision++;
+        }
+        catch (LuceneException&)
+        {
+            // keep using the current reader, e.g. if the writer was closed
+        }
+    }
+
+private:
+    std::shared_ptr<Snapshot> m_current;
+    std::atomic<bool>         m_refreshPending{false};
+    std::mutex                m_refreshMutex;
+};
+
+
+double normal_ram_buffer_size()
+{
+    return (double)std::max(Config::TMRAMBufferSizeMB(), 1L);
+}
+
+
+// A single Lucene index with its writer and realtime searcher.
+class TMIndex
+{
+public:
+    TMIndex(const std::wstring& path, AnalyzerPtr analyzer) : TMIndex(OpenDirectory(path), analyzer) {}
+
+    TMIndex(DirectoryPtr dir, AnalyzerPtr analyzer)
+    {
+        m_writer = newLucene<IndexWriter>(dir, analyzer, IndexWriter::MaxFieldLengthLIMITED);
+
+        // Merge segments in background threads, so that large imports don't
+        // stall on merges in the thread doing the inserts. The serial scheduler
+        // can still be enabled in the config as a fallback.
+        if (Config::TMConcurrentMerges())
+            m_writer->setMergeScheduler(newLucene<ConcurrentMergeScheduler>());
+        else
+            m_writer->setMergeScheduler(newLucene<SerialMergeScheduler>());
+
+        // Bigger RAM buffer means fewer, larger segments are flushed and
+        // consequently less merging is needed:
+        m_writer->setRAMBufferSizeMB(normal_ram_buffer_size());
+        m_writer->setMergeFactor((int32_t)std::max(Config::TMMergeFactor(), 2L));
+
+        // get the associated realtime reader & searcher:
+        m_mng = std::make_shared<SearcherManager>(m_writer);
+    }
+
+    ~TMIndex()
+    {
+        m_mng.reset();
+        m_writer->close();
+    }
+
+    TMIndex(const TMIndex&) = delete;
+    TMIndex& operator=(const TMIndex&) = delete;
+
+    /**
+        Memory mapping avoids read() calls and double buffering of the term
+        dictionary and stored fields, but requires address space for all of
+        the index's files, so it's only used in 64-bit builds.
+     */
+    static DirectoryPtr OpenDirectory(const std::wstring& path)
+    {
+        if (sizeof(void*) >= 8 && Config::TMMemoryMappedIO())
+            return newLucene<MMapDirectory>(path);
+        else
+            return newLucene<SimpleFSDirectory>(path);
+    }
+
+    IndexWriterPtr Writer() const { return m_writer; }
+    SearcherManager& Manager() { return *m_mng; }
+
+    /// Commits pending changes and makes them visible to searches soon.
+    void Commit()
+    {
+        m_writer->commit();
+        m_mng->RefreshInBackground();
+    }
+
+private:
+    IndexWriterPtr m_writer;
+    std::shared_ptr<SearcherManager> m_mng;
+};
+
+typedef std::shared_ptr<TMIndex> TMIndexPtr;
+
+
+/**
+    Small in-memory index of recently entered translations, searched along
+    with the main indexes.
+
+    Making a new entry searchable in the main index requires reopening its
+    reader, which flushes a new tiny segment to disk (and causes merges
+    later) every time. Translations entered by the user are therefore only
+    added to this index at first, which is cheap, and written into the main
+    indexes together from time to time (see TranslationMemoryWriterImpl).
+    It contains entries of all language pairs.
+ */
+class DeltaIndex
+{
+public:
+    DeltaIndex(AnalyzerPtr analyzer) : m_index(newLucene<RAMDirectory>(), analyzer) {}
+
+    DeltaIndex(const DeltaIndex&) = delete;
+    DeltaIndex& operator=(const DeltaIndex&) = delete;
+
+    SearcherManager& Manager() { return m_index.Manager(); }
+
+    /// Quick check to skip searching, may be inexact while being modified
+    bool IsEmpty() const { return m_count == 0; }
+
+    /// Adds document, replacing any existing one with the same UUID; call Publish() afterwards
+    void Add(const std::wstring& uuid, DocumentPtr doc, AnalyzerPtr analyzer)
+    {
+        m_index.Writer()->updateDocument(newLucene<Term>(L"uuid", uuid), doc, analyzer);
+        m_count++;
+    }
+
+    void Delete(const std::wstring& uuid)
+    {
+        m_index.Writer()->deleteDocuments(newLucene<Term>(L"uuid", uuid));
+    }
+
+    /// Makes changes visible to searches immediately, there's no disk I/O involved
+    void Publish() { m_index.Manager().Refresh(); }
+
+    void Clear()
+    {
+        m_index.Writer()->deleteAll();
+        m_count = 0;
+        Publish();
+    }
+
+private:
+    TMIndex m_index;
+    std::atomic<size_t> m_count{0};
+};
+
+typedef std::shared_ptr<DeltaIndex> DeltaIndexPtr;
+
+
+/**
+    Shared table of source texts, used by the compact storage mode.
+
+    The same source text is typically translated into many languages. In
+    the compact mode, TM documents only store the hash of the source text
+    (it is still indexed for searching, of course) and the text itself is
+    stored just once, in this table.
+ */
+class SourceTable
+{
+public:
+    SourceTable(const std::wstring& path, AnalyzerPtr analyzer) : m_index(path, analyzer) {}
+
+    /// Adds the text to the table, unless it's already there.
+    void Add(const std::wstring& hash, const std::wstring& text)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_pending.find(hash) != m_pending.end())
+            return;
+        {
+            auto reader = m_index.Manager().Reader();
+            if (reader->docFreq(newLucene<Term>(L"hash", hash)) > 0)
+                return;
+        }
+
+        auto doc = newLucene<Document>();
+        doc->add(newLucene<Field>(L"hash", hash, Field::STORE_YES, Field::INDEX_NOT_ANALYZED_NO_NORMS));
+        doc->add(newLucene<Field>(L"text", text, Field::STORE_YES, Field::INDEX_NO));
+        m_index.Writer()->addDocument(doc);
+        m_pending.emplace(hash, text);
+    }
+
+    /// Returns the text with given hash or empty string if not found.
+    std::wstring Get(const std::wstring& hash)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto i = m_pending.find(hash);
+            if (i != m_pending.end())
+                return i->second;
+        }
+
+        auto reader = m_index.Manager().Reader();
+        auto termDocs = reader->termDocs(newLucene<Term>(L"hash", hash));
+        if (!termDocs->next())
+            return std::wstring();
+        return reader->document(termDocs->doc())->get(L"text");
+    }
+
+    /**
+        Fills in the "source" field of documents stored in compact mode.
+
+        This must be called on all documents read from the index before
+        accessing their source text.
+     */
+    void Resolve(DocumentPtr doc)
+    {
+        if (doc->getField(L"source"))
+            return;
+        auto hash = doc->get(L"srchash");
+        if (!hash.empty())
+            doc->add(newLucene<Field>(L"source", Get(hash), Field::STORE_YES, Field::INDEX_NO));
+    }
+
+    void Commit()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_index.Writer()->commit();
+        // texts added so far must be readable by the time documents that
+        // refer to them are, so don't wait for a background refresh:
+        m_index.Manager().Refresh();
+        m_pending.clear();
+    }
+
+    void Rollback()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_index.Writer()->rollback();
+        m_pending.clear();
+    }
+
+    void DeleteAll()
     {
         std::lock_guard<std::mutex> guard(m_mutex);
-        ReloadReaderIfNeeded();
-        m_searcher->getIndexReader()->incRef();
-        return SafeRef<IndexSearcher>(*this, m_searcher);
+        m_index.Writer()->deleteAll();
+        m_pending.clear();
     }
 
 private:
-    void ReloadReaderIfNeeded()
+    TMIndex m_index;
+
+    std::mutex m_mutex;
+    // texts added since the last commit, not yet visible in the index:
+    std::map<std::wstring, std::wstring> m_pending;
+};
+
+typedef std::shared_ptr<SourceTable> SourceTablePtr;
+
+
+/**
+    Set of Lucene indexes the TM is stored in.
+
+    By default, everything is kept in a single index. If partitioning is
+    enabled, there is one index per (source language, language) pair, where
+    only the language part of the codes is used (i.e. "pt" and "pt_BR" share
+    the same index). These indexes are opened lazily, so that queries only
+    touch the one relevant index and commits to it don't invalidate cached
+    readers of the other ones.
+ */
+class TMStorage
+{
+public:
+    TMStorage(AnalyzerPtr analyzer,
+              const std::wstring& mainDir, const std::wstring& shardsDir, const std::wstring& sourcesDir,
+              bool partitioned, bool compact)
+        : m_analyzer(analyzer),
+          m_mainDir(mainDir), m_shardsDir(shardsDir), m_sourcesDir(sourcesDir),
+          m_partitioned(partitioned), m_compact(compact)
     {
-        // contract: m_mutex is locked when this function is called
-        if (m_reader->isCurrent())
-            return; // nothing to do
+        if (m_partitioned)
+            wxFileName::Mkdir(m_shardsDir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
+        else
+            m_main = std::make_shared<TMIndex>(m_mainDir, m_analyzer);
 
-        auto newReader = m_reader->reopen();
-        auto newSearcher = newLucene<IndexSearcher>(newReader);
+        // the table is needed for reading documents stored in compact mode
+        // even if it's not used for new ones anymore:
+        if (m_compact || wxDirExists(m_sourcesDir))
+            m_sources = std::make_shared<SourceTable>(m_sourcesDir, m_analyzer);
+    }
+
+    /**
+        Returns index for given language pair.
 
-        m_reader->decRef();
+        If @a create is false, nullptr is returned when the pair's index
+        doesn't exist yet. Never returns nullptr if partitioning isn't used.
+     */
+    TMIndexPtr Get(const Language& srclang, const Language& lang, bool create)
+    {
+        if (!m_partitioned)
+            return m_main;
 
-        m_reader = newReader;
-        m_searcher = newSearcher;
+        const auto key = str::to_wstring(srclang.Lang() + "-" + lang.Lang());
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return DoGet(key, create);
     }
 
-    void DecRef(IndexReaderPtr& r)
+    /// Returns all indexes, opening those not opened yet.
+    std::vector<TMIndexPtr> All()
     {
+        if (!m_partitioned)
+            return {m_main};
+
         std::lock_guard<std::mutex> guard(m_mutex);
-        r->decRef();
+        wxDir dir(m_shardsDir);
+        if (dir.IsOpened())
+        {
+            wxString name;
+            for (bool cont = dir.GetFirst(&name, "", wxDIR_DIRS); cont; cont = dir.GetNext(&name))
+                DoGet(name.ToStdWstring(), /*create=*/false);
+        }
+        return DoGetOpened();
     }
-    void DecRef(IndexSearcherPtr& s)
+
+    /// Returns already opened indexes, i.e. all that may have uncommitted changes.
+    std::vector<TMIndexPtr> Opened()
     {
+        if (!m_partitioned)
+            return {m_main};
+
         std::lock_guard<std::mutex> guard(m_mutex);
-        s->getIndexReader()->decRef();
+        return DoGetOpened();
+    }
+
+    /// Table of source texts; nullptr if compact storage was never used.
+    SourceTablePtr Sources() const { return m_sources; }
+
+    /// Table to store source texts of new documents in; nullptr if not in compact mode.
+    SourceTable *CompactSources() const { return m_compact ? m_sources.get() : nullptr; }
+
+    /// Size of all data on disk, in bytes
+    long GetDiskSize() const
+    {
+        long size = 0;
+        for (auto& path: {m_mainDir, m_shardsDir, m_sourcesDir})
+        {
+            if (wxDirExists(path))
+                size += (long)wxDir::GetTotalSize(path).GetValue();
+        }
+        return size;
+    }
+
+    /**
+        Moves data stored in the other layout (i.e. the single index if
+        partitioning is used and vice versa) into this one.
+
+        This is done after the user changes the setting, so that existing
+        TM content remains available.
+     */
+    void MigrateFromOtherLayout();
+
+    /**
+        Reindexes documents that were indexed with different tokenization
+        than their languages use now (see GetTextAnalysis()), e.g. Chinese
+        or Japanese texts added by older versions.
+     */
+    void MigrateAnalysis();
+
+private:
+    TMIndexPtr DoGet(const std::wstring& key, bool create)
+    {
+        // contract: m_mutex is locked when this function is called
+        auto i = m_shards.find(key);
+        if (i != m_shards.end())
+            return i->second;
+
+        const std::wstring path = m_shardsDir + wxFILE_SEP_PATH + key;
+        if (!create && !wxDirExists(path))
+            return nullptr;
+
+        auto index = std::make_shared<TMIndex>(path, m_analyzer);
+        m_shards.emplace(key, index);
+        return index;
+    }
+
+    std::vector<TMIndexPtr> DoGetOpened() const
+    {
+        // contract: m_mutex is locked when this function is called
+        std::vector<TMIndexPtr> all;
+        all.reserve(m_shards.size());
+        for (auto& i: m_shards)
+            all.push_back(i.second);
+        return all;
     }
 
-    IndexReaderPtr   m_reader;
-    IndexSearcherPtr m_searcher;
-    std::mutex       m_mutex;
+    AnalyzerPtr m_analyzer;
+    std::wstring m_mainDir, m_shardsDir, m_sourcesDir;
+    bool m_partitioned, m_compact;
+
+    TMIndexPtr m_main;
+    SourceTablePtr m_sources;
+
+    std::mutex m_mutex;
+    std::map<std::wstring, TMIndexPtr> m_shards;
 };
 
 
@@ -200,11 +653,63 @@ struct SearchArguments
     QueryPtr query;
     std::wstring exactSourceText;
 
+    // Analyzer of documents in the searched languages
+    AnalyzerPtr analyzer;
+
+    // Slower search passes are skipped after this time:
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    // If set, called with results found so far before running slower passes:
+    std::function<void(const SuggestionsList&)> onPartialResults;
+
+    bool past_deadline() const { return std::chrono::steady_clock::now() >= deadline; }
+
+    // Table to resolve source texts of compact documents in, if any
+    SourceTable *sources = nullptr;
+
+    // If not negative, only documents whose source differs from the searched
+    // text by at most this many tokens are returned (where it's known cheaply):
+    int maxTokensDifference = -1;
+    int sourceTokensCount = 0;
+
+    // Plural form to search translations of, see TranslationMemory::SearchPluralForm();
+    // 0 for ordinary translations
+    unsigned pluralForm = 0;
+
     void set_lang(const Language& srclang_, const Language& lang_)
+    {
+        // The language queries only depend on the languages, so they are built
+        // once and cached. The cache is per-thread, because Lucene++ objects
+        // aren't meant to be used from multiple threads concurrently:
+        struct LangQueries
+        {
+            QueryPtr srclang, lang;
+        };
+        static const size_t MAX_CACHED_LANGUAGES = 32;
+        thread_local std::map<std::pair<std::string, std::string>, LangQueries> s_cache;
+
+        auto key = std::make_pair(srclang_.Code(), lang_.Code());
+        auto cached = s_cache.find(key);
+        if (cached == s_cache.end())
+        {
+            if (s_cache.size() >= MAX_CACHED_LANGUAGES)
+                s_cache.clear();
+            cached = s_cache.emplace(key, LangQueries{build_srclang_query(srclang_), build_lang_query(lang_)}).first;
+        }
+
+        this->srclang = cached->second.srclang;
+        this->lang = cached->second.lang;
+        this->analyzer = GetTMAnalyzer(srclang_, lang_);
+    }
+
+private:
+    static QueryPtr build_srclang_query(const Language& srclang_)
     {
         // TODO: query by srclang too!
-        this->srclang = newLucene<TermQuery>(newLucene<Term>(L"srclang", srclang_.WCode()));
+        return newLucene<TermQuery>(newLucene<Term>(L"srclang", srclang_.WCode()));
+    }
 
+    static QueryPtr build_lang_query(const Language& lang_)
+    {
         const Lucene::String fullLang = lang_.WCode();
         const Lucene::String shortLang = StringUtils::toUnicode(lang_.Lang());
 
@@ -225,8 +730,95 @@ struct SearchArguments
         langQ->add(langPrimary, BooleanClause::SHOULD);
         langQ->add(langSecondary, BooleanClause::SHOULD);
 
-        this->lang = langQ;
+        return langQ;
+    }
+};
+
+
+// Operations whose durations are recorded for GetDetailedStats()
+enum class TimedOp
+{
+    Search,
+    SearchSubstring,
+    Insert,
+    Commit,
+    Max
+};
+
+const char *TIMED_OP_NAMES[] = { "Search", "SearchSubstring", "Insert", "Commit" };
+
+// Keeps durations of the most recent calls of an operation
+class LatencyRecorder
+{
+public:
+    static const size_t WINDOW_SIZE = 1000;
+
+    void Add(double ms)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_samples.size() < WINDOW_SIZE)
+            m_samples.push_back(ms);
+        else
+            m_samples[m_next] = ms;
+        m_next = (m_next + 1) % WINDOW_SIZE;
+    }
+
+    TranslationMemory::LatencyStats Get() const
+    {
+        typedef TranslationMemory::LatencyStats LatencyStats;
+        std::vector<double> samples;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            samples = m_samples;
+        }
+
+        LatencyStats stats;
+        stats.count = samples.size();
+        if (samples.empty())
+            return stats;
+
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&](double p) { return samples[std::min(samples.size() - 1, size_t(p * samples.size()))]; };
+        stats.median = percentile(0.5);
+        stats.p90 = percentile(0.9);
+        stats.p99 = percentile(0.99);
+        stats.max = samples.back();
+
+        for (auto ms: samples)
+        {
+            auto bound = std::lower_bound(std::begin(LatencyStats::HISTOGRAM_BOUNDS), std::end(LatencyStats::HISTOGRAM_BOUNDS), ms);
+            stats.histogram[bound - std::begin(LatencyStats::HISTOGRAM_BOUNDS)]++;
+        }
+
+        return stats;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<double> m_samples;
+    size_t m_next = 0;
+};
+
+LatencyRecorder gs_latency[(int)TimedOp::Max];
+
+// Records the duration of its scope
+class ScopedTiming
+{
+public:
+    explicit ScopedTiming(TimedOp op)
+        : m_op(op), m_start(std::chrono::steady_clock::now()), m_span("tm", TIMED_OP_NAMES[(int)op]) {}
+
+    ~ScopedTiming()
+    {
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - m_start;
+        gs_latency[(int)m_op].Add(ms.count());
+        wxLogTrace("poedit.tm", "%s took %.2f ms", TIMED_OP_NAMES[(int)m_op], ms.count());
     }
+
+private:
+    TimedOp m_op;
+    std::chrono::steady_clock::time_point m_start;
+    tracing::span m_span;
 };
 
 
@@ -239,42 +831,92 @@ struct SearchArguments
 class TranslationMemoryImpl
 {
 public:
-#ifdef __WXMSW__
-    typedef SimpleFSDirectory DirectoryType;
-#else
-    typedef MMapDirectory DirectoryType;
-#endif
-
     TranslationMemoryImpl() { Init(); }
 
-    ~TranslationMemoryImpl()
-    {
-        m_mng.reset();
-        m_writer->close();
-    }
+    ~TranslationMemoryImpl();
 
-    SuggestionsList Search(const Language& srclang, const Language& lang,
-                           const std::wstring& source);
+    SuggestionsList Search(const SuggestionQuery& q);
+    // If exactOnly is true, only exact matches are returned for strings that have any
+    std::vector<SuggestionsList> Search(const Language& srclang, const Language& lang,
+                                        const std::vector<std::wstring>& sources,
+                                        bool exactOnly, unsigned pluralForm = 0);
+    // Like the above with exactOnly=true, for several target languages at once
+    std::vector<std::vector<SuggestionsList>> Search(const Language& srclang,
+                                                     const std::vector<Language>& langs,
+                                                     const std::vector<std::wstring>& sources);
 
     void ExportData(TranslationMemory::IOInterface& destination);
-    void ImportData(std::function<void(TranslationMemory::IOInterface&)> source);
+    std::string ImportData(std::function<void(TranslationMemory::IOInterface&)> source);
+
+    size_t CountEntries(const TranslationMemory::EntriesFilter& filter);
+    size_t ExportEntries(const TranslationMemory::EntriesFilter& filter, TranslationMemory::IOInterface& destination);
+    size_t DeleteEntries(const TranslationMemory::EntriesFilter& filter);
+    size_t RollbackImport(const std::string& importBatch);
 
     void SearchSubstring(TranslationMemory::IOInterface& destination,
                         const Language& srclang, const Language& lang, const std::wstring& sourcePhrase);
 
+    std::vector<TranslationMemory::ConcordanceHit> Concordance(const Language& srclang, const Language& lang,
+                                                               const std::wstring& phrase,
+                                                               TranslationMemory::ConcordanceDirection direction,
+                                                               size_t offset, size_t count,
+                                                               size_t *totalHits);
+
     std::shared_ptr<TranslationMemory::Writer> GetWriter() { return m_writerAPI; }
 
     void GetStats(long& numDocs, long& fileSize);
+    TranslationMemory::DetailedStats GetDetailedStats();
+
+    size_t GetCachesMemoryUsage();
+
+    void Optimize();
+
+    // Loads data needed by searches into memory, so that first searches are fast
+    void WarmUp();
 
     static std::wstring GetDatabaseDir();
+    // Directory with per-language indexes, if partitioning is enabled
+    static std::wstring GetShardsDatabaseDir();
+    // Directory with source texts table used by compact storage
+    static std::wstring GetSourcesDatabaseDir();
 
 private:
     void Init();
 
+    // Rewrites duplicate, invalid and old-format documents, see TranslationMemory::Optimize()
+    void CompactIndex(const TMIndexPtr& index);
+
+    // Source text analyzed for DoSearch(), reusable for searching in several languages
+    struct PreparedSource
+    {
+        std::wstring text;
+        PhraseQueryPtr phrase;
+        BooleanQueryPtr terms;
+        int tokensCount = 0;
+    };
+
+    // Only depends on the analyzer of source texts, i.e. source language
+    PreparedSource PrepareSource(AnalyzerPtr analyzer, const std::wstring& source);
+
+    // Searches using already acquired searcher and language queries in sa
+    SuggestionsList DoSearch(IndexSearcherPtr searcher, SearchArguments& sa, const std::wstring& source)
+    {
+        auto prepared = PrepareSource(sa.analyzer, source);
+        return DoSearch(searcher, sa, prepared);
+    }
+    SuggestionsList DoSearch(IndexSearcherPtr searcher, SearchArguments& sa, PreparedSource& source);
+
+    // Looks up only exact matches, using the exact-match index
+    SuggestionsList DoSearchExact(IndexSearcherPtr searcher, SearchArguments& sa, const std::wstring& source);
+
+    // Adds matches of recently entered translations, not yet in the main indexes, to results
+    void SearchDelta(const Language& srclang, const Language& lang, const std::wstring& source,
+                     bool exactOnly, SuggestionsList& results);
+
 private:
     AnalyzerPtr      m_analyzer;
-    IndexWriterPtr   m_writer;
-    std::shared_ptr<SearcherManager> m_mng;
+    std::shared_ptr<TMStorage> m_storage;
+    DeltaIndexPtr    m_delta;
 
     std::shared_ptr<TranslationMemory::Writer> m_writerAPI;
 };
@@ -282,14 +924,7 @@ private:
 
 std::wstring TranslationMemoryImpl::GetDatabaseDir()
 {
-    wxString data;
-#if defined(__UNIX__) && !defined(__WXOSX__)
-    if ( !wxGetEnv("XDG_DATA_HOME", &data) )
-        data = wxGetHomeDir() + "/.local/share";
-    data += "/poedit";
-#else
-    data = wxStandardPaths::Get().GetUserDataDir();
-#endif
+    wxString data = GetUserDataDir();
 
     // ensure the parent directory exists:
     wxFileName::Mkdir(data, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
@@ -300,6 +935,16 @@ std::wstring TranslationMemoryImpl::GetDatabaseDir()
     return data.ToStdWstring();
 }
 
+std::wstring TranslationMemoryImpl::GetShardsDatabaseDir()
+{
+    return GetDatabaseDir() + L"Shards";
+}
+
+std::wstring TranslationMemoryImpl::GetSourcesDatabaseDir()
+{
+    return GetDatabaseDir() + L"Sources";
+}
+
 
 namespace
 {
@@ -314,10 +959,19 @@ static const int MAX_RESULTS = 10;
 // a few hits regardless.
 static const int LUCENE_QUERY_MAX_DOCS = 500;
 
+// Max. number of candidates that are loaded from the database and rescored
+// by their similarity; more than MAX_RESULTS, because Lucene's ranking that
+// they are preselected by is only approximate.
+static const int RESCORED_CANDIDATES = 3 * MAX_RESULTS;
+
 // Normalized score that must be met for a suggestion to be shown. This is
 // an empirical guess of what constitutes good matches.
 static const double QUALITY_THRESHOLD = 0.6;
 
+// Normalized score of a hit good enough to not bother looking for more
+// matches with less strict queries.
+static const double HIGH_CONFIDENCE_THRESHOLD = 0.9;
+
 // Maximum allowed difference in phrase length, in #terms.
 static const int MAX_ALLOWED_LENGTH_DIFFERENCE = 3;
 
@@ -343,6 +997,18 @@ void AddOrUpdateResult(SuggestionsList& all, Suggestion&& r)
     }
 }
 
+// Key of the exact-match index: stored in the untokenized "srchash" field,
+// it lets exact hits be found with a single term lookup, without having to
+// evaluate phrase queries. Hash collisions are harmless, because the source
+// text is always compared afterwards.
+std::wstring source_hash(const std::wstring& source)
+{
+    static const boost::uuids::uuid s_namespace =
+      boost::uuids::string_generator()("1f0e2bb6-1f6e-4f4c-9c58-5a8f3b0a7d21");
+    boost::uuids::name_generator gen(s_namespace);
+    return boost::uuids::to_wstring(gen(source));
+}
+
 // Return translation (or source) text field.
 //
 // Older versions of Poedit used to store C-like escaped text (e.g. "\n" instead
@@ -370,19 +1036,126 @@ void postprocess_results(SuggestionsList& results)
 }
 
 
+// Returns number of tokens the analyzer splits the text into
+int count_tokens(AnalyzerPtr analyzer, const std::wstring& text)
+{
+    auto stream = analyzer->reusableTokenStream(L"source", newLucene<StringReader>(text));
+    int count = 0;
+    while (stream->incrementToken())
+        count++;
+    return count;
+}
+
+
+/**
+    Per-document integer values of an indexed, untokenized field, obtained
+    from the field cache without loading stored documents.
+
+    The cache is used per segment, so that it doesn't have to be rebuilt
+    for the entire index every time a new segment is added. Documents
+    without the field have value 0.
+ */
+class PerDocumentInts
+{
+public:
+    PerDocumentInts(IndexReaderPtr reader, const Lucene::String& field)
+    {
+        auto subReaders = Collection<IndexReaderPtr>::newInstance();
+        ReaderUtil::gatherSubReaders(subReaders, reader);
+
+        int32_t base = 0;
+        for (auto sub: subReaders)
+        {
+            m_starts.push_back(base);
+            m_values.push_back(FieldCache::DEFAULT()->getInts(sub, field));
+            base += sub->maxDoc();
+        }
+    }
+
+    int32_t get(int32_t doc) const
+    {
+        auto i = std::upper_bound(m_starts.begin(), m_starts.end(), doc);
+        if (i == m_starts.begin())
+            return 0;
+        size_t segment = (i - m_starts.begin()) - 1;
+        return m_values[segment][doc - m_starts[segment]];
+    }
+
+private:
+    std::vector<int32_t> m_starts;
+    std::vector<Collection<int32_t>> m_values;
+};
+
+
+// Estimates similarity of a hit from its (normalized) Lucene score and the
+// length of its source text, before loading the stored document
+double estimate_score(const SearchArguments& sa, double score, size_t length)
+{
+    if (score == 1.0)
+    {
+        if (length == sa.exactSourceText.size())
+            return 1.0; // possibly exact match
+
+        // Check against too small queries having perfect hit in a large stored text.
+        // Do this by penalizing too large difference in lengths of the source strings.
+        double len1 = sa.exactSourceText.size();
+        double len2 = length;
+        score = 0.95 * (1.0 - 0.4 * (std::abs(len1 - len2) / std::max(len1, len2)));
+    }
+    return score;
+}
+
+
+/**
+    Runs the search and calls @a callback with every hit of sufficient quality.
+
+    Lucene's TF-IDF scores are only used to preselect candidates, which are
+    then scored by their actual similarity to the searched text (see
+    TextSimilarity()), so that scores are comparable regardless of the
+    query used to find them.
+
+    Stored documents are expensive to load, so hits are first pre-scored and
+    filtered using only the compact "srclen" and "srctokens" fields, and only
+    the @a maxDocs best candidates are loaded and rescored.
+ */
 template<typename T>
 void PerformSearchWithBlock(IndexSearcherPtr searcher,
                             const SearchArguments& sa,
                             double scoreThreshold,
-                            double scoreScaling,
-                            T callback)
+                            T callback,
+                            size_t maxDocs = std::numeric_limits<size_t>::max())
 {
     auto fullQuery = newLucene<BooleanQuery>();
     fullQuery->add(sa.srclang, BooleanClause::MUST);
     fullQuery->add(sa.lang, BooleanClause::MUST);
     fullQuery->add(sa.query, BooleanClause::MUST);
+    if (sa.pluralForm)
+    {
+        fullQuery->add(newLucene<TermQuery>(newLucene<Term>(L"form", StringUtils::toString((int32_t)sa.pluralForm))),
+                       BooleanClause::MUST);
+    }
+    else
+    {
+        // separately stored plural forms are only meaningful for a specific form:
+        thread_local QueryPtr s_anyPluralForm = newLucene<PrefixQuery>(newLucene<Term>(L"form", L""));
+        fullQuery->add(s_anyPluralForm, BooleanClause::MUST_NOT);
+    }
 
     auto hits = searcher->search(fullQuery, LUCENE_QUERY_MAX_DOCS);
+    if (hits->scoreDocs.empty())
+        return;
+
+    auto reader = searcher->getIndexReader();
+    PerDocumentInts lengths(reader, L"srclen");
+    PerDocumentInts tokens(reader, L"srctokens");
+
+    struct Candidate
+    {
+        int32_t doc;
+        double prescore;   // estimate of the final score
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(hits->scoreDocs.size());
 
     for (int i = 0; i < hits->scoreDocs.size(); i++)
     {
@@ -391,28 +1164,34 @@ void PerformSearchWithBlock(IndexSearcherPtr searcher,
         if (score < scoreThreshold)
             continue;
 
-        auto doc = searcher->doc(scoreDoc->doc);
-        auto src = get_text_field(doc, L"source");
-        if (src == sa.exactSourceText)
+        if (sa.maxTokensDifference >= 0)
         {
-            score = 1.0;
+            auto count = tokens.get(scoreDoc->doc);
+            if (count > 0 && std::abs(count - sa.sourceTokensCount) > sa.maxTokensDifference)
+                continue;
         }
-        else
-        {
-            if (score == 1.0)
-            {
-                score = 0.95; // can't score non-exact thing as 100%:
 
-                // Check against too small queries having perfect hit in a large stored text.
-                // Do this by penalizing too large difference in lengths of the source strings.
-                double len1 = sa.exactSourceText.size();
-                double len2 = src.size();
-                score *= 1.0 - 0.4 * (std::abs(len1 - len2) / std::max(len1, len2));
-            }
+        // Length is unknown (0) for data stored by older versions, assume the best then:
+        size_t length = lengths.get(scoreDoc->doc);
+        double prescore = estimate_score(sa, score, length ? length : sa.exactSourceText.size());
 
-            score *= scoreScaling;
-        }
+        candidates.push_back({scoreDoc->doc, prescore});
+    }
 
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Candidate& a, const Candidate& b){ return a.prescore > b.prescore; });
+    if (candidates.size() > maxDocs)
+        candidates.resize(maxDocs);
+
+    for (auto& c: candidates)
+    {
+        auto doc = searcher->doc(c.doc);
+        if (sa.sources)
+            sa.sources->Resolve(doc);
+        auto src = get_text_field(doc, L"source");
+        auto score = TextSimilarity(src, sa.exactSourceText);
+        if (score < scoreThreshold)
+            continue;
         callback(doc, score);
     }
 }
@@ -420,12 +1199,11 @@ void PerformSearchWithBlock(IndexSearcherPtr searcher,
 void PerformSearch(IndexSearcherPtr searcher,
                    const SearchArguments& sa,
                    SuggestionsList& results,
-                   double scoreThreshold,
-                   double scoreScaling)
+                   double scoreThreshold)
 {
     PerformSearchWithBlock
     (
-        searcher, sa, scoreThreshold, scoreScaling,
+        searcher, sa, scoreThreshold,
         [&results](DocumentPtr doc, double score)
         {
             auto t = get_text_field(doc, L"trans");
@@ -433,7 +1211,8 @@ void PerformSearch(IndexSearcherPtr searcher,
             Suggestion r {t, score, int(ts)};
             r.id = StringUtils::toUTF8(doc->get(L"uuid"));
             AddOrUpdateResult(results, std::move(r));
-        }
+        },
+        RESCORED_CANDIDATES
     );
 
     postprocess_results(results);
@@ -441,211 +1220,1993 @@ void PerformSearch(IndexSearcherPtr searcher,
 
 } // anonymous namespace
 
-SuggestionsList TranslationMemoryImpl::Search(const Language& srclang,
-                                              const Language& lang,
-                                              const std::wstring& source)
+SuggestionsList TranslationMemoryImpl::Search(const SuggestionQuery& q)
 {
+    ScopedTiming timing(TimedOp::Search);
     try
     {
-        SuggestionsList results;
-
-        const Lucene::String sourceField(L"source");
-        auto boolQ = newLucene<BooleanQuery>();
-        auto phraseQ = newLucene<PhraseQuery>();
+        SearchArguments sa;
+        if (q.timeBudget.count() > 0)
+            sa.deadline = std::chrono::steady_clock::now() + q.timeBudget;
+        sa.onPartialResults = q.onPartialResults;
 
-        auto stream = m_analyzer->tokenStream(sourceField, newLucene<StringReader>(source));
-        int sourceTokensCount = 0;
-        int sourceTokenPosition = -1;
-        while (stream->incrementToken())
+        SuggestionsList results;
+        auto index = m_storage->Get(q.srclang, q.lang, /*create=*/false);
+        if (index)
         {
-            sourceTokensCount++;
-            auto word = stream->getAttribute<TermAttribute>()->term();
-            sourceTokenPosition += stream->getAttribute<PositionIncrementAttribute>()->getPositionIncrement();
-            auto term = newLucene<Term>(sourceField, word);
-            boolQ->add(newLucene<TermQuery>(term), BooleanClause::SHOULD);
-            phraseQ->add(term, sourceTokenPosition);
+            sa.set_lang(q.srclang, q.lang);
+            sa.sources = m_storage->Sources().get();
+            auto searcher = index->Manager().Searcher();
+            results = DoSearch(searcher.ptr(), sa, q.source);
         }
+        SearchDelta(q.srclang, q.lang, q.source, /*exactOnly=*/false, results);
+        return results;
+    }
+    catch (LuceneException&)
+    {
+        return SuggestionsList();
+    }
+}
+
+
+std::vector<SuggestionsList> TranslationMemoryImpl::Search(const Language& srclang,
+                                                           const Language& lang,
+                                                           const std::vector<std::wstring>& sources,
+                                                           bool exactOnly,
+                                                           unsigned pluralForm)
+{
+    ScopedTiming timing(TimedOp::Search);
+    std::vector<SuggestionsList> results(sources.size());
+    try
+    {
+        auto index = m_storage->Get(srclang, lang, /*create=*/false);
+        // plural forms aren't entered interactively, so the delta never has them:
+        const bool useDelta = !m_delta->IsEmpty() && !pluralForm;
+        if (!index && !useDelta)
+            return results;
 
+        // Language queries and the searcher are the same for all strings:
         SearchArguments sa;
         sa.set_lang(srclang, lang);
-        sa.exactSourceText = source;
-        sa.query = phraseQ;
-
-        auto searcher = m_mng->Searcher();
+        sa.sources = m_storage->Sources().get();
+        sa.pluralForm = pluralForm;
+        std::optional<SearcherManager::SafeRef<IndexSearcher>> searcher;
+        if (index)
+            searcher.emplace(index->Manager().Searcher());
 
-        // Try exact phrase first:
-        PerformSearch(searcher.ptr(), sa, results, QUALITY_THRESHOLD, /*scoreScaling=*/1.0);
-        if (!results.empty())
-            return results;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            try
+            {
+                // Most hits in mature catalogs are exact ones, so answer them
+                // from the exact-match index and only fall back to fuzzy search
+                // when there is none. Entries stored before the index existed
+                // are still found by the fallback.
+                if (exactOnly)
+                {
+                    if (searcher)
+                        results[i] = DoSearchExact(searcher->ptr(), sa, sources[i]);
+                    if (useDelta)
+                        SearchDelta(srclang, lang, sources[i], /*exactOnly=*/true, results[i]);
+                }
+                if (results[i].empty())
+                {
+                    if (searcher)
+                        results[i] = DoSearch(searcher->ptr(), sa, sources[i]);
+                    if (useDelta)
+                        SearchDelta(srclang, lang, sources[i], /*exactOnly=*/false, results[i]);
+                }
+            }
+            catch (LuceneException&)
+            {
+                // leave results for this string empty
+            }
+        }
+    }
+    catch (LuceneException&)
+    {
+    }
+    return results;
+}
 
-        // Then, if no matches were found, permit being a bit sloppy:
-        phraseQ->setSlop(1);
-        sa.query = phraseQ;
-        PerformSearch(searcher.ptr(), sa, results, QUALITY_THRESHOLD, /*scoreScaling=*/0.9);
 
-        if (!results.empty())
+std::vector<std::vector<SuggestionsList>> TranslationMemoryImpl::Search(const Language& srclang,
+                                                                        const std::vector<Language>& langs,
+                                                                        const std::vector<std::wstring>& sources)
+{
+    ScopedTiming timing(TimedOp::Search);
+    std::vector<std::vector<SuggestionsList>> results(langs.size(), std::vector<SuggestionsList>(sources.size()));
+    try
+    {
+        // Searchers and language queries for all languages that have any data:
+        std::vector<size_t> targets;
+        std::vector<SafeRef<IndexSearcher>> searchers;
+        std::vector<SearchArguments> args;
+        for (size_t l = 0; l < langs.size(); l++)
+        {
+            auto index = m_storage->Get(srclang, langs[l], /*create=*/false);
+            if (!index)
+                continue;
+            targets.push_back(l);
+            searchers.push_back(index->Manager().Searcher());
+            args.emplace_back();
+            args.back().set_lang(srclang, langs[l]);
+            args.back().sources = m_storage->Sources().get();
+        }
+        if (targets.empty())
             return results;
 
-        // As the last resort, try terms search. This will almost certainly
-        // produce low-quality results, but hopefully better than nothing.
-        boolQ->setMinimumNumberShouldMatch(std::max(1, boolQ->getClauses().size() - MAX_ALLOWED_LENGTH_DIFFERENCE));
-        sa.query = boolQ;
-        PerformSearchWithBlock
-        (
-            searcher.ptr(), sa, QUALITY_THRESHOLD, /*scoreScaling=*/0.8,
-            [=,&results](DocumentPtr doc, double score)
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            // analyzing the source text and building queries for it only
+            // needs to be done once, regardless of the number of languages:
+            PreparedSource prepared;
+            bool isPrepared = false;
+
+            for (size_t t = 0; t < targets.size(); t++)
             {
-                auto s = get_text_field(doc, sourceField);
-                auto t = get_text_field(doc, L"trans");
-                auto stream2 = m_analyzer->tokenStream(sourceField, newLucene<StringReader>(s));
-                int tokensCount2 = 0;
-                while (stream2->incrementToken())
-                    tokensCount2++;
-
-                if (std::abs(tokensCount2 - sourceTokensCount) <= MAX_ALLOWED_LENGTH_DIFFERENCE)
+                auto& found = results[targets[t]][i];
+                try
                 {
-                    time_t ts = DateField::stringToTime(doc->get(L"created"));
-                    Suggestion r {t, score, int(ts)};
-                    r.id = StringUtils::toUTF8(doc->get(L"uuid"));
-                    AddOrUpdateResult(results, std::move(r));
+                    found = DoSearchExact(searchers[t].ptr(), args[t], sources[i]);
+                    if (found.empty())
+                    {
+                        if (!isPrepared)
+                        {
+                            prepared = PrepareSource(args[t].analyzer, sources[i]);
+                            isPrepared = true;
+                        }
+                        found = DoSearch(searchers[t].ptr(), args[t], prepared);
+                    }
+                }
+                catch (LuceneException&)
+                {
+                    // leave results for this string empty
                 }
             }
-        );
+        }
+    }
+    catch (LuceneException&)
+    {
+    }
+    return results;
+}
+
+
+SuggestionsList TranslationMemoryImpl::DoSearchExact(IndexSearcherPtr searcher,
+                                                     SearchArguments& sa,
+                                                     const std::wstring& source)
+{
+    SuggestionsList results;
+
+    sa.exactSourceText = source;
+    sa.maxTokensDifference = -1;
+    sa.query = newLucene<TermQuery>(newLucene<Term>(L"srchash", source_hash(source)));
+
+    PerformSearchWithBlock
+    (
+        searcher, sa, /*scoreThreshold=*/0.0,
+        [&results](DocumentPtr doc, double score)
+        {
+            if (score != 1.0)
+                return; // hash collision, not an exact match
+            auto t = get_text_field(doc, L"trans");
+            time_t ts = DateField::stringToTime(doc->get(L"created"));
+            Suggestion r {t, score, int(ts)};
+            r.id = StringUtils::toUTF8(doc->get(L"uuid"));
+            AddOrUpdateResult(results, std::move(r));
+        },
+        RESCORED_CANDIDATES
+    );
+
+    postprocess_results(results);
+    return results;
+}
+
+
+void TranslationMemoryImpl::SearchDelta(const Language& srclang, const Language& lang,
+                                        const std::wstring& source, bool exactOnly,
+                                        SuggestionsList& results)
+{
+    if (m_delta->IsEmpty())
+        return;
+
+    SearchArguments sa;
+    sa.set_lang(srclang, lang);
+    auto searcher = m_delta->Manager().Searcher();
+    auto found = exactOnly ? DoSearchExact(searcher.ptr(), sa, source) : DoSearch(searcher.ptr(), sa, source);
+    if (found.empty())
+        return;
+
+    // entries may be in both indexes while being written to the main one:
+    for (auto& r: found)
+        AddOrUpdateResult(results, std::move(r));
+    postprocess_results(results);
+}
+
+
+TranslationMemoryImpl::PreparedSource TranslationMemoryImpl::PrepareSource(AnalyzerPtr analyzer, const std::wstring& source)
+{
+    PreparedSource prepared;
+    prepared.text = source;
+    prepared.terms = newLucene<BooleanQuery>();
+    prepared.phrase = newLucene<PhraseQuery>();
+
+    const Lucene::String sourceField(L"source");
+    auto stream = analyzer->reusableTokenStream(sourceField, newLucene<StringReader>(source));
+    int sourceTokenPosition = -1;
+    auto termAttr = stream->getAttribute<TermAttribute>();
+    auto positionAttr = stream->getAttribute<PositionIncrementAttribute>();
+    while (stream->incrementToken())
+    {
+        prepared.tokensCount++;
+        auto word = termAttr->term();
+        sourceTokenPosition += positionAttr->getPositionIncrement();
+        auto term = newLucene<Term>(sourceField, word);
+        prepared.terms->add(newLucene<TermQuery>(term), BooleanClause::SHOULD);
+        prepared.phrase->add(term, sourceTokenPosition);
+    }
 
-        postprocess_results(results);
+    return prepared;
+}
+
+
+SuggestionsList TranslationMemoryImpl::DoSearch(IndexSearcherPtr searcher,
+                                                SearchArguments& sa,
+                                                PreparedSource& source)
+{
+    SuggestionsList results;
+
+    const Lucene::String sourceField(L"source");
+    auto boolQ = source.terms;
+    auto phraseQ = source.phrase;
+    const int sourceTokensCount = source.tokensCount;
+
+    // the queries may have been modified by a previous search in another language:
+    phraseQ->setSlop(0);
+
+    sa.exactSourceText = source.text;
+    sa.maxTokensDifference = -1;
+    sa.query = phraseQ;
+
+    // Try exact phrase first:
+    PerformSearch(searcher, sa, results, QUALITY_THRESHOLD);
+    if (!results.empty() && results.front().score >= HIGH_CONFIDENCE_THRESHOLD)
         return results;
+
+    // The remaining passes are slower, so only run them if there's time left
+    // and make what was found so far available in the meantime:
+    if (sa.past_deadline())
+        return results;
+    if (sa.onPartialResults && !results.empty())
+        sa.onPartialResults(results);
+
+    // Then, if no good enough matches were found, permit being a bit sloppy;
+    // scores of the results are comparable, so they can be merged:
+    phraseQ->setSlop(1);
+    sa.query = phraseQ;
+    PerformSearch(searcher, sa, results, QUALITY_THRESHOLD);
+
+    if (!results.empty() || sa.past_deadline())
+        return results;
+
+    // As the last resort, try terms search. This will almost certainly
+    // produce low-quality results, but hopefully better than nothing.
+    boolQ->setMinimumNumberShouldMatch(std::max(1, boolQ->getClauses().size() - MAX_ALLOWED_LENGTH_DIFFERENCE));
+    sa.query = boolQ;
+    sa.maxTokensDifference = MAX_ALLOWED_LENGTH_DIFFERENCE;
+    sa.sourceTokensCount = sourceTokensCount;
+    auto analyzer = sa.analyzer;
+    PerformSearchWithBlock
+    (
+        searcher, sa, QUALITY_THRESHOLD,
+        [=,&results](DocumentPtr doc, double score)
+        {
+            // Documents stored by older versions don't have their tokens
+            // count indexed and weren't filtered by it yet:
+            if (doc->get(L"srctokens").empty())
+            {
+                auto tokensCount2 = count_tokens(analyzer, get_text_field(doc, sourceField));
+                if (std::abs(tokensCount2 - sourceTokensCount) > MAX_ALLOWED_LENGTH_DIFFERENCE)
+                    return;
+            }
+
+            auto t = get_text_field(doc, L"trans");
+            time_t ts = DateField::stringToTime(doc->get(L"created"));
+            Suggestion r {t, score, int(ts)};
+            r.id = StringUtils::toUTF8(doc->get(L"uuid"));
+            AddOrUpdateResult(results, std::move(r));
+        },
+        RESCORED_CANDIDATES
+    );
+
+    postprocess_results(results);
+    return results;
+}
+
+
+namespace
+{
+
+// Builds query for the exact phrase in given (analyzed) field
+PhraseQueryPtr build_phrase_query(AnalyzerPtr analyzer, const Lucene::String& field, const std::wstring& phrase)
+{
+    auto phraseQ = newLucene<PhraseQuery>();
+
+    auto stream = analyzer->reusableTokenStream(field, newLucene<StringReader>(phrase));
+    int tokenPosition = -1;
+    auto termAttr = stream->getAttribute<TermAttribute>();
+    auto positionAttr = stream->getAttribute<PositionIncrementAttribute>();
+    while (stream->incrementToken())
+    {
+        tokenPosition += positionAttr->getPositionIncrement();
+        phraseQ->add(newLucene<Term>(field, termAttr->term()), tokenPosition);
     }
-    catch (LuceneException&)
+
+    return phraseQ;
+}
+
+} // anonymous namespace
+
+
+std::vector<TranslationMemory::ConcordanceHit>
+TranslationMemoryImpl::Concordance(const Language& srclang, const Language& lang,
+                                   const std::wstring& phrase,
+                                   TranslationMemory::ConcordanceDirection direction,
+                                   size_t offset, size_t count,
+                                   size_t *totalHits)
+{
+    ScopedTiming timing(TimedOp::SearchSubstring);
+
+    std::vector<TranslationMemory::ConcordanceHit> results;
+    if (totalHits)
+        *totalHits = 0;
+
+    try
     {
-        return SuggestionsList();
+        auto index = m_storage->Get(srclang, lang, /*create=*/false);
+        if (!index || count == 0)
+            return results;
+
+        const bool inSource = (direction == TranslationMemory::ConcordanceDirection::Source);
+        auto phraseQ = build_phrase_query(GetTMAnalyzer(srclang, lang), inSource ? L"source" : L"transtext", phrase);
+        if (phraseQ->getTerms().empty())
+            return results;
+
+        SearchArguments sa;
+        sa.set_lang(srclang, lang);
+        auto fullQuery = newLucene<BooleanQuery>();
+        fullQuery->add(sa.srclang, BooleanClause::MUST);
+        fullQuery->add(sa.lang, BooleanClause::MUST);
+        fullQuery->add(phraseQ, BooleanClause::MUST);
+
+        auto searcher = index->Manager().Searcher();
+        const size_t maxDocs = std::min(offset + count, (size_t)std::numeric_limits<int32_t>::max());
+        auto hits = searcher->search(fullQuery, (int32_t)maxDocs);
+        if (totalHits)
+            *totalHits = hits->totalHits;
+
+        auto sources = m_storage->Sources();
+        for (size_t i = offset; i < (size_t)hits->scoreDocs.size(); i++)
+        {
+            auto doc = searcher->doc(hits->scoreDocs[(int32_t)i]->doc);
+            if (sources)
+                sources->Resolve(doc);
+
+            TranslationMemory::ConcordanceHit hit;
+            hit.source = get_text_field(doc, L"source");
+            hit.trans = get_text_field(doc, L"trans");
+            hit.creationTime = DateField::stringToTime(doc->get(L"created"));
+
+            // The phrase's words were matched by the index, but they may be
+            // separated by e.g. punctuation in the text, so it's not always
+            // found verbatim:
+            const auto& text = inSource ? hit.source : hit.trans;
+            auto match = boost::algorithm::ifind_first(text, phrase);
+            if (match)
+            {
+                hit.matchPos = match.begin() - text.begin();
+                hit.matchLength = match.size();
+            }
+
+            results.push_back(std::move(hit));
+        }
+    }
+    CATCH_AND_RETHROW_EXCEPTION
+
+    return results;
+}
+
+
+void TranslationMemoryImpl::SearchSubstring(TranslationMemory::IOInterface& destination,
+                                            const Language& srclang, const Language& lang, const std::wstring& sourcePhrase)
+{
+    static const size_t PAGE_SIZE = 500;
+
+    size_t total = 0;
+    for (size_t offset = 0; offset == 0 || offset < total; offset += PAGE_SIZE)
+    {
+        auto hits = Concordance(srclang, lang, sourcePhrase, TranslationMemory::ConcordanceDirection::Source,
+                                offset, PAGE_SIZE, &total);
+        if (hits.empty())
+            break;
+
+        for (auto& hit: hits)
+        {
+            // only verbatim occurrences are wanted here:
+            if (hit.matchPos != std::wstring::npos)
+                destination.Insert(srclang, lang, hit.source, hit.trans, hit.creationTime);
+        }
+    }
+}
+
+
+namespace
+{
+
+// Number of documents read by one worker as a unit of work when exporting
+const int32_t EXPORT_BATCH_SIZE = 1000;
+
+// Returns plural form of separately stored plural translation, 0 for ordinary ones
+unsigned get_plural_form(DocumentPtr doc)
+{
+    const auto form = doc->get(L"form");
+    return form.empty() ? 0 : (unsigned)StringUtils::toInt(form);
+}
+
+struct ExportedEntry
+{
+    int32_t docId;
+    Language srclang, lang;
+    std::wstring source, trans;
+    time_t created;
+    std::wstring uuid;
+    bool legacy; // stored in pre-1.8 format, with escaped texts
+    std::wstring batch; // import batch ID, if any
+    unsigned form;      // plural form, if stored separately
+};
+
+// Reads document @a i of the reader, which must not be deleted
+ExportedEntry read_document(IndexReaderPtr reader, SourceTable *sources, int32_t i)
+{
+    auto doc = reader->document(i);
+    if (sources)
+        sources->Resolve(doc);
+    return
+    {
+        i,
+        Language::TryParse(doc->get(L"srclang")),
+        Language::TryParse(doc->get(L"lang")),
+        get_text_field(doc, L"source"),
+        get_text_field(doc, L"trans"),
+        DateField::stringToTime(doc->get(L"created")),
+        doc->get(L"uuid"),
+        doc->get(L"v").empty(),
+        doc->get(L"batch"),
+        get_plural_form(doc)
+    };
+}
+
+// Reads documents [first,last) of the reader, skipping deleted ones
+std::vector<ExportedEntry> read_documents(IndexReaderPtr reader, SourceTable *sources, int32_t first, int32_t last)
+{
+    std::vector<ExportedEntry> out;
+    out.reserve(last - first);
+    for (int32_t i = first; i < last; i++)
+    {
+        if (reader->isDeleted(i))
+            continue;
+        out.push_back(read_document(reader, sources, i));
+    }
+    return out;
+}
+
+// Reading stored fields is the expensive part of processing many documents,
+// so batches of them are read by @a read(n) in parallel (readers are safe to
+// use from multiple threads), in rounds of a few batches per core so that
+// only the current round is in memory. They are passed to @a func(n, batch)
+// in order, from the calling thread.
+template<typename Read, typename Func>
+void read_batches_in_rounds(size_t batchesCount, Read&& read, Func&& func)
+{
+    const size_t roundSize = 4 * std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t round = 0; round < batchesCount; round += roundSize)
+    {
+        const size_t count = std::min(roundSize, batchesCount - round);
+        std::vector<std::vector<ExportedEntry>> batches(count);
+        std::vector<std::exception_ptr> errors(count);
+
+        dispatch::parallel_for(count, [&](size_t n)
+        {
+            try
+            {
+                batches[n] = read(round + n);
+            }
+            catch (...)
+            {
+                errors[n] = std::current_exception();
+            }
+        }, dispatch::priority::bulk);
+
+        for (auto& e: errors)
+        {
+            if (e)
+                std::rethrow_exception(e);
+        }
+
+        for (size_t n = 0; n < count; n++)
+            func(round + n, batches[n]);
     }
 }
 
+// Passes all documents of the reader to @a func, in batches, see read_batches_in_rounds()
+template<typename Func>
+void for_each_document_batch(IndexReaderPtr reader, SourceTable *sources, Progress& progress, Func&& func)
+{
+    const int32_t numDocs = reader->maxDoc();
+    const size_t batchesCount = (numDocs + EXPORT_BATCH_SIZE - 1) / EXPORT_BATCH_SIZE;
+
+    auto range = [=](size_t n)
+    {
+        const int32_t first = int32_t(n) * EXPORT_BATCH_SIZE;
+        return std::make_pair(first, std::min(numDocs, first + EXPORT_BATCH_SIZE));
+    };
+
+    read_batches_in_rounds(batchesCount,
+        [&](size_t n)
+        {
+            auto r = range(n);
+            return read_documents(reader, sources, r.first, r.second);
+        },
+        [&](size_t n, std::vector<ExportedEntry>& batch)
+        {
+            func(batch);
+            auto r = range(n);
+            progress.increment(r.second - r.first);
+        });
+}
+
+// IOInterface implementations aren't thread-safe, hence the above
+void export_documents(IndexReaderPtr reader, SourceTable *sources,
+                      TranslationMemory::IOInterface& destination, Progress& progress)
+{
+    for_each_document_batch(reader, sources, progress, [&](const std::vector<ExportedEntry>& batch)
+    {
+        for (auto& e: batch)
+        {
+            // can't be represented in the interface (nor in TMX); they are
+            // stored again when the files they came from are learned from
+            if (e.form)
+                continue;
+            destination.Insert(e.srclang, e.lang, e.source, e.trans, e.created);
+        }
+    });
+}
+
+} // anonymous namespace
+
+
+void TranslationMemoryImpl::ExportData(TranslationMemory::IOInterface& destination)
+{
+    try
+    {
+        std::vector<SearcherManager::SafeRef<IndexReader>> readers;
+        int32_t numDocs = 0;
+        for (auto& index: m_storage->All())
+        {
+            readers.push_back(index->Manager().CurrentReader());
+            numDocs += readers.back()->maxDoc();
+        }
+
+        Progress progress(numDocs);
+        for (auto& reader: readers)
+            export_documents(reader.ptr(), m_storage->Sources().get(), destination, progress);
+    }
+    CATCH_AND_RETHROW_EXCEPTION
+}
+
+
+void TranslationMemoryImpl::GetStats(long& numDocs, long& fileSize)
+{
+    try
+    {
+        numDocs = 0;
+        for (auto& index: m_storage->All())
+        {
+            auto reader = index->Manager().CurrentReader();
+            numDocs += reader->numDocs();
+        }
+        fileSize = m_storage->GetDiskSize();
+    }
+    CATCH_AND_RETHROW_EXCEPTION
+}
+
+namespace
+{
+
+void count_language_pairs(IndexReaderPtr reader, std::map<std::string, long>& counts)
+{
+    // Assign source language to documents first, then count them by language.
+    // Terms are used instead of stored fields, so only the index needs to be read.
+    std::vector<int> srclangOf(reader->maxDoc(), -1);
+    std::vector<std::string> srclangs;
+
+    auto terms = reader->terms(newLucene<Term>(L"srclang", L""));
+    do
+    {
+        auto term = terms->term();
+        if (!term || term->field() != L"srclang")
+            break;
+        const int id = (int)srclangs.size();
+        srclangs.push_back(StringUtils::toUTF8(term->text()));
+        auto docs = reader->termDocs(term);
+        while (docs->next())
+            srclangOf[docs->doc()] = id;
+    }
+    while (terms->next());
+    terms->close();
+
+    terms = reader->terms(newLucene<Term>(L"lang", L""));
+    do
+    {
+        auto term = terms->term();
+        if (!term || term->field() != L"lang")
+            break;
+        const std::string lang = StringUtils::toUTF8(term->text());
+        std::map<int, long> perSrclang;
+        auto docs = reader->termDocs(term);
+        while (docs->next())
+        {
+            auto srclang = srclangOf[docs->doc()];
+            if (srclang != -1)
+                perSrclang[srclang]++;
+        }
+        for (auto& i: perSrclang)
+            counts[srclangs[i.first] + " → " + lang] += i.second;
+    }
+    while (terms->next());
+    terms->close();
+}
+
+} // anonymous namespace
+
+TranslationMemory::DetailedStats TranslationMemoryImpl::GetDetailedStats()
+{
+    try
+    {
+        TranslationMemory::DetailedStats stats;
+
+        for (auto& index: m_storage->All())
+        {
+            auto reader = index->Manager().CurrentReader();
+            stats.indexes++;
+            stats.numDocs += reader->numDocs();
+            stats.deletedDocs += reader->maxDoc() - reader->numDocs();
+
+            auto subReaders = Collection<IndexReaderPtr>::newInstance();
+            ReaderUtil::gatherSubReaders(subReaders, reader.ptr());
+            stats.segments += subReaders.size();
+
+            count_language_pairs(reader.ptr(), stats.docsPerLanguagePair);
+        }
+        stats.fileSize = m_storage->GetDiskSize();
+
+        for (int op = 0; op < (int)TimedOp::Max; op++)
+            stats.latency[TIMED_OP_NAMES[op]] = gs_latency[op].Get();
+
+        return stats;
+    }
+    CATCH_AND_RETHROW_EXCEPTION
+}
+
+size_t TranslationMemoryImpl::GetCachesMemoryUsage()
+{
+    try
+    {
+        // PerDocumentInts caches "srclen" and "srctokens" values of every document
+        // (deleted ones included) once the index was searched or warmed up:
+        size_t size = 0;
+        for (auto& index: m_storage->All())
+        {
+            auto reader = index->Manager().Reader();
+            size += size_t(reader->maxDoc()) * 2 * sizeof(int32_t);
+        }
+        return size;
+    }
+    CATCH_AND_RETHROW_EXCEPTION
+}
+
+// ----------------------------------------------------------------
+// TranslationMemoryWriterImpl
+// ----------------------------------------------------------------
+
+namespace
+{
+
+// Size of IndexWriter's RAM buffer used during bulk imports
+const double BULK_IMPORT_RAM_BUFFER_MB = 256.0;
+
+// Limits on the amount and age of recently entered translations kept only in
+// the delta index, before they are written to the main indexes
+const size_t DELTA_MAX_ITEMS = 500;
+const std::chrono::seconds DELTA_MAX_AGE(60);
+
+// Computes unique ID for the translation
+boost::uuids::uuid make_uuid(const Language& srclang, const Language& lang,
+                       const std::wstring& source, const std::wstring& trans,
+                       unsigned pluralForm = 0)
+{
+    static const boost::uuids::uuid s_namespace =
+      boost::uuids::string_generator()("6e3f73c5-333f-4171-9d43-954c372a8a02");
+    boost::uuids::name_generator gen(s_namespace);
+
+    // reuse the buffer, this is called for every inserted item:
+    static thread_local std::wstring itemId;
+    itemId.assign(srclang.WCode());
+    itemId += lang.WCode();
+    itemId += source;
+    itemId += trans;
+    // the same text may be used for several forms:
+    if (pluralForm)
+    {
+        itemId += L'\0';
+        itemId += std::to_wstring(pluralForm);
+    }
+
+    return gen(itemId);
+}
+
+// If compactSources is not null, the source text is stored in it instead of
+// in the document. The document must be indexed with the same analyzer, as
+// returned by GetTMAnalyzer(srclang, lang). importBatch is the ID of the
+// import (see ImportData()) the entry comes from, if any. pluralForm is
+// non-zero for separately stored plural forms, see get_item_entries().
+DocumentPtr make_document(AnalyzerPtr analyzer,
+                          const std::wstring& itemUUID,
+                          const Language& srclang, const Language& lang,
+                          const std::wstring& source, const std::wstring& trans,
+                          time_t creationTime,
+                          SourceTable *compactSources,
+                          const std::wstring& importBatch = std::wstring(),
+                          unsigned pluralForm = 0)
+{
+    auto doc = newLucene<Document>();
+    const auto hash = source_hash(source);
+    if (compactSources)
+        compactSources->Add(hash, source);
+
+    doc->add(newLucene<Field>(L"uuid", itemUUID,
+                              Field::STORE_YES, Field::INDEX_NOT_ANALYZED));
+    doc->add(newLucene<Field>(L"v", L"1",
+                              Field::STORE_YES, Field::INDEX_NO));
+    doc->add(newLucene<Field>(L"created", DateField::timeToString(creationTime),
+                              Field::STORE_YES, Field::INDEX_NO));
+    doc->add(newLucene<Field>(L"srclang", srclang.WCode(),
+                              Field::STORE_YES, Field::INDEX_NOT_ANALYZED));
+    doc->add(newLucene<Field>(L"lang", lang.WCode(),
+                              Field::STORE_YES, Field::INDEX_NOT_ANALYZED));
+    // non-standard tokenization used, to detect outdated documents:
+    const auto analysisId = GetTMAnalysisId(srclang, lang);
+    if (!analysisId.empty())
+    {
+        doc->add(newLucene<Field>(L"analysis", analysisId,
+                                  Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS));
+    }
+    doc->add(newLucene<Field>(L"source", source,
+                              compactSources ? Field::STORE_NO : Field::STORE_YES, Field::INDEX_ANALYZED));
+    doc->add(newLucene<Field>(L"srchash", hash,
+                              compactSources ? Field::STORE_YES : Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS));
+    // compact fields for pre-scoring hits without loading stored source text:
+    doc->add(newLucene<Field>(L"srclen", StringUtils::toString((int32_t)source.size()),
+                              Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS));
+    doc->add(newLucene<Field>(L"srctokens", StringUtils::toString(count_tokens(analyzer, source)),
+                              Field::STORE_YES, Field::INDEX_NOT_ANALYZED_NO_NORMS));
+    doc->add(newLucene<Field>(L"trans", trans,
+                              Field::STORE_YES, Field::INDEX_NOT_ANALYZED));
+    // for concordance searches in translations:
+    doc->add(newLucene<Field>(L"transtext", trans,
+                              Field::STORE_NO, Field::INDEX_ANALYZED));
+    if (!importBatch.empty())
+    {
+        doc->add(newLucene<Field>(L"batch", importBatch,
+                                  Field::STORE_YES, Field::INDEX_NOT_ANALYZED_NO_NORMS));
+    }
+    if (pluralForm)
+    {
+        doc->add(newLucene<Field>(L"form", StringUtils::toString((int32_t)pluralForm),
+                                  Field::STORE_YES, Field::INDEX_NOT_ANALYZED_NO_NORMS));
+    }
+
+    return doc;
+}
+
+} // anonymous namespace
+
+
+void TranslationMemoryImpl::Optimize()
+{
+    try
+    {
+        auto indexes = m_storage->All();
+        Progress progress((int)indexes.size());
+        for (auto& index: indexes)
+        {
+            Progress subtask(1, progress, 1);
+            CompactIndex(index);
+            // wait for all merges to finish, including ones done by a concurrent merge scheduler;
+            // this also expunges deleted documents:
+            index->Writer()->optimize(true);
+            index->Commit();
+        }
+    }
+    CATCH_AND_RETHROW_EXCEPTION
+}
+
+
+void TranslationMemoryImpl::CompactIndex(const TMIndexPtr& index)
+{
+    // Documents are kept in the index and only the ones that need it are
+    // rewritten, so that entries inserted concurrently aren't lost:
+    struct Record
+    {
+        int32_t docId;
+        time_t created;
+        bool normalized; // current format and canonical UUID
+        std::wstring uuid;
+    };
+
+    auto reader = index->Manager().CurrentReader();
+    auto sources = m_storage->Sources().get();
+
+    std::unordered_map<boost::uuids::uuid, std::vector<Record>, boost::hash<boost::uuids::uuid>> groups;
+    std::vector<std::wstring> invalid;
+    {
+        Progress progress(reader->maxDoc());
+        for_each_document_batch(reader.ptr(), sources, progress, [&](std::vector<ExportedEntry>& batch)
+        {
+            for (auto& e: batch)
+            {
+                if (!e.lang.IsValid() || !e.srclang.IsValid() || e.lang == e.srclang)
+                {
+                    invalid.push_back(std::move(e.uuid));
+                    continue;
+                }
+                const auto uuid = make_uuid(e.srclang, e.lang, e.source, e.trans, e.form);
+                const bool normalized = !e.legacy && e.uuid == boost::uuids::to_wstring(uuid);
+                groups[uuid].push_back({e.docId, e.created, normalized, std::move(e.uuid)});
+            }
+        });
+    }
+
+    auto writer = index->Writer();
+    int rewritten = 0, removed = (int)invalid.size();
+
+    for (auto& uuid: invalid)
+        writer->deleteDocuments(newLucene<Term>(L"uuid", uuid));
+
+    for (auto& g: groups)
+    {
+        auto& records = g.second;
+        if (records.size() == 1 && records.front().normalized)
+            continue;
+
+        // duplicates are merged into the most recent one:
+        auto newest = std::max_element(records.begin(), records.end(),
+                                       [](const Record& a, const Record& b){ return a.created < b.created; });
+
+        auto doc = reader->document(newest->docId);
+        if (sources)
+            sources->Resolve(doc);
+
+        const std::wstring canonicalUUID = boost::uuids::to_wstring(g.first);
+        const auto srclang = Language::TryParse(doc->get(L"srclang"));
+        const auto lang = Language::TryParse(doc->get(L"lang"));
+        auto analyzer = GetTMAnalyzer(srclang, lang);
+        auto newDoc = make_document(analyzer, canonicalUUID, srclang, lang,
+                                    get_text_field(doc, L"source"),
+                                    get_text_field(doc, L"trans"),
+                                    newest->created,
+                                    m_storage->CompactSources(),
+                                    doc->get(L"batch"),
+                                    get_plural_form(doc));
+
+        for (auto& r: records)
+        {
+            if (r.uuid != canonicalUUID)
+                writer->deleteDocuments(newLucene<Term>(L"uuid", r.uuid));
+        }
+        // also replaces all documents with the canonical UUID:
+        writer->updateDocument(newLucene<Term>(L"uuid", canonicalUUID), newDoc, analyzer);
+
+        rewritten++;
+        removed += (int)records.size() - 1;
+    }
+
+    if (rewritten || removed)
+    {
+        // source texts first, documents may refer to them:
+        if (sources)
+            sources->Commit();
+        index->Commit();
+        gs_revision++;
+    }
+
+    wxLogTrace("poedit.tm", "compacted index: %d documents rewritten, %d duplicate or invalid removed", rewritten, removed);
+}
+
+
+namespace
+{
+
+// Entry to store in the TM for a catalog item
+struct ItemEntry
+{
+    ItemEntry(const std::wstring& source_, const std::wstring& trans_, unsigned form_ = 0)
+        : source(source_), trans(trans_), form(form_) {}
+
+    std::wstring source, trans;
+    // plural form of the translation of plural source text, if it's stored
+    // separately for each form, i.e. the language doesn't have English-like
+    // plurals; 0 otherwise
+    unsigned form;
+};
+
+// Entries to store in the TM for a catalog item; empty if the item shouldn't be stored
+typedef std::vector<ItemEntry> ItemEntries;
+
+// Works with both CatalogItemPtr and CatalogItemSnapshotPtr
+template<typename ItemPtr>
+ItemEntries get_item_entries(const Language& lang, const ItemPtr& item)
+{
+    ItemEntries entries;
+
+    // ignore translations with errors in them
+    if (item->HasError())
+        return entries;
+
+    // ignore untranslated, pre-translated and non-revised or unfinished translations
+    if (item->IsFuzzy() || item->IsPreTranslated() || !item->IsTranslated())
+        return entries;
+
+    // always store at least the singular translation
+    entries.emplace_back(str::to_wstring(item->GetString()), str::to_wstring(item->GetTranslation()));
+
+    // for plurals, the simpler cases with nplurals <= 2 are stored as ordinary
+    // translations of the plural source text; others can't be, as each form
+    // corresponds to different numbers, so they are stored tagged with the form
+    if (item->HasPlural())
+    {
+        const unsigned nplurals = lang.nplurals();
+        switch (nplurals)
+        {
+            case 1:
+                // e.g. Chinese, Japanese; store translation for both singular and plural
+                entries.emplace_back(str::to_wstring(item->GetPluralString()), str::to_wstring(item->GetTranslation()));
+                break;
+            case 2:
+                // e.g. Germanic or Romanic languages, same 2 forms as English
+                entries.emplace_back(str::to_wstring(item->GetPluralString()), str::to_wstring(item->GetTranslation(1)));
+                break;
+            default:
+            {
+                const auto plural = str::to_wstring(item->GetPluralString());
+                for (unsigned form = 1; form < nplurals; form++)
+                {
+                    auto trans = item->GetTranslation(form);
+                    if (!trans.empty())
+                        entries.emplace_back(plural, str::to_wstring(trans), form);
+                }
+                break;
+            }
+        }
+    }
+
+    return entries;
+}
+
+} // anonymous namespace
+
+class TranslationMemoryWriterImpl : public TranslationMemory::Writer,
+                                    public std::enable_shared_from_this<TranslationMemoryWriterImpl>
+{
+public:
+    TranslationMemoryWriterImpl(std::shared_ptr<TMStorage> storage, DeltaIndexPtr delta)
+        : m_storage(storage), m_delta(delta)
+    {}
+
+    ~TranslationMemoryWriterImpl() {}
+
+    void Commit() override
+    {
+        ScopedTiming timing(TimedOp::Commit);
+        try
+        {
+            ProcessQueue(/*writeAll=*/true);
+            // source texts first, documents may refer to them:
+            if (auto sources = m_storage->Sources())
+                sources->Commit();
+            for (auto& index: m_storage->Opened())
+                index->Commit();
+            gs_revision++;
+        }
+        CATCH_AND_RETHROW_EXCEPTION
+    }
+
+    /// Writes entries only in the delta index into the main indexes, so that they are committed on close
+    void FlushDelta()
+    {
+        try
+        {
+            ProcessQueue(/*writeAll=*/true);
+        }
+        catch (...)
+        {
+            // nothing can be done about it when shutting down
+        }
+    }
+
+    void Rollback() override
+    {
+        try
+        {
+            {
+                std::lock_guard<std::mutex> insertGuard(m_insertMutex);
+                {
+                    std::lock_guard<std::mutex> guard(m_queueMutex);
+                    m_queue.clear();
+                }
+                m_pending.clear();
+                m_delta->Clear();
+            }
+            if (auto sources = m_storage->Sources())
+                sources->Rollback();
+            for (auto& index: m_storage->Opened())
+            {
+                index->Writer()->rollback();
+                index->Manager().RefreshInBackground();
+            }
+            gs_revision++;
+        }
+        CATCH_AND_RETHROW_EXCEPTION
+    }
+
+    void Insert(const Language& srclang, const Language& lang,
+                const std::wstring& source, const std::wstring& trans,
+                time_t creationTime) override
+    {
+        Insert(srclang, lang, ItemEntry(source, trans), creationTime);
+    }
+
+    void Insert(const Language& srclang, const Language& lang,
+                const std::wstring& source, const std::wstring& trans) override
+    {
+        Insert(srclang, lang, source, trans, 0);
+    }
+
+    void Insert(const Language& srclang, const Language& lang, const CatalogItemPtr& item) override
+    {
+        if (!lang.IsValid() || !srclang.IsValid())
+            return;
+
+        for (auto& e: get_item_entries(lang, item))
+            Insert(srclang, lang, e);
+    }
+
+    void Insert(const CatalogPtr& catalog) override
+    {
+        // Work on an immutable copy so that the catalog can keep being
+        // edited while the (potentially slow) insertion runs:
+        auto cat = catalog->TakeSnapshot();
+
+        Progress progress(cat->items().size());
+
+        auto srclang = cat->GetSourceLanguage();
+        auto lang = cat->GetLanguage();
+        if (!lang.IsValid() || !srclang.IsValid() || lang == srclang)
+            return;
+
+        try
+        {
+            // Most of the catalog is typically already in the TM, from when
+            // it was saved the last time; don't rewrite those entries.
+            auto index = m_storage->Get(srclang, lang, /*create=*/true);
+            auto reader = index->Manager().CurrentReader();
+
+            for (auto& item: cat->items())
+            {
+                // Note that dt.IsModified() is intentionally not checked - we
+                // want to save old entries in the TM too, so that we harvest as
+                // much useful translations as we can.
+                for (auto& e: get_item_entries(lang, item))
+                {
+                    if (!IsInIndex(reader.ptr(), srclang, lang, e))
+                        Insert(srclang, lang, e);
+                }
+                progress.increment();
+            }
+        }
+        CATCH_AND_RETHROW_EXCEPTION
+    }
+
+    void InsertLater(const Language& srclang, const Language& lang, const CatalogItemPtr& item) override
+    {
+        if (!lang.IsValid() || !srclang.IsValid() || lang == srclang)
+            return;
+
+        // Capture the content now, the item may be changed by the time it's
+        // processed. Empty entries are queued too, so that an earlier queued
+        // translation of an item that became e.g. fuzzy since isn't stored.
+        QueuedItem queued{srclang, lang, get_item_entries(lang, item), time(NULL)};
+
+        std::lock_guard<std::mutex> guard(m_queueMutex);
+        m_queue[item] = std::move(queued);
+        if (m_queueScheduled)
+            return;
+        m_queueScheduled = true;
+
+        auto self = shared_from_this();
+        dispatch::async([self]
+        {
+            try
+            {
+                self->ProcessQueue(/*writeAll=*/false);
+            }
+            catch (...)
+            {
+                // ignore failures here, they'll become apparent when committing
+            }
+        });
+    }
+
+    void Delete(const std::string& uuid) override
+    {
+        try
+        {
+            const auto wuuid = StringUtils::toUnicode(uuid);
+            {
+                // don't write the entry into the main index later:
+                std::lock_guard<std::mutex> insertGuard(m_insertMutex);
+                for (auto& p: m_pending)
+                {
+                    auto& item = p.second;
+                    item.entries.erase(std::remove_if(item.entries.begin(), item.entries.end(),
+                                                      [&](const ItemEntry& e){ return EntryUUID(item, e) == wuuid; }),
+                                       item.entries.end());
+                }
+                m_delta->Delete(wuuid);
+                m_delta->Publish();
+            }
+
+            // the UUID doesn't tell which language pair it belongs to:
+            auto term = newLucene<Term>(L"uuid", wuuid);
+            for (auto& index: m_storage->All())
+                index->Writer()->deleteDocuments(term);
+            gs_revision++;
+        }
+        CATCH_AND_RETHROW_EXCEPTION
+    }
+
+    void DeleteAll() override
+    {
+        try
+        {
+            {
+                std::lock_guard<std::mutex> insertGuard(m_insertMutex);
+                {
+                    std::lock_guard<std::mutex> guard(m_queueMutex);
+                    m_queue.clear();
+                }
+                m_pending.clear();
+                m_delta->Clear();
+            }
+            for (auto& index: m_storage->All())
+                index->Writer()->deleteAll();
+            if (auto sources = m_storage->Sources())
+                sources->DeleteAll();
+            gs_revision++;
+        }
+        CATCH_AND_RETHROW_EXCEPTION
+    }
+
+private:
+    void Insert(const Language& srclang, const Language& lang, const ItemEntry& e, time_t creationTime = 0)
+    {
+        if (!lang.IsValid() || !srclang.IsValid() || lang == srclang)
+            return;
+
+        ScopedTiming timing(TimedOp::Insert);
+
+        if (creationTime == 0)
+            creationTime = time(NULL);
+
+        const std::wstring itemUUID = boost::uuids::to_wstring(make_uuid(srclang, lang, e.source, e.trans, e.form));
+
+        try
+        {
+            auto writer = m_storage->Get(srclang, lang, /*create=*/true)->Writer();
+            // Then add a new document, replacing any existing one with the same ID:
+            auto analyzer = GetTMAnalyzer(srclang, lang);
+            auto doc = make_document(analyzer, itemUUID, srclang, lang, e.source, e.trans, creationTime,
+                                     m_storage->CompactSources(), std::wstring(), e.form);
+            writer->updateDocument(newLucene<Term>(L"uuid", itemUUID), doc, analyzer);
+        }
+        CATCH_AND_RETHROW_EXCEPTION
+    }
+
+    // Is the exact same entry already in the index?
+    static bool IsInIndex(IndexReaderPtr reader, const Language& srclang, const Language& lang, const ItemEntry& e)
+    {
+        const std::wstring itemUUID = boost::uuids::to_wstring(make_uuid(srclang, lang, e.source, e.trans, e.form));
+        return reader->docFreq(newLucene<Term>(L"uuid", itemUUID)) > 0;
+    }
+
+    struct QueuedItem
+    {
+        Language srclang, lang;
+        ItemEntries entries;
+        time_t created;
+    };
+
+    static std::wstring EntryUUID(const QueuedItem& item, const ItemEntry& e)
+    {
+        return boost::uuids::to_wstring(make_uuid(item.srclang, item.lang, e.source, e.trans, e.form));
+    }
+
+    /**
+        Makes items queued by InsertLater() so far searchable immediately, by
+        adding them to the delta index. Accumulated items are written to the
+        main indexes if there are many of them, they wait for too long, or
+        if @a writeAll is true.
+     */
+    void ProcessQueue(bool writeAll)
+    {
+        std::lock_guard<std::mutex> insertGuard(m_insertMutex);
+
+        std::map<CatalogItemPtr, QueuedItem> queue;
+        {
+            std::lock_guard<std::mutex> guard(m_queueMutex);
+            std::swap(queue, m_queue);
+            m_queueScheduled = false;
+        }
+
+        if (!queue.empty())
+        {
+            if (m_pending.empty())
+                m_pendingSince = std::chrono::steady_clock::now();
+
+            for (auto& q: queue)
+            {
+                auto& item = q.second;
+                // not needed if the delta is about to be written anyway:
+                if (!writeAll)
+                {
+                    auto analyzer = GetTMAnalyzer(item.srclang, item.lang);
+                    for (auto& e: item.entries)
+                    {
+                        const auto uuid = EntryUUID(item, e);
+                        m_delta->Add(uuid,
+                                     make_document(analyzer, uuid, item.srclang, item.lang, e.source, e.trans,
+                                                   item.created, nullptr, std::wstring(), e.form),
+                                     analyzer);
+                    }
+                }
+                // a newer version of the item replaces the previous one:
+                m_pending[q.first] = std::move(item);
+            }
+
+            if (!writeAll)
+                m_delta->Publish();
+        }
+
+        if (writeAll ||
+            m_pending.size() >= DELTA_MAX_ITEMS ||
+            (!m_pending.empty() && std::chrono::steady_clock::now() - m_pendingSince >= DELTA_MAX_AGE))
+        {
+            WritePending();
+        }
+    }
+
+    // Writes items accumulated in the delta index into the main indexes
+    void WritePending()
+    {
+        if (m_pending.empty())
+            return;
+
+        std::set<TMIndexPtr> touched;
+        for (auto& p: m_pending)
+        {
+            auto& item = p.second;
+            if (item.entries.empty())
+                continue;
+
+            auto index = m_storage->Get(item.srclang, item.lang, /*create=*/true);
+            auto reader = index->Manager().CurrentReader();
+            for (auto& e: item.entries)
+            {
+                // re-confirmed translations don't need to be written again:
+                if (IsInIndex(reader.ptr(), item.srclang, item.lang, e))
+                    continue;
+                Insert(item.srclang, item.lang, e, item.created);
+                touched.insert(index);
+            }
+        }
+
+        wxLogTrace("poedit.tm", "writing %d recently translated items from the delta index", (int)m_pending.size());
+        m_pending.clear();
+
+        // the entries must remain searchable, so only remove them from the
+        // delta once the main indexes' readers contain them:
+        for (auto& index: touched)
+            index->Manager().Refresh();
+        m_delta->Clear();
+    }
+
+    std::shared_ptr<TMStorage> m_storage;
+    DeltaIndexPtr m_delta;
+
+    std::mutex m_queueMutex;
+    std::map<CatalogItemPtr, QueuedItem> m_queue;
+    bool m_queueScheduled = false;
+
+    // serializes processing of the queue and protects the following:
+    std::mutex m_insertMutex;
+    // items that are in the delta index, but not yet written to the main indexes
+    std::map<CatalogItemPtr, QueuedItem> m_pending;
+    std::chrono::steady_clock::time_point m_pendingSince;
+};
+
+
+// ----------------------------------------------------------------
+// Bulk import
+// ----------------------------------------------------------------
+
+namespace
+{
+
+/**
+    Writer used by ImportData().
+
+    updateDocument() must delete any existing document with the same UUID,
+    which makes it expensive when importing many new entries. This writer
+    uses plain addDocument() for entries that are known not to be in the
+    TM yet, i.e. not in the index as it was when the import started and
+    not added earlier during the same import.
+ */
+class BulkImportWriter : public TranslationMemory::IOInterface
+{
+public:
+    /// Entries are tagged with @a importBatch, unless it is empty
+    BulkImportWriter(TMStorage& storage, const std::wstring& importBatch = std::wstring())
+        : m_storage(storage), m_importBatch(importBatch)
+    {}
+
+    ~BulkImportWriter()
+    {
+        try
+        {
+            for (auto& t: m_targets)
+                t.second->index->Writer()->setRAMBufferSizeMB(normal_ram_buffer_size());
+        }
+        catch (...)
+        {
+            // the writer may be already closed after a failure
+        }
+    }
+
+    void Insert(const Language& srclang, const Language& lang,
+                const std::wstring& source, const std::wstring& trans,
+                time_t creationTime) override
+    {
+        Insert(srclang, lang, source, trans, creationTime, m_importBatch);
+    }
+
+    /// Inserts entry tagged with given import batch instead of the writer's one
+    void Insert(const Language& srclang, const Language& lang,
+                const std::wstring& source, const std::wstring& trans,
+                time_t creationTime, const std::wstring& importBatch, unsigned pluralForm = 0)
+    {
+        if (!lang.IsValid() || !srclang.IsValid() || lang == srclang)
+            return;
+
+        if (creationTime == 0)
+            creationTime = time(NULL);
+
+        auto& target = GetTarget(srclang, lang);
+        auto writer = target.index->Writer();
+
+        const auto uuid = make_uuid(srclang, lang, source, trans, pluralForm);
+        const std::wstring itemUUID = boost::uuids::to_wstring(uuid);
+        auto analyzer = GetTMAnalyzer(srclang, lang);
+        auto doc = make_document(analyzer, itemUUID, srclang, lang, source, trans, creationTime,
+                                 m_storage.CompactSources(), importBatch, pluralForm);
+        auto uuidTerm = newLucene<Term>(L"uuid", itemUUID);
+
+        // Note that the check errs on the side of caution: docFreq() counts
+        // deleted documents too, in which case updateDocument() is used.
+        const bool seen = !m_added.insert(uuid).second;
+        if (!seen && (target.emptyIndex || target.reader->docFreq(uuidTerm) == 0))
+            writer->addDocument(doc, analyzer);
+        else
+            writer->updateDocument(uuidTerm, doc, analyzer);
+    }
+
+    /// Commits all indexes written to
+    void Commit()
+    {
+        if (auto sources = m_storage.Sources())
+            sources->Commit();
+        for (auto& t: m_targets)
+            t.second->index->Commit();
+    }
+
+private:
+    // Index written to, with its reader as it was before the import
+    struct Target
+    {
+        Target(TMIndexPtr index_)
+            : index(index_), reader(index_->Manager().CurrentReader()), emptyIndex(reader->numDocs() == 0)
+        {}
+
+        TMIndexPtr index;
+        SearcherManager::SafeRef<IndexReader> reader;
+        bool emptyIndex;
+    };
+
+    Target& GetTarget(const Language& srclang, const Language& lang)
+    {
+        auto index = m_storage.Get(srclang, lang, /*create=*/true);
+        auto& target = m_targets[index.get()];
+        if (!target)
+        {
+            target.reset(new Target(index));
+            // Flush fewer, bigger segments during the import and only commit
+            // once at the end:
+            index->Writer()->setRAMBufferSizeMB(BULK_IMPORT_RAM_BUFFER_MB);
+        }
+        return *target;
+    }
+
+    TMStorage& m_storage;
+    std::wstring m_importBatch;
+    std::map<TMIndex*, std::unique_ptr<Target>> m_targets;
+    std::unordered_set<boost::uuids::uuid, boost::hash<boost::uuids::uuid>> m_added;
+};
+
+
+void TMStorage::MigrateFromOtherLayout()
+{
+    std::vector<std::wstring> sources;
+    if (m_partitioned)
+    {
+        if (wxDirExists(m_mainDir))
+            sources.push_back(m_mainDir);
+    }
+    else
+    {
+        wxDir dir;
+        if (wxDirExists(m_shardsDir) && dir.Open(m_shardsDir))
+        {
+            wxString name;
+            for (bool cont = dir.GetFirst(&name, "", wxDIR_DIRS); cont; cont = dir.GetNext(&name))
+                sources.push_back(m_shardsDir + wxFILE_SEP_PATH + name.ToStdWstring());
+        }
+    }
+
+    if (sources.empty())
+        return;
+
+    BulkImportWriter writer(*this);
+    for (auto& path: sources)
+    {
+        TMIndex old(path, m_analyzer);
+        auto reader = old.Manager().Reader();
+        Progress progress(reader->maxDoc());
+        // not export_documents(), import batch tags and plural forms must be preserved:
+        for_each_document_batch(reader.ptr(), m_sources.get(), progress, [&](const std::vector<ExportedEntry>& batch)
+        {
+            for (auto& e: batch)
+                writer.Insert(e.srclang, e.lang, e.source, e.trans, e.created, e.batch, e.form);
+        });
+    }
+    writer.Commit();
+
+    // only remove the old data after it was committed to the new location:
+    for (auto& path: sources)
+        wxFileName::Rmdir(path, wxPATH_RMDIR_RECURSIVE);
+    if (!m_partitioned)
+        wxFileName::Rmdir(m_shardsDir, wxPATH_RMDIR_RECURSIVE);
+}
+
+
+// Calls @a func with all terms of untokenized @a field, reading only the term dictionary
+template<typename F>
+void for_each_field_term(IndexReaderPtr reader, const Lucene::String& field, F&& func)
+{
+    auto terms = reader->terms(newLucene<Term>(field, L""));
+    do
+    {
+        auto term = terms->term();
+        if (!term || term->field() != field)
+            break;
+        func(term);
+    }
+    while (terms->next());
+    terms->close();
+}
+
+// Assigns documents values of untokenized @a field, as indexes into @a values
+// (-1 if the document doesn't have the field)
+std::vector<int> map_field_values(IndexReaderPtr reader, const Lucene::String& field, std::vector<Lucene::String>& values)
+{
+    std::vector<int> valueOf(reader->maxDoc(), -1);
+    for_each_field_term(reader, field, [&](TermPtr term)
+    {
+        const int id = (int)values.size();
+        values.push_back(term->text());
+        auto docs = reader->termDocs(term);
+        while (docs->next())
+            valueOf[docs->doc()] = id;
+    });
+    return valueOf;
+}
+
+// Returns documents whose "analysis" field doesn't match their languages' GetTMAnalysisId()
+std::vector<int32_t> find_documents_to_reanalyze(IndexReaderPtr reader)
+{
+    // Most indexes only contain documents analyzed in the standard way, which
+    // can be seen from the term dictionaries alone:
+    bool needsCheck = false;
+    for_each_field_term(reader, L"analysis", [&](TermPtr) { needsCheck = true; });
+    for (auto field: {L"srclang", L"lang"})
+    {
+        for_each_field_term(reader, field, [&](TermPtr term)
+        {
+            if (GetTextAnalysis(Language::TryParse(term->text())) != TextAnalysis::Standard)
+                needsCheck = true;
+        });
+    }
+
+    std::vector<int32_t> outdated;
+    if (!needsCheck)
+        return outdated;
+
+    std::vector<Lucene::String> srclangs, langs, analyses;
+    const auto srclangOf = map_field_values(reader, L"srclang", srclangs);
+    const auto langOf = map_field_values(reader, L"lang", langs);
+    const auto analysisOf = map_field_values(reader, L"analysis", analyses);
+
+    std::map<std::pair<int, int>, std::wstring> expected;
+    const int32_t maxDoc = reader->maxDoc();
+    for (int32_t i = 0; i < maxDoc; i++)
+    {
+        if (srclangOf[i] == -1 || langOf[i] == -1 || reader->isDeleted(i))
+            continue;
+
+        const auto pair = std::make_pair(srclangOf[i], langOf[i]);
+        auto e = expected.find(pair);
+        if (e == expected.end())
+        {
+            auto id = GetTMAnalysisId(Language::TryParse(srclangs[pair.first]), Language::TryParse(langs[pair.second]));
+            e = expected.emplace(pair, id).first;
+        }
+
+        const bool matches = (analysisOf[i] == -1) ? e->second.empty() : (e->second == analyses[analysisOf[i]]);
+        if (!matches)
+            outdated.push_back(i);
+    }
+
+    return outdated;
+}
+
+
+void TMStorage::MigrateAnalysis()
+{
+    std::vector<TMIndexPtr> indexes;
+    if (m_partitioned)
+    {
+        // only indexes of languages that aren't analyzed in the standard way
+        // can contain outdated documents, so don't open the others:
+        auto isStandard = [](const wxString& lang)
+        {
+            return GetTextAnalysis(Language::TryParse(lang.ToStdWstring())) == TextAnalysis::Standard;
+        };
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        wxDir dir(m_shardsDir);
+        if (dir.IsOpened())
+        {
+            wxString name;
+            for (bool cont = dir.GetFirst(&name, "", wxDIR_DIRS); cont; cont = dir.GetNext(&name))
+            {
+                if (!isStandard(name.BeforeFirst('-')) || !isStandard(name.AfterFirst('-')))
+                    indexes.push_back(DoGet(name.ToStdWstring(), /*create=*/false));
+            }
+        }
+    }
+    else
+    {
+        indexes.push_back(m_main);
+    }
+
+    for (auto& index: indexes)
+    {
+        auto reader = index->Manager().Reader();
+        auto outdated = find_documents_to_reanalyze(reader.ptr());
+        if (outdated.empty())
+            continue;
+
+        wxLogTrace("poedit.tm", "reindexing %d documents with changed tokenization", (int)outdated.size());
+
+        auto writer = index->Writer();
+        for (auto i: outdated)
+        {
+            auto doc = reader->document(i);
+            if (m_sources)
+                m_sources->Resolve(doc);
+
+            const auto srclang = Language::TryParse(doc->get(L"srclang"));
+            const auto lang = Language::TryParse(doc->get(L"lang"));
+            const auto uuid = doc->get(L"uuid");
+            auto analyzer = GetTMAnalyzer(srclang, lang);
+            auto newDoc = make_document(analyzer, uuid, srclang, lang,
+                                        get_text_field(doc, L"source"),
+                                        get_text_field(doc, L"trans"),
+                                        DateField::stringToTime(doc->get(L"created")),
+                                        CompactSources(),
+                                        doc->get(L"batch"),
+                                        get_plural_form(doc));
+            writer->updateDocument(newLucene<Term>(L"uuid", uuid), newDoc, analyzer);
+        }
+
+        // source texts first, documents may refer to them:
+        if (m_sources)
+            m_sources->Commit();
+        index->Commit();
+    }
+}
+
+
+// Does language code stored in a document match language of EntriesFilter?
+bool matches_filter_language(const Lucene::String& code, const Language& lang)
+{
+    const Lucene::String& wanted = lang.WCode();
+    if (code == wanted)
+        return true;
+    // if only the language is given, its regional variants match too:
+    return lang.Country().empty() &&
+           code.size() > wanted.size() && code[wanted.size()] == L'_' && code.compare(0, wanted.size(), wanted) == 0;
+}
+
+// Returns non-deleted documents matching the filter's criteria that can be
+// checked using the index alone, i.e. everything except creation time.
+std::vector<int32_t> find_filter_candidates(IndexReaderPtr reader, const TranslationMemory::EntriesFilter& filter)
+{
+    const int32_t maxDoc = reader->maxDoc();
+    std::vector<char> matching(maxDoc, 1);
+
+    auto restrict_by = [&](const Lucene::String& field, std::function<bool(const Lucene::String&)> accept)
+    {
+        std::vector<char> found(maxDoc, 0);
+        for_each_field_term(reader, field, [&](TermPtr term)
+        {
+            if (!accept(term->text()))
+                return;
+            auto docs = reader->termDocs(term);
+            while (docs->next())
+                found[docs->doc()] = 1;
+        });
+        for (int32_t i = 0; i < maxDoc; i++)
+            matching[i] &= found[i];
+    };
+
+    if (filter.srclang.IsValid())
+        restrict_by(L"srclang", [&](const Lucene::String& code){ return matches_filter_language(code, filter.srclang); });
+    if (filter.lang.IsValid())
+        restrict_by(L"lang", [&](const Lucene::String& code){ return matches_filter_language(code, filter.lang); });
+    if (!filter.importBatch.empty())
+    {
+        const auto batch = StringUtils::toUnicode(filter.importBatch);
+        restrict_by(L"batch", [&](const Lucene::String& value){ return value == batch; });
+    }
+
+    std::vector<int32_t> candidates;
+    for (int32_t i = 0; i < maxDoc; i++)
+    {
+        if (matching[i] && !reader->isDeleted(i))
+            candidates.push_back(i);
+    }
+    return candidates;
+}
+
+// Passes documents of the reader matching the filter to @a func, in batches, see read_batches_in_rounds()
+template<typename Func>
+void for_each_filtered_document_batch(IndexReaderPtr reader, SourceTable *sources,
+                                      const TranslationMemory::EntriesFilter& filter, Func&& func)
+{
+    const auto candidates = find_filter_candidates(reader, filter);
+    const size_t batchesCount = (candidates.size() + EXPORT_BATCH_SIZE - 1) / EXPORT_BATCH_SIZE;
+    Progress progress(candidates.size());
+
+    read_batches_in_rounds(batchesCount,
+        [&](size_t n)
+        {
+            const size_t first = n * EXPORT_BATCH_SIZE;
+            const size_t last = std::min(candidates.size(), first + EXPORT_BATCH_SIZE);
+            std::vector<ExportedEntry> out;
+            out.reserve(last - first);
+            for (size_t i = first; i < last; i++)
+            {
+                auto e = read_document(reader, sources, candidates[i]);
+                if (filter.createdFrom && e.created < filter.createdFrom)
+                    continue;
+                if (filter.createdTo && e.created >= filter.createdTo)
+                    continue;
+                out.push_back(std::move(e));
+            }
+            return out;
+        },
+        [&](size_t n, std::vector<ExportedEntry>& batch)
+        {
+            func(batch);
+            progress.increment(int(std::min(candidates.size(), (n + 1) * EXPORT_BATCH_SIZE) - n * EXPORT_BATCH_SIZE));
+        });
+}
+
+// Returns indexes that may contain entries matching the filter
+std::vector<TMIndexPtr> indexes_for_filter(TMStorage& storage, const TranslationMemory::EntriesFilter& filter)
+{
+    // if partitioned, entries of a language pair are all in the same index:
+    if (filter.srclang.IsValid() && filter.lang.IsValid())
+    {
+        auto index = storage.Get(filter.srclang, filter.lang, /*create=*/false);
+        if (!index)
+            return {};
+        return {index};
+    }
+    return storage.All();
+}
+
+} // anonymous namespace
+
+
+std::string TranslationMemoryImpl::ImportData(std::function<void(TranslationMemory::IOInterface&)> source)
+{
+    try
+    {
+        const auto importBatch = boost::uuids::to_string(boost::uuids::random_generator()());
+        BulkImportWriter writer(*m_storage, StringUtils::toUnicode(importBatch));
+        source(writer);
+        writer.Commit();
+        gs_revision++;
+        return importBatch;
+    }
+    CATCH_AND_RETHROW_EXCEPTION
+}
+
+
+size_t TranslationMemoryImpl::CountEntries(const TranslationMemory::EntriesFilter& filter)
+{
+    try
+    {
+        size_t count = 0;
+        for (auto& index: indexes_for_filter(*m_storage, filter))
+        {
+            auto reader = index->Manager().CurrentReader();
+            // documents only need to be read to check their creation time:
+            if (!filter.createdFrom && !filter.createdTo)
+            {
+                count += find_filter_candidates(reader.ptr(), filter).size();
+                continue;
+            }
+            for_each_filtered_document_batch(reader.ptr(), nullptr, filter, [&](const std::vector<ExportedEntry>& batch)
+            {
+                count += batch.size();
+            });
+        }
+        return count;
+    }
+    CATCH_AND_RETHROW_EXCEPTION
+}
+
+
+size_t TranslationMemoryImpl::ExportEntries(const TranslationMemory::EntriesFilter& filter,
+                                            TranslationMemory::IOInterface& destination)
+{
+    try
+    {
+        auto indexes = indexes_for_filter(*m_storage, filter);
+        Progress progress((int)indexes.size());
+
+        size_t count = 0;
+        for (auto& index: indexes)
+        {
+            Progress subtask(1, progress, 1);
+            auto reader = index->Manager().CurrentReader();
+            for_each_filtered_document_batch(reader.ptr(), m_storage->Sources().get(), filter, [&](const std::vector<ExportedEntry>& batch)
+            {
+                for (auto& e: batch)
+                {
+                    // see export_documents()
+                    if (e.form)
+                        continue;
+                    destination.Insert(e.srclang, e.lang, e.source, e.trans, e.created);
+                    count++;
+                }
+            });
+        }
+        return count;
+    }
+    CATCH_AND_RETHROW_EXCEPTION
+}
+
 
-void TranslationMemoryImpl::SearchSubstring(TranslationMemory::IOInterface& destination,
-                                            const Language& srclang, const Language& lang, const std::wstring& sourcePhrase)
+size_t TranslationMemoryImpl::DeleteEntries(const TranslationMemory::EntriesFilter& filter)
 {
-    try
+    // nothing but the batch field needs to be checked, which the index can do alone:
+    if (!filter.importBatch.empty() && !filter.srclang.IsValid() && !filter.lang.IsValid() &&
+        !filter.createdFrom && !filter.createdTo)
     {
-        const Lucene::String sourceField(L"source");
-        auto phraseQ = newLucene<PhraseQuery>();
+        return RollbackImport(filter.importBatch);
+    }
 
-        auto stream = m_analyzer->tokenStream(sourceField, newLucene<StringReader>(sourcePhrase));
-        int sourceTokenPosition = -1;
-        while (stream->incrementToken())
+    TRACE_SPAN("tm", "DeleteEntries");
+    try
+    {
+        auto indexes = indexes_for_filter(*m_storage, filter);
+        Progress progress((int)indexes.size());
+
+        // all matching documents are deleted with a single call per index and
+        // committed together at the end, without reloading readers in between:
+        size_t count = 0;
+        std::vector<TMIndexPtr> modified;
+        for (auto& index: indexes)
         {
-            auto word = stream->getAttribute<TermAttribute>()->term();
-            sourceTokenPosition += stream->getAttribute<PositionIncrementAttribute>()->getPositionIncrement();
-            auto term = newLucene<Term>(sourceField, word);
-            phraseQ->add(term, sourceTokenPosition);
-        }
+            Progress subtask(1, progress, 1);
+            auto reader = index->Manager().CurrentReader();
+            auto terms = Collection<TermPtr>::newInstance();
+            for_each_filtered_document_batch(reader.ptr(), nullptr, filter, [&](const std::vector<ExportedEntry>& batch)
+            {
+                for (auto& e: batch)
+                    terms.add(newLucene<Term>(L"uuid", e.uuid));
+            });
+            if (terms.empty())
+                continue;
 
-        SearchArguments sa;
-        sa.set_lang(srclang, lang);
-        sa.exactSourceText = sourcePhrase;
-        sa.query = phraseQ;
+            index->Writer()->deleteDocuments(terms);
+            count += terms.size();
+            modified.push_back(index);
+        }
 
-        auto searcher = m_mng->Searcher();
+        for (auto& index: modified)
+            index->Commit();
+        if (count)
+            gs_revision++;
 
-        PerformSearchWithBlock
-        (
-            searcher.ptr(), sa, /*qualityThreshold=*/0.0, /*scoreScaling=*/1.0,
-            [&](DocumentPtr doc, double /*score*/)
-            {
-                auto sourceText = get_text_field(doc, sourceField);
-                if (boost::algorithm::ifind_first(sourceText, sourcePhrase))
-                {
-                    destination.Insert
-                    (
-                        srclang,
-                        lang,
-                        sourceText,
-                        get_text_field(doc, L"trans"),
-                        DateField::stringToTime(doc->get(L"created"))
-                    );
-                }
-            }
-        );
+        wxLogTrace("poedit.tm", "deleted %d entries in bulk", (int)count);
+        return count;
     }
     CATCH_AND_RETHROW_EXCEPTION
 }
 
 
-void TranslationMemoryImpl::ExportData(TranslationMemory::IOInterface& destination)
+size_t TranslationMemoryImpl::RollbackImport(const std::string& importBatch)
 {
+    TRACE_SPAN("tm", "RollbackImport");
+    if (importBatch.empty())
+        return 0;
+
     try
     {
-        auto reader = m_mng->Reader();
-        int32_t numDocs = reader->maxDoc();
-        Progress progress(numDocs);
+        auto term = newLucene<Term>(L"batch", StringUtils::toUnicode(importBatch));
 
-        for (int32_t i = 0; i < numDocs; i++)
+        size_t count = 0;
+        std::vector<TMIndexPtr> modified;
+        for (auto& index: m_storage->All())
         {
-            progress.increment();
-            if (reader->isDeleted(i))
+            // docFreq() would include already deleted documents, termDocs() skips them:
+            size_t found = 0;
+            {
+                auto reader = index->Manager().CurrentReader();
+                auto docs = reader->termDocs(term);
+                while (docs->next())
+                    found++;
+            }
+            if (!found)
                 continue;
-            auto doc = reader->document(i);
-            destination.Insert
-            (
-            	Language::TryParse(doc->get(L"srclang")),
-                Language::TryParse(doc->get(L"lang")),
-                get_text_field(doc, L"source"),
-                get_text_field(doc, L"trans"),
-                DateField::stringToTime(doc->get(L"created"))
-            );
+
+            index->Writer()->deleteDocuments(term);
+            count += found;
+            modified.push_back(index);
         }
+
+        for (auto& index: modified)
+            index->Commit();
+        if (count)
+            gs_revision++;
+
+        wxLogTrace("poedit.tm", "rolled back import %s: %d entries", importBatch.c_str(), (int)count);
+        return count;
     }
     CATCH_AND_RETHROW_EXCEPTION
 }
 
 
-void TranslationMemoryImpl::ImportData(std::function<void(TranslationMemory::IOInterface&)> source)
+TranslationMemoryImpl::~TranslationMemoryImpl()
 {
-    auto writer = TranslationMemory::Get().GetWriter();
-    source(*writer);
-    writer->Commit();
+    if (m_writerAPI)
+        std::static_pointer_cast<TranslationMemoryWriterImpl>(m_writerAPI)->FlushDelta();
 }
 
 
-void TranslationMemoryImpl::GetStats(long& numDocs, long& fileSize)
+void TranslationMemoryImpl::Init()
 {
     try
     {
-        auto reader = m_mng->Reader();
-        numDocs = reader->numDocs();
-        fileSize = wxDir::GetTotalSize(GetDatabaseDir()).GetValue();
+        m_analyzer = GetTMAnalyzer(Language(), Language());
+
+        m_storage = std::make_shared<TMStorage>(m_analyzer,
+                                                GetDatabaseDir(), GetShardsDatabaseDir(), GetSourcesDatabaseDir(),
+                                                Config::TMPartitionByLanguage(), Config::TMCompactStorage());
+        m_storage->MigrateFromOtherLayout();
+        m_storage->MigrateAnalysis();
+
+        m_delta = std::make_shared<DeltaIndex>(m_analyzer);
+        m_writerAPI = std::make_shared<TranslationMemoryWriterImpl>(m_storage, m_delta);
     }
     CATCH_AND_RETHROW_EXCEPTION
 }
 
-// ----------------------------------------------------------------
-// TranslationMemoryWriterImpl
-// ----------------------------------------------------------------
 
-class TranslationMemoryWriterImpl : public TranslationMemory::Writer
+void TranslationMemoryImpl::WarmUp()
 {
-public:
-    TranslationMemoryWriterImpl(IndexWriterPtr writer) : m_writer(writer) {}
-
-    ~TranslationMemoryWriterImpl() {}
-
-    void Commit() override
+    TRACE_SPAN("tm", "WarmUp");
+    try
     {
-        try
+        for (auto& index: m_storage->All())
         {
-            m_writer->commit();
+            auto reader = index->Manager().Reader();
+            // looking up a term loads the term dictionary's index:
+            reader->docFreq(newLucene<Term>(L"source", L""));
+            // fields used for pre-scoring hits, cached per segment:
+            PerDocumentInts lengths(reader.ptr(), L"srclen");
+            PerDocumentInts tokens(reader.ptr(), L"srctokens");
         }
-        CATCH_AND_RETHROW_EXCEPTION
     }
-
-    void Rollback() override
+    catch (...)
     {
-        try
-        {
-            m_writer->rollback();
-        }
-        CATCH_AND_RETHROW_EXCEPTION
+        // not essential, any errors will be reported when the TM is used
     }
+}
+
+
+// ----------------------------------------------------------------
+// TM hosted by another process
+// ----------------------------------------------------------------
+
+namespace
+{
+
+[[noreturn]] void throw_unavailable_with_service()
+{
+    BOOST_THROW_EXCEPTION(Exception(_("This operation is not available while the translation memory is used by another instance of Poedit.")));
+}
+
+} // anonymous namespace
+
+#ifdef HAVE_TM_SERVICE
+
+/**
+    Writer used when the TM is hosted by another process.
+
+    Changes are collected locally and sent in batches on Commit(). Entries
+    aren't checked against the TM first, as that would need extra round
+    trips; the hosting process replaces existing identical ones.
+ */
+class ServiceWriter : public TranslationMemory::Writer
+{
+public:
+    ServiceWriter(std::shared_ptr<TMServiceClient> service) : m_service(service) {}
 
     void Insert(const Language& srclang, const Language& lang,
                 const std::wstring& source, const std::wstring& trans,
@@ -654,45 +3215,8 @@ public:
         if (!lang.IsValid() || !srclang.IsValid() || lang == srclang)
             return;
 
-        if (creationTime == 0)
-            creationTime = time(NULL);
-
-        // Compute unique ID for the translation:
-
-        static const boost::uuids::uuid s_namespace =
-          boost::uuids::string_generator()("6e3f73c5-333f-4171-9d43-954c372a8a02");
-        boost::uuids::name_generator gen(s_namespace);
-
-        std::wstring itemId(srclang.WCode());
-        itemId += lang.WCode();
-        itemId += source;
-        itemId += trans;
-
-        const std::wstring itemUUID = boost::uuids::to_wstring(gen(itemId));
-
-        try
-        {
-            // Then add a new document:
-            auto doc = newLucene<Document>();
-
-            doc->add(newLucene<Field>(L"uuid", itemUUID,
-                                      Field::STORE_YES, Field::INDEX_NOT_ANALYZED));
-            doc->add(newLucene<Field>(L"v", L"1",
-                                      Field::STORE_YES, Field::INDEX_NO));
-            doc->add(newLucene<Field>(L"created", DateField::timeToString(creationTime),
-                                      Field::STORE_YES, Field::INDEX_NO));
-            doc->add(newLucene<Field>(L"srclang", srclang.WCode(),
-                                      Field::STORE_YES, Field::INDEX_NOT_ANALYZED));
-            doc->add(newLucene<Field>(L"lang", lang.WCode(),
-                                      Field::STORE_YES, Field::INDEX_NOT_ANALYZED));
-            doc->add(newLucene<Field>(L"source", source,
-                                      Field::STORE_YES, Field::INDEX_ANALYZED));
-            doc->add(newLucene<Field>(L"trans", trans,
-                                      Field::STORE_YES, Field::INDEX_NOT_ANALYZED));
-
-            m_writer->updateDocument(newLucene<Term>(L"uuid", itemUUID), doc);
-        }
-        CATCH_AND_RETHROW_EXCEPTION
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_entries.push_back({srclang, lang, source, trans, creationTime ? creationTime : time(NULL)});
     }
 
     void Insert(const Language& srclang, const Language& lang,
@@ -703,100 +3227,76 @@ public:
 
     void Insert(const Language& srclang, const Language& lang, const CatalogItemPtr& item) override
     {
-        if (!lang.IsValid() || !srclang.IsValid())
-            return;
-
-        // ignore translations with errors in them
-        if (item->HasError())
-            return;
-
-        // ignore untranslated, pre-translated and non-revised or unfinished translations
-        if (item->IsFuzzy() || item->IsPreTranslated() || !item->IsTranslated())
-            return;
-
-        // always store at least the singular translation
-        Insert(srclang, lang, str::to_wstring(item->GetString()), str::to_wstring(item->GetTranslation()));
-
-        // for plurals, try to support at least the simpler cases, with nplurals <= 2
-        if (item->HasPlural())
+        for (auto& e: get_item_entries(lang, item))
         {
-            switch (lang.nplurals())
-            {
-                case 1:
-                    // e.g. Chinese, Japanese; store translation for both singular and plural
-                    Insert(srclang, lang, str::to_wstring(item->GetPluralString()), str::to_wstring(item->GetTranslation()));
-                    break;
-                case 2:
-                    // e.g. Germanic or Romanic languages, same 2 forms as English
-                    Insert(srclang, lang, str::to_wstring(item->GetPluralString()), str::to_wstring(item->GetTranslation(1)));
-                    break;
-                default:
-                    // not supported, only singular stored above
-                    break;
-            }
+            // separately stored plural forms aren't supported by the service protocol
+            if (!e.form)
+                Insert(srclang, lang, e.source, e.trans);
         }
     }
 
-    void Insert(const CatalogPtr& cat) override
+    void Insert(const CatalogPtr& catalog) override
     {
-        Progress progress(cat->items().size());
-
+        auto cat = catalog->TakeSnapshot();
         auto srclang = cat->GetSourceLanguage();
         auto lang = cat->GetLanguage();
-        if (!lang.IsValid() || !srclang.IsValid())
-            return;
-
         for (auto& item: cat->items())
         {
-            // Note that dt.IsModified() is intentionally not checked - we
-            // want to save old entries in the TM too, so that we harvest as
-            // much useful translations as we can.
-            Insert(srclang, lang, item);
-            progress.increment();
+            for (auto& e: get_item_entries(lang, item))
+            {
+                if (!e.form)
+                    Insert(srclang, lang, e.source, e.trans);
+            }
         }
     }
 
+    void InsertLater(const Language& srclang, const Language& lang, const CatalogItemPtr& item) override
+    {
+        Insert(srclang, lang, item);
+    }
+
     void Delete(const std::string& uuid) override
     {
-        try
-        {
-            m_writer->deleteDocuments(newLucene<Term>(L"uuid", StringUtils::toUnicode(uuid)));
-        }
-        CATCH_AND_RETHROW_EXCEPTION
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_deleted.push_back(uuid);
     }
 
     void DeleteAll() override
     {
-        try
-        {
-            m_writer->deleteAll();
-        }
-        CATCH_AND_RETHROW_EXCEPTION
+        throw_unavailable_with_service();
     }
 
-private:
-    IndexWriterPtr m_writer;
-};
-
-
-void TranslationMemoryImpl::Init()
-{
-    try
+    void Commit() override
     {
-        auto dir = newLucene<DirectoryType>(GetDatabaseDir());
-        m_analyzer = newLucene<StandardAnalyzer>(LuceneVersion::LUCENE_CURRENT);
-
-        m_writer = newLucene<IndexWriter>(dir, m_analyzer, IndexWriter::MaxFieldLengthLIMITED);
-        m_writer->setMergeScheduler(newLucene<SerialMergeScheduler>());
+        std::vector<TMServiceClient::Entry> entries;
+        std::vector<std::string> deleted;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            std::swap(entries, m_entries);
+            std::swap(deleted, m_deleted);
+        }
+        if (entries.empty() && deleted.empty())
+            return;
 
-        // get the associated realtime reader & searcher:
-        m_mng.reset(new SearcherManager(m_writer));
+        TRACE_SPAN("tm", "Commit");
+        m_service->Update(entries, deleted);
+    }
 
-        m_writerAPI = std::make_shared<TranslationMemoryWriterImpl>(m_writer);
+    void Rollback() override
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_entries.clear();
+        m_deleted.clear();
     }
-    CATCH_AND_RETHROW_EXCEPTION
-}
 
+private:
+    std::shared_ptr<TMServiceClient> m_service;
+    std::mutex m_mutex;
+    std::vector<TMServiceClient::Entry> m_entries;
+    std::vector<std::string> m_deleted;
+};
+
+#endif // HAVE_TM_SERVICE
 
 
 // ----------------------------------------------------------------
@@ -823,39 +3323,166 @@ void TranslationMemory::CleanUp()
     }
 }
 
-TranslationMemory::TranslationMemory() : m_impl(nullptr)
+void TranslationMemory::Preload()
 {
-    try
+    dispatch::async(dispatch::priority::bulk, []
     {
-        m_impl = new TranslationMemoryImpl;
-    }
-    catch (...)
+        try
+        {
+            Get().Impl().WarmUp();
+        }
+        catch (...)
+        {
+            // the error is reported when the TM is used
+        }
+    });
+}
+
+TranslationMemory::TranslationMemory() : m_implReady(false), m_impl(nullptr)
+{
+}
+
+TranslationMemoryImpl& TranslationMemory::Impl()
+{
+    if (m_service)
+        throw_unavailable_with_service();
+
+    std::call_once(m_implFlag, [=]
     {
-        m_error = std::current_exception();
-    }
+        TRACE_SPAN("tm", "Open");
+        try
+        {
+            m_impl = new TranslationMemoryImpl;
+        }
+        catch (...)
+        {
+            m_error = std::current_exception();
+        }
+        m_implReady = true;
+    });
+
+    if (!m_impl)
+        std::rethrow_exception(m_error);
+    return *m_impl;
 }
 
 TranslationMemory::~TranslationMemory() { delete m_impl; }
 
+void TranslationMemory::UseService(std::shared_ptr<TMServiceClient> service)
+{
+#ifdef HAVE_TM_SERVICE
+    m_service = service;
+    m_serviceWriter = std::make_shared<ServiceWriter>(service);
+#else
+    (void)service;
+#endif
+}
+
 
 // ----------------------------------------------------------------
 // public API
 // ----------------------------------------------------------------
 
+namespace
+{
+
+// Searches all texts in the same language pair together, so that the work
+// that doesn't depend on the text is done only once. @a search is called
+// with (srclang, lang, sources) and must give the same results as
+// SuggestTranslation() would for each of the sources.
+template<typename F>
+std::vector<SuggestionsList> search_by_language_pairs(const std::vector<SuggestionQuery>& queries, F&& search)
+{
+    typedef std::pair<std::string, std::string> LangPair;
+    std::map<LangPair, std::vector<size_t>> groups;
+    for (size_t i = 0; i < queries.size(); i++)
+        groups[LangPair(queries[i].srclang.Code(), queries[i].lang.Code())].push_back(i);
+
+    std::vector<SuggestionsList> results(queries.size());
+    for (auto& g: groups)
+    {
+        auto& first = queries[g.second.front()];
+        std::vector<std::wstring> sources;
+        sources.reserve(g.second.size());
+        for (auto i: g.second)
+            sources.push_back(queries[i].source);
+
+        auto hits = search(first.srclang, first.lang, sources);
+        for (size_t j = 0; j < hits.size(); j++)
+            results[g.second[j]] = std::move(hits[j]);
+    }
+
+    return results;
+}
+
+} // anonymous namespace
+
 SuggestionsList TranslationMemory::Search(const Language& srclang,
                                           const Language& lang,
                                           const std::wstring& source)
 {
-    if (!m_impl)
-        std::rethrow_exception(m_error);
-    return m_impl->Search(srclang, lang, source);
+#ifdef HAVE_TM_SERVICE
+    if (m_service)
+        return m_service->Search(srclang, {lang}, {source}, /*exactOnly=*/false).front().front();
+#endif
+    return Impl().Search(SuggestionQuery{srclang, lang, source});
+}
+
+std::vector<SuggestionsList> TranslationMemory::Search(const Language& srclang,
+                                                       const Language& lang,
+                                                       const std::vector<std::wstring>& sources)
+{
+#ifdef HAVE_TM_SERVICE
+    if (m_service)
+        return m_service->Search(srclang, {lang}, sources, /*exactOnly=*/true).front();
+#endif
+    return Impl().Search(srclang, lang, sources, /*exactOnly=*/true);
+}
+
+std::vector<SuggestionsList> TranslationMemory::SearchPluralForm(const Language& srclang,
+                                                                 const Language& lang,
+                                                                 const std::vector<std::wstring>& pluralSources,
+                                                                 unsigned form)
+{
+#ifdef HAVE_TM_SERVICE
+    // not supported by the service protocol
+    if (m_service)
+        return std::vector<SuggestionsList>(pluralSources.size());
+#endif
+    return Impl().Search(srclang, lang, pluralSources, /*exactOnly=*/true, form);
+}
+
+std::vector<std::vector<SuggestionsList>> TranslationMemory::Search(const Language& srclang,
+                                                                    const std::vector<Language>& langs,
+                                                                    const std::vector<std::wstring>& sources)
+{
+#ifdef HAVE_TM_SERVICE
+    if (m_service)
+        return m_service->Search(srclang, langs, sources, /*exactOnly=*/true);
+#endif
+    return Impl().Search(srclang, langs, sources);
 }
 
 dispatch::future<SuggestionsList> TranslationMemory::SuggestTranslation(const SuggestionQuery&& q)
 {
+#ifdef HAVE_TM_SERVICE
+    if (m_service)
+    {
+        auto service = m_service;
+        return dispatch::async(dispatch::priority::interactive, [service, q]
+        {
+            return service->Search(q.srclang, {q.lang}, {q.source}, /*exactOnly=*/false).front().front();
+        });
+    }
+#endif
+
+    // Don't block the caller, typically the UI, until the database is opened:
+    if (!m_implReady)
+        return dispatch::async(dispatch::priority::interactive, [this, q]{ return Impl().Search(q); });
+
     try
     {
-        return dispatch::make_ready_future(Search(q.srclang, q.lang, q.source));
+        return dispatch::make_ready_future(Impl().Search(q));
     }
     catch (...)
     {
@@ -863,6 +3490,46 @@ dispatch::future<SuggestionsList> TranslationMemory::SuggestTranslation(const Su
     }
 }
 
+dispatch::future<std::vector<SuggestionsList>> TranslationMemory::SuggestTranslations(const std::vector<SuggestionQuery>& queries)
+{
+#ifdef HAVE_TM_SERVICE
+    if (m_service)
+    {
+        auto service = m_service;
+        return dispatch::async(dispatch::priority::bulk, [service, queries]
+        {
+            return search_by_language_pairs(queries, [&service](auto& srclang, auto& lang, auto& sources)
+            {
+                return service->Search(srclang, {lang}, sources, /*exactOnly=*/false).front();
+            });
+        });
+    }
+#endif
+
+    if (!m_implReady)
+    {
+        return dispatch::async(dispatch::priority::bulk, [this, queries]
+        {
+            Impl();
+            return SuggestTranslations(queries).get();
+        });
+    }
+
+    try
+    {
+        auto& impl = Impl();
+        auto results = search_by_language_pairs(queries, [&impl](auto& srclang, auto& lang, auto& sources)
+        {
+            return impl.Search(srclang, lang, sources, /*exactOnly=*/false);
+        });
+        return dispatch::make_ready_future(std::move(results));
+    }
+    catch (...)
+    {
+        return dispatch::make_exceptional_future_from_current<std::vector<SuggestionsList>>();
+    }
+}
+
 void TranslationMemory::Delete(const std::string& id)
 {
     auto tm = TranslationMemory::Get().GetWriter();
@@ -870,29 +3537,67 @@ void TranslationMemory::Delete(const std::string& id)
     tm->Commit();
 }
 
+unsigned TranslationMemory::GetRevision() const
+{
+#ifdef HAVE_TM_SERVICE
+    if (m_service)
+        return m_service->GetRevision();
+#endif
+    return gs_revision;
+}
+
 void TranslationMemory::ExportData(IOInterface& destination)
 {
-    if (!m_impl)
-        std::rethrow_exception(m_error);
-    return m_impl->ExportData(destination);
+    return Impl().ExportData(destination);
 }
 
-void TranslationMemory::ImportData(std::function<void(IOInterface&)> source)
+std::string TranslationMemory::ImportData(std::function<void(IOInterface&)> source)
 {
-    if (!m_impl)
-        std::rethrow_exception(m_error);
-    return m_impl->ImportData(source);
+#ifdef HAVE_TM_SERVICE
+    if (m_service)
+    {
+        ServiceWriter writer(m_service);
+        source(writer);
+        writer.Commit();
+        return std::string();
+    }
+#endif
+    return Impl().ImportData(source);
+}
+
+size_t TranslationMemory::CountEntries(const EntriesFilter& filter)
+{
+    return Impl().CountEntries(filter);
+}
+
+size_t TranslationMemory::ExportEntries(const EntriesFilter& filter, IOInterface& destination)
+{
+    return Impl().ExportEntries(filter, destination);
+}
+
+size_t TranslationMemory::DeleteEntries(const EntriesFilter& filter)
+{
+    return Impl().DeleteEntries(filter);
+}
+
+size_t TranslationMemory::RollbackImport(const std::string& importBatch)
+{
+    return Impl().RollbackImport(importBatch);
 }
 
 std::shared_ptr<TranslationMemory::Writer> TranslationMemory::GetWriter()
 {
-    if (!m_impl)
-        std::rethrow_exception(m_error);
-    return m_impl->GetWriter();
+    if (m_serviceWriter)
+        return m_serviceWriter;
+    return Impl().GetWriter();
 }
 
 void TranslationMemory::DeleteAllAndReset()
 {
+    // don't delete the database used by another process below:
+    if (m_service)
+        throw_unavailable_with_service();
+
     try
     {
         auto tm = TranslationMemory::Get().GetWriter();
@@ -903,26 +3608,52 @@ void TranslationMemory::DeleteAllAndReset()
     {
         // Lucene database is corrupted, best we can do is delete it completely
         wxFileName::Rmdir(TranslationMemoryImpl::GetDatabaseDir(), wxPATH_RMDIR_RECURSIVE);
+        wxFileName::Rmdir(TranslationMemoryImpl::GetShardsDatabaseDir(), wxPATH_RMDIR_RECURSIVE);
+        wxFileName::Rmdir(TranslationMemoryImpl::GetSourcesDatabaseDir(), wxPATH_RMDIR_RECURSIVE);
 
         // recreate implementation object
         TranslationMemoryImpl *impl = new TranslationMemoryImpl;
         std::swap(m_impl, impl);
         delete impl;
         m_error = nullptr;
+        gs_revision++;
     }
 }
 
 void TranslationMemory::GetStats(long& numDocs, long& fileSize)
 {
-    if (!m_impl)
-        std::rethrow_exception(m_error);
-    m_impl->GetStats(numDocs, fileSize);
+    Impl().GetStats(numDocs, fileSize);
+}
+
+TranslationMemory::DetailedStats TranslationMemory::GetDetailedStats()
+{
+    return Impl().GetDetailedStats();
+}
+
+size_t TranslationMemory::GetCachesMemoryUsage()
+{
+    if (!m_implReady)
+        return 0;
+    return Impl().GetCachesMemoryUsage();
+}
+
+void TranslationMemory::Optimize()
+{
+    Impl().Optimize();
+}
+
+std::vector<TranslationMemory::ConcordanceHit>
+TranslationMemory::Concordance(const Language& srclang, const Language& lang,
+                               const std::wstring& phrase,
+                               ConcordanceDirection direction,
+                               size_t offset, size_t count,
+                               size_t *totalHits)
+{
+    return Impl().Concordance(srclang, lang, phrase, direction, offset, count, totalHits);
 }
 
 void TranslationMemory::SearchSubstring(IOInterface& destination,
                                         const Language& srclang, const Language& lang, const std::wstring& sourcePhrase)
 {
-    if (!m_impl)
-        std::rethrow_exception(m_error);
-    m_impl->SearchSubstring(destination, srclang, lang, sourcePhrase);
+    Impl().SearchSubstring(destination, srclang, lang, sourcePhrase);
 }
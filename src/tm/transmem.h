@@ -26,8 +26,12 @@
 #ifndef _TRANSMEM_H_
 #define _TRANSMEM_H_
 
+#include <atomic>
+#include <ctime>
 #include <exception>
 #include <functional>
+#include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <memory>
@@ -36,6 +40,7 @@
 #include "suggestions.h"
 
 class TranslationMemoryImpl;
+class TMServiceClient;
 
 /** 
     Lucene-based translation memory.
@@ -51,6 +56,26 @@ public:
     /// Destroys the singleton, must be called (only) on app shutdown.
     static void CleanUp();
 
+    /**
+        Opens the database in background, so that it's ready by the time
+        it is first used, and warms up its caches.
+
+        The database is otherwise opened lazily on first use, which may be
+        slow with large TMs.
+     */
+    static void Preload();
+
+    /**
+        Makes the TM use the one hosted by another Poedit process (see
+        TMService) instead of opening the database, which can only be used
+        by one process at a time.
+
+        Searches and writes are forwarded to the hosting process; other
+        operations, e.g. exporting or statistics, throw. Must be called
+        before the TM is first used.
+     */
+    void UseService(std::shared_ptr<TMServiceClient> service);
+
     /**
         Search translation memory for similar strings.
         
@@ -64,10 +89,56 @@ public:
                            const Language& lang,
                            const std::wstring& source);
 
+    /**
+        Search translation memory for several strings at once.
+
+        This is faster than calling Search() for each of them individually,
+        because the work that doesn't depend on the string is done only once
+        and because exact matches are looked up directly in the exact-match
+        index. Unlike Search(), if there are any exact matches for a string,
+        only they are returned for it and fuzzy search is skipped.
+
+        @return Lists of hits, one for each string in @a sources.
+     */
+    std::vector<SuggestionsList> Search(const Language& srclang,
+                                        const Language& lang,
+                                        const std::vector<std::wstring>& sources);
+
+    /**
+        Search translation memory for several strings in several languages.
+
+        Equivalent to calling the above for each of @a langs, but every source
+        string is analyzed only once, regardless of the number of languages.
+        Useful for processing all translations of the same source text (e.g.
+        all catalogs in a project) together.
+
+        @return Lists of hits, results[l][i] is for @a langs[l] and @a sources[i].
+     */
+    std::vector<std::vector<SuggestionsList>> Search(const Language& srclang,
+                                                     const std::vector<Language>& langs,
+                                                     const std::vector<std::wstring>& sources);
+
+    /**
+        Like Search() for several strings, but looks up translations of
+        plural source texts @a pluralSources into plural form @a form.
+
+        This is only meaningful for languages with more than 2 plural forms,
+        whose plural forms other than the first one are stored separately
+        for each form (for other languages, they are ordinary translations of
+        the plural source text). Returns empty results if the TM is hosted
+        by another process, which doesn't support it.
+     */
+    std::vector<SuggestionsList> SearchPluralForm(const Language& srclang,
+                                                  const Language& lang,
+                                                  const std::vector<std::wstring>& pluralSources,
+                                                  unsigned form);
+
     /// SuggestionsBackend API implementation:
     dispatch::future<SuggestionsList> SuggestTranslation(const SuggestionQuery&& q) override;
+    dispatch::future<std::vector<SuggestionsList>> SuggestTranslations(const std::vector<SuggestionQuery>& queries) override;
 
     void Delete(const std::string& id) override;
+    unsigned GetRevision() const override;
 
     /// Abstract interface to processing TM entries
     class IOInterface
@@ -93,13 +164,101 @@ public:
         Imports data provided by the function into the database. The function
         must use the interface passed to it to write data.
 
+        Imported entries are tagged with a unique import batch ID, which is
+        returned, so that they can be removed again later (see EntriesFilter).
+        Entries that were already in the TM are re-tagged too. The ID is empty
+        if the TM is hosted by another process.
+
         May throw on error.
      */
-    void ImportData(std::function<void(IOInterface&)> source);
+    std::string ImportData(std::function<void(IOInterface&)> source);
+
+    /// Selection of stored translations for bulk operations; empty criteria match everything
+    struct EntriesFilter
+    {
+        /// Languages of the entries; matches their regional variants too if only the language is given
+        Language srclang, lang;
+        /// Range of entries' creation times, [createdFrom, createdTo); 0 means unbounded
+        time_t createdFrom = 0, createdTo = 0;
+        /// ID returned by ImportData()
+        std::string importBatch;
+
+        bool IsEmpty() const
+        {
+            return !srclang.IsValid() && !lang.IsValid() && !createdFrom && !createdTo && importBatch.empty();
+        }
+    };
+
+    /// Returns the number of entries matching @a filter
+    size_t CountEntries(const EntriesFilter& filter);
+
+    /**
+        Exports entries matching @a filter, e.g. to keep a copy of them before
+        DeleteEntries(), so that the deletion can be undone by importing them.
+
+        Returns the number of exported entries. May throw on error.
+     */
+    size_t ExportEntries(const EntriesFilter& filter, IOInterface& destination);
+
+    /**
+        Deletes all entries matching @a filter at once and commits the change.
+
+        This is much faster than deleting entries one by one with Delete().
+        Returns the number of deleted entries. May throw on error.
+     */
+    size_t DeleteEntries(const EntriesFilter& filter);
+
+    /**
+        Removes all entries tagged with @a importBatch, i.e. undoes import
+        done by ImportData() that returned it.
+
+        Unlike DeleteEntries() with equivalent filter, doesn't need to read
+        the entries, it's a single indexed delete and therefore fast even for
+        very large imports. Entries that were already in the TM before the
+        import are removed too. Returns the number of removed entries.
+     */
+    size_t RollbackImport(const std::string& importBatch);
 
     void SearchSubstring(IOInterface& destination,
                          const Language& srclang, const Language& lang, const std::wstring& sourcePhrase);
 
+    /// Which side of stored translations to look for the phrase in
+    enum class ConcordanceDirection
+    {
+        Source,
+        Translation
+    };
+
+    /// Result of concordance search
+    struct ConcordanceHit
+    {
+        std::wstring source, trans;
+        time_t creationTime = 0;
+
+        /// Position and length of the phrase in the searched text, for
+        /// highlighting; npos if only its words were found, but not verbatim.
+        size_t matchPos = std::wstring::npos;
+        size_t matchLength = 0;
+    };
+
+    /**
+        Concordance search: finds stored translations containing @a phrase.
+
+        The phrase is searched for using the index, stored texts aren't
+        re-analyzed. Hits are sorted by relevance and paginated: at most
+        @a count hits starting at @a offset are returned.
+
+        @param totalHits If not null, set to the total number of hits.
+
+        Note that translations stored by older versions of Poedit aren't
+        found in the Translation direction until they are stored again.
+     */
+    std::vector<ConcordanceHit> Concordance(const Language& srclang, const Language& lang,
+                                            const std::wstring& phrase,
+                                            ConcordanceDirection direction,
+                                            size_t offset, size_t count,
+                                            size_t *totalHits = nullptr);
+
     /**
         Performs updates to the translation memory.
         
@@ -158,6 +317,20 @@ public:
          */
         virtual void Insert(const CatalogPtr& cat) = 0;
 
+        /**
+            Queues catalog item for insertion in the background.
+
+            Unlike Insert(), this is cheap and can be called from the main
+            thread. The item's content is captured immediately, repeated
+            changes to the same item are coalesced and entries that are
+            already in the TM are skipped. Queued items are searchable almost
+            immediately (through a small in-memory index), are written into
+            the database in batches and are included in the next Commit().
+         */
+        virtual void InsertLater(const Language& srclang,
+                                 const Language& lang,
+                                 const CatalogItemPtr& item) = 0;
+
         /// Delete a single document identifed by its UUID
         virtual void Delete(const std::string& uuid) = 0;
 
@@ -180,12 +353,80 @@ public:
     /// Returns statistics about the TM
     void GetStats(long& numDocs, long& fileSize);
 
+    /// Durations of an operation, over the most recent calls
+    struct LatencyStats
+    {
+        /// Upper bounds of histogram buckets, in milliseconds; the last
+        /// bucket is for everything slower.
+        static constexpr double HISTOGRAM_BOUNDS[] = {1, 5, 20, 100, 500};
+        static constexpr size_t HISTOGRAM_BUCKETS = 6;
+
+        size_t count = 0;
+        double median = 0, p90 = 0, p99 = 0, max = 0;  // in milliseconds
+        size_t histogram[HISTOGRAM_BUCKETS] = {};
+    };
+
+    /// Detailed statistics, meant for diagnosing performance issues
+    struct DetailedStats
+    {
+        long numDocs = 0;
+        long deletedDocs = 0;   ///< deleted, but not merged away yet
+        long fileSize = 0;
+        int indexes = 0;        ///< more than one if partitioned by language
+        int segments = 0;       ///< total over all indexes
+
+        /// Number of stored translations per "srclang → lang" pair
+        std::map<std::string, long> docsPerLanguagePair;
+
+        /// Timing of Search, SearchSubstring, Insert and Commit operations
+        std::map<std::string, LatencyStats> latency;
+    };
+
+    /**
+        Returns detailed statistics about the TM.
+
+        This is slower than GetStats(), because it has to look at all
+        documents. Individual operations' timings are also logged with
+        the "poedit.tm" trace mask.
+     */
+    DetailedStats GetDetailedStats();
+
+    /**
+        Returns approximate memory used by the TM's in-memory caches (field
+        caches used for scoring hits), in bytes.
+
+        Returns 0 if the database wasn't opened yet, doesn't open it.
+     */
+    size_t GetCachesMemoryUsage();
+
+    /**
+        Optimizes the database for searching by merging all its segments.
+
+        The database is compacted at the same time: duplicates of the same
+        translation (e.g. stored by older versions under different IDs) are
+        merged into the most recent one, invalid entries are removed, and
+        entries stored in old formats are rewritten in the current one.
+
+        This is slow on large TMs and is meant to be run explicitly as
+        a maintenance action, not as part of normal operations.
+
+        May throw on error.
+     */
+    void Optimize();
+
 private:
     TranslationMemory();
     ~TranslationMemory();
 
+    /// Returns the implementation, opening the database if needed; throws on error
+    TranslationMemoryImpl& Impl();
+
+    std::once_flag m_implFlag;
+    std::atomic<bool> m_implReady;
     TranslationMemoryImpl *m_impl;
     std::exception_ptr m_error;
+    std::shared_ptr<TMServiceClient> m_service;
+    std::shared_ptr<Writer> m_serviceWriter;
     static TranslationMemory *ms_instance;
 };
 
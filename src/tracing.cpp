@@ -0,0 +1,295 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "tracing.h"
+
+#include <wx/log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __WXMSW__
+    #include <wx/msw/wrapwin.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+
+namespace
+{
+
+struct Event
+{
+    const char *category, *name;
+    int64_t start, duration;
+};
+
+// Events are collected in per-thread buffers to avoid contention between
+// threads. The buffers are shared with the registry so that events of
+// threads that already terminated aren't lost.
+struct ThreadBuffer
+{
+    explicit ThreadBuffer(int tid_) : tid(tid_) {}
+
+    const int tid;
+    std::mutex mutex;
+    std::vector<Event> events;
+};
+
+struct CounterEvent
+{
+    const char *name;
+    int64_t ts;
+    std::vector<std::pair<const char*, uint64_t>> values;
+};
+
+// Spans active on the thread tracked with track_active_spans(). It is read
+// by other threads, so only string literals' pointers are stored, and as a
+// fixed-size array; a slightly inconsistent read can't do any harm then.
+const int MAX_ACTIVE_SPANS = 32;
+std::atomic<std::thread::id> gs_activeThread;
+std::atomic<const char*> gs_activeSpans[MAX_ACTIVE_SPANS];
+std::atomic<int> gs_activeDepth(0);
+
+std::mutex gs_registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> gs_buffers;
+std::vector<CounterEvent> gs_counters;  // rare, so not per-thread
+wxString gs_filename;
+
+ThreadBuffer& GetThreadBuffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> s_buffer;
+    if (!s_buffer)
+    {
+        std::lock_guard<std::mutex> lock(gs_registryMutex);
+        s_buffer = std::make_shared<ThreadBuffer>(int(gs_buffers.size() + 1));
+        gs_buffers.push_back(s_buffer);
+    }
+    return *s_buffer;
+}
+
+void WriteJSONString(std::ostream& out, const char *s)
+{
+    out << '"';
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            out << '\\';
+        out << *s;
+    }
+    out << '"';
+}
+
+} // anonymous namespace
+
+
+uint64_t tracing::peak_memory_usage()
+{
+#ifdef __WXMSW__
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    #ifdef __APPLE__
+    return usage.ru_maxrss;  // already in bytes on macOS
+    #else
+    return uint64_t(usage.ru_maxrss) * 1024;
+    #endif
+#endif
+}
+
+
+std::atomic<bool> tracing::detail::g_enabled(false);
+std::atomic<bool> tracing::detail::g_trackingActive(false);
+
+
+void tracing::start(const wxString& filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(gs_registryMutex);
+        gs_filename = filename;
+    }
+    detail::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+
+void tracing::stop()
+{
+    if (!detail::g_enabled.exchange(false))
+        return;
+
+    std::lock_guard<std::mutex> lock(gs_registryMutex);
+
+    std::ofstream out(gs_filename.fn_str(), std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        wxLogError("Failed to write trace file %s.", gs_filename);
+        return;
+    }
+
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (auto& buffer: gs_buffers)
+    {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        for (auto& e: buffer->events)
+        {
+            if (!first)
+                out << ",\n";
+            first = false;
+            out << "{\"name\":";
+            WriteJSONString(out, e.name);
+            out << ",\"cat\":";
+            WriteJSONString(out, e.category);
+            out << ",\"ph\":\"X\",\"ts\":" << e.start << ",\"dur\":" << e.duration
+                << ",\"pid\":1,\"tid\":" << buffer->tid << "}";
+        }
+        buffer->events.clear();
+    }
+
+    for (auto& c: gs_counters)
+    {
+        if (!first)
+            out << ",\n";
+        first = false;
+        out << "{\"name\":";
+        WriteJSONString(out, c.name);
+        out << ",\"ph\":\"C\",\"ts\":" << c.ts << ",\"pid\":1,\"tid\":0,\"args\":{";
+        for (size_t i = 0; i < c.values.size(); i++)
+        {
+            if (i)
+                out << ",";
+            WriteJSONString(out, c.values[i].first);
+            out << ":" << c.values[i].second;
+        }
+        out << "}}";
+    }
+    gs_counters.clear();
+
+    // Peak memory is reported as a counter at the end of the trace:
+    if (auto peak = peak_memory_usage())
+    {
+        if (!first)
+            out << ",\n";
+        out << "{\"name\":\"peak memory\",\"ph\":\"C\",\"ts\":" << span::now()
+            << ",\"pid\":1,\"tid\":0,\"args\":{\"bytes\":" << peak << "}}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+
+void tracing::counter(const char *name, std::initializer_list<std::pair<const char*, uint64_t>> values)
+{
+    if (!is_enabled())
+        return;
+
+    std::lock_guard<std::mutex> lock(gs_registryMutex);
+    gs_counters.push_back({name, span::now(), values});
+}
+
+
+int64_t tracing::span::now()
+{
+    static const auto s_epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_epoch).count();
+}
+
+
+void tracing::span::record()
+{
+    const int64_t end = now();
+    auto& buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back({m_category, m_name, m_start, end - m_start});
+}
+
+
+void tracing::event(const char *category, const char *name, int64_t start, int64_t duration)
+{
+    if (!is_enabled())
+        return;
+
+    auto& buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back({category, name, start, duration});
+}
+
+
+void tracing::track_active_spans(bool enable)
+{
+    if (enable)
+    {
+        gs_activeDepth = 0;
+        gs_activeThread = std::this_thread::get_id();
+    }
+    else
+    {
+        gs_activeThread = std::thread::id();
+    }
+    detail::g_trackingActive = enable;
+}
+
+
+std::vector<const char*> tracing::active_spans()
+{
+    std::vector<const char*> out;
+    const int depth = std::min(gs_activeDepth.load(), MAX_ACTIVE_SPANS);
+    for (int i = 0; i < depth; i++)
+    {
+        if (auto name = gs_activeSpans[i].load())
+            out.push_back(name);
+    }
+    return out;
+}
+
+
+bool tracing::detail::push_active(const char *name)
+{
+    if (std::this_thread::get_id() != gs_activeThread.load(std::memory_order_relaxed))
+        return false;
+
+    // deeper spans are counted, but not remembered:
+    const int depth = gs_activeDepth.load(std::memory_order_relaxed);
+    if (depth < MAX_ACTIVE_SPANS)
+        gs_activeSpans[depth].store(name, std::memory_order_relaxed);
+    gs_activeDepth.store(depth + 1, std::memory_order_release);
+    return true;
+}
+
+
+void tracing::detail::pop_active()
+{
+    gs_activeDepth.fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,163 @@
+/*
+ *  This file is part of Poedit (https://poedit.net)
+ *
+ *  Copyright (C) 2026 Vaclav Slavik
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef Poedit_tracing_h
+#define Poedit_tracing_h
+
+#include <wx/string.h>
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+/**
+    Lightweight tracing of where time is spent, for diagnosing performance.
+
+    Code is instrumented with TRACE_SPAN(), which records the duration of the
+    enclosing scope. Spans are only recorded when tracing was started with
+    tracing::start() (see the --trace command line option) and are written
+    as Chrome trace event JSON, viewable in https://ui.perfetto.dev or
+    chrome://tracing, by tracing::stop(). When not tracing, a span costs a
+    couple of atomic loads.
+
+    Define POEDIT_DISABLE_TRACING to compile the instrumentation out.
+ */
+namespace tracing
+{
+
+/// Starts recording spans, to be written into @a filename by stop().
+void start(const wxString& filename);
+
+/// Stops recording and writes the trace, if it was started.
+void stop();
+
+namespace detail
+{
+extern std::atomic<bool> g_enabled;
+extern std::atomic<bool> g_trackingActive;
+bool push_active(const char *name);
+void pop_active();
+}
+
+/// Is tracing currently enabled?
+inline bool is_enabled() { return detail::g_enabled.load(std::memory_order_relaxed); }
+
+/**
+    Records current values of counter @a name, e.g. memory usage by kind.
+
+    Does nothing if not tracing. @a name and names of the values must be
+    string literals.
+ */
+void counter(const char *name, std::initializer_list<std::pair<const char*, uint64_t>> values);
+
+/// Returns peak resident memory of the process so far, in bytes (0 if unknown)
+uint64_t peak_memory_usage();
+
+/**
+    Records event that already happened, from @a start (see span::now()) and
+    lasting @a duration microseconds, as if it were a span.
+
+    Does nothing if not tracing. @a name and @a category must be string literals.
+ */
+void event(const char *category, const char *name, int64_t start, int64_t duration);
+
+/**
+    Starts or stops keeping track of spans active on the calling thread, so
+    that other threads can find out what it's doing with active_spans().
+
+    Unlike recording of spans, this works even when not tracing. Only one
+    thread (typically the main one) can be tracked at a time.
+ */
+void track_active_spans(bool enable);
+
+/// Returns names of spans active on the tracked thread, outermost first.
+std::vector<const char*> active_spans();
+
+
+/// Records duration of its scope; @a name and @a category must be string literals.
+class span
+{
+public:
+    span(const char *category, const char *name)
+        : m_category(category), m_name(name), m_start(is_enabled() ? now() : -1),
+          m_active(detail::g_trackingActive.load(std::memory_order_relaxed) && detail::push_active(name)) {}
+
+    ~span()
+    {
+        if (m_start >= 0)
+            record();
+        if (m_active)
+            detail::pop_active();
+    }
+
+    span(const span&) = delete;
+    span& operator=(const span&) = delete;
+
+    /// Current timestamp in microseconds, as used in the trace.
+    static int64_t now();
+
+private:
+    void record();
+
+    const char *m_category, *m_name;
+    int64_t m_start;
+    bool m_active;
+};
+
+
+/**
+    Traces the time until asynchronous operation @a f completes.
+
+    @a f is a dispatch::future (or anything with compatible then()); the
+    returned future is equivalent to it.
+ */
+template<typename Future>
+Future trace_future(const char *category, const char *name, Future&& f)
+{
+    if (!is_enabled())
+        return std::move(f);
+    auto s = std::make_shared<span>(category, name);
+    return f.then([s](Future r){ return r.get(); });
+}
+
+} // namespace tracing
+
+
+#define TRACE_SPAN_CONCAT2(a, b)  a##b
+#define TRACE_SPAN_CONCAT(a, b)   TRACE_SPAN_CONCAT2(a, b)
+
+#ifdef POEDIT_DISABLE_TRACING
+    #define TRACE_SPAN(category, name)
+#else
+    /// Traces the rest of the current scope as span @a name in @a category.
+    #define TRACE_SPAN(category, name) \
+        tracing::span TRACE_SPAN_CONCAT(trace_span_, __LINE__)(category, name)
+#endif
+
+#endif // Poedit_tracing_h
@@ -27,23 +27,123 @@
 
 #include "str_helpers.h"
 
+#include <map>
+
 #include <unicode/ubidi.h>
+#include <unicode/uversion.h>
 
 
 namespace unicode
 {
 
-Collator::Collator(const Language& language, mode m)
+namespace
+{
+
+/**
+    Per-thread cache of ICU objects used as prototypes for cloning.
+
+    Opening a collator or break iterator loads locale data and rules, which is
+    expensive; cloning an already open instance is much cheaper. Instances are
+    kept per thread so that no locking is needed (and because not all ICU
+    versions guarantee thread-safe cloning).
+ */
+template<typename T, void (*Close)(T*)>
+class PrototypesCache
+{
+public:
+    PrototypesCache() {}
+    PrototypesCache(const PrototypesCache&) = delete;
+
+    ~PrototypesCache()
+    {
+        for (auto& i: m_items)
+        {
+            if (i.second)
+                Close(i.second);
+        }
+    }
+
+    /// Returns cached prototype for @a key, creating it with @a open() if needed
+    template<typename Factory>
+    const T *get(const std::string& key, Factory&& open)
+    {
+        auto i = m_items.find(key);
+        if (i != m_items.end())
+            return i->second;
+        return m_items.emplace(key, open()).first->second;
+    }
+
+private:
+    std::map<std::string, T*> m_items;
+};
+
+UCollator *open_collator(const Language& language)
 {
     UErrorCode err = U_ZERO_ERROR;
+    UCollator *coll;
 
     if (language.IsValid())
-        m_coll = ucol_open(language.IcuLocaleName().c_str(), &err);
+        coll = ucol_open(language.IcuLocaleName().c_str(), &err);
     else
-        m_coll = ucol_open(NULL, &err); // NULL is default locale, i.e. set to user's
+        coll = ucol_open(NULL, &err); // NULL is default locale, i.e. set to user's
+
+    if (!coll)
+    {
+        err = U_ZERO_ERROR;
+        coll = ucol_open("", &err); // "" is the root collator, should always exist
+    }
+
+    return coll;
+}
+
+UCollator *clone_collator(const UCollator *coll)
+{
+    if (!coll)
+        return nullptr;
+    UErrorCode err = U_ZERO_ERROR;
+#if U_ICU_VERSION_MAJOR_NUM >= 71
+    return ucol_clone(coll, &err);
+#else
+    return ucol_safeClone(coll, nullptr, nullptr, &err);
+#endif
+}
+
+UBreakIterator *open_break_iterator(UBreakIteratorType type, const Language& lang)
+{
+    UErrorCode err = U_ZERO_ERROR;
+    UBreakIterator *bi = ubrk_open(type, lang.IcuLocaleName().c_str(), nullptr, 0, &err);
+    if (U_FAILURE(err))
+    {
+        // fall back to root locale
+        err = U_ZERO_ERROR;
+        bi = ubrk_open(type, "", nullptr, 0, &err);
+    }
+    return U_SUCCESS(err) ? bi : nullptr;
+}
 
-    if (!m_coll)
-        m_coll = ucol_open("", &err); // "" is the root collator, should always exist
+UBreakIterator *clone_break_iterator(const UBreakIterator *bi)
+{
+    if (!bi)
+        return nullptr;
+    UErrorCode err = U_ZERO_ERROR;
+#if U_ICU_VERSION_MAJOR_NUM >= 69
+    return ubrk_clone(bi, &err);
+#else
+    return ubrk_safeClone(bi, nullptr, nullptr, &err);
+#endif
+}
+
+} // anonymous namespace
+
+
+Collator::Collator(const Language& language, mode m)
+{
+    static thread_local PrototypesCache<UCollator, ucol_close> s_prototypes;
+
+    // empty key is for the user's default locale:
+    auto prototype = s_prototypes.get(language.IsValid() ? language.IcuLocaleName() : std::string(),
+                                      [&]{ return open_collator(language); });
+    m_coll = clone_collator(prototype);
 
     wxASSERT(m_coll);
 
@@ -60,14 +160,11 @@ Collator::~Collator()
 
 BreakIterator::BreakIterator(UBreakIteratorType type, const Language& lang)
 {
-    UErrorCode err = U_ZERO_ERROR;
-    m_bi = ubrk_open(type, lang.IcuLocaleName().c_str(), nullptr, 0, &err);
-    if (U_FAILURE(err))
-    {
-        // fall back to root locale
-        err = U_ZERO_ERROR;
-        m_bi = ubrk_open(type, "", nullptr, 0, &err);
-    }
+    static thread_local PrototypesCache<UBreakIterator, ubrk_close> s_prototypes;
+
+    auto prototype = s_prototypes.get(std::to_string(type) + ":" + lang.IcuLocaleName(),
+                                      [&]{ return open_break_iterator(type, lang); });
+    m_bi = clone_break_iterator(prototype);
 }
 
 } // namespace unicode
@@ -81,8 +178,8 @@ TextDirection get_base_direction(const wxString& text)
     if (text.empty())
         return TextDirection::LTR;
 
-    auto s = str::to_icu(text);
-    switch (ubidi_getBaseDirection(s.data(), -1))
+    static thread_local str::UCharScratchBuffer s_buffer;
+    switch (ubidi_getBaseDirection(str::to_icu(text, s_buffer), -1))
     {
         case UBIDI_RTL:
             return TextDirection::RTL;
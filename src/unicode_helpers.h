@@ -32,6 +32,12 @@
 
 #include <wx/string.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
 #include <unicode/ucol.h>
 #include <unicode/ubrk.h>
 
@@ -98,6 +104,39 @@ public:
         return compare(a, b) == UCOL_LESS;
     }
 
+    /**
+        Returns binary sort key for the string.
+
+        Comparing sort keys bytewise (see compare_sort_keys()) gives the same
+        result as compare(), but is much faster, so it's worth precomputing
+        the keys when sorting many strings.
+     */
+    std::string sort_key(const UChar *str) const
+    {
+        uint8_t buf[256];
+        int32_t length = ucol_getSortKey(m_coll, str, -1, buf, (int32_t)sizeof(buf));
+        if (length <= 0)
+            return std::string();
+        if (length <= (int32_t)sizeof(buf))
+            return std::string(reinterpret_cast<const char*>(buf), length - 1); // without terminating NUL
+
+        std::string key(length, '\0');
+        ucol_getSortKey(m_coll, str, -1, reinterpret_cast<uint8_t*>(&key[0]), length);
+        key.resize(length - 1);
+        return key;
+    }
+
+    /// Compares two keys returned by sort_key()
+    static result_type compare_sort_keys(const std::string& a, const std::string& b)
+    {
+        const int r = memcmp(a.data(), b.data(), std::min(a.length(), b.length()));
+        if (r != 0)
+            return r < 0 ? UCOL_LESS : UCOL_GREATER;
+        if (a.length() != b.length())
+            return a.length() < b.length() ? UCOL_LESS : UCOL_GREATER;
+        return UCOL_EQUAL;
+    }
+
 private:
     UCollator *m_coll = nullptr;
 };
@@ -218,6 +257,102 @@ inline auto fold_case(const T& str)
     return fold_case_to_type<T, T>(str);
 }
 
+/**
+    Returns true if @a length characters at @a str are all ASCII.
+
+    Works with both UTF-8 and wide strings. Written without any branches in
+    the loop, so that compilers can vectorize it.
+ */
+template<typename CharT>
+inline bool is_ascii(const CharT *str, size_t length)
+{
+    typedef typename std::make_unsigned<CharT>::type UCharT;
+    uint32_t acc = 0;
+    for (size_t i = 0; i < length; i++)
+        acc |= (uint32_t)(UCharT)str[i];
+    return acc < 0x80;
+}
+
+namespace detail
+{
+
+// Length of wxString's internal representation, i.e. of wx_str(); this
+// avoids any conversions if wxWidgets is built to store strings in UTF-8.
+inline size_t internal_length(const wxString& str)
+{
+#if wxUSE_UNICODE_UTF8
+    return str.utf8_length();
+#else
+    return str.length();
+#endif
+}
+
+} // namespace detail
+
+inline bool is_ascii(const wxString& str)
+{
+    // ASCII text is ASCII in UTF-8 too, it doesn't need to be decoded:
+    return is_ascii(str.wx_str(), detail::internal_length(str));
+}
+
+inline wchar_t ascii_to_lower(wchar_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? wchar_t(c + ('a' - 'A')) : c;
+}
+
+/// Folds case of ASCII-only string (see is_ascii()) without using ICU
+inline void ascii_fold_case_inplace(wxString& str)
+{
+    for (auto i = str.begin(); i != str.end(); ++i)
+    {
+        const wchar_t c = *i;
+        if (c >= 'A' && c <= 'Z')
+            *i = ascii_to_lower(c);
+    }
+}
+
+/**
+    Finds case-insensitive occurrence of @a needle in @a haystack.
+
+    Both must be ASCII-only (see is_ascii()) and @a needle must be already
+    case-folded. This avoids case-folding copy of @a haystack, which is what
+    fold_case() would do. Returns position of the match or npos.
+ */
+template<typename CharT>
+inline size_t ascii_find_nocase(const CharT *haystack, size_t haystackLength,
+                                const CharT *needle, size_t needleLength,
+                                size_t start = 0)
+{
+    if (needleLength == 0)
+        return start <= haystackLength ? start : std::wstring::npos;
+    if (needleLength > haystackLength)
+        return std::wstring::npos;
+
+    const wchar_t first = needle[0];
+    const size_t last = haystackLength - needleLength;
+    for (size_t i = start; i <= last; i++)
+    {
+        if (ascii_to_lower(haystack[i]) != first)
+            continue;
+        size_t j = 1;
+        while (j < needleLength && ascii_to_lower(haystack[i + j]) == (wchar_t)needle[j])
+            j++;
+        if (j == needleLength)
+            return i;
+    }
+
+    return std::wstring::npos;
+}
+
+/// Variant of ascii_find_nocase() working directly with wxString's internal representation
+inline size_t ascii_find_nocase(const wxString& haystack, const wxString& needle, size_t start = 0)
+{
+    // for ASCII strings, positions in UTF-8 and in characters are the same
+    return ascii_find_nocase(haystack.wx_str(), detail::internal_length(haystack),
+                             needle.wx_str(), detail::internal_length(needle),
+                             start);
+}
+
 /// Upper-casing Unicode-correctly
 template<typename T>
 inline auto to_upper(const T& str)
@@ -26,10 +26,14 @@
 #include "utility.h"
 
 #include <stdio.h>
+#include <type_traits>
 
 #include <wx/filename.h>
+#include <wx/file.h>
 #include <wx/log.h>
 #include <wx/config.h>
+#include <wx/stdpaths.h>
+#include <wx/utils.h>
 
 #if wxUSE_GUI
     #include <wx/display.h>
@@ -41,11 +45,32 @@
 #ifdef __UNIX__
     #include <sys/types.h>
     #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
     #include <unistd.h>
 #endif
+#ifdef __WXMSW__
+    #include <wx/msw/wrapwin.h>
+#endif
 
 #include "str_helpers.h"
 
+#include <fstream>
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define HAVE_SSE2_ESCAPING
+    #include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    #define HAVE_NEON_ESCAPING
+    #include <arm_neon.h>
+#endif
+
 wxString EscapeMarkup(const wxString& str)
 {
     wxString s(str);
@@ -81,6 +106,151 @@ wxString EscapeMarkup(const wxString& str)
 }
 
 
+namespace
+{
+
+template<typename U>
+inline bool NeedsCEscape(U c)
+{
+    return c == '"' || c == '\\' || c < 0x20;
+}
+
+// Checks whether any of 16 characters at @a p may need escaping; false
+// positives are fine, exact position is found by scalar code afterwards.
+template<typename U>
+inline bool BlockNeedsCEscape(const U *p);
+
+#if defined(HAVE_SSE2_ESCAPING)
+
+inline __m128i MatchCEscape8(__m128i v)
+{
+    // unsigned v <= 0x1f is v saturating-minus 0x1f == 0:
+    const __m128i ctrl = _mm_cmpeq_epi8(_mm_subs_epu8(v, _mm_set1_epi8(0x1f)), _mm_setzero_si128());
+    return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))), ctrl);
+}
+
+inline __m128i MatchCEscape16(__m128i v)
+{
+    const __m128i ctrl = _mm_cmpeq_epi16(_mm_subs_epu16(v, _mm_set1_epi16(0x1f)), _mm_setzero_si128());
+    return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(v, _mm_set1_epi16('"')), _mm_cmpeq_epi16(v, _mm_set1_epi16('\\'))), ctrl);
+}
+
+inline __m128i MatchCEscape32(__m128i v)
+{
+    // signed comparison is fine, Unicode code points are < 2^31:
+    const __m128i ctrl = _mm_cmplt_epi32(v, _mm_set1_epi32(0x20));
+    return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(v, _mm_set1_epi32('"')), _mm_cmpeq_epi32(v, _mm_set1_epi32('\\'))), ctrl);
+}
+
+inline __m128i Load128(const void *p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+
+template<>
+inline bool BlockNeedsCEscape(const uint8_t *p)
+{
+    return _mm_movemask_epi8(MatchCEscape8(Load128(p))) != 0;
+}
+
+template<>
+inline bool BlockNeedsCEscape(const uint16_t *p)
+{
+    const __m128i m = _mm_or_si128(MatchCEscape16(Load128(p)), MatchCEscape16(Load128(p + 8)));
+    return _mm_movemask_epi8(m) != 0;
+}
+
+template<>
+inline bool BlockNeedsCEscape(const uint32_t *p)
+{
+    const __m128i m = _mm_or_si128(_mm_or_si128(MatchCEscape32(Load128(p)), MatchCEscape32(Load128(p + 4))),
+                                   _mm_or_si128(MatchCEscape32(Load128(p + 8)), MatchCEscape32(Load128(p + 12))));
+    return _mm_movemask_epi8(m) != 0;
+}
+
+#elif defined(HAVE_NEON_ESCAPING)
+
+template<>
+inline bool BlockNeedsCEscape(const uint8_t *p)
+{
+    const uint8x16_t v = vld1q_u8(p);
+    const uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\\'))),
+                                  vcltq_u8(v, vdupq_n_u8(0x20)));
+    return vmaxvq_u8(m) != 0;
+}
+
+inline uint16x8_t MatchCEscape16(const uint16_t *p)
+{
+    const uint16x8_t v = vld1q_u16(p);
+    return vorrq_u16(vorrq_u16(vceqq_u16(v, vdupq_n_u16('"')), vceqq_u16(v, vdupq_n_u16('\\'))),
+                     vcltq_u16(v, vdupq_n_u16(0x20)));
+}
+
+template<>
+inline bool BlockNeedsCEscape(const uint16_t *p)
+{
+    return vmaxvq_u16(vorrq_u16(MatchCEscape16(p), MatchCEscape16(p + 8))) != 0;
+}
+
+inline uint32x4_t MatchCEscape32(const uint32_t *p)
+{
+    const uint32x4_t v = vld1q_u32(p);
+    return vorrq_u32(vorrq_u32(vceqq_u32(v, vdupq_n_u32('"')), vceqq_u32(v, vdupq_n_u32('\\'))),
+                     vcltq_u32(v, vdupq_n_u32(0x20)));
+}
+
+template<>
+inline bool BlockNeedsCEscape(const uint32_t *p)
+{
+    const uint32x4_t m = vorrq_u32(vorrq_u32(MatchCEscape32(p), MatchCEscape32(p + 4)),
+                                   vorrq_u32(MatchCEscape32(p + 8), MatchCEscape32(p + 12)));
+    return vmaxvq_u32(m) != 0;
+}
+
+#endif // HAVE_SSE2_ESCAPING/HAVE_NEON_ESCAPING
+
+template<typename U>
+size_t DoFindCharToEscape(const U *s, size_t len)
+{
+    size_t i = 0;
+#if defined(HAVE_SSE2_ESCAPING) || defined(HAVE_NEON_ESCAPING)
+    while (i + 16 <= len)
+    {
+        if (BlockNeedsCEscape(s + i))
+        {
+            for (size_t blockEnd = i + 16; i < blockEnd; i++)
+            {
+                if (NeedsCEscape(s[i]))
+                    return i;
+            }
+        }
+        else
+        {
+            i += 16;
+        }
+    }
+#endif
+    for (; i < len; i++)
+    {
+        if (NeedsCEscape(s[i]))
+            return i;
+    }
+    return len;
+}
+
+typedef std::conditional<sizeof(wchar_t) == 2, uint16_t, uint32_t>::type WcharUnit;
+
+} // anonymous namespace
+
+
+size_t FindCharToEscape(const char *s, size_t len)
+{
+    return DoFindCharToEscape(reinterpret_cast<const uint8_t*>(s), len);
+}
+
+size_t FindCharToEscape(const wchar_t *s, size_t len)
+{
+    return DoFindCharToEscape(reinterpret_cast<const WcharUnit*>(s), len);
+}
+
+
 wxFileName CommonDirectory(const wxFileName& a, const wxFileName& b)
 {
     if (!a.IsOk())
@@ -117,6 +287,19 @@ wxFileName MakeFileName(const wxString& path)
     return fn;
 }
 
+wxString GetUserDataDir()
+{
+    wxString data;
+#if defined(__UNIX__) && !defined(__WXOSX__)
+    if ( !wxGetEnv("XDG_DATA_HOME", &data) )
+        data = wxGetHomeDir() + "/.local/share";
+    data += "/poedit";
+#else
+    data = wxStandardPaths::Get().GetUserDataDir();
+#endif
+    return data;
+}
+
 #if wxUSE_GUI && defined(__WXMSW__)
 bool IsRunningUnderScreenReader()
 {
@@ -199,7 +382,11 @@ wxString TempDirectory::CreateFileName(const wxString& suffix)
 {
     wxASSERT( !m_dir.empty() );
 
-    int counter = m_counters[suffix]++;
+    int counter;
+    {
+        std::lock_guard<std::mutex> lock(m_countersMutex);
+        counter = m_counters[suffix]++;
+    }
 
     wxString s = wxString::Format("%s%c%s%s",
                                   m_dir.c_str(), wxFILE_SEP_PATH,
@@ -280,6 +467,37 @@ bool TempOutputFileFor::Commit()
     return ReplaceFile(m_filenameTmp, m_filenameFinal);
 }
 
+bool TempOutputFileFor::CompressWithGzip()
+{
+    const wxString compressed = m_filenameTmp + ".gz";
+    try
+    {
+        std::ifstream in(m_filenameTmp.fn_str(), std::ios::binary);
+        std::ofstream f(compressed.fn_str(), std::ios::binary);
+        if (!in || !f)
+            return false;
+        {
+            boost::iostreams::filtering_ostream out;
+            out.push(boost::iostreams::gzip_compressor());
+            out.push(f);
+            boost::iostreams::copy(in, out);
+        } // flushes the compressor and writes gzip trailer
+        f.close();
+        if (f.fail())
+        {
+            wxRemoveFile(compressed);
+            return false;
+        }
+    }
+    catch (...)
+    {
+        wxRemoveFile(compressed);
+        return false;
+    }
+
+    return wxRenameFile(compressed, m_filenameTmp, /*overwrite=*/true);
+}
+
 bool TempOutputFileFor::ReplaceFile(const wxString& temp, const wxString& dest)
 {
 #ifdef __WXOSX__
@@ -336,6 +554,170 @@ TempOutputFileFor::~TempOutputFileFor()
 #endif
 }
 
+
+// ----------------------------------------------------------------------
+// MappedFile
+// ----------------------------------------------------------------------
+
+bool IsGzipFileName(const wxString& filename)
+{
+    return filename.Lower().EndsWith(".gz");
+}
+
+wxString StripGzipExtension(const wxString& filename)
+{
+    return IsGzipFileName(filename) ? filename.substr(0, filename.length() - 3) : filename;
+}
+
+namespace
+{
+
+// gzip streams start with these two bytes:
+inline bool is_gzip_data(const char *data, size_t size)
+{
+    return size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+}
+
+} // anonymous namespace
+
+MappedFile::MappedFile(const wxString& filename) : MappedFile(filename, RawContent)
+{
+    if (!m_ok || !is_gzip_data(m_data, m_size))
+        return;
+
+    // Decompress directly from the mapping, in chunks, so that the
+    // compressed data doesn't need another copy in memory:
+    std::string decompressed;
+    decompressed.reserve(m_size * 4);
+    try
+    {
+        boost::iostreams::filtering_istream in;
+        in.push(boost::iostreams::gzip_decompressor());
+        in.push(boost::iostreams::array_source(m_data, m_size));
+        boost::iostreams::copy(in, boost::iostreams::back_inserter(decompressed));
+    }
+    catch (...)
+    {
+        Unmap();
+        m_buffer.clear();
+        m_data = nullptr;
+        m_size = 0;
+        m_ok = false;
+        return;
+    }
+
+    Unmap();
+    m_buffer = std::move(decompressed);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+MappedFile::MappedFile(const wxString& filename, RawContentTag)
+{
+#if defined(__UNIX__)
+    int fd = open(filename.fn_str(), O_RDONLY);
+    if (fd != -1)
+    {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            m_size = (size_t)st.st_size;
+            if (m_size == 0)
+            {
+                m_ok = true;
+            }
+            else
+            {
+                void *addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr != MAP_FAILED)
+                {
+                    madvise(addr, m_size, MADV_SEQUENTIAL);
+                    m_data = static_cast<const char*>(addr);
+                    m_mapped = m_ok = true;
+                }
+            }
+        }
+        close(fd);
+    }
+#elif defined(__WXMSW__)
+    HANDLE file = ::CreateFileW(filename.wc_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER size;
+        if (::GetFileSizeEx(file, &size))
+        {
+            m_size = (size_t)size.QuadPart;
+            if (m_size == 0)
+            {
+                m_ok = true;
+            }
+            else
+            {
+                HANDLE mapping = ::CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                if (mapping)
+                {
+                    void *addr = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                    if (addr)
+                    {
+                        m_mapping = mapping;
+                        m_data = static_cast<const char*>(addr);
+                        m_mapped = m_ok = true;
+                    }
+                    else
+                    {
+                        ::CloseHandle(mapping);
+                    }
+                }
+            }
+        }
+        ::CloseHandle(file);
+    }
+#endif
+
+    if (m_ok)
+        return;
+
+    // mapping failed or isn't supported, read the file into memory instead:
+    wxFile f;
+    if (!f.Open(filename, wxFile::read))
+        return;
+    wxFileOffset len = f.Length();
+    if (len == wxInvalidOffset)
+        return;
+    m_buffer.resize((size_t)len);
+    if (len > 0 && f.Read(&m_buffer[0], (size_t)len) != (ssize_t)len)
+    {
+        m_buffer.clear();
+        return;
+    }
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    m_ok = true;
+}
+
+MappedFile::~MappedFile()
+{
+    Unmap();
+}
+
+void MappedFile::Unmap()
+{
+    if (!m_mapped)
+        return;
+
+#if defined(__UNIX__)
+    munmap(const_cast<char*>(m_data), m_size);
+#elif defined(__WXMSW__)
+    ::UnmapViewOfFile(m_data);
+    ::CloseHandle((HANDLE)m_mapping);
+    m_mapping = nullptr;
+#endif
+
+    m_data = nullptr;
+    m_mapped = false;
+}
+
 #ifdef __WXMSW__
 wxString CliSafeFileName(const wxString& fn)
 {
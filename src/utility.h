@@ -26,7 +26,12 @@
 #ifndef Poedit_utility_h
 #define Poedit_utility_h
 
+#include <cstdint>
 #include <map>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
 
 #include <wx/arrstr.h>
 #include <wx/filename.h>
@@ -102,88 +107,156 @@
 
 wxString EscapeMarkup(const wxString& str);
 
+/// Computes 64bit FNV-1a hash of @a data, optionally continuing from previous @a hash.
+inline uint64_t HashFNV1a(const void *data, size_t len, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    auto p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 // Encoding and decoding a string with C escape sequences:
 
-template<typename T>
-inline void EscapeCStringInplace(T& str)
+/**
+    Returns offset of the first character in @a s that may need C escaping
+    (quote, backslash or a control character), or @a len if there's none.
+
+    Uses SIMD instructions to check 16 characters at a time where available,
+    because most text doesn't need any escaping at all.
+ */
+size_t FindCharToEscape(const char *s, size_t len);
+size_t FindCharToEscape(const wchar_t *s, size_t len);
+
+namespace cstring_detail
+{
+
+inline const char *CStringData(const std::string& s) { return s.data(); }
+inline const wchar_t *CStringData(const std::wstring& s) { return s.data(); }
+inline const wchar_t *CStringData(const wxString& s) { return s.wx_str(); }
+
+template<typename T, typename CharT>
+inline T EscapeCString(const T& str, const CharT *data, size_t len)
 {
-    for (typename T::iterator i = str.begin(); i != str.end(); ++i)
+    size_t pos = FindCharToEscape(data, len);
+    if (pos == len)
+        return str;
+
+    T out;
+    out.reserve(len + len / 8 + 2);
+    size_t copyFrom = 0;
+    while (pos < len)
     {
-        switch ((wchar_t)*i)
+        // copy the run with nothing to escape in one go:
+        out.append(data + copyFrom, pos - copyFrom);
+
+        char escaped = 0;
+        switch ((wchar_t)data[pos])
         {
-            case '"' :           i = ++str.insert(i, '\\'); break;
-            case '\a': *i = 'a'; i = ++str.insert(i, '\\'); break;
-            case '\b': *i = 'b'; i = ++str.insert(i, '\\'); break;
-            case '\f': *i = 'f'; i = ++str.insert(i, '\\'); break;
-            case '\n': *i = 'n'; i = ++str.insert(i, '\\'); break;
-            case '\r': *i = 'r'; i = ++str.insert(i, '\\'); break;
-            case '\t': *i = 't'; i = ++str.insert(i, '\\'); break;
-            case '\v': *i = 'v'; i = ++str.insert(i, '\\'); break;
-            case '\\':           i = ++str.insert(i, '\\'); break;
+            case '"' : escaped = '"';  break;
+            case '\a': escaped = 'a';  break;
+            case '\b': escaped = 'b';  break;
+            case '\f': escaped = 'f';  break;
+            case '\n': escaped = 'n';  break;
+            case '\r': escaped = 'r';  break;
+            case '\t': escaped = 't';  break;
+            case '\v': escaped = 'v';  break;
+            case '\\': escaped = '\\'; break;
             default:
                 break;
         }
-    }
-}
+        if (escaped)
+        {
+            out += CharT('\\');
+            out += CharT(escaped);
+        }
+        else
+        {
+            out += data[pos];  // other control characters are kept as they are
+        }
 
-template<typename T>
-inline T EscapeCString(const T& str)
-{
-    T out(str);
-    EscapeCStringInplace(out);
+        copyFrom = pos + 1;
+        pos = copyFrom + FindCharToEscape(data + copyFrom, len - copyFrom);
+    }
+    out.append(data + copyFrom, len - copyFrom);
     return out;
 }
 
-template<typename T>
-inline T UnescapeCString(const T& str)
+template<typename T, typename CharT>
+inline T UnescapeCString(const T& str, const CharT *data, size_t len)
 {
-    if (str.find('\\') == T::npos)
+    typedef std::char_traits<CharT> traits;
+
+    const CharT *end = data + len;
+    const CharT *backslash = traits::find(data, len, CharT('\\'));
+    if (!backslash)
         return str;
 
     T out;
-    out.reserve(str.length());
-    for (auto i = str.begin(); i != str.end(); ++i)
+    out.reserve(len);
+    const CharT *copyFrom = data;
+    while (backslash)
     {
-        wchar_t c = *i;
-        if (c == '\\')
+        out.append(copyFrom, backslash - copyFrom);
+        if (backslash + 1 == end)
         {
-            if (++i != str.end())
-            {
-                switch ((wchar_t)*i)
-                {
-                    case 'a': out += '\a'; break;
-                    case 'b': out += '\b'; break;
-                    case 'f': out += '\f'; break;
-                    case 'n': out += '\n'; break;
-                    case 'r': out += '\r'; break;
-                    case 't': out += '\t'; break;
-                    case 'v': out += '\v'; break;
-                    case '\\':
-                    case '"':
-                    case '\'':
-                    case '?':
-                        out += *i;
-                        break;
-                    default:
-                        out += c;
-                        out += *i;
-                        break;
-                }
-            }
-            else
-            {
-                out += c;
-                break;
-            }
+            out += CharT('\\');
+            copyFrom = end;
+            break;
         }
-        else
+
+        const CharT c = backslash[1];
+        switch ((wchar_t)c)
         {
-            out += c;
+            case 'a': out += CharT('\a'); break;
+            case 'b': out += CharT('\b'); break;
+            case 'f': out += CharT('\f'); break;
+            case 'n': out += CharT('\n'); break;
+            case 'r': out += CharT('\r'); break;
+            case 't': out += CharT('\t'); break;
+            case 'v': out += CharT('\v'); break;
+            case '\\':
+            case '"':
+            case '\'':
+            case '?':
+                out += c;
+                break;
+            default:
+                out += CharT('\\');
+                out += c;
+                break;
         }
+
+        copyFrom = backslash + 2;
+        backslash = traits::find(copyFrom, end - copyFrom, CharT('\\'));
     }
+    out.append(copyFrom, end - copyFrom);
     return out;
 }
 
+} // namespace cstring_detail
+
+template<typename T>
+inline T EscapeCString(const T& str)
+{
+    return cstring_detail::EscapeCString(str, cstring_detail::CStringData(str), str.length());
+}
+
+template<typename T>
+inline void EscapeCStringInplace(T& str)
+{
+    str = EscapeCString(str);
+}
+
+template<typename T>
+inline T UnescapeCString(const T& str)
+{
+    return cstring_detail::UnescapeCString(str, cstring_detail::CStringData(str), str.length());
+}
+
 
 wxFileName MakeFileName(const wxString& path);
 
@@ -217,6 +290,15 @@ inline wxString MaskForType(const char *extensions, const wxString& description,
 }
 
 
+/**
+    Returns the directory where Poedit keeps user data that must persist
+    (translation memory, journals of unsaved edits), without trailing separator.
+
+    Uses XDG_DATA_HOME on Unix systems other than macOS. The directory may
+    not exist yet.
+ */
+wxString GetUserDataDir();
+
 #if wxUSE_GUI && defined(__WXMSW__)
 bool IsRunningUnderScreenReader();
 #endif
@@ -241,7 +323,7 @@ public:
 
     const wxString& DirName() const { return m_dir; }
 
-    // creates new file name in that directory
+    // creates new file name in that directory (thread-safe)
     wxString CreateFileName(const wxString& suffix);
 
     /// Clears the temp directory (only safe if none of the files are open). Called by dtor.
@@ -251,6 +333,7 @@ public:
     static void KeepFiles(bool keep = true) { ms_keepFiles = keep; }
 
 private:
+    std::mutex m_countersMutex;
     std::map<wxString, int> m_counters;
     wxString m_dir;
 
@@ -276,6 +359,12 @@ public:
     /// Renames temp file to the final one (passed to ctor).
     bool Commit();
 
+    /**
+        Compresses the temp file written so far with gzip, for files stored
+        compressed (see IsGzipFileName()). Call before Commit().
+     */
+    bool CompressWithGzip();
+
     /// Rename file to replace another *while preserving destination
     /// file's permissions*.
     /// Make this helper publicly accessible for code that can't
@@ -290,6 +379,93 @@ public:
 };
 
 
+// ----------------------------------------------------------------------
+// MappedFile
+// ----------------------------------------------------------------------
+
+/// Is the file stored gzip-compressed, i.e. does it have a .gz extension?
+bool IsGzipFileName(const wxString& filename);
+
+/// Returns @a filename without the .gz extension, if it has one
+wxString StripGzipExtension(const wxString& filename);
+
+/**
+    Output stream writing into a std::string.
+
+    Unlike std::ostringstream, whose str() returns a copy, the written data
+    can be taken out of it without copying with TakeString().
+ */
+class StringOutputStream : public std::ostream
+{
+public:
+    StringOutputStream() : std::ostream(&m_buf) {}
+
+    std::string TakeString() { return std::move(m_buf.data); }
+
+private:
+    struct Buffer : public std::streambuf
+    {
+        std::string data;
+
+        int_type overflow(int_type c) override
+        {
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+                data.push_back(traits_type::to_char_type(c));
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char *s, std::streamsize n) override
+        {
+            data.append(s, size_t(n));
+            return n;
+        }
+    };
+
+    Buffer m_buf;
+};
+
+/**
+    Read-only view of file's content, memory-mapped if possible.
+
+    Falls back to reading the file into memory if mapping isn't possible
+    (e.g. on some network filesystems). The data is not NUL-terminated.
+
+    Files with gzip-compressed content are decompressed into memory as
+    they are read, so they can be used as if they weren't compressed.
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const wxString& filename);
+
+    /// Maps the file as is, without decompressing it
+    enum RawContentTag { RawContent };
+    MappedFile(const wxString& filename, RawContentTag);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool IsOk() const { return m_ok; }
+
+    const char *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    void Unmap();
+
+    bool m_ok = false;
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+    bool m_mapped = false;
+    std::string m_buffer;
+#ifdef __WXMSW__
+    void *m_mapping = nullptr;
+#endif
+};
+
+
 #ifdef __WXMSW__
 /// Return filename safe for passing to CLI tools (gettext).
 /// Uses 8.3 short names to avoid Unicode and codepage issues.